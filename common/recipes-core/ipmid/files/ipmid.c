@@ -45,6 +45,9 @@
 #define SIZE_IANA_ID 3
 #define SIZE_GUID 16
 
+// SEL entries per OEM bulk read, keeps the response within an IPMB frame
+#define SEL_BULK_MAX 12
+
 //declare for clearing BIOS flag
 #define BIOS_Timeout 600
 // Boot valid flag
@@ -2867,6 +2870,57 @@ oem_stor_add_string_sel(unsigned char *request, unsigned char req_len,
   return;
 }
 
+static void
+oem_stor_get_sel_entries(unsigned char *request, unsigned char req_len,
+                         unsigned char *response, unsigned char *res_len)
+{
+  // Byte0:1      Reservation ID (unused)
+  // Byte2:3      Record ID to start from, LSB first
+  // Byte4        Max number of entries
+  // Response: next Record ID (2 bytes), entry count, count * 16 bytes
+  ipmi_mn_req_t *req = (ipmi_mn_req_t *) request;
+  ipmi_res_t *res = (ipmi_res_t *) response;
+  unsigned char *data = &res->data[0];
+  sel_msg_t entries[SEL_BULK_MAX];
+  int read_rec_id;
+  int next_rec_id;
+  int count;
+  int max;
+
+  *res_len = 0;
+
+  if (req_len < 8) {
+    res->cc = CC_INVALID_LENGTH;
+    return;
+  }
+
+  read_rec_id = (req->data[3] << 8) | req->data[2];
+  max = req->data[4];
+  if (max == 0) {
+    res->cc = CC_PARAM_OUT_OF_RANGE;
+    return;
+  }
+  if (max > SEL_BULK_MAX) {
+    max = SEL_BULK_MAX;
+  }
+
+  if (sel_get_entries(req->payload_id, read_rec_id, entries, max, &count,
+                      &next_rec_id)) {
+    res->cc = CC_UNSPECIFIED_ERROR;
+    return;
+  }
+
+  res->cc = CC_SUCCESS;
+  *data++ = next_rec_id & 0xFF;
+  *data++ = (next_rec_id >> 8) & 0xFF;
+  *data++ = count;
+
+  memcpy(data, entries, count * sizeof(sel_msg_t));
+  data += count * sizeof(sel_msg_t);
+
+  *res_len = data - &res->data[0];
+}
+
 static void
 ipmi_handle_oem (unsigned char *request, unsigned char req_len,
      unsigned char *response, unsigned char *res_len)
@@ -2982,6 +3036,9 @@ ipmi_handle_oem_storage (unsigned char *request, unsigned char req_len,
     case CMD_OEM_STOR_ADD_STRING_SEL:
       oem_stor_add_string_sel (request, req_len, response, res_len);
       break;
+    case CMD_OEM_STOR_GET_SEL_ENTRIES:
+      oem_stor_get_sel_entries (request, req_len, response, res_len);
+      break;
     default:
       res->cc = CC_INVALID_CMD;
       break;
@@ -5,8 +5,9 @@
  * This file represents platform specific implementation for storing
  * SEL logs and acts as back-end for IPMI stack
  *
- * TODO: Optimize the file handling to keep file open always instead of
- * current open/seek/close
+ * Records are appended to fixed size segment files under /mnt/data/sel<node>/
+ * and mirrored in an in-memory ring indexed by sequence number, so lookups
+ * never touch the flash and rotation only unlinks the oldest segment.
  *
  *
  * This program is free software; you can redistribute it and/or modify
@@ -23,7 +24,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
-#define _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
 #include "sel.h"
 #include "timestamp.h"
 #include <stdio.h>
@@ -34,178 +35,507 @@
 #include <string.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <time.h>
 #include <openbmc/pal.h>
 
-// SEL File.
-#define SEL_LOG_FILE  "/mnt/data/sel%d.bin"
-#define SIZE_PATH_MAX 32
+
+// SEL store, one directory per node holding the segment files
+#ifndef SEL_LOG_DIR
+#define SEL_LOG_DIR   "/mnt/data/sel%d"
+#endif
+#define SEL_SEG_FILE  SEL_LOG_DIR "/%08x.seg"
+#define SEL_META_FILE SEL_LOG_DIR "/meta"
+#define SEL_META_TMP  SEL_LOG_DIR "/meta.tmp"
+#define SIZE_PATH_MAX 64
+
+// Single file SEL used by older images, imported once at init
+#ifndef SEL_LEGACY_FILE
+#define SEL_LEGACY_FILE "/mnt/data/sel%d.bin"
+#endif
+#define SEL_LEGACY_VERSION 0x01
+#define SEL_LEGACY_OFFSET 0x100
+#define SEL_LEGACY_ELEMS 129
 
 // SEL Header magic number
 #define SEL_HDR_MAGIC 0xFBFBFBFB
 
-// SEL Header version number
-#define SEL_HDR_VERSION 0x01
-
-// SEL Data offset from file beginning
-#define SEL_DATA_OFFSET 0x100
+// Segment and meta file version number
+#define SEL_HDR_VERSION 0x02
 
 // SEL reservation IDs can not be 0x00 or 0xFFFF
 #define SEL_RSVID_MIN  0x01
 #define SEL_RSVID_MAX  0xFFFE
 
-// Number of SEL records before wrap
-#define SEL_RECORDS_MAX 128 // TODO: Based on need we can make it bigger
-#define SEL_ELEMS_MAX (SEL_RECORDS_MAX+1)
+// Records per segment and number of segments kept before the oldest one
+// is dropped
+#define SEL_SEG_RECORDS 1024
+#define SEL_SEGS_MAX 24
+#define SEL_RECORDS_MAX (SEL_SEG_RECORDS * SEL_SEGS_MAX)
 
-// Index for circular array
-#define SEL_INDEX_MIN 0x00
-#define SEL_INDEX_MAX SEL_RECORDS_MAX
+// Upper bound of segment files looked at while scanning the directory
+#define SEL_SCAN_MAX 256
 
-// Record ID can not be 0x0 (IPMI/Section 31)
-#define SEL_RECID_MIN (SEL_INDEX_MIN+1)
-#define SEL_RECID_MAX (SEL_INDEX_MAX+1)
+// Record ID can not be 0x0 (IPMI/Section 31), IDs 0x0001-0xFFFE are
+// handed out from the sequence number
+#define SEL_RECID_MIN 0x0001
+#define SEL_RECID_SPAN 0xFFFE
 
 // Special RecID value for first and last (IPMI/Section 31)
 #define SEL_RECID_FIRST 0x0000
 #define SEL_RECID_LAST 0xFFFF
 
-// SEL header struct to keep track of SEL Log entries
+#define SEL_SEG_NUM(seq) ((seq) / SEL_SEG_RECORDS)
+#define SEL_SEG_OFFSET(seq) \
+  (sizeof(sel_seg_hdr_t) + ((seq) % SEL_SEG_RECORDS) * sizeof(sel_msg_t))
+
+// Header at the start of every segment file, followed by the records
 typedef struct {
-  int magic; // Magic number to check validity
-  int version; // version number of this header
-  int begin; // index to the beginning of the log
-  int end; // index to end of the log
+  uint32_t magic; // Magic number to check validity
+  uint32_t version; // version number of this header
+  uint32_t seq; // sequence number of the first record in this segment
+  uint32_t reserved;
+} sel_seg_hdr_t;
+
+// Written on erase only, records where numbering continues
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t next; // sequence number of the next record
+  time_stamp_t ts_erase; // last erase time stamp
+} sel_meta_t;
+
+// Legacy SEL header struct, kept to import sel%d.bin
+typedef struct {
+  int magic;
+  int version;
+  int begin;
+  int end;
+  time_stamp_t ts_add;
+  time_stamp_t ts_erase;
+} sel_legacy_hdr_t;
+
+// Per node SEL state. Records [first, next) are retained, record seq lives
+// in data[seq % SEL_RECORDS_MAX].
+typedef struct {
+  uint32_t first; // sequence number of the oldest record
+  uint32_t next; // sequence number given to the next record
+  int fd; // segment being appended to, -1 if not open
   time_stamp_t ts_add; // last addition time stamp
   time_stamp_t ts_erase; // last erase time stamp
-} sel_hdr_t;
+  sel_msg_t *data;
+} sel_store_t;
 
 // Keep track of last Reservation ID
 static int g_rsv_id[MAX_NODES+1];
 
-// Cached version of SEL Header and data
-static sel_hdr_t g_sel_hdr[MAX_NODES+1];
-static sel_msg_t g_sel_data[MAX_NODES+1][SEL_ELEMS_MAX];
+static sel_store_t g_sel[MAX_NODES+1];
+static pthread_mutex_t m_sel = PTHREAD_MUTEX_INITIALIZER;
 
-// Local helper functions to interact with file system
 static int
-file_get_sel_hdr(int node) {
-  FILE *fp;
-  char fpath[SIZE_PATH_MAX] = {0};
+seq_to_rec_id(uint32_t seq) {
+  return (seq % SEL_RECID_SPAN) + SEL_RECID_MIN;
+}
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+// Map a record ID to its sequence number, O(1) since retained records have
+// consecutive sequence numbers
+static int
+rec_id_to_seq(int node, int rec_id, uint32_t *seq) {
+  sel_store_t *sel = &g_sel[node];
+  uint32_t off;
 
-  fp = fopen(fpath, "r");
-  if (fp == NULL) {
+  if (sel->first == sel->next) {
     return -1;
   }
 
-  if (fread(&g_sel_hdr[node], sizeof(sel_hdr_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_get_sel_hdr: fread\n");
-    fclose (fp);
+  if (rec_id == SEL_RECID_FIRST) {
+    *seq = sel->first;
+    return 0;
+  }
+  if (rec_id == SEL_RECID_LAST) {
+    *seq = sel->next - 1;
+    return 0;
+  }
+  if (rec_id < SEL_RECID_MIN || rec_id > SEL_RECID_SPAN) {
     return -1;
   }
 
-  fclose(fp);
+  off = (rec_id - seq_to_rec_id(sel->first) + SEL_RECID_SPAN) % SEL_RECID_SPAN;
+  if (off >= sel->next - sel->first) {
+    return -1;
+  }
+
+  *seq = sel->first + off;
   return 0;
 }
 
+static void
+file_seg_path(char *fpath, int node, uint32_t segno) {
+  snprintf(fpath, SIZE_PATH_MAX, SEL_SEG_FILE, node, segno);
+}
+
 static int
-file_get_sel_data(int node) {
-  FILE *fp;
-  int i, j;
+file_store_meta(int node) {
+  sel_meta_t meta;
   char fpath[SIZE_PATH_MAX] = {0};
+  char tpath[SIZE_PATH_MAX] = {0};
+  int fd;
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+  meta.magic = SEL_HDR_MAGIC;
+  meta.version = SEL_HDR_VERSION;
+  meta.next = g_sel[node].next;
+  memcpy(meta.ts_erase.ts, g_sel[node].ts_erase.ts, 0x04);
 
-  fp = fopen(fpath, "r");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_get_sel_data: fopen\n");
+  snprintf(fpath, sizeof(fpath), SEL_META_FILE, node);
+  snprintf(tpath, sizeof(tpath), SEL_META_TMP, node);
+
+  fd = open(tpath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "file_store_meta: open %s\n", tpath);
     return -1;
   }
 
-  if (fseek(fp, SEL_DATA_OFFSET, SEEK_SET)) {
-    syslog(LOG_WARNING, "file_get_sel_data: fseek\n");
-    fclose(fp);
+  if (write(fd, &meta, sizeof(meta)) != sizeof(meta) || fsync(fd)) {
+    syslog(LOG_WARNING, "file_store_meta: write %s\n", tpath);
+    close(fd);
+    unlink(tpath);
     return -1;
   }
+  close(fd);
 
-  unsigned char buf[SEL_ELEMS_MAX * 16];
-  if (fread(buf, 1, SEL_ELEMS_MAX * sizeof(sel_msg_t), fp) <= 0) {
-    syslog(LOG_WARNING, "file_get_sel_data: fread\n");
-    fclose(fp);
+  if (rename(tpath, fpath)) {
+    syslog(LOG_WARNING, "file_store_meta: rename %s\n", fpath);
+    unlink(tpath);
     return -1;
   }
 
-  fclose(fp);
+  return 0;
+}
 
-  for (i = 0; i < SEL_ELEMS_MAX; i++) {
-    for (j = 0; j < sizeof(sel_msg_t);j++) {
-      g_sel_data[node][i].msg[j] = buf[i*16 + j];
-    }
+static int
+file_get_meta(int node, sel_meta_t *meta) {
+  char fpath[SIZE_PATH_MAX] = {0};
+  int fd, ret = -1;
+
+  snprintf(fpath, sizeof(fpath), SEL_META_FILE, node);
+
+  fd = open(fpath, O_RDONLY);
+  if (fd < 0) {
+    return -1;
   }
 
-  return 0;
+  if (read(fd, meta, sizeof(*meta)) == sizeof(*meta) &&
+      meta->magic == SEL_HDR_MAGIC && meta->version == SEL_HDR_VERSION) {
+    ret = 0;
+  }
+  close(fd);
+
+  return ret;
 }
 
+// Open the segment the next record goes to. A new segment drops the oldest
+// one once SEL_SEGS_MAX segments exist, the remaining data is untouched.
 static int
-file_store_sel_hdr(int node) {
-  FILE *fp;
+file_open_seg(int node) {
+  sel_store_t *sel = &g_sel[node];
+  sel_seg_hdr_t hdr;
   char fpath[SIZE_PATH_MAX] = {0};
+  uint32_t segno = SEL_SEG_NUM(sel->next);
+  uint32_t oldest;
+
+  if (sel->fd >= 0) {
+    if (sel->next % SEL_SEG_RECORDS) {
+      return 0;
+    }
+    close(sel->fd);
+    sel->fd = -1;
+  }
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+  file_seg_path(fpath, node, segno);
 
-  fp = fopen(fpath, "r+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_store_sel_hdr: fopen\n");
+  if (sel->next % SEL_SEG_RECORDS) {
+    sel->fd = open(fpath, O_WRONLY | O_APPEND);
+    if (sel->fd < 0) {
+      syslog(LOG_WARNING, "file_open_seg: open %s\n", fpath);
+      return -1;
+    }
+    return 0;
+  }
+
+  while (sel->first != sel->next &&
+         segno - SEL_SEG_NUM(sel->first) >= SEL_SEGS_MAX) {
+    char opath[SIZE_PATH_MAX] = {0};
+
+    oldest = SEL_SEG_NUM(sel->first);
+    syslog(LOG_WARNING, "sel_add_entry: SEL rollover\n");
+    file_seg_path(opath, node, oldest);
+    unlink(opath);
+    sel->first = (oldest + 1) * SEL_SEG_RECORDS;
+  }
+
+  sel->fd = open(fpath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (sel->fd < 0) {
+    syslog(LOG_WARNING, "file_open_seg: create %s\n", fpath);
     return -1;
   }
 
-  if (fwrite(&g_sel_hdr[node], sizeof(sel_hdr_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_store_sel_hdr: fwrite\n");
-    fclose(fp);
+  hdr.magic = SEL_HDR_MAGIC;
+  hdr.version = SEL_HDR_VERSION;
+  hdr.seq = segno * SEL_SEG_RECORDS;
+  hdr.reserved = 0;
+  if (write(sel->fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+    syslog(LOG_WARNING, "file_open_seg: write %s\n", fpath);
+    close(sel->fd);
+    sel->fd = -1;
+    unlink(fpath);
     return -1;
   }
 
-  fclose(fp);
+  return 0;
+}
+
+// Append one record to the store
+static int
+file_append_sel_data(int node, sel_msg_t *msg) {
+  sel_store_t *sel = &g_sel[node];
+  ssize_t n;
+
+  if (file_open_seg(node)) {
+    return -1;
+  }
+
+  n = write(sel->fd, msg->msg, sizeof(sel_msg_t));
+  if (n != sizeof(sel_msg_t)) {
+    syslog(LOG_WARNING, "file_append_sel_data: write\n");
+    // Drop a torn record so the following appends stay aligned
+    if (n > 0 && ftruncate(sel->fd, SEL_SEG_OFFSET(sel->next))) {
+      close(sel->fd);
+      sel->fd = -1;
+    }
+    return -1;
+  }
+
+  memcpy(sel->data[sel->next % SEL_RECORDS_MAX].msg, msg->msg, sizeof(sel_msg_t));
+  sel->next++;
 
   return 0;
 }
 
+// Remove every segment of the node
+static void
+file_remove_segs(int node) {
+  char dpath[SIZE_PATH_MAX] = {0};
+  char fpath[SIZE_PATH_MAX + 256] = {0};
+  struct dirent *ent;
+  unsigned int segno;
+  char c;
+  DIR *dir;
+
+  snprintf(dpath, sizeof(dpath), SEL_LOG_DIR, node);
+  dir = opendir(dpath);
+  if (dir == NULL) {
+    return;
+  }
+
+  while ((ent = readdir(dir)) != NULL) {
+    if (sscanf(ent->d_name, "%8x.se%c", &segno, &c) == 2 && c == 'g') {
+      snprintf(fpath, sizeof(fpath), "%s/%s", dpath, ent->d_name);
+      unlink(fpath);
+    }
+  }
+  closedir(dir);
+}
+
 static int
-file_store_sel_data(int node, int recId, sel_msg_t *data) {
-  FILE *fp;
-  int index;
+cmp_segno(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+// Load one segment in to the ring, returns the number of records or -1.
+// A torn record at the tail is cut off.
+static int
+file_load_seg(int node, uint32_t segno, time_t *mtime) {
+  sel_seg_hdr_t hdr;
+  struct stat st;
   char fpath[SIZE_PATH_MAX] = {0};
+  uint32_t seq = segno * SEL_SEG_RECORDS;
+  int fd, i, cnt;
 
-  sprintf(fpath, SEL_LOG_FILE, node);
+  file_seg_path(fpath, node, segno);
 
-  fp = fopen(fpath, "r+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "file_store_sel_data: fopen\n");
+  fd = open(fpath, O_RDWR);
+  if (fd < 0) {
     return -1;
   }
 
-  // Records are stored using zero-based index
-  index = (recId-1) * sizeof(sel_msg_t);
-
-  if (fseek(fp, SEL_DATA_OFFSET+index, SEEK_SET)) {
-    syslog(LOG_WARNING, "file_store_sel_data: fseek\n");
-    fclose(fp);
+  if (fstat(fd, &st) || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+      hdr.magic != SEL_HDR_MAGIC || hdr.version != SEL_HDR_VERSION ||
+      hdr.seq != seq) {
+    syslog(LOG_WARNING, "file_load_seg: invalid segment %s\n", fpath);
+    close(fd);
     return -1;
   }
 
-  if (fwrite(data->msg, sizeof(sel_msg_t), 1, fp) <= 0) {
-    syslog(LOG_WARNING, "file_store_sel_data: fwrite\n");
-    fclose(fp);
+  cnt = (st.st_size - sizeof(hdr)) / sizeof(sel_msg_t);
+  if (cnt > SEL_SEG_RECORDS) {
+    cnt = SEL_SEG_RECORDS;
+  }
+  if (st.st_size != SEL_SEG_OFFSET(seq) + cnt * sizeof(sel_msg_t) &&
+      cnt < SEL_SEG_RECORDS) {
+    syslog(LOG_WARNING, "file_load_seg: truncating torn record in %s\n", fpath);
+    if (ftruncate(fd, SEL_SEG_OFFSET(seq) + cnt * sizeof(sel_msg_t))) {
+      syslog(LOG_WARNING, "file_load_seg: ftruncate %s\n", fpath);
+    }
+  }
+
+  for (i = 0; i < cnt; i++) {
+    if (read(fd, g_sel[node].data[(seq + i) % SEL_RECORDS_MAX].msg,
+             sizeof(sel_msg_t)) != sizeof(sel_msg_t)) {
+      cnt = i;
+      break;
+    }
+  }
+  close(fd);
+
+  if (mtime != NULL) {
+    *mtime = st.st_mtime;
+  }
+
+  return cnt;
+}
+
+// Rebuild the ring from the newest run of consecutive segments. Only the
+// newest segment may be partially filled, anything older than a gap or a
+// damaged segment is dropped.
+static int
+file_load_sel(int node) {
+  sel_store_t *sel = &g_sel[node];
+  uint32_t segs[SEL_SCAN_MAX];
+  char dpath[SIZE_PATH_MAX] = {0};
+  char fpath[SIZE_PATH_MAX] = {0};
+  struct dirent *ent;
+  unsigned int segno;
+  int nsegs = 0, i, cnt, kept;
+  time_t mtime = 0;
+  uint32_t ts;
+  char c;
+  DIR *dir;
+
+  snprintf(dpath, sizeof(dpath), SEL_LOG_DIR, node);
+  dir = opendir(dpath);
+  if (dir == NULL) {
+    syslog(LOG_WARNING, "file_load_sel: opendir %s\n", dpath);
     return -1;
   }
 
-  fclose(fp);
+  while ((ent = readdir(dir)) != NULL && nsegs < SEL_SCAN_MAX) {
+    if (sscanf(ent->d_name, "%8x.se%c", &segno, &c) == 2 && c == 'g') {
+      segs[nsegs++] = segno;
+    }
+  }
+  closedir(dir);
+
+  if (nsegs == 0) {
+    return 0;
+  }
+
+  qsort(segs, nsegs, sizeof(uint32_t), cmp_segno);
+
+  kept = 0;
+  for (i = nsegs - 1; i >= 0; i--) {
+    if (kept) {
+      if (kept == SEL_SEGS_MAX || segs[i] + 1 != segs[i+1]) {
+        break;
+      }
+      cnt = file_load_seg(node, segs[i], NULL);
+      if (cnt != SEL_SEG_RECORDS) {
+        break;
+      }
+      sel->first = segs[i] * SEL_SEG_RECORDS;
+    } else {
+      cnt = file_load_seg(node, segs[i], &mtime);
+      if (cnt < 0) {
+        file_seg_path(fpath, node, segs[i]);
+        unlink(fpath);
+        continue;
+      }
+      sel->first = segs[i] * SEL_SEG_RECORDS;
+      sel->next = sel->first + cnt;
+    }
+    kept++;
+  }
+
+  for (; i >= 0; i--) {
+    file_seg_path(fpath, node, segs[i]);
+    unlink(fpath);
+  }
+
+  if (kept && mtime) {
+    ts = (uint32_t) mtime;
+    sel->ts_add.ts[0] = ts & 0xFF;
+    sel->ts_add.ts[1] = (ts >> 8) & 0xFF;
+    sel->ts_add.ts[2] = (ts >> 16) & 0xFF;
+    sel->ts_add.ts[3] = (ts >> 24) & 0xFF;
+  }
 
   return 0;
 }
 
+// Append the records of an old sel%d.bin, then remove it
+static void
+file_import_legacy(int node) {
+  sel_store_t *sel = &g_sel[node];
+  sel_legacy_hdr_t hdr;
+  sel_msg_t data[SEL_LEGACY_ELEMS];
+  char fpath[SIZE_PATH_MAX] = {0};
+  FILE *fp;
+  int i, cnt = 0;
+
+  snprintf(fpath, sizeof(fpath), SEL_LEGACY_FILE, node);
+
+  fp = fopen(fpath, "r");
+  if (fp == NULL) {
+    return;
+  }
+
+  // The last slot is only written once the old log has wrapped
+  memset(data, 0, sizeof(data));
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != SEL_HDR_MAGIC ||
+      hdr.version != SEL_LEGACY_VERSION ||
+      hdr.begin < 0 || hdr.begin >= SEL_LEGACY_ELEMS ||
+      hdr.end < 0 || hdr.end >= SEL_LEGACY_ELEMS ||
+      fseek(fp, SEL_LEGACY_OFFSET, SEEK_SET) ||
+      fread(data, sizeof(sel_msg_t), SEL_LEGACY_ELEMS, fp) < SEL_LEGACY_ELEMS - 1) {
+    syslog(LOG_WARNING, "file_import_legacy: invalid %s\n", fpath);
+    fclose(fp);
+    return;
+  }
+  fclose(fp);
+
+  for (i = hdr.begin; i != hdr.end; i = (i + 1) % SEL_LEGACY_ELEMS) {
+    if (file_append_sel_data(node, &data[i])) {
+      syslog(LOG_WARNING, "file_import_legacy: append\n");
+      return;
+    }
+    cnt++;
+  }
+
+  memcpy(sel->ts_add.ts, hdr.ts_add.ts, 0x04);
+  memcpy(sel->ts_erase.ts, hdr.ts_erase.ts, 0x04);
+  if (file_store_meta(node)) {
+    return;
+  }
+
+  unlink(fpath);
+  syslog(LOG_INFO, "file_import_legacy: imported %d records from %s\n", cnt, fpath);
+}
+
 static void
 dump_sel_syslog(int fru, sel_msg_t *data) {
   int i = 0;
@@ -331,187 +661,185 @@ parse_sel(uint8_t fru, sel_msg_t *data) {
 // Retrieve time stamp for recent add operation
 void
 sel_ts_recent_add(int node, time_stamp_t *ts) {
-  memcpy(ts->ts, g_sel_hdr[node].ts_add.ts, 0x04);
+  pthread_mutex_lock(&m_sel);
+  memcpy(ts->ts, g_sel[node].ts_add.ts, 0x04);
+  pthread_mutex_unlock(&m_sel);
 }
 
 // Retrieve time stamp for recent erase operation
 void
 sel_ts_recent_erase(int node, time_stamp_t *ts) {
-  memcpy(ts->ts, g_sel_hdr[node].ts_erase.ts, 0x04);
+  pthread_mutex_lock(&m_sel);
+  memcpy(ts->ts, g_sel[node].ts_erase.ts, 0x04);
+  pthread_mutex_unlock(&m_sel);
 }
 
 // Retrieve total number of entries in SEL log
 int
 sel_num_entries(int node) {
-  if (g_sel_hdr[node].begin <= g_sel_hdr[node].end) {
-      return (g_sel_hdr[node].end - g_sel_hdr[node].begin);
-  } else {
-    return (g_sel_hdr[node].end + (SEL_INDEX_MAX - g_sel_hdr[node].begin + 1));
-  }
+  int num;
+
+  pthread_mutex_lock(&m_sel);
+  num = g_sel[node].next - g_sel[node].first;
+  pthread_mutex_unlock(&m_sel);
+
+  return num;
 }
 
 // Retrieve total free space available in SEL log
+// The SEL Info response only has 16 bits for it, so clamp to 0xFFFF
 int
 sel_free_space(int node) {
-  int total_space;
-  int used_space;
+  int free_space;
 
-  total_space = SEL_RECORDS_MAX * sizeof(sel_msg_t);
-  used_space = sel_num_entries(node) * sizeof(sel_msg_t);
+  free_space = (SEL_RECORDS_MAX - sel_num_entries(node)) * sizeof(sel_msg_t);
+  if (free_space > 0xFFFF) {
+    free_space = 0xFFFF;
+  }
 
-  return (total_space - used_space);
+  return free_space;
 }
 
 // Reserve an ID that will be used in later operations
 // IPMI/Section 31.4
 int
 sel_rsv_id(int node) {
+  int rsv_id;
+
+  pthread_mutex_lock(&m_sel);
   // Increment the current reservation ID and return
   if (g_rsv_id[node]++ == SEL_RSVID_MAX) {
     g_rsv_id[node] = SEL_RSVID_MIN;
   }
+  rsv_id = g_rsv_id[node];
+  pthread_mutex_unlock(&m_sel);
 
-  return g_rsv_id[node];
+  return rsv_id;
 }
 
-// Get the SEL entry for a given record ID
-// IPMI/Section 31.5
+// Get up to max SEL entries starting at a given record ID
+// Returns the record ID following the last one copied in next_rec_id,
+// 0xFFFF once the end of the log is reached
 int
-sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id) {
-
-  int index;
+sel_get_entries(int node, int read_rec_id, sel_msg_t *msgs, int max,
+                int *count, int *next_rec_id) {
+  sel_store_t *sel = &g_sel[node];
+  uint32_t seq;
+  int i;
 
-  // Find the index in to array based on given index
-  if (read_rec_id == SEL_RECID_FIRST) {
-    index = g_sel_hdr[node].begin;
-  } else if (read_rec_id == SEL_RECID_LAST) {
-    if (g_sel_hdr[node].end) {
-      index = g_sel_hdr[node].end - 1;
-    } else {
-      index = SEL_INDEX_MAX;
-    }
-  } else {
-    index = read_rec_id;
-  }
+  pthread_mutex_lock(&m_sel);
 
   // If the log is empty return error
-  if (sel_num_entries(node) == 0) {
+  if (sel->first == sel->next) {
+    pthread_mutex_unlock(&m_sel);
     syslog(LOG_WARNING, "sel_get_entry: No entries\n");
     return -1;
   }
 
-  // Check for boundary conditions
-  if ((index < SEL_INDEX_MIN) || (index > SEL_INDEX_MAX)) {
+  if (rec_id_to_seq(node, read_rec_id, &seq)) {
+    pthread_mutex_unlock(&m_sel);
     syslog(LOG_WARNING, "sel_get_entry: Invalid Record ID %d\n", read_rec_id);
     return -1;
   }
 
-  // If begin < end, check to make sure the given id falls between
-  if (g_sel_hdr[node].begin < g_sel_hdr[node].end) {
-    if (index < g_sel_hdr[node].begin || index >= g_sel_hdr[node].end) {
-      syslog(LOG_WARNING, "sel_get_entry: Wrong Record ID %d\n", read_rec_id);
-      return -1;
-    }
+  for (i = 0; i < max && seq < sel->next; i++, seq++) {
+    memcpy(msgs[i].msg, sel->data[seq % SEL_RECORDS_MAX].msg, sizeof(sel_msg_t));
   }
 
-  // If end < begin, check to make sure the given id is valid
-  if (g_sel_hdr[node].begin > g_sel_hdr[node].end) {
-    if (index >= g_sel_hdr[node].end && index < g_sel_hdr[node].begin) {
-      syslog(LOG_WARNING, "sel_get_entry: Wrong Record ID2 %d\n", read_rec_id);
-      return -1;
-    }
-  }
-
-  memcpy(msg->msg, g_sel_data[node][index].msg, sizeof(sel_msg_t));
-
-  // Return the next record ID in the log
-  *next_rec_id = ++read_rec_id;
-  if (*next_rec_id > SEL_INDEX_MAX) {
-    *next_rec_id = SEL_INDEX_MIN;
-  }
+  *count = i;
 
   // If this is the last entry in the log, return 0xFFFF
-  if (*next_rec_id == g_sel_hdr[node].end) {
-    *next_rec_id = SEL_RECID_LAST;
-  }
+  *next_rec_id = (seq == sel->next) ? SEL_RECID_LAST : seq_to_rec_id(seq);
+
+  pthread_mutex_unlock(&m_sel);
 
   return 0;
 }
 
+// Get the SEL entry for a given record ID
+// IPMI/Section 31.5
+int
+sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id) {
+  int count;
+
+  return sel_get_entries(node, read_rec_id, msg, 1, &count, next_rec_id);
+}
+
 // Add a new entry in to SEL log
 // IPMI/Section 31.6
 int
 sel_add_entry(int node, sel_msg_t *msg, int *rec_id) {
-  // If the SEL if full, roll over. To keep track of empty condition, use
-  // one empty location less than the max records.
-  if (sel_num_entries(node) == SEL_RECORDS_MAX) {
-      syslog(LOG_WARNING, "sel_add_entry: SEL rollover\n");
-    if (++g_sel_hdr[node].begin > SEL_INDEX_MAX) {
-      g_sel_hdr[node].begin = SEL_INDEX_MIN;
-    }
-  }
+  sel_store_t *sel = &g_sel[node];
 
   // Update message's time stamp starting at byte 4
   if (msg->msg[2] < 0xE0)
     time_stamp_fill(&msg->msg[3]);
 
-  // Add the enry at end
-  memcpy(g_sel_data[node][g_sel_hdr[node].end].msg, msg->msg, sizeof(sel_msg_t));
-
-  // Return the newly added record ID
-  *rec_id = g_sel_hdr[node].end+1;
-
   // Print the data in syslog
   dump_sel_syslog(node, msg);
 
   // Parse the SEL message
   parse_sel((uint8_t) node, msg);
 
-  if (file_store_sel_data(node, *rec_id, msg)) {
-    syslog(LOG_WARNING, "sel_add_entry: file_store_sel_data\n");
+  pthread_mutex_lock(&m_sel);
+
+  if (sel->data == NULL || file_append_sel_data(node, msg)) {
+    pthread_mutex_unlock(&m_sel);
+    syslog(LOG_WARNING, "sel_add_entry: file_append_sel_data\n");
     return -1;
   }
 
-  // Increment the end pointer
-  if (++g_sel_hdr[node].end > SEL_INDEX_MAX) {
-    g_sel_hdr[node].end = SEL_INDEX_MIN;
-  }
+  // Return the newly added record ID
+  *rec_id = seq_to_rec_id(sel->next - 1);
 
-  // Update timestamp for add in header
-  time_stamp_fill(g_sel_hdr[node].ts_add.ts);
+  // Update timestamp for add, recovered from the segment mtime at init
+  time_stamp_fill(sel->ts_add.ts);
 
-  // Store the structure persistently
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "sel_add_entry: file_store_sel_hdr\n");
-    return -1;
-  }
+  pthread_mutex_unlock(&m_sel);
 
   return 0;
 }
 
 // Erase the SEL completely
 // IPMI/Section 31.9
-// Note: To reduce wear/tear, instead of erasing, manipulating the metadata
+// Note: Segments are unlinked, record numbering continues from the next
+// segment so IDs handed out before the erase are not reused right away
 int
 sel_erase(int node, int rsv_id) {
+  sel_store_t *sel = &g_sel[node];
+  int ret = 0;
+
+  pthread_mutex_lock(&m_sel);
+
   if (rsv_id != g_rsv_id[node]) {
+    pthread_mutex_unlock(&m_sel);
     return -1;
   }
 
+  if (sel->fd >= 0) {
+    close(sel->fd);
+    sel->fd = -1;
+  }
+
   // Erase SEL Logs
-  g_sel_hdr[node].begin = SEL_INDEX_MIN;
-  g_sel_hdr[node].end = SEL_INDEX_MIN;
+  file_remove_segs(node);
+  if (sel->next % SEL_SEG_RECORDS) {
+    sel->next = (SEL_SEG_NUM(sel->next) + 1) * SEL_SEG_RECORDS;
+  }
+  sel->first = sel->next;
 
-  // Update timestamp for erase in header
-  time_stamp_fill(g_sel_hdr[node].ts_erase.ts);
+  // Update timestamp for erase
+  time_stamp_fill(sel->ts_erase.ts);
 
-  // Store the structure persistently
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "sel_erase: file_store_sel_hdr\n");
-    return -1;
+  // Store the numbering and erase time persistently
+  if (file_store_meta(node)) {
+    syslog(LOG_WARNING, "sel_erase: file_store_meta\n");
+    ret = -1;
   }
 
-  return 0;
+  pthread_mutex_unlock(&m_sel);
+
+  return ret;
 }
 
 // To get the erase status while erase happens
@@ -519,73 +847,58 @@ sel_erase(int node, int rsv_id) {
 // Note: Since we are not doing offline erasing, need not return in-progress state
 int
 sel_erase_status(int node, int rsv_id, sel_erase_stat_t *status) {
+  int ret = 0;
+
+  pthread_mutex_lock(&m_sel);
   if (rsv_id != g_rsv_id[node]) {
-    return -1;
+    ret = -1;
+  } else {
+    // Since we do not do any offline erasing, always return erase done
+    *status = SEL_ERASE_DONE;
   }
+  pthread_mutex_unlock(&m_sel);
 
-  // Since we do not do any offline erasing, always return erase done
-  *status = SEL_ERASE_DONE;
-
-  return 0;
+  return ret;
 }
 
-// Initialize SEL log file
+// Initialize SEL store of a node
 static int
 sel_node_init(int node) {
-  FILE *fp;
-  int i;
-  char fpath[SIZE_PATH_MAX] = {0};
-
-  sprintf(fpath, SEL_LOG_FILE, node);
+  sel_store_t *sel = &g_sel[node];
+  sel_meta_t meta;
+  char dpath[SIZE_PATH_MAX] = {0};
 
-  // Check if the file exists or not
-  if (access(fpath, F_OK) == 0) {
-    // Since file is present, fetch all the contents to cache
-    if (file_get_sel_hdr(node)) {
-      syslog(LOG_WARNING, "init_sel: file_get_sel_hdr\n");
-      return -1;
-    }
-
-    if (file_get_sel_data(node)) {
-      syslog(LOG_WARNING, "init_sel: file_get_sel_data\n");
-      return -1;
-    }
+  memset(sel, 0, sizeof(sel_store_t));
+  sel->fd = -1;
+  g_rsv_id[node] = 0x01;
 
-    return 0;
+  sel->data = calloc(SEL_RECORDS_MAX, sizeof(sel_msg_t));
+  if (sel->data == NULL) {
+    syslog(LOG_WARNING, "init_sel: calloc\n");
+    return -1;
   }
 
-  // File not present, so create the file
-  fp = fopen(fpath, "w+");
-  if (fp == NULL) {
-    syslog(LOG_WARNING, "init_sel: fopen\n");
+  snprintf(dpath, sizeof(dpath), SEL_LOG_DIR, node);
+  if (mkdir(dpath, 0755) && errno != EEXIST) {
+    syslog(LOG_WARNING, "init_sel: mkdir %s\n", dpath);
     return -1;
   }
 
-  fclose (fp);
-
-  // Populate SEL Header in to the file
-  g_sel_hdr[node].magic = SEL_HDR_MAGIC;
-  g_sel_hdr[node].version = SEL_HDR_VERSION;
-  g_sel_hdr[node].begin = SEL_INDEX_MIN;
-  g_sel_hdr[node].end = SEL_INDEX_MIN;
-  memset(g_sel_hdr[node].ts_add.ts, 0x0, 4);
-  memset(g_sel_hdr[node].ts_erase.ts, 0x0, 4);
-
-  if (file_store_sel_hdr(node)) {
-    syslog(LOG_WARNING, "init_sel: file_store_sel_hdr\n");
+  if (file_load_sel(node)) {
+    syslog(LOG_WARNING, "init_sel: file_load_sel\n");
     return -1;
   }
 
-  // Populate SEL Data in to the file
-  for (i = 1;  i <= SEL_RECORDS_MAX; i++) {
-    sel_msg_t msg = {0};
-    if (file_store_sel_data(node, i, &msg)) {
-      syslog(LOG_WARNING, "init_sel: file_store_sel_data\n");
-      return -1;
+  // Numbering continues after an erase even with no segment left
+  if (!file_get_meta(node, &meta)) {
+    memcpy(sel->ts_erase.ts, meta.ts_erase.ts, 0x04);
+    if (meta.next > sel->next) {
+      file_remove_segs(node);
+      sel->first = sel->next = meta.next;
     }
   }
 
-  g_rsv_id[node] = 0x01;
+  file_import_legacy(node);
 
   return 0;
 }
@@ -595,12 +908,14 @@ sel_init(void) {
   int ret;
   int i;
 
+  pthread_mutex_lock(&m_sel);
   for (i = 1; i < MAX_NODES+1; i++) {
     ret = sel_node_init(i);
     if (ret) {
-      return ret;
+      break;
     }
   }
+  pthread_mutex_unlock(&m_sel);
 
   return ret;
 }
@@ -43,6 +43,8 @@ int sel_num_entries(int node);
 int sel_free_space(int node);
 int sel_rsv_id(int node);
 int sel_get_entry(int node, int read_rec_id, sel_msg_t *msg, int *next_rec_id);
+int sel_get_entries(int node, int read_rec_id, sel_msg_t *msgs, int max,
+                    int *count, int *next_rec_id);
 int sel_add_entry(int node, sel_msg_t *msg, int *rec_id);
 int sel_erase(int node, int rsv_id);
 int sel_erase_status(int node, int rsv_id, sel_erase_stat_t *status);
@@ -0,0 +1,274 @@
+/*
+ *
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * SEL store test and benchmark, with the store under SEL_TEST_DIR
+ * instead of /mnt/data. Put SEL_TEST_DIR on the file system to be
+ * measured; /tmp is usually a tmpfs.
+ *
+ *   sel-test                 store tests, then the benchmark
+ *   sel-test <adds>          benchmark only, adding that many records
+ *
+ * "make SEL_OLD=<sel.c>" builds the add benchmark against another sel.c
+ * with its /mnt/data paths moved under SEL_TEST_DIR, e.g. the single file
+ * SEL from before the segment store, for a comparison. Walks are left out
+ * there, the single file SEL does not chain record IDs once it wrapped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "sel.h"
+
+#define NODE 1
+#define SEG_RECORDS 1024
+#define SEGS_MAX 24
+#define BULK_MAX 12
+
+static int failures = 0;
+
+/* The platform hooks run on every add; nothing to parse here */
+int pal_get_event_sensor_name(uint8_t fru, uint8_t *sel, char *name) { name[0] = '\0'; return 0; }
+int pal_parse_sel(uint8_t fru, uint8_t *sel, char *error_log) { error_log[0] = '\0'; return 1; }
+int pal_sel_handler(uint8_t fru, uint8_t snr_num, uint8_t *event_data) { return 0; }
+int pal_parse_oem_sel(uint8_t fru, uint8_t *sel, char *error_log) { error_log[0] = '\0'; return 0; }
+void pal_update_ts_sled(void) { }
+
+static double
+now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* OEM record without a time stamp, carrying val */
+static void
+make_msg(sel_msg_t *msg, uint32_t val) {
+  memset(msg, 0, sizeof(*msg));
+  msg->msg[2] = 0xE0;
+  memcpy(&msg->msg[3], &val, sizeof(val));
+}
+
+static void
+reset_store(void) {
+  if (system("rm -rf " SEL_TEST_DIR " && mkdir -p " SEL_TEST_DIR) != 0)
+    printf("cannot reset " SEL_TEST_DIR "\n");
+}
+
+static int
+add_range(uint32_t first, int n) {
+  sel_msg_t msg;
+  int i, id;
+
+  for (i = 0; i < n; i++) {
+    make_msg(&msg, first + i);
+    if (sel_add_entry(NODE, &msg, &id))
+      return -1;
+  }
+  return 0;
+}
+
+#ifndef SEL_OLD
+static uint32_t
+msg_val(sel_msg_t *msg) {
+  uint32_t val;
+
+  memcpy(&val, &msg->msg[3], sizeof(val));
+  return val;
+}
+
+static void
+check(bool passed, const char *what) {
+  printf("%-48s %s\n", what, passed ? "PASSED" : "FAILED");
+  if (!passed)
+    failures++;
+}
+
+/*
+ * Walk the SEL with Get SEL Entry from the first record. Returns the
+ * records found and sets first and last to the values of the first and last
+ * record; -1 if a lookup failed or the values are not consecutive.
+ */
+static int
+walk(uint32_t *first, uint32_t *last) {
+  sel_msg_t msg;
+  int id = 0, next, cnt = 0;
+
+  while (sel_get_entry(NODE, id, &msg, &next) == 0) {
+    if (cnt == 0)
+      *first = msg_val(&msg);
+    else if (msg_val(&msg) != *last + 1)
+      return -1;
+    *last = msg_val(&msg);
+    cnt++;
+    if (next == 0xFFFF)
+      return cnt;
+    id = next;
+  }
+  return -1;
+}
+
+/* The same walk with Get SEL Entries; returns the requests made */
+static int
+walk_bulk(int *count, uint32_t *last) {
+  sel_msg_t msgs[BULK_MAX];
+  int id = 0, next, cnt, i, reqs = 0;
+
+  *count = 0;
+  while (sel_get_entries(NODE, id, msgs, BULK_MAX, &cnt, &next) == 0) {
+    reqs++;
+    for (i = 0; i < cnt; i++) {
+      if (*count > 0 && msg_val(&msgs[i]) != *last + 1)
+        return -1;
+      *last = msg_val(&msgs[i]);
+      (*count)++;
+    }
+    if (next == 0xFFFF)
+      return reqs;
+    id = next;
+  }
+  return -1;
+}
+
+/* sel%d.bin as older images wrote it, records 0 to n - 1 */
+static void
+write_legacy(int n) {
+  struct {
+    int magic;
+    int version;
+    int begin;
+    int end;
+    uint8_t ts_add[4];
+    uint8_t ts_erase[4];
+  } hdr = {(int)0xFBFBFBFB, 0x01, 0, n, {0}, {0}};
+  char path[64];
+  sel_msg_t msg;
+  FILE *fp;
+  int i;
+
+  snprintf(path, sizeof(path), SEL_TEST_DIR "/sel%d.bin", NODE);
+  fp = fopen(path, "w");
+  if (fp == NULL)
+    return;
+  fwrite(&hdr, sizeof(hdr), 1, fp);
+  fseek(fp, 0x100, SEEK_SET);
+  for (i = 0; i < 129; i++) {
+    make_msg(&msg, i);
+    fwrite(&msg, sizeof(msg), 1, fp);
+  }
+  fclose(fp);
+}
+
+static void
+test_store(void) {
+  sel_erase_stat_t status;
+  sel_msg_t msg;
+  uint32_t first = 0, last = 0;
+  int id, next, cnt, rsv;
+
+  reset_store();
+  write_legacy(100);
+  check(sel_init() == 0 && sel_num_entries(NODE) == 100 &&
+        access(SEL_TEST_DIR "/sel1.bin", F_OK) != 0, "legacy sel1.bin imported");
+  check(walk(&first, &last) == 100 && first == 0 && last == 99, "legacy records in order");
+
+  check(add_range(100, 1000) == 0 && sel_num_entries(NODE) == 1100, "add");
+  check(sel_get_entry(NODE, 0xFFFF, &msg, &next) == 0 && msg_val(&msg) == 1099 &&
+        next == 0xFFFF, "get last record");
+
+  // Reloaded from the segment files as after a restart
+  check(sel_init() == 0 && walk(&first, &last) == 1100 && last == 1099, "reload");
+
+  // Rotation drops whole segments and keeps numbering
+  check(add_range(1100, SEG_RECORDS * SEGS_MAX) == 0, "add past the retention");
+  cnt = sel_num_entries(NODE);
+  check(cnt > SEG_RECORDS * (SEGS_MAX - 1) && cnt <= SEG_RECORDS * SEGS_MAX &&
+        walk(&first, &last) == cnt && last == 1099 + SEG_RECORDS * SEGS_MAX,
+        "oldest segments rotated out");
+  check(walk_bulk(&id, &last) == (cnt + BULK_MAX - 1) / BULK_MAX && id == cnt,
+        "bulk walk matches");
+  check(sel_free_space(NODE) >= 0 && sel_free_space(NODE) <= 0xFFFF, "free space");
+
+  rsv = sel_rsv_id(NODE);
+  check(sel_erase(NODE, rsv + 1) != 0, "erase with a stale reservation rejected");
+  check(sel_erase(NODE, rsv) == 0 && sel_num_entries(NODE) == 0 &&
+        sel_erase_status(NODE, rsv, &status) == 0 && status == SEL_ERASE_DONE &&
+        sel_get_entry(NODE, 0, &msg, &next) != 0, "erase");
+
+  // Record IDs handed out after an erase do not restart from the first one
+  make_msg(&msg, 7);
+  check(sel_add_entry(NODE, &msg, &id) == 0 && id != 1 && sel_init() == 0 &&
+        sel_num_entries(NODE) == 1 && sel_get_entry(NODE, id, &msg, &next) == 0 &&
+        msg_val(&msg) == 7, "numbering kept over erase and reload");
+}
+#endif
+
+static void
+bench(int adds) {
+  double start, add_s;
+
+  reset_store();
+  if (sel_init()) {
+    printf("sel_init failed\n");
+    failures++;
+    return;
+  }
+
+  start = now();
+  if (add_range(0, adds)) {
+    printf("sel_add_entry failed\n");
+    failures++;
+    return;
+  }
+  add_s = now() - start;
+  printf("%d adds: %.1f us/add, %d retained\n", adds, add_s * 1e6 / adds,
+         sel_num_entries(NODE));
+
+#ifndef SEL_OLD
+  {
+    uint32_t first = 0, last = 0;
+    int cnt, reqs;
+
+    start = now();
+    cnt = walk(&first, &last);
+    printf("walk of %d records: %d requests %.2f ms\n", cnt, cnt, (now() - start) * 1e3);
+    start = now();
+    reqs = walk_bulk(&cnt, &last);
+    printf("bulk walk of %d records: %d requests %.2f ms\n", cnt, reqs,
+           (now() - start) * 1e3);
+  }
+#endif
+}
+
+int
+main(int argc, char **argv) {
+#ifndef SEL_OLD
+  if (argc == 1)
+    test_store();
+#endif
+  bench((argc > 1) ? atoi(argv[1]) : 30000);
+
+  system("rm -rf " SEL_TEST_DIR);
+  printf("SEL: %s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -30,7 +30,11 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <time.h>
 #include <openbmc/pal.h>
+#include <openbmc/kv.h>
 #include <openbmc/sdr.h>
 #include <openbmc/obmc-sensor.h>
 #include <openbmc/fruid.h>
@@ -49,6 +53,21 @@
 #define FRAME_BUFF_SIZE 4096
 #define FRAME_PAGE_BUF_SIZE 256
 
+#define CRI_SEL_DIR  "/mnt/data"
+#define CRI_SEL_FILE "cri_sel"
+#define FRUID_DIR    "/tmp"
+
+// Sources a frame is rendered from
+#define UDBG_SRC_FRU     (1 << 0)
+#define UDBG_SRC_SEL     (1 << 1)
+#define UDBG_SRC_FW      (1 << 2)
+#define UDBG_SRC_POWER   (1 << 3)
+#define UDBG_SRC_THRESH  (1 << 4)
+#define UDBG_SRC_ALL     0xFF
+
+// Re-render age for frames whose sources cannot be watched
+#define UDBG_UNWATCHED_AGE 5
+
 struct frame {
   char title[32];
   size_t max_size;
@@ -392,33 +411,6 @@ static int panelNum = (sizeof(panels)/sizeof(struct ctrl_panel)) - 1;
 
 extern void plat_lan_init(lan_config_t *lan);
 
-static int
-chk_cri_sel_update(uint8_t *cri_sel_up) {
-  FILE *fp;
-  struct stat file_stat;
-  uint8_t pos = plat_get_fru_sel();
-  static uint8_t pre_pos = 0xff;
-
-  fp = fopen("/mnt/data/cri_sel", "r");
-  if (fp) {
-    if ((stat("/mnt/data/cri_sel", &file_stat) == 0) && 
-        (file_stat.st_mtime != frame_sel.mtime || pre_pos != pos)) {
-      *cri_sel_up = 1;
-    } else {
-      *cri_sel_up = 0;
-    }
-    fclose(fp);
-  } else {
-    if (frame_sel.buf == NULL || frame_sel.lines != 0 || pre_pos != pos) {
-      *cri_sel_up = 1;
-    } else {
-      *cri_sel_up = 0;
-    }
-  }
-  pre_pos = pos;
-  return 0;
-}
-
 int
 plat_udbg_get_frame_info(uint8_t *num)
 {
@@ -430,37 +422,6 @@ plat_udbg_get_frame_info(uint8_t *num)
   return 0;
 }
 
-int
-plat_udbg_get_updated_frames(uint8_t *count, uint8_t *buffer) {
-  uint8_t cri_sel_up = 0;
-  uint8_t info_page_up = 1;
-
-  if (!plat_supported()) {
-    return -1;
-  }
-
-  *count = 0;
-
-  // info page update
-  if (info_page_up == 1) {
-    buffer[*count] = 1;
-    *count += 1;
-  }
-
-  // cri sel update
-  chk_cri_sel_update(&cri_sel_up);
-  if (cri_sel_up == 1) {
-    buffer[*count] = 2;
-    *count += 1;
-  }
-
-  // cri sensor update
-  buffer[*count] = 3;
-  *count += 1;
-
-  return 0;
-}
-
 int
 plat_udbg_get_post_desc(uint8_t index, uint8_t *next, uint8_t phase,  uint8_t *end, uint8_t *length, uint8_t *buffer) {
   int target, pdesc_size;
@@ -568,165 +529,189 @@ plat_udbg_get_gpio_desc(uint8_t index, uint8_t *next, uint8_t *level, uint8_t *d
 }
 
 static int
-udbg_get_cri_sel(uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
+udbg_render_cri_sel(uint8_t pos) {
   int len;
-  int ret;
   char line_buff[FRAME_PAGE_BUF_SIZE], *ptr;
   FILE *fp;
-  struct stat file_stat;
-  uint8_t pos = plat_get_fru_sel();
-  static uint8_t pre_pos = FRU_ALL;
-  bool pos_changed = pre_pos != pos;
- 
-  pre_pos = pos;
-
-  fp = fopen("/mnt/data/cri_sel", "r");
-  if (fp) {
-    if ((stat("/mnt/data/cri_sel", &file_stat) == 0) && 
-				(file_stat.st_mtime != frame_sel.mtime || pos_changed)) {
-      // initialize and clear frame
-      frame_sel.init(&frame_sel, FRAME_BUFF_SIZE);
-      frame_sel.overwrite = 1;
-      frame_sel.max_page = 20;
-      frame_sel.mtime = file_stat.st_mtime;
-      snprintf(frame_sel.title, 32, "Cri SEL");
-
-      while (fgets(line_buff, FRAME_PAGE_BUF_SIZE, fp)) {
-        // Remove newline
-        line_buff[strlen(line_buff)-1] = '\0';
-        ptr = line_buff;
-        // Find message
-        ptr = strstr(ptr, "local0.err");
-        if (!ptr || (ptr = strstr(ptr, ":")) == NULL) {
+
+  // initialize and clear frame
+  frame_sel.init(&frame_sel, FRAME_BUFF_SIZE);
+  frame_sel.overwrite = 1;
+  frame_sel.max_page = 20;
+  snprintf(frame_sel.title, 32, "Cri SEL");
+
+  fp = fopen(CRI_SEL_DIR "/" CRI_SEL_FILE, "r");
+  if (fp == NULL) {
+    // Title only
+    return 0;
+  }
+
+  while (fgets(line_buff, FRAME_PAGE_BUF_SIZE, fp)) {
+    // Remove newline
+    line_buff[strlen(line_buff)-1] = '\0';
+    ptr = line_buff;
+    // Find message
+    ptr = strstr(ptr, "local0.err");
+    if (!ptr || (ptr = strstr(ptr, ":")) == NULL) {
+      continue;
+    }
+    len = strlen(ptr);
+    if (len > 2) {
+      // Check if FRU specific information
+      char *fptr = ptr;
+      fptr = strstr(fptr, ",FRU:");
+      if (fptr) {
+        if ((fptr[5]-'0') != pos)
           continue;
-        }
-        len = strlen(ptr);
-        if (len > 2) {
-					// Check if FRU specific information
-          char *fptr = ptr;
-          fptr = strstr(fptr, ",FRU:");
-          if (fptr) {
-            if ((fptr[5]-'0') != pos)
-              continue;
-            // Remove ',FRU:X' from the string.
-            *fptr = '\0';
-          }
-          ptr += 2;
-        }
-        // Write new message
-        frame_sel.insert(&frame_sel, ptr, 0);
+        // Remove ',FRU:X' from the string.
+        *fptr = '\0';
       }
+      ptr += 2;
     }
-    fclose(fp);
-  } else {
-    // Title only
-    frame_sel.init(&frame_sel, FRAME_BUFF_SIZE);
-    snprintf(frame_sel.title, 32, "Cri SEL");
-    frame_sel.mtime = 0;
+    // Write new message
+    frame_sel.insert(&frame_sel, ptr, 0);
   }
+  fclose(fp);
 
-  if (page > frame_sel.pages) {
-    return -1;
+  return 0;
+}
+
+static thresh_sensor_t *snr_thresh;
+static int *snr_thresh_sts;
+static size_t snr_thresh_cnt;
+static bool snr_thresh_valid;
+
+static uint8_t
+cri_sensor_fru(sensor_desc_t *snr, uint8_t pos) {
+  return snr->fru == FRU_ALL ? pos : snr->fru;
+}
+
+// Load the thresholds of all critical sensors, one SDR pass per FRU
+static void
+udbg_load_cri_thresh(uint8_t pos, sensor_desc_t *cri_sensor, size_t sensor_count) {
+  uint8_t snr_list[sensor_count];
+  int idx[sensor_count], sts[sensor_count];
+  thresh_sensor_t thresh[sensor_count];
+  bool done[sensor_count];
+  uint8_t fru;
+  int i, j, n, ret;
+
+  if (snr_thresh_cnt != sensor_count) {
+    free(snr_thresh);
+    free(snr_thresh_sts);
+    snr_thresh = calloc(sensor_count, sizeof(thresh_sensor_t));
+    snr_thresh_sts = calloc(sensor_count, sizeof(int));
+    if (snr_thresh == NULL || snr_thresh_sts == NULL) {
+      free(snr_thresh);
+      free(snr_thresh_sts);
+      snr_thresh = NULL;
+      snr_thresh_sts = NULL;
+      snr_thresh_cnt = 0;
+      return;
+    }
+    snr_thresh_cnt = sensor_count;
   }
 
-  ret = frame_sel.getPage(&frame_sel, page, (char *)buffer, FRAME_PAGE_BUF_SIZE);
-  if (ret < 0) {
-    *count = 0;
-    return -1;
+  snr_thresh_valid = true;
+  memset(done, 0, sizeof(done));
+  for (i = 0; i < sensor_count; i++) {
+    snr_thresh_sts[i] = -1;
   }
-  *count = (uint8_t)ret;
 
-  if (page < frame_sel.pages)
-    *next = page+1;
-  else
-    *next = 0xFF; // Set the value of next to 0xFF to indicate this is the last page
+  for (i = 0; i < sensor_count; i++) {
+    if (done[i] || (cri_sensor[i].fru == FRU_ALL && pos == FRU_ALL)) {
+      continue;
+    }
 
-  return 0;
+    fru = cri_sensor_fru(&cri_sensor[i], pos);
+    for (j = i, n = 0; j < sensor_count; j++) {
+      if (!done[j] && !(cri_sensor[j].fru == FRU_ALL && pos == FRU_ALL) &&
+          cri_sensor_fru(&cri_sensor[j], pos) == fru) {
+        done[j] = true;
+        idx[n] = j;
+        snr_list[n++] = cri_sensor[j].sensor_num;
+      }
+    }
+
+    ret = sdr_get_snr_thresh_list(fru, snr_list, n, thresh, sts);
+    if (ret < 0) {
+      // Try again on the next render, e.g. the SDR is not ready yet
+      snr_thresh_valid = false;
+      continue;
+    }
+    for (j = 0; j < n; j++) {
+      snr_thresh[idx[j]] = thresh[j];
+      snr_thresh_sts[idx[j]] = sts[j];
+    }
+  }
 }
 
 static int
-udbg_get_cri_sensor (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
+udbg_render_cri_sensor(uint8_t pos) {
   char str[32], temp_val[16], temp_thresh[8], print_format[32];
   int i, ret;
   float fvalue;
-  thresh_sensor_t thresh;
+  thresh_sensor_t *thresh;
   sensor_desc_t *cri_sensor = NULL;
   size_t sensor_count = 0;
-  uint8_t pos = plat_get_fru_sel();
   uint8_t fru;
 
   if (plat_get_sensor_desc(pos, &cri_sensor, &sensor_count)) {
     return -1;
   }
 
-  if (page == 1) {
-    // Only update frame data while getting page 1
+  if (!snr_thresh_valid || snr_thresh_cnt != sensor_count) {
+    udbg_load_cri_thresh(pos, cri_sensor, sensor_count);
+  }
 
-    // initialize and clear frame
-    frame_snr.init(&frame_snr, FRAME_BUFF_SIZE);
-    snprintf(frame_snr.title, 32, "CriSensor");
+  // initialize and clear frame
+  frame_snr.init(&frame_snr, FRAME_BUFF_SIZE);
+  snprintf(frame_snr.title, 32, "CriSensor");
 
-    for (i = 0; i < sensor_count; i++) {
-      /* Pos implies BMC (FRU_ALL) and configuration for this sensor
-       * wants us to use the FRU info from the pos. Skip this sensor */
-      if (cri_sensor[i].fru == FRU_ALL && pos == FRU_ALL) {
-        continue;
-      }
-      fru = cri_sensor[i].fru == FRU_ALL ? pos : cri_sensor[i].fru;
+  for (i = 0; i < sensor_count; i++) {
+    /* Pos implies BMC (FRU_ALL) and configuration for this sensor
+     * wants us to use the FRU info from the pos. Skip this sensor */
+    if (cri_sensor[i].fru == FRU_ALL && pos == FRU_ALL) {
+      continue;
+    }
+    fru = cri_sensor_fru(&cri_sensor[i], pos);
 
-      temp_thresh[0] = 0;
-      ret = sensor_cache_read(fru, cri_sensor[i].sensor_num, &fvalue);
-      if (ret < 0) {
-        strcpy(temp_val, "NA");
-      } else {
-        ret = sdr_get_snr_thresh(fru, cri_sensor[i].sensor_num, &thresh);
-        if (ret == 0) {
-          if ((GETBIT(thresh.flag, UNR_THRESH) == 1) && (fvalue > thresh.unr_thresh)) {
-            strcpy(temp_thresh, "/UNR");
-          } else if (((GETBIT(thresh.flag, UCR_THRESH) == 1)) && (fvalue > thresh.ucr_thresh)) {
-            strcpy(temp_thresh, "/UCR");
-          } else if (((GETBIT(thresh.flag, UNC_THRESH) == 1)) && (fvalue > thresh.unc_thresh)) {
-            strcpy(temp_thresh, "/UNC");
-          } else if (((GETBIT(thresh.flag, LNR_THRESH) == 1)) && (fvalue < thresh.lnr_thresh)) {
-            strcpy(temp_thresh, "/LNR");
-          } else if (((GETBIT(thresh.flag, LCR_THRESH) == 1)) && (fvalue < thresh.lcr_thresh)) {
-            strcpy(temp_thresh, "/LCR");
-          } else if (((GETBIT(thresh.flag, LNC_THRESH) == 1)) && (fvalue < thresh.lnc_thresh)) {
-            strcpy(temp_thresh, "/LNC");
-          }
+    temp_thresh[0] = 0;
+    ret = sensor_cache_read(fru, cri_sensor[i].sensor_num, &fvalue);
+    if (ret < 0) {
+      strcpy(temp_val, "NA");
+    } else {
+      if (i < snr_thresh_cnt && snr_thresh_sts[i] == 0) {
+        thresh = &snr_thresh[i];
+        if ((GETBIT(thresh->flag, UNR_THRESH) == 1) && (fvalue > thresh->unr_thresh)) {
+          strcpy(temp_thresh, "/UNR");
+        } else if (((GETBIT(thresh->flag, UCR_THRESH) == 1)) && (fvalue > thresh->ucr_thresh)) {
+          strcpy(temp_thresh, "/UCR");
+        } else if (((GETBIT(thresh->flag, UNC_THRESH) == 1)) && (fvalue > thresh->unc_thresh)) {
+          strcpy(temp_thresh, "/UNC");
+        } else if (((GETBIT(thresh->flag, LNR_THRESH) == 1)) && (fvalue < thresh->lnr_thresh)) {
+          strcpy(temp_thresh, "/LNR");
+        } else if (((GETBIT(thresh->flag, LCR_THRESH) == 1)) && (fvalue < thresh->lcr_thresh)) {
+          strcpy(temp_thresh, "/LCR");
+        } else if (((GETBIT(thresh->flag, LNC_THRESH) == 1)) && (fvalue < thresh->lnc_thresh)) {
+          strcpy(temp_thresh, "/LNC");
         }
-        snprintf(print_format, sizeof(print_format), "%%.%df%%s", (int)cri_sensor[i].disp_prec);
-        snprintf(temp_val, sizeof(temp_val), (const char *)print_format, fvalue, cri_sensor[i].unit);
       }
-      if (temp_thresh[0] != 0)
-        snprintf(str, sizeof(str), ESC_ALT"%s%s%s"ESC_RST, cri_sensor[i].name, temp_val, temp_thresh);
-      else
-        snprintf(str, sizeof(str), "%s%s", cri_sensor[i].name, temp_val);
-      frame_snr.append(&frame_snr, str, 0);
+      snprintf(print_format, sizeof(print_format), "%%.%df%%s", (int)cri_sensor[i].disp_prec);
+      snprintf(temp_val, sizeof(temp_val), (const char *)print_format, fvalue, cri_sensor[i].unit);
     }
-  }  // End of update frame
-
-  if (page > frame_snr.pages) {
-    return -1;
-  }
-
-  ret = frame_snr.getPage(&frame_snr, page, (char *)buffer, FRAME_PAGE_BUF_SIZE);
-  if (ret < 0) {
-    *count = 0;
-    return -1;
+    if (temp_thresh[0] != 0)
+      snprintf(str, sizeof(str), ESC_ALT"%s%s%s"ESC_RST, cri_sensor[i].name, temp_val, temp_thresh);
+    else
+      snprintf(str, sizeof(str), "%s%s", cri_sensor[i].name, temp_val);
+    frame_snr.append(&frame_snr, str, 0);
   }
-  *count = (uint8_t)ret;
-
-  if (page < frame_snr.pages)
-    *next = page + 1;
-  else
-    *next = 0xFF;  // Set the value of next to 0xFF to indicate this is the last page
 
   return 0;
 }
 
 static int
-udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer) {
+udbg_render_info(uint8_t pos) {
   int ret;
   char line_buff[1000], *pres_dev = line_buff, *delim = "\n";
   FILE *fp;
@@ -735,108 +720,334 @@ udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count,
   unsigned char zero_ip_addr[SIZE_IP_ADDR] = { 0 };
   unsigned char zero_ip6_addr[SIZE_IP6_ADDR] = { 0 };
   char fruid_path[256];
-  uint8_t pos = plat_get_fru_sel();
 
-  if (page == 1) {
-    // Only update frame data while getting page 1
-
-    // initialize and clear frame
-    frame_info.init(&frame_info, FRAME_BUFF_SIZE);
-    snprintf(frame_info.title, 32, "SYS_Info");
-
-    // FRU
-    if (pos != FRU_ALL && pal_get_fruid_path(pos, fruid_path) == 0 &&
-        fruid_parse(fruid_path, &fruid) == 0) {
-      frame_info.append(&frame_info, "SN:", 0);
-      frame_info.append(&frame_info, fruid.board.serial, 1);
-      frame_info.append(&frame_info, "PN:", 0);
-      frame_info.append(&frame_info, fruid.board.part, 1);
-      free_fruid_info(&fruid);
-    }
-
-    // LAN
-    plat_lan_init(&lan_config);
-    if (memcmp(lan_config.ip_addr, zero_ip_addr, SIZE_IP_ADDR)) {
-      inet_ntop(AF_INET, lan_config.ip_addr, line_buff, FRAME_PAGE_BUF_SIZE);
-      frame_info.append(&frame_info, "BMC_IP:", 0);
-      frame_info.append(&frame_info, line_buff, 1);
-    }
-    if (memcmp(lan_config.ip6_addr, zero_ip6_addr, SIZE_IP6_ADDR)) {
-      inet_ntop(AF_INET6, lan_config.ip6_addr, line_buff, FRAME_PAGE_BUF_SIZE);
-      frame_info.append(&frame_info, "BMC_IPv6:", 0);
-      frame_info.append(&frame_info, line_buff, 1);
-    }
-
-    // BMC ver
-    fp = fopen("/etc/issue", "r");
-    if (fp != NULL) {
-      if (fgets(line_buff, sizeof(line_buff), fp)) {
-        if ((ret = sscanf(line_buff, "%*s %*s %s", line_buff)) == 1) {
-          frame_info.append(&frame_info, "BMC_FW_ver:", 0);
-          frame_info.append(&frame_info, line_buff, 1);
-        }
+  // initialize and clear frame
+  frame_info.init(&frame_info, FRAME_BUFF_SIZE);
+  snprintf(frame_info.title, 32, "SYS_Info");
+
+  // FRU
+  if (pos != FRU_ALL && pal_get_fruid_path(pos, fruid_path) == 0 &&
+      fruid_parse(fruid_path, &fruid) == 0) {
+    frame_info.append(&frame_info, "SN:", 0);
+    frame_info.append(&frame_info, fruid.board.serial, 1);
+    frame_info.append(&frame_info, "PN:", 0);
+    frame_info.append(&frame_info, fruid.board.part, 1);
+    free_fruid_info(&fruid);
+  }
+
+  // LAN
+  plat_lan_init(&lan_config);
+  if (memcmp(lan_config.ip_addr, zero_ip_addr, SIZE_IP_ADDR)) {
+    inet_ntop(AF_INET, lan_config.ip_addr, line_buff, FRAME_PAGE_BUF_SIZE);
+    frame_info.append(&frame_info, "BMC_IP:", 0);
+    frame_info.append(&frame_info, line_buff, 1);
+  }
+  if (memcmp(lan_config.ip6_addr, zero_ip6_addr, SIZE_IP6_ADDR)) {
+    inet_ntop(AF_INET6, lan_config.ip6_addr, line_buff, FRAME_PAGE_BUF_SIZE);
+    frame_info.append(&frame_info, "BMC_IPv6:", 0);
+    frame_info.append(&frame_info, line_buff, 1);
+  }
+
+  // BMC ver
+  fp = fopen("/etc/issue", "r");
+  if (fp != NULL) {
+    if (fgets(line_buff, sizeof(line_buff), fp)) {
+      if ((ret = sscanf(line_buff, "%*s %*s %s", line_buff)) == 1) {
+        frame_info.append(&frame_info, "BMC_FW_ver:", 0);
+        frame_info.append(&frame_info, line_buff, 1);
       }
-      fclose(fp);
     }
+    fclose(fp);
+  }
+
+  // BIOS ver
+  if (pos != FRU_ALL && !pal_get_sysfw_ver(pos, (uint8_t *)line_buff)) {
+    // BIOS version response contains the length at offset 2 followed by ascii string
+    line_buff[3+line_buff[2]] = '\0';
+    frame_info.append(&frame_info, "BIOS_FW_ver:", 0);
+    frame_info.append(&frame_info, &line_buff[3], 1);
+  }
+
+  // ME status
+  if (pos != FRU_ALL && !plat_get_me_status(pos, line_buff)) {
+    frame_info.append(&frame_info, "ME_status:", 0);
+    frame_info.append(&frame_info, line_buff, 1);
+  }
+
+  // Board ID
+  if (!plat_get_board_id(line_buff)) {
+    frame_info.append(&frame_info, "Board_ID:", 0);
+    frame_info.append(&frame_info, line_buff, 1);
+  }
+
+  // Battery - Use Escape sequence
+  frame_info.append(&frame_info, "Battery:", 0);
+  frame_info.append(&frame_info, ESC_BAT"     ", 1);
+
+  // MCU Version - Use Escape sequence
+  frame_info.append(&frame_info, "MCUbl_ver:", 0);
+  frame_info.append(&frame_info, ESC_MCU_BL_VER, 1);
+  frame_info.append(&frame_info, "MCU_ver:", 0);
+  frame_info.append(&frame_info, ESC_MCU_RUN_VER, 1);
+
+  // Sys config present device
+  pres_dev = line_buff;
+  if (plat_get_syscfg_text(pos, pres_dev) == 0) {
+    pres_dev = strtok(pres_dev, delim);
+    if (pres_dev) {
+      frame_info.append(&frame_info, "Sys Conf. info:", 0);
+      do {
+        frame_info.append(&frame_info, pres_dev, 1);
+      } while ((pres_dev = strtok(NULL, delim)) != NULL);
+    }
+  }
+
+  return 0;
+}
 
-    // BIOS ver
-    if (pos != FRU_ALL && !pal_get_sysfw_ver(pos, (uint8_t *)line_buff)) {
-      // BIOS version response contains the length at offset 2 followed by ascii string
-      line_buff[3+line_buff[2]] = '\0';
-      frame_info.append(&frame_info, "BIOS_FW_ver:", 0);
-      frame_info.append(&frame_info, &line_buff[3], 1);
+/*
+ * Frame cache. Each frame is rendered once and served from memory until
+ * one of the sources it is built from changes or it reaches max_age (for
+ * content nobody signals, such as sensor readings or the ME status).
+ * Changes made by other processes are picked up through inotify on the
+ * files backing each source.
+ */
+struct frame_cache {
+  struct frame *frame;
+  uint8_t sources;
+  int max_age;
+  int (*render)(uint8_t pos);
+  bool dirty;
+  time_t render_time;
+  uint32_t hash;
+  uint32_t gen;           // bumped whenever the rendered content changes
+  uint32_t reported_gen;  // gen last reported by get_updated_frames
+};
+
+static struct frame_cache frame_cache[] = {
+  { /* dummy entry for making other to 1-based */ },
+  {
+    .frame = &frame_info,
+    .sources = UDBG_SRC_FRU | UDBG_SRC_FW | UDBG_SRC_POWER,
+    .max_age = 30,
+    .render = udbg_render_info,
+    .dirty = true,
+  },
+  {
+    .frame = &frame_sel,
+    .sources = UDBG_SRC_SEL,
+    .max_age = 0,
+    .render = udbg_render_cri_sel,
+    .dirty = true,
+  },
+  {
+    .frame = &frame_snr,
+    .sources = UDBG_SRC_THRESH,
+    .max_age = 2,
+    .render = udbg_render_cri_sensor,
+    .dirty = true,
+  },
+};
+static int frameNum = (sizeof(frame_cache)/sizeof(struct frame_cache)) - 1;
+
+static int udbg_ifd = -1;
+static int wd_sel = -1, wd_kv = -1, wd_tmp = -1, wd_thresh = -1;
+static uint8_t udbg_watched;
+static time_t udbg_watch_time;
+static uint8_t udbg_pos;
+static bool udbg_pos_valid;
+
+static void
+udbg_add_watch(int *wd, const char *path, uint8_t sources, uint8_t *changed) {
+  if (*wd >= 0) {
+    return;
+  }
+
+  *wd = inotify_add_watch(udbg_ifd, path,
+      IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO);
+  if (*wd >= 0) {
+    udbg_watched |= sources;
+    // Anything before the watch existed went unseen
+    *changed |= sources;
+  }
+}
+
+// (Re)try the watches, directories such as the kv store may appear later
+static void
+udbg_watch_init(uint8_t *changed) {
+  time_t now = time(NULL);
+
+  if (udbg_ifd < 0) {
+    udbg_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (udbg_ifd < 0) {
+      return;
     }
+  } else if (udbg_watched == (UDBG_SRC_FRU | UDBG_SRC_SEL | UDBG_SRC_FW |
+                              UDBG_SRC_POWER | UDBG_SRC_THRESH) ||
+             (now >= udbg_watch_time && now - udbg_watch_time < UDBG_UNWATCHED_AGE)) {
+    return;
+  }
+  udbg_watch_time = now;
 
-    // ME status
-    if (pos != FRU_ALL && !plat_get_me_status(pos, line_buff)) {
-      frame_info.append(&frame_info, "ME_status:", 0);
-      frame_info.append(&frame_info, line_buff, 1);
+  udbg_add_watch(&wd_sel, CRI_SEL_DIR, UDBG_SRC_SEL, changed);
+  udbg_add_watch(&wd_kv, KV_STORE_PATH, UDBG_SRC_FW | UDBG_SRC_POWER, changed);
+  udbg_add_watch(&wd_tmp, FRUID_DIR, UDBG_SRC_FRU, changed);
+  udbg_add_watch(&wd_thresh, THRESHOLD_PATH, UDBG_SRC_THRESH, changed);
+}
+
+static uint8_t
+udbg_event_sources(struct inotify_event *ev) {
+  if (ev->mask & IN_Q_OVERFLOW) {
+    return UDBG_SRC_ALL;
+  }
+  if (ev->mask & IN_IGNORED) {
+    // The watched directory is gone, watch it again once it is back
+    if (ev->wd == wd_sel) {
+      wd_sel = -1;
+      udbg_watched &= ~UDBG_SRC_SEL;
+    } else if (ev->wd == wd_kv) {
+      wd_kv = -1;
+      udbg_watched &= ~(UDBG_SRC_FW | UDBG_SRC_POWER);
+    } else if (ev->wd == wd_tmp) {
+      wd_tmp = -1;
+      udbg_watched &= ~UDBG_SRC_FRU;
+    } else if (ev->wd == wd_thresh) {
+      wd_thresh = -1;
+      udbg_watched &= ~UDBG_SRC_THRESH;
     }
+    return UDBG_SRC_ALL;
+  }
+  if (ev->wd == wd_thresh) {
+    return UDBG_SRC_THRESH;
+  }
+  if (ev->len == 0) {
+    return 0;
+  }
 
-    // Board ID
-    if (!plat_get_board_id(line_buff)) {
-      frame_info.append(&frame_info, "Board_ID:", 0);
-      frame_info.append(&frame_info, line_buff, 1);
+  if (ev->wd == wd_sel && !strcmp(ev->name, CRI_SEL_FILE)) {
+    return UDBG_SRC_SEL;
+  }
+  if (ev->wd == wd_kv) {
+    if (strstr(ev->name, "sysfw_ver")) {
+      return UDBG_SRC_FW;
+    }
+    if (strstr(ev->name, "pwr") || strstr(ev->name, "power")) {
+      return UDBG_SRC_POWER;
+    }
+  }
+  if (ev->wd == wd_tmp) {
+    if (!strncmp(ev->name, "fruid", 5)) {
+      return UDBG_SRC_FRU;
+    }
+    if (!strncmp(ev->name, "sdr", 3)) {
+      return UDBG_SRC_THRESH;
     }
+  }
+  return 0;
+}
 
-    // Battery - Use Escape sequence
-    frame_info.append(&frame_info, "Battery:", 0);
-    frame_info.append(&frame_info, ESC_BAT"     ", 1);
+// Collect what changed since the last call and mark the frames built from it
+static void
+udbg_poll_changes(void) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  uint8_t pos = plat_get_fru_sel();
+  uint8_t changed = 0;
+  ssize_t len;
+  char *ptr;
+  int i;
 
-    // MCU Version - Use Escape sequence
-    frame_info.append(&frame_info, "MCUbl_ver:", 0);
-    frame_info.append(&frame_info, ESC_MCU_BL_VER, 1);
-    frame_info.append(&frame_info, "MCU_ver:", 0);
-    frame_info.append(&frame_info, ESC_MCU_RUN_VER, 1);
+  if (!udbg_pos_valid || pos != udbg_pos) {
+    udbg_pos = pos;
+    udbg_pos_valid = true;
+    changed = UDBG_SRC_ALL;
+  }
 
-    // Sys config present device
-    pres_dev = line_buff;
-    if (plat_get_syscfg_text(pos, pres_dev) == 0) {
-      pres_dev = strtok(pres_dev, delim);
-      if (pres_dev) {
-        frame_info.append(&frame_info, "Sys Conf. info:", 0);
-        do {
-          frame_info.append(&frame_info, pres_dev, 1);
-        } while ((pres_dev = strtok(NULL, delim)) != NULL);
-      }
+  udbg_watch_init(&changed);
+  while (udbg_ifd >= 0 && (len = read(udbg_ifd, buf, sizeof(buf))) > 0) {
+    for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+      ev = (struct inotify_event *)ptr;
+      changed |= udbg_event_sources(ev);
     }
-  } // End of update frame
+  }
+
+  if (changed & UDBG_SRC_THRESH) {
+    snr_thresh_valid = false;
+  }
+  for (i = 1; i <= frameNum; i++) {
+    if (frame_cache[i].sources & changed) {
+      frame_cache[i].dirty = true;
+    }
+  }
+}
 
-  if (page > frame_info.pages) {
+static uint32_t
+frame_hash(struct frame *self) {
+  uint32_t hash = 2166136261u;
+  uint16_t idx;
+  char *ptr;
+
+  for (ptr = self->title; *ptr; ptr++) {
+    hash = (hash ^ (uint8_t)*ptr) * 16777619u;
+  }
+  hash = (hash ^ self->pages) * 16777619u;
+  for (idx = self->idx_head; idx != self->idx_tail; idx = (idx + 1) % self->max_size) {
+    hash = (hash ^ (uint8_t)self->buf[idx]) * 16777619u;
+  }
+  return hash;
+}
+
+// Render a frame again if needed, noting whether its content changed
+static int
+udbg_refresh_frame(uint8_t id) {
+  struct frame_cache *fc = &frame_cache[id];
+  time_t now = time(NULL);
+  int max_age = fc->max_age;
+  uint32_t hash;
+
+  if ((fc->sources & ~udbg_watched) &&
+      (max_age == 0 || max_age > UDBG_UNWATCHED_AGE)) {
+    max_age = UDBG_UNWATCHED_AGE;
+  }
+
+  if (!fc->dirty && fc->frame->buf != NULL &&
+      !(max_age && (now - fc->render_time >= max_age || now < fc->render_time))) {
+    return 0;
+  }
+
+  if (fc->render(udbg_pos)) {
     return -1;
   }
+  fc->dirty = false;
+  fc->render_time = now;
 
-  ret = frame_info.getPage(&frame_info, page, (char *)buffer, FRAME_PAGE_BUF_SIZE);
-  if (ret < 0) {
-    *count = 0;
+  hash = frame_hash(fc->frame);
+  if (hash != fc->hash || fc->gen == 0) {
+    fc->hash = hash;
+    fc->gen++;
+  }
+  return 0;
+}
+
+int
+plat_udbg_get_updated_frames(uint8_t *count, uint8_t *buffer) {
+  int i;
+
+  if (!plat_supported()) {
     return -1;
   }
-  *count = (uint8_t)ret;
 
-  if (page < frame_info.pages)
-    *next = page + 1;
-  else
-    *next = 0xFF; // Set the value of next to 0xFF to indicate this is the last page
+  udbg_poll_changes();
+
+  *count = 0;
+  for (i = 1; i <= frameNum; i++) {
+    if (udbg_refresh_frame(i) == 0 &&
+        frame_cache[i].gen != frame_cache[i].reported_gen) {
+      frame_cache[i].reported_gen = frame_cache[i].gen;
+      buffer[*count] = i;
+      *count += 1;
+    }
+  }
 
   return 0;
 }
@@ -844,19 +1055,42 @@ udbg_get_info_page (uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count,
 int
 plat_udbg_get_frame_data(uint8_t frame, uint8_t page, uint8_t *next, uint8_t *count, uint8_t *buffer)
 {
+  struct frame *f;
+  int ret;
+
   if (!plat_supported()) {
     return -1;
   }
-  switch (frame) {
-    case 1: //info_page
-      return udbg_get_info_page(frame, page, next, count, buffer);
-    case 2: // critical SEL
-      return udbg_get_cri_sel(frame, page, next, count, buffer);
-    case 3: //critical Sensor
-      return udbg_get_cri_sensor(frame, page, next, count, buffer);
-    default:
+  if (frame < 1 || frame > frameNum) {
+    return -1;
+  }
+
+  // Only refresh while getting page 1 so the card walks a consistent frame
+  if (page == 1 || frame_cache[frame].frame->buf == NULL) {
+    udbg_poll_changes();
+    if (udbg_refresh_frame(frame)) {
       return -1;
+    }
+  }
+  f = frame_cache[frame].frame;
+
+  if (page > f->pages) {
+    return -1;
   }
+
+  ret = f->getPage(f, page, (char *)buffer, FRAME_PAGE_BUF_SIZE);
+  if (ret < 0) {
+    *count = 0;
+    return -1;
+  }
+  *count = (uint8_t)ret;
+
+  if (page < f->pages)
+    *next = page + 1;
+  else
+    *next = 0xFF; // Set the value of next to 0xFF to indicate this is the last page
+
+  return 0;
 }
 
 static uint8_t panel_main (uint8_t item) {
@@ -27,8 +27,10 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <time.h>
+#include <getopt.h>
 
 #include <openbmc/pal.h>
+#include <openbmc/ncsi.h>
 
 #define FTGMAC0_DIR "/sys/devices/platform/ftgmac100.0/net/eth0"
 #define MAX_RETRY_CNT 3
@@ -93,26 +95,89 @@ write_ftgmac0_value(const char *device_name, unsigned char count, unsigned char
 
 static void
 print_usage_help(void) {
-  printf("Usage: ncsi-util <channel_id> <cmd> <[0..n] raw_payload_bytes_to_send>\n\n");
+  printf("Usage: ncsi-util [-n <ifname>] <channel_id> <cmd> <[0..n] raw_payload_bytes_to_send>\n");
+  printf("       ncsi-util -s     show the NIC link status and statistics published by ncsid\n\n");
   printf("   e.g. \n");
   printf("       ncsi-util 0 80 0 0 129 25 0 0 27 0\n");
 }
 
+static void
+print_response(ncsi_rsp_t *rsp) {
+  int i;
+
+  printf("NC-SI Command Response:\n");
+  printf("Response Code: 0x%04X  Reason Code: 0x%04X\n", rsp->resp_code, rsp->reason_code);
+  for (i = 0; i < rsp->len; i++) {
+    if (i && !(i % 16))
+      printf("\n");
+    printf("0x%02x ", rsp->data[i]);
+  }
+  printf("\n");
+}
+
+static int
+print_snapshot(void) {
+  ncsi_snapshot_t snap;
+  ncsi_channel_snapshot_t *ch;
+  int i;
+
+  if (ncsi_snapshot_read(&snap)) {
+    printf("NIC snapshot is not available, is ncsid running?\n");
+    return -1;
+  }
+
+  printf("Updated %ld seconds ago, polling every %u seconds\n",
+         (long)(time(NULL) - snap.update_time), snap.interval);
+  for (i = 0; i < NCSI_MAX_CHANNEL; i++) {
+    ch = &snap.channel[i];
+    if (!ch->present)
+      continue;
+    printf("Channel %d:\n", i);
+    printf("  Link: %s (status 0x%08X, OEM 0x%08X)\n",
+           (ch->link.link_status & 0x1) ? "up" : "down",
+           ch->link.link_status, ch->link.oem_link_status);
+    printf("  RX bytes: %llu  unicast: %llu  multicast: %llu  broadcast: %llu\n",
+           (unsigned long long)ch->stats.rx_bytes, (unsigned long long)ch->stats.rx_ucast,
+           (unsigned long long)ch->stats.rx_mcast, (unsigned long long)ch->stats.rx_bcast);
+    printf("  TX bytes: %llu  unicast: %llu  multicast: %llu  broadcast: %llu\n",
+           (unsigned long long)ch->stats.tx_bytes, (unsigned long long)ch->stats.tx_ucast,
+           (unsigned long long)ch->stats.tx_mcast, (unsigned long long)ch->stats.tx_bcast);
+    printf("  FCS errors: %u  alignment errors: %u  runt: %u  jabber: %u\n",
+           ch->stats.fcs_err, ch->stats.align_err, ch->stats.runt, ch->stats.jabber);
+    printf("  AENs: %u  command errors: %u\n", ch->aen_count, ch->err_count);
+  }
+
+  return 0;
+}
 
 int
 main(int argc, char **argv) {
 
-  int i;
+  int i, opt;
   unsigned char count;
   unsigned char buf[128];
+  const char *ifname = NCSI_DEFAULT_IFNAME;
+  ncsi_rsp_t rsp;
+
+  while ((opt = getopt(argc, argv, "n:s")) != -1) {
+    switch (opt) {
+      case 'n':
+        ifname = optarg;
+        break;
+      case 's':
+        return print_snapshot();
+      default:
+        goto err_exit;
+    }
+  }
 
-  if (argc < 2)
+  if (argc - optind < 2 || argc - optind > (int)sizeof(buf))
     goto err_exit;
 
-  count = argc-1;
+  count = argc - optind;
 
-  for (i=1; i<argc; ++i) {
-    buf[i-1] = atoi(argv[i]);
+  for (i = optind; i < argc; ++i) {
+    buf[i - optind] = atoi(argv[i]);
   }
 
 #ifdef DEBUG
@@ -125,6 +190,12 @@ main(int argc, char **argv) {
   printf("\n");
 #endif
 
+  // Through ncsid or a netlink channel; the legacy driver interface has no response
+  if (ncsi_request(ifname, buf[0], buf[1], &buf[2], count - 2, &rsp) == 0) {
+    print_response(&rsp);
+    return 0;
+  }
+
   write_ftgmac0_value("cmd_payload", count, buf);
 
   return 0;
@@ -0,0 +1,484 @@
+/*
+ * ncsid
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Keeps a single NC-SI channel open to the NIC and
+ *  - multiplexes the commands of ncsi-util and other clients on it,
+ *    matching responses by sequence id,
+ *  - polls Get Link Status and Get Controller Packet Statistics into a
+ *    shared memory snapshot, so monitoring reads memory instead of
+ *    sending NC-SI traffic,
+ *  - with --aen, enables and handles AENs itself. By default AENs stay
+ *    with the kernel NC-SI driver, which enables them on the channels it
+ *    configures and handles them without passing them to netlink; the
+ *    daemon then only sees link changes through polling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <openbmc/ncsi.h>
+
+#define DEFAULT_INTERVAL   10
+#define MAX_CLIENTS        16
+#define MAX_PENDING        64
+
+/* Owner of an outstanding command */
+#define OWNER_POLL         -1
+#define OWNER_GONE         -2
+
+typedef struct {
+  bool used;
+  uint32_t seq;
+  int owner;               /* client fd, OWNER_POLL or OWNER_GONE */
+  uint8_t channel;
+  uint8_t cmd;
+  struct timespec sent;
+} pending_t;
+
+static ncsi_chan_t *g_chan;
+static ncsi_snapshot_t *g_snap;
+static pending_t g_pending[MAX_PENDING];
+static int g_clients[MAX_CLIENTS];
+static int g_num_channels = 1;
+static bool g_aen = false;
+static volatile sig_atomic_t g_exit = 0;
+
+static void
+print_usage(void) {
+  printf("Usage: ncsid [-i <ifname>] [-c <channels>] [-t <interval>] [--aen] [--loopback]\n");
+  printf("       -i <ifname>     NC-SI interface (default %s)\n", NCSI_DEFAULT_IFNAME);
+  printf("       -c <channels>   number of channels to monitor (1-%d)\n", NCSI_MAX_CHANNEL);
+  printf("       -t <interval>   statistics polling interval in seconds\n");
+  printf("       --aen           enable AENs and handle them in ncsid\n");
+  printf("       --loopback      use the built-in loopback responder\n");
+}
+
+static void
+sig_handler(int sig) {
+  g_exit = 1;
+}
+
+static int
+elapsed_ms(struct timespec *from) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - from->tv_sec) * 1000 + (now.tv_nsec - from->tv_nsec) / 1000000;
+}
+
+static int
+submit(int owner, uint8_t channel, uint8_t cmd, const uint8_t *payload, uint16_t len) {
+  pending_t *p = NULL;
+  int i;
+
+  for (i = 0; i < MAX_PENDING; i++) {
+    if (!g_pending[i].used) {
+      p = &g_pending[i];
+      break;
+    }
+  }
+  if (p == NULL) {
+    syslog(LOG_WARNING, "ncsid: too many outstanding commands");
+    return -1;
+  }
+
+  if (ncsi_submit(g_chan, channel, cmd, payload, len, &p->seq))
+    return -1;
+
+  p->used = true;
+  p->owner = owner;
+  p->channel = channel;
+  p->cmd = cmd;
+  clock_gettime(CLOCK_MONOTONIC, &p->sent);
+  return 0;
+}
+
+static void
+reply_client(int fd, ncsi_rsp_t *rsp) {
+  if (send(fd, rsp, sizeof(*rsp), MSG_NOSIGNAL) < 0)
+    syslog(LOG_DEBUG, "ncsid: reply to client failed, errno = %d", errno);
+}
+
+static void
+poll_channels(void) {
+  int ch;
+
+  for (ch = 0; ch < g_num_channels; ch++) {
+    submit(OWNER_POLL, NCSI_CHANNEL(0, ch), NCSI_CMD_GET_LINK_STATUS, NULL, 0);
+    submit(OWNER_POLL, NCSI_CHANNEL(0, ch), NCSI_CMD_GET_CTRL_PKT_STATS, NULL, 0);
+  }
+}
+
+static void
+enable_aen(void) {
+  /* Link status change, configuration required and host driver change */
+  uint8_t payload[8] = {0, 0, 0, 0, 0, 0, 0, 0x07};
+  int ch;
+
+  for (ch = 0; ch < g_num_channels; ch++)
+    submit(OWNER_POLL, NCSI_CHANNEL(0, ch), NCSI_CMD_AEN_ENABLE, payload, sizeof(payload));
+}
+
+static void
+handle_poll_rsp(pending_t *p, ncsi_rsp_t *rsp) {
+  ncsi_channel_snapshot_t *snap;
+  ncsi_link_status_t link;
+  ncsi_pkt_stats_t stats;
+  int ch = NCSI_CHANNEL_ID(p->channel);
+
+  if (ch >= NCSI_MAX_CHANNEL)
+    return;
+  snap = &g_snap->channel[ch];
+
+  ncsi_snapshot_begin(g_snap);
+  if (rsp == NULL || rsp->resp_code != NCSI_RESP_COMPLETED) {
+    snap->err_count++;
+  } else if (p->cmd == NCSI_CMD_GET_LINK_STATUS) {
+    if (ncsi_parse_link_status(rsp, &link) == 0) {
+      if (snap->present && (snap->link.link_status & 0x1) != (link.link_status & 0x1))
+        syslog(LOG_INFO, "ncsid: channel %d link %s", ch,
+               (link.link_status & 0x1) ? "up" : "down");
+      snap->present = true;
+      snap->link = link;
+      snap->link_time = time(NULL);
+    }
+  } else if (p->cmd == NCSI_CMD_GET_CTRL_PKT_STATS) {
+    if (ncsi_parse_pkt_stats(rsp, &stats) == 0) {
+      snap->present = true;
+      snap->stats = stats;
+      snap->stats_time = time(NULL);
+    }
+  }
+  g_snap->update_time = time(NULL);
+  ncsi_snapshot_end(g_snap);
+}
+
+static void
+handle_aen(ncsi_rsp_t *rsp) {
+  ncsi_link_status_t link;
+  uint8_t type;
+  int ch = NCSI_CHANNEL_ID(rsp->channel);
+
+  if (ch >= NCSI_MAX_CHANNEL || ncsi_parse_aen(rsp, &type, &link))
+    return;
+
+  ncsi_snapshot_begin(g_snap);
+  g_snap->channel[ch].aen_count++;
+  if (type == NCSI_AEN_LINK_STATUS_CHANGE) {
+    g_snap->channel[ch].present = true;
+    g_snap->channel[ch].link.link_status = link.link_status;
+    g_snap->channel[ch].link.oem_link_status = link.oem_link_status;
+    g_snap->channel[ch].link_time = time(NULL);
+  }
+  ncsi_snapshot_end(g_snap);
+
+  switch (type) {
+    case NCSI_AEN_LINK_STATUS_CHANGE:
+      syslog(LOG_INFO, "ncsid: AEN channel %d link %s", ch,
+             (link.link_status & 0x1) ? "up" : "down");
+      break;
+    case NCSI_AEN_CONFIG_REQUIRED:
+      // The channel lost its configuration, resume AEN delivery
+      syslog(LOG_WARNING, "ncsid: AEN channel %d configuration required", ch);
+      enable_aen();
+      break;
+    case NCSI_AEN_HOST_DRIVER_CHANGE:
+      syslog(LOG_INFO, "ncsid: AEN channel %d host driver status change", ch);
+      break;
+    default:
+      syslog(LOG_INFO, "ncsid: AEN channel %d type 0x%02X", ch, type);
+      break;
+  }
+}
+
+static void
+handle_response(void) {
+  ncsi_rsp_t rsp;
+  int i;
+
+  if (ncsi_recv(g_chan, &rsp, 0))
+    return;
+
+  if (rsp.type == NCSI_PKT_AEN) {
+    handle_aen(&rsp);
+    return;
+  }
+
+  for (i = 0; i < MAX_PENDING; i++) {
+    if (g_pending[i].used && g_pending[i].seq == rsp.seq)
+      break;
+  }
+  if (i == MAX_PENDING)
+    return;
+
+  if (g_pending[i].owner == OWNER_POLL)
+    handle_poll_rsp(&g_pending[i], &rsp);
+  else if (g_pending[i].owner >= 0)
+    reply_client(g_pending[i].owner, &rsp);
+  g_pending[i].used = false;
+}
+
+static void
+expire_pending(void) {
+  ncsi_rsp_t rsp;
+  int i;
+
+  for (i = 0; i < MAX_PENDING; i++) {
+    if (!g_pending[i].used || elapsed_ms(&g_pending[i].sent) < NCSI_TIMEOUT_MS)
+      continue;
+
+    if (g_pending[i].owner == OWNER_POLL) {
+      handle_poll_rsp(&g_pending[i], NULL);
+    } else if (g_pending[i].owner >= 0) {
+      memset(&rsp, 0, sizeof(rsp));
+      rsp.seq = g_pending[i].seq;
+      rsp.channel = g_pending[i].channel;
+      rsp.type = g_pending[i].cmd | NCSI_RSP_FLAG;
+      rsp.resp_code = NCSI_RESP_TRANSPORT_ERR;
+      reply_client(g_pending[i].owner, &rsp);
+    }
+    g_pending[i].used = false;
+  }
+}
+
+static void
+drop_client(int idx) {
+  int i;
+
+  for (i = 0; i < MAX_PENDING; i++) {
+    if (g_pending[i].used && g_pending[i].owner == g_clients[idx])
+      g_pending[i].owner = OWNER_GONE;
+  }
+  close(g_clients[idx]);
+  g_clients[idx] = -1;
+}
+
+static void
+handle_client(int idx) {
+  ncsid_req_t req;
+  ncsi_rsp_t rsp;
+  int len;
+
+  len = recv(g_clients[idx], &req, sizeof(req), 0);
+  if (len <= 0) {
+    drop_client(idx);
+    return;
+  }
+
+  if (len < (int)offsetof(ncsid_req_t, payload) ||
+      len < (int)offsetof(ncsid_req_t, payload) + req.len ||
+      req.len > NCSI_MAX_PAYLOAD ||
+      submit(g_clients[idx], req.channel, req.cmd, req.payload, req.len)) {
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.resp_code = NCSI_RESP_TRANSPORT_ERR;
+    reply_client(g_clients[idx], &rsp);
+  }
+}
+
+static void
+accept_client(int lfd) {
+  int fd, i;
+
+  fd = accept(lfd, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  for (i = 0; i < MAX_CLIENTS; i++) {
+    if (g_clients[i] < 0) {
+      g_clients[i] = fd;
+      return;
+    }
+  }
+  syslog(LOG_WARNING, "ncsid: too many clients");
+  close(fd);
+}
+
+static int
+open_server(void) {
+  struct sockaddr_un local;
+  int fd;
+
+  fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  memset(&local, 0, sizeof(local));
+  local.sun_family = AF_UNIX;
+  strcpy(local.sun_path, SOCK_PATH_NCSID);
+  unlink(local.sun_path);
+  if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+      listen(fd, MAX_CLIENTS) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static int
+open_timer(int interval) {
+  struct itimerspec its;
+  int fd;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  its.it_interval.tv_sec = interval;
+  its.it_interval.tv_nsec = 0;
+  its.it_value.tv_sec = 0;
+  its.it_value.tv_nsec = 1;   // first sweep right away
+  timerfd_settime(fd, 0, &its, NULL);
+
+  return fd;
+}
+
+int
+main(int argc, char **argv) {
+  struct pollfd pfds[3 + MAX_CLIENTS];
+  const char *ifname = NCSI_DEFAULT_IFNAME;
+  int interval = DEFAULT_INTERVAL;
+  bool loopback = false;
+  int lfd, tfd;
+  int i, nfds, opt;
+  uint64_t expirations;
+  static struct option long_opts[] = {
+    {"aen", no_argument, 0, 'a'},
+    {"loopback", no_argument, 0, 'l'},
+    {0, 0, 0, 0},
+  };
+
+  while ((opt = getopt_long(argc, argv, "i:c:t:al", long_opts, NULL)) != -1) {
+    switch (opt) {
+      case 'i':
+        ifname = optarg;
+        break;
+      case 'c':
+        g_num_channels = atoi(optarg);
+        break;
+      case 't':
+        interval = atoi(optarg);
+        break;
+      case 'a':
+        g_aen = true;
+        break;
+      case 'l':
+        loopback = true;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+  if (g_num_channels < 1 || g_num_channels > NCSI_MAX_CHANNEL || interval < 1) {
+    print_usage();
+    return -1;
+  }
+
+  openlog("ncsid", LOG_CONS, LOG_DAEMON);
+  signal(SIGTERM, sig_handler);
+  signal(SIGINT, sig_handler);
+
+  g_chan = loopback ? ncsi_open_loopback() : ncsi_open(ifname);
+  if (g_chan == NULL) {
+    syslog(LOG_ERR, "ncsid: cannot open NC-SI channel on %s", ifname);
+    return -1;
+  }
+
+  g_snap = ncsi_snapshot_map(true);
+  if (g_snap == NULL) {
+    syslog(LOG_ERR, "ncsid: cannot map the snapshot");
+    return -1;
+  }
+  ncsi_snapshot_begin(g_snap);
+  memset(g_snap->channel, 0, sizeof(g_snap->channel));
+  g_snap->interval = interval;
+  ncsi_snapshot_end(g_snap);
+
+  lfd = open_server();
+  tfd = open_timer(interval);
+  if (lfd < 0 || tfd < 0) {
+    syslog(LOG_ERR, "ncsid: setup failed, errno = %d", errno);
+    return -1;
+  }
+  for (i = 0; i < MAX_CLIENTS; i++)
+    g_clients[i] = -1;
+
+  if (g_aen)
+    enable_aen();
+
+  while (!g_exit) {
+    pfds[0].fd = ncsi_get_fd(g_chan);
+    pfds[1].fd = tfd;
+    pfds[2].fd = lfd;
+    nfds = 3;
+    for (i = 0; i < MAX_CLIENTS; i++) {
+      if (g_clients[i] >= 0)
+        pfds[nfds++].fd = g_clients[i];
+    }
+    for (i = 0; i < nfds; i++) {
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+    }
+
+    // Wake up at least every timeout period to expire lost commands
+    if (poll(pfds, nfds, NCSI_TIMEOUT_MS) < 0 && errno != EINTR)
+      break;
+
+    if (pfds[0].revents & POLLIN)
+      handle_response();
+    if ((pfds[1].revents & POLLIN) &&
+        read(tfd, &expirations, sizeof(expirations)) == sizeof(expirations))
+      poll_channels();
+    if (pfds[2].revents & POLLIN)
+      accept_client(lfd);
+    for (i = 3; i < nfds; i++) {
+      if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        int idx;
+        for (idx = 0; idx < MAX_CLIENTS; idx++) {
+          if (g_clients[idx] == pfds[i].fd) {
+            handle_client(idx);
+            break;
+          }
+        }
+      }
+    }
+
+    expire_pending();
+  }
+
+  unlink(SOCK_PATH_NCSID);
+  ncsi_snapshot_unmap(g_snap);
+  ncsi_close(g_chan);
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * power-sim
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Simulated sled for power-util. The behaviour is set through the
+ * environment:
+ *
+ *   POWER_SIM_STATE       initial state per slot: 1 on, 0 off, x 12V-off,
+ *                         - empty (default "1111")
+ *   POWER_SIM_PRESS_MS    time a power request blocks, like a button
+ *                         press (default 200)
+ *   POWER_SIM_ON_MS       delay from power on to power good (default 1500)
+ *   POWER_SIM_OFF_MS      delay from power off to power good low (default 500)
+ *   POWER_SIM_STAGGER_MS  stagger declared to power-util (default 300)
+ *   POWER_SIM_CYCLE_OFF_MS  time a power cycle holds a slot off, declared
+ *                         to power-util (default 1000)
+ *   POWER_SIM_STUCK       slots that never assert power good, e.g. "3"
+ *   POWER_SIM_POLICY      power restore policy: 0 off, 1 last state, 2 on
+ *                         (default 0)
+ *
+ * Power-ons starting closer together than the declared stagger are
+ * reported on stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "power-sim.h"
+
+// Scheduling slack allowed before an overlap is reported
+#define SIM_JITTER_MS  5
+
+typedef struct {
+  bool present;
+  uint8_t status;       /* state once the pending transition completes */
+  uint8_t prev;         /* state reported until then */
+  long long settle;     /* time the pending transition completes */
+  char last_state[MAX_VALUE_LEN];
+} sim_slot_t;
+
+const char pal_server_list[] = "slot1, slot2, slot3, slot4";
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_slot_t sim_slot[MAX_NUM_FRUS + 1];
+static long long sim_last_on;
+static uint8_t sim_last_on_slot;
+static bool sim_ready;
+
+static long long
+sim_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int
+sim_env(const char *name, int def) {
+  char *val = getenv(name);
+
+  return val ? atoi(val) : def;
+}
+
+static bool
+sim_is_stuck(uint8_t slot) {
+  char *val = getenv("POWER_SIM_STUCK");
+
+  return val && strchr(val, '0' + slot);
+}
+
+static void
+sim_init(void) {
+  char *state = getenv("POWER_SIM_STATE");
+  uint8_t slot;
+  char c;
+
+  if (sim_ready) {
+    return;
+  }
+
+  for (slot = 1; slot <= MAX_NUM_FRUS; slot++) {
+    c = (state && strlen(state) >= slot) ? state[slot - 1] : '1';
+    sim_slot[slot].present = (c != '-');
+    if (c == '0') {
+      sim_slot[slot].status = SERVER_POWER_OFF;
+    } else if (c == 'x') {
+      sim_slot[slot].status = SERVER_12V_OFF;
+    } else {
+      sim_slot[slot].status = SERVER_POWER_ON;
+    }
+    sim_slot[slot].prev = sim_slot[slot].status;
+    strcpy(sim_slot[slot].last_state,
+           sim_slot[slot].status == SERVER_POWER_ON ? "on" : "off");
+  }
+  sim_ready = true;
+}
+
+static uint8_t
+sim_current(uint8_t slot) {
+  sim_slot_t *s = &sim_slot[slot];
+
+  return (sim_now() >= s->settle) ? s->status : s->prev;
+}
+
+static void
+sim_transition(uint8_t slot, uint8_t status, int delay_ms) {
+  sim_slot_t *s = &sim_slot[slot];
+  int stagger = sim_env("POWER_SIM_STAGGER_MS", 300);
+  long long now = sim_now();
+
+  if (status == SERVER_POWER_ON && s->status != SERVER_POWER_ON) {
+    if (sim_last_on && now - sim_last_on < stagger - SIM_JITTER_MS) {
+      fprintf(stderr, "power-sim: slot%u powered on %lld ms after slot%u,"
+              " inside the %d ms stagger\n", slot, now - sim_last_on,
+              sim_last_on_slot, stagger);
+    }
+    sim_last_on = now;
+    sim_last_on_slot = slot;
+    if (sim_is_stuck(slot)) {
+      // Power good never follows
+      return;
+    }
+  }
+
+  s->prev = sim_current(slot);
+  s->status = status;
+  s->settle = now + delay_ms;
+}
+
+int
+pal_get_fru_id(char *str, uint8_t *fru) {
+  int slot;
+
+  if (sscanf(str, "slot%d", &slot) != 1 || slot < 1 || slot > MAX_NUM_FRUS) {
+    return -1;
+  }
+  *fru = slot;
+  return 0;
+}
+
+int
+pal_get_fru_name(uint8_t fru, char *name) {
+  if (fru < 1 || fru > MAX_NUM_FRUS) {
+    return -1;
+  }
+  sprintf(name, "slot%u", fru);
+  return 0;
+}
+
+int
+pal_is_fru_prsnt(uint8_t fru, uint8_t *status) {
+  pthread_mutex_lock(&sim_lock);
+  sim_init();
+  *status = sim_slot[fru].present;
+  pthread_mutex_unlock(&sim_lock);
+  return 0;
+}
+
+bool
+pal_is_fw_update_ongoing(uint8_t fru) {
+  return false;
+}
+
+int
+pal_is_crashdump_ongoing(uint8_t fru) {
+  return 0;
+}
+
+int
+pal_get_server_power(uint8_t slot_id, uint8_t *status) {
+  if (slot_id < 1 || slot_id > MAX_NUM_FRUS) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&sim_lock);
+  sim_init();
+  *status = sim_current(slot_id);
+  pthread_mutex_unlock(&sim_lock);
+  return 0;
+}
+
+int
+pal_set_server_power(uint8_t slot_id, uint8_t cmd) {
+  int on_ms = sim_env("POWER_SIM_ON_MS", 1500);
+  int off_ms = sim_env("POWER_SIM_OFF_MS", 500);
+  uint8_t status;
+  int ret = 0;
+
+  if (slot_id < 1 || slot_id > MAX_NUM_FRUS) {
+    return -1;
+  }
+
+  usleep(sim_env("POWER_SIM_PRESS_MS", 200) * 1000);
+
+  pthread_mutex_lock(&sim_lock);
+  sim_init();
+  status = sim_current(slot_id);
+  switch (cmd) {
+    case SERVER_POWER_ON:
+      if (status == SERVER_12V_OFF) {
+        ret = -2;
+      } else if (status == SERVER_POWER_ON) {
+        ret = 1;
+      } else {
+        sim_transition(slot_id, SERVER_POWER_ON, on_ms);
+      }
+      break;
+    case SERVER_POWER_OFF:
+    case SERVER_GRACEFUL_SHUTDOWN:
+      if (status != SERVER_POWER_ON) {
+        ret = 1;
+      } else {
+        sim_transition(slot_id, SERVER_POWER_OFF, off_ms);
+      }
+      break;
+    case SERVER_POWER_CYCLE:
+    case SERVER_POWER_RESET:
+      if (status != SERVER_POWER_ON) {
+        ret = -2;
+      } else {
+        sim_slot[slot_id].prev = SERVER_POWER_OFF;
+        sim_slot[slot_id].settle = sim_now() + on_ms;
+      }
+      break;
+    case SERVER_12V_OFF:
+      if (status == SERVER_12V_OFF) {
+        ret = 1;
+      } else {
+        sim_transition(slot_id, SERVER_12V_OFF, off_ms);
+      }
+      break;
+    case SERVER_12V_ON:
+      if (status != SERVER_12V_OFF) {
+        ret = 1;
+      } else {
+        sim_transition(slot_id, SERVER_POWER_OFF, off_ms);
+      }
+      break;
+    case SERVER_12V_CYCLE:
+      sim_transition(slot_id, SERVER_POWER_OFF, on_ms);
+      break;
+    default:
+      ret = -1;
+      break;
+  }
+  pthread_mutex_unlock(&sim_lock);
+
+  return ret;
+}
+
+int
+pal_sled_cycle(void) {
+  printf("power-sim: sled cycle\n");
+  return 0;
+}
+
+int
+pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint) {
+  constraint->stagger_ms = sim_env("POWER_SIM_STAGGER_MS", 300);
+  constraint->max_parallel = 0;
+  constraint->timeout_ms = sim_env("POWER_SIM_ON_MS", 1500) * 4;
+  constraint->cycle_off_ms = sim_env("POWER_SIM_CYCLE_OFF_MS", 1000);
+  return 0;
+}
+
+int
+pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group) {
+  *group = slot_id;
+
+  // Same pairing of 12V control as a two slot server configuration
+  if (cmd == SERVER_12V_OFF || cmd == SERVER_12V_ON || cmd == SERVER_12V_CYCLE) {
+    *group = (slot_id + 1) / 2;
+  }
+  return 0;
+}
+
+int
+pal_get_pwr_good_gpio(uint8_t slot_id, int *gpio) {
+  return PAL_ENOTSUP;
+}
+
+void
+pal_get_chassis_status(uint8_t slot, uint8_t *req_data, uint8_t *res_data, uint8_t *res_len) {
+  res_data[0] = sim_env("POWER_SIM_POLICY", POWER_CFG_OFF) << 5;
+  *res_len = 1;
+}
+
+int
+pal_get_last_pwr_state(uint8_t fru, char *state) {
+  pthread_mutex_lock(&sim_lock);
+  sim_init();
+  strcpy(state, sim_slot[fru].last_state);
+  pthread_mutex_unlock(&sim_lock);
+  return 0;
+}
+
+int
+pal_set_last_pwr_state(uint8_t fru, char *state) {
+  pthread_mutex_lock(&sim_lock);
+  snprintf(sim_slot[fru].last_state, MAX_VALUE_LEN, "%s", state);
+  pthread_mutex_unlock(&sim_lock);
+  return 0;
+}
+
+int
+pal_set_led(uint8_t slot, uint8_t status) {
+  return 0;
+}
+
+int
+pal_set_restart_cause(uint8_t slot, uint8_t restart_cause) {
+  return 0;
+}
+
+void
+pal_update_ts_sled(void) {
+}
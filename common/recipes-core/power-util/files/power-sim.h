@@ -0,0 +1,97 @@
+/*
+ * power-sim
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * The subset of the PAL used by power-util, backed by a simulated four
+ * slot sled so the sequencing logic can be exercised on a plain Linux
+ * host (make power-util-sim).
+ */
+
+#ifndef __POWER_SIM_H__
+#define __POWER_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/file.h>
+
+#define MAX_NUM_FRUS        4
+#define MAX_VALUE_LEN       64
+
+enum {
+  PAL_EOK = 0,
+  PAL_ENOTSUP = -ENOTSUP,
+};
+
+enum {
+  SERVER_POWER_OFF,
+  SERVER_POWER_ON,
+  SERVER_POWER_CYCLE,
+  SERVER_POWER_RESET,
+  SERVER_GRACEFUL_SHUTDOWN,
+  SERVER_12V_OFF,
+  SERVER_12V_ON,
+  SERVER_12V_CYCLE,
+};
+
+enum {
+  POWER_CFG_OFF = 0,
+  POWER_CFG_LPS,
+  POWER_CFG_ON,
+  POWER_CFG_UKNOWN,
+};
+
+enum {
+  LED_OFF = 0,
+  LED_ON,
+};
+
+enum {
+  RESTART_CAUSE_IPMI_CHASSIS_CMD = 0x1,
+};
+
+typedef struct {
+  uint16_t stagger_ms;
+  uint8_t  max_parallel;
+  uint32_t timeout_ms;
+  uint32_t cycle_off_ms;
+} pwr_seq_constraint_t;
+
+extern const char pal_server_list[];
+
+int pal_get_fru_id(char *str, uint8_t *fru);
+int pal_get_fru_name(uint8_t fru, char *name);
+int pal_is_fru_prsnt(uint8_t fru, uint8_t *status);
+bool pal_is_fw_update_ongoing(uint8_t fru);
+int pal_is_crashdump_ongoing(uint8_t fru);
+int pal_get_server_power(uint8_t slot_id, uint8_t *status);
+int pal_set_server_power(uint8_t slot_id, uint8_t cmd);
+int pal_sled_cycle(void);
+int pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint);
+int pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group);
+int pal_get_pwr_good_gpio(uint8_t slot_id, int *gpio);
+void pal_get_chassis_status(uint8_t slot, uint8_t *req_data, uint8_t *res_data, uint8_t *res_len);
+int pal_get_last_pwr_state(uint8_t fru, char *state);
+int pal_set_last_pwr_state(uint8_t fru, char *state);
+int pal_set_led(uint8_t slot, uint8_t status);
+int pal_set_restart_cause(uint8_t slot, uint8_t restart_cause);
+void pal_update_ts_sled(void);
+
+#endif /* __POWER_SIM_H__ */
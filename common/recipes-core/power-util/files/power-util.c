@@ -27,12 +27,32 @@
 #include <getopt.h>
 #include <stdbool.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef POWER_UTIL_SIM
+#include "power-sim.h"
+#else
 #include <openbmc/pal.h>
+#endif
 
 #define POWER_ON_STR        "on"
 #define POWER_OFF_STR       "off"
 
 #define MAX_RETRIES          10
+#define PWR_ON_RETRY_MS      3000
+
+#define MAX_SEQ_SLOTS        16
+#define WAIT_POLL_MIN_MS     20
+#define WAIT_POLL_MAX_MS     500
+#define DEF_STAGGER_MS       1000
+#define DEF_TIMEOUT_MS       30000
+#define DEF_CYCLE_OFF_MS     10000
+
+#define GPIO_VAL_PATH       "/sys/class/gpio/gpio%d/value"
+#define GPIO_EDGE_PATH      "/sys/class/gpio/gpio%d/edge"
+
+#define PWR_MASK(s)         (1 << (s))
 
 #ifndef PWR_OPTION_LIST
 #define PWR_OPTION_LIST "status, graceful-shutdown, off, on, reset, cycle, " \
@@ -55,10 +75,122 @@ enum {
   PWR_SLED_CYCLE
 };
 
+typedef struct {
+  uint8_t fru;
+  uint8_t opt;
+  uint8_t group;
+  const char *option;
+  pthread_t tid;
+  int ret;
+  bool timeout;
+  long long queue_ms;
+  long long off_ms;
+  long long on_ms;
+  long long total_ms;
+} slot_op_t;
+
+/* Shared between the slot workers of one multi-slot operation */
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pwr_seq_constraint_t limit;
+  long long next_on;
+  int running;
+  bool group_busy[256];
+} seq = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
 static void
 print_usage() {
   printf("Usage: power-util [ %s ] [ %s ]\nUsage: power-util sled-cycle\n",
       pal_server_list, pwr_option_list);
+  printf("Usage: power-util [ <fru>,<fru>... | all ] [ %s ]\n", pwr_option_list);
+}
+
+static long long
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int
+open_pwr_good(uint8_t fru) {
+  char path[64];
+  char buf[8];
+  int gpio, fd;
+
+  if (pal_get_pwr_good_gpio(fru, &gpio) < 0) {
+    return -1;
+  }
+
+  sprintf(path, GPIO_EDGE_PATH, gpio);
+  fd = open(path, O_WRONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  if (write(fd, "both", 4) != 4) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+
+  sprintf(path, GPIO_VAL_PATH, gpio);
+  fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    // Consume the current value so that poll() only reports new edges
+    read(fd, buf, sizeof(buf));
+  }
+  return fd;
+}
+
+/*
+ * Wait until the power status of fru is one of those in mask. Platforms
+ * exposing a power-good GPIO wake us on its edges, otherwise the status
+ * is polled with a backoff starting at WAIT_POLL_MIN_MS.
+ */
+static int
+wait_power_state(uint8_t fru, uint16_t mask, int timeout_ms) {
+  long long end = now_ms() + timeout_ms;
+  long long left;
+  int delay = WAIT_POLL_MIN_MS;
+  struct pollfd pfd;
+  uint8_t status;
+  char buf[8];
+  int fd, ret = -1;
+
+  fd = open_pwr_good(fru);
+  while (1) {
+    if (!pal_get_server_power(fru, &status) && (mask & PWR_MASK(status))) {
+      ret = 0;
+      break;
+    }
+
+    left = end - now_ms();
+    if (left <= 0) {
+      break;
+    }
+
+    if (fd >= 0) {
+      pfd.fd = fd;
+      pfd.events = POLLPRI | POLLERR;
+      if (poll(&pfd, 1, left < WAIT_POLL_MAX_MS ? left : WAIT_POLL_MAX_MS) > 0) {
+        lseek(fd, 0, SEEK_SET);
+        read(fd, buf, sizeof(buf));
+      }
+    } else {
+      usleep((left < delay ? left : delay) * 1000);
+      delay = (delay * 2 < WAIT_POLL_MAX_MS) ? delay * 2 : WAIT_POLL_MAX_MS;
+    }
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+  return ret;
 }
 
 static bool
@@ -119,9 +251,9 @@ get_power_opt(char *option, uint8_t *opt) {
   return 0;
 }
 
-//check power policy and power state to power on/off server after AC power restore
-void
-power_policy_control(uint8_t fru, char *last_ps) {
+// Whether the power restore policy powers the server on once 12V is back
+static bool
+policy_powers_on(uint8_t fru, char *last_ps) {
   uint8_t chassis_status[5] = {0};
   uint8_t chassis_status_length;
   uint8_t power_policy = POWER_CFG_UKNOWN;
@@ -141,12 +273,15 @@ power_policy_control(uint8_t fru, char *last_ps) {
       pal_get_last_pwr_state(fru, pwr_state);
       last_ps = pwr_state;
     }
-    if (!(strcmp(last_ps, "on"))) {
-      sleep(3);
-      pal_set_server_power(fru, SERVER_POWER_ON);
-    }
+    return !strcmp(last_ps, "on");
   }
-  else if(power_policy == POWER_CFG_ON) {
+  return power_policy == POWER_CFG_ON;
+}
+
+//check power policy and power state to power on/off server after AC power restore
+void
+power_policy_control(uint8_t fru, char *last_ps) {
+  if (policy_powers_on(fru, last_ps)) {
     sleep(3);
     pal_set_server_power(fru, SERVER_POWER_ON);
   }
@@ -170,24 +305,12 @@ static bool can_change_power(uint8_t fru)
 }
 
 static int
-power_util(uint8_t fru, uint8_t opt) {
-  int ret;
+power_op(uint8_t fru, uint8_t opt) {
+  int ret = -1;
   uint8_t status;
   int retries;
   char pwr_state[MAX_VALUE_LEN] = {0};
 
-  if (opt == PWR_SLED_CYCLE) {
-    for(fru = 1; fru <= MAX_NUM_FRUS; fru++) {
-      if (!can_change_power(fru)) {
-        return -1;
-      }
-    }
-  } else if (opt != PWR_STATUS) {
-    if (!can_change_power(fru)) {
-      return -1;
-    }
-  }
-
   switch(opt) {
     case PWR_STATUS:
       ret = pal_get_server_power(fru, &status);
@@ -281,14 +404,16 @@ power_util(uint8_t fru, uint8_t opt) {
       }
 
       for (retries = 0; retries < MAX_RETRIES; retries++) {
-         sleep(3);
-         ret = pal_get_server_power(fru, &status);
-         if ((ret >= 0) && (status == SERVER_POWER_ON)) {
+         if (!wait_power_state(fru, PWR_MASK(SERVER_POWER_ON), PWR_ON_RETRY_MS)) {
            syslog(LOG_CRIT, "SERVER_POWER_ON successful for FRU: %d", fru);
+           ret = 0;
            break;
          }
          ret = pal_set_server_power(fru, SERVER_POWER_ON);
       }
+      if (retries == MAX_RETRIES) {
+        ret = -1;
+      }
       if (ret < 0) {
         syslog(LOG_WARNING, "power_util: pal_set_server_power failed for"
           " fru %u", fru);
@@ -420,6 +545,281 @@ power_util(uint8_t fru, uint8_t opt) {
   return ret;
 }
 
+static int
+power_util(uint8_t fru, uint8_t opt) {
+
+  if (opt == PWR_SLED_CYCLE) {
+    for(fru = 1; fru <= MAX_NUM_FRUS; fru++) {
+      if (!can_change_power(fru)) {
+        return -1;
+      }
+    }
+  } else if (opt != PWR_STATUS) {
+    if (!can_change_power(fru)) {
+      return -1;
+    }
+  }
+
+  return power_op(fru, opt);
+}
+
+static uint8_t
+opt_to_cmd(uint8_t opt) {
+  switch (opt) {
+    case PWR_GRACEFUL_SHUTDOWN:
+      return SERVER_GRACEFUL_SHUTDOWN;
+    case PWR_OFF:
+      return SERVER_POWER_OFF;
+    case PWR_ON:
+      return SERVER_POWER_ON;
+    case PWR_RESET:
+      return SERVER_POWER_RESET;
+    case PWR_CYCLE:
+      return SERVER_POWER_CYCLE;
+    case PWR_12V_OFF:
+      return SERVER_12V_OFF;
+    case PWR_12V_ON:
+      return SERVER_12V_ON;
+    case PWR_12V_CYCLE:
+      return SERVER_12V_CYCLE;
+  }
+  return SERVER_POWER_OFF;
+}
+
+static void
+seq_acquire(slot_op_t *op) {
+  pthread_mutex_lock(&seq.lock);
+  while (seq.group_busy[op->group] ||
+         (seq.limit.max_parallel && seq.running >= seq.limit.max_parallel)) {
+    pthread_cond_wait(&seq.cond, &seq.lock);
+  }
+  seq.group_busy[op->group] = true;
+  seq.running++;
+  pthread_mutex_unlock(&seq.lock);
+}
+
+static void
+seq_release(slot_op_t *op) {
+  pthread_mutex_lock(&seq.lock);
+  seq.group_busy[op->group] = false;
+  seq.running--;
+  pthread_cond_broadcast(&seq.cond);
+  pthread_mutex_unlock(&seq.lock);
+}
+
+// Hold a slot back until the previous power-on is stagger_ms old
+static void
+seq_stagger(slot_op_t *op) {
+  long long start = now_ms();
+  long long wait;
+
+  pthread_mutex_lock(&seq.lock);
+  wait = seq.next_on - start;
+  if (wait < 0) {
+    wait = 0;
+  }
+  seq.next_on = start + wait + seq.limit.stagger_ms;
+  pthread_mutex_unlock(&seq.lock);
+
+  if (wait > 0) {
+    usleep(wait * 1000);
+  }
+  op->queue_ms += now_ms() - start;
+}
+
+// Run one phase of a slot operation and confirm the state it leads to
+static int
+slot_phase(slot_op_t *op, uint8_t opt, uint16_t mask, long long *elapsed) {
+  long long start = now_ms();
+  int ret;
+
+  ret = power_op(op->fru, opt);
+  if (ret >= 0 && mask && wait_power_state(op->fru, mask, seq.limit.timeout_ms)) {
+    syslog(LOG_WARNING, "power_util: fru %u did not reach the requested"
+      " power state in %u ms", op->fru, seq.limit.timeout_ms);
+    op->timeout = true;
+    ret = -1;
+  }
+  *elapsed = now_ms() - start;
+  return ret;
+}
+
+// Keep a slot off for the platform's power cycle time before powering on
+static void
+cycle_hold(slot_op_t *op) {
+  long long start = now_ms();
+
+  if (seq.limit.cycle_off_ms) {
+    usleep(seq.limit.cycle_off_ms * 1000);
+  }
+  op->off_ms += now_ms() - start;
+}
+
+// State a slot settles in once its 12V is on again
+static uint16_t
+restored_mask(uint8_t fru) {
+  return PWR_MASK(policy_powers_on(fru, NULL) ? SERVER_POWER_ON : SERVER_POWER_OFF);
+}
+
+static void *
+slot_worker(void *arg) {
+  slot_op_t *op = (slot_op_t *)arg;
+  uint16_t off_mask = PWR_MASK(SERVER_POWER_OFF) | PWR_MASK(SERVER_12V_OFF);
+  uint16_t on_mask = PWR_MASK(SERVER_POWER_ON);
+  uint16_t mask;
+  uint8_t status;
+  long long start = now_ms();
+
+  seq_acquire(op);
+  op->queue_ms = now_ms() - start;
+
+  switch (op->opt) {
+    case PWR_STATUS:
+      op->ret = power_op(op->fru, op->opt);
+      break;
+    case PWR_GRACEFUL_SHUTDOWN:
+    case PWR_OFF:
+      op->ret = slot_phase(op, op->opt, off_mask, &op->off_ms);
+      break;
+    case PWR_12V_OFF:
+      op->ret = slot_phase(op, op->opt, PWR_MASK(SERVER_12V_OFF), &op->off_ms);
+      break;
+    case PWR_ON:
+      // PWR_ON confirms power good itself and re-issues the request
+      seq_stagger(op);
+      op->ret = slot_phase(op, op->opt, 0, &op->on_ms);
+      break;
+    case PWR_RESET:
+      // Power good stays asserted through a reset, nothing to confirm
+      op->ret = slot_phase(op, op->opt, 0, &op->on_ms);
+      break;
+    case PWR_12V_ON:
+      // A slot already on 12V stays as it is, otherwise the power restore
+      // policy decides whether the server follows
+      if (!pal_get_server_power(op->fru, &status) && status != SERVER_12V_OFF) {
+        mask = PWR_MASK(status);
+      } else {
+        mask = restored_mask(op->fru);
+      }
+      seq_stagger(op);
+      op->ret = slot_phase(op, op->opt, mask, &op->on_ms);
+      break;
+    case PWR_12V_CYCLE:
+      // Confirm each half, the platform's 12V cycle returns only once it
+      // is over
+      mask = restored_mask(op->fru);
+      op->ret = slot_phase(op, PWR_12V_OFF, PWR_MASK(SERVER_12V_OFF), &op->off_ms);
+      if (op->ret >= 0) {
+        cycle_hold(op);
+        seq_stagger(op);
+        op->ret = slot_phase(op, PWR_12V_ON, mask, &op->on_ms);
+      }
+      break;
+    case PWR_CYCLE:
+      // Confirm the slot off, then on again. An already off slot is only
+      // powered on, as the platform's power cycle does.
+      op->ret = 0;
+      if (pal_get_server_power(op->fru, &status) || status != SERVER_POWER_OFF) {
+        op->ret = slot_phase(op, PWR_OFF, off_mask, &op->off_ms);
+        if (op->ret >= 0) {
+          cycle_hold(op);
+        }
+      }
+      if (op->ret >= 0) {
+        seq_stagger(op);
+        op->ret = slot_phase(op, PWR_ON, on_mask, &op->on_ms);
+      }
+      if (op->ret >= 0) {
+        pal_set_restart_cause(op->fru, RESTART_CAUSE_IPMI_CHASSIS_CMD);
+      }
+      break;
+  }
+
+  seq_release(op);
+  op->total_ms = now_ms() - start;
+  return NULL;
+}
+
+static void
+print_phase(long long ms) {
+  if (ms) {
+    printf("%10lld", ms);
+  } else {
+    printf("%10s", "-");
+  }
+}
+
+static void
+print_report(slot_op_t *ops, int count) {
+  char fruname[32];
+  int i;
+
+  printf("\n%-10s%-20s%-10s%10s%10s%10s%10s\n", "FRU", "Operation", "Result",
+      "Queued", "Off", "On", "Total");
+  for (i = 0; i < count; i++) {
+    if (pal_get_fru_name(ops[i].fru, fruname)) {
+      sprintf(fruname, "fru%d", ops[i].fru);
+    }
+    printf("%-10s%-20s%-10s%10lld", fruname, ops[i].option,
+        ops[i].ret >= 0 ? "OK" : ops[i].timeout ? "TIMEOUT" : "FAILED",
+        ops[i].queue_ms);
+    print_phase(ops[i].off_ms);
+    print_phase(ops[i].on_ms);
+    printf("%10lld\n", ops[i].total_ms);
+  }
+  printf("(times in ms)\n");
+}
+
+/*
+ * Apply one operation to several slots at once. Slots are sequenced
+ * concurrently within the constraints declared by the platform: slots of
+ * the same group run one after the other, at most max_parallel run at a
+ * time and power-ons are staggered by stagger_ms.
+ */
+static int
+power_util_multi(uint8_t *frus, int count, uint8_t opt, const char *option) {
+  slot_op_t ops[MAX_SEQ_SLOTS] = {0};
+  uint8_t cmd = opt_to_cmd(opt);
+  int i, ret = 0;
+
+  if (pal_get_pwr_seq_constraint(cmd, &seq.limit)) {
+    seq.limit.stagger_ms = DEF_STAGGER_MS;
+    seq.limit.max_parallel = 0;
+    seq.limit.timeout_ms = DEF_TIMEOUT_MS;
+    seq.limit.cycle_off_ms = DEF_CYCLE_OFF_MS;
+  }
+  if (!seq.limit.timeout_ms) {
+    seq.limit.timeout_ms = DEF_TIMEOUT_MS;
+  }
+
+  for (i = 0; i < count; i++) {
+    ops[i].fru = frus[i];
+    ops[i].opt = opt;
+    ops[i].option = option;
+    if (pal_get_pwr_seq_group(frus[i], cmd, &ops[i].group)) {
+      ops[i].group = frus[i];
+    }
+    if (pthread_create(&ops[i].tid, NULL, slot_worker, &ops[i])) {
+      ops[i].ret = -1;
+      ops[i].tid = 0;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    if (ops[i].tid) {
+      pthread_join(ops[i].tid, NULL);
+    }
+    if (ops[i].ret < 0) {
+      ret = -1;
+    }
+  }
+
+  if (opt != PWR_STATUS) {
+    print_report(ops, count);
+  }
+  return ret;
+}
+
 static int
 add_process_running_flag(uint8_t slot_id, uint8_t opt) {
   int pid_file;
@@ -448,6 +848,75 @@ rm_process_running_flag(uint8_t slot_id, uint8_t opt) {
   }
 }
 
+static int
+power_util_slots(char *list, uint8_t opt, const char *option) {
+  uint8_t frus[MAX_SEQ_SLOTS];
+  char fru_list[256];
+  bool all = !strcmp(list, "all");
+  uint8_t fru, status;
+  int count = 0;
+  int i, ret;
+  char *pch;
+
+  if (all) {
+    snprintf(fru_list, sizeof(fru_list), "%s", pal_server_list);
+  } else {
+    snprintf(fru_list, sizeof(fru_list), "%s", list);
+  }
+
+  pch = strtok(fru_list, ", ");
+  while (pch != NULL) {
+    if (pal_get_fru_id(pch, &fru) < 0) {
+      printf("Wrong fru: %s\n", pch);
+      print_usage();
+      return -1;
+    }
+    if (pal_is_fru_prsnt(fru, &status) < 0 || status == 0) {
+      // An empty slot is only an error when asked for explicitly
+      if (!all) {
+        printf("%s is empty!\n", pch);
+        print_usage();
+        return -1;
+      }
+    } else {
+      for (i = 0; i < count && frus[i] != fru; i++);
+      if (i == count) {
+        if (count == MAX_SEQ_SLOTS) {
+          printf("Too many frus, at most %d at a time\n", MAX_SEQ_SLOTS);
+          return -1;
+        }
+        frus[count++] = fru;
+      }
+    }
+    pch = strtok(NULL, ", ");
+  }
+
+  if (count == 0) {
+    printf("No fru to operate on\n");
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    if (opt != PWR_STATUS && !can_change_power(frus[i])) {
+      return -1;
+    }
+    if (add_process_running_flag(frus[i], opt) < 0) {
+      printf("power_util: another instance is running for FRU:%d...\n", frus[i]);
+      while (i-- > 0) {
+        rm_process_running_flag(frus[i], opt);
+      }
+      exit(-2);
+    }
+  }
+
+  ret = power_util_multi(frus, count, opt, option);
+
+  for (i = 0; i < count; i++) {
+    rm_process_running_flag(frus[i], opt);
+  }
+  return ret;
+}
+
 int
 main(int argc, char **argv) {
 
@@ -472,6 +941,10 @@ main(int argc, char **argv) {
     exit(-1);
   }
 
+  if (argc > 2 && (!strcmp(argv[1], "all") || strchr(argv[1], ','))) {
+    return power_util_slots(argv[1], opt, option);
+  }
+
   if (argc > 2) {
     ret = pal_get_fru_id(argv[1], &fru);
     if (ret < 0) {
@@ -30,6 +30,8 @@
 #include <pthread.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <limits.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/sdr.h>
 #include <openbmc/pal.h>
@@ -44,6 +46,18 @@
 static thresh_sensor_t g_snr[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
 static thresh_sensor_t g_aggregate_snr[MAX_SENSOR_NUM] = {0};
 
+/*
+ * Threshold overrides are published by threshold-util as a new version of
+ * the FRU's table file. The watch thread only marks the FRU, the monitor
+ * thread applies the table before its next sweep.
+ */
+static volatile int g_thresh_pending[MAX_NUM_FRUS] = {0};
+static volatile int g_thresh_poll = 0;
+// Sensor states to clear, set by the health monitor after log-util --clear
+static volatile int g_clear_pending[MAX_NUM_FRUS] = {0};
+static int g_thresh_mode[MAX_NUM_FRUS] = {0};
+static uint32_t g_thresh_ver[MAX_NUM_FRUS] = {0};
+
 static void
 print_usage() {
     printf("Usage: sensord <options>\n");
@@ -71,6 +85,129 @@ get_struct_thresh_sensor(uint8_t fru) {
   return snr;
 }
 
+/*
+ * Compiled threshold descriptor of a sensor. The enabled upper bounds are
+ * kept in ascending and the lower bounds in descending order of value with
+ * their hysteresis applied deassert points, the bands count how many of
+ * them are asserted. win_lo/win_hi enclose the readings that leave the
+ * current band unchanged.
+ */
+typedef struct {
+  float up_set[3];
+  float up_clr[3];
+  float lo_set[3];
+  float lo_clr[3];
+  float win_lo;
+  float win_hi;
+  uint8_t up_id[3];
+  uint8_t lo_id[3];
+  uint8_t nup;
+  uint8_t nlo;
+  uint8_t up_band;
+  uint8_t lo_band;
+} thresh_desc_t;
+
+static thresh_desc_t g_desc[MAX_NUM_FRUS][MAX_SENSOR_NUM];
+static thresh_desc_t g_aggregate_desc[MAX_SENSOR_NUM];
+
+/* Sensors of each FRU with a non-zero curr_state, kept up to date on change */
+static int g_fru_bad_cnt[MAX_NUM_FRUS] = {0};
+
+static thresh_desc_t *
+get_struct_thresh_desc(uint8_t fru) {
+
+  if (fru == AGGREGATE_SENSOR_FRU_ID) {
+    return g_aggregate_desc;
+  }
+
+  if (fru < 1 || fru > MAX_NUM_FRUS) {
+    return NULL;
+  }
+  return g_desc[fru-1];
+}
+
+/* Update curr_state of a sensor and the FRU's count of unhealthy sensors */
+static void
+set_snr_state(uint8_t fru, thresh_sensor_t *snr, int state) {
+
+  if (fru >= 1 && fru <= MAX_NUM_FRUS && !snr->curr_state != !state) {
+    __sync_fetch_and_add(&g_fru_bad_cnt[fru-1], state ? 1 : -1);
+  }
+  snr->curr_state = state;
+}
+
+static void
+thresh_desc_window(thresh_desc_t *d) {
+
+  // A reading at or above win_hi / at or below win_lo may change a band
+  d->win_hi = INFINITY;
+  d->win_lo = -INFINITY;
+  if (d->up_band < d->nup)
+    d->win_hi = d->up_set[d->up_band];
+  if (d->lo_band > 0)
+    d->win_hi = fminf(d->win_hi, nextafterf(d->lo_clr[d->lo_band-1], INFINITY));
+  if (d->lo_band < d->nlo)
+    d->win_lo = d->lo_set[d->lo_band];
+  if (d->up_band > 0)
+    d->win_lo = fmaxf(d->win_lo, nextafterf(d->up_clr[d->up_band-1], -INFINITY));
+}
+
+static void
+thresh_desc_add(float *set, float *clr, uint8_t *id, uint8_t *n,
+                float val, float hyst, uint8_t thresh, int upper) {
+  int i = *n;
+
+  // Keep upper bounds ascending and lower bounds descending by value
+  while (i > 0 && (upper ? set[i-1] > val : set[i-1] < val)) {
+    set[i] = set[i-1];
+    clr[i] = clr[i-1];
+    id[i] = id[i-1];
+    i--;
+  }
+  set[i] = val;
+  clr[i] = upper ? val - hyst : val + hyst;
+  id[i] = thresh;
+  (*n)++;
+}
+
+/*
+ * Compile the descriptor of a sensor from its thresholds. The bands are
+ * derived from curr_state so a recompile keeps asserted events asserted.
+ */
+static void
+compile_snr_thresh(uint8_t fru, uint8_t snr_num) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(fru);
+  thresh_desc_t *d = get_struct_thresh_desc(fru);
+  thresh_sensor_t *s;
+
+  if (snr == NULL || d == NULL) {
+    return;
+  }
+  s = &snr[snr_num];
+  d = &d[snr_num];
+  memset(d, 0, sizeof(thresh_desc_t));
+
+  if (GETBIT(s->flag, UNC_THRESH))
+    thresh_desc_add(d->up_set, d->up_clr, d->up_id, &d->nup, s->unc_thresh, s->neg_hyst, UNC_THRESH, 1);
+  if (GETBIT(s->flag, UCR_THRESH))
+    thresh_desc_add(d->up_set, d->up_clr, d->up_id, &d->nup, s->ucr_thresh, s->neg_hyst, UCR_THRESH, 1);
+  if (GETBIT(s->flag, UNR_THRESH))
+    thresh_desc_add(d->up_set, d->up_clr, d->up_id, &d->nup, s->unr_thresh, s->neg_hyst, UNR_THRESH, 1);
+  if (GETBIT(s->flag, LNC_THRESH))
+    thresh_desc_add(d->lo_set, d->lo_clr, d->lo_id, &d->nlo, s->lnc_thresh, s->pos_hyst, LNC_THRESH, 0);
+  if (GETBIT(s->flag, LCR_THRESH))
+    thresh_desc_add(d->lo_set, d->lo_clr, d->lo_id, &d->nlo, s->lcr_thresh, s->pos_hyst, LCR_THRESH, 0);
+  if (GETBIT(s->flag, LNR_THRESH))
+    thresh_desc_add(d->lo_set, d->lo_clr, d->lo_id, &d->nlo, s->lnr_thresh, s->pos_hyst, LNR_THRESH, 0);
+
+  while (d->up_band < d->nup && GETBIT(s->curr_state, d->up_id[d->up_band]))
+    d->up_band++;
+  while (d->lo_band < d->nlo && GETBIT(s->curr_state, d->lo_id[d->lo_band]))
+    d->lo_band++;
+
+  thresh_desc_window(d);
+}
+
 /* Initialize all thresh_sensor_t structs for all the Yosemite sensors */
 static int
 init_fru_snr_thresh(uint8_t fru) {
@@ -107,16 +244,21 @@ init_fru_snr_thresh(uint8_t fru) {
     }
 
     pal_init_sensor_check(fru, snr_num, (void *)&snr[snr_num]);
+    compile_snr_thresh(fru, snr_num);
   }
 
-  if (access(THRESHOLD_PATH, F_OK) == -1) {
-        mkdir(THRESHOLD_PATH, 0777);
-  }
   ret = pal_copy_all_thresh_to_file(fru, snr);
   if (ret < 0) {
     syslog(LOG_WARNING, "%s: Fail to copy thresh to file for FRU: %d", __func__, fru);
     return ret;
   }
+
+  // Any override table present is applied before the first sweep
+  if (fru != AGGREGATE_SENSOR_FRU_ID) {
+    g_thresh_mode[fru-1] = SENSORD_MODE_NORMAL;
+    g_thresh_ver[fru-1] = 0;
+    g_thresh_pending[fru-1] = 1;
+  }
   return 0;
 }
 
@@ -138,299 +280,307 @@ sensor_raw_read_helper(uint8_t fru, uint8_t snr_num, float *val)
   return ret;
 }
 
-static float
-get_snr_thresh_val(uint8_t fru, uint8_t snr_num, uint8_t thresh) {
-
-  float val;
-  thresh_sensor_t *snr;
-
-  snr = get_struct_thresh_sensor(fru);
+static const char *
+get_thresh_name(uint8_t thresh) {
 
   switch (thresh) {
-    case UCR_THRESH:
-      val = snr[snr_num].ucr_thresh;
-      break;
     case UNC_THRESH:
-      val = snr[snr_num].unc_thresh;
-      break;
+      return "Upper Non Critical";
+    case UCR_THRESH:
+      return "Upper Critical";
     case UNR_THRESH:
-      val = snr[snr_num].unr_thresh;
-      break;
-    case LCR_THRESH:
-      val = snr[snr_num].lcr_thresh;
-      break;
+      return "Upper Non Recoverable";
     case LNC_THRESH:
-      val = snr[snr_num].lnc_thresh;
-      break;
+      return "Lower Non Critical";
+    case LCR_THRESH:
+      return "Lower Critical";
     case LNR_THRESH:
-      val = snr[snr_num].lnr_thresh;
-      break;
+      return "Lower Non Recoverable";
     default:
-      syslog(LOG_WARNING, "get_snr_thresh_val: wrong thresh enum value");
+      syslog(LOG_WARNING, "get_thresh_name: wrong thresh enum value");
       exit(-1);
   }
-
-  return val;
 }
 
 /*
- * Check the curr sensor values against the threshold and
- * if the curr val has deasserted, log it.
+ * Re-read the sensor retry times, the crossing is confirmed when every
+ * reading is still at or beyond the bound (above: upwards, else downwards).
+ * Returns 1 if confirmed, 0 if not and -1 on a read failure.
  */
 static int
-check_thresh_deassert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
-  float *curr_val) {
-  uint8_t curr_state = 0;
-  float thresh_val;
-  char thresh_name[100];
-  thresh_sensor_t *snr;
-  uint8_t retry = 0;
+confirm_thresh_cross(uint8_t fru, uint8_t snr_num, int retry, float bound,
+  bool above, bool strict, float *curr_val) {
   int ret;
 
-  snr = get_struct_thresh_sensor(fru);
-
-  if (!GETBIT(snr[snr_num].flag, thresh) ||
-      !GETBIT(snr[snr_num].curr_state, thresh))
-    return 0;
-
-  thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
+  while (retry-- > 0) {
+    msleep(50);
+    ret = sensor_raw_read_helper(fru, snr_num, curr_val);
+    if (ret < 0)
+      return -1;
 
-  while (retry <= MAX_SENSOR_CHECK_RETRY) {
-    switch (thresh) {
+    if (above ? (strict ? *curr_val <= bound : *curr_val < bound) :
+                (strict ? *curr_val >= bound : *curr_val > bound))
+      return 0;
+  }
 
-      case UNR_THRESH:
-      case UCR_THRESH:
-      case UNC_THRESH:
-        if (*curr_val >= (thresh_val - snr[snr_num].neg_hyst))
-          return 0;
-        break;
+  return 1;
+}
 
-      case LNR_THRESH:
-      case LCR_THRESH:
-      case LNC_THRESH:
-        if (*curr_val <= (thresh_val + snr[snr_num].pos_hyst))
-          return 0;
-    }
+static void
+log_thresh_event(uint8_t fru, uint8_t snr_num, uint8_t thresh,
+  float thresh_val, float curr_val, bool assert) {
+  thresh_sensor_t *snr = &get_struct_thresh_sensor(fru)[snr_num];
 
-    if (retry < MAX_SENSOR_CHECK_RETRY) {
-      msleep(50);
-      ret = sensor_raw_read_helper(fru, snr_num, curr_val);
-      if (ret < 0)
-        return -1;
-    }
-    retry++;
+  pal_update_ts_sled();
+  if (assert) {
+    syslog(LOG_CRIT, "ASSERT: %s threshold - raised - FRU: %d, num: 0x%X"
+        " curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s",
+        get_thresh_name(thresh), fru, snr_num, curr_val, snr->units,
+        thresh_val, snr->units, snr->name);
+    pal_sensor_assert_handle(fru, snr_num, curr_val, thresh);
+  } else {
+    syslog(LOG_CRIT, "DEASSERT: %s threshold - settled - FRU: %d, num: 0x%X "
+        "curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s",
+        get_thresh_name(thresh), fru, snr_num, curr_val, snr->units,
+        thresh_val, snr->units, snr->name);
+    pal_sensor_deassert_handle(fru, snr_num, curr_val, thresh);
   }
+}
 
-  switch (thresh) {
-    case UNC_THRESH:
-        curr_state = ~(SETBIT(curr_state, UNR_THRESH) |
-            SETBIT(curr_state, UCR_THRESH) |
-            SETBIT(curr_state, UNC_THRESH));
-        sprintf(thresh_name, "Upper Non Critical");
-      break;
+/*
+ * Evaluate a reading against the compiled thresholds of the sensor. While
+ * the reading stays inside the current band this is two comparisons, events
+ * are only generated when a band is left. An assert needs the crossing to
+ * hold over MAX_ASSERT_CHECK_RETRY re-reads, a deassert over
+ * MAX_SENSOR_CHECK_RETRY re-reads, as before.
+ */
+static int
+check_thresh(uint8_t fru, uint8_t snr_num, float *curr_val) {
+  thresh_sensor_t *snr = &get_struct_thresh_sensor(fru)[snr_num];
+  thresh_desc_t *d = &get_struct_thresh_desc(fru)[snr_num];
+  int state, ret = 0, i;
+  uint8_t thresh;
 
-    case UCR_THRESH:
-        curr_state = ~(SETBIT(curr_state, UCR_THRESH) |
-            SETBIT(curr_state, UNR_THRESH));
-        sprintf(thresh_name, "Upper Critical");
-      break;
+  if (*curr_val < d->win_hi && *curr_val > d->win_lo)
+    return 0;
 
-    case UNR_THRESH:
-        curr_state = ~(SETBIT(curr_state, UNR_THRESH));
-        sprintf(thresh_name, "Upper Non Recoverable");
+  // Asserts, from the least to the most severe bound
+  while (d->up_band < d->nup && *curr_val >= d->up_set[d->up_band]) {
+    ret = confirm_thresh_cross(fru, snr_num, MAX_ASSERT_CHECK_RETRY,
+                               d->up_set[d->up_band], true, false, curr_val);
+    if (ret <= 0)
       break;
-
-    case LNC_THRESH:
-        curr_state = ~(SETBIT(curr_state, LNR_THRESH) |
-            SETBIT(curr_state, LCR_THRESH) |
-            SETBIT(curr_state, LNC_THRESH));
-        sprintf(thresh_name, "Lower Non Critical");
+    state = snr->curr_state;
+    for (i = 0; i <= d->up_band; i++)
+      state = SETBIT(state, d->up_id[i]);
+    set_snr_state(fru, snr, state);
+    thresh = d->up_id[d->up_band++];
+    log_thresh_event(fru, snr_num, thresh, d->up_set[d->up_band-1], *curr_val, true);
+  }
+  if (ret < 0)
+    goto out;
+
+  while (d->lo_band < d->nlo && *curr_val <= d->lo_set[d->lo_band]) {
+    ret = confirm_thresh_cross(fru, snr_num, MAX_ASSERT_CHECK_RETRY,
+                               d->lo_set[d->lo_band], false, false, curr_val);
+    if (ret <= 0)
       break;
-
-    case LCR_THRESH:
-        curr_state = ~(SETBIT(curr_state, LCR_THRESH) |
-            SETBIT(curr_state, LNR_THRESH));
-        sprintf(thresh_name, "Lower Critical");
+    state = snr->curr_state;
+    for (i = 0; i <= d->lo_band; i++)
+      state = SETBIT(state, d->lo_id[i]);
+    set_snr_state(fru, snr, state);
+    thresh = d->lo_id[d->lo_band++];
+    log_thresh_event(fru, snr_num, thresh, d->lo_set[d->lo_band-1], *curr_val, true);
+  }
+  if (ret < 0)
+    goto out;
+
+  // Deasserts, from the most to the least severe bound
+  while (d->up_band > 0 && *curr_val < d->up_clr[d->up_band-1]) {
+    ret = confirm_thresh_cross(fru, snr_num, MAX_SENSOR_CHECK_RETRY,
+                               d->up_clr[d->up_band-1], false, true, curr_val);
+    if (ret <= 0)
       break;
-
-    case LNR_THRESH:
-        curr_state = ~(SETBIT(curr_state, LNR_THRESH));
-        sprintf(thresh_name, "Lower Non Recoverable");
+    thresh = d->up_id[--d->up_band];
+    state = snr->curr_state;
+    for (i = d->up_band; i < d->nup; i++)
+      state = CLEARBIT(state, d->up_id[i]);
+    set_snr_state(fru, snr, state);
+    log_thresh_event(fru, snr_num, thresh, d->up_set[d->up_band], *curr_val, false);
+  }
+  if (ret < 0)
+    goto out;
+
+  while (d->lo_band > 0 && *curr_val > d->lo_clr[d->lo_band-1]) {
+    ret = confirm_thresh_cross(fru, snr_num, MAX_SENSOR_CHECK_RETRY,
+                               d->lo_clr[d->lo_band-1], true, true, curr_val);
+    if (ret <= 0)
       break;
-
-    default:
-      syslog(LOG_WARNING, "get_snr_thresh_val: wrong thresh enum value");
-      exit(-1);
-  }
-
-  if (curr_state) {
-    snr[snr_num].curr_state &= curr_state;
-    pal_update_ts_sled();
-    syslog(LOG_CRIT, "DEASSERT: %s threshold - settled - FRU: %d, num: 0x%X "
-        "curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s",thresh_name,
-        fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
-        snr[snr_num].units, snr[snr_num].name);
-    pal_sensor_deassert_handle(fru, snr_num, *curr_val, thresh);
+    thresh = d->lo_id[--d->lo_band];
+    state = snr->curr_state;
+    for (i = d->lo_band; i < d->nlo; i++)
+      state = CLEARBIT(state, d->lo_id[i]);
+    set_snr_state(fru, snr, state);
+    log_thresh_event(fru, snr_num, thresh, d->lo_set[d->lo_band], *curr_val, false);
   }
 
-  return 0;
+out:
+  thresh_desc_window(d);
+  return (ret < 0) ? -1 : 0;
 }
 
-
-/*
- * Check the curr sensor values against the threshold and
- * if the curr val has asserted, log it.
- */
+/* Apply the override table, or the defaults if there is none, in one go */
 static int
-check_thresh_assert(uint8_t fru, uint8_t snr_num, uint8_t thresh,
-  float *curr_val) {
-  uint8_t curr_state = 0;
-  float thresh_val;
-  char thresh_name[100];
+reinit_snr_threshold(uint8_t fru) {
+  int i, sensor_cnt, curr_state, mode;
+  uint8_t snr_num;
+  uint8_t *sensor_list;
   thresh_sensor_t *snr;
-  uint8_t retry = 0;
-  int ret;
+  thresh_tbl_t *tbl;
+  size_t size;
 
   snr = get_struct_thresh_sensor(fru);
-
-  if (!GETBIT(snr[snr_num].flag, thresh) ||
-      GETBIT(snr[snr_num].curr_state, thresh))
-    return 0;
-
-  thresh_val = get_snr_thresh_val(fru, snr_num, thresh);
-
-  while (retry <= MAX_ASSERT_CHECK_RETRY) {
-    switch (thresh) {
-      case UNR_THRESH:
-      case UCR_THRESH:
-      case UNC_THRESH:
-        if (*curr_val < thresh_val) {
-          return 0;
-        }
-        break;
-      case LNR_THRESH:
-      case LCR_THRESH:
-      case LNC_THRESH:
-        if (*curr_val > thresh_val) {
-          return 0;
-        }
-        break;
-    }
-
-    if (retry < MAX_ASSERT_CHECK_RETRY) {
-      msleep(50);
-      ret = sensor_raw_read_helper(fru, snr_num, curr_val);
-      if (ret < 0)
-        return -1;
-    }
-    retry++;
+  if (snr == NULL) {
+    return -1;
   }
 
-  switch (thresh) {
-    case UNR_THRESH:
-        curr_state = (SETBIT(curr_state, UNR_THRESH) |
-            SETBIT(curr_state, UCR_THRESH) |
-            SETBIT(curr_state, UNC_THRESH));
-        sprintf(thresh_name, "Upper Non Recoverable");
-      break;
-
-    case UCR_THRESH:
-        curr_state = (SETBIT(curr_state, UCR_THRESH) |
-            SETBIT(curr_state, UNC_THRESH));
-        sprintf(thresh_name, "Upper Critical");
-      break;
-
-    case UNC_THRESH:
-        curr_state = (SETBIT(curr_state, UNC_THRESH));
-        sprintf(thresh_name, "Upper Non Critical");
-      break;
-
-    case LNR_THRESH:
-        curr_state = (SETBIT(curr_state, LNR_THRESH) |
-            SETBIT(curr_state, LCR_THRESH) |
-            SETBIT(curr_state, LNC_THRESH));
-        sprintf(thresh_name, "Lower Non Recoverable");
-      break;
+  if (pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt) < 0) {
+    return -1;
+  }
 
-    case LCR_THRESH:
-        curr_state = (SETBIT(curr_state, LCR_THRESH) |
-            SETBIT(curr_state, LNC_THRESH));
-        sprintf(thresh_name, "Lower Critical");
-      break;
+  mode = SENSORD_MODE_TESTING;
+  tbl = pal_thresh_tbl_map(fru, mode, &size);
+  if (tbl == NULL) {
+    mode = SENSORD_MODE_NORMAL;
+    tbl = pal_thresh_tbl_map(fru, mode, &size);
+  }
+  if (tbl == NULL) {
+    syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
+    return -1;
+  }
 
-    case LNC_THRESH:
-        curr_state = (SETBIT(curr_state, LNC_THRESH));
-        sprintf(thresh_name, "Lower Non Critical");
-      break;
+  // Nothing changed since the last apply
+  if (mode == g_thresh_mode[fru-1] && tbl->version == g_thresh_ver[fru-1]) {
+    pal_thresh_tbl_unmap(tbl, size);
+    return 0;
+  }
 
-    default:
-      syslog(LOG_WARNING, "get_snr_thresh_val: wrong thresh enum value");
-      exit(-1);
+  for (i = 0; i < sensor_cnt && i < (int)tbl->count; i++) {
+    snr_num = sensor_list[i];
+    curr_state = snr[snr_num].curr_state;
+    memcpy(&snr[snr_num], THRESH_TBL_ENTRY(tbl, i), sizeof(thresh_sensor_t));
+    snr[snr_num].curr_state = curr_state;
+    compile_snr_thresh(fru, snr_num);
   }
 
-  if (curr_state) {
-    curr_state &= snr[snr_num].flag;
-    snr[snr_num].curr_state |= curr_state;
-    pal_update_ts_sled();
-    syslog(LOG_CRIT, "ASSERT: %s threshold - raised - FRU: %d, num: 0x%X"
-        " curr_val: %.2f %s, thresh_val: %.2f %s, snr: %-16s", thresh_name,
-        fru, snr_num, *curr_val, snr[snr_num].units, thresh_val,
-        snr[snr_num].units, snr[snr_num].name);
-    pal_sensor_assert_handle(fru, snr_num, *curr_val, thresh);
+  if (mode != g_thresh_mode[fru-1] || mode == SENSORD_MODE_TESTING) {
+    syslog(LOG_INFO, "%s: fru%d thresholds %s (version %u)", __func__, fru,
+           (mode == SENSORD_MODE_TESTING) ? "overridden" : "restored", tbl->version);
   }
+  g_thresh_mode[fru-1] = mode;
+  g_thresh_ver[fru-1] = tbl->version;
+  pal_thresh_tbl_unmap(tbl, size);
 
   return 0;
 }
 
 static int
-reinit_snr_threshold(uint8_t fru, int mode) {
-  int ret = 0;
-  thresh_sensor_t *snr;
+thresh_reinit_chk(uint8_t fru) {
 
-  snr = get_struct_thresh_sensor(fru);
-  if (snr == NULL) {
-#ifdef DEBUG
-    syslog(LOG_WARNING, "%s: get_struct_thresh_sensor failed",__func__);
-#endif /* DEBUG */
+  // Without a working watch, fall back to checking every sweep
+  if (!g_thresh_pending[fru-1] && !g_thresh_poll) {
+    return 0;
   }
-  ret = pal_get_all_thresh_from_file(fru, snr, mode);
-  if (0 != ret) {
-    syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
-    return -1;
+  g_thresh_pending[fru-1] = 0;
+
+  return reinit_snr_threshold(fru);
+}
+
+/*
+ * Clears the asserted states of a FRU so that they are asserted and logged
+ * again. Runs in the FRU's monitor thread between sweeps, which is the only
+ * one using the compiled thresholds in check_thresh().
+ */
+static void
+snr_clear_chk(uint8_t fru) {
+  thresh_sensor_t *snr;
+  int num;
+
+  if (!g_clear_pending[fru-1]) {
+    return;
   }
+  g_clear_pending[fru-1] = 0;
 
-  return 0;
+  snr = get_struct_thresh_sensor(fru);
+  for (num = 0; num < MAX_SENSOR_NUM; num++) {
+    if (snr[num].curr_state) {
+      set_snr_state(fru, &snr[num], 0);
+      compile_snr_thresh(fru, num);
+    }
+  }
 }
 
-static int
-thresh_reinit_chk(uint8_t fru) {
-  int ret;
-  char fpath[64] = {0};
-  char initpath[64] = {0};
-  char fru_name[8];
+/* Marks FRUs whose threshold table was replaced or removed */
+static void *
+thresh_watch_monitor(void *unused) {
+  char tbl_name[MAX_NUM_FRUS][64];
+  char fru_name[16];
+  char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  char *slash;
+  ssize_t len;
+  int fd, i;
+  uint8_t fru;
 
-  ret = pal_get_fru_name(fru, fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n", __func__, fru);
-    return -1;
+  memset(tbl_name, 0, sizeof(tbl_name));
+  for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
+    if (pal_get_fru_name(fru, fru_name) == 0) {
+      snprintf(tbl_name[fru-1], sizeof(tbl_name[0]), THRESHOLD_BIN, fru_name);
+      slash = strrchr(tbl_name[fru-1], '/');
+      memmove(tbl_name[fru-1], slash + 1, strlen(slash));
+    }
+  }
+
+  fd = inotify_init();
+  if (fd < 0 || inotify_add_watch(fd, THRESHOLD_PATH,
+                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+    syslog(LOG_WARNING, "%s: inotify on %s failed, polling thresholds", __func__, THRESHOLD_PATH);
+    g_thresh_poll = 1;
+    pthread_exit(NULL);
   }
 
-  sprintf(fpath, THRESHOLD_BIN, fru_name);
-  sprintf(initpath, THRESHOLD_RE_FLAG, fru_name);
-  if (0 != access(fpath, F_OK)) {
-    // If there is no THRESHOLD_BIN file but INIT_FLAG exist, it means threshold-util --clear is triggered.
-    // And snr info should be loaded default.
-    if (0 == access(initpath, F_OK)) {
-      ret = reinit_snr_threshold(fru, SENSORD_MODE_NORMAL);
+  while (1) {
+    len = read(fd, buf, sizeof(buf));
+    if (len <= 0) {
+      if (len < 0 && errno == EINTR)
+        continue;
+      syslog(LOG_WARNING, "%s: inotify read failed, polling thresholds", __func__);
+      g_thresh_poll = 1;
+      break;
+    }
+
+    for (i = 0; i < len; i += sizeof(struct inotify_event) + ev->len) {
+      ev = (struct inotify_event *)&buf[i];
+      if (ev->mask & IN_Q_OVERFLOW) {
+        for (fru = 1; fru <= MAX_NUM_FRUS; fru++)
+          g_thresh_pending[fru-1] = 1;
+        continue;
+      }
+      if (ev->len == 0)
+        continue;
+      for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
+        if (!strcmp(ev->name, tbl_name[fru-1])) {
+          g_thresh_pending[fru-1] = 1;
+          break;
+        }
+      }
     }
-  } else {
-    // If THRESHOLD_BIN file exist and INIT_FLAG also exist, it means threshold-util --set is triggered.
-    // And snr info should be updated.    
-    if (0 == access(initpath, F_OK))
-      ret = reinit_snr_threshold(fru, SENSORD_MODE_TESTING);
   }
 
-  return ret;
+  close(fd);
+  pthread_exit(NULL);
+  return NULL;
 }
 
 /*
@@ -477,6 +627,8 @@ snr_monitor(void *arg) {
 
   while(1) {
 
+    snr_clear_chk(fru);
+
     if (pal_is_fw_update_ongoing(fru)) {
       sleep(STOP_PERIOD);
       continue;
@@ -486,6 +638,7 @@ snr_monitor(void *arg) {
     if (ret < 0)
       syslog(LOG_ERR, "%s: Fail to reinit sensor threshold for fru%d",__func__,fru);
 
+    pal_sensor_sweep(fru, true);
     for (i = 0; i < sensor_cnt; i++) {
       snr_num = sensor_list[i];
       curr_val = 0;
@@ -498,19 +651,7 @@ snr_monitor(void *arg) {
         snr_poll_interval[snr_num] = snr[snr_num].poll_interval;
         if (!(ret = sensor_raw_read_helper(fru, snr_num, &curr_val))) {
 
-          check_thresh_assert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNR_THRESH, &curr_val);
-
-          check_thresh_deassert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNC_THRESH, &curr_val);
+          check_thresh(fru, snr_num, &curr_val);
 #ifdef DEBUG
         } else {
           syslog(LOG_ERR, "FRU: %d, num: 0x%X, snr:%-16s, read failed",
@@ -526,9 +667,10 @@ snr_monitor(void *arg) {
       if (!ret && (snr[snr_num].curr_state != (int) curr_val)) {
         pal_sensor_discrete_check(fru, snr_num, snr[snr_num].name,
             snr[snr_num].curr_state, (int) curr_val);
-        snr[snr_num].curr_state = (int) curr_val;
+        set_snr_state(fru, &snr[snr_num], (int) curr_val);
       }
     }
+    pal_sensor_sweep(fru, false);
 
 #ifdef DYN_THRESH_FRU1
     // Handle dynamic threshold changes for FRU1
@@ -545,7 +687,6 @@ static void *
 snr_health_monitor() {
 
   int fru;
-  thresh_sensor_t *snr;
   uint8_t value = 0;
   int num;
   int ret = 0;
@@ -563,12 +704,6 @@ snr_health_monitor() {
 
       value = 0;
 
-      snr = get_struct_thresh_sensor(fru);
-      if (snr == NULL) {
-         syslog(LOG_WARNING, "snr_health_monitor: get_struct_thresh_sensor failed, fru %d", fru);
-         exit(-1);
-      }
-
       // get current health status from kv_store
       ret = pal_get_fru_health(fru, &fru_health_kv_state[fru]);
       if (ret) {
@@ -578,17 +713,12 @@ snr_health_monitor() {
         continue;
       }
 
-      for (num = 0; num <= MAX_SENSOR_NUM; num++) {
-        value |= snr[num].curr_state;
-      }
-
-      value = (value > 0) ? FRU_STATUS_BAD: FRU_STATUS_GOOD;
+      value = (g_fru_bad_cnt[fru-1] > 0) ? FRU_STATUS_BAD: FRU_STATUS_GOOD;
 
       // If log-util clear the fru, cleaning sensor status (After doing it, sensord will regenerate assert)
+      // The FRU's monitor thread does it, it owns the compiled thresholds
       if ( (fru_health_kv_state[fru] != fru_health_last_state[fru]) && (fru_health_kv_state[fru] == 1)) {
-        for (num = 0; num <= MAX_SENSOR_NUM; num++) {
-           snr[num].curr_state = 0;
-        }
+        g_clear_pending[fru-1] = 1;
       }
 
       // keep last status
@@ -600,6 +730,8 @@ snr_health_monitor() {
     } /* for loop for frus */
     sleep(MIN_POLL_INTERVAL);
   } /* while loop */
+
+  return NULL;
 }
 
 static void *
@@ -623,6 +755,7 @@ aggregate_snr_monitor(void *unused)
   }
   for(i = 0; i < (int)cnt; i++) {
     aggregate_sensor_threshold(i, &g_aggregate_snr[i]);
+    compile_snr_thresh(fru, i);
   }
   snr = get_struct_thresh_sensor(fru);
   if (snr == NULL) {
@@ -637,19 +770,7 @@ aggregate_snr_monitor(void *unused)
       if (snr[snr_num].flag) {
         if (!(ret = sensor_raw_read_helper(fru, snr_num, &curr_val))) {
 
-          check_thresh_assert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNC_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_assert(fru, snr_num, LNR_THRESH, &curr_val);
-
-          check_thresh_deassert(fru, snr_num, UNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, UNC_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LCR_THRESH, &curr_val);
-          check_thresh_deassert(fru, snr_num, LNC_THRESH, &curr_val);
+          check_thresh(fru, snr_num, &curr_val);
 #ifdef DEBUG
         } else {
           syslog(LOG_ERR, "FRU: %d, num: 0x%X, snr:%-16s, read failed",
@@ -674,6 +795,17 @@ run_sensord(int argc, char **argv) {
   pthread_t thread_snr[MAX_NUM_FRUS];
   pthread_t sensor_health;
   pthread_t agg_sensor_mon;
+  pthread_t thresh_watch;
+
+  if (access(THRESHOLD_PATH, F_OK) == -1) {
+    mkdir(THRESHOLD_PATH, 0777);
+  }
+
+  /* Threshold override watch, started before the tables are written */
+  if (pthread_create(&thresh_watch, NULL, thresh_watch_monitor, NULL) < 0) {
+    syslog(LOG_WARNING, "pthread_create for threshold watch failed\n");
+    g_thresh_poll = 1;
+  }
 
   arg = 1;
   while(arg < argc) {
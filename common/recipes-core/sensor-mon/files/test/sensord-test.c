@@ -0,0 +1,348 @@
+/*
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Threshold checks of sensord against simulated sensor readings, and a
+ * micro-benchmark of check_thresh() on synthetic traces.
+ *
+ *   sensord-test                     event tests and the benchmark
+ *   sensord-test <readings>          benchmark with that many readings
+ *
+ * "make SENSORD=<file> SENSORD_OLD=1" builds only the benchmark against
+ * a sensord.c from before the compiled threshold descriptors, which
+ * checks every threshold of every reading, for a comparison on the same
+ * traces.
+ */
+#define main sensord_main
+#include SENSORD
+#undef main
+#include <time.h>
+
+#define TEST_FRU 1
+#define BENCH_SENSORS 48
+
+static int failures = 0;
+
+/* Reading returned by the re-reads, and the events logged */
+static float g_reading;
+static int g_rereads_left = -1;   // re-reads before g_after is returned
+static float g_after;
+static uint8_t g_events[32];
+static int g_n_events;
+static int g_event_cnt;
+
+const char pal_fru_list[] = "all, slot1";
+
+int
+sensor_raw_read(uint8_t fru, uint8_t sensor_num, float *value) {
+  if (g_rereads_left == 0)
+    g_reading = g_after;
+  if (g_rereads_left >= 0)
+    g_rereads_left--;
+  *value = g_reading;
+  return 0;
+}
+
+int
+aggregate_sensor_read(size_t index, float *value) {
+  *value = g_reading;
+  return 0;
+}
+
+void
+msleep(int msec) {
+}
+
+void
+pal_update_ts_sled(void) {
+}
+
+/* The events are counted, not logged; old and new code log the same lines */
+void
+syslog(int priority, const char *format, ...) {
+}
+
+static void
+log_event(uint8_t thresh, bool assert) {
+  g_event_cnt++;
+  if (g_n_events < (int)sizeof(g_events))
+    g_events[g_n_events++] = assert ? thresh : (0x80 | thresh);
+}
+
+void
+pal_sensor_assert_handle(uint8_t fru, uint8_t snr_num, float val, uint8_t thresh) {
+  log_event(thresh, true);
+}
+
+void
+pal_sensor_deassert_handle(uint8_t fru, uint8_t snr_num, float val, uint8_t thresh) {
+  log_event(thresh, false);
+}
+
+/* Not reached by the threshold checks */
+int pal_copy_all_thresh_to_file(uint8_t fru, thresh_sensor_t *sinfo) { return 0; }
+int pal_get_fru_discrete_list(uint8_t fru, uint8_t **sensor_list, int *cnt) { return -1; }
+int pal_get_fru_health(uint8_t fru, uint8_t *value) { return -1; }
+int pal_get_fru_id(char *fru_str, uint8_t *fru) { return -1; }
+int pal_get_fru_name(uint8_t fru, char *name) { return -1; }
+int pal_get_fru_sensor_list(uint8_t fru, uint8_t **sensor_list, int *cnt) { return -1; }
+int pal_get_sensor_name(uint8_t fru, uint8_t sensor_num, char *name) { return -1; }
+int pal_init_sensor_check(uint8_t fru, uint8_t snr_num, void *snr) { return 0; }
+bool pal_is_fw_update_ongoing(uint8_t fruid) { return false; }
+void pal_sensor_sweep(uint8_t fru, bool start) { }
+int pal_sensor_discrete_check(uint8_t fru, uint8_t snr_num, char *snr_name,
+                              uint8_t o_val, uint8_t n_val) { return 0; }
+int pal_set_sensor_health(uint8_t fru, uint8_t value) { return 0; }
+thresh_tbl_t *pal_thresh_tbl_map(uint8_t fru, int mode, size_t *size) { return NULL; }
+void pal_thresh_tbl_unmap(thresh_tbl_t *tbl, size_t size) { }
+int aggregate_sensor_count(size_t *count) { return -1; }
+int aggregate_sensor_init(const char *conf_file) { return -1; }
+int aggregate_sensor_threshold(size_t index, thresh_sensor_t *thresh) { return -1; }
+int sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) { return -1; }
+int sensor_cache_write(uint8_t fru, uint8_t sensor_num, bool available, float value) { return 0; }
+
+/* lnr 5, lcr 10, lnc 15, unc 70, ucr 80, unr 90, hysteresis 1 */
+static void
+set_thresh(thresh_sensor_t *s, uint16_t flag) {
+  memset(s, 0, sizeof(*s));
+  s->flag = flag;
+  s->lnr_thresh = 5;
+  s->lcr_thresh = 10;
+  s->lnc_thresh = 15;
+  s->unc_thresh = 70;
+  s->ucr_thresh = 80;
+  s->unr_thresh = 90;
+  s->pos_hyst = 1;
+  s->neg_hyst = 1;
+  strcpy(s->name, "TEST_SENSOR");
+}
+
+#ifndef SENSORD_OLD
+static void
+check(bool passed, const char *what) {
+  printf("%-48s %s\n", what, passed ? "PASSED" : "FAILED");
+  if (!passed)
+    failures++;
+}
+
+static void
+read_sensor(uint8_t snr_num, float val) {
+  g_reading = val;
+  check_thresh(TEST_FRU, snr_num, &g_reading);
+}
+
+/* Events since the last call, as a string: "+UNC +UCR" / "-UCR" */
+static const char *
+events(void) {
+  static const char *names[] = {"", "UCR", "UNC", "UNR", "LCR", "LNC", "LNR"};
+  static char buf[128];
+  int i;
+
+  buf[0] = '\0';
+  for (i = 0; i < g_n_events; i++) {
+    sprintf(buf + strlen(buf), "%s%c%s", i ? " " : "",
+            (g_events[i] & 0x80) ? '-' : '+', names[g_events[i] & 0x7F]);
+  }
+  g_n_events = 0;
+  return buf;
+}
+
+static void
+test_events(void) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(TEST_FRU);
+  thresh_sensor_t *s = &snr[1];
+  uint16_t all = 0;
+  int t;
+
+  for (t = UCR_THRESH; t <= LNR_THRESH; t++)
+    all = SETBIT(all, t);
+  set_thresh(s, all);
+  compile_snr_thresh(TEST_FRU, 1);
+
+  read_sensor(1, 40);
+  check(!strcmp(events(), "") && s->curr_state == 0, "normal reading, no event");
+  read_sensor(1, 85);
+  check(!strcmp(events(), "+UNC +UCR") && g_fru_bad_cnt[TEST_FRU-1] == 1,
+        "upper asserts, least severe first");
+  read_sensor(1, 79.5);
+  check(!strcmp(events(), ""), "within hysteresis, no event");
+  read_sensor(1, 78.5);
+  check(!strcmp(events(), "-UCR") && GETBIT(s->curr_state, UNC_THRESH) &&
+        !GETBIT(s->curr_state, UCR_THRESH), "one band down");
+  read_sensor(1, 95);
+  check(!strcmp(events(), "+UCR +UNR"), "up to non recoverable");
+  read_sensor(1, 40);
+  check(!strcmp(events(), "-UNR -UCR -UNC") && s->curr_state == 0 &&
+        g_fru_bad_cnt[TEST_FRU-1] == 0, "upper deasserts, most severe first");
+  read_sensor(1, 8);
+  check(!strcmp(events(), "+LNC +LCR"), "lower asserts");
+
+  // Asserted events stay asserted across a recompile
+  compile_snr_thresh(TEST_FRU, 1);
+  read_sensor(1, 8);
+  check(!strcmp(events(), ""), "recompile keeps the state");
+  read_sensor(1, 40);
+  check(!strcmp(events(), "-LCR -LNC") && s->curr_state == 0, "lower deasserts");
+
+  // A crossing the re-read does not confirm is ignored
+  g_rereads_left = 0;
+  g_after = 40;
+  read_sensor(1, 85);
+  check(!strcmp(events(), "") && s->curr_state == 0, "unconfirmed assert ignored");
+  read_sensor(1, 85);
+  g_rereads_left = 1;
+  g_after = 85;
+  read_sensor(1, 40);
+  check(!strcmp(events(), "+UNC +UCR") && s->curr_state != 0,
+        "unconfirmed deassert ignored");
+  g_rereads_left = -1;
+  read_sensor(1, 40);
+  events();
+
+  // Disabled thresholds are skipped
+  set_thresh(&snr[2], SETBIT(SETBIT(0, UNC_THRESH), UNR_THRESH));
+  compile_snr_thresh(TEST_FRU, 2);
+  read_sensor(2, 85);
+  check(!strcmp(events(), "+UNC"), "disabled threshold skipped");
+  read_sensor(2, 95);
+  check(!strcmp(events(), "+UNR"), "next enabled threshold");
+  read_sensor(2, 40);
+  check(!strcmp(events(), "-UNR -UNC"), "deasserts of enabled thresholds");
+
+  // A clear from log-util is only applied by the monitor thread, and the
+  // asserted states are asserted again afterwards
+  read_sensor(1, 85);
+  events();
+  g_clear_pending[TEST_FRU-1] = 1;
+  read_sensor(1, 85);
+  check(!strcmp(events(), "") && s->curr_state != 0, "clear left to the monitor");
+  snr_clear_chk(TEST_FRU);
+  check(s->curr_state == 0 && g_fru_bad_cnt[TEST_FRU-1] == 0 &&
+        !g_clear_pending[TEST_FRU-1], "states cleared between sweeps");
+  read_sensor(1, 85);
+  check(!strcmp(events(), "+UNC +UCR"), "asserted again after a clear");
+  read_sensor(1, 40);
+  events();
+}
+#endif
+
+static double
+now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * BENCH_SENSORS sensors read in turn, noise of +-2 around 40 and with
+ * probability rate per reading an excursion to 85 or 8 (or back to 40).
+ */
+static void
+bench(int readings, double rate) {
+  thresh_sensor_t *snr = get_struct_thresh_sensor(TEST_FRU);
+  float *trace, base = 40, val;
+  unsigned int seed = 1;
+  int i, k, unhealthy = 0, state = 0;
+  uint16_t all = 0;
+  double start, ns;
+
+  for (k = UCR_THRESH; k <= LNR_THRESH; k++)
+    all = SETBIT(all, k);
+  for (k = 0; k < BENCH_SENSORS; k++) {
+    set_thresh(&snr[k], all);
+#ifndef SENSORD_OLD
+    compile_snr_thresh(TEST_FRU, k);
+#endif
+  }
+
+  trace = malloc(readings * sizeof(float));
+  if (trace == NULL)
+    return;
+  for (i = 0; i < readings; i++) {
+    seed = seed * 1103515245 + 12345;
+    if ((seed >> 8) / (float)(1 << 24) < rate)
+      base = (base == 40) ? ((seed & 0x100) ? 85 : 8) : 40;
+    seed = seed * 1103515245 + 12345;
+    trace[i] = base + ((seed >> 8) / (float)(1 << 24) - 0.5f) * 4;
+  }
+
+  g_event_cnt = 0;
+  start = now_ns();
+  for (i = 0; i < readings; i++) {
+    k = i % BENCH_SENSORS;
+    g_reading = val = trace[i];
+#ifdef SENSORD_OLD
+    check_thresh_assert(TEST_FRU, k, UNC_THRESH, &val);
+    check_thresh_assert(TEST_FRU, k, UCR_THRESH, &val);
+    check_thresh_assert(TEST_FRU, k, UNR_THRESH, &val);
+    check_thresh_assert(TEST_FRU, k, LNC_THRESH, &val);
+    check_thresh_assert(TEST_FRU, k, LCR_THRESH, &val);
+    check_thresh_assert(TEST_FRU, k, LNR_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, UNR_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, UCR_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, UNC_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, LNR_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, LCR_THRESH, &val);
+    check_thresh_deassert(TEST_FRU, k, LNC_THRESH, &val);
+    if (k == BENCH_SENSORS - 1) {
+      int num, value = 0;
+      for (num = 0; num < MAX_SENSOR_NUM; num++)
+        value |= snr[num].curr_state;
+      unhealthy += value > 0;
+    }
+#else
+    check_thresh(TEST_FRU, k, &val);
+    if (k == BENCH_SENSORS - 1)
+      unhealthy += g_fru_bad_cnt[TEST_FRU-1] > 0;
+#endif
+  }
+  ns = (now_ns() - start) / readings;
+  free(trace);
+
+  for (k = 0; k < BENCH_SENSORS; k++)
+    state ^= snr[k].curr_state * (k + 1);
+  printf("excursion rate %5.2f%%: %6.1f ns/reading (%d events, %d unhealthy sweeps,"
+         " state %d)\n", rate * 100, ns, g_event_cnt, unhealthy, state);
+
+  for (k = 0; k < BENCH_SENSORS; k++) {
+#ifdef SENSORD_OLD
+    snr[k].curr_state = 0;
+#else
+    set_snr_state(TEST_FRU, &snr[k], 0);
+#endif
+  }
+}
+
+int
+main(int argc, char **argv) {
+  int readings = (argc > 1) ? atoi(argv[1]) : 5000000;
+
+#ifndef SENSORD_OLD
+  if (argc == 1)
+    test_events();
+#endif
+
+  printf("%d readings of %d sensors\n", readings, BENCH_SENSORS);
+  bench(readings, 0);
+  bench(readings, 0.0005);
+  bench(readings, 0.01);
+
+  printf("sensord: %s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
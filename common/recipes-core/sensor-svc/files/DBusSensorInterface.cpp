@@ -51,6 +51,12 @@ static const char* xml =
 "      <arg type='d' name='value' direction='out'/>"
 "      <arg type='s' name='unit' direction='out'/>"
 "    </method>"
+"    <signal name='valueChanged'>"
+"      <arg type='y' name='fruId'/>"
+"      <arg type='y' name='id'/>"
+"      <arg type='i' name='readStatus'/>"
+"      <arg type='d' name='value'/>"
+"    </signal>"
 "  </interface>"
 "</node>";
 
@@ -72,34 +78,41 @@ DBusSensorInterface::~DBusSensorInterface() {
 void DBusSensorInterface::sensorRead(GDBusMethodInvocation* invocation,
                                      gpointer               arg) {
   Sensor* obj = static_cast<Sensor*>(arg);
+  float value;
   LOG(INFO) << "sensorRead of " << obj->getName();
+  ReadResult status = obj->getReading(&value);
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(id)",
-                                        obj->getLastReadStatus(),
-                                        obj->getValue()));
+                                        status,
+                                        value));
 }
 
 void DBusSensorInterface::sensorRawRead(GDBusMethodInvocation* invocation,
                                         gpointer               arg) {
   Sensor* obj = static_cast<Sensor*>(arg);
+  float value;
   LOG(INFO) << "sensorRawRead of " << obj->getName();
   obj->sensorRawRead();
+  emitValueChanged(g_dbus_method_invocation_get_connection(invocation), obj);
+  ReadResult status = obj->getReading(&value);
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(id)",
-                                        obj->getLastReadStatus(),
-                                        obj->getValue()));
+                                        status,
+                                        value));
 }
 
 void DBusSensorInterface::getSensorObject(GDBusMethodInvocation* invocation,
                                           gpointer               arg) {
   Sensor* obj = static_cast<Sensor*>(arg);
+  float value;
   LOG(INFO) << "getSensorObject of " << obj->getName();
+  ReadResult status = obj->getReading(&value);
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(syids)",
                                         obj->getName().c_str(),
                                         obj->getId(),
-                                        obj->getLastReadStatus(),
-                                        obj->getValue(),
+                                        status,
+                                        value,
                                         obj->getUnit().c_str()));
 }
 
@@ -113,6 +126,35 @@ void DBusSensorInterface::getSensorId(GDBusMethodInvocation* invocation,
                                         obj->getValue()));
 }
 
+void DBusSensorInterface::emitValueChanged(GDBusConnection* connection,
+                                           Sensor*          sensor) {
+  GError* error = nullptr;
+  ReadResult status;
+  float value;
+
+  if (!sensor->checkChanged(&status, &value)) {
+    return;
+  }
+
+  FRU* fru = sensor->getFru();
+  g_dbus_connection_emit_signal(connection,
+                                nullptr,
+                                sensor->getObjectPath().c_str(),
+                                "org.openbmc.SensorObject",
+                                "valueChanged",
+                                g_variant_new("(yyid)",
+                                              fru ? fru->getId() : 0xFF,
+                                              sensor->getId(),
+                                              status,
+                                              (double)value),
+                                &error);
+  if (error != nullptr) {
+    LOG(WARNING) << "valueChanged of " << sensor->getName()
+                 << " not sent: " << error->message;
+    g_error_free(error);
+  }
+}
+
 void DBusSensorInterface::methodCallBack(
                           GDBusConnection*       connection,
                           const char*            sender,
@@ -25,6 +25,8 @@
 namespace openbmc {
 namespace qin {
 
+class Sensor;
+
 class DBusSensorInterface: public DBusInterfaceBase {
   public:
     /**
@@ -54,6 +56,13 @@ class DBusSensorInterface: public DBusInterfaceBase {
                                GDBusMethodInvocation* invocation,
                                gpointer               arg);
 
+    /**
+     * Emit the valueChanged signal of the sensor if its read status or
+     * value changed since the last signal
+     */
+    static void emitValueChanged(GDBusConnection* connection,
+                                 Sensor*          sensor);
+
   private:
     /**
      * Callback for sensorRead method
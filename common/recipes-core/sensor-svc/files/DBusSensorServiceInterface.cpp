@@ -56,6 +56,10 @@ static const char* xml =
   "    <method name='getSensorObjects'>"
   "      <arg type='a(syids)' name='sensorlist' direction='out'/>"
   "    </method>"
+  "    <method name='getSensorValues'>"
+  "      <arg type='ay' name='ids' direction='in'/>"
+  "      <arg type='a(yid)' name='values' direction='out'/>"
+  "    </method>"
   "    <method name='addFRU'>"
   "      <arg type='s' name='fruParentPath' direction='in'/>"
   "      <arg type='s' name='fruJsonString' direction='in'/>"
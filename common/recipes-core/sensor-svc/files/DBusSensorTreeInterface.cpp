@@ -20,15 +20,23 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 #include <glog/logging.h>
 #include <gio/gio.h>
 #include "DBusSensorTreeInterface.h"
+#include "DBusSensorInterface.h"
 #include "FRU.h"
 #include "Sensor.h"
 
 namespace openbmc {
 namespace qin {
 
+// Max number of threads reading sensors for getSensorValues
+#define MAX_READ_THREADS 4
+
 static const char* xml =
   "<!DOCTYPE node PUBLIC"
   " \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\" "
@@ -57,6 +65,10 @@ static const char* xml =
   "    <method name='getSensorObjects'>"
   "      <arg type='a(syids)' name='sensorlist' direction='out'/>"
   "    </method>"
+  "    <method name='getSensorValues'>"
+  "      <arg type='ay' name='ids' direction='in'/>"
+  "      <arg type='a(yid)' name='values' direction='out'/>"
+  "    </method>"
   "  </interface>"
   "</node>";
 
@@ -76,37 +88,19 @@ DBusSensorTreeInterface::~DBusSensorTreeInterface() {
 }
 
 /*
-* Helper function, returns path of Object obj
+* Helper function, returns the SensorIndex of the FRU or SensorService obj
 */
-static std::string getPathToCurrentObject(Object* obj){
-  if (obj->getParent() == nullptr){
-    return "/" + obj->getName();
-  }
-  else {
-    return getPathToCurrentObject(obj->getParent()) + "/" + obj->getName();
-  }
+static SensorIndex* getIndex(Object* obj) {
+  SensorIndex* index = dynamic_cast<SensorIndex*>(obj);
+  DCHECK(index != nullptr) << "Object " << obj->getName() << " has no index";
+  return index;
 }
 
 /*
-* Helper function, returns vector of FRU names of
-* all FRUs under Object obj subtree
+* Helper function, returns path of the found object or "" if none
 */
-static std::vector<std::string> getFRUListRec(Object* obj) {
-  std::vector<std::string> sensorObjectPaths;
-
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr){
-      sensorObjectPaths.push_back(it.second->getName());
-      std::vector<std::string> childSubtree = getFRUListRec(it.second);
-      if (!childSubtree.empty()){
-        for (auto &itVec : childSubtree) {
-          sensorObjectPaths.push_back(itVec);
-        }
-      }
-    }
-  }
-
-  return sensorObjectPaths;
+static std::string getPath(Object* obj) {
+  return obj == nullptr ? std::string() : obj->getObjectPath();
 }
 
 void DBusSensorTreeInterface::getFRUList(GDBusMethodInvocation* invocation,
@@ -115,11 +109,8 @@ void DBusSensorTreeInterface::getFRUList(GDBusMethodInvocation* invocation,
   Object* obj = static_cast<Object*>(arg);
   LOG(INFO) << "getFRUList " << obj->getName();
 
-  std::vector<std::string> fruList = getFRUListRec(obj);
-  std::string objectPath = getPathToCurrentObject(obj);
-
-  for (auto &it : fruList) {
-    g_variant_builder_add(builder, "s", it.c_str());
+  for (auto &it : getIndex(obj)->getFRUs()) {
+    g_variant_builder_add(builder, "s", it.first.c_str());
   }
 
   g_dbus_method_invocation_return_value(invocation,
@@ -127,35 +118,6 @@ void DBusSensorTreeInterface::getFRUList(GDBusMethodInvocation* invocation,
   g_variant_builder_unref(builder);
 }
 
-
-/*
-* Helper function, locates FRU with fruName under subtree and returns its path
-*/
-static std::string getFruPathByNameRec(Object* obj, std::string fruName) {
-  std::string path;
-
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr) {
-      //Child is FRU
-      if (fruName.compare(it.first) == 0){
-        // FRU found
-        path = it.first;
-        break;
-      }
-      else {
-        path = getFruPathByNameRec(it.second, fruName);
-        if (!path.empty()){
-          // If sensor is located no need to search more
-          path = it.first + "/" + path;
-          break;
-        }
-      }
-    }
-  }
-
-  return path;
-}
-
 void DBusSensorTreeInterface::getFruPathByName(
                                           GDBusMethodInvocation* invocation,
                                           GVariant*              parameters,
@@ -165,91 +127,27 @@ void DBusSensorTreeInterface::getFruPathByName(
   g_variant_get(parameters, "(&s)", &fruName);
 
   LOG(INFO) << "getFruPathByName of " << fruName << " from " << obj->getName();
-  std::string path = getFruPathByNameRec(obj, std::string(fruName));
-
-  if (!path.empty()) {
-    path = getPathToCurrentObject(obj) + "/" + path;
-  }
+  std::string path = getPath(getIndex(obj)->findFRU(std::string(fruName)));
 
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(s)", path.c_str()));
 }
 
-/*
-* Helper function, locates FRU with fruId under subtree and returns its path
-*/
-static std::string getFruPathByIdRec(Object* obj, uint8_t fruId) {
-  std::string path;
-
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr) {
-      //Child is sensor device
-      if (fruId == ((FRU*)it.second)->getId()){
-        // FRU found
-        path = it.first;
-        break;
-      }
-      else {
-        path = getFruPathByIdRec(it.second, fruId);
-        if (!path.empty()){
-          // If sensor is located no need to search more
-          path = it.first + "/" + path;
-          break;
-        }
-      }
-    }
-  }
-  return path;
-}
-
 void DBusSensorTreeInterface::getFruPathById(GDBusMethodInvocation* invocation,
                                              GVariant*              parameters,
                                              gpointer               arg){
   Object* obj = static_cast<Object*>(arg);
-  gchar fruId;
+  uint8_t fruId;
   g_variant_get(parameters, "(y)", &fruId);
 
-  LOG(INFO) << "getFruPathById of " << fruId << " from " << obj->getName();
-  std::string path = getFruPathByIdRec(obj, fruId);
-
-  if (!path.empty()) {
-    path = getPathToCurrentObject(obj) + "/" + path;
-  }
+  LOG(INFO) << "getFruPathById of " << (int)fruId
+            << " from " << obj->getName();
+  std::string path = getPath(getIndex(obj)->findFRU(fruId));
 
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(s)", path.c_str()));
 }
 
-/*
-* Helper function, locates Sensor with sensorName under subtree and
-* returns its path
-*/
-static std::string getSensorPathByNameRec(Object* obj,
-                                          std::string sensorName) {
-  std::string path;
-
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr) {
-      //Child is FRU
-      path = getSensorPathByNameRec(it.second, sensorName);
-      if (!path.empty()){
-        // If sensor is located no need to search more
-        path = it.first + "/" + path;
-        break;
-      }
-    }
-    else if (dynamic_cast<Sensor*>(it.second) != nullptr) {
-      //Child is sensor object
-      if (sensorName.compare(it.second->getName()) == 0) {
-        path = it.second->getName();
-        break;
-      }
-    }
-  }
-
-  return path;
-}
-
 void DBusSensorTreeInterface::getSensorPathByName(
                                              GDBusMethodInvocation* invocation,
                                              GVariant*              parameters,
@@ -259,44 +157,13 @@ void DBusSensorTreeInterface::getSensorPathByName(
   g_variant_get(parameters, "(&s)", &sensorName);
 
   LOG(INFO) << "getSensorPath of " << sensorName << " from " << obj->getName();
-  std::string path = getSensorPathByNameRec(obj, std::string(sensorName));
-
-  if (!path.empty()) {
-    path = getPathToCurrentObject(obj) + "/" + path;
-  }
+  std::string path =
+      getPath(getIndex(obj)->findSensor(std::string(sensorName)));
 
   g_dbus_method_invocation_return_value(invocation,
                                         g_variant_new("(s)", path.c_str()));
 }
 
-/*
-* Helper function, locates Sensor with id under subtree and returns its path
-*/
-static std::string getSensorPathByIdRec(Object* obj, uint16_t id) {
-  std::string path;
-
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr) {
-      //Child is FRU
-      path = getSensorPathByIdRec(it.second, id);
-      if (!path.empty()){
-        // If sensor is located no need to search more
-        path = it.first + "/" + path;
-        break;
-      }
-    }
-    else if (dynamic_cast<Sensor*>(it.second) != nullptr) {
-      //Child is sensor object
-      if (((Sensor*) it.second)->getId() == id) {
-        path = it.second->getName();
-        break;
-      }
-    }
-  }
-
-  return path;
-}
-
 void DBusSensorTreeInterface::getSensorPathById(
                                              GDBusMethodInvocation* invocation,
                                              GVariant*              parameters,
@@ -309,55 +176,133 @@ void DBusSensorTreeInterface::getSensorPathById(
   LOG(INFO) << "getSensorPathById of " << (int)id
             << " from " << obj->getName();
 
-  std::string path = getSensorPathByIdRec(obj, id);
+  std::string path = getPath(getIndex(obj)->findSensor(id));
+
+  g_dbus_method_invocation_return_value(invocation,
+                                        g_variant_new("(s)", path.c_str()));
+}
 
-  if (!path.empty()) {
-    path = getPathToCurrentObject(obj) + "/" + path;
+void DBusSensorTreeInterface::getSensorObjects(
+                                           GDBusMethodInvocation* invocation,
+                                           gpointer               arg) {
+  Object* obj = static_cast<Object*>(arg);
+  LOG(INFO) << "getSensorObjects of " << obj->getName();
+
+  GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(syids)"));
+
+  for (auto &it : getIndex(obj)->getSensors()) {
+    Sensor* sensor = static_cast<Sensor*>(it.second);
+    float value;
+    ReadResult status = sensor->getReading(&value);
+    g_variant_builder_add(builder,
+                          "(syids)",
+                          sensor->getName().c_str(),
+                          sensor->getId(),
+                          status,
+                          value,
+                          sensor->getUnit().c_str());
   }
 
   g_dbus_method_invocation_return_value(invocation,
-                                        g_variant_new("(s)", path.c_str()));
+                                        g_variant_new("(a(syids))", builder));
+  g_variant_builder_unref(builder);
 }
 
-/**
- * Recursively traverses through subtree under Object obj and
- * adds all sensor objects to GVariantBuilder* builder
- */
-static void addSensorObjects(GVariantBuilder* builder, Object* obj) {
-  for (auto &it : obj->getChildMap()) {
-    Sensor* sensor;
-    if ((sensor = dynamic_cast<Sensor*>(it.second)) != nullptr) {
-      //child is Sensor, add it to builder
-      g_variant_builder_add(builder,
-                            "(syids)",
-                            sensor->getName().c_str(),
-                            sensor->getId(),
-                            sensor->getLastReadStatus(),
-                            sensor->getValue(),
-                            sensor->getUnit().c_str());
+/*
+* Helper function, reads the sensors through their cache. Sensors of
+* different access groups are read in parallel by up to
+* MAX_READ_THREADS threads, sensors of one group in order by one thread.
+*/
+static void readSensors(const std::vector<Sensor*> &sensors) {
+  std::map<int, std::vector<Sensor*>> groups;
+  std::vector<std::vector<Sensor*>> work;
+
+  for (Sensor* sensor : sensors) {
+    int group = sensor->getAccessGroup();
+    if (group == ACCESS_GROUP_NONE) {
+      work.push_back(std::vector<Sensor*>(1, sensor));
+    } else {
+      groups[group].push_back(sensor);
     }
   }
+  for (auto &it : groups) {
+    work.push_back(std::move(it.second));
+  }
 
-  for (auto &it : obj->getChildMap()) {
-    if (dynamic_cast<FRU*>(it.second) != nullptr) {
-      //Recursively call on child FRU
-      addSensorObjects(builder, it.second);
+  std::atomic<size_t> next(0);
+  auto worker = [&work, &next]() {
+    size_t i;
+    while ((i = next++) < work.size()) {
+      for (Sensor* sensor : work[i]) {
+        sensor->sensorCachedRead();
+      }
     }
+  };
+
+  std::vector<std::thread> threads;
+  size_t nofThreads = std::min(work.size(), (size_t)MAX_READ_THREADS);
+  for (size_t i = 1; i < nofThreads; i++) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
   }
 }
 
-void DBusSensorTreeInterface::getSensorObjects(
+void DBusSensorTreeInterface::getSensorValues(
                                            GDBusMethodInvocation* invocation,
+                                           GVariant*              parameters,
                                            gpointer               arg) {
   Object* obj = static_cast<Object*>(arg);
-  LOG(INFO) << "getSensorObjects of " << obj->getName();
+  SensorIndex* index = getIndex(obj);
+  GVariantIter* iter;
+  uint8_t id;
+  std::vector<uint8_t> ids;
+  std::vector<Sensor*> sensors;
 
-  GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(syids)"));
+  g_variant_get(parameters, "(ay)", &iter);
+  while (g_variant_iter_loop(iter, "y", &id)) {
+    ids.push_back(id);
+  }
+  g_variant_iter_free(iter);
 
-  addSensorObjects(builder, obj);
+  LOG(INFO) << "getSensorValues of " << ids.size()
+            << " sensors from " << obj->getName();
+
+  // Sensors not found are reported as not available
+  for (uint8_t sensorId : ids) {
+    Sensor* sensor = static_cast<Sensor*>(index->findSensor(sensorId));
+    if (sensor != nullptr) {
+      sensors.push_back(sensor);
+    }
+  }
+  readSensors(sensors);
+
+  GDBusConnection* connection =
+      g_dbus_method_invocation_get_connection(invocation);
+  for (Sensor* sensor : sensors) {
+    DBusSensorInterface::emitValueChanged(connection, sensor);
+  }
+
+  GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(yid)"));
+  for (uint8_t sensorId : ids) {
+    Sensor* sensor = static_cast<Sensor*>(index->findSensor(sensorId));
+    if (sensor != nullptr) {
+      float value;
+      ReadResult status = sensor->getReading(&value);
+      g_variant_builder_add(builder,
+                            "(yid)",
+                            sensorId,
+                            status,
+                            status == READING_SUCCESS ? value : 0);
+    } else {
+      g_variant_builder_add(builder, "(yid)", sensorId, READING_NA, 0.0);
+    }
+  }
 
   g_dbus_method_invocation_return_value(invocation,
-                                        g_variant_new("(a(syids))", builder));
+                                        g_variant_new("(a(yid))", builder));
   g_variant_builder_unref(builder);
 }
 
@@ -391,6 +336,9 @@ void DBusSensorTreeInterface::methodCallBack(
   else if (g_strcmp0(methodName, "getSensorObjects") == 0) {
     getSensorObjects(invocation, arg);
   }
+  else if (g_strcmp0(methodName, "getSensorValues") == 0) {
+    getSensorValues(invocation, parameters, arg);
+  }
 }
 
 } // namespace qin
@@ -107,6 +107,15 @@ class DBusSensorTreeInterface: public DBusInterfaceBase {
      */
     static void getSensorObjects(GDBusMethodInvocation* invocation,
                                  gpointer               arg);
+
+    /**
+     * Callback for getSensorValues method
+     * Reads the sensors with the given ids under subtree, served from
+     * the sensor cache when fresh, and returns id, status and value
+     */
+    static void getSensorValues(GDBusMethodInvocation* invocation,
+                                GVariant*              parameters,
+                                gpointer               arg);
 };
 
 } // namespace qin
@@ -20,15 +20,18 @@
 
 #pragma once
 #include <string>
+#include <atomic>
 #include <object-tree/Object.h>
+#include "SensorIndex.h"
 
 namespace openbmc {
 namespace qin {
 
-class FRU : public Object {
+class FRU : public Object, public SensorIndex {
   private:
     uint8_t fruId_ = 0xFF;      // id of FRU, default 0xFF
-    uint8_t poweronFlag_ = 0;   // keeps track of time in seconds
+    std::atomic<uint8_t> poweronFlag_{0};
+                                // keeps track of time in seconds
                                 // elapsed after FRU power on
                                 // todo: rework on poweronFlag_
 
@@ -18,9 +18,14 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <gflags/gflags.h>
 #include "Sensor.h"
 #include "SensorAccessMechanism.h"
 
+DEFINE_int32(sensor_cache_ms, 1000,
+             "Time in ms a sensor reading is served from cache to batched "
+             "reads");
+
 namespace openbmc {
 namespace qin {
 
@@ -53,26 +58,77 @@ uint8_t Sensor::getId(){
 }
 
 float Sensor::getValue() {
+  std::lock_guard<std::mutex> lock(valueMutex_);
   return value_;
 }
 
+ReadResult Sensor::getReading(float* value) {
+  std::lock_guard<std::mutex> lock(valueMutex_);
+  *value = value_;
+  return readResult_;
+}
+
 std::string Sensor::getUnit() {
   return unit_;
 }
 
 ReadResult Sensor::getLastReadStatus() {
-  return sensorAccess_->getLastReadResult();
+  std::lock_guard<std::mutex> lock(valueMutex_);
+  return readResult_;
 }
 
-ReadResult Sensor::sensorRawRead(){
+ReadResult Sensor::rawRead(){
   float val;
   ReadResult readResult = sensorAccess_->sensorRawRead(this, &val);
-  if (readResult == READING_SUCCESS){
-    value_ = val;
+  {
+    std::lock_guard<std::mutex> lock(valueMutex_);
+    if (!hasRead_ || readResult != readResult_ ||
+        (readResult == READING_SUCCESS && val != value_)) {
+      changed_ = true;
+    }
+    readResult_ = readResult;
+    if (readResult == READING_SUCCESS){
+      value_ = val;
+    }
   }
+  lastReadTime_ = std::chrono::steady_clock::now();
+  hasRead_ = true;
 
   return readResult;
 }
 
+ReadResult Sensor::sensorRawRead(){
+  std::lock_guard<std::mutex> lock(readMutex_);
+  return rawRead();
+}
+
+ReadResult Sensor::sensorCachedRead(){
+  std::lock_guard<std::mutex> lock(readMutex_);
+  int cacheTime = cacheTime_ < 0 ? FLAGS_sensor_cache_ms : cacheTime_;
+
+  if (hasRead_ && std::chrono::steady_clock::now() - lastReadTime_ <
+                  std::chrono::milliseconds(cacheTime)) {
+    return getLastReadStatus();
+  }
+  return rawRead();
+}
+
+bool Sensor::checkChanged(ReadResult* status, float* value){
+  std::lock_guard<std::mutex> lock(valueMutex_);
+  bool changed = changed_;
+  changed_ = false;
+  *status = readResult_;
+  *value = value_;
+  return changed;
+}
+
+void Sensor::setCacheTime(int cacheTime){
+  cacheTime_ = cacheTime;
+}
+
+int Sensor::getAccessGroup(){
+  return sensorAccess_->getAccessGroup();
+}
+
 } // namespace qin
 } // namespace openbmc
@@ -21,6 +21,8 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <mutex>
+#include <chrono>
 #include <stdlib.h>
 #include <stdio.h>
 #include <object-tree/Object.h>
@@ -33,10 +35,24 @@ namespace qin {
 class Sensor : public Object{
   private:
     uint8_t id_ = 0xFF;                           // Sensor Id
-    float value_;                                 // Last Read Sensor Value
+    float value_ = 0;                             // Last Read Sensor Value
     std::string unit_;                            // Unit of Sensor
     std::unique_ptr<SensorAccessMechanism> sensorAccess_;
                                                   // sensorAccess mechanism
+    std::mutex readMutex_;                        // serializes reads
+    std::chrono::steady_clock::time_point lastReadTime_;
+                                                  // time of last raw read
+    bool hasRead_ = false;                        // raw read done at least once
+    std::mutex valueMutex_;                       // guards value_, readResult_
+                                                  // and changed_, not held
+                                                  // while reading
+    ReadResult readResult_ = READING_NA;          // Last Read Status
+    bool changed_ = false;                        // status or value changed
+                                                  // since checkChanged()
+    int cacheTime_ = -1;                          // ms a reading is served
+                                                  // from cache, -1 default
+
+    ReadResult rawRead();
 
   public:
     /*
@@ -70,6 +86,12 @@ class Sensor : public Object{
      */
     float getValue();
 
+    /*
+     * Returns last raw read status and sets value to the value of the same
+     * read
+     */
+    ReadResult getReading(float* value);
+
     /*
      * Returns Sensor value
      */
@@ -84,6 +106,28 @@ class Sensor : public Object{
      * sensorRaw
      */
     ReadResult sensorRawRead();
+
+    /*
+     * Returns the last reading if it is younger than the cache time,
+     * reads the sensor otherwise
+     */
+    ReadResult sensorCachedRead();
+
+    /*
+     * Returns true if status or value changed since the last call, and the
+     * current status and value as getReading()
+     */
+    bool checkChanged(ReadResult* status, float* value);
+
+    /*
+     * Sets the cache time in ms, -1 to use the --sensor_cache_ms default
+     */
+    void setCacheTime(int cacheTime);
+
+    /*
+     * Returns access group of the sensor, see SensorAccessMechanism
+     */
+    int getAccessGroup();
 };
 
 } // namespace qin
@@ -20,6 +20,8 @@
 
 #pragma once
 #include <cstdint>
+#include <chrono>
+#include <algorithm>
 
 namespace openbmc {
 namespace qin {
@@ -37,15 +39,30 @@ enum ReadResult {
 
 class Sensor;     //Forward declaration of class Sensor
 
+// Sensors in the same access group share hardware and are never read
+// concurrently. Sensors in no group are read independently.
+#define ACCESS_GROUP_NONE (-1)
+#define ACCESS_GROUP_PAL 0
+
+// Backoff of a sensor that exceeded its retries, in milliseconds
+#define RETRY_BACKOFF_MIN 1000
+#define RETRY_BACKOFF_MAX 60000
+
 class SensorAccessMechanism {
 
 protected:
 
   int8_t maxNofRetry_ = -1; // -1 if no limit
-  uint8_t totalRetry_ = 0;
+  uint8_t totalRetry_ = 0;  // consecutive failed reads
   ReadResult readResult_ = READING_NA;
   uint8_t accessCondition_ = 0; // Allways accessible
 
+  // After maxNofRetry_ consecutive failures the sensor is skipped and only
+  // probed again once retryBackoff_ elapsed; the backoff doubles on every
+  // failed probe up to RETRY_BACKOFF_MAX and resets on a successful read
+  std::chrono::milliseconds retryBackoff_{RETRY_BACKOFF_MIN};
+  std::chrono::steady_clock::time_point nextRetry_;
+
   virtual void rawRead(Sensor* s, float *value);
   virtual bool preRawRead(Sensor* s, float* value) {
     return true;
@@ -54,22 +71,38 @@ protected:
   bool checkAccessConditions(Sensor* s);
 
 public:
+  virtual ~SensorAccessMechanism() {}
+
   bool setAccessConditions(uint8_t accessCondition) {
     this->accessCondition_ = accessCondition;
+    return true;
   }
 
   ReadResult sensorRawRead(Sensor* s, float *value) {
+    auto now = std::chrono::steady_clock::now();
 
     if (checkAccessConditions(s) == false) {
+      *value = 0;
       readResult_ = READING_NA;
       return readResult_;
     }
 
+    // Given up on the sensor, wait for the backoff before probing again
+    if (maxNofRetry_ >= 0 && totalRetry_ >= maxNofRetry_ &&
+        now < nextRetry_) {
+      *value = 0;
+      readResult_ = READING_SKIP;
+      return readResult_;
+    }
+
     if (preRawRead(s, value)){
       rawRead(s, value);
     }
     else {
+      // Not present, e.g. empty socket, this is not a read failure
+      *value = 0;
       readResult_ = READING_NA;
+      return readResult_;
     }
 
     postRawRead(s, value);
@@ -79,15 +112,19 @@ public:
     }
 
     //Max retry logic
-    if (maxNofRetry_ > 0) {
-      if (readResult_ == READING_SUCCESS) {
-        maxNofRetry_ = 0;
-      }
-      else if (maxNofRetry_ > maxNofRetry_){
-        maxNofRetry_++;
+    if (readResult_ == READING_SUCCESS) {
+      totalRetry_ = 0;
+      retryBackoff_ = std::chrono::milliseconds(RETRY_BACKOFF_MIN);
+    }
+    else if (maxNofRetry_ >= 0) {
+      if (totalRetry_ < maxNofRetry_) {
+        totalRetry_++;
       }
-      else {
-        readResult_ =  READING_SKIP;
+      if (totalRetry_ >= maxNofRetry_) {
+        nextRetry_ = now + retryBackoff_;
+        retryBackoff_ = std::min(retryBackoff_ * 2,
+                                 std::chrono::milliseconds(RETRY_BACKOFF_MAX));
+        readResult_ = READING_SKIP;
       }
     }
 
@@ -101,6 +138,14 @@ public:
   void setmaxNofRetry (uint8_t maxNofRetry) {
     this->maxNofRetry_ = maxNofRetry;
   }
+
+  /*
+   * Access group of the sensor, by default all sensors read through the
+   * platform library share one group
+   */
+  virtual int getAccessGroup() {
+    return ACCESS_GROUP_PAL;
+  }
 };
 
 } // namespace qin
@@ -28,6 +28,7 @@
 #include <syslog.h>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <cstring>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
@@ -68,6 +69,11 @@ class SensorAccessVR : public SensorAccessMechanism {
 
     bool preRawRead(Sensor* s, float* value) override;
 
+    // Page select and read must not interleave with other VRs on the bus
+    int getAccessGroup() override {
+      return 0x100 | busId_;
+    }
+
     void rawRead(Sensor* s, float *value) override{
       int fd;
       char fn[32];
@@ -79,7 +85,7 @@ class SensorAccessVR : public SensorAccessMechanism {
 
       readResult_ = READING_NA;
 
-      static uint16_t vrUpdateInProgressCount = 0;
+      static std::atomic<uint16_t> vrUpdateInProgressCount(0);
       if ( access(VR_UPDATE_IN_PROGRESS, F_OK) == 0 )
       {
         //Avoid sensord unmonitoring vr sensors
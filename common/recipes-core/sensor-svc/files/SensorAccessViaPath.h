@@ -44,6 +44,11 @@ class SensorAccessViaPath : public SensorAccessMechanism {
     SensorAccessViaPath(std::string path, float unitDiv)
       : path_(path), unitDiv_(unitDiv) {}
 
+    // sysfs attributes can be read concurrently with anything else
+    int getAccessGroup() override {
+      return ACCESS_GROUP_NONE;
+    }
+
     void rawRead(Sensor* s, float *value) override {
       int pos = path_.find('*');
       while (pos != std::string::npos){
@@ -0,0 +1,121 @@
+/*
+ * SensorIndex.h
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <object-tree/Object.h>
+
+namespace openbmc {
+namespace qin {
+
+/**
+ * Index of the Sensors and FRUs in the subtree of a FRU or SensorService,
+ * by id and by name. Only the part of the subtree reachable through FRUs
+ * is indexed, matching what the SensorTree dbus methods search. The index
+ * is maintained by SensorObjectTree on add and delete.
+ */
+class SensorIndex {
+  public:
+    typedef std::unordered_multimap<uint8_t, Object*> IdMap;
+    typedef std::unordered_multimap<std::string, Object*> NameMap;
+
+    void addSensor(uint8_t id, Object* object) {
+      sensorById_.insert(std::make_pair(id, object));
+      sensorByName_.insert(std::make_pair(object->getName(), object));
+    }
+
+    void removeSensor(uint8_t id, Object* object) {
+      erase(sensorById_, id, object);
+      erase(sensorByName_, object->getName(), object);
+    }
+
+    void addFRU(uint8_t id, Object* object) {
+      fruById_.insert(std::make_pair(id, object));
+      fruByName_.insert(std::make_pair(object->getName(), object));
+    }
+
+    void removeFRU(uint8_t id, Object* object) {
+      erase(fruById_, id, object);
+      erase(fruByName_, object->getName(), object);
+    }
+
+    /**
+     * Find a Sensor or FRU in the subtree, nullptr if there is none.
+     * If several match, any one of them is returned.
+     */
+    Object* findSensor(uint8_t id) const {
+      return find(sensorById_, id);
+    }
+
+    Object* findSensor(const std::string &name) const {
+      return find(sensorByName_, name);
+    }
+
+    Object* findFRU(uint8_t id) const {
+      return find(fruById_, id);
+    }
+
+    Object* findFRU(const std::string &name) const {
+      return find(fruByName_, name);
+    }
+
+    /**
+     * All Sensors in the subtree keyed by id
+     */
+    const IdMap& getSensors() const {
+      return sensorById_;
+    }
+
+    /**
+     * All FRUs in the subtree keyed by name
+     */
+    const NameMap& getFRUs() const {
+      return fruByName_;
+    }
+
+  private:
+    IdMap sensorById_;
+    NameMap sensorByName_;
+    IdMap fruById_;
+    NameMap fruByName_;
+
+    template <typename Map>
+    static Object* find(const Map &map, const typename Map::key_type &key) {
+      auto it = map.find(key);
+      return it == map.end() ? nullptr : it->second;
+    }
+
+    template <typename Map>
+    static void erase(Map &map, const typename Map::key_type &key,
+                      Object* object) {
+      auto range = map.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == object) {
+          map.erase(it);
+          return;
+        }
+      }
+    }
+};
+
+} // namespace qin
+} // namespace openbmc
@@ -191,11 +191,32 @@ void SensorJsonParser::parseSensor(const nlohmann::json &jObject,
       throw std::invalid_argument("Invalid sensor api");
     }
 
-    object = sensorTree.addSensor(name,
-                                  parentPath,
-                                  id,
-                                  unit,
-                                  std::move(upSensorAccess));
+    try {
+      //Skip the sensor after maxRetry consecutive failed reads
+      const std::string &maxRetry = access.at("maxRetry");
+      upSensorAccess->setmaxNofRetry(std::stoi(maxRetry, nullptr, 0));
+    }
+    catch (const std::out_of_range& oor) {
+      //No retry limit if maxRetry is not mentioned
+    }
+
+    Sensor* sensor = sensorTree.addSensor(name,
+                                          parentPath,
+                                          id,
+                                          unit,
+                                          std::move(upSensorAccess));
+    object = sensor;
+
+    try {
+      //Set cache time of batched reads in ms if set in json file
+      const std::string &cacheTime = access.at("cacheTime");
+      if (sensor != nullptr) {
+        sensor->setCacheTime(std::stoi(cacheTime, nullptr, 0));
+      }
+    }
+    catch (const std::out_of_range& oor) {
+      //if cacheTime is not mentioned
+    }
   }
 
   if (object == nullptr) {
@@ -54,7 +54,57 @@ Object* SensorObjectTree::addObject(std::unique_ptr<Object> upObj,
       throw std::invalid_argument("Invalid parent type");
     }
   }
-  return ObjectTree::addObject(std::move(upObj), parentPath);
+  Object* object = ObjectTree::addObject(std::move(upObj), parentPath);
+  updateIndex(object, true);
+  return object;
+}
+
+void SensorObjectTree::deleteObjectByPath(const std::string &path) {
+  Object* object = getObject(path);
+  if (object != nullptr) {
+    updateIndex(object, false);
+  }
+  try {
+    ObjectTree::deleteObjectByPath(path);
+  } catch (...) {
+    // object is still in the tree
+    if (object != nullptr) {
+      updateIndex(object, true);
+    }
+    throw;
+  }
+}
+
+void SensorObjectTree::updateIndex(Object* object, bool add) {
+  Sensor* sensor = dynamic_cast<Sensor*>(object);
+  FRU* fru = dynamic_cast<FRU*>(object);
+  if (sensor == nullptr && fru == nullptr) {
+    return;
+  }
+
+  for (Object* parent = object->getParent(); parent != nullptr;
+       parent = parent->getParent()) {
+    SensorIndex* index = dynamic_cast<SensorIndex*>(parent);
+    if (index == nullptr) {
+      break;
+    }
+    if (sensor != nullptr) {
+      if (add) {
+        index->addSensor(sensor->getId(), sensor);
+      } else {
+        index->removeSensor(sensor->getId(), sensor);
+      }
+    } else {
+      if (add) {
+        index->addFRU(fru->getId(), fru);
+      } else {
+        index->removeFRU(fru->getId(), fru);
+      }
+    }
+    if (dynamic_cast<FRU*>(parent) == nullptr) {
+      break;
+    }
+  }
 }
 
 SensorService* SensorObjectTree::addSensorService(
@@ -100,8 +100,21 @@ class SensorObjectTree : public ObjectTree {
                        const std::string &unit,
                        std::unique_ptr<SensorAccessMechanism> upSensorAccess);
 
+     /**
+      * Delete the object at path and drop it from the indexes of
+      * its FRU and SensorService ancestors.
+      */
+     void deleteObjectByPath(const std::string &path) override;
+
   private:
 
+    /**
+     * Add the Sensor or FRU object to, or remove it from, the SensorIndex
+     * of every ancestor whose subtree search reaches it, i.e. up to and
+     * including the first ancestor that is not a FRU.
+     */
+    void updateIndex(Object* object, bool add);
+
     /**
      * Get the FRU from object.
      */
@@ -174,6 +187,7 @@ class SensorObjectTree : public ObjectTree {
       else {
         dbus->registerObject(path, interface, object);
       }
+      updateIndex(object, true);
       return object;
     }
 };
@@ -20,11 +20,12 @@
 
 #pragma once
 #include <object-tree/Object.h>
+#include "SensorIndex.h"
 
 namespace openbmc {
 namespace qin {
 
-class SensorService : public Object{
+class SensorService : public Object, public SensorIndex {
   public:
     using Object::Object; // inherit constructor
 };
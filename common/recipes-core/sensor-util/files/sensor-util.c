@@ -50,16 +50,30 @@
   static const char * pal_fru_list_sensor_history_t =  pal_fru_list;
 #endif /* CUSTOM_FRU_LIST */
 
-static pthread_mutex_t timer = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t done = PTHREAD_COND_INITIALIZER;
+/* Output format of the sensor readings */
+enum {
+  FORMAT_TEXT = 0,
+  FORMAT_JSON,
+  FORMAT_CSV,
+};
+
+static int out_format = FORMAT_TEXT;
+static bool first_fru = true;
 
 // This is for get_sensor_reading
 typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t done_cond;
+  int refcnt;
+  bool done;
+  bool abandoned;
   uint8_t fru;
   int sensor_cnt;
   int sensor_num;
   bool threshold;
-  uint8_t sensor_list[];  
+  char *out;
+  size_t out_len;
+  uint8_t sensor_list[];
 } get_sensor_reading_struct;
 
 static void
@@ -76,6 +90,8 @@ print_usage() {
   printf("              example --history 4d means history of 4 days\n");
   printf("         --history <period>   show max, min and average values of last <period> seconds\n");
   printf("         --history-clear                    clear history values\n");
+  printf("         --json                             print a snapshot of the readings as JSON\n");
+  printf("         --csv                              print a snapshot of the readings as CSV\n");
 }
 
 static int convert_period(char *str, long *val) {
@@ -108,41 +124,117 @@ static int convert_period(char *str, long *val) {
   return rc;
 }
 
+/* Messages about a FRU go to stderr when the output is machine-readable */
+#define fru_msg(...) \
+  fprintf(out_format == FORMAT_TEXT ? stdout : stderr, __VA_ARGS__)
+
+static void
+print_json_str(FILE *fp, const char *str) {
+
+  fputc('"', fp);
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      fprintf(fp, "\\%c", *str);
+    else if ((unsigned char)*str < 0x20)
+      fprintf(fp, "\\u%04x", *str);
+    else
+      fputc(*str, fp);
+  }
+  fputc('"', fp);
+}
+
 static void
-print_sensor_reading(float fvalue, uint16_t snr_num, thresh_sensor_t *thresh,
-    bool threshold, char *status) {
+print_json_thresh(FILE *fp, const char *name, thresh_sensor_t *thresh, uint8_t bit,
+    float value) {
+
+  fprintf(fp, ", \"%s\": ", name);
+  thresh->flag & GETMASK(bit) ? fprintf(fp, "%.2f", value) : fprintf(fp, "null");
+}
+
+static void
+print_csv_thresh(FILE *fp, thresh_sensor_t *thresh, uint8_t bit, float value) {
+
+  thresh->flag & GETMASK(bit) ? fprintf(fp, ",%.2f", value) : fprintf(fp, ",NA");
+}
+
+static void
+print_sensor_reading(FILE *fp, char *fruname, bool first, bool available,
+    float fvalue, uint16_t snr_num, thresh_sensor_t *thresh, bool threshold,
+    char *status) {
+
+  switch (out_format) {
+    case FORMAT_JSON:
+      fprintf(fp, "%s\n    {\"num\": %u, \"name\": ", first ? "" : ",", snr_num);
+      print_json_str(fp, thresh->name);
+      fprintf(fp, ", \"value\": ");
+      available ? fprintf(fp, "%.2f", fvalue) : fprintf(fp, "null");
+      fprintf(fp, ", \"units\": ");
+      print_json_str(fp, thresh->units);
+      fprintf(fp, ", \"status\": \"%s\"", status);
+      if (threshold) {
+        print_json_thresh(fp, "ucr", thresh, UCR_THRESH, thresh->ucr_thresh);
+        print_json_thresh(fp, "unc", thresh, UNC_THRESH, thresh->unc_thresh);
+        print_json_thresh(fp, "unr", thresh, UNR_THRESH, thresh->unr_thresh);
+        print_json_thresh(fp, "lcr", thresh, LCR_THRESH, thresh->lcr_thresh);
+        print_json_thresh(fp, "lnc", thresh, LNC_THRESH, thresh->lnc_thresh);
+        print_json_thresh(fp, "lnr", thresh, LNR_THRESH, thresh->lnr_thresh);
+      }
+      fprintf(fp, "}");
+      return;
+    case FORMAT_CSV:
+      fprintf(fp, "%s,0x%X,%s,", fruname, snr_num, thresh->name);
+      available ? fprintf(fp, "%.2f", fvalue) : fprintf(fp, "NA");
+      fprintf(fp, ",%s,%s", thresh->units, status);
+      if (threshold) {
+        print_csv_thresh(fp, thresh, UCR_THRESH, thresh->ucr_thresh);
+        print_csv_thresh(fp, thresh, UNC_THRESH, thresh->unc_thresh);
+        print_csv_thresh(fp, thresh, UNR_THRESH, thresh->unr_thresh);
+        print_csv_thresh(fp, thresh, LCR_THRESH, thresh->lcr_thresh);
+        print_csv_thresh(fp, thresh, LNC_THRESH, thresh->lnc_thresh);
+        print_csv_thresh(fp, thresh, LNR_THRESH, thresh->lnr_thresh);
+      }
+      fprintf(fp, "\n");
+      return;
+    default:
+      break;
+  }
 
-  printf("%-28s (0x%X) : %7.2f %-5s | (%s)",
+  if (!available) {
+    fprintf(fp, "%-28s (0x%X) : NA | (na)\n", thresh->name, snr_num);
+    return;
+  }
+
+  fprintf(fp, "%-28s (0x%X) : %7.2f %-5s | (%s)",
       thresh->name, snr_num, fvalue, thresh->units, status);
   if (threshold) {
 
-    printf(" | UCR: ");
+    fprintf(fp, " | UCR: ");
     thresh->flag & GETMASK(UCR_THRESH) ?
-      printf("%.2f", thresh->ucr_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->ucr_thresh) : fprintf(fp, "NA");
 
-    printf(" | UNC: ");
+    fprintf(fp, " | UNC: ");
     thresh->flag & GETMASK(UNC_THRESH) ?
-      printf("%.2f", thresh->unc_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->unc_thresh) : fprintf(fp, "NA");
 
-    printf(" | UNR: ");
+    fprintf(fp, " | UNR: ");
     thresh->flag & GETMASK(UNR_THRESH) ?
-      printf("%.2f", thresh->unr_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->unr_thresh) : fprintf(fp, "NA");
 
-    printf(" | LCR: ");
+    fprintf(fp, " | LCR: ");
     thresh->flag & GETMASK(LCR_THRESH) ?
-      printf("%.2f", thresh->lcr_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->lcr_thresh) : fprintf(fp, "NA");
 
-    printf(" | LNC: ");
+    fprintf(fp, " | LNC: ");
     thresh->flag & GETMASK(LNC_THRESH) ?
-      printf("%.2f", thresh->lnc_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->lnc_thresh) : fprintf(fp, "NA");
 
-    printf(" | LNR: ");
+    fprintf(fp, " | LNR: ");
     thresh->flag & GETMASK(LNR_THRESH) ?
-      printf("%.2f", thresh->lnr_thresh) : printf("NA");
+      fprintf(fp, "%.2f", thresh->lnr_thresh) : fprintf(fp, "NA");
 
   }
 
-  printf("\n");
+  fprintf(fp, "\n");
 }
 
 static void
@@ -167,6 +259,88 @@ get_sensor_status(float fvalue, thresh_sensor_t *thresh, char *status) {
     sprintf(status, STATUS_LNR);
 }
 
+/*
+ * Load the thresholds of all the requested sensors of a FRU in one go.
+ * status[i] is set to non-zero for the sensors which should be skipped.
+ */
+static int
+get_sensor_thresh_list(uint8_t fru, uint8_t *sensor_list, int sensor_cnt,
+    int num, thresh_sensor_t *thresh, int *status) {
+
+  int i, ret;
+  char fruname[32] = {0};
+
+  if (fru == AGGREGATE_SENSOR_FRU_ID) {
+    for (i = 0; i < sensor_cnt; i++) {
+      status[i] = -1;
+      if (num != SENSOR_ALL && sensor_list[i] != num) {
+        continue;
+      }
+      if (aggregate_sensor_threshold(sensor_list[i], &thresh[i])) {
+        syslog(LOG_ERR, "agg_snr_thresh failed for agg num: 0x%X", sensor_list[i]);
+        continue;
+      }
+      status[i] = 0;
+    }
+    return 0;
+  }
+
+  ret = sdr_get_snr_thresh_list(fru, sensor_list, sensor_cnt, thresh, status);
+  if (ret == ERR_NOT_READY) {
+    pal_get_fru_name(fru, fruname);
+    fru_msg("%s SDR is missing!\n", fruname);
+    return ret;
+  } else if (ret < 0) {
+    syslog(LOG_ERR, "sdr_get_snr_thresh_list failed for FRU %d", fru);
+    return ret;
+  }
+
+  for (i = 0; i < sensor_cnt; i++) {
+    if (num != SENSOR_ALL && sensor_list[i] != num) {
+      status[i] = -1;
+    } else if (status[i] < 0) {
+      syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", fru, sensor_list[i]);
+    }
+  }
+  return 0;
+}
+
+static void
+put_sensor_reading(get_sensor_reading_struct *sensor_info) {
+
+  bool last;
+
+  pthread_mutex_lock(&sensor_info->lock);
+  last = (--sensor_info->refcnt == 0);
+  pthread_mutex_unlock(&sensor_info->lock);
+
+  if (last) {
+    pthread_mutex_destroy(&sensor_info->lock);
+    pthread_cond_destroy(&sensor_info->done_cond);
+    free(sensor_info->out);
+    free(sensor_info);
+  }
+}
+
+// Set by the caller under the lock when it stops waiting for the reader
+static bool
+sensor_reading_abandoned(get_sensor_reading_struct *sensor_info) {
+
+  bool abandoned;
+
+  pthread_mutex_lock(&sensor_info->lock);
+  abandoned = sensor_info->abandoned;
+  pthread_mutex_unlock(&sensor_info->lock);
+
+  return abandoned;
+}
+
+/*
+ * Reads every requested sensor of a FRU from the cache in a single pass.
+ * The output is collected into a private buffer so that a reading which
+ * overruns its deadline can be abandoned by the caller without cancelling
+ * this thread (and without it holding any lock or partial output).
+ */
 static void*
 get_sensor_reading(void *sensor_data) {
 
@@ -175,52 +349,66 @@ get_sensor_reading(void *sensor_data) {
   uint8_t snr_num;
   float fvalue;
   char status[8];
-  thresh_sensor_t thresh;
-  int ret = 0;
+  thresh_sensor_t *thresh;
+  int *thresh_status;
   char fruname[32] = {0};
+  bool first = true;
+  bool available;
+  FILE *fp;
+
+  fp = open_memstream(&sensor_info->out, &sensor_info->out_len);
+  thresh = calloc(sensor_info->sensor_cnt, sizeof(thresh_sensor_t));
+  thresh_status = calloc(sensor_info->sensor_cnt, sizeof(int));
+  if (!fp || !thresh || !thresh_status) {
+    goto done;
+  }
 
-  //Allow this thread to be killed at any time
-  pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+  if (sensor_info->fru == AGGREGATE_SENSOR_FRU_ID) {
+    strcpy(fruname, AGGREGATE_SENSOR_FRU_NAME);
+  } else if (pal_get_fru_name(sensor_info->fru, fruname)) {
+    sprintf(fruname, "fru%d", sensor_info->fru);
+  }
 
-  for (i = 0; i < sensor_info->sensor_cnt; i++) {    
-    snr_num = sensor_info->sensor_list[i];
-    /* If calculation is for a single sensor, ignore all others. */
-    if (sensor_info->sensor_num != SENSOR_ALL && snr_num != sensor_info->sensor_num) {
+  if (get_sensor_thresh_list(sensor_info->fru, sensor_info->sensor_list,
+        sensor_info->sensor_cnt, sensor_info->sensor_num, thresh, thresh_status)) {
+    goto done;
+  }
+
+  for (i = 0; i < sensor_info->sensor_cnt; i++) {
+    if (thresh_status[i] < 0) {
       continue;
     }
-
-    if (sensor_info->fru == AGGREGATE_SENSOR_FRU_ID) {
-      if (aggregate_sensor_threshold(snr_num, &thresh)) {
-        syslog(LOG_ERR, "agg_snr_thresh failed for agg num: 0x%X", snr_num);
-        continue;
-      }
-    } else {
-      ret = sdr_get_snr_thresh(sensor_info->fru, snr_num, &thresh);
-      if (ret == ERR_NOT_READY) {
-        pal_get_fru_name(sensor_info->fru, fruname);
-        printf("%s SDR is missing!\n", fruname);
-        //Tell caller it's done
-        pthread_cond_signal(&done);
-        return NULL;
-      }
-      else if (ret < 0) {
-        syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", sensor_info->fru, snr_num);
-        continue;
-      }
+    // Stop early once the caller has given up on this FRU
+    if (sensor_reading_abandoned(sensor_info)) {
+      break;
     }
 
-    usleep(50);
-    if (sensor_cache_read(sensor_info->fru, snr_num, &fvalue) < 0) {
-      printf("%-28s (0x%X) : NA | (na)\n", thresh.name, sensor_info->sensor_list[i]);
-      continue;
+    snr_num = sensor_info->sensor_list[i];
+    available = (sensor_cache_read(sensor_info->fru, snr_num, &fvalue) == 0);
+    if (available) {
+      get_sensor_status(fvalue, &thresh[i], status);
     } else {
-      get_sensor_status(fvalue, &thresh, status);
-      print_sensor_reading(fvalue, (uint16_t)snr_num, &thresh, sensor_info->threshold, status);
+      strcpy(status, "na");
     }
+    print_sensor_reading(fp, fruname, first, available, fvalue, (uint16_t)snr_num,
+        &thresh[i], sensor_info->threshold, status);
+    first = false;
   }
 
+done:
+  if (fp) {
+    fclose(fp);
+  }
+  free(thresh);
+  free(thresh_status);
+
   //Tell caller it's done
-  pthread_cond_signal(&done);
+  pthread_mutex_lock(&sensor_info->lock);
+  sensor_info->done = true;
+  pthread_cond_signal(&sensor_info->done_cond);
+  pthread_mutex_unlock(&sensor_info->lock);
+
+  put_sensor_reading(sensor_info);
   return NULL;
 }
 
@@ -230,43 +418,38 @@ get_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num, i
   int start_time, i;
   uint8_t snr_num;
   float min, average, max;
-  thresh_sensor_t thresh;
-  int ret = 0;
-  char fruname[32] = {0};
+  thresh_sensor_t *thresh;
+  int *thresh_status;
 
   start_time = time(NULL) - period;
 
+  thresh = calloc(sensor_cnt, sizeof(thresh_sensor_t));
+  thresh_status = calloc(sensor_cnt, sizeof(int));
+  if (!thresh || !thresh_status) {
+    goto bail;
+  }
+
+  if (get_sensor_thresh_list(fru, sensor_list, sensor_cnt, num, thresh, thresh_status)) {
+    goto bail;
+  }
+
   for (i = 0; i < sensor_cnt; i++) {
-    snr_num = sensor_list[i];
-    if (num != SENSOR_ALL && snr_num != num) {
+    if (thresh_status[i] < 0) {
       continue;
     }
-
-    if (fru == AGGREGATE_SENSOR_FRU_ID) {
-      if (aggregate_sensor_threshold(snr_num, &thresh)) {
-        syslog(LOG_ERR, "agg_snr_threshold failed 0x%x", snr_num);
-        continue;
-      }
-    } else {
-      ret = sdr_get_snr_thresh(fru, snr_num, &thresh);
-      if (ret == ERR_NOT_READY) {
-        pal_get_fru_name(fru, fruname);
-        printf("%s SDR is missing!\n", fruname);
-        return;
-      }
-      else if (ret < 0) {
-        syslog(LOG_ERR, "sdr_get_snr_thresh failed for FRU %d num: 0x%X", fru, snr_num);
-        continue;
-      }
-    }
+    snr_num = sensor_list[i];
 
     if (sensor_read_history(fru, snr_num, &min, &average, &max, start_time) < 0) {
-      printf("%-18s (0x%X) min = NA, average = NA, max = NA\n", thresh.name, snr_num);
+      printf("%-18s (0x%X) min = NA, average = NA, max = NA\n", thresh[i].name, snr_num);
       continue;
     }
 
-    printf("%-18s (0x%X) min = %.2f, average = %.2f, max = %.2f\n", thresh.name, snr_num, min, average, max);
+    printf("%-18s (0x%X) min = %.2f, average = %.2f, max = %.2f\n", thresh[i].name, snr_num, min, average, max);
   }
+
+bail:
+  free(thresh);
+  free(thresh_status);
 }
 
 static void clear_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, int num) {
@@ -284,36 +467,53 @@ static void clear_sensor_history(uint8_t fru, uint8_t *sensor_list, int sensor_c
   }
 }
 
-void get_sensor_reading_timer(struct timespec *timeout, get_sensor_reading_struct *sensor_data)
+static void
+get_sensor_reading_timer(struct timespec *timeout, get_sensor_reading_struct *sensor_data)
 {
   struct timespec abs_time;
   pthread_t tid_get_sensor_reading;
-  int err;
+  int err = 0;
   char fruname[32] = {0};
 
-  pthread_mutex_lock(&timer);
-
   //Assign the timeout time to abs_time
   clock_gettime(CLOCK_REALTIME, &abs_time);
   abs_time.tv_sec += timeout->tv_sec;
   abs_time.tv_nsec += timeout->tv_nsec;
 
-  //Make get_sensor_reading a thread
-  pthread_create(&tid_get_sensor_reading, NULL, get_sensor_reading, (void *) sensor_data);
-
-  //Timer thread, continue only when get_sensor_reading send the done signal or abs_time timed out
-  err = pthread_cond_timedwait(&done, &timer, &abs_time);
+  //Make get_sensor_reading a thread, it holds its own reference to the data
+  sensor_data->refcnt = 2;
+  if (pthread_create(&tid_get_sensor_reading, NULL, get_sensor_reading, (void *) sensor_data)) {
+    sensor_data->refcnt = 1;
+    put_sensor_reading(sensor_data);
+    return;
+  }
 
-  //Timeout actions
-  if (err == ETIMEDOUT) {
-    pal_get_fru_name(sensor_data->fru, fruname);
-    printf("FRU:%s timed out...\n", fruname);
-    pthread_cancel(tid_get_sensor_reading);
+  //Continue only when get_sensor_reading is done or abs_time timed out
+  pthread_mutex_lock(&sensor_data->lock);
+  while (!sensor_data->done && err != ETIMEDOUT) {
+    err = pthread_cond_timedwait(&sensor_data->done_cond, &sensor_data->lock, &abs_time);
   }
 
-  pthread_mutex_unlock(&timer);
+  //Timeout actions: leave the reader to finish on its own and drop its output
+  if (!sensor_data->done) {
+    sensor_data->abandoned = true;
+    pthread_mutex_unlock(&sensor_data->lock);
+    pthread_detach(tid_get_sensor_reading);
+    if (sensor_data->fru == AGGREGATE_SENSOR_FRU_ID) {
+      strcpy(fruname, AGGREGATE_SENSOR_FRU_NAME);
+    } else {
+      pal_get_fru_name(sensor_data->fru, fruname);
+    }
+    fru_msg("FRU:%s timed out...\n", fruname);
+  } else {
+    pthread_mutex_unlock(&sensor_data->lock);
+    pthread_join(tid_get_sensor_reading, NULL);
+    if (sensor_data->out_len) {
+      fwrite(sensor_data->out, 1, sensor_data->out_len, stdout);
+    }
+  }
 
-  return;
+  put_sensor_reading(sensor_data);
 }
 
 static int
@@ -322,9 +522,9 @@ print_sensor(uint8_t fru, int sensor_num, bool history, bool threshold, bool his
   uint8_t status;
   int sensor_cnt;
   uint8_t *sensor_list;
-  char fruname[16] = {0};
+  char fruname[32] = {0};
   struct timespec timeout;
-  get_sensor_reading_struct data;
+  get_sensor_reading_struct *data;
 
   //Setup 4 seconds timeout for each fru get_sensor_reading
   memset(&timeout, 0, sizeof(timeout));
@@ -353,23 +553,23 @@ print_sensor(uint8_t fru, int sensor_num, bool history, bool threshold, bool his
     }
     ret = pal_is_fru_prsnt(fru, &status);
     if (ret < 0) {
-      printf("pal_is_fru_prsnt failed for fru: %s\n", fruname);
+      fru_msg("pal_is_fru_prsnt failed for fru: %s\n", fruname);
       return ret;
     }
     if (status == 0) {
-      printf("%s is not present!\n\n", fruname);
+      fru_msg("%s is not present!\n\n", fruname);
       return -1;
     }
 
     ret = pal_is_fru_ready(fru, &status);
     if ((ret < 0) || (status == 0)) {
-      printf("%s is unavailable!\n\n", fruname);
+      fru_msg("%s is unavailable!\n\n", fruname);
       return ret;
     }
 
     ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
     if (ret < 0) {
-      printf("%s get sensor list failed!\n", fruname);
+      fru_msg("%s get sensor list failed!\n", fruname);
       return ret;
     }
   }
@@ -379,17 +579,36 @@ print_sensor(uint8_t fru, int sensor_num, bool history, bool threshold, bool his
   } else if (history) {
     get_sensor_history(fru, sensor_list, sensor_cnt, sensor_num, period);
   } else {
-    data.fru = fru;
-    data.sensor_cnt = sensor_cnt;
-    data.sensor_num = sensor_num;
-    data.threshold = threshold;
-    memcpy(data.sensor_list, sensor_list, sizeof(uint8_t)*sensor_cnt);
-    get_sensor_reading_timer(&timeout, &data);
+    data = calloc(1, sizeof(get_sensor_reading_struct) + sizeof(uint8_t)*sensor_cnt);
+    if (!data) {
+      return -1;
+    }
+    pthread_mutex_init(&data->lock, NULL);
+    pthread_cond_init(&data->done_cond, NULL);
+    data->refcnt = 1;
+    data->fru = fru;
+    data->sensor_cnt = sensor_cnt;
+    data->sensor_num = sensor_num;
+    data->threshold = threshold;
+    memcpy(data->sensor_list, sensor_list, sizeof(uint8_t)*sensor_cnt);
+
+    if (out_format == FORMAT_JSON) {
+      printf("%s\n  ", first_fru ? "{" : ",");
+      print_json_str(stdout, fruname);
+      printf(": [");
+      first_fru = false;
+      get_sensor_reading_timer(&timeout, data);
+      printf("\n  ]");
+      fflush(stdout);
+      return 0;
+    }
+    get_sensor_reading_timer(&timeout, data);
   }
 
   //Print Empty Line to separate frus,
   //only when sensor_cnt greater than 0, not history-clear, and sensor_num is not specified
-  if ( (sensor_cnt > 0) && (!history_clear) && (sensor_num == SENSOR_ALL) ){
+  if ( (sensor_cnt > 0) && (!history_clear) && (sensor_num == SENSOR_ALL) &&
+       (out_format == FORMAT_TEXT) ){
     printf("\n");
   }
 
@@ -407,6 +626,8 @@ int parse_args(int argc, char *argv[], char *fruname,
     {"history-clear", no_argument, 0, 'c'},
     {"history", required_argument, 0, 'h'},
     {"threshold", no_argument,     0, 't'},
+    {"json", no_argument,          0, 'j'},
+    {"csv", no_argument,           0, 'v'},
     {0,0,0,0},
   };
 
@@ -417,8 +638,14 @@ int parse_args(int argc, char *argv[], char *fruname,
   *period = 60;
   *snr = -1;
 
-  while(-1 != (ret = getopt_long(argc, argv, "ch:t", long_opts, &index))) {
+  while(-1 != (ret = getopt_long(argc, argv, "ch:tjv", long_opts, &index))) {
     switch(ret) {
+      case 'j':
+        out_format = FORMAT_JSON;
+        break;
+      case 'v':
+        out_format = FORMAT_CSV;
+        break;
       case 'c':
         *history_clear = true;
         break;
@@ -453,6 +680,10 @@ int parse_args(int argc, char *argv[], char *fruname,
   if (num > 1) {
     return -1;
   }
+  /* Machine-readable output is a snapshot of the current readings */
+  if (out_format != FORMAT_TEXT && (*history_clear || *history)) {
+    return -1;
+  }
 
   return 0;
 }
@@ -493,6 +724,11 @@ main(int argc, char **argv) {
     }
   }
 
+  if (out_format == FORMAT_CSV) {
+    printf("fru,num,name,value,units,status%s\n",
+        threshold ? ",ucr,unc,unr,lcr,lnc,lnr" : "");
+  }
+
   if (fru == 0) {
     for (fru = 1; fru <= MAX_NUM_FRUS; fru++) {
       ret |= print_sensor(fru, num, history, threshold, history_clear, period);
@@ -501,5 +737,9 @@ main(int argc, char **argv) {
   } else {
     ret = print_sensor(fru, num, history, threshold, history_clear, period);
   }
+
+  if (out_format == FORMAT_JSON) {
+    printf("%s}\n", first_fru ? "{" : "\n");
+  }
   return ret;
 }
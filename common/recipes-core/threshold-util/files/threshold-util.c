@@ -84,25 +84,13 @@ is_fru_valid(uint8_t fru) {
 static int
 clear_thresh_value_setting(uint8_t fru) {
   int ret;
-  char fpath[64] = {0};
-  char cmd[128] = {0};
-  char fruname[16] = {0};
 
-  ret = pal_get_fru_name(fru, fruname);
+  // Removing the override table makes sensord restore the defaults
+  ret = pal_clear_thresh_value(fru);
   if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
+    printf("%s: Fail to clear fru%d threshold table\n",__func__,fru);
     return ret;
   }
-  
-  memset(fpath, 0, sizeof(fpath));
-  sprintf(fpath, THRESHOLD_BIN, fruname);
-  sprintf(cmd,"rm -rf %s",fpath);
-  system(cmd);
-
-  memset(fpath, 0, sizeof(fpath));
-  sprintf(fpath, THRESHOLD_RE_FLAG, fruname);
-  sprintf(cmd,"touch %s",fpath);
-  system(cmd); 
 
   return 0;
 }
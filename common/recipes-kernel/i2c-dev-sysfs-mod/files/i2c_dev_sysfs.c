@@ -20,12 +20,15 @@
 
 //#define DEBUG
 
+#include <linux/bitmap.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
 #include <linux/i2c.h>
+#include <linux/jiffies.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
@@ -45,6 +48,117 @@
 
 #endif
 
+/* The register address is a single byte */
+#define I2C_DEV_MAX_REGS 256
+
+static unsigned int volatile_ms = 20;
+module_param(volatile_ms, uint, 0644);
+MODULE_PARM_DESC(volatile_ms,
+                 "How long (ms) a volatile register value is reused, 0 to always read");
+
+/*
+ * Register cache. Only devices set up through
+ * i2c_dev_sysfs_data_init_regmap() have one (idd_n_regs > 0), for all the
+ * others every access goes to the device as before. All the functions below
+ * are called with idd_lock held.
+ */
+static bool i2c_dev_cache_fresh(i2c_dev_data_st *data, int reg)
+{
+  if (reg >= data->idd_n_regs || !test_bit(reg, data->idd_valid)) {
+    return false;
+  }
+  if (data->idd_reg_flags[reg] & I2C_DEV_REG_NONVOLATILE) {
+    return true;
+  }
+  return time_before(jiffies,
+                     data->idd_cache_time[reg] + msecs_to_jiffies(volatile_ms));
+}
+
+static void i2c_dev_cache_update(i2c_dev_data_st *data, int reg, uint8_t val)
+{
+  if (reg >= data->idd_n_regs
+      || (data->idd_reg_flags[reg] & I2C_DEV_REG_NOCACHE)) {
+    return;
+  }
+  data->idd_cache[reg] = val;
+  data->idd_cache_time[reg] = jiffies;
+  set_bit(reg, data->idd_valid);
+}
+
+/* A write may change any volatile register, only non-volatile ones are kept */
+static void i2c_dev_cache_write(i2c_dev_data_st *data, int reg, uint8_t val)
+{
+  int i;
+
+  for (i = 0; i < data->idd_n_regs; i++) {
+    if (!(data->idd_reg_flags[i] & I2C_DEV_REG_NONVOLATILE)) {
+      clear_bit(i, data->idd_valid);
+    }
+  }
+  if (reg < data->idd_n_regs
+      && (data->idd_reg_flags[reg] & I2C_DEV_REG_NONVOLATILE)) {
+    i2c_dev_cache_update(data, reg, val);
+  }
+}
+
+/* Read a run of registers from the device, in I2C block reads if possible */
+static int i2c_dev_read_regs(struct i2c_client *client,
+                             i2c_dev_data_st *data,
+                             int reg, uint8_t values[], int nbytes)
+{
+  int i, len, ret;
+
+  for (i = 0; i < nbytes; i += len) {
+    if (data->idd_block_read && nbytes - i > 1) {
+      len = min(nbytes - i, I2C_SMBUS_BLOCK_MAX);
+      ret = i2c_smbus_read_i2c_block_data(client, reg + i, len, &values[i]);
+      if (ret < 0) {
+        return ret;
+      }
+      if (ret != len) {
+        return -EIO;
+      }
+    } else {
+      len = 1;
+      ret = i2c_smbus_read_byte_data(client, reg + i);
+      if (ret < 0) {
+        return ret;
+      }
+      values[i] = ret;
+    }
+  }
+  return nbytes;
+}
+
+/*
+ * Read nbytes registers starting at reg. Values still fresh in the cache
+ * are taken from there, the rest is read from the device in contiguous runs.
+ */
+static int i2c_dev_fetch(struct i2c_client *client,
+                         i2c_dev_data_st *data,
+                         int reg, uint8_t values[], int nbytes)
+{
+  int i, j, start, ret;
+
+  for (i = 0; i < nbytes;) {
+    if (i2c_dev_cache_fresh(data, reg + i)) {
+      values[i] = data->idd_cache[reg + i];
+      i++;
+      continue;
+    }
+    for (start = i; i < nbytes && !i2c_dev_cache_fresh(data, reg + i); i++);
+    ret = i2c_dev_read_regs(client, data, reg + start, &values[start],
+                            i - start);
+    if (ret < 0) {
+      return ret;
+    }
+    for (j = start; j < i; j++) {
+      i2c_dev_cache_update(data, reg + j, values[j]);
+    }
+  }
+  return nbytes;
+}
+
 ssize_t i2c_dev_show_label(struct device *dev,
                            struct device_attribute *attr,
                            char *buf)
@@ -66,6 +180,7 @@ int i2c_dev_read_byte(struct device *dev,
   i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
+  uint8_t value;
   int val;
   int val_mask;
 
@@ -73,7 +188,7 @@ int i2c_dev_read_byte(struct device *dev,
 
   mutex_lock(&data->idd_lock);
 
-  val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  val = i2c_dev_fetch(client, data, dev_attr->ida_reg, &value, 1);
 
   mutex_unlock(&data->idd_lock);
 
@@ -82,7 +197,7 @@ int i2c_dev_read_byte(struct device *dev,
     return val;
   }
 
-  val = (val >> dev_attr->ida_bit_offset) & val_mask;
+  val = (value >> dev_attr->ida_bit_offset) & val_mask;
   return val;
 }
 EXPORT_SYMBOL_GPL(i2c_dev_read_byte);
@@ -96,24 +211,12 @@ int i2c_dev_read_nbytes(struct device *dev,
   i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int i;
   int ret_val;
 
   mutex_lock(&data->idd_lock);
-  for (i = 0; i < nbytes; ++i) {
-    ret_val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg + i);
-    if (ret_val < 0) {
-      mutex_unlock(&data->idd_lock);
-      return ret_val;
-    }
-    if (ret_val > 255) {
-      mutex_unlock(&data->idd_lock);
-      return EFAULT;
-    }
-    values[i] = ret_val;
-  }
+  ret_val = i2c_dev_fetch(client, data, dev_attr->ida_reg, values, nbytes);
   mutex_unlock(&data->idd_lock);
-  return nbytes;
+  return ret_val;
 }
 EXPORT_SYMBOL_GPL(i2c_dev_read_nbytes);
 
@@ -176,6 +279,7 @@ static ssize_t i2c_dev_sysfs_show(struct device *dev,
   i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
+  uint8_t value;
   int val;
   int val_mask;
 
@@ -192,7 +296,7 @@ static ssize_t i2c_dev_sysfs_show(struct device *dev,
   mutex_lock(&data->idd_lock);
 
   /* default handling */
-  val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  val = i2c_dev_fetch(client, data, dev_attr->ida_reg, &value, 1);
 
   mutex_unlock(&data->idd_lock);
 
@@ -201,7 +305,7 @@ static ssize_t i2c_dev_sysfs_show(struct device *dev,
     return val;
   }
 
-  val = (val >> dev_attr->ida_bit_offset) & val_mask;
+  val = (value >> dev_attr->ida_bit_offset) & val_mask;
 
   return scnprintf(buf, PAGE_SIZE, "0x%x%s%s\n", val,
                    (dev_attr->ida_help) ? "\n\nNote:\n" : "",
@@ -217,6 +321,7 @@ static ssize_t i2c_dev_sysfs_store(struct device *dev,
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
   int val;
+  int ret;
   int req_val;
   int req_val_mask;
 
@@ -237,8 +342,17 @@ static ssize_t i2c_dev_sysfs_store(struct device *dev,
 
   mutex_lock(&data->idd_lock);
 
-  /* default handling, first read back the current value */
-  val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  /*
+   * default handling, first read back the current value. Only a
+   * non-volatile register can be taken from the cache here.
+   */
+  if (dev_attr->ida_reg < data->idd_n_regs
+      && (data->idd_reg_flags[dev_attr->ida_reg] & I2C_DEV_REG_NONVOLATILE)
+      && i2c_dev_cache_fresh(data, dev_attr->ida_reg)) {
+    val = data->idd_cache[dev_attr->ida_reg];
+  } else {
+    val = i2c_smbus_read_byte_data(client, dev_attr->ida_reg);
+  }
 
   if (val < 0) {
     /* fail to read */
@@ -249,7 +363,12 @@ static ssize_t i2c_dev_sysfs_store(struct device *dev,
   val &= ~(req_val_mask << dev_attr->ida_bit_offset);
   val |= req_val << dev_attr->ida_bit_offset;
 
-  val = i2c_smbus_write_byte_data(client, dev_attr->ida_reg, val);
+  ret = i2c_smbus_write_byte_data(client, dev_attr->ida_reg, val);
+  if (ret < 0) {
+    val = ret;
+  } else {
+    i2c_dev_cache_write(data, dev_attr->ida_reg, val);
+  }
 
  unlock_out:
   mutex_unlock(&data->idd_lock);
@@ -270,6 +389,14 @@ void i2c_dev_sysfs_data_clean(struct i2c_client *client, i2c_dev_data_st *data)
   if (data->idd_hwmon_dev) {
     hwmon_device_unregister(data->idd_hwmon_dev);
   }
+  if (data->idd_snapshot.attr.name) {
+    sysfs_remove_bin_file(&client->dev.kobj, &data->idd_snapshot);
+  }
+  kfree(data->idd_cache);
+  kfree(data->idd_reg_flags);
+  kfree(data->idd_cache_time);
+  kfree(data->idd_used);
+  kfree(data->idd_valid);
   if (data->idd_attr_group.attrs) {
     sysfs_remove_group(&client->dev.kobj, &data->idd_attr_group);
     kfree(data->idd_attr_group.attrs);
@@ -281,10 +408,177 @@ void i2c_dev_sysfs_data_clean(struct i2c_client *client, i2c_dev_data_st *data)
 }
 EXPORT_SYMBOL_GPL(i2c_dev_sysfs_data_clean);
 
-int i2c_dev_sysfs_data_init(struct i2c_client *client,
-                            i2c_dev_data_st *data,
-                            const i2c_dev_attr_st *dev_attrs,
-                            int n_attrs)
+/*
+ * "snapshot" binary attribute: the whole register file in one read. A read
+ * at offset 0 refreshes every register used by an attribute, in I2C block
+ * reads where the device supports them; reads further in return the same
+ * snapshot. Registers not used by any attribute or flagged
+ * I2C_DEV_REG_NOCACHE read as 0.
+ */
+static ssize_t i2c_dev_snapshot_read(struct file *filp, struct kobject *kobj,
+                                     struct bin_attribute *attr,
+                                     char *buf, loff_t off, size_t count)
+{
+  struct device *dev = container_of(kobj, struct device, kobj);
+  struct i2c_client *client = to_i2c_client(dev);
+  i2c_dev_data_st *data = i2c_get_clientdata(client);
+  int i, j, start;
+  int ret = 0;
+
+  if (off >= data->idd_n_regs) {
+    return 0;
+  }
+  if (off + count > data->idd_n_regs) {
+    count = data->idd_n_regs - off;
+  }
+
+  mutex_lock(&data->idd_lock);
+
+  for (i = 0; off == 0 && i < data->idd_n_regs;) {
+    if (!test_bit(i, data->idd_used)) {
+      i++;
+      continue;
+    }
+    for (start = i; i < data->idd_n_regs && test_bit(i, data->idd_used); i++);
+    ret = i2c_dev_read_regs(client, data, start, &data->idd_cache[start],
+                            i - start);
+    if (ret < 0) {
+      break;
+    }
+    for (j = start; j < i; j++) {
+      i2c_dev_cache_update(data, j, data->idd_cache[j]);
+    }
+  }
+
+  if (ret >= 0) {
+    for (i = 0; i < count; i++) {
+      buf[i] = test_bit(off + i, data->idd_used) ? data->idd_cache[off + i] : 0;
+    }
+    ret = count;
+  }
+
+  mutex_unlock(&data->idd_lock);
+
+  return ret;
+}
+
+/*
+ * Not every device advances the register address through an I2C block
+ * read. Block reads are only used if a block read of the first run of
+ * registers used by attributes matches the byte reads of the same
+ * registers, and the run holds different values so that a device repeating
+ * one register cannot pass. A register changing in between only turns
+ * block reads off.
+ */
+static bool i2c_dev_probe_block_read(struct i2c_client *client,
+                                     i2c_dev_data_st *data)
+{
+  uint8_t bytes[4];
+  uint8_t block[4];
+  bool distinct = false;
+  int i, start, n;
+  int ret;
+
+  if (!i2c_check_functionality(client->adapter,
+                               I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+    return false;
+  }
+
+  for (start = 0; start < data->idd_n_regs; start++) {
+    if (test_bit(start, data->idd_used)) {
+      break;
+    }
+  }
+  for (n = 0; n < sizeof(bytes) && start + n < data->idd_n_regs
+         && test_bit(start + n, data->idd_used); n++);
+  if (n < 2) {
+    return false;
+  }
+
+  for (i = 0; i < n; i++) {
+    ret = i2c_smbus_read_byte_data(client, start + i);
+    if (ret < 0) {
+      return false;
+    }
+    bytes[i] = ret;
+    distinct |= (bytes[i] != bytes[0]);
+  }
+  ret = i2c_smbus_read_i2c_block_data(client, start, n, block);
+  if (ret != n || memcmp(bytes, block, n) || !distinct) {
+    return false;
+  }
+  return true;
+}
+
+static int i2c_dev_regmap_init(struct i2c_client *client,
+                               i2c_dev_data_st *data,
+                               const i2c_dev_attr_st *dev_attrs,
+                               int n_attrs,
+                               const i2c_dev_reg_st *regs,
+                               int n_regs)
+{
+  int i, reg, nbytes;
+  int n = 0;
+
+  for (i = 0; i < n_attrs; i++) {
+    nbytes = max((dev_attrs[i].ida_n_bits + 7) / 8, 1);
+    n = max(n, dev_attrs[i].ida_reg + nbytes);
+  }
+  n = min(n, I2C_DEV_MAX_REGS);
+  if (n <= 0) {
+    return 0;
+  }
+
+  data->idd_cache = kzalloc(n, GFP_KERNEL);
+  data->idd_reg_flags = kzalloc(n, GFP_KERNEL);
+  data->idd_cache_time = kcalloc(n, sizeof(*data->idd_cache_time), GFP_KERNEL);
+  data->idd_used = kcalloc(BITS_TO_LONGS(n), sizeof(long), GFP_KERNEL);
+  data->idd_valid = kcalloc(BITS_TO_LONGS(n), sizeof(long), GFP_KERNEL);
+  if (!data->idd_cache || !data->idd_reg_flags || !data->idd_cache_time
+      || !data->idd_used || !data->idd_valid) {
+    return -ENOMEM;
+  }
+  data->idd_n_regs = n;
+
+  for (i = 0; i < n_regs; i++) {
+    for (reg = max(regs[i].idr_first, 0);
+         reg <= regs[i].idr_last && reg < n; reg++) {
+      data->idd_reg_flags[reg] = regs[i].idr_flags;
+    }
+  }
+  for (i = 0; i < n_attrs; i++) {
+    nbytes = max((dev_attrs[i].ida_n_bits + 7) / 8, 1);
+    for (reg = dev_attrs[i].ida_reg;
+         reg < dev_attrs[i].ida_reg + nbytes && reg < n; reg++) {
+      if (reg >= 0 && !(data->idd_reg_flags[reg] & I2C_DEV_REG_NOCACHE)) {
+        set_bit(reg, data->idd_used);
+      }
+    }
+  }
+
+  data->idd_block_read = i2c_dev_probe_block_read(client, data);
+  PP_DEBUG("Register cache of %d registers, block read %s",
+           n, data->idd_block_read ? "on" : "off");
+
+  sysfs_bin_attr_init(&data->idd_snapshot);
+  data->idd_snapshot.attr.name = "snapshot";
+  data->idd_snapshot.attr.mode = S_IRUSR;
+  data->idd_snapshot.size = n;
+  data->idd_snapshot.read = i2c_dev_snapshot_read;
+  if (sysfs_create_bin_file(&client->dev.kobj, &data->idd_snapshot)) {
+    /* the cache works without it */
+    data->idd_snapshot.attr.name = NULL;
+  }
+  return 0;
+}
+
+static int i2c_dev_sysfs_init(struct i2c_client *client,
+                              i2c_dev_data_st *data,
+                              const i2c_dev_attr_st *dev_attrs,
+                              int n_attrs,
+                              const i2c_dev_reg_st *regs,
+                              int n_regs,
+                              bool regmap)
 {
   int i;
   int err;
@@ -328,6 +622,12 @@ int i2c_dev_sysfs_data_init(struct i2c_client *client,
     PP_DEBUG("Created attribute \"%s\"", cur_attr->isa_dev_attr.attr.name);
   }
 
+  if (regmap
+      && (err = i2c_dev_regmap_init(client, data, dev_attrs, n_attrs,
+                                    regs, n_regs))) {
+    goto exit_cleanup;
+  }
+
   /* Register sysfs hooks */
   if ((err = sysfs_create_group(&client->dev.kobj, &data->idd_attr_group))) {
     goto exit_cleanup;
@@ -347,8 +647,38 @@ int i2c_dev_sysfs_data_init(struct i2c_client *client,
   i2c_dev_sysfs_data_clean(client, data);
   return err;
 }
+
+int i2c_dev_sysfs_data_init(struct i2c_client *client,
+                            i2c_dev_data_st *data,
+                            const i2c_dev_attr_st *dev_attrs,
+                            int n_attrs)
+{
+  return i2c_dev_sysfs_init(client, data, dev_attrs, n_attrs, NULL, 0, false);
+}
 EXPORT_SYMBOL_GPL(i2c_dev_sysfs_data_init);
 
+/*
+ * Same as i2c_dev_sysfs_data_init(), plus a cache of the registers used by
+ * the attributes, I2C block reads when the device supports them and the
+ * "snapshot" attribute. regs flags registers or register ranges, see
+ * I2C_DEV_REG_NONVOLATILE and I2C_DEV_REG_NOCACHE. Only for devices whose
+ * registers are plain, unpaged byte registers.
+ *
+ * Can be exercised without hardware through i2c-stub, see
+ * test/i2c-dev-sysfs-test.c.
+ */
+int i2c_dev_sysfs_data_init_regmap(struct i2c_client *client,
+                                   i2c_dev_data_st *data,
+                                   const i2c_dev_attr_st *dev_attrs,
+                                   int n_attrs,
+                                   const i2c_dev_reg_st *regs,
+                                   int n_regs)
+{
+  return i2c_dev_sysfs_init(client, data, dev_attrs, n_attrs,
+                            regs, n_regs, true);
+}
+EXPORT_SYMBOL_GPL(i2c_dev_sysfs_data_init_regmap);
+
 
 MODULE_AUTHOR("Tian Fang <tfang@fb.com>");
 MODULE_DESCRIPTION("i2c device sysfs attribute library");
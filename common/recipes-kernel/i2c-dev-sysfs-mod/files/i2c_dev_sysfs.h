@@ -52,17 +52,48 @@ typedef struct i2c_sysfs_attr_st_{
 #define TO_I2C_SYSFS_ATTR(_attr) \
 	container_of(_attr, i2c_sysfs_attr_st, isa_dev_attr)
 
+/*
+ * Register flags for i2c_dev_sysfs_data_init_regmap(). Registers without an
+ * entry are volatile: a value read from the device is reused for at most
+ * volatile_ms (module parameter) and dropped by any write to the device.
+ * A register a firmware update can change, such as a CPLD revision, is not
+ * non-volatile.
+ */
+#define I2C_DEV_REG_NONVOLATILE 0x1 /* only changes when written, cached */
+#define I2C_DEV_REG_NOCACHE     0x2 /* never reused, e.g. read to clear */
+
+typedef struct i2c_dev_reg_st_ {
+  int idr_first;
+  int idr_last;
+  int idr_flags;
+} i2c_dev_reg_st;
+
 typedef struct i2c_dev_data_st_ {
   struct device *idd_hwmon_dev;
   struct mutex idd_lock;
   i2c_sysfs_attr_st *idd_attrs;
   struct attribute_group idd_attr_group;
+  /* register cache, only set up by i2c_dev_sysfs_data_init_regmap() */
+  int idd_n_regs;
+  uint8_t *idd_cache;
+  uint8_t *idd_reg_flags;
+  unsigned long *idd_cache_time;
+  unsigned long *idd_used;
+  unsigned long *idd_valid;
+  bool idd_block_read;
+  struct bin_attribute idd_snapshot;
 } i2c_dev_data_st;
 
 int i2c_dev_sysfs_data_init(struct i2c_client *client,
                             i2c_dev_data_st *data,
                             const i2c_dev_attr_st *dev_attrs,
                             int n_attrs);
+int i2c_dev_sysfs_data_init_regmap(struct i2c_client *client,
+                                   i2c_dev_data_st *data,
+                                   const i2c_dev_attr_st *dev_attrs,
+                                   int n_attrs,
+                                   const i2c_dev_reg_st *regs,
+                                   int n_regs);
 void i2c_dev_sysfs_data_clean(struct i2c_client *client, i2c_dev_data_st *data);
 int i2c_dev_read_byte(struct device *dev,
                       struct device_attribute *attr);
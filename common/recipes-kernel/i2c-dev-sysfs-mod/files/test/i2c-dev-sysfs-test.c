@@ -0,0 +1,241 @@
+/*
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * i2c_dev_sysfs register cache test on i2c-stub, with the wedge100
+ * syscpld driver as the client:
+ *
+ *   modprobe i2c-stub chip_addr=0x31
+ *   insmod i2c_dev_sysfs.ko && insmod syscpld.ko
+ *   i2c-dev-sysfs-test <N>      N: the i2c-stub bus number
+ *
+ * The CPLD registers are loaded into i2c-stub before syscpld is created on
+ * it, so the block read probe sees them, and the device is removed again
+ * at the end. Registers are then changed behind the driver through
+ * /dev/i2c-N to see what is served from the cache. Only for an i2c-stub
+ * bus, it writes the CPLD registers.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <openbmc/obmc-i2c.h>
+
+#define CPLD_ADDR 0x31
+#define CPLD_DRIVER "syscpld"
+
+#define REG_BOARD 0x00     /* board_rev, model_id: strapped, cached */
+#define REG_CPLD_REV 0x01  /* cpld_rev, cpld_released */
+#define REG_CPLD_SUB 0x02  /* cpld_sub_rev */
+#define REG_SLOT 0x03      /* slotid: strapped, cached */
+#define REG_PRESENT 0x08   /* psu1_present and others */
+#define REG_UART_MUX 0x26  /* uart_mux, writable */
+
+static const struct {
+  uint8_t reg;
+  uint8_t val;
+} cpld_regs[] = {
+  {REG_BOARD, 0x12},
+  {REG_CPLD_REV, 0x45},
+  {REG_CPLD_SUB, 0x07},
+  {REG_SLOT, 0x04},
+  {REG_PRESENT, 0x05},
+  {REG_UART_MUX, 0x01},
+};
+
+static char dev_dir[64];
+static int stub_fd = -1;
+static int failures = 0;
+
+static void
+check(bool passed, const char *what) {
+  printf("%-48s %s\n", what, passed ? "PASSED" : "FAILED");
+  if (!passed)
+    failures++;
+}
+
+static int
+write_file(const char *path, const char *val) {
+  int fd, ret;
+
+  fd = open(path, O_WRONLY);
+  if (fd < 0)
+    return -1;
+  ret = write(fd, val, strlen(val));
+  close(fd);
+  return (ret == strlen(val)) ? 0 : -1;
+}
+
+/* First line of an attribute, as the default show prints it */
+static int
+attr_read(const char *name) {
+  char path[128], buf[64];
+  int fd, len;
+
+  snprintf(path, sizeof(path), "%s/%s", dev_dir, name);
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0)
+    return -1;
+  buf[len] = '\0';
+  return strtol(buf, NULL, 0);
+}
+
+static int
+attr_write(const char *name, int val) {
+  char path[128], buf[16];
+
+  snprintf(path, sizeof(path), "%s/%s", dev_dir, name);
+  snprintf(buf, sizeof(buf), "0x%x", val);
+  return write_file(path, buf);
+}
+
+static int
+volatile_ms(int ms) {
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%d", ms);
+  return write_file("/sys/module/i2c_dev_sysfs/parameters/volatile_ms", buf);
+}
+
+/* Change a register behind the driver */
+static void
+stub_set(uint8_t reg, uint8_t val) {
+  if (i2c_smbus_write_byte_data(stub_fd, reg, val) < 0)
+    perror("i2c_smbus_write_byte_data");
+}
+
+static int
+stub_get(uint8_t reg) {
+  return i2c_smbus_read_byte_data(stub_fd, reg);
+}
+
+static void
+test_attrs(void) {
+  check(attr_read("board_rev") == 0x2 && attr_read("model_id") == 0x1 &&
+        attr_read("cpld_rev") == 0x05 && attr_read("cpld_released") == 0x1 &&
+        attr_read("cpld_sub_rev") == 0x07 && attr_read("slotid") == 0x04 &&
+        attr_read("psu1_present") == 0x1, "attributes read");
+}
+
+static void
+test_snapshot(void) {
+  char path[128];
+  uint8_t buf[256];
+  bool passed;
+  int fd, len, i;
+
+  snprintf(path, sizeof(path), "%s/snapshot", dev_dir);
+  fd = open(path, O_RDONLY);
+  len = (fd < 0) ? -1 : read(fd, buf, sizeof(buf));
+  if (fd >= 0)
+    close(fd);
+
+  // Registers no attribute uses read as 0
+  passed = len > REG_UART_MUX && buf[0x04] == 0 && buf[0x10] == 0;
+  for (i = 0; passed && i < sizeof(cpld_regs) / sizeof(cpld_regs[0]); i++)
+    passed = buf[cpld_regs[i].reg] == cpld_regs[i].val;
+  check(passed, "snapshot");
+}
+
+static void
+test_cache(void) {
+  // The CPLD version is read again once volatile_ms is over, so a CPLD
+  // update shows up without reloading the driver
+  stub_set(REG_CPLD_REV, 0x46);
+  stub_set(REG_CPLD_SUB, 0x08);
+  usleep(50 * 1000);
+  check(attr_read("cpld_rev") == 0x06 && attr_read("cpld_sub_rev") == 0x08,
+        "CPLD version not kept after an update");
+
+  // Strapped registers are kept for as long as the driver is bound
+  stub_set(REG_BOARD, 0x13);
+  stub_set(REG_SLOT, 0x05);
+  usleep(50 * 1000);
+  check(attr_read("board_rev") == 0x2 && attr_read("slotid") == 0x04,
+        "strapped registers cached");
+  stub_set(REG_BOARD, 0x12);
+  stub_set(REG_SLOT, 0x04);
+
+  // Other registers are reused for volatile_ms
+  if (volatile_ms(1000)) {
+    check(false, "volatile_ms set");
+    return;
+  }
+  attr_read("psu1_present");
+  stub_set(REG_PRESENT, 0x04);
+  check(attr_read("psu1_present") == 0x1, "volatile register reused");
+  usleep(1100 * 1000);
+  check(attr_read("psu1_present") == 0x0, "volatile register expires");
+
+  // A write goes to the device and drops the volatile values read
+  stub_set(REG_PRESENT, 0x05);
+  check(attr_write("uart_mux", 0x2) == 0 && stub_get(REG_UART_MUX) == 0x02 &&
+        attr_read("uart_mux") == 0x2 && attr_read("psu1_present") == 0x1,
+        "write invalidates");
+  volatile_ms(20);
+}
+
+int
+main(int argc, char **argv) {
+  char path[64], buf[32];
+  int bus, i;
+
+  if (argc != 2) {
+    printf("Usage: %s <i2c-stub bus>\n", argv[0]);
+    return 1;
+  }
+  bus = atoi(argv[1]);
+
+  snprintf(path, sizeof(path), "/dev/i2c-%d", bus);
+  stub_fd = open(path, O_RDWR);
+  if (stub_fd < 0 || ioctl(stub_fd, I2C_SLAVE_FORCE, CPLD_ADDR) < 0) {
+    perror(path);
+    return 1;
+  }
+  for (i = 0; i < sizeof(cpld_regs) / sizeof(cpld_regs[0]); i++)
+    stub_set(cpld_regs[i].reg, cpld_regs[i].val);
+
+  snprintf(path, sizeof(path), "/sys/bus/i2c/devices/i2c-%d/new_device", bus);
+  snprintf(buf, sizeof(buf), CPLD_DRIVER " 0x%x", CPLD_ADDR);
+  snprintf(dev_dir, sizeof(dev_dir), "/sys/bus/i2c/devices/%d-%04x", bus, CPLD_ADDR);
+  check(write_file(path, buf) == 0 && access(dev_dir, F_OK) == 0, CPLD_DRIVER " created");
+  if (failures) {
+    close(stub_fd);
+    return 1;
+  }
+
+  printf("Testing " CPLD_DRIVER " on i2c-stub bus %d\n", bus);
+  test_attrs();
+  test_snapshot();
+  test_cache();
+
+  snprintf(path, sizeof(path), "/sys/bus/i2c/devices/i2c-%d/delete_device", bus);
+  snprintf(buf, sizeof(buf), "0x%x", CPLD_ADDR);
+  write_file(path, buf);
+  close(stub_fd);
+
+  printf("i2c_dev_sysfs: %s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
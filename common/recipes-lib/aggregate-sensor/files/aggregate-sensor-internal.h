@@ -54,6 +54,9 @@ typedef struct {
   size_t value_map_size;
   value_map_element_type value_map[MAX_CONDITIONALS];
   int default_expression_idx; /* -1 == invalid */
+  int cond_expression_idx; /* Resolved from cond_key, -1 == invalid */
+  bool cond_valid; /* cond_expression_idx is up to date */
+  int cond_wd; /* Watch on the cond_key file, -1 == none yet */
 } aggregate_sensor_t;
 
 extern size_t g_sensors_count;
@@ -211,6 +211,7 @@ static int load_linear_cond_eq(aggregate_sensor_t *snr, json_t *obj)
     }
   }
   snr->value_map_size = i;
+  snr->cond_wd = -1;
   snr->default_expression_idx = -1;
   if ((tmp = json_object_get(tmp, "default_expression")) != NULL &&
       json_is_string(tmp)) {
@@ -23,6 +23,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 #include <openbmc/obmc-sensor.h>
 #include <openbmc/edb.h>
 #include <jansson.h>
@@ -41,6 +43,11 @@
 size_t g_sensors_count = 0;
 aggregate_sensor_t *g_sensors = NULL;
 
+/* Watches on the condition key files so they are only looked up
+ * again after they changed. -1 if inotify is not available, then
+ * the keys are looked up on every read */
+static int g_cond_fd = -1;
+
 int get_sensor_value(void *state, float *value)
 {
   struct sensor_src *snr = (struct sensor_src *)state;
@@ -56,36 +63,115 @@ aggregate_sensor_count(size_t *count)
   return 0;
 }
 
-int
-aggregate_sensor_read(size_t index, float *value)
+/* The whole cache store is not watched: sensord writes there for
+ * every reading. Each condition key file is watched once it is used */
+static void
+cond_watch_init(void)
+{
+  if (g_cond_fd >= 0) {
+    return;
+  }
+
+  g_cond_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_cond_fd < 0) {
+    syslog(LOG_WARNING, "aggregate-sensor: inotify_init failed, polling conditions");
+  }
+}
+
+/* Watch the key file before reading the key, so no later write is missed */
+static void
+cond_watch_key(aggregate_sensor_t *snr)
+{
+  char kpath[MAX_KEY_PATH_LEN];
+
+  if (g_cond_fd < 0 || snr->cond_wd >= 0) {
+    return;
+  }
+  snprintf(kpath, sizeof(kpath), CACHE_STORE, snr->cond_key);
+  snr->cond_wd = inotify_add_watch(g_cond_fd, kpath,
+      IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+}
+
+/* Mark the sensors conditional on the key file watched by wd (all
+ * if -1) for a new look up. Once the file is gone so is the watch */
+static void
+cond_invalidate(int wd, bool removed)
 {
-  char cond_value[MAX_VALUE_LEN];
   size_t i;
-  aggregate_sensor_t *snr;
-  if (index >= g_sensors_count) {
-    return -1;
+
+  for (i = 0; i < g_sensors_count; i++) {
+    if (wd < 0 || g_sensors[i].cond_wd == wd) {
+      g_sensors[i].cond_valid = false;
+      if (removed) {
+        g_sensors[i].cond_wd = -1;
+      }
+    }
   }
-  snr = &g_sensors[index];
-  if (edb_cache_get(snr->cond_key, cond_value)) {
-    if (snr->default_expression_idx != -1) {
-      size_t f_idx = snr->default_expression_idx;
-      return expression_evaluate(snr->expressions[f_idx], value);
+}
+
+/* Drain the pending change events of the condition keys */
+static void
+cond_watch_poll(void)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  ssize_t len;
+  char *ptr;
+
+  while ((len = read(g_cond_fd, buf, sizeof(buf))) > 0) {
+    for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+      ev = (struct inotify_event *)ptr;
+      if (ev->mask & IN_Q_OVERFLOW) {
+        cond_invalidate(-1, false);
+      } else {
+        cond_invalidate(ev->wd, ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF));
+      }
     }
+  }
+}
+
+/* Look up the condition key and resolve the expression to be used */
+static void
+cond_resolve(aggregate_sensor_t *snr)
+{
+  char cond_value[MAX_VALUE_LEN];
+  size_t i;
+
+  /* Without a watch (no key file yet) look again on the next read */
+  cond_watch_key(snr);
+  snr->cond_valid = snr->cond_wd >= 0;
+  snr->cond_expression_idx = snr->default_expression_idx;
+  if (edb_cache_get(snr->cond_key, cond_value)) {
     DEBUG("key: %s not available\n", snr->cond_key);
-    return -1;
+    return;
   }
   for (i = 0; i < snr->value_map_size; i++) {
     if (!strncmp(snr->value_map[i].condition_value, cond_value,
           sizeof(snr->value_map[i].condition_value))) {
-      size_t f_idx = snr->value_map[i].formula_index;
-      return expression_evaluate(snr->expressions[f_idx], value);
+      snr->cond_expression_idx = (int)snr->value_map[i].formula_index;
+      return;
     }
   }
-  if (snr->default_expression_idx != -1) {
-    size_t f_idx = (size_t)snr->default_expression_idx;
-    return expression_evaluate(snr->expressions[f_idx], value);
+}
+
+int
+aggregate_sensor_read(size_t index, float *value)
+{
+  aggregate_sensor_t *snr;
+  if (index >= g_sensors_count) {
+    return -1;
+  }
+  snr = &g_sensors[index];
+  if (g_cond_fd >= 0) {
+    cond_watch_poll();
+  }
+  if (!snr->cond_valid) {
+    cond_resolve(snr);
+  }
+  if (snr->cond_expression_idx == -1) {
+    return -1;
   }
-  return -1;
+  return expression_evaluate(snr->expressions[snr->cond_expression_idx], value);
 }
 
 int
@@ -122,10 +208,16 @@ aggregate_sensor_units(size_t index, char *units)
 int
 aggregate_sensor_init(const char *conf_file_path)
 {
+  int ret;
+
   if (!conf_file_path) {
     conf_file_path = DEFAULT_CONF_FILE_PATH;
   }
-  return load_aggregate_conf(conf_file_path);
+  ret = load_aggregate_conf(conf_file_path);
+  if (ret == 0) {
+    cond_watch_init();
+  }
+  return ret;
 }
 
 void
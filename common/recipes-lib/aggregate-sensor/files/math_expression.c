@@ -19,38 +19,75 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <string.h>
 #include <assert.h>
 #include "math_expression.h"
 
-typedef enum {
-  TERM_VARIABLE,
-  TERM_CONSTANT
-} term_type;
-
-typedef struct {
-  term_type type;
-  union {
-    variable_type var;
-    float         constant;
-  } term;
-} expression_term_type;
+#define MAX_PRINT_LEN 256
 
 typedef enum {
-  OP_INVALID = 0, /* No R value */
+  OP_INVALID = 0,
+  OP_CONSTANT, /* Push constant */
+  OP_VARIABLE, /* Push vars[idx] */
   OP_ADD, /* L + R */
   OP_SUBTRACT, /* L - R */
-  OP_MULTIPLY /* L * R */
+  OP_MULTIPLY, /* L * R */
+  OP_MIN, /* min of the top argc values */
+  OP_MAX, /* max of the top argc values */
+  OP_AVG, /* mean of the top argc values */
+  OP_CLAMP, /* X limited to [LO, HI] */
+  OP_MAVG /* Moving average of X in mavg[idx] */
 } operator_type;
 
+typedef struct {
+  uint8_t  op;
+  uint8_t  argc;
+  uint16_t idx;
+  float    constant;
+} instruction_type;
+
+/* History of one mavg() */
+typedef struct {
+  float  samples[EXPRESSION_MAX_MAVG];
+  size_t len;
+  size_t count;
+  size_t pos;
+} moving_avg_type;
+
 struct expression_type_s {
-  operator_type type;
-  expression_term_type *left_exp_term;
-  expression_type      *left_exp_group;
-  expression_term_type *right_exp_term;
-  expression_type      *right_exp_group;
-  expression_type      *parent;
+  instruction_type *code;
+  size_t           code_len;
+  size_t           code_size;
+  /* Variables referenced, each only once */
+  variable_type    vars[EXPRESSION_MAX_VARS];
+  size_t           num_vars;
+  moving_avg_type  *mavg;
+  size_t           num_mavg;
+};
+
+/* Parser state, one token of look ahead */
+typedef struct {
+  expression_type *exp;
+  char            *token;
+  char            *saveptr;
+  size_t          depth;
+  variable_type   *vars;
+  size_t          num;
+} parser_type;
+
+static const struct {
+  const char    *name;
+  operator_type op;
+  size_t        min_args;
+  size_t        max_args;
+} functions[] = {
+  {"min",   OP_MIN,   1, 255},
+  {"max",   OP_MAX,   1, 255},
+  {"avg",   OP_AVG,   1, 255},
+  {"clamp", OP_CLAMP, 3, 3},
+  {"mavg",  OP_MAVG,  2, 2},
 };
 
 static operator_type get_operator(char *str)
@@ -78,6 +115,18 @@ static operator_type get_operator(char *str)
   return op;
 }
 
+static int get_function(char *str)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+    if (!strcmp(str, functions[i].name)) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
 static bool is_constant(char *str)
 {
   bool period_done = false;
@@ -92,176 +141,326 @@ static bool is_constant(char *str)
   return true;
 }
 
-static expression_type *alloc_expression(expression_type *parent)
+static void next_token(parser_type *p)
 {
-  expression_type *o = calloc(1, sizeof(expression_type));
-  if (!o) {
-    return NULL;
+  p->token = strtok_r(NULL, " \n", &p->saveptr);
+}
+
+static bool token_is(parser_type *p, const char *str)
+{
+  return p->token != NULL && !strcmp(p->token, str);
+}
+
+/* Append an instruction to the program while keeping track of
+ * the stack depth it needs */
+static int emit(parser_type *p, operator_type op, size_t argc, size_t idx, float constant)
+{
+  expression_type *exp = p->exp;
+  instruction_type *ins;
+
+  if (exp->code_len == exp->code_size) {
+    size_t size = exp->code_size ? exp->code_size * 2 : 16;
+    ins = realloc(exp->code, size * sizeof(instruction_type));
+    if (!ins) {
+      return -1;
+    }
+    exp->code = ins;
+    exp->code_size = size;
   }
-  o->parent = parent;
-  return o;
+
+  switch(op) {
+    case OP_CONSTANT:
+    case OP_VARIABLE:
+      if (++p->depth > EXPRESSION_MAX_STACK) {
+        return -1;
+      }
+      break;
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+      p->depth -= 1;
+      break;
+    case OP_MIN:
+    case OP_MAX:
+    case OP_AVG:
+    case OP_CLAMP:
+      p->depth -= argc - 1;
+      break;
+    default:
+      break;
+  }
+
+  ins = &exp->code[exp->code_len++];
+  ins->op = op;
+  ins->argc = argc;
+  ins->idx = idx;
+  ins->constant = constant;
+  return 0;
 }
 
-static expression_term_type *alloc_expression_term(char *name, variable_type *va, int num)
+/* Resolve the variable to its slot, adding it on first use */
+static int get_variable(parser_type *p, char *name, size_t *idx)
 {
-  int i;
-  expression_term_type *term = calloc(1, sizeof(expression_term_type));
-  if (!term) {
-    return NULL;
+  expression_type *exp = p->exp;
+  size_t i;
+
+  for (i = 0; i < exp->num_vars; i++) {
+    if (!strncmp(name, exp->vars[i].name, sizeof(exp->vars[i].name))) {
+      *idx = i;
+      return 0;
+    }
   }
-  term->type = is_constant(name) ? TERM_CONSTANT : TERM_VARIABLE;
-  if (term->type == TERM_CONSTANT) {
-    term->term.constant = atof(name);
-  } else {
-    /* Look for the variable name in the list and copy it over */
-    for (i = 0; i < num; i++) {
-      if (!strncmp(name, va[i].name, sizeof(va[i].name))) {
-        term->term.var = va[i];
-        break;
+  if (exp->num_vars == EXPRESSION_MAX_VARS) {
+    return -1;
+  }
+  for (i = 0; i < p->num; i++) {
+    if (!strncmp(name, p->vars[i].name, sizeof(p->vars[i].name))) {
+      *idx = exp->num_vars;
+      exp->vars[exp->num_vars++] = p->vars[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int parse_expression(parser_type *p);
+
+/* mavg ( X , N ): N is the window and has to be a constant */
+static int parse_mavg_window(parser_type *p)
+{
+  moving_avg_type *m;
+  int len;
+
+  if (!p->token || !is_constant(p->token)) {
+    return -1;
+  }
+  len = atoi(p->token);
+  if (len < 1 || len > EXPRESSION_MAX_MAVG) {
+    return -1;
+  }
+  m = realloc(p->exp->mavg, (p->exp->num_mavg + 1) * sizeof(moving_avg_type));
+  if (!m) {
+    return -1;
+  }
+  p->exp->mavg = m;
+  m = &m[p->exp->num_mavg];
+  memset(m, 0, sizeof(*m));
+  m->len = len;
+  next_token(p);
+  return 0;
+}
+
+static int parse_function(parser_type *p, int fn)
+{
+  size_t argc = 0;
+
+  next_token(p);
+  if (!token_is(p, "(")) {
+    return -1;
+  }
+  next_token(p);
+  for (;;) {
+    if (functions[fn].op == OP_MAVG && argc == 1) {
+      if (parse_mavg_window(p)) {
+        return -1;
       }
+    } else if (parse_expression(p)) {
+      return -1;
+    }
+    argc++;
+    if (!token_is(p, ",")) {
+      break;
     }
-    assert(i < num);
+    next_token(p);
+  }
+  if (!token_is(p, ")") ||
+      argc < functions[fn].min_args || argc > functions[fn].max_args) {
+    return -1;
   }
-  return term;
+  next_token(p);
+
+  if (functions[fn].op == OP_MAVG) {
+    return emit(p, OP_MAVG, 1, p->exp->num_mavg++, 0);
+  }
+  return emit(p, functions[fn].op, argc, 0, 0);
 }
 
-static int expression_term_evaluate(expression_term_type *term, float *value)
+/* term := constant | variable | ( expression ) | function ( expression , ... ) */
+static int parse_term(parser_type *p)
 {
-  if (term->type == TERM_CONSTANT) {
-    *value = term->term.constant;
+  size_t idx;
+  int fn;
+
+  if (!p->token) {
+    return -1;
+  }
+  if (token_is(p, "(")) {
+    next_token(p);
+    if (parse_expression(p) || !token_is(p, ")")) {
+      return -1;
+    }
+    next_token(p);
     return 0;
   }
-  return term->term.var.value(term->term.var.state, value);
+  if ((fn = get_function(p->token)) >= 0) {
+    return parse_function(p, fn);
+  }
+  if (is_constant(p->token)) {
+    float constant = atof(p->token);
+    next_token(p);
+    return emit(p, OP_CONSTANT, 0, 0, constant);
+  }
+  if (get_variable(p, p->token, &idx)) {
+    return -1;
+  }
+  next_token(p);
+  return emit(p, OP_VARIABLE, 0, idx, 0);
+}
+
+/* expression := term { operator term }, strictly left to right */
+static int parse_expression(parser_type *p)
+{
+  operator_type op;
+
+  if (parse_term(p)) {
+    return -1;
+  }
+  while (p->token && (op = get_operator(p->token)) != OP_INVALID) {
+    next_token(p);
+    if (parse_term(p) || emit(p, op, 2, 0, 0)) {
+      return -1;
+    }
+  }
+  return 0;
 }
 
 expression_type *expression_parse(const char *user_str, variable_type *vars, size_t num)
 {
-  char *token, *saveptr;
-  expression_type *tmp, *current = NULL, *ret = NULL;
+  parser_type p;
   char *str;
 
+  memset(&p, 0, sizeof(p));
+  p.vars = vars;
+  p.num = num;
+
   str = calloc(strlen(user_str) + 1, 1);
   if (!str) {
     return NULL;
   }
   strcpy(str, user_str);
-
-  ret = current = alloc_expression(NULL);
-  if (!current) {
+  p.exp = calloc(1, sizeof(expression_type));
+  if (!p.exp) {
     free(str);
     return NULL;
   }
 
-  for(token = strtok_r(str, " \n", &saveptr);
-      token != NULL;
-      token = strtok_r(NULL, " \n", &saveptr)) {
+  p.token = strtok_r(str, " \n", &p.saveptr);
+  /* The whole string has to be consumed, a trailing token
+   * means unbalanced parenthesis or a missing operator */
+  if (parse_expression(&p) || p.token != NULL) {
+    free(str);
+    expression_destroy(p.exp);
+    return NULL;
+  }
+  assert(p.depth == 1);
+  free(str);
+  return p.exp;
+}
 
-    assert(current);
+static float moving_avg_update(moving_avg_type *m, float value)
+{
+  float sum = 0;
+  size_t i;
 
-    if (!strncmp(token, "(", 2)) {
-      /* Start a new group and set it as current */
-      current = alloc_expression(current);
-      if (!current) {
-        goto free_bail;
-      }
-    } else if (!strncmp(token, ")", 2)) {
-      expression_type *parent = current->parent;
-      /* Close the current group, set it as the parent's
-       * left (if empty) or right term and finally set
-       * the parent as the current group. */
-      if (parent->left_exp_term == NULL && parent->left_exp_group == NULL) {
-        parent->left_exp_group = current;
-      } else if (parent->right_exp_term == NULL && parent->right_exp_group == NULL) {
-        parent->right_exp_group = current;
-      } 
-      current = parent;
-    } else if(get_operator(token) != OP_INVALID) {
-      if (current->type == OP_INVALID) {
-        /* Simple case, we have parsed the left term
-         * and just parsing the operator. Just set it */
-        current->type = get_operator(token);
-      } else {
-        /* If the current expression is already a valid
-         * operation, then this is the second + in a + b + c.
-         * Thus, artificially close the current group, create
-         * a parent group with the left expression as the current
-         * group and then set the new one as the current with
-         * its operator set to the freshly parsed operator */
-        tmp = alloc_expression(current->parent);
-        if (!tmp) {
-          goto free_bail;
-        }
-        tmp->left_exp_group = current;
-        current->parent = tmp;
-        tmp->type = get_operator(token);
-        current = tmp;
-      }
-    } else {
-      expression_term_type *term = alloc_expression_term(token, vars, num);
-      if (!term) {
-        goto free_bail;
-      }
-      /* This is either a variable or a constant. Allocate
-       * a expression term and set it as the left (if available) or
-       * right of the current expression group */
-      if (current->left_exp_term == NULL && current->left_exp_group == NULL) {
-        current->left_exp_term = term;
-      } else if (current->right_exp_term == NULL && current->right_exp_term == NULL) {
-        current->right_exp_term = term;
-      } else {
-        assert(0);
-      }
-    }
+  m->samples[m->pos] = value;
+  m->pos = (m->pos + 1) % m->len;
+  if (m->count < m->len) {
+    m->count++;
   }
-  /* We are done parsing, ensure that we are the top group
-   * and the user is not missing any unclosed parenthesis */
-  assert(current->parent == NULL);
-  free(str);
-  return current;
-free_bail:
-  /* Free the partially created tree if it exists */
-  expression_destroy(ret);
-  return NULL;
+  for (i = 0; i < m->count; i++) {
+    sum += m->samples[i];
+  }
+  return sum / m->count;
 }
 
 int expression_evaluate(expression_type *exp, float *value)
 {
-  float l_val, r_val;
+  float stack[EXPRESSION_MAX_STACK];
+  /* Values of the variables read so far in this evaluation */
+  float vals[EXPRESSION_MAX_VARS];
+  uint32_t loaded = 0;
+  size_t sp = 0, i, j;
   int ret;
-  assert(exp->left_exp_term || exp->left_exp_group);
-  ret = exp->left_exp_term ? expression_term_evaluate(exp->left_exp_term, &l_val) :
-    expression_evaluate(exp->left_exp_group, &l_val);
-  if (ret) {
-    return ret;
-  }
-
-  if (!exp->right_exp_term && !exp->right_exp_group) {
-    /* Example use case would be the expression ( a + b ). This would be parsed
-     * as ( ( a + b ) ) thus, the outer redundant group would have ( a + b )
-     * as the left expression group with nothing on the right. Hense just
-     * return success with the evaluation of the left expression. */
-    *value = l_val;
-    return 0;
-  }
-  ret = exp->right_exp_term ? expression_term_evaluate(exp->right_exp_term, &r_val) :
-    expression_evaluate(exp->right_exp_group, &r_val);
-  if (ret) {
-    return ret;
-  }
 
-  switch(exp->type) {
-    case OP_ADD:
-      *value = l_val + r_val;
-      break;
-    case OP_SUBTRACT:
-      *value = l_val - r_val;
-      break;
-    case OP_MULTIPLY:
-      *value = l_val * r_val;
-      break;
-    default:
-      assert(0);
+  for (i = 0; i < exp->code_len; i++) {
+    instruction_type *ins = &exp->code[i];
+    float *top;
+
+    switch(ins->op) {
+      case OP_CONSTANT:
+        stack[sp++] = ins->constant;
+        continue;
+      case OP_VARIABLE:
+        if (!(loaded & (1U << ins->idx))) {
+          variable_type *var = &exp->vars[ins->idx];
+          ret = var->value(var->state, &vals[ins->idx]);
+          if (ret) {
+            return ret;
+          }
+          loaded |= 1U << ins->idx;
+        }
+        stack[sp++] = vals[ins->idx];
+        continue;
+      case OP_MAVG:
+        stack[sp-1] = moving_avg_update(&exp->mavg[ins->idx], stack[sp-1]);
+        continue;
+      default:
+        break;
+    }
+
+    /* Operators with argc operands, the result replaces the first */
+    sp -= ins->argc - 1;
+    top = &stack[sp-1];
+    switch(ins->op) {
+      case OP_ADD:
+        top[0] += top[1];
+        break;
+      case OP_SUBTRACT:
+        top[0] -= top[1];
+        break;
+      case OP_MULTIPLY:
+        top[0] *= top[1];
+        break;
+      case OP_MIN:
+        for (j = 1; j < ins->argc; j++) {
+          if (top[j] < top[0])
+            top[0] = top[j];
+        }
+        break;
+      case OP_MAX:
+        for (j = 1; j < ins->argc; j++) {
+          if (top[j] > top[0])
+            top[0] = top[j];
+        }
+        break;
+      case OP_AVG:
+        for (j = 1; j < ins->argc; j++) {
+          top[0] += top[j];
+        }
+        top[0] /= ins->argc;
+        break;
+      case OP_CLAMP:
+        if (top[0] < top[1])
+          top[0] = top[1];
+        else if (top[0] > top[2])
+          top[0] = top[2];
+        break;
+      default:
+        assert(0);
+    }
   }
+  assert(sp == 1);
+  *value = stack[0];
   return 0;
 }
 
@@ -270,56 +469,68 @@ void expression_destroy(expression_type *exp)
   if (!exp) {
     return;
   }
-  if (exp->left_exp_term)
-    free(exp->left_exp_term);
-  else if (exp->left_exp_group)
-    expression_destroy(exp->left_exp_group);
-  if (exp->right_exp_term)
-    free(exp->right_exp_term);
-  else if (exp->right_exp_group)
-    expression_destroy(exp->right_exp_group);
+  free(exp->code);
+  free(exp->mavg);
   free(exp);
 }
 
+/* Rebuild the expression from the program, every operation
+ * in parenthesis so the order of evaluation is visible */
 void expression_print(expression_type *exp)
 {
-  printf("( ");
-  if (exp->left_exp_term) {
-    if (exp->left_exp_term->type == TERM_CONSTANT) {
-      printf("%2.5f ", exp->left_exp_term->term.constant);
-    } else {
-      printf("%s ", exp->left_exp_term->term.var.name);
-    }
-  } else {
-      expression_print(exp->left_exp_group);
-  }
+  static const char *binary[] = {
+    [OP_ADD] = "+", [OP_SUBTRACT] = "-", [OP_MULTIPLY] = "*",
+  };
+  char stack[EXPRESSION_MAX_STACK][MAX_PRINT_LEN];
+  char tmp[2 * MAX_PRINT_LEN + 16];
+  size_t sp = 0, i, j;
+  int len;
 
-  switch(exp->type) {
-    case OP_ADD:
-      printf("+ ");
-      break;
-    case OP_SUBTRACT:
-      printf("- ");
-      break;
-    case OP_MULTIPLY:
-      printf("* ");
-      break;
-    default:
-      /* This case is possible only if there is no right term */
-      assert(exp->right_exp_term == NULL && exp->right_exp_group == NULL);
-      break;
-  }
+  for (i = 0; i < exp->code_len; i++) {
+    instruction_type *ins = &exp->code[i];
+    char *top;
 
-  if (exp->right_exp_term) {
-    if (exp->right_exp_term->type == TERM_CONSTANT) {
-      printf("%2.5f ", exp->right_exp_term->term.constant);
+    switch(ins->op) {
+      case OP_CONSTANT:
+        snprintf(stack[sp++], MAX_PRINT_LEN, "%2.5f", ins->constant);
+        continue;
+      case OP_VARIABLE:
+        snprintf(stack[sp++], MAX_PRINT_LEN, "%s", exp->vars[ins->idx].name);
+        continue;
+      case OP_MAVG:
+        snprintf(tmp, sizeof(tmp), "mavg( %s , %zu )", stack[sp-1],
+            exp->mavg[ins->idx].len);
+        tmp[MAX_PRINT_LEN - 1] = '\0';
+        strcpy(stack[sp-1], tmp);
+        continue;
+      default:
+        break;
+    }
+
+    sp -= ins->argc - 1;
+    top = stack[sp-1];
+    if (ins->op <= OP_MULTIPLY) {
+      snprintf(tmp, sizeof(tmp), "( %s %s %s )", top, binary[ins->op], stack[sp]);
     } else {
-      printf("%s ", exp->right_exp_term->term.var.name);
+      for (j = 0; j < sizeof(functions) / sizeof(functions[0]); j++) {
+        if (functions[j].op == ins->op)
+          break;
+      }
+      len = snprintf(tmp, sizeof(tmp), "%s( %s", functions[j].name, top);
+      for (j = 1; j < ins->argc && len < MAX_PRINT_LEN; j++) {
+        len += snprintf(tmp + len, sizeof(tmp) - len, " , %s", stack[sp-1+j]);
+      }
+      if (len < MAX_PRINT_LEN) {
+        snprintf(tmp + len, sizeof(tmp) - len, " )");
+      }
     }
-  } else if (exp->right_exp_group) {
-    expression_print(exp->right_exp_group);
+    /* Overlong expressions are cut short */
+    tmp[MAX_PRINT_LEN - 1] = '\0';
+    strcpy(top, tmp);
+  }
+  if (sp == 1) {
+    printf("%s ", stack[0]);
   }
-  printf(") ");
 }
 
 #ifdef __EXPRESSION_TEST__
@@ -356,6 +567,10 @@ int main(int argc, char *argv[])
     *((float *)vi->state) = atof(tmp);
   }
   op = expression_parse(argv[1], input, num);
+  if (!op) {
+    printf("Parsing expression failed!\n");
+    return -1;
+  }
   printf("Input:\n");
   for(i = 0; i < num; i++) {
     int rc;
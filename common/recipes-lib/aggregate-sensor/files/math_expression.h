@@ -29,8 +29,25 @@
  *
  * 2. Expressions are parsed using spaces. So, 'a*b+c' is invalid while
  *    'a * b + c' is valid.
+ *
+ * 3. Functions take a comma separated list of expressions in parenthesis,
+ *    again separated by spaces: "max ( a , b , c )".
+ *      min ( x , ... ), max ( x , ... ), avg ( x , ... )
+ *                          - Minimum, maximum and mean of the arguments.
+ *      clamp ( x , lo , hi ) - x limited to the range [lo, hi].
+ *      mavg ( x , N )      - Moving average of x over the last N
+ *                            evaluations. N is a constant (1 - 64).
+ *
+ * The expression is compiled into a flat program for a stack machine at
+ * parse time. Every variable is read at most once per evaluation, no
+ * matter how often it is referenced.
  */
 
+/* Limits of a single expression */
+#define EXPRESSION_MAX_VARS   32
+#define EXPRESSION_MAX_STACK  32
+#define EXPRESSION_MAX_MAVG   64
+
 /* The function which is fed into expression_parse which stores this 
  * with the variable, thus keeping all the string parsing and comparision
  * at parse time rather than at evaluation time */
@@ -54,13 +71,15 @@ typedef struct expression_type_s expression_type;
 
 /* Parse the expression provided in 'str' and return the evaluatable 
  * expression object. The list of variables (see above) is also taken.
+ * Returns NULL on a syntax error or a reference to an unknown variable.
  * A copy of the variable (name, value() and state) is made so the
  * caller may free it after this function returns, but must maintain
  * the scope of 'value' & 'state' if they are dynamic objects */
 expression_type *expression_parse(const char *str, variable_type *vars, size_t num);
 
-/* Evaluate the expression. Note, multiple calls to the functions
- * provided in 'vars' in expression_parse might be made */
+/* Evaluate the expression. The function of each variable referenced is
+ * called once. Expressions using mavg() keep history in the object, so
+ * the same object must not be evaluated concurrently */
 int expression_evaluate(expression_type *op, float *value);
 
 /* Destroy the object created in expression_parse */
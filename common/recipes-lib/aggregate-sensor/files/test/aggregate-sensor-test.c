@@ -21,6 +21,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <jansson.h>
 #include "aggregate-sensor.h"
 #include <openbmc/edb.h>
@@ -37,12 +40,15 @@ typedef struct {
   int   curr_ret;
 } sensor_test_t;
 
+int math_expression_test(void);
+
 sensor_test_t test_sensors[MAX_TEST_SENSORS];
 size_t        num_test_sensors = 0;
 char          test_values[MAX_TEST_VALUE_MAP_SIZE][MAX_VALUE_LEN];
 size_t        num_test_values = 0;
 
 char          *curr_val = NULL;
+char          test_key[MAX_KEY_LEN];
 
 int edb_cache_get(char *key, char *value)
 {
@@ -121,6 +127,7 @@ static void load_test_params(const char *file, size_t num)
   }
   tmp2 = json_object_get(tmp, "condition");
   assert(tmp2);
+  strncpy(test_key, json_string_value(json_object_get(tmp2, "key")), MAX_KEY_LEN - 1);
   tmp2 = json_object_get(tmp2, "value_map");
   assert(tmp2);
   for (i = 0, iter = json_object_iter(tmp2);
@@ -136,6 +143,22 @@ static void load_test_params(const char *file, size_t num)
   }
 }
 
+/* The library only looks the condition up again once the key
+ * changed, so let it see a write to the key */
+void set_curr_val(char *val)
+{
+  char path[MAX_KEY_PATH_LEN];
+  int fd;
+
+  curr_val = val;
+  mkdir(CACHE_STORE_PATH, 0777);
+  snprintf(path, sizeof(path), CACHE_STORE, test_key);
+  fd = open(path, O_WRONLY | O_CREAT, 0644);
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
 void set_all_sensors_valid(void)
 {
   int i;
@@ -193,12 +216,12 @@ int test_sensor(const char *file, size_t num, const char *name)
   printf("\n");
 
   for (i = 0; i < num_test_values; i++) {
-    curr_val = test_values[i];
+    set_curr_val(test_values[i]);
     test_sensor_values(num, true);
   }
-  curr_val = "INVALID_VALUE";
+  set_curr_val("INVALID_VALUE");
   test_sensor_values(num, true); // TODO check if default is set
-  curr_val = NULL;
+  set_curr_val(NULL);
   test_sensor_values(num, true); // TODO check if default is set
 
   return 0;
@@ -242,6 +265,9 @@ int aggregate_sensor_test(const char *file)
 
 int main(int argc, char *argv[])
 {
+  if (math_expression_test()) {
+    return -1;
+  }
   if (argc < 2) {
     printf("Usage: %s <JSON Config>\n", argv[0]);
     return -1;
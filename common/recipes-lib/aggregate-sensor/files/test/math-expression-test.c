@@ -0,0 +1,213 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include "math_expression.h"
+
+/* Variables a, b and c of the expressions under test */
+typedef struct {
+  float value;
+  int   ret;
+  int   reads;
+} test_var_t;
+
+static test_var_t test_vars[3];
+static int failures = 0;
+
+static int get_test_var(void *state, float *value)
+{
+  test_var_t *v = (test_var_t *)state;
+
+  v->reads++;
+  *value = v->value;
+  return v->ret;
+}
+
+static variable_type vars[] = {
+  {"a", get_test_var, &test_vars[0]},
+  {"b", get_test_var, &test_vars[1]},
+  {"c", get_test_var, &test_vars[2]},
+};
+
+static void set_vars(float a, float b, float c)
+{
+  memset(test_vars, 0, sizeof(test_vars));
+  test_vars[0].value = a;
+  test_vars[1].value = b;
+  test_vars[2].value = c;
+}
+
+static void check(bool passed, const char *what, const char *str)
+{
+  printf("%-10s \"%s\": %s\n", what, str, passed ? "PASSED" : "FAILED");
+  if (!passed) {
+    failures++;
+  }
+}
+
+/* Evaluate str once with the current variables */
+static void test_value(const char *str, float expected)
+{
+  expression_type *exp = expression_parse(str, vars, 3);
+  float value = NAN;
+
+  check(exp && expression_evaluate(exp, &value) == 0 &&
+      fabsf(value - expected) < 0.0001, "value", str);
+  expression_destroy(exp);
+}
+
+static void test_parse_error(const char *str)
+{
+  expression_type *exp = expression_parse(str, vars, 3);
+
+  check(exp == NULL, "rejected", str);
+  expression_destroy(exp);
+}
+
+static void test_functions(void)
+{
+  set_vars(4, -2, 9);
+  test_value("min ( a , b , c )", -2);
+  test_value("max ( a , b , c )", 9);
+  test_value("avg ( a , b , c )", 11.0 / 3);
+  test_value("min ( a )", 4);
+  test_value("max ( a , 10 )", 10);
+  test_value("clamp ( a , 0 , 5 )", 4);
+  test_value("clamp ( b , 0 , 5 )", 0);
+  test_value("clamp ( c , 0 , 5 )", 5);
+  test_value("( max ( a , b ) * 2 ) + min ( b , c )", 6);
+  test_value("clamp ( avg ( a , c ) - 1 , 0 , 100 ) * 0.5", 2.75);
+  /* No precedence, strictly left to right */
+  test_value("4 * a + 5", 21);
+  test_value("( 4 * a ) + ( 5 * b ) - 6", 0);
+}
+
+static void test_moving_average(void)
+{
+  const char *str = "mavg ( a , 3 )";
+  float in[] = {3, 6, 9, 12, 0};
+  float out[] = {3, 4.5, 6, 9, 7};
+  expression_type *exp = expression_parse(str, vars, 3);
+  bool passed = exp != NULL;
+  float value;
+  size_t i;
+
+  for (i = 0; passed && i < sizeof(in) / sizeof(in[0]); i++) {
+    set_vars(in[i], 0, 0);
+    passed = expression_evaluate(exp, &value) == 0 && fabsf(value - out[i]) < 0.0001;
+  }
+  /* A failed read is not part of the history */
+  if (passed) {
+    set_vars(100, 0, 0);
+    test_vars[0].ret = -1;
+    passed = expression_evaluate(exp, &value) != 0;
+    set_vars(3, 0, 0);
+    passed = passed && expression_evaluate(exp, &value) == 0 && fabsf(value - 5) < 0.0001;
+  }
+  check(passed, "window", str);
+  expression_destroy(exp);
+
+  str = "mavg ( clamp ( avg ( a , b ) , 0 , 20 ) , 2 ) * 2";
+  exp = expression_parse(str, vars, 3);
+  passed = exp != NULL;
+  set_vars(10, 50, 0);
+  passed = passed && expression_evaluate(exp, &value) == 0 && fabsf(value - 40) < 0.0001;
+  set_vars(2, 4, 0);
+  passed = passed && expression_evaluate(exp, &value) == 0 && fabsf(value - 23) < 0.0001;
+  check(passed, "nested", str);
+  expression_destroy(exp);
+
+  /* Every mavg() keeps its own history */
+  str = "mavg ( a , 2 ) + mavg ( a , 4 )";
+  exp = expression_parse(str, vars, 3);
+  passed = exp != NULL;
+  for (i = 0; passed && i < 4; i++) {
+    set_vars(i * 4, 0, 0);
+    passed = expression_evaluate(exp, &value) == 0;
+  }
+  /* (8 + 12) / 2 + (0 + 4 + 8 + 12) / 4 */
+  check(passed && fabsf(value - 16) < 0.0001, "separate", str);
+  expression_destroy(exp);
+}
+
+static void test_variables(void)
+{
+  const char *str = "( a * a ) + max ( a , b , a ) - clamp ( a , b , c )";
+  expression_type *exp = expression_parse(str, vars, 3);
+  float value;
+
+  set_vars(3, 1, 2);
+  check(exp && expression_evaluate(exp, &value) == 0 && fabsf(value - 10) < 0.0001 &&
+      test_vars[0].reads == 1 && test_vars[1].reads == 1 && test_vars[2].reads == 1,
+      "read once", str);
+
+  set_vars(3, 1, 2);
+  test_vars[2].ret = -2;
+  check(exp && expression_evaluate(exp, &value) == -2, "read fail", str);
+  expression_destroy(exp);
+}
+
+static void test_parse_errors(void)
+{
+  char str[256];
+  int i;
+
+  test_parse_error("");
+  test_parse_error("a+b");
+  test_parse_error("a +");
+  test_parse_error("a b");
+  test_parse_error("d + 1");
+  test_parse_error("( a + b");
+  test_parse_error("a + b )");
+  test_parse_error("max ( a , b");
+  test_parse_error("max a , b )");
+  test_parse_error("min ( )");
+  test_parse_error("max ( a , , b )");
+  test_parse_error("clamp ( a , 1 )");
+  test_parse_error("clamp ( a , 1 , 2 , 3 )");
+  test_parse_error("mavg ( a )");
+  test_parse_error("mavg ( a , b )");
+  test_parse_error("mavg ( a , 0 )");
+  test_parse_error("mavg ( a , 65 )");
+  test_parse_error("mavg ( a , 2 , 3 )");
+  test_parse_error("avg ( a , b ) c");
+
+  /* Deeper than the evaluation stack */
+  strcpy(str, "max ( 1");
+  for (i = 0; i < EXPRESSION_MAX_STACK; i++) {
+    strcat(str, " , 1");
+  }
+  strcat(str, " )");
+  test_parse_error(str);
+}
+
+int math_expression_test(void)
+{
+  printf("Testing expressions\n");
+  test_functions();
+  test_moving_average();
+  test_variables();
+  test_parse_errors();
+  printf("Expressions: %s\n", failures ? "FAILED" : "PASSED");
+  return failures;
+}
@@ -0,0 +1,458 @@
+/*
+ * hsvc.c - Hot service event handling of the sled slots
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Every slot has a settle timer (timerfd) that each present pin edge
+ * re-arms, so the slot is only looked at once its pins have been quiet for
+ * the settle time. One thread waits on all timers. When a slot settles to
+ * a new present state, the removal/insertion work is queued for a small
+ * pool of workers. The work of one slot runs in order, newer work replaces
+ * work of the same slot that has not started yet.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "hsvc.h"
+
+#define HSVC_MAX_WORKERS  8
+#define HSVC_LOG_LEN      256
+#define HSVC_EV_LOG       0
+#define HSVC_EV_STOP      0xff
+
+typedef struct {
+  int tfd;                // settle timer
+  bool settling;
+  uint32_t edge_seq;
+  int state;              // settled present state, -1 if unknown
+  bool queued;
+  bool running;
+  hsvc_action_t job;
+  uint32_t job_seq;
+} hsvc_slot_t;
+
+struct hsvc_log {
+  struct timespec due;
+  struct hsvc_log *next;
+  char msg[HSVC_LOG_LEN];
+};
+
+static hsvc_slot_t slots[HSVC_MAX_SLOTS + 1];
+static const hsvc_ops_t *hops;
+static unsigned int settle_ms[2] = {
+  HSVC_REMOVAL_SETTLE_MS,
+  HSVC_INSERTION_SETTLE_MS,
+};
+static pthread_mutex_t hsvc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static hsvc_stats_t stats;
+static uint32_t job_seq;
+static bool stopping;
+static int epfd = -1;
+static int stop_fd = -1;
+static int log_tfd = -1;
+static struct hsvc_log *logs;
+static pthread_t loop_tid;
+static pthread_t worker_tids[HSVC_MAX_WORKERS];
+static int n_workers;
+
+static bool
+hsvc_idle(void) {
+  int i;
+
+  for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+    if (slots[i].settling || slots[i].queued || slots[i].running) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+timespec_add_ms(struct timespec *ts, unsigned int ms) {
+  ts->tv_sec += ms / 1000;
+  ts->tv_nsec += (ms % 1000) * 1000000L;
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+static bool
+timespec_before(const struct timespec *a, const struct timespec *b) {
+  return a->tv_sec < b->tv_sec ||
+         (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// Arm the log timer for the first message, called with hsvc_lock held
+static void
+log_timer_arm(void) {
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  if (logs) {
+    its.it_value = logs->due;
+  }
+  timerfd_settime(log_tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+void
+hsvc_log_delayed(unsigned int ms, const char *msg) {
+  struct hsvc_log *log, **pp;
+
+  log = malloc(sizeof(*log));
+  if (log == NULL || log_tfd < 0) {
+    free(log);
+    syslog(LOG_CRIT, "%s", msg);
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &log->due);
+  timespec_add_ms(&log->due, ms);
+  snprintf(log->msg, sizeof(log->msg), "%s", msg);
+
+  pthread_mutex_lock(&hsvc_lock);
+  for (pp = &logs; *pp && !timespec_before(&log->due, &(*pp)->due);
+       pp = &(*pp)->next);
+  log->next = *pp;
+  *pp = log;
+  if (logs == log) {
+    log_timer_arm();
+  }
+  pthread_mutex_unlock(&hsvc_lock);
+}
+
+static void
+log_expired(void) {
+  struct hsvc_log *due = NULL, **tail = &due, *log;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  pthread_mutex_lock(&hsvc_lock);
+  while (logs && !timespec_before(&now, &logs->due)) {
+    *tail = logs;
+    tail = &logs->next;
+    logs = logs->next;
+  }
+  *tail = NULL;
+  log_timer_arm();
+  pthread_mutex_unlock(&hsvc_lock);
+
+  while ((log = due) != NULL) {
+    due = log->next;
+    syslog(LOG_CRIT, "%s", log->msg);
+    free(log);
+  }
+}
+
+void
+hsvc_edge(uint8_t slot_id, hsvc_action_t action) {
+  struct itimerspec its;
+  hsvc_slot_t *s;
+
+  if (slot_id < 1 || slot_id > HSVC_MAX_SLOTS) {
+    return;
+  }
+  s = &slots[slot_id];
+
+  memset(&its, 0, sizeof(its));
+  timespec_add_ms(&its.it_value, settle_ms[action]);
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+    its.it_value.tv_nsec = 1;
+  }
+
+  pthread_mutex_lock(&hsvc_lock);
+  stats.edges++;
+  s->settling = true;
+  s->edge_seq++;
+  timerfd_settime(s->tfd, 0, &its, NULL);
+  pthread_mutex_unlock(&hsvc_lock);
+}
+
+// Queue the work of a slot, called with hsvc_lock held
+static void
+queue_work(uint8_t slot_id, hsvc_action_t action) {
+  hsvc_slot_t *s = &slots[slot_id];
+
+  if (s->queued) {
+    stats.coalesced++;
+  } else {
+    s->queued = true;
+    s->job_seq = ++job_seq;
+  }
+  s->job = action;
+  pthread_cond_signal(&work_cond);
+}
+
+static void
+slot_settled(uint8_t slot_id) {
+  hsvc_slot_t *s = &slots[slot_id];
+  uint32_t edge_seq;
+  int prsnt;
+
+  pthread_mutex_lock(&hsvc_lock);
+  if (!s->settling) {
+    pthread_mutex_unlock(&hsvc_lock);
+    return;
+  }
+  edge_seq = s->edge_seq;
+  pthread_mutex_unlock(&hsvc_lock);
+
+  prsnt = hops->is_prsnt(slot_id);
+
+  pthread_mutex_lock(&hsvc_lock);
+  // Another edge came in meanwhile, its timer will expire later
+  if (s->edge_seq != edge_seq) {
+    pthread_mutex_unlock(&hsvc_lock);
+    return;
+  }
+  s->settling = false;
+  stats.settles++;
+  if (prsnt < 0) {
+    syslog(LOG_CRIT, "%s: is_prsnt failed for slot%u", __func__, slot_id);
+  } else if (prsnt == s->state) {
+    stats.glitches++;
+  } else {
+    s->state = prsnt;
+    queue_work(slot_id, prsnt ? HSVC_INSERTION : HSVC_REMOVAL);
+  }
+  if (hsvc_idle()) {
+    pthread_cond_broadcast(&idle_cond);
+  }
+  pthread_mutex_unlock(&hsvc_lock);
+}
+
+static void *
+hsvc_loop(void *arg) {
+  struct epoll_event evs[HSVC_MAX_SLOTS + 2];
+  uint64_t exp;
+  int n, i;
+
+  while (1) {
+    n = epoll_wait(epfd, evs, HSVC_MAX_SLOTS + 2, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      syslog(LOG_ERR, "%s: epoll_wait failed, errno=%d", __func__, errno);
+      break;
+    }
+    for (i = 0; i < n; i++) {
+      if (evs[i].data.u32 == HSVC_EV_STOP) {
+        return NULL;
+      }
+      if (evs[i].data.u32 == HSVC_EV_LOG) {
+        if (read(log_tfd, &exp, sizeof(exp)) == sizeof(exp)) {
+          log_expired();
+        }
+        continue;
+      }
+      if (read(slots[evs[i].data.u32].tfd, &exp, sizeof(exp)) == sizeof(exp)) {
+        slot_settled(evs[i].data.u32);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void *
+hsvc_worker(void *arg) {
+  hsvc_slot_t *s;
+  hsvc_action_t action;
+  int i, next;
+
+  pthread_mutex_lock(&hsvc_lock);
+  while (!stopping) {
+    // Oldest queued work of a slot that has none running
+    next = 0;
+    for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+      if (slots[i].queued && !slots[i].running &&
+          (next == 0 || slots[i].job_seq < slots[next].job_seq)) {
+        next = i;
+      }
+    }
+    if (next == 0) {
+      pthread_cond_wait(&work_cond, &hsvc_lock);
+      continue;
+    }
+
+    s = &slots[next];
+    s->queued = false;
+    s->running = true;
+    action = s->job;
+    pthread_mutex_unlock(&hsvc_lock);
+
+    hops->action(next, action);
+
+    pthread_mutex_lock(&hsvc_lock);
+    s->running = false;
+    stats.actions++;
+    // Work of this slot queued meanwhile may wait for another worker
+    pthread_cond_broadcast(&work_cond);
+    if (hsvc_idle()) {
+      pthread_cond_broadcast(&idle_cond);
+    }
+  }
+  pthread_mutex_unlock(&hsvc_lock);
+
+  return NULL;
+}
+
+static int
+epoll_add(int fd, uint32_t id) {
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = id;
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int
+hsvc_start(const hsvc_ops_t *ops, int workers) {
+  int i, prsnt;
+
+  if (workers < 1 || workers > HSVC_MAX_WORKERS) {
+    return -1;
+  }
+  hops = ops;
+  stopping = false;
+  memset(&stats, 0, sizeof(stats));
+  for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+    memset(&slots[i], 0, sizeof(slots[i]));
+    slots[i].tfd = -1;
+  }
+
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  log_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (epfd < 0 || stop_fd < 0 || log_tfd < 0 ||
+      epoll_add(stop_fd, HSVC_EV_STOP) || epoll_add(log_tfd, HSVC_EV_LOG)) {
+    goto err;
+  }
+
+  for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+    slots[i].tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (slots[i].tfd < 0 || epoll_add(slots[i].tfd, i)) {
+      goto err;
+    }
+    prsnt = ops->is_prsnt(i);
+    slots[i].state = (prsnt < 0) ? -1 : prsnt;
+  }
+
+  if (pthread_create(&loop_tid, NULL, hsvc_loop, NULL)) {
+    goto err;
+  }
+  for (n_workers = 0; n_workers < workers; n_workers++) {
+    if (pthread_create(&worker_tids[n_workers], NULL, hsvc_worker, NULL)) {
+      hsvc_stop();
+      return -1;
+    }
+  }
+  return 0;
+
+err:
+  syslog(LOG_ERR, "%s: setup failed, errno=%d", __func__, errno);
+  for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+    if (slots[i].tfd >= 0) {
+      close(slots[i].tfd);
+    }
+    slots[i].tfd = -1;
+  }
+  if (epfd >= 0) close(epfd);
+  if (stop_fd >= 0) close(stop_fd);
+  if (log_tfd >= 0) close(log_tfd);
+  epfd = stop_fd = log_tfd = -1;
+  return -1;
+}
+
+void
+hsvc_stop(void) {
+  struct hsvc_log *log;
+  uint64_t one = 1;
+  int i;
+
+  if (write(stop_fd, &one, sizeof(one)) == sizeof(one)) {
+    pthread_join(loop_tid, NULL);
+  }
+
+  pthread_mutex_lock(&hsvc_lock);
+  stopping = true;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&hsvc_lock);
+  for (i = 0; i < n_workers; i++) {
+    pthread_join(worker_tids[i], NULL);
+  }
+  n_workers = 0;
+
+  for (i = 1; i <= HSVC_MAX_SLOTS; i++) {
+    close(slots[i].tfd);
+    slots[i].tfd = -1;
+  }
+  close(epfd);
+  close(stop_fd);
+  close(log_tfd);
+  epfd = stop_fd = log_tfd = -1;
+
+  while ((log = logs) != NULL) {
+    logs = log->next;
+    free(log);
+  }
+}
+
+void
+hsvc_set_settle_ms(hsvc_action_t action, unsigned int ms) {
+  settle_ms[action] = ms;
+}
+
+int
+hsvc_wait_idle(int timeout_ms) {
+  struct timespec deadline;
+  int ret = 0;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  timespec_add_ms(&deadline, timeout_ms);
+
+  pthread_mutex_lock(&hsvc_lock);
+  while (!hsvc_idle() && ret == 0) {
+    ret = pthread_cond_timedwait(&idle_cond, &hsvc_lock, &deadline);
+  }
+  pthread_mutex_unlock(&hsvc_lock);
+
+  return ret ? -1 : 0;
+}
+
+void
+hsvc_get_stats(hsvc_stats_t *st) {
+  pthread_mutex_lock(&hsvc_lock);
+  *st = stats;
+  pthread_mutex_unlock(&hsvc_lock);
+}
@@ -0,0 +1,76 @@
+/*
+ * hsvc.h - Hot service event handling of the sled slots
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __HSVC_H__
+#define __HSVC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HSVC_MAX_SLOTS            4
+
+// Quiet time after the last present pin edge before the slot is looked at
+#define HSVC_REMOVAL_SETTLE_MS    250
+#define HSVC_INSERTION_SETTLE_MS  5000
+
+// Threads running the removal/insertion work of the slots
+#define HSVC_WORKERS              2
+
+typedef enum {
+  HSVC_REMOVAL = 0,
+  HSVC_INSERTION = 1,
+} hsvc_action_t;
+
+typedef struct {
+  // 1 if the card of the slot is present, 0 if not, negative on error
+  int (*is_prsnt)(uint8_t slot_id);
+  // Work following a settled removal or insertion, run on a worker
+  void (*action)(uint8_t slot_id, hsvc_action_t action);
+} hsvc_ops_t;
+
+typedef struct {
+  uint32_t edges;        // present pin edges reported
+  uint32_t settles;      // settle timers expired
+  uint32_t glitches;     // settled to the state the slot already was in
+  uint32_t actions;      // removal/insertion work run
+  uint32_t coalesced;    // work replaced by newer work before it ran
+} hsvc_stats_t;
+
+/*
+ * Start the event loop and the workers. The present state of the slots at
+ * start is taken as settled, no work is run for it.
+ */
+int hsvc_start(const hsvc_ops_t *ops, int workers);
+void hsvc_stop(void);
+
+// Report a present pin edge of a slot, called from the GPIO handlers
+void hsvc_edge(uint8_t slot_id, hsvc_action_t action);
+
+// Syslog msg at LOG_CRIT after ms, without a thread per message
+void hsvc_log_delayed(unsigned int ms, const char *msg);
+
+void hsvc_set_settle_ms(hsvc_action_t action, unsigned int ms);
+
+// Wait until no slot is settling and no work is queued or running
+int hsvc_wait_idle(int timeout_ms);
+
+void hsvc_get_stats(hsvc_stats_t *stats);
+
+#endif /* __HSVC_H__ */
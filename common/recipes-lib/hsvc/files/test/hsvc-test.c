@@ -0,0 +1,302 @@
+/*
+ * hsvc-test.c - Tests of the hot service event handling
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * The present pins of the slots are simulated: a script of pin changes is
+ * played in real time and reported the way gpiointrd does, one edge per
+ * present pin of the slot.
+ *
+ * eg: hsvc-test
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "hsvc.h"
+
+#define MAX_ACTIONS 64
+
+typedef struct {
+  unsigned int ms;     // since the start of the script
+  uint8_t slot_id;
+  int prsnt;
+} sim_edge_t;
+
+typedef struct {
+  uint8_t slot_id;
+  hsvc_action_t action;
+  double at_ms;
+} sim_action_t;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sim_prsnt[HSVC_MAX_SLOTS + 1];
+static int sim_running[HSVC_MAX_SLOTS + 1];
+static bool sim_overlap;
+static unsigned int sim_work_ms;
+static sim_action_t actions[MAX_ACTIONS];
+static int n_actions;
+static struct timespec t0;
+
+static double
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec - t0.tv_sec) * 1000.0 + (ts.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+static int
+count_threads(void) {
+  DIR *dir = opendir("/proc/self/task");
+  struct dirent *de;
+  int n = 0;
+
+  if (dir == NULL) {
+    return -1;
+  }
+  while ((de = readdir(dir)) != NULL) {
+    if (de->d_name[0] != '.') {
+      n++;
+    }
+  }
+  closedir(dir);
+  return n;
+}
+
+static int
+sim_is_prsnt(uint8_t slot_id) {
+  int prsnt;
+
+  pthread_mutex_lock(&sim_lock);
+  prsnt = sim_prsnt[slot_id];
+  pthread_mutex_unlock(&sim_lock);
+  return prsnt;
+}
+
+static void
+sim_action(uint8_t slot_id, hsvc_action_t action) {
+  pthread_mutex_lock(&sim_lock);
+  if (sim_running[slot_id]++) {
+    sim_overlap = true;
+  }
+  if (n_actions < MAX_ACTIONS) {
+    actions[n_actions].slot_id = slot_id;
+    actions[n_actions].action = action;
+    actions[n_actions].at_ms = now_ms();
+    n_actions++;
+  }
+  pthread_mutex_unlock(&sim_lock);
+
+  usleep(sim_work_ms * 1000);
+
+  pthread_mutex_lock(&sim_lock);
+  sim_running[slot_id]--;
+  pthread_mutex_unlock(&sim_lock);
+}
+
+static const hsvc_ops_t sim_ops = {
+  .is_prsnt = sim_is_prsnt,
+  .action = sim_action,
+};
+
+// Play the script, returns the time of the last edge of every slot
+static void
+sim_play(const sim_edge_t *script, int n, double *last_edge) {
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  n_actions = 0;
+  for (i = 0; i < n; i++) {
+    while (now_ms() < script[i].ms) {
+      usleep(500);
+    }
+    pthread_mutex_lock(&sim_lock);
+    sim_prsnt[script[i].slot_id] = script[i].prsnt;
+    pthread_mutex_unlock(&sim_lock);
+    // PRSNT_B_N and PRSNT_N both change
+    hsvc_edge(script[i].slot_id, script[i].prsnt ? HSVC_INSERTION : HSVC_REMOVAL);
+    hsvc_edge(script[i].slot_id, script[i].prsnt ? HSVC_INSERTION : HSVC_REMOVAL);
+    if (last_edge) {
+      last_edge[script[i].slot_id] = now_ms();
+    }
+  }
+}
+
+// Every slot bounces for bounce_ms while being inserted or removed
+static int
+sled_script(sim_edge_t *script, int prsnt, unsigned int bounce_ms) {
+  int n = 0, slot;
+  unsigned int t;
+
+  for (slot = 1; slot <= HSVC_MAX_SLOTS; slot++) {
+    for (t = slot * 7; t < bounce_ms; t += 13 + (t * slot) % 29) {
+      script[n].ms = t;
+      script[n].slot_id = slot;
+      script[n].prsnt = (n % 2) ? !prsnt : prsnt;
+      n++;
+    }
+    script[n].ms = bounce_ms + slot;
+    script[n].slot_id = slot;
+    script[n].prsnt = prsnt;
+    n++;
+  }
+  // time order
+  for (slot = 1; slot < n; slot++) {
+    sim_edge_t e = script[slot];
+    int j = slot - 1;
+    while (j >= 0 && script[j].ms > e.ms) {
+      script[j + 1] = script[j];
+      j--;
+    }
+    script[j + 1] = e;
+  }
+  return n;
+}
+
+static int
+count_actions(uint8_t slot_id, hsvc_action_t action) {
+  int i, n = 0;
+
+  for (i = 0; i < n_actions; i++) {
+    if (actions[i].slot_id == slot_id && actions[i].action == action) {
+      n++;
+    }
+  }
+  return n;
+}
+
+static void
+test_sled(hsvc_action_t action, unsigned int settle_ms, int threads) {
+  sim_edge_t script[256];
+  double last_edge[HSVC_MAX_SLOTS + 1];
+  hsvc_stats_t st;
+  int n, slot, i;
+  double lat, max_lat = 0;
+
+  n = sled_script(script, action == HSVC_INSERTION, 300);
+  sim_play(script, n, last_edge);
+  CHECK(count_threads() == threads);
+  CHECK(hsvc_wait_idle(settle_ms + 2000) == 0);
+
+  for (slot = 1; slot <= HSVC_MAX_SLOTS; slot++) {
+    CHECK(count_actions(slot, action) == 1);
+    for (i = 0; i < n_actions; i++) {
+      if (actions[i].slot_id == slot) {
+        lat = actions[i].at_ms - last_edge[slot];
+        CHECK(lat >= settle_ms - 1 && lat < settle_ms + 100);
+        if (lat > max_lat) {
+          max_lat = lat;
+        }
+      }
+    }
+  }
+  CHECK(n_actions == HSVC_MAX_SLOTS);
+  hsvc_get_stats(&st);
+  printf("%s: %d pin edges, %d actions, slots ready %.0f ms after the last "
+         "edge (%.0f ms after the first), the old handler: %d threads, "
+         "ready %u ms after the last edge\n",
+         action == HSVC_INSERTION ? "insertion" : "removal",
+         n * 2, n_actions, max_lat, max_lat + 300,
+         n, action == HSVC_INSERTION ? 5000 : 250);
+}
+
+static void
+test_glitch(void) {
+  sim_edge_t script[] = {
+    { 10, 2, 0 },
+    { 30, 2, 1 },
+  };
+  hsvc_stats_t before, after;
+
+  hsvc_get_stats(&before);
+  sim_play(script, 2, NULL);
+  CHECK(hsvc_wait_idle(3000) == 0);
+  hsvc_get_stats(&after);
+  CHECK(n_actions == 0);
+  CHECK(after.glitches == before.glitches + 1);
+}
+
+// Slow work: a slot pushed back in while its removal work still runs
+static void
+test_ordering(void) {
+  sim_edge_t script[] = {
+    { 0, 3, 0 },
+    { 400, 3, 1 },
+  };
+
+  sim_work_ms = 1500;
+  sim_play(script, 2, NULL);
+  CHECK(hsvc_wait_idle(6000) == 0);
+  CHECK(n_actions == 2);
+  CHECK(actions[0].action == HSVC_REMOVAL && actions[1].action == HSVC_INSERTION);
+  CHECK(actions[1].at_ms >= actions[0].at_ms + sim_work_ms);
+  CHECK(!sim_overlap);
+  sim_work_ms = 0;
+}
+
+int
+main(int argc, char **argv) {
+  int slot, threads;
+
+  for (slot = 1; slot <= HSVC_MAX_SLOTS; slot++) {
+    sim_prsnt[slot] = 0;
+  }
+  // Short insertion settling until the last tests, the default is 5 s
+  hsvc_set_settle_ms(HSVC_INSERTION, 200);
+  threads = count_threads();
+  CHECK(hsvc_start(&sim_ops, HSVC_WORKERS) == 0);
+  // the event loop and the workers, nothing per event
+  threads += 1 + HSVC_WORKERS;
+  CHECK(count_threads() == threads);
+
+  test_sled(HSVC_INSERTION, 200, threads);
+  test_glitch();
+  test_ordering();
+  test_sled(HSVC_REMOVAL, HSVC_REMOVAL_SETTLE_MS, threads);
+  for (slot = 1; slot <= HSVC_MAX_SLOTS; slot++) {
+    sim_prsnt[slot] = 1;
+  }
+  hsvc_stop();
+
+  hsvc_set_settle_ms(HSVC_INSERTION, HSVC_INSERTION_SETTLE_MS);
+  CHECK(hsvc_start(&sim_ops, HSVC_WORKERS) == 0);
+  test_sled(HSVC_REMOVAL, HSVC_REMOVAL_SETTLE_MS, threads);
+  test_sled(HSVC_INSERTION, HSVC_INSERTION_SETTLE_MS, threads);
+  hsvc_log_delayed(10, "hsvc-test: delayed log");
+  usleep(50000);
+  hsvc_stop();
+
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -87,12 +88,11 @@ ipmb_txb()
 /*
  * Function to handle IPMB messages
  */
-void
-lib_ipmb_handle(unsigned char bus_id,
-            unsigned char *request, unsigned char req_len,
-            unsigned char *response, unsigned char *res_len) {
+int
+lib_ipmb_submit(unsigned char bus_id,
+            unsigned char *request, unsigned char req_len) {
 
-  int s, t, len;
+  int s, len;
   struct sockaddr_un remote;
   char sock_path[64] = {0};
   struct timeval tv;
@@ -102,9 +102,9 @@ lib_ipmb_handle(unsigned char bus_id,
   // TODO: Need to update to reuse the socket instead of creating new
   if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
 #ifdef DEBUG
-    syslog(LOG_WARNING, "lib_ipmb_handle: socket() failed\n");
+    syslog(LOG_WARNING, "lib_ipmb_submit: socket() failed\n");
 #endif
-    return;
+    return -1;
   }
 
   // setup timeout for receving on socket
@@ -121,14 +121,28 @@ lib_ipmb_handle(unsigned char bus_id,
 #ifdef DEBUG
     syslog(LOG_WARNING, "ipmb_handle: connect() failed\n");
 #endif
-    goto clean_exit;
+    close(s);
+    return -1;
   }
 
   if (send(s, request, req_len, 0) == -1) {
 #ifdef DEBUG
     syslog(LOG_WARNING, "ipmb_handle: send() failed\n");
 #endif
-    goto clean_exit;
+    close(s);
+    return -1;
+  }
+
+  return s;
+}
+
+void
+lib_ipmb_collect(int s, unsigned char *response, unsigned char *res_len) {
+
+  int t;
+
+  if (s < 0) {
+    return;
   }
 
   if ((t=recv(s, response, MAX_IPMB_RES_LEN, 0)) > 0) {
@@ -136,7 +150,7 @@ lib_ipmb_handle(unsigned char bus_id,
   } else {
     if (t < 0) {
 #ifdef DEBUG
-      syslog(LOG_WARNING, "lib_ipmb_handle: recv() failed\n");
+      syslog(LOG_WARNING, "lib_ipmb_collect: recv() failed\n");
 #endif
     } else {
 #ifdef DEBUG
@@ -145,10 +159,15 @@ lib_ipmb_handle(unsigned char bus_id,
     }
   }
 
-clean_exit:
   close(s);
+}
+
+void
+lib_ipmb_handle(unsigned char bus_id,
+            unsigned char *request, unsigned char req_len,
+            unsigned char *response, unsigned char *res_len) {
 
-  return;
+  lib_ipmb_collect(lib_ipmb_submit(bus_id, request, req_len), response, res_len);
 }
 
 int
@@ -73,6 +73,16 @@ void lib_ipmb_handle(unsigned char bus_id,
                   unsigned char *request, unsigned char req_len,
                   unsigned char *response, unsigned char *res_len);
 
+/*
+ * Split form of lib_ipmb_handle() for pipelining: ipmbd serves every
+ * connection on its own thread, so several requests can be submitted
+ * before collecting their responses. lib_ipmb_collect() closes the
+ * connection returned by lib_ipmb_submit().
+ */
+int lib_ipmb_submit(unsigned char bus_id,
+                  unsigned char *request, unsigned char req_len);
+void lib_ipmb_collect(int s, unsigned char *response, unsigned char *res_len);
+
 /*
  * ipmb_send():
  *   Send IPMB command without prepare tx data.
@@ -430,6 +430,7 @@ enum
 enum
 {
   CMD_OEM_STOR_ADD_STRING_SEL = 0x30,
+  CMD_OEM_STOR_GET_SEL_ENTRIES = 0x31,
 };
 
 // OEM Command Codes for QC
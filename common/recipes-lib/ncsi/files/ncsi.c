@@ -0,0 +1,725 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include "ncsi.h"
+
+/* Kernel NCSI generic netlink interface (include/uapi/linux/ncsi.h) */
+#define NCSI_GENL_NAME        "NCSI"
+#define NCSI_GENL_CMD_SEND    4
+#define NCSI_ATTR_IFINDEX     1
+#define NCSI_ATTR_PACKAGE_ID  3
+#define NCSI_ATTR_CHANNEL_ID  4
+#define NCSI_ATTR_DATA        5
+
+#define NCSI_NL_BUF_SIZE      1024
+
+enum {
+  NCSI_TRANSPORT_NETLINK = 0,
+  NCSI_TRANSPORT_LOOPBACK,
+};
+
+struct ncsi_chan {
+  int type;
+  int fd;
+  int ifindex;
+  uint16_t family;
+  uint32_t seq;
+  /* loopback responder */
+  int peer_fd;
+  pthread_t tid;
+};
+
+/* Request framing used between the loopback channel and its responder */
+typedef struct {
+  uint32_t seq;
+  ncsi_pkt_hdr_t hdr;
+  uint8_t payload[NCSI_MAX_PAYLOAD + 4];
+} __attribute__((packed)) ncsi_lb_frame_t;
+
+static uint32_t
+ncsi_next_seq(ncsi_chan_t *chan) {
+  // 0 is reserved for AENs
+  if (++chan->seq == 0)
+    chan->seq = 1;
+  return chan->seq;
+}
+
+static void
+ncsi_build_hdr(ncsi_pkt_hdr_t *hdr, uint8_t iid, uint8_t type, uint8_t channel,
+               uint16_t len) {
+  memset(hdr, 0, sizeof(*hdr));
+  hdr->revision = 0x01;
+  hdr->iid = iid;
+  hdr->type = type;
+  hdr->channel = channel;
+  hdr->length = htons(len);
+}
+
+/* Fill rsp from a raw NC-SI response or AEN packet */
+static int
+ncsi_decode_pkt(const uint8_t *buf, int len, uint32_t seq, ncsi_rsp_t *rsp) {
+  const ncsi_pkt_hdr_t *hdr = (const ncsi_pkt_hdr_t *)buf;
+  int plen;
+
+  if (len < (int)sizeof(ncsi_pkt_hdr_t))
+    return -1;
+
+  plen = ntohs(hdr->length) & 0x0FFF;
+  if (plen > len - (int)sizeof(ncsi_pkt_hdr_t))
+    plen = len - sizeof(ncsi_pkt_hdr_t);
+  buf += sizeof(ncsi_pkt_hdr_t);
+
+  memset(rsp, 0, sizeof(*rsp));
+  rsp->seq = seq;
+  rsp->type = hdr->type;
+  rsp->channel = hdr->channel;
+
+  if (hdr->type == NCSI_PKT_AEN) {
+    rsp->seq = 0;
+    rsp->len = (plen > NCSI_MAX_PAYLOAD) ? NCSI_MAX_PAYLOAD : plen;
+    memcpy(rsp->data, buf, rsp->len);
+    return 0;
+  }
+
+  if (plen < 4)
+    return -1;
+  rsp->resp_code = (buf[0] << 8) | buf[1];
+  rsp->reason_code = (buf[2] << 8) | buf[3];
+  plen -= 4;
+  rsp->len = (plen > NCSI_MAX_PAYLOAD) ? NCSI_MAX_PAYLOAD : plen;
+  memcpy(rsp->data, buf + 4, rsp->len);
+
+  return 0;
+}
+
+static int
+ncsi_wait_fd(int fd, int timeout_ms) {
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  int ret;
+
+  do {
+    ret = poll(&pfd, 1, timeout_ms);
+  } while (ret < 0 && errno == EINTR);
+
+  return ret;
+}
+
+/*
+ * Netlink transport
+ */
+
+static struct nlattr *
+nl_put_attr(struct nlmsghdr *nlh, uint16_t type, const void *data, int len) {
+  struct nlattr *nla = (struct nlattr *)((uint8_t *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+
+  nla->nla_type = type;
+  nla->nla_len = NLA_HDRLEN + len;
+  memcpy((uint8_t *)nla + NLA_HDRLEN, data, len);
+  nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(nla->nla_len);
+
+  return nla;
+}
+
+static struct nlattr *
+nl_find_attr(struct nlmsghdr *nlh, int hdrlen, uint16_t type) {
+  struct nlattr *nla = (struct nlattr *)((uint8_t *)NLMSG_DATA(nlh) + NLMSG_ALIGN(hdrlen));
+  int rem = nlh->nlmsg_len - NLMSG_LENGTH(hdrlen);
+
+  while (rem >= (int)sizeof(*nla) && nla->nla_len >= sizeof(*nla) && nla->nla_len <= rem) {
+    if ((nla->nla_type & NLA_TYPE_MASK) == type)
+      return nla;
+    rem -= NLA_ALIGN(nla->nla_len);
+    nla = (struct nlattr *)((uint8_t *)nla + NLA_ALIGN(nla->nla_len));
+  }
+
+  return NULL;
+}
+
+static int
+nl_resolve_family(int fd, uint16_t *family) {
+  uint8_t buf[NCSI_NL_BUF_SIZE] __attribute__((aligned(4)));
+  struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+  struct genlmsghdr *genl;
+  struct nlattr *nla;
+  int len;
+
+  memset(buf, 0, sizeof(buf));
+  nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+  nlh->nlmsg_type = GENL_ID_CTRL;
+  nlh->nlmsg_flags = NLM_F_REQUEST;
+  nlh->nlmsg_seq = 0;
+  genl = NLMSG_DATA(nlh);
+  genl->cmd = CTRL_CMD_GETFAMILY;
+  genl->version = 1;
+  nl_put_attr(nlh, CTRL_ATTR_FAMILY_NAME, NCSI_GENL_NAME, strlen(NCSI_GENL_NAME) + 1);
+
+  if (send(fd, buf, nlh->nlmsg_len, 0) < 0)
+    return -1;
+  if (ncsi_wait_fd(fd, NCSI_TIMEOUT_MS) <= 0)
+    return -1;
+  len = recv(fd, buf, sizeof(buf), 0);
+  if (len < (int)NLMSG_LENGTH(GENL_HDRLEN) || !NLMSG_OK(nlh, len) ||
+      nlh->nlmsg_type == NLMSG_ERROR)
+    return -1;
+
+  nla = nl_find_attr(nlh, GENL_HDRLEN, CTRL_ATTR_FAMILY_ID);
+  if (nla == NULL)
+    return -1;
+  *family = *(uint16_t *)((uint8_t *)nla + NLA_HDRLEN);
+
+  return 0;
+}
+
+static int
+nl_submit(ncsi_chan_t *chan, uint32_t seq, uint8_t channel, uint8_t cmd,
+          const uint8_t *payload, uint16_t len) {
+  uint8_t buf[NCSI_NL_BUF_SIZE] __attribute__((aligned(4)));
+  uint8_t pkt[sizeof(ncsi_pkt_hdr_t) + NCSI_MAX_PAYLOAD];
+  struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+  struct genlmsghdr *genl;
+  uint32_t val;
+
+  memset(buf, 0, sizeof(buf));
+  nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+  nlh->nlmsg_type = chan->family;
+  nlh->nlmsg_flags = NLM_F_REQUEST;
+  nlh->nlmsg_seq = seq;
+  genl = NLMSG_DATA(nlh);
+  genl->cmd = NCSI_GENL_CMD_SEND;
+
+  val = chan->ifindex;
+  nl_put_attr(nlh, NCSI_ATTR_IFINDEX, &val, sizeof(val));
+  val = NCSI_PACKAGE_ID(channel);
+  nl_put_attr(nlh, NCSI_ATTR_PACKAGE_ID, &val, sizeof(val));
+  val = NCSI_CHANNEL_ID(channel);
+  nl_put_attr(nlh, NCSI_ATTR_CHANNEL_ID, &val, sizeof(val));
+
+  // The kernel assigns the IID, the netlink sequence matches the response
+  ncsi_build_hdr((ncsi_pkt_hdr_t *)pkt, 0, cmd, channel, len);
+  memcpy(pkt + sizeof(ncsi_pkt_hdr_t), payload, len);
+  nl_put_attr(nlh, NCSI_ATTR_DATA, pkt, sizeof(ncsi_pkt_hdr_t) + len);
+
+  if (send(chan->fd, buf, nlh->nlmsg_len, 0) < 0) {
+    syslog(LOG_WARNING, "%s: send failed, errno = %d", __func__, errno);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int
+nl_recv(ncsi_chan_t *chan, ncsi_rsp_t *rsp) {
+  uint8_t buf[NCSI_NL_BUF_SIZE] __attribute__((aligned(4)));
+  struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+  struct nlattr *nla;
+  int len;
+
+  len = recv(chan->fd, buf, sizeof(buf), 0);
+  if (len < 0 || !NLMSG_OK(nlh, len))
+    return -1;
+
+  if (nlh->nlmsg_type == NLMSG_ERROR) {
+    // The kernel rejected the command or timed it out
+    memset(rsp, 0, sizeof(*rsp));
+    rsp->seq = nlh->nlmsg_seq;
+    rsp->resp_code = NCSI_RESP_TRANSPORT_ERR;
+    return 0;
+  }
+
+  nla = nl_find_attr(nlh, GENL_HDRLEN, NCSI_ATTR_DATA);
+  if (nla == NULL)
+    return -1;
+
+  return ncsi_decode_pkt((uint8_t *)nla + NLA_HDRLEN, nla->nla_len - NLA_HDRLEN,
+                         nlh->nlmsg_seq, rsp);
+}
+
+ncsi_chan_t *
+ncsi_open(const char *ifname) {
+  ncsi_chan_t *chan;
+  struct sockaddr_nl addr;
+
+  chan = calloc(1, sizeof(ncsi_chan_t));
+  if (chan == NULL)
+    return NULL;
+  chan->type = NCSI_TRANSPORT_NETLINK;
+  chan->peer_fd = -1;
+
+  chan->ifindex = if_nametoindex(ifname ? ifname : NCSI_DEFAULT_IFNAME);
+  if (chan->ifindex == 0) {
+    syslog(LOG_WARNING, "%s: unknown interface %s", __func__, ifname);
+    goto err;
+  }
+
+  chan->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (chan->fd < 0) {
+    syslog(LOG_WARNING, "%s: socket failed, errno = %d", __func__, errno);
+    goto err;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  if (bind(chan->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    syslog(LOG_WARNING, "%s: bind failed, errno = %d", __func__, errno);
+    goto err_close;
+  }
+
+  if (nl_resolve_family(chan->fd, &chan->family)) {
+    syslog(LOG_WARNING, "%s: NCSI netlink family is not available", __func__);
+    goto err_close;
+  }
+
+  return chan;
+
+err_close:
+  close(chan->fd);
+err:
+  free(chan);
+  return NULL;
+}
+
+/*
+ * Loopback transport: a responder thread behaving like a single-package
+ * NIC with NCSI_MAX_CHANNEL channels, for exercising ncsid and clients
+ * on a host without NC-SI hardware.
+ */
+
+static void
+lb_put32(uint8_t *buf, uint32_t val) {
+  buf[0] = val >> 24;
+  buf[1] = val >> 16;
+  buf[2] = val >> 8;
+  buf[3] = val;
+}
+
+static void
+lb_put64(uint8_t *buf, uint64_t val) {
+  lb_put32(buf, val >> 32);
+  lb_put32(buf + 4, (uint32_t)val);
+}
+
+static int
+lb_send(int fd, uint32_t seq, uint8_t type, uint8_t channel, uint16_t resp_code,
+        const uint8_t *data, uint16_t len) {
+  ncsi_lb_frame_t frame;
+
+  frame.seq = seq;
+  if (type == NCSI_PKT_AEN) {
+    ncsi_build_hdr(&frame.hdr, 0, type, channel, len);
+    memcpy(frame.payload, data, len);
+  } else {
+    ncsi_build_hdr(&frame.hdr, (uint8_t)seq, type, channel, len + 4);
+    frame.payload[0] = resp_code >> 8;
+    frame.payload[1] = resp_code;
+    frame.payload[2] = 0;
+    frame.payload[3] = 0;
+    memcpy(&frame.payload[4], data, len);
+    len += 4;
+  }
+
+  return send(fd, &frame, sizeof(frame.seq) + sizeof(frame.hdr) + len, 0);
+}
+
+static void *
+lb_responder(void *arg) {
+  ncsi_chan_t *chan = arg;
+  ncsi_lb_frame_t req;
+  uint8_t data[NCSI_MAX_PAYLOAD];
+  uint64_t counter = 0;
+  uint8_t ch;
+  int len;
+
+  while ((len = recv(chan->peer_fd, &req, sizeof(req), 0)) > 0) {
+    if (len < (int)(sizeof(req.seq) + sizeof(req.hdr)))
+      continue;
+
+    ch = req.hdr.channel;
+    if (NCSI_PACKAGE_ID(ch) != 0 || NCSI_CHANNEL_ID(ch) >= NCSI_MAX_CHANNEL) {
+      // No such channel: the request times out, as on real hardware
+      continue;
+    }
+
+    memset(data, 0, sizeof(data));
+    counter++;
+    switch (req.hdr.type) {
+      case NCSI_CMD_GET_LINK_STATUS:
+        // Link up, 10GBASE-T full duplex, auto-negotiation complete
+        lb_put32(&data[0], 0x00000021 | (0x08 << 1));
+        lb_send(chan->peer_fd, req.seq, req.hdr.type | NCSI_RSP_FLAG, ch,
+                NCSI_RESP_COMPLETED, data, 12);
+        break;
+      case NCSI_CMD_GET_CTRL_PKT_STATS:
+        lb_put64(&data[8], counter * 1500);   // rx bytes
+        lb_put64(&data[16], counter * 1000);  // tx bytes
+        lb_put64(&data[24], counter);         // rx unicast
+        lb_put64(&data[48], counter);         // tx unicast
+        lb_send(chan->peer_fd, req.seq, req.hdr.type | NCSI_RSP_FLAG, ch,
+                NCSI_RESP_COMPLETED, data, 204);
+        break;
+      case NCSI_CMD_AEN_ENABLE:
+        lb_send(chan->peer_fd, req.seq, req.hdr.type | NCSI_RSP_FLAG, ch,
+                NCSI_RESP_COMPLETED, data, 0);
+        // Report the current link state right away
+        data[3] = NCSI_AEN_LINK_STATUS_CHANGE;
+        lb_put32(&data[4], 0x00000021 | (0x08 << 1));
+        lb_send(chan->peer_fd, 0, NCSI_PKT_AEN, ch, 0, data, 12);
+        break;
+      default:
+        if (req.hdr.type >= NCSI_CMD_OEM) {
+          lb_send(chan->peer_fd, req.seq, req.hdr.type | NCSI_RSP_FLAG, ch,
+                  NCSI_RESP_UNSUPPORTED, data, 0);
+        } else {
+          lb_send(chan->peer_fd, req.seq, req.hdr.type | NCSI_RSP_FLAG, ch,
+                  NCSI_RESP_COMPLETED, data, 0);
+        }
+        break;
+    }
+  }
+
+  return NULL;
+}
+
+ncsi_chan_t *
+ncsi_open_loopback(void) {
+  ncsi_chan_t *chan;
+  int fds[2];
+
+  chan = calloc(1, sizeof(ncsi_chan_t));
+  if (chan == NULL)
+    return NULL;
+  chan->type = NCSI_TRANSPORT_LOOPBACK;
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+    free(chan);
+    return NULL;
+  }
+  chan->fd = fds[0];
+  chan->peer_fd = fds[1];
+
+  if (pthread_create(&chan->tid, NULL, lb_responder, chan)) {
+    close(fds[0]);
+    close(fds[1]);
+    free(chan);
+    return NULL;
+  }
+
+  return chan;
+}
+
+void
+ncsi_close(ncsi_chan_t *chan) {
+  if (chan == NULL)
+    return;
+
+  if (chan->type == NCSI_TRANSPORT_LOOPBACK) {
+    // Shutting down our end terminates the responder
+    shutdown(chan->fd, SHUT_RDWR);
+    pthread_join(chan->tid, NULL);
+    close(chan->peer_fd);
+  }
+  close(chan->fd);
+  free(chan);
+}
+
+int
+ncsi_get_fd(ncsi_chan_t *chan) {
+  return chan->fd;
+}
+
+int
+ncsi_submit(ncsi_chan_t *chan, uint8_t channel, uint8_t cmd,
+            const uint8_t *payload, uint16_t len, uint32_t *seq) {
+  ncsi_lb_frame_t frame;
+  uint32_t s;
+
+  if (len > NCSI_MAX_PAYLOAD || (len && payload == NULL))
+    return -1;
+
+  s = ncsi_next_seq(chan);
+  if (chan->type == NCSI_TRANSPORT_LOOPBACK) {
+    frame.seq = s;
+    ncsi_build_hdr(&frame.hdr, (uint8_t)s, cmd, channel, len);
+    memcpy(frame.payload, payload, len);
+    if (send(chan->fd, &frame, sizeof(frame.seq) + sizeof(frame.hdr) + len, 0) < 0)
+      return -1;
+  } else if (nl_submit(chan, s, channel, cmd, payload, len)) {
+    return -1;
+  }
+
+  if (seq)
+    *seq = s;
+  return 0;
+}
+
+int
+ncsi_recv(ncsi_chan_t *chan, ncsi_rsp_t *rsp, int timeout_ms) {
+  ncsi_lb_frame_t frame;
+  int len;
+
+  if (ncsi_wait_fd(chan->fd, timeout_ms) <= 0)
+    return -1;
+
+  if (chan->type == NCSI_TRANSPORT_NETLINK)
+    return nl_recv(chan, rsp);
+
+  len = recv(chan->fd, &frame, sizeof(frame), 0);
+  if (len < (int)sizeof(frame.seq))
+    return -1;
+  return ncsi_decode_pkt((uint8_t *)&frame.hdr, len - sizeof(frame.seq), frame.seq, rsp);
+}
+
+int
+ncsi_send_cmd(ncsi_chan_t *chan, uint8_t channel, uint8_t cmd,
+              const uint8_t *payload, uint16_t len, ncsi_rsp_t *rsp) {
+  struct timespec start, now;
+  uint32_t seq;
+  int elapsed = 0;
+
+  if (ncsi_submit(chan, channel, cmd, payload, len, &seq))
+    return -1;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (elapsed < NCSI_TIMEOUT_MS) {
+    if (ncsi_recv(chan, rsp, NCSI_TIMEOUT_MS - elapsed) == 0 && rsp->seq == seq)
+      return (rsp->resp_code == NCSI_RESP_TRANSPORT_ERR) ? -1 : 0;
+
+    // Skip AENs and stale responses
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - start.tv_sec) * 1000 +
+              (now.tv_nsec - start.tv_nsec) / 1000000;
+  }
+
+  syslog(LOG_WARNING, "%s: cmd 0x%02X channel 0x%02X timed out", __func__, cmd, channel);
+  return -1;
+}
+
+static int
+ncsid_request(const ncsid_req_t *req, ncsi_rsp_t *rsp) {
+  struct sockaddr_un remote;
+  int s, len;
+  int ret = -1;
+
+  s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (s < 0)
+    return -1;
+
+  memset(&remote, 0, sizeof(remote));
+  remote.sun_family = AF_UNIX;
+  strcpy(remote.sun_path, SOCK_PATH_NCSID);
+  if (connect(s, (struct sockaddr *)&remote, sizeof(remote)) < 0)
+    goto exit;
+
+  if (send(s, req, offsetof(ncsid_req_t, payload) + req->len, 0) < 0)
+    goto exit;
+
+  // ncsid always answers, with a transport error on timeout
+  if (ncsi_wait_fd(s, 2 * NCSI_TIMEOUT_MS) <= 0)
+    goto exit;
+  len = recv(s, rsp, sizeof(*rsp), 0);
+  if (len == sizeof(*rsp))
+    ret = (rsp->resp_code == NCSI_RESP_TRANSPORT_ERR) ? -1 : 0;
+
+exit:
+  close(s);
+  return ret;
+}
+
+int
+ncsi_request(const char *ifname, uint8_t channel, uint8_t cmd,
+             const uint8_t *payload, uint16_t len, ncsi_rsp_t *rsp) {
+  ncsid_req_t req;
+  ncsi_chan_t *chan;
+  int ret;
+
+  if (len > NCSI_MAX_PAYLOAD)
+    return -1;
+
+  req.channel = channel;
+  req.cmd = cmd;
+  req.len = len;
+  memcpy(req.payload, payload, len);
+  if (access(SOCK_PATH_NCSID, F_OK) == 0)
+    return ncsid_request(&req, rsp);
+
+  chan = ncsi_open(ifname);
+  if (chan == NULL)
+    return -1;
+  ret = ncsi_send_cmd(chan, channel, cmd, payload, len, rsp);
+  ncsi_close(chan);
+
+  return ret;
+}
+
+/*
+ * Response decoders
+ */
+
+static uint32_t
+get32(const uint8_t *buf) {
+  return ((uint32_t)buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static uint64_t
+get64(const uint8_t *buf) {
+  return ((uint64_t)get32(buf) << 32) | get32(buf + 4);
+}
+
+int
+ncsi_parse_link_status(const ncsi_rsp_t *rsp, ncsi_link_status_t *link) {
+  if (rsp->type != (NCSI_CMD_GET_LINK_STATUS | NCSI_RSP_FLAG) ||
+      rsp->resp_code != NCSI_RESP_COMPLETED || rsp->len < 12)
+    return -1;
+
+  link->link_status = get32(&rsp->data[0]);
+  link->other_indications = get32(&rsp->data[4]);
+  link->oem_link_status = get32(&rsp->data[8]);
+  return 0;
+}
+
+int
+ncsi_parse_pkt_stats(const ncsi_rsp_t *rsp, ncsi_pkt_stats_t *stats) {
+  const uint8_t *d = rsp->data;
+
+  // Counters up to the jabber count are all we keep
+  if (rsp->type != (NCSI_CMD_GET_CTRL_PKT_STATS | NCSI_RSP_FLAG) ||
+      rsp->resp_code != NCSI_RESP_COMPLETED || rsp->len < 92)
+    return -1;
+
+  stats->rx_bytes = get64(&d[8]);
+  stats->tx_bytes = get64(&d[16]);
+  stats->rx_ucast = get64(&d[24]);
+  stats->rx_mcast = get64(&d[32]);
+  stats->rx_bcast = get64(&d[40]);
+  stats->tx_ucast = get64(&d[48]);
+  stats->tx_mcast = get64(&d[56]);
+  stats->tx_bcast = get64(&d[64]);
+  stats->fcs_err = get32(&d[72]);
+  stats->align_err = get32(&d[76]);
+  stats->false_carrier = get32(&d[80]);
+  stats->runt = get32(&d[84]);
+  stats->jabber = get32(&d[88]);
+  return 0;
+}
+
+int
+ncsi_parse_aen(const ncsi_rsp_t *rsp, uint8_t *aen_type, ncsi_link_status_t *link) {
+  if (rsp->type != NCSI_PKT_AEN || rsp->len < 4)
+    return -1;
+
+  *aen_type = rsp->data[3];
+  if (*aen_type == NCSI_AEN_LINK_STATUS_CHANGE && link != NULL) {
+    if (rsp->len < 12)
+      return -1;
+    link->link_status = get32(&rsp->data[4]);
+    link->oem_link_status = get32(&rsp->data[8]);
+  }
+  return 0;
+}
+
+/*
+ * Shared memory snapshot
+ */
+
+ncsi_snapshot_t *
+ncsi_snapshot_map(bool writer) {
+  ncsi_snapshot_t *snap;
+  int fd;
+
+  fd = shm_open(NCSI_SNAPSHOT_SHM, writer ? (O_CREAT | O_RDWR) : O_RDONLY,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0)
+    return NULL;
+
+  if (writer && ftruncate(fd, sizeof(ncsi_snapshot_t)) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  snap = mmap(NULL, sizeof(ncsi_snapshot_t), writer ? (PROT_READ | PROT_WRITE) : PROT_READ,
+              MAP_SHARED, fd, 0);
+  close(fd);
+
+  return (snap == MAP_FAILED) ? NULL : snap;
+}
+
+void
+ncsi_snapshot_unmap(ncsi_snapshot_t *snap) {
+  if (snap)
+    munmap(snap, sizeof(ncsi_snapshot_t));
+}
+
+void
+ncsi_snapshot_begin(ncsi_snapshot_t *snap) {
+  snap->seq++;
+  __sync_synchronize();
+}
+
+void
+ncsi_snapshot_end(ncsi_snapshot_t *snap) {
+  __sync_synchronize();
+  snap->seq++;
+}
+
+int
+ncsi_snapshot_read(ncsi_snapshot_t *out) {
+  ncsi_snapshot_t *snap;
+  uint32_t seq;
+  int retry;
+  int ret = -1;
+
+  snap = ncsi_snapshot_map(false);
+  if (snap == NULL)
+    return -1;
+
+  for (retry = 0; retry < 100; retry++) {
+    seq = snap->seq;
+    if (seq & 1) {
+      usleep(100);
+      continue;
+    }
+    __sync_synchronize();
+    memcpy(out, snap, sizeof(ncsi_snapshot_t));
+    __sync_synchronize();
+    if (snap->seq == seq) {
+      ret = 0;
+      break;
+    }
+  }
+
+  ncsi_snapshot_unmap(snap);
+  return ret;
+}
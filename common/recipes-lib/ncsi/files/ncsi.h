@@ -0,0 +1,195 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __NCSI_H__
+#define __NCSI_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define NCSI_DEFAULT_IFNAME   "eth0"
+#define SOCK_PATH_NCSID       "/tmp/ncsid_socket"
+#define NCSI_SNAPSHOT_SHM     "/ncsi_snapshot"
+
+#define NCSI_MAX_PAYLOAD      256
+#define NCSI_MAX_CHANNEL      4
+#define NCSI_TIMEOUT_MS       1000
+
+/* NC-SI command types (DSP0222) */
+#define NCSI_CMD_CLEAR_INITIAL_STATE   0x00
+#define NCSI_CMD_AEN_ENABLE            0x08
+#define NCSI_CMD_GET_LINK_STATUS       0x0A
+#define NCSI_CMD_GET_VERSION_ID        0x15
+#define NCSI_CMD_GET_CAPABILITIES      0x16
+#define NCSI_CMD_GET_PARAMETERS        0x17
+#define NCSI_CMD_GET_CTRL_PKT_STATS    0x18
+#define NCSI_CMD_GET_NCSI_STATS        0x19
+#define NCSI_CMD_OEM                   0x50
+
+#define NCSI_RSP_FLAG                  0x80
+#define NCSI_PKT_AEN                   0xFF
+
+/* AEN types */
+#define NCSI_AEN_LINK_STATUS_CHANGE    0x00
+#define NCSI_AEN_CONFIG_REQUIRED       0x01
+#define NCSI_AEN_HOST_DRIVER_CHANGE    0x02
+
+/* Response codes */
+#define NCSI_RESP_COMPLETED            0x0000
+#define NCSI_RESP_FAILED               0x0001
+#define NCSI_RESP_UNAVAILABLE          0x0002
+#define NCSI_RESP_UNSUPPORTED          0x0003
+/* Not an NC-SI code: the command was rejected or timed out in transport */
+#define NCSI_RESP_TRANSPORT_ERR        0xFFFF
+
+/* Channel byte: package id in bits 7:5, internal channel id in bits 4:0 */
+#define NCSI_CHANNEL(pkg, ch)  ((uint8_t)(((pkg) << 5) | ((ch) & 0x1F)))
+#define NCSI_PACKAGE_ID(c)     (((c) >> 5) & 0x07)
+#define NCSI_CHANNEL_ID(c)     ((c) & 0x1F)
+
+typedef struct {
+  uint8_t  mc_id;
+  uint8_t  revision;
+  uint8_t  reserved;
+  uint8_t  iid;
+  uint8_t  type;
+  uint8_t  channel;
+  uint16_t length;      /* payload length, network order */
+  uint32_t reserved1[2];
+} __attribute__((packed)) ncsi_pkt_hdr_t;
+
+/* A response (or AEN) delivered to the caller */
+typedef struct {
+  uint32_t seq;         /* sequence id of the request, 0 for an AEN */
+  uint8_t  type;        /* response type (cmd | 0x80) or NCSI_PKT_AEN */
+  uint8_t  channel;
+  uint16_t resp_code;
+  uint16_t reason_code;
+  uint16_t len;         /* length of data[] */
+  uint8_t  data[NCSI_MAX_PAYLOAD];
+} ncsi_rsp_t;
+
+/* Request framing used between clients and ncsid */
+typedef struct {
+  uint8_t  channel;
+  uint8_t  cmd;
+  uint16_t len;
+  uint8_t  payload[NCSI_MAX_PAYLOAD];
+} ncsid_req_t;
+
+typedef struct {
+  uint32_t link_status;
+  uint32_t other_indications;
+  uint32_t oem_link_status;
+} ncsi_link_status_t;
+
+/* The commonly used counters of Get Controller Packet Statistics */
+typedef struct {
+  uint64_t rx_bytes;
+  uint64_t tx_bytes;
+  uint64_t rx_ucast;
+  uint64_t rx_mcast;
+  uint64_t rx_bcast;
+  uint64_t tx_ucast;
+  uint64_t tx_mcast;
+  uint64_t tx_bcast;
+  uint32_t fcs_err;
+  uint32_t align_err;
+  uint32_t false_carrier;
+  uint32_t runt;
+  uint32_t jabber;
+} ncsi_pkt_stats_t;
+
+typedef struct {
+  bool     present;
+  time_t   link_time;
+  time_t   stats_time;
+  uint32_t aen_count;
+  uint32_t err_count;
+  ncsi_link_status_t link;
+  ncsi_pkt_stats_t   stats;
+} ncsi_channel_snapshot_t;
+
+/*
+ * Periodically refreshed state published by ncsid. seq is odd while the
+ * daemon is updating the snapshot, readers retry until they see a stable
+ * even value.
+ */
+typedef struct {
+  volatile uint32_t seq;
+  uint32_t interval;
+  time_t   update_time;
+  ncsi_channel_snapshot_t channel[NCSI_MAX_CHANNEL];
+} ncsi_snapshot_t;
+
+typedef struct ncsi_chan ncsi_chan_t;
+
+/* Open a persistent NC-SI channel over the kernel NCSI netlink family */
+ncsi_chan_t *ncsi_open(const char *ifname);
+
+/* Open a channel to the in-process loopback responder (testing) */
+ncsi_chan_t *ncsi_open_loopback(void);
+
+void ncsi_close(ncsi_chan_t *chan);
+
+/* File descriptor to poll for responses and AENs */
+int ncsi_get_fd(ncsi_chan_t *chan);
+
+/*
+ * Queue a command without waiting for its response. The sequence id used
+ * to match the response is returned in *seq.
+ */
+int ncsi_submit(ncsi_chan_t *chan, uint8_t channel, uint8_t cmd,
+                const uint8_t *payload, uint16_t len, uint32_t *seq);
+
+/* Receive one response or AEN, waiting up to timeout_ms (-1 forever) */
+int ncsi_recv(ncsi_chan_t *chan, ncsi_rsp_t *rsp, int timeout_ms);
+
+/* Send a command and wait for its matching response */
+int ncsi_send_cmd(ncsi_chan_t *chan, uint8_t channel, uint8_t cmd,
+                  const uint8_t *payload, uint16_t len, ncsi_rsp_t *rsp);
+
+/*
+ * Send a command through ncsid when it is running, or over a private
+ * channel on ifname otherwise.
+ */
+int ncsi_request(const char *ifname, uint8_t channel, uint8_t cmd,
+                 const uint8_t *payload, uint16_t len, ncsi_rsp_t *rsp);
+
+/* Decoders for the responses used by the snapshot */
+int ncsi_parse_link_status(const ncsi_rsp_t *rsp, ncsi_link_status_t *link);
+int ncsi_parse_pkt_stats(const ncsi_rsp_t *rsp, ncsi_pkt_stats_t *stats);
+int ncsi_parse_aen(const ncsi_rsp_t *rsp, uint8_t *aen_type, ncsi_link_status_t *link);
+
+/* Shared memory snapshot, written by ncsid and read without NC-SI traffic */
+ncsi_snapshot_t *ncsi_snapshot_map(bool writer);
+void ncsi_snapshot_unmap(ncsi_snapshot_t *snap);
+void ncsi_snapshot_begin(ncsi_snapshot_t *snap);
+void ncsi_snapshot_end(ncsi_snapshot_t *snap);
+int ncsi_snapshot_read(ncsi_snapshot_t *out);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* __NCSI_H__ */
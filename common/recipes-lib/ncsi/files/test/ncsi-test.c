@@ -0,0 +1,262 @@
+/*
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * libncsi test against the loopback NC-SI responder.
+ *
+ *   ncsi-test [<ncsid>]
+ *
+ * Given the path of an ncsid binary, also runs "ncsid --loopback" and
+ * checks commands sent through it and the snapshot it publishes.
+ * Must not run on a BMC where ncsid is in service, it takes over the
+ * ncsid socket and snapshot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "ncsi.h"
+
+static int failures = 0;
+
+static void
+check(bool passed, const char *what) {
+  printf("%-48s %s\n", what, passed ? "PASSED" : "FAILED");
+  if (!passed)
+    failures++;
+}
+
+static long
+elapsed_ms(struct timespec *from) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - from->tv_sec) * 1000 + (now.tv_nsec - from->tv_nsec) / 1000000;
+}
+
+static void
+test_commands(ncsi_chan_t *chan) {
+  ncsi_link_status_t link;
+  ncsi_pkt_stats_t stats;
+  uint64_t rx_bytes;
+  uint8_t payload[NCSI_MAX_PAYLOAD + 1] = {0};
+  struct timespec start;
+  ncsi_rsp_t rsp;
+
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 0), NCSI_CMD_GET_LINK_STATUS, NULL, 0, &rsp) == 0 &&
+        ncsi_parse_link_status(&rsp, &link) == 0 && (link.link_status & 0x1),
+        "get link status");
+
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 1), NCSI_CMD_GET_CTRL_PKT_STATS, NULL, 0, &rsp) == 0 &&
+        ncsi_parse_pkt_stats(&rsp, &stats) == 0 && stats.rx_bytes > 0 &&
+        stats.rx_ucast == stats.tx_ucast, "get packet statistics");
+  rx_bytes = stats.rx_bytes;
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 1), NCSI_CMD_GET_CTRL_PKT_STATS, NULL, 0, &rsp) == 0 &&
+        ncsi_parse_pkt_stats(&rsp, &stats) == 0 && stats.rx_bytes > rx_bytes,
+        "packet statistics advance");
+
+  // The wrong response type is not decoded
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 0), NCSI_CMD_GET_VERSION_ID, NULL, 0, &rsp) == 0 &&
+        ncsi_parse_link_status(&rsp, &link) != 0 && ncsi_parse_pkt_stats(&rsp, &stats) != 0,
+        "mismatched response rejected");
+
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 0), NCSI_CMD_OEM, payload, 4, &rsp) == 0 &&
+        rsp.resp_code == NCSI_RESP_UNSUPPORTED, "OEM command unsupported");
+
+  check(ncsi_submit(chan, NCSI_CHANNEL(0, 0), NCSI_CMD_OEM, payload, sizeof(payload), NULL) != 0,
+        "oversized payload rejected");
+
+  // No such package: nothing answers and the command times out
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(1, 0), NCSI_CMD_GET_LINK_STATUS, NULL, 0, &rsp) != 0 &&
+        elapsed_ms(&start) >= NCSI_TIMEOUT_MS - 10, "missing package times out");
+}
+
+static void
+test_pipelined(ncsi_chan_t *chan) {
+  uint8_t cmds[] = {NCSI_CMD_GET_LINK_STATUS, NCSI_CMD_GET_CTRL_PKT_STATS,
+                    NCSI_CMD_GET_VERSION_ID, NCSI_CMD_GET_LINK_STATUS};
+  uint32_t seq[sizeof(cmds)];
+  bool seen[sizeof(cmds)] = {false};
+  bool passed = true;
+  ncsi_rsp_t rsp;
+  size_t i, j;
+
+  for (i = 0; i < sizeof(cmds); i++)
+    passed = passed && ncsi_submit(chan, NCSI_CHANNEL(0, i), cmds[i], NULL, 0, &seq[i]) == 0;
+
+  for (i = 0; passed && i < sizeof(cmds); i++) {
+    passed = ncsi_recv(chan, &rsp, NCSI_TIMEOUT_MS) == 0;
+    for (j = 0; passed && j < sizeof(cmds); j++) {
+      if (rsp.seq == seq[j])
+        break;
+    }
+    passed = passed && j < sizeof(cmds) && !seen[j] &&
+             rsp.type == (cmds[j] | NCSI_RSP_FLAG) &&
+             rsp.channel == NCSI_CHANNEL(0, j);
+    if (passed)
+      seen[j] = true;
+  }
+  check(passed, "pipelined commands matched by sequence id");
+}
+
+static void
+test_aen(ncsi_chan_t *chan) {
+  uint8_t payload[8] = {0, 0, 0, 0, 0, 0, 0, 0x07};
+  ncsi_link_status_t link;
+  ncsi_rsp_t rsp;
+  uint8_t type = 0xFF;
+
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 2), NCSI_CMD_AEN_ENABLE, payload, 8, &rsp) == 0 &&
+        rsp.resp_code == NCSI_RESP_COMPLETED, "AEN enable");
+  check(ncsi_recv(chan, &rsp, NCSI_TIMEOUT_MS) == 0 && rsp.type == NCSI_PKT_AEN &&
+        rsp.seq == 0 && NCSI_CHANNEL_ID(rsp.channel) == 2 &&
+        ncsi_parse_aen(&rsp, &type, &link) == 0 &&
+        type == NCSI_AEN_LINK_STATUS_CHANGE && (link.link_status & 0x1),
+        "link status AEN");
+
+  // A command waiting for its response skips AENs and stale responses
+  ncsi_submit(chan, NCSI_CHANNEL(0, 2), NCSI_CMD_AEN_ENABLE, payload, 8, NULL);
+  check(ncsi_send_cmd(chan, NCSI_CHANNEL(0, 3), NCSI_CMD_GET_LINK_STATUS, NULL, 0, &rsp) == 0 &&
+        rsp.type == (NCSI_CMD_GET_LINK_STATUS | NCSI_RSP_FLAG) &&
+        NCSI_CHANNEL_ID(rsp.channel) == 3, "AEN skipped by send_cmd");
+}
+
+static void
+test_snapshot(void) {
+  ncsi_snapshot_t *snap;
+  ncsi_snapshot_t copy;
+
+  snap = ncsi_snapshot_map(true);
+  check(snap != NULL, "snapshot map");
+  if (snap == NULL)
+    return;
+
+  ncsi_snapshot_begin(snap);
+  memset(snap->channel, 0, sizeof(snap->channel));
+  snap->interval = 7;
+  snap->channel[1].present = true;
+  snap->channel[1].stats.rx_bytes = 12345;
+  // A reader gives up while the writer is in the middle of an update
+  check(ncsi_snapshot_read(&copy) != 0, "snapshot busy while updated");
+  ncsi_snapshot_end(snap);
+
+  check(ncsi_snapshot_read(&copy) == 0 && copy.interval == 7 && copy.channel[1].present &&
+        copy.channel[1].stats.rx_bytes == 12345 && !copy.channel[0].present,
+        "snapshot read");
+  ncsi_snapshot_unmap(snap);
+}
+
+static pid_t
+start_ncsid(const char *path, bool aen) {
+  pid_t pid;
+  int i;
+
+  unlink(SOCK_PATH_NCSID);
+  pid = fork();
+  if (pid == 0) {
+    if (aen)
+      execl(path, path, "--loopback", "--aen", "-c", "2", "-t", "1", NULL);
+    else
+      execl(path, path, "--loopback", "-c", "2", "-t", "1", NULL);
+    _exit(127);
+  }
+
+  for (i = 0; pid > 0 && i < 100; i++) {
+    if (access(SOCK_PATH_NCSID, F_OK) == 0)
+      return pid;
+    usleep(20 * 1000);
+  }
+  return -1;
+}
+
+static void
+stop_ncsid(pid_t pid) {
+  int status;
+
+  kill(pid, SIGTERM);
+  check(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+        access(SOCK_PATH_NCSID, F_OK) != 0, "ncsid exits cleanly");
+}
+
+static void
+test_ncsid(const char *path) {
+  ncsi_link_status_t link;
+  ncsi_snapshot_t snap;
+  ncsi_rsp_t rsp;
+  pid_t pid;
+
+  pid = start_ncsid(path, true);
+  check(pid > 0, "ncsid --loopback --aen starts");
+  if (pid <= 0)
+    return;
+
+  check(ncsi_request(NULL, NCSI_CHANNEL(0, 1), NCSI_CMD_GET_LINK_STATUS, NULL, 0, &rsp) == 0 &&
+        ncsi_parse_link_status(&rsp, &link) == 0, "request through ncsid");
+  check(ncsi_request(NULL, NCSI_CHANNEL(0, 0), NCSI_CMD_OEM, NULL, 0, &rsp) == 0 &&
+        rsp.resp_code == NCSI_RESP_UNSUPPORTED, "OEM request through ncsid");
+  check(ncsi_request(NULL, NCSI_CHANNEL(1, 0), NCSI_CMD_GET_LINK_STATUS, NULL, 0, &rsp) != 0,
+        "timed out request through ncsid");
+
+  // Two polling periods
+  sleep(2);
+  check(ncsi_snapshot_read(&snap) == 0 && snap.interval == 1 &&
+        snap.channel[0].present && snap.channel[1].present && !snap.channel[2].present &&
+        (snap.channel[1].link.link_status & 0x1) && snap.channel[1].stats.rx_bytes > 0 &&
+        snap.channel[0].aen_count == 1 && snap.channel[1].aen_count == 1 &&
+        snap.channel[0].err_count == 0, "snapshot published, AENs counted");
+  stop_ncsid(pid);
+
+  // AENs are left to the kernel driver unless asked for
+  pid = start_ncsid(path, false);
+  check(pid > 0, "ncsid --loopback starts");
+  if (pid <= 0)
+    return;
+  sleep(1);
+  check(ncsi_snapshot_read(&snap) == 0 && snap.channel[0].present &&
+        snap.channel[0].aen_count == 0 && snap.channel[1].aen_count == 0,
+        "no AENs enabled by default");
+  stop_ncsid(pid);
+}
+
+int
+main(int argc, char **argv) {
+  ncsi_chan_t *chan;
+
+  printf("Testing against the loopback responder\n");
+  chan = ncsi_open_loopback();
+  check(chan != NULL, "open loopback channel");
+  if (chan != NULL) {
+    test_commands(chan);
+    test_pipelined(chan);
+    test_aen(chan);
+    ncsi_close(chan);
+  }
+  test_snapshot();
+
+  if (argc > 1)
+    test_ncsid(argv[1]);
+
+  printf("NC-SI: %s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
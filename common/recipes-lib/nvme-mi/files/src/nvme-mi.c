@@ -18,6 +18,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <syslog.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -37,6 +41,18 @@
 #define NVME_SERIAL_NUM_REG 0x0B
 #define SERIAL_NUM_SIZE 20
 
+/* NVMe-MI Basic Management Command data structures, including the PEC byte */
+#define NVME_STATUS_CMD 0x00
+#define NVME_STATUS_LEN 8
+#define NVME_VPD_CMD 0x08
+#define NVME_VPD_LEN 24
+
+#define NVME_RETRY_MAX 5
+#define NVME_RETRY_DELAY_MS 10
+
+#define NVME_MAX_BUS 16
+#define NVME_MAX_CACHE 64
+
 /* NVMe-MI Temperature Definition Code */
 #define TEMP_HIGHER_THAN_127 0x7F
 #define TEPM_LOWER_THAN_n60 0xC4
@@ -53,6 +69,25 @@
 #define VENDOR_ID_SEAGATE 0x1BB1
 #define VENDOR_ID_TOSHIBA 0x1179
 
+typedef struct {
+  char path[32];
+  int fd;
+} nvme_bus_t;
+
+typedef struct {
+  bool valid;
+  char path[32];
+  int drive;
+  uint64_t read_time;
+  ssd_data data;
+} nvme_cache_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvme_bus_t g_bus[NVME_MAX_BUS] = {
+  [0 ... NVME_MAX_BUS-1] = {.path = "", .fd = -1},
+};
+static nvme_cache_t g_cache[NVME_MAX_CACHE];
+
 // Helper function for msleep
 void
 msleep(int msec) {
@@ -66,96 +101,430 @@ msleep(int msec) {
   }
 }
 
-/* Read a byte from NVMe-MI 0x6A. Need to give a bus and a byte address for reading. */
-int
-nvme_read_byte(const char *i2c_bus_device, uint8_t item, uint8_t *value) {
-  int dev;
-  int ret;
-  int32_t res;
-  int retry = 0;
+/* Keep the bus device open across calls; reopened on the next call after an error */
+static int
+nvme_bus_get(const char *i2c_bus_device) {
+  int i, fd;
+  int slot = -1;
+
+  for (i = 0; i < NVME_MAX_BUS; i++) {
+    if (g_bus[i].fd >= 0) {
+      if (!strcmp(g_bus[i].path, i2c_bus_device))
+        return g_bus[i].fd;
+    } else if (slot < 0) {
+      slot = i;
+    }
+  }
 
-  dev = open(i2c_bus_device, O_RDWR);
-  if (dev < 0) {
+  fd = open(i2c_bus_device, O_RDWR);
+  if (fd < 0) {
     syslog(LOG_DEBUG, "%s(): open() failed", __func__);
     return -1;
   }
 
-  ret = ioctl(dev, I2C_SLAVE, I2C_NVME_INTF_ADDR);
-  if (ret < 0) {
+  if (ioctl(fd, I2C_SLAVE, I2C_NVME_INTF_ADDR) < 0) {
     syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
+    close(fd);
     return -1;
   }
 
-  res = i2c_smbus_read_byte_data(dev, item);
-  retry = 0;
-  while ((retry < 5) && (res < 0)) {
-    msleep(100);
-    res = i2c_smbus_read_byte_data(dev, item);
-    if (res < 0)
-      retry++;
+  // Table is full, recycle the first entry
+  if (slot < 0) {
+    close(g_bus[0].fd);
+    slot = 0;
+  }
+  snprintf(g_bus[slot].path, sizeof(g_bus[slot].path), "%s", i2c_bus_device);
+  g_bus[slot].fd = fd;
+
+  return fd;
+}
+
+static void
+nvme_bus_drop(int fd) {
+  int i;
+
+  for (i = 0; i < NVME_MAX_BUS; i++) {
+    if (g_bus[i].fd == fd) {
+      close(fd);
+      g_bus[i].fd = -1;
+      g_bus[i].path[0] = '\0';
+      return;
+    }
+  }
+}
+
+/* Close all the bus devices kept open by the library */
+void
+nvme_mi_close(void) {
+  int i;
+
+  pthread_mutex_lock(&g_lock);
+  for (i = 0; i < NVME_MAX_BUS; i++) {
+    if (g_bus[i].fd >= 0) {
+      close(g_bus[i].fd);
+      g_bus[i].fd = -1;
+      g_bus[i].path[0] = '\0';
+    }
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+/* SMBus PEC, CRC-8 with polynomial x^8 + x^2 + x + 1 */
+static uint8_t
+nvme_pec(uint8_t crc, const uint8_t *buf, int len) {
+  int i, j;
+
+  for (i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+
+  return crc;
+}
+
+/* Verify the PEC trailing a basic management data structure read at cmd */
+static bool
+nvme_pec_ok(uint8_t cmd, const uint8_t *buf, int len) {
+  uint8_t hdr[3] = {I2C_NVME_INTF_ADDR << 1, cmd, (I2C_NVME_INTF_ADDR << 1) | 1};
+  uint8_t crc;
+
+  crc = nvme_pec(0, hdr, sizeof(hdr));
+  crc = nvme_pec(crc, buf, len);
+
+  return crc == buf[len];
+}
+
+/*
+ * Read rlen bytes of the basic management data starting at offset cmd,
+ * as one I2C write-read transaction on the persistent bus handle.
+ */
+static int
+nvme_block_read(const char *i2c_bus_device, uint8_t cmd, uint8_t *buf, uint8_t rlen) {
+  int fd;
+  int ret = -1;
+  int err = 0;
+  int retry;
+
+  pthread_mutex_lock(&g_lock);
+  for (retry = 0; retry <= NVME_RETRY_MAX; retry++) {
+    if (retry)
+      msleep(NVME_RETRY_DELAY_MS << (retry - 1));
+
+    fd = nvme_bus_get(i2c_bus_device);
+    if (fd < 0)
+      continue;
+
+    ret = i2c_rdwr_msg_transfer(fd, I2C_NVME_INTF_ADDR << 1, &cmd, 1, buf, rlen);
+    if (ret == 0)
+      break;
+    // The adapter only does SMBus transfers, retrying does not help
+    err = errno;
+    if (err == EOPNOTSUPP)
+      break;
+  }
+  if (ret < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_rdwr_msg_transfer failed", __func__);
+    if (fd >= 0 && err != EOPNOTSUPP)
+      nvme_bus_drop(fd);
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  return ret;
+}
+
+static int
+nvme_smbus_read(const char *i2c_bus_device, uint8_t item, int size) {
+  int fd = -1;
+  int32_t res = -1;
+  int retry;
+
+  pthread_mutex_lock(&g_lock);
+  for (retry = 0; retry <= NVME_RETRY_MAX; retry++) {
+    if (retry)
+      msleep(NVME_RETRY_DELAY_MS << (retry - 1));
+
+    fd = nvme_bus_get(i2c_bus_device);
+    if (fd < 0)
+      continue;
+
+    if (size == I2C_SMBUS_WORD_DATA)
+      res = i2c_smbus_read_word_data(fd, item);
     else
+      res = i2c_smbus_read_byte_data(fd, item);
+    if (res >= 0)
       break;
   }
+  if (res < 0 && fd >= 0)
+    nvme_bus_drop(fd);
+  pthread_mutex_unlock(&g_lock);
 
+  return res;
+}
+
+/* Read a byte from NVMe-MI 0x6A. Need to give a bus and a byte address for reading. */
+int
+nvme_read_byte(const char *i2c_bus_device, uint8_t item, uint8_t *value) {
+  int32_t res;
+
+  res = nvme_smbus_read(i2c_bus_device, item, I2C_SMBUS_BYTE_DATA);
   if (res < 0) {
     syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
-    close(dev);
     return -1;
   }
 
   *value = (uint8_t) res;
 
-  close(dev);
-
   return 0;
 }
 
 /* Read a word from NVMe-MI 0x6A. Need to give a bus and a byte address for reading. */
 int
 nvme_read_word(const char *i2c_bus_device, uint8_t item, uint16_t *value) {
-  int dev;
-  int ret;
   int32_t res;
-  int retry = 0;
 
-  dev = open(i2c_bus_device, O_RDWR);
-  if (dev < 0) {
-    syslog(LOG_DEBUG, "%s(): open() failed", __func__);
+  res = nvme_smbus_read(i2c_bus_device, item, I2C_SMBUS_WORD_DATA);
+  if (res < 0) {
+    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_word_data failed", __func__);
     return -1;
   }
 
-  ret = ioctl(dev, I2C_SLAVE, I2C_NVME_INTF_ADDR);
-  if (ret < 0) {
-    syslog(LOG_DEBUG, "%s(): ioctl() assigning i2c addr failed", __func__);
-    close(dev);
+  *value = (uint16_t) res;
+
+  return 0;
+}
+
+static void
+nvme_parse_status(const uint8_t *buf, ssd_data *data) {
+  data->sflgs = buf[NVME_SFLGS_REG];
+  data->warning = buf[NVME_WARNING_REG];
+  data->temp = buf[NVME_TEMP_REG];
+  data->pdlu = buf[NVME_PDLU_REG];
+}
+
+static void
+nvme_parse_vpd(const uint8_t *buf, ssd_data *data) {
+  data->vendor = (buf[NVME_VENDOR_REG - NVME_VPD_CMD] << 8) |
+                 buf[NVME_VENDOR_REG - NVME_VPD_CMD + 1];
+  memcpy(data->serial_num, &buf[NVME_SERIAL_NUM_REG - NVME_VPD_CMD], SERIAL_NUM_SIZE);
+}
+
+/* Read the status data structure (cmd 0) with a single block read */
+static int
+nvme_status_block_read(const char *i2c_bus_device, ssd_data *data) {
+  uint8_t buf[NVME_STATUS_LEN];
+
+  if (nvme_block_read(i2c_bus_device, NVME_STATUS_CMD, buf, sizeof(buf)))
+    return -1;
+  if (!nvme_pec_ok(NVME_STATUS_CMD, buf, NVME_STATUS_LEN - 1)) {
+    syslog(LOG_DEBUG, "%s(): PEC mismatch", __func__);
     return -1;
   }
+  nvme_parse_status(buf, data);
 
-  res = i2c_smbus_read_word_data(dev, item);
-  retry = 0;
-  while ((retry < 5) && (res < 0)) {
-    msleep(100);
-    res = i2c_smbus_read_word_data(dev, item);
-    if (res < 0)
-      retry++;
-    else
-      break;
+  return 0;
+}
+
+/* Read the vendor data structure (cmd 8) with a single block read */
+static int
+nvme_vpd_block_read(const char *i2c_bus_device, ssd_data *data) {
+  uint8_t buf[NVME_VPD_LEN];
+
+  if (nvme_block_read(i2c_bus_device, NVME_VPD_CMD, buf, sizeof(buf)))
+    return -1;
+  if (!nvme_pec_ok(NVME_VPD_CMD, buf, NVME_VPD_LEN - 1)) {
+    syslog(LOG_DEBUG, "%s(): PEC mismatch", __func__);
+    return -1;
   }
+  nvme_parse_vpd(buf, data);
 
-  if (res < 0) {
-    syslog(LOG_DEBUG, "%s(): i2c_smbus_read_byte_data failed", __func__);
-    close(dev);
+  return 0;
+}
+
+/* Read the status data structure per register, for drives without block read */
+static int
+nvme_status_byte_read(const char *i2c_bus_device, ssd_data *data) {
+  if (nvme_read_byte(i2c_bus_device, NVME_SFLGS_REG, &data->sflgs) ||
+      nvme_read_byte(i2c_bus_device, NVME_WARNING_REG, &data->warning) ||
+      nvme_read_byte(i2c_bus_device, NVME_TEMP_REG, &data->temp) ||
+      nvme_read_byte(i2c_bus_device, NVME_PDLU_REG, &data->pdlu))
+    return -1;
+
+  return 0;
+}
+
+/* Read the vendor ID register, the word read returns it byte swapped */
+static int
+nvme_vendor_word_read(const char *i2c_bus_device, uint16_t *value) {
+  if (nvme_read_word(i2c_bus_device, NVME_VENDOR_REG, value))
+    return -1;
+
+  *value = (*value & 0xFF00) >> 8 | (*value & 0xFF) << 8;
+
+  return 0;
+}
+
+/* Read the serial number one byte register at a time */
+static int
+nvme_serial_num_byte_read(const char *i2c_bus_device, uint8_t *value) {
+  int count;
+
+  for (count = 0; count < SERIAL_NUM_SIZE; count++) {
+    if (nvme_read_byte(i2c_bus_device, NVME_SERIAL_NUM_REG + count, value + count))
+      return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Read a data structure with a block read, falling back to SMBus byte and
+ * word reads when the drive has no block read support or the PEC does not
+ * match.
+ */
+static int
+nvme_status_read(const char *i2c_bus_device, ssd_data *data) {
+  if (nvme_status_block_read(i2c_bus_device, data) == 0)
+    return 0;
+
+  return nvme_status_byte_read(i2c_bus_device, data);
+}
+
+static int
+nvme_vpd_read(const char *i2c_bus_device, ssd_data *data) {
+  if (nvme_vpd_block_read(i2c_bus_device, data) == 0)
+    return 0;
+
+  if (nvme_vendor_word_read(i2c_bus_device, &data->vendor))
+    return -1;
+
+  return nvme_serial_num_byte_read(i2c_bus_device, data->serial_num);
+}
+
+/*
+ * Read the whole NVMe-MI basic management area (status and vendor data
+ * structures) in one 32-byte read from offset 0. A structure that fails
+ * its PEC is read again on its own; a drive that rejects the block read
+ * is read per register.
+ */
+int
+nvme_mi_basic_read(const char *i2c_bus_device, ssd_data *data) {
+  uint8_t buf[NVME_STATUS_LEN + NVME_VPD_LEN];
+
+  if ((i2c_bus_device == NULL) || (data == NULL)) {
+    syslog(LOG_ERR, "%s(): invalid parameter (null)", __func__);
     return -1;
   }
 
-  *value = (uint16_t) res;
+  if (nvme_block_read(i2c_bus_device, NVME_STATUS_CMD, buf, sizeof(buf))) {
+    if (nvme_status_byte_read(i2c_bus_device, data))
+      return -1;
+    return nvme_vpd_read(i2c_bus_device, data);
+  }
 
-  close(dev);
+  if (!nvme_pec_ok(NVME_STATUS_CMD, buf, NVME_STATUS_LEN - 1)) {
+    // A corrupted transfer, retry the structures separately
+    if (nvme_status_read(i2c_bus_device, data))
+      return -1;
+  } else {
+    nvme_parse_status(buf, data);
+  }
+
+  if (!nvme_pec_ok(NVME_VPD_CMD, &buf[NVME_VPD_CMD], NVME_VPD_LEN - 1))
+    return nvme_vpd_read(i2c_bus_device, data);
 
+  nvme_parse_vpd(&buf[NVME_VPD_CMD], data);
   return 0;
 }
 
+static uint64_t
+nvme_time_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Same as nvme_mi_basic_read(), but serve the data from a per-drive cache
+ * when it is at most max_age_ms old. drive distinguishes the drives that
+ * share one bus device behind a mux; the caller selects the mux channel.
+ */
+int
+nvme_mi_basic_read_cached(const char *i2c_bus_device, int drive, int max_age_ms, ssd_data *data) {
+  nvme_cache_t *entry = NULL;
+  uint64_t now = nvme_time_ms();
+  int i, ret;
+
+  if ((i2c_bus_device == NULL) || (data == NULL)) {
+    syslog(LOG_ERR, "%s(): invalid parameter (null)", __func__);
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_lock);
+  for (i = 0; i < NVME_MAX_CACHE; i++) {
+    if (g_cache[i].valid && (g_cache[i].drive == drive) &&
+        !strcmp(g_cache[i].path, i2c_bus_device)) {
+      entry = &g_cache[i];
+      break;
+    }
+  }
+  if (entry && (max_age_ms > 0) && (now - entry->read_time <= (uint64_t)max_age_ms)) {
+    memcpy(data, &entry->data, sizeof(ssd_data));
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  ret = nvme_mi_basic_read(i2c_bus_device, data);
+
+  pthread_mutex_lock(&g_lock);
+  if (!entry) {
+    for (i = 0; i < NVME_MAX_CACHE; i++) {
+      if (!g_cache[i].valid || (g_cache[i].drive == drive &&
+          !strcmp(g_cache[i].path, i2c_bus_device))) {
+        entry = &g_cache[i];
+        break;
+      }
+    }
+    // Cache is full, evict the oldest entry
+    if (!entry) {
+      entry = &g_cache[0];
+      for (i = 1; i < NVME_MAX_CACHE; i++) {
+        if (g_cache[i].read_time < entry->read_time)
+          entry = &g_cache[i];
+      }
+    }
+  }
+  if (ret == 0) {
+    snprintf(entry->path, sizeof(entry->path), "%s", i2c_bus_device);
+    entry->drive = drive;
+    entry->read_time = now;
+    memcpy(&entry->data, data, sizeof(ssd_data));
+    entry->valid = true;
+  } else if (entry->valid && entry->drive == drive &&
+             !strcmp(entry->path, i2c_bus_device)) {
+    entry->valid = false;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  return ret;
+}
+
+/* Drop the cached data of a drive, e.g. on hot-plug. drive < 0 drops the whole bus */
+void
+nvme_mi_cache_invalidate(const char *i2c_bus_device, int drive) {
+  int i;
+
+  pthread_mutex_lock(&g_lock);
+  for (i = 0; i < NVME_MAX_CACHE; i++) {
+    if (g_cache[i].valid && !strcmp(g_cache[i].path, i2c_bus_device) &&
+        (drive < 0 || g_cache[i].drive == drive))
+      g_cache[i].valid = false;
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
 /* Read NVMe-MI Status Flags. Need to give a bus for reading. */
 int
 nvme_sflgs_read(const char *i2c_bus_device, uint8_t *value) {
@@ -219,42 +588,88 @@ nvme_pdlu_read(const char *i2c_bus_device, uint8_t *value) {
 /* Read NVMe-MI Vendor ID. Need to give a bus for reading. */
 int
 nvme_vendor_read(const char *i2c_bus_device, uint16_t *value) {
-  int ret;
+  ssd_data data;
 
-  ret = nvme_read_word(i2c_bus_device, NVME_VENDOR_REG, value);
+  if (nvme_vpd_block_read(i2c_bus_device, &data) == 0) {
+    *value = data.vendor;
+    return 0;
+  }
 
-  if(ret < 0) {
-    syslog(LOG_DEBUG, "%s(): nvme_read_byte failed", __func__);
+  if (nvme_vendor_word_read(i2c_bus_device, value)) {
+    syslog(LOG_DEBUG, "%s(): nvme_read_word failed", __func__);
     return -1;
   }
 
-  *value = (*value & 0xFF00) >> 8 | (*value & 0xFF) << 8;
-
   return 0;
 }
 
 /* Read NVMe-MI Serial Number. Need to give a bus for reading. */
 int
 nvme_serial_num_read(const char *i2c_bus_device, uint8_t *value, int size) {
-  int ret;
-  uint8_t reg = NVME_SERIAL_NUM_REG;
-  int count;
+  ssd_data data;
 
   if(size != SERIAL_NUM_SIZE) {
     syslog(LOG_DEBUG, "%s(): the array size is wrong", __func__);
     return -1;
   }
 
-  for(count = 0; count < SERIAL_NUM_SIZE; count++) {
-    ret = nvme_read_byte(i2c_bus_device, reg + count, value + count);
-    if(ret < 0) {
-      syslog(LOG_DEBUG, "%s(): nvme_read_byte failed", __func__);
-      return -1;
-    }
+  if (nvme_vpd_block_read(i2c_bus_device, &data) == 0) {
+    memcpy(value, data.serial_num, SERIAL_NUM_SIZE);
+    return 0;
+  }
+
+  if (nvme_serial_num_byte_read(i2c_bus_device, value)) {
+    syslog(LOG_DEBUG, "%s(): nvme_read_byte failed", __func__);
+    return -1;
   }
+
   return 0;
 }
 
+/* Decode NVMe-MI Status Flags. */
+void
+nvme_sflgs_decode(uint8_t value, t_status_flags *status_flag_decoding) {
+
+  sprintf(status_flag_decoding->self.key, "Status Flags");
+  sprintf(status_flag_decoding->self.value, "0x%02X", value);
+
+  sprintf(status_flag_decoding->read_complete.key, "SMBUS block read complete");
+  if ((value & 0x80) == 0)
+    sprintf(status_flag_decoding->read_complete.value, "FAIL");
+  else
+    sprintf(status_flag_decoding->read_complete.value, "OK");
+
+  sprintf(status_flag_decoding->ready.key, "Drive Ready");
+  if ((value & 0x40) == 0)
+    sprintf(status_flag_decoding->ready.value, "Ready");
+  else
+    sprintf(status_flag_decoding->ready.value, "Not ready");
+
+  sprintf(status_flag_decoding->functional.key, "Drive Functional");
+  if ((value & 0x20) == 0)
+    sprintf(status_flag_decoding->functional.value, "Unrecoverable Failure");
+  else
+    sprintf(status_flag_decoding->functional.value, "Functional");
+
+  sprintf(status_flag_decoding->reset_required.key, "Reset Required");
+  if ((value & 0x10) == 0)
+    sprintf(status_flag_decoding->reset_required.value, "Required");
+  else
+    sprintf(status_flag_decoding->reset_required.value, "No");
+
+  sprintf(status_flag_decoding->port0_link.key, "Port 0 PCIe Link Active");
+  if ((value & 0x08) == 0)
+    sprintf(status_flag_decoding->port0_link.value, "Down");
+  else
+    sprintf(status_flag_decoding->port0_link.value, "Up");
+
+  sprintf(status_flag_decoding->port1_link.key, "Port 1 PCIe Link Active");
+  if ((value & 0x04) == 0)
+    sprintf(status_flag_decoding->port1_link.value, "Down");
+  else
+    sprintf(status_flag_decoding->port1_link.value, "Up");
+}
+
 /* Read NVMe-MI Status Flags and decode it. */
 int
 nvme_sflgs_read_decode(const char *i2c_bus_device, uint8_t *value, t_status_flags *status_flag_decoding) {
@@ -270,47 +685,48 @@ nvme_sflgs_read_decode(const char *i2c_bus_device, uint8_t *value, t_status_flag
     sprintf(status_flag_decoding->self.value, "Fail on reading");
     return -1;
   }
-  else {
-    sprintf(status_flag_decoding->self.value, "0x%02X", *value);
+  else
+    nvme_sflgs_decode(*value, status_flag_decoding);
 
-    sprintf(status_flag_decoding->read_complete.key, "SMBUS block read complete");
-    if ((*value & 0x80) == 0)
-      sprintf(status_flag_decoding->read_complete.value, "FAIL");
-    else
-      sprintf(status_flag_decoding->read_complete.value, "OK");
+  return 0;
+}
 
-    sprintf(status_flag_decoding->ready.key, "Drive Ready");
-    if ((*value & 0x40) == 0)
-      sprintf(status_flag_decoding->ready.value, "Ready");
-    else
-      sprintf(status_flag_decoding->ready.value, "Not ready");
+/* Decode NVMe-MI SMART Warnings. */
+void
+nvme_smart_warning_decode(uint8_t value, t_smart_warning *smart_warning_decoding) {
 
-    sprintf(status_flag_decoding->functional.key, "Drive Functional");
-    if ((*value & 0x20) == 0)
-      sprintf(status_flag_decoding->functional.value, "Unrecoverable Failure");
-    else
-      sprintf(status_flag_decoding->functional.value, "Functional");
+  sprintf(smart_warning_decoding->self.key, "SMART Critical Warning");
+  sprintf(smart_warning_decoding->self.value, "0x%02X", value);
 
-    sprintf(status_flag_decoding->reset_required.key, "Reset Required");
-    if ((*value & 0x10) == 0)
-      sprintf(status_flag_decoding->reset_required.value, "Required");
-    else
-      sprintf(status_flag_decoding->reset_required.value, "No");
+  sprintf(smart_warning_decoding->spare_space.key, "Spare Space");
+  if ((value & 0x01) == 0)
+    sprintf(smart_warning_decoding->spare_space.value, "Low");
+  else
+    sprintf(smart_warning_decoding->spare_space.value, "Normal");
 
-    sprintf(status_flag_decoding->port0_link.key, "Port 0 PCIe Link Active");
-    if ((*value & 0x08) == 0)
-      sprintf(status_flag_decoding->port0_link.value, "Down");
-    else
-      sprintf(status_flag_decoding->port0_link.value, "Up");
+  sprintf(smart_warning_decoding->temp_warning.key, "Temperature Warning");
+  if ((value & 0x02) == 0)
+    sprintf(smart_warning_decoding->temp_warning.value, "Abnormal");
+  else
+    sprintf(smart_warning_decoding->temp_warning.value, "Normal");
 
-    sprintf(status_flag_decoding->port1_link.key, "Port 1 PCIe Link Active");
-    if ((*value & 0x04) == 0)
-      sprintf(status_flag_decoding->port1_link.value, "Down");
-    else
-      sprintf(status_flag_decoding->port1_link.value, "Up");
-  }
+  sprintf(smart_warning_decoding->reliability.key, "NVM Subsystem Reliability");
+  if ((value & 0x04) == 0)
+    sprintf(smart_warning_decoding->reliability.value, "Degraded");
+  else
+    sprintf(smart_warning_decoding->reliability.value, "Normal");
 
-  return 0;
+  sprintf(smart_warning_decoding->media_status.key, "Media Status");
+  if ((value & 0x08) == 0)
+    sprintf(smart_warning_decoding->media_status.value, "Read Only mode");
+  else
+    sprintf(smart_warning_decoding->media_status.value, "Normal");
+
+  sprintf(smart_warning_decoding->backup_device.key, "Volatile Memory Backup Device");
+  if ((value & 0x10) == 0)
+    sprintf(smart_warning_decoding->backup_device.value, "Failed");
+  else
+    sprintf(smart_warning_decoding->backup_device.value, "Normal");
 }
 
 /* Read NVMe-MI SMART Warnings and decode it. */
@@ -328,41 +744,25 @@ nvme_smart_warning_read_decode(const char *i2c_bus_device, uint8_t *value, t_sma
     sprintf(smart_warning_decoding->self.value, "Fail on reading");
     return -1;
   }
-  else {
-    sprintf(smart_warning_decoding->self.value, "0x%02X", *value);
-
-    sprintf(smart_warning_decoding->spare_space.key, "Spare Space");
-    if ((*value & 0x01) == 0)
-      sprintf(smart_warning_decoding->spare_space.value, "Low");
-    else
-      sprintf(smart_warning_decoding->spare_space.value, "Normal");
-
-    sprintf(smart_warning_decoding->temp_warning.key, "Temperature Warning");
-    if ((*value & 0x02) == 0)
-      sprintf(smart_warning_decoding->temp_warning.value, "Abnormal");
-    else
-      sprintf(smart_warning_decoding->temp_warning.value, "Normal");
-
-    sprintf(smart_warning_decoding->reliability.key, "NVM Subsystem Reliability");
-    if ((*value & 0x04) == 0)
-      sprintf(smart_warning_decoding->reliability.value, "Degraded");
-    else
-      sprintf(smart_warning_decoding->reliability.value, "Normal");
+  else
+    nvme_smart_warning_decode(*value, smart_warning_decoding);
 
-    sprintf(smart_warning_decoding->media_status.key, "Media Status");
-    if ((*value & 0x08) == 0)
-      sprintf(smart_warning_decoding->media_status.value, "Read Only mode");
-    else
-      sprintf(smart_warning_decoding->media_status.value, "Normal");
+  return 0;
+}
 
-    sprintf(smart_warning_decoding->backup_device.key, "Volatile Memory Backup Device");
-    if ((*value & 0x10) == 0)
-      sprintf(smart_warning_decoding->backup_device.value, "Failed");
-    else
-      sprintf(smart_warning_decoding->backup_device.value, "Normal");
-  }
+/* Decode NVMe-MI Composite Temperature. */
+void
+nvme_temp_decode(uint8_t value, t_key_value_pair *temp_decoding) {
 
-  return 0;
+  sprintf(temp_decoding->key, "Composite Temperature");
+  if (value <= TEMP_HIGHER_THAN_127)
+    sprintf(temp_decoding->value, "%d C", value);
+  else if (value >= TEPM_LOWER_THAN_n60)
+    sprintf(temp_decoding->value, "%d C", (value - 0x100));
+  else if (value == TEMP_NO_UPDATE)
+    sprintf(temp_decoding->value, "No data or data is too old");
+  else if (value == TEMP_SENSOR_FAIL)
+    sprintf(temp_decoding->value, "Sensor failure");
 }
 
 /* Read NVMe-MI Composite Temperature and decode it. */
@@ -380,20 +780,20 @@ nvme_temp_read_decode(const char *i2c_bus_device, uint8_t *value, t_key_value_pa
     sprintf(temp_decoding->value, "Fail on reading");
     return -1;
   }
-  else {
-    if (*value <= TEMP_HIGHER_THAN_127)
-      sprintf(temp_decoding->value, "%d C", *value);
-    else if (*value >= TEPM_LOWER_THAN_n60)
-      sprintf(temp_decoding->value, "%d C", (*value - 0x100));
-    else if (*value == TEMP_NO_UPDATE)
-      sprintf(temp_decoding->value, "No data or data is too old");
-    else if (*value == TEMP_SENSOR_FAIL)
-      sprintf(temp_decoding->value, "Sensor failure");
-  }
+  else
+    nvme_temp_decode(*value, temp_decoding);
 
   return 0;
 }
 
+/* Decode NVMe-MI Percentage Drive Life Used. */
+void
+nvme_pdlu_decode(uint8_t value, t_key_value_pair *pdlu_decoding) {
+
+  sprintf(pdlu_decoding->key, "Percentage Drive Life Used");
+  sprintf(pdlu_decoding->value, "%d", value);
+}
+
 /* Read NVMe-MI Percentage Drive Life Used and decode it. */
 int
 nvme_pdlu_read_decode(const char *i2c_bus_device, uint8_t *value, t_key_value_pair *pdlu_decoding) {
@@ -410,11 +810,46 @@ nvme_pdlu_read_decode(const char *i2c_bus_device, uint8_t *value, t_key_value_pa
     return -1;
   }
   else
-    sprintf(pdlu_decoding->value, "%d", *value);
+    nvme_pdlu_decode(*value, pdlu_decoding);
 
   return 0;
 }
 
+/* Decode NVMe-MI Vendor ID. */
+void
+nvme_vendor_decode(uint16_t value, t_key_value_pair *vendor_decoding) {
+
+  sprintf(vendor_decoding->key, "Vendor");
+  switch (value) {
+  case VENDOR_ID_HGST:
+    sprintf(vendor_decoding->value, "HGST(0x%04X)", value);
+    break;
+  case VENDOR_ID_HYNIX:
+    sprintf(vendor_decoding->value, "Hynix(0x%04X)", value);
+    break;
+  case VENDOR_ID_INTEL:
+    sprintf(vendor_decoding->value, "Intel(0x%04X)", value);
+    break;
+  case VENDOR_ID_LITEON:
+    sprintf(vendor_decoding->value, "Lite-on(0x%04X)", value);
+    break;
+  case VENDOR_ID_MICRON:
+    sprintf(vendor_decoding->value, "Micron(0x%04X)", value);
+    break;
+  case VENDOR_ID_SAMSUNG:
+    sprintf(vendor_decoding->value, "Samsung(0x%04X)", value);
+    break;
+  case VENDOR_ID_SEAGATE:
+    sprintf(vendor_decoding->value, "Seagate(0x%04X)", value);
+    break;
+  case VENDOR_ID_TOSHIBA:
+    sprintf(vendor_decoding->value, "Toshiba(0x%04X)", value);
+    break;
+  default:
+    sprintf(vendor_decoding->value, "Unknown(0x%04X)", value);
+  }
+}
+
 /* Read NVMe-MI Vendor ID and decode it. */
 int
 nvme_vendor_read_decode(const char *i2c_bus_device, uint16_t *value, t_key_value_pair *vendor_decoding) {
@@ -430,40 +865,21 @@ nvme_vendor_read_decode(const char *i2c_bus_device, uint16_t *value, t_key_value
     sprintf(vendor_decoding->value, "Fail on reading");
     return -1;
   }
-  else{
-    switch (*value) {
-    case VENDOR_ID_HGST:
-      sprintf(vendor_decoding->value, "HGST(0x%04X)", *value);
-      break;
-    case VENDOR_ID_HYNIX:
-      sprintf(vendor_decoding->value, "Hynix(0x%04X)", *value);
-      break;
-    case VENDOR_ID_INTEL:
-      sprintf(vendor_decoding->value, "Intel(0x%04X)", *value);
-      break;
-    case VENDOR_ID_LITEON:
-      sprintf(vendor_decoding->value, "Lite-on(0x%04X)", *value);
-      break;
-    case VENDOR_ID_MICRON:
-      sprintf(vendor_decoding->value, "Micron(0x%04X)", *value);
-      break;
-    case VENDOR_ID_SAMSUNG:
-      sprintf(vendor_decoding->value, "Samsung(0x%04X)", *value);
-      break;
-    case VENDOR_ID_SEAGATE:
-      sprintf(vendor_decoding->value, "Seagate(0x%04X)", *value);
-      break;
-    case VENDOR_ID_TOSHIBA:
-      sprintf(vendor_decoding->value, "Toshiba(0x%04X)", *value);
-      break;
-    default:
-      sprintf(vendor_decoding->value, "Unknown(0x%04X)", *value);
-    }
-  }
+  else
+    nvme_vendor_decode(*value, vendor_decoding);
 
   return 0;
 }
 
+/* Decode NVMe-MI Serial Number. */
+void
+nvme_serial_num_decode(const uint8_t *value, t_key_value_pair *sn_decoding) {
+
+  sprintf(sn_decoding->key, "Serial Number");
+  memcpy(sn_decoding->value, value, SERIAL_NUM_SIZE);
+  sn_decoding->value[SERIAL_NUM_SIZE] = '\0';
+}
+
 /* Read NVMe-MI Serial Number and decode it. */
 int
 nvme_serial_num_read_decode(const char *i2c_bus_device, uint8_t *value, int size, t_key_value_pair *sn_decoding) {
@@ -479,10 +895,8 @@ nvme_serial_num_read_decode(const char *i2c_bus_device, uint8_t *value, int size
     sprintf(sn_decoding->value, "Fail on reading");
     return -1;
   }
-  else{
-    memcpy(sn_decoding->value, value, SERIAL_NUM_SIZE);
-    sn_decoding->value[SERIAL_NUM_SIZE] = '\0';
-  }
+  else
+    nvme_serial_num_decode(value, sn_decoding);
 
   return 0;
 }
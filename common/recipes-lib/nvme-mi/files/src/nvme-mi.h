@@ -53,6 +53,11 @@ t_key_value_pair media_status;
 t_key_value_pair backup_device;
 } t_smart_warning; 
 
+int nvme_mi_basic_read(const char *i2c_bus, ssd_data *data);
+int nvme_mi_basic_read_cached(const char *i2c_bus, int drive, int max_age_ms, ssd_data *data);
+void nvme_mi_cache_invalidate(const char *i2c_bus, int drive);
+void nvme_mi_close(void);
+
 int nvme_read_byte(const char *i2c_bus, uint8_t item, uint8_t *value);
 int nvme_read_word(const char *i2c_bus, uint8_t item, uint16_t *value);
 int nvme_sflgs_read(const char *i2c_bus, uint8_t *value);
@@ -69,4 +74,11 @@ int nvme_pdlu_read_decode(const char *i2c_bus, uint8_t *value, t_key_value_pair
 int nvme_vendor_read_decode(const char *i2c_bus, uint16_t *value, t_key_value_pair *vendor_decoding);
 int nvme_serial_num_read_decode(const char *i2c_bus, uint8_t *value, int size, t_key_value_pair *sn_decoding);
 
+void nvme_sflgs_decode(uint8_t value, t_status_flags *status_flag_decoding);
+void nvme_smart_warning_decode(uint8_t value, t_smart_warning *smart_warning_decoding);
+void nvme_temp_decode(uint8_t value, t_key_value_pair *temp_decoding);
+void nvme_pdlu_decode(uint8_t value, t_key_value_pair *pdlu_decoding);
+void nvme_vendor_decode(uint16_t value, t_key_value_pair *vendor_decoding);
+void nvme_serial_num_decode(const uint8_t *value, t_key_value_pair *sn_decoding);
+
 #endif
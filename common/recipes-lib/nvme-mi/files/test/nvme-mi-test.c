@@ -0,0 +1,291 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * NVMe-MI library test against a simulated drive at 0x6A.
+ *
+ *   nvme-mi-test             drive simulated in this process
+ *   nvme-mi-test /dev/i2c-N  drive on an i2c-stub bus, after
+ *                            "modprobe i2c-stub chip_addr=0x6a"
+ *
+ * The in-process drive answers the I2C_RDWR and I2C_SMBUS ioctls the way
+ * i2c-stub does for byte and word reads, and can also take the I2C block
+ * reads i2c-stub rejects (it has no plain I2C support), corrupt a PEC or
+ * not answer at all. Only the fallback to SMBus reads can be checked on
+ * i2c-stub.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <openbmc/obmc-i2c.h>
+#include "nvme-mi.h"
+
+#define DRIVE_ADDR 0x6A
+#define DRIVE_VENDOR 0x144D
+#define DRIVE_SERIAL "S3HCNX0K123456      "
+
+static struct {
+  bool real;            /* pass the ioctls on to an i2c-stub bus */
+  bool block;           /* adapter takes I2C block reads */
+  bool present;
+  int corrupt;          /* PEC errors left to send */
+  uint8_t addr;
+  uint8_t regs[256];
+  int xfers;
+} drive;
+
+static int failures = 0;
+
+int
+ioctl(int fd, unsigned long request, ...) {
+  struct i2c_rdwr_ioctl_data *rdwr;
+  struct i2c_smbus_ioctl_data *smbus;
+  uint8_t ptr;
+  va_list ap;
+  void *arg;
+
+  va_start(ap, request);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+
+  if (drive.real)
+    return syscall(SYS_ioctl, fd, request, arg);
+
+  switch (request) {
+    case I2C_SLAVE:
+      drive.addr = (unsigned long)arg;
+      return 0;
+    case I2C_RDWR:
+      if (!drive.block) {
+        errno = EOPNOTSUPP;
+        return -1;
+      }
+      drive.xfers++;
+      rdwr = arg;
+      if (!drive.present || rdwr->nmsgs != 2 || rdwr->msgs[0].addr != DRIVE_ADDR) {
+        errno = ENXIO;
+        return -1;
+      }
+      ptr = rdwr->msgs[0].buf[0];
+      memcpy(rdwr->msgs[1].buf, &drive.regs[ptr], rdwr->msgs[1].len);
+      if (drive.corrupt > 0) {
+        drive.corrupt--;
+        rdwr->msgs[1].buf[rdwr->msgs[1].len - 1] ^= 0x5A;
+      }
+      return rdwr->nmsgs;
+    case I2C_SMBUS:
+      drive.xfers++;
+      smbus = arg;
+      if (!drive.present || drive.addr != DRIVE_ADDR) {
+        errno = ENXIO;
+        return -1;
+      }
+      if (smbus->size == I2C_SMBUS_BYTE_DATA) {
+        smbus->data->byte = drive.regs[smbus->command];
+      } else if (smbus->size == I2C_SMBUS_WORD_DATA) {
+        smbus->data->word = drive.regs[smbus->command] |
+                            (drive.regs[(uint8_t)(smbus->command + 1)] << 8);
+      } else {
+        errno = EINVAL;
+        return -1;
+      }
+      return 0;
+  }
+
+  errno = ENOTTY;
+  return -1;
+}
+
+/* SMBus PEC of a block read at cmd, computed independently of the library */
+static uint8_t
+pec(uint8_t cmd, const uint8_t *buf, int len) {
+  uint8_t hdr[3] = {DRIVE_ADDR << 1, cmd, (DRIVE_ADDR << 1) | 1};
+  uint8_t crc = 0;
+  int i, j;
+
+  for (i = 0; i < 3 + len; i++) {
+    crc ^= (i < 3) ? hdr[i] : buf[i - 3];
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  }
+  return crc;
+}
+
+/* Basic management status (offset 0) and vendor (offset 8) data structures */
+static void
+set_drive(uint8_t sflgs, uint8_t warning, uint8_t temp, uint8_t pdlu) {
+  memset(drive.regs, 0, sizeof(drive.regs));
+  drive.regs[0] = 6;
+  drive.regs[1] = sflgs;
+  drive.regs[2] = warning;
+  drive.regs[3] = temp;
+  drive.regs[4] = pdlu;
+  drive.regs[7] = pec(0x00, &drive.regs[0], 7);
+  drive.regs[8] = 22;
+  drive.regs[9] = DRIVE_VENDOR >> 8;
+  drive.regs[10] = DRIVE_VENDOR & 0xFF;
+  memcpy(&drive.regs[11], DRIVE_SERIAL, 20);
+  drive.regs[31] = pec(0x08, &drive.regs[8], 23);
+}
+
+/* Load the registers into an i2c-stub chip */
+static int
+load_stub(const char *bus) {
+  int fd, i;
+
+  fd = open(bus, O_RDWR);
+  if (fd < 0 || ioctl(fd, I2C_SLAVE, DRIVE_ADDR) < 0) {
+    perror(bus);
+    return -1;
+  }
+  for (i = 0; i < 32; i++) {
+    if (i2c_smbus_write_byte_data(fd, i, drive.regs[i]) < 0) {
+      perror("i2c_smbus_write_byte_data");
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+static void
+check(bool passed, const char *what) {
+  printf("%-48s %s\n", what, passed ? "PASSED" : "FAILED");
+  if (!passed)
+    failures++;
+}
+
+static bool
+data_ok(const ssd_data *data, uint8_t sflgs, uint8_t warning, uint8_t temp, uint8_t pdlu) {
+  return data->sflgs == sflgs && data->warning == warning &&
+         data->temp == temp && data->pdlu == pdlu &&
+         data->vendor == DRIVE_VENDOR &&
+         !memcmp(data->serial_num, DRIVE_SERIAL, 20);
+}
+
+static void
+test_field_reads(const char *bus) {
+  uint8_t sn[20];
+  uint16_t vendor = 0;
+  uint8_t temp = 0;
+  int xfers;
+
+  xfers = drive.xfers;
+  check(nvme_serial_num_read(bus, sn, sizeof(sn)) == 0 && !memcmp(sn, DRIVE_SERIAL, 20),
+        "serial number");
+  if (!drive.real)
+    printf("  %d transfers\n", drive.xfers - xfers);
+
+  check(nvme_vendor_read(bus, &vendor) == 0 && vendor == DRIVE_VENDOR, "vendor ID");
+  check(nvme_temp_read(bus, &temp) == 0 && temp == 35, "temperature");
+}
+
+static void
+test_sim(const char *bus) {
+  ssd_data data;
+  uint8_t sn[20];
+  int xfers;
+
+  drive.present = true;
+  drive.block = true;
+  set_drive(0xBF, 0xFF, 35, 3);
+
+  /* Block reads */
+  xfers = drive.xfers;
+  check(nvme_mi_basic_read(bus, &data) == 0 && data_ok(&data, 0xBF, 0xFF, 35, 3) &&
+        drive.xfers - xfers == 1, "basic read, one transfer");
+  xfers = drive.xfers;
+  check(nvme_serial_num_read(bus, sn, sizeof(sn)) == 0 && !memcmp(sn, DRIVE_SERIAL, 20) &&
+        drive.xfers - xfers == 1, "serial number, one transfer");
+
+  /* A PEC error is read again as a block */
+  drive.corrupt = 1;
+  xfers = drive.xfers;
+  check(nvme_mi_basic_read(bus, &data) == 0 && data_ok(&data, 0xBF, 0xFF, 35, 3) &&
+        drive.xfers - xfers == 2, "basic read, PEC error retried");
+
+  /* A drive whose PEC never matches is read per register */
+  drive.corrupt = 1000;
+  check(nvme_mi_basic_read(bus, &data) == 0 && data_ok(&data, 0xBF, 0xFF, 35, 3),
+        "basic read, bad PEC, SMBus fallback");
+  check(nvme_serial_num_read(bus, sn, sizeof(sn)) == 0 && !memcmp(sn, DRIVE_SERIAL, 20),
+        "serial number, bad PEC, SMBus fallback");
+  drive.corrupt = 0;
+
+  /* An adapter without I2C block reads, like i2c-stub, is not retried */
+  drive.block = false;
+  xfers = drive.xfers;
+  check(nvme_mi_basic_read(bus, &data) == 0 && data_ok(&data, 0xBF, 0xFF, 35, 3) &&
+        drive.xfers - xfers == 4 + 1 + 20, "basic read, no block read, SMBus fallback");
+  test_field_reads(bus);
+  drive.block = true;
+
+  /* Cached reads */
+  nvme_mi_basic_read_cached(bus, 1, 0, &data);
+  set_drive(0xBF, 0xFD, 40, 4);
+  xfers = drive.xfers;
+  check(nvme_mi_basic_read_cached(bus, 1, 1000, &data) == 0 &&
+        data_ok(&data, 0xBF, 0xFF, 35, 3) && drive.xfers == xfers, "cached, fresh");
+  check(nvme_mi_basic_read_cached(bus, 2, 1000, &data) == 0 &&
+        data_ok(&data, 0xBF, 0xFD, 40, 4) && drive.xfers == xfers + 1, "cached, other drive");
+  check(nvme_mi_basic_read_cached(bus, 1, 0, &data) == 0 &&
+        data_ok(&data, 0xBF, 0xFD, 40, 4) && drive.xfers == xfers + 2, "cached, max age 0");
+  set_drive(0xBF, 0xFF, 45, 5);
+  nvme_mi_cache_invalidate(bus, -1);
+  check(nvme_mi_basic_read_cached(bus, 1, 1000, &data) == 0 &&
+        data_ok(&data, 0xBF, 0xFF, 45, 5), "cached, invalidated");
+
+  /* A missing drive fails and drops its cache entry */
+  drive.present = false;
+  check(nvme_mi_basic_read_cached(bus, 1, 0, &data) != 0, "drive removed");
+  drive.present = true;
+  xfers = drive.xfers;
+  check(nvme_mi_basic_read_cached(bus, 1, 1000, &data) == 0 &&
+        drive.xfers == xfers + 1, "drive back, read again");
+}
+
+int
+main(int argc, char **argv) {
+  const char *bus = "/dev/null";
+
+  if (argc > 1) {
+    bus = argv[1];
+    drive.real = true;
+    set_drive(0xBF, 0xFF, 35, 3);
+    if (load_stub(bus))
+      return 1;
+    printf("Testing against i2c-stub on %s\n", bus);
+    test_field_reads(bus);
+  } else {
+    printf("Testing against a simulated drive\n");
+    test_sim(bus);
+  }
+
+  nvme_mi_close();
+  printf("NVMe-MI: %s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
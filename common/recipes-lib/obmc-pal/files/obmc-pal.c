@@ -17,6 +17,7 @@
  */
 #include "obmc-pal.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <fcntl.h>
@@ -26,6 +27,8 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <openbmc/edb.h>
 #include <openbmc/kv.h>
 #include <openbmc/ipmi.h>
@@ -242,6 +245,26 @@ pal_sled_cycle(void)
   return PAL_EOK;
 }
 
+int __attribute__((weak))
+pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint)
+{
+  return PAL_ENOTSUP;
+}
+
+// Slots in the same group are never sequenced concurrently
+int __attribute__((weak))
+pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group)
+{
+  *group = slot_id;
+  return PAL_EOK;
+}
+
+int __attribute__((weak))
+pal_get_pwr_good_gpio(uint8_t slot_id, int *gpio)
+{
+  return PAL_ENOTSUP;
+}
+
 int __attribute__((weak))
 pal_post_handle(uint8_t slot, uint8_t status)
 {
@@ -346,6 +369,12 @@ pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value)
   return PAL_EOK;
 }
 
+void __attribute__((weak))
+pal_sensor_sweep(uint8_t fru, bool start)
+{
+  return;
+}
+
 int __attribute__((weak))
 pal_sensor_threshold_flag(uint8_t fru, uint8_t snr_num, uint16_t *flag)
 {
@@ -1741,257 +1770,334 @@ pal_is_sensor_existing(uint8_t fru, uint8_t snr_num) {
 }
 
 int __attribute__((weak))
-pal_copy_all_thresh_to_file(uint8_t fru, thresh_sensor_t *sinfo) {
+pal_sensor_sdr_init(uint8_t fru, void *sinfo)
+{
+  return -1;
+}
+
+static int
+thresh_tbl_path(uint8_t fru, int mode, char *fpath) {
+  char fru_name[16] = {0};
+
+  if (pal_get_fru_name(fru, fru_name) < 0) {
+    printf("%s: Fail to get fru%d name\n", __func__, fru);
+    return -1;
+  }
+
+  if (mode == SENSORD_MODE_TESTING) {
+    sprintf(fpath, THRESHOLD_BIN, fru_name);
+  } else {
+    sprintf(fpath, INIT_THRESHOLD_BIN, fru_name);
+  }
+
+  return 0;
+}
+
+// Publish a complete table: write a temporary file and rename it over the
+// old one so readers always map either the old or the new version
+static int
+thresh_tbl_store(uint8_t fru, int mode, thresh_sensor_t *snr, int cnt,
+                 uint32_t version) {
+  thresh_tbl_t hdr;
+  char fpath[64] = {0};
+  char tpath[72] = {0};
+  size_t len = cnt * sizeof(thresh_sensor_t);
   int fd;
-  uint8_t bytes_wd = 0;
-  uint8_t snr_num = 0;
+
+  if (thresh_tbl_path(fru, mode, fpath) < 0) {
+    return -1;
+  }
+  snprintf(tpath, sizeof(tpath), "%s.%d", fpath, getpid());
+
+  hdr.magic = THRESH_TBL_MAGIC;
+  hdr.version = version;
+  hdr.count = cnt;
+  hdr.reserved = 0;
+
+  fd = open(tpath, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) {
+    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, tpath, errno, strerror(errno));
+    return -1;
+  }
+
+  if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+      write(fd, snr, len) != (ssize_t)len) {
+    syslog(LOG_ERR, "%s: write failed for %s\n", __func__, tpath);
+    close(fd);
+    unlink(tpath);
+    return -1;
+  }
+  close(fd);
+
+  if (rename(tpath, fpath)) {
+    syslog(LOG_ERR, "%s: rename failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+    unlink(tpath);
+    return -1;
+  }
+
+  return 0;
+}
+
+thresh_tbl_t * __attribute__((weak))
+pal_thresh_tbl_map(uint8_t fru, int mode, size_t *size) {
+  thresh_tbl_t *tbl;
+  struct stat st;
+  char fpath[64] = {0};
+  int fd;
+
+  if (thresh_tbl_path(fru, mode, fpath) < 0) {
+    return NULL;
+  }
+
+  fd = open(fpath, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  if (fstat(fd, &st) || st.st_size < sizeof(thresh_tbl_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  tbl = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (tbl == MAP_FAILED) {
+    syslog(LOG_ERR, "%s: mmap failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+    return NULL;
+  }
+
+  if (tbl->magic != THRESH_TBL_MAGIC ||
+      st.st_size < sizeof(thresh_tbl_t) + tbl->count * sizeof(thresh_sensor_t)) {
+    syslog(LOG_WARNING, "%s: invalid threshold table %s\n", __func__, fpath);
+    munmap(tbl, st.st_size);
+    return NULL;
+  }
+
+  *size = st.st_size;
+  return tbl;
+}
+
+void __attribute__((weak))
+pal_thresh_tbl_unmap(thresh_tbl_t *tbl, size_t size) {
+  munmap(tbl, size);
+}
+
+int __attribute__((weak))
+pal_copy_all_thresh_to_file(uint8_t fru, thresh_sensor_t *sinfo) {
+  thresh_sensor_t *snr;
   int ret;
-  char fru_name[8];
   int sensor_cnt;
   uint8_t *sensor_list;
-  char fpath[64] = {0};
   int i;
 
-  ret = pal_get_fru_name(fru, &fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
-    return ret;
-  }
-
   ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
   if (ret < 0) {
     return ret;
   }
 
-  sprintf(fpath, INIT_THRESHOLD_BIN, fru_name);
-  fd = open(fpath, O_CREAT | O_RDWR);
-  if (fd < 0) {
-    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+  snr = calloc(sensor_cnt ? sensor_cnt : 1, sizeof(thresh_sensor_t));
+  if (snr == NULL) {
     return -1;
   }
 
   for (i = 0; i < sensor_cnt; i++) {
-    snr_num = sensor_list[i];
-    bytes_wd = write(fd, &sinfo[snr_num], sizeof(thresh_sensor_t));
-    if (bytes_wd != sizeof(thresh_sensor_t)) {
-      syslog(LOG_ERR, "%s: read returns %d bytes\n", __func__, bytes_wd);
-      close(fd);
-      return -1;
-    }
+    memcpy(&snr[i], &sinfo[sensor_list[i]], sizeof(thresh_sensor_t));
   }
 
-  close(fd);
-  return 0;
-}
+  ret = thresh_tbl_store(fru, SENSORD_MODE_NORMAL, snr, sensor_cnt, 0);
+  free(snr);
 
-int __attribute__((weak))
-pal_sensor_sdr_init(uint8_t fru, void *sinfo)
-{
-  return -1;
+  return ret;
 }
 
 int __attribute__((weak))
 pal_get_all_thresh_from_file(uint8_t fru, thresh_sensor_t *sinfo, int mode) {
-  int fd;
-  int cnt = 0;
-  uint8_t buf[MAX_THERSH_LEN] = {0};
-  uint8_t bytes_rd = 0;
+  thresh_tbl_t *tbl;
+  size_t size;
   int ret;
   uint8_t snr_num = 0;
-  char fru_name[8];
   int sensor_cnt;
   uint8_t *sensor_list;
-  char fpath[64] = {0};
-  char initpath[64] = {0};
-  char cmd[128] = {0};
-  thresh_sensor_t *snr;
   int curr_state = 0;
-
-  ret = pal_get_fru_name(fru, &fru_name);
-  if (ret < 0)
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
-
-  switch (mode) {
-    case SENSORD_MODE_TESTING:
-      sprintf(fpath, THRESHOLD_BIN, fru_name);
-      break;
-    case SENSORD_MODE_NORMAL:
-      sprintf(fpath, INIT_THRESHOLD_BIN, fru_name);
-      break;
-    default:
-      sprintf(fpath, INIT_THRESHOLD_BIN, fru_name);
-      break;
-  }
+  int i;
 
   ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
   if (ret < 0) {
     return ret;
   }
 
-  fd = open(fpath, O_RDONLY);
-  if (fd < 0) {
-    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+  tbl = pal_thresh_tbl_map(fru, mode, &size);
+  if (tbl == NULL) {
+    syslog(LOG_ERR, "%s: no threshold table for fru%d\n", __func__, fru);
     return -1;
   }
 
-  while ((bytes_rd = read(fd, buf, sizeof(thresh_sensor_t))) > 0) {
-    if (bytes_rd != sizeof(thresh_sensor_t)) {
-      syslog(LOG_ERR, "%s: read returns %d bytes\n", __func__, bytes_rd);
-      close(fd);
-      return -1;
-    }
-
-    snr_num = sensor_list[cnt];
+  for (i = 0; i < sensor_cnt && i < tbl->count; i++) {
+    snr_num = sensor_list[i];
     curr_state = sinfo[snr_num].curr_state;
-    memcpy(&sinfo[snr_num], &buf, sizeof(thresh_sensor_t));
+    memcpy(&sinfo[snr_num], THRESH_TBL_ENTRY(tbl, i), sizeof(thresh_sensor_t));
     sinfo[snr_num].curr_state = curr_state;
-    memset(buf, 0, sizeof(buf));
-    cnt++;
-
-    if (cnt == sensor_cnt) {
-      syslog(LOG_ERR, "%s: cnt = %d", __func__, cnt);
-      break;
-    }
   }
 
-  close(fd);
+  pal_thresh_tbl_unmap(tbl, size);
 
-  // Remove reinit file
-  memset(fpath, 0, sizeof(fpath));
-  sprintf(fpath, THRESHOLD_RE_FLAG, fru_name);
-  if (0 == access(fpath, F_OK)) {
-    sprintf(cmd,"rm -rf %s",fpath);
-    system(cmd);
+  return 0;
+}
+
+static int
+thresh_tbl_index(uint8_t fru, uint8_t snr_num, int *sensor_cnt) {
+  uint8_t *sensor_list;
+  int i;
+
+  if (pal_get_fru_sensor_list(fru, &sensor_list, sensor_cnt) < 0) {
+    return -1;
   }
 
-  return 0;
+  for (i = 0; i < *sensor_cnt; i++) {
+    if (sensor_list[i] == snr_num) {
+      return i;
+    }
+  }
+
+  return -1;
 }
 
 int __attribute__((weak))
 pal_get_thresh_from_file(uint8_t fru, uint8_t snr_num, thresh_sensor_t *sinfo) {
-  int fd;
-  int cnt = 0;
-  uint8_t buf[MAX_THERSH_LEN] = {0};
-  uint8_t bytes_rd = 0;
-  int ret;
-  char fru_name[8];
+  thresh_tbl_t *tbl;
+  size_t size;
   int sensor_cnt;
-  uint8_t *sensor_list;
-  char fpath[64] = {0};
+  int idx;
 
-  ret = pal_get_fru_name(fru, &fru_name);
-  if (ret < 0)
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
+  idx = thresh_tbl_index(fru, snr_num, &sensor_cnt);
+  if (idx < 0) {
+    return -1;
+  }
 
-  sprintf(fpath, THRESHOLD_BIN, fru_name);
-  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
-  if (ret < 0) {
-    return ret;
+  tbl = pal_thresh_tbl_map(fru, SENSORD_MODE_TESTING, &size);
+  if (tbl == NULL) {
+    tbl = pal_thresh_tbl_map(fru, SENSORD_MODE_NORMAL, &size);
+  }
+  if (tbl == NULL) {
+    syslog(LOG_ERR, "%s: no threshold table for fru%d\n", __func__, fru);
+    return -1;
   }
 
-  fd = open(fpath, O_RDONLY);
-  if (fd < 0) {
-    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+  if (idx >= tbl->count) {
+    pal_thresh_tbl_unmap(tbl, size);
     return -1;
   }
-  
-  while (cnt != sensor_cnt) {
-    lseek(fd, cnt*sizeof(thresh_sensor_t), SEEK_SET);
-    if (snr_num == sensor_list[cnt]) {
-      bytes_rd = read(fd, buf, sizeof(thresh_sensor_t));
-      if (bytes_rd != sizeof(thresh_sensor_t)) {
-        syslog(LOG_ERR, "%s: read returns %d bytes\n", __func__, bytes_rd);
-        close(fd);
-        return -1;
-      }
-      memcpy(sinfo, buf, sizeof(thresh_sensor_t));
-      break;
+
+  memcpy(sinfo, THRESH_TBL_ENTRY(tbl, idx), sizeof(thresh_sensor_t));
+  pal_thresh_tbl_unmap(tbl, size);
+
+  return 0;
+}
+
+// Override table versions keep counting across pal_clear_thresh_value(),
+// so sensord never takes a new override table for the one it applied
+// before the clear. The counter lives next to the tables, not in them.
+static uint32_t
+thresh_tbl_next_version(uint8_t fru, uint32_t min_version) {
+  char fru_name[16] = {0};
+  char fpath[64] = {0};
+  uint32_t version = 0;
+  FILE *fp;
+
+  if (pal_get_fru_name(fru, fru_name) < 0) {
+    return min_version;
+  }
+  sprintf(fpath, THRESHOLD_VER, fru_name);
+
+  fp = fopen(fpath, "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%u", &version) != 1) {
+      version = 0;
     }
-    cnt++;
+    fclose(fp);
   }
+  version = (version + 1 > min_version) ? version + 1 : min_version;
 
-  close(fd);
+  fp = fopen(fpath, "w");
+  if (fp == NULL) {
+    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+    return version;
+  }
+  fprintf(fp, "%u\n", version);
+  fclose(fp);
 
-  return 0;
+  return version;
 }
 
+// Replace one sensor in the override table and publish it as a new
+// version. The override table starts out as a copy of the defaults.
 int __attribute__((weak))
 pal_copy_thresh_to_file(uint8_t fru, uint8_t snr_num, thresh_sensor_t *sinfo) {
-  int fd;
-  int cnt = 0;
-  uint8_t bytes_wd = 0;
-  int ret;
-  char fru_name[8];
+  thresh_tbl_t *tbl;
+  thresh_sensor_t *snr;
+  uint32_t version = 1;
+  size_t size;
   int sensor_cnt;
-  uint8_t *sensor_list;
-  char fpath[64] = {0};
+  int cnt, idx, ret;
 
-  ret = pal_get_fru_name(fru, &fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
-    return ret;
+  idx = thresh_tbl_index(fru, snr_num, &sensor_cnt);
+  if (idx < 0) {
+    return -1;
   }
 
-  sprintf(fpath, THRESHOLD_BIN, fru_name);
-  ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
-  if (ret < 0) {
-    return ret;
+  tbl = pal_thresh_tbl_map(fru, SENSORD_MODE_TESTING, &size);
+  if (tbl != NULL) {
+    version = tbl->version + 1;
+  } else {
+    tbl = pal_thresh_tbl_map(fru, SENSORD_MODE_NORMAL, &size);
   }
-
-  fd = open(fpath, O_CREAT | O_RDWR);
-  if (fd < 0) {
-    syslog(LOG_ERR, "%s: open failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+  if (tbl == NULL) {
+    syslog(LOG_ERR, "%s: no threshold table for fru%d\n", __func__, fru);
     return -1;
   }
+  version = thresh_tbl_next_version(fru, version);
 
-  while (cnt != sensor_cnt) {
-    lseek(fd, cnt*sizeof(thresh_sensor_t), SEEK_SET);
-    if (snr_num == sensor_list[cnt]) {
-      bytes_wd = write(fd, sinfo, sizeof(thresh_sensor_t));
-      if (bytes_wd != sizeof(thresh_sensor_t)) {
-        syslog(LOG_ERR, "%s: read returns %d bytes\n", __func__, bytes_wd);
-        close(fd);
-        return -1;
-      }
-      break;
-    } 
-    cnt++;  
+  cnt = (tbl->count > sensor_cnt) ? tbl->count : sensor_cnt;
+  snr = calloc(cnt, sizeof(thresh_sensor_t));
+  if (snr == NULL) {
+    pal_thresh_tbl_unmap(tbl, size);
+    return -1;
   }
+  memcpy(snr, THRESH_TBL_ENTRY(tbl, 0), tbl->count * sizeof(thresh_sensor_t));
+  pal_thresh_tbl_unmap(tbl, size);
 
-  close(fd);
-  return 0;
+  memcpy(&snr[idx], sinfo, sizeof(thresh_sensor_t));
+  ret = thresh_tbl_store(fru, SENSORD_MODE_TESTING, snr, cnt, version);
+  free(snr);
+
+  return ret;
 }
 
+// Drop all overrides of a FRU, sensord goes back to the defaults
 int __attribute__((weak))
-pal_sensor_thresh_modify(uint8_t fru,  uint8_t sensor_num, uint8_t thresh_type, float value) {
-  int i;
-  int ret = -1;
-  thresh_sensor_t snr;
-  FILE *pfile;
-  char fru_name[8];
+pal_clear_thresh_value(uint8_t fru) {
   char fpath[64] = {0};
-  char initpath[64] = {0};
-  char cmd[128] = {0};
 
-  ret = pal_get_fru_name(fru, &fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n",__func__,fru);
-    return ret;
+  if (thresh_tbl_path(fru, SENSORD_MODE_TESTING, fpath) < 0) {
+    return -1;
   }
 
-  memset(fpath, 0, sizeof(fpath));
-  sprintf(fpath, THRESHOLD_BIN, fru_name);
-  memset(initpath, 0, sizeof(initpath));
-  sprintf(initpath, INIT_THRESHOLD_BIN, fru_name);
-  if (0 != access(fpath, F_OK)) {
-    sprintf(cmd,"cp -rf %s %s", initpath, fpath);
-    system(cmd);
+  if (unlink(fpath) && errno != ENOENT) {
+    syslog(LOG_ERR, "%s: unlink failed for %s, errno : %d %s\n", __func__, fpath, errno, strerror(errno));
+    return -1;
   }
 
-  ret = pal_get_thresh_from_file(fru, sensor_num, &snr);
+  return 0;
+}
+
+int __attribute__((weak))
+pal_sensor_thresh_modify(uint8_t fru,  uint8_t sensor_num, uint8_t thresh_type, float value) {
+  int ret = -1;
+  thresh_sensor_t snr;
 
+  ret = pal_get_thresh_from_file(fru, sensor_num, &snr);
   if (ret < 0) {
-    syslog(LOG_ERR, "%s: Fail to get %s sensor threshold file\n",__func__,fru_name);
+    syslog(LOG_ERR, "%s: Fail to get fru%d sensor threshold\n", __func__, fru);
     return ret;
   }
 
@@ -2025,18 +2131,12 @@ pal_sensor_thresh_modify(uint8_t fru,  uint8_t sensor_num, uint8_t thresh_type,
       return -1;
   }
 
+  // sensord picks the new table version up through its inotify watch
   ret = pal_copy_thresh_to_file(fru, sensor_num, &snr);
   if (ret < 0) {
-    printf("fail to set threshold file for %s\n", fru_name);
+    printf("fail to set threshold file for fru%d\n", fru);
     return ret;
   }
 
-  // Create reinit file
-  memset(fpath, 0, sizeof(fpath));
-  sprintf(fpath, THRESHOLD_RE_FLAG, fru_name);
-  sprintf(cmd,"touch %s",fpath);
-  system(cmd);
-
   return 0;
 }
-
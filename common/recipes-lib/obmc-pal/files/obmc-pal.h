@@ -19,6 +19,7 @@
 #define __OBMC_PAL_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <sys/file.h>
@@ -41,7 +42,7 @@ extern "C" {
 #define THRESHOLD_PATH     "/tmp/thresh-cache"
 #define INIT_THRESHOLD_BIN "/tmp/thresh-cache/%s_init_thresh-val.bin"
 #define THRESHOLD_BIN      "/tmp/thresh-cache/%s_thresh-val.bin"
-#define THRESHOLD_RE_FLAG  "/tmp/thresh-cache/%s_thresh-reinit"
+#define THRESHOLD_VER      "/tmp/thresh-cache/%s_thresh-ver"
 #define MAX_SENSOR_NUMBER  0xFF
 #define MAX_THERSH_LEN     256
 
@@ -64,6 +65,29 @@ typedef struct {
 
 } thresh_sensor_t;
 
+/*
+ * Threshold table file: this header followed by one thresh_sensor_t per
+ * sensor in pal_get_fru_sensor_list() order. Writers replace the whole file
+ * with rename() and bump version, readers mmap() it.
+ */
+#define THRESH_TBL_MAGIC   0x54485442
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+} thresh_tbl_t;
+
+#define THRESH_TBL_ENTRY(tbl, i) (&((thresh_sensor_t *)((tbl) + 1))[i])
+
+/* Limits a platform places on sequencing several slots at once */
+typedef struct {
+  uint16_t stagger_ms;    /* minimum gap between two slots powering on */
+  uint8_t  max_parallel;  /* slots sequenced at the same time, 0 for no limit */
+  uint32_t timeout_ms;    /* time allowed to reach the requested state */
+  uint32_t cycle_off_ms;  /* time a slot is held off in a power cycle */
+} pwr_seq_constraint_t;
+
 enum {
   SENSORD_MODE_TESTING = 0x01,
   SENSORD_MODE_NORMAL  = 0x0F,
@@ -202,6 +226,9 @@ int pal_is_fru_prsnt(uint8_t fru, uint8_t *status);
 int pal_get_server_power(uint8_t slot_id, uint8_t *status);
 int pal_set_server_power(uint8_t slot_id, uint8_t cmd);
 int pal_sled_cycle(void);
+int pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint);
+int pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group);
+int pal_get_pwr_good_gpio(uint8_t slot_id, int *gpio);
 int pal_post_handle(uint8_t slot, uint8_t status);
 int pal_set_rst_btn(uint8_t slot, uint8_t status);
 int pal_set_led(uint8_t led, uint8_t status);
@@ -219,6 +246,9 @@ int pal_fruid_write(uint8_t slot, char *path);
 int pal_get_fru_devtty(uint8_t fru, char *devtty);
 int pal_sensor_check(uint8_t fru, uint8_t sensor_num);
 int pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value);
+// Brackets a monitoring sweep over the sensors of a fru by the calling
+// thread, e.g. to read them all at once. Other readers are not affected.
+void pal_sensor_sweep(uint8_t fru, bool start);
 int pal_sensor_threshold_flag(uint8_t fru, uint8_t snr_num, uint16_t *flag);
 int pal_get_sensor_name(uint8_t fru, uint8_t sensor_num, char *name);
 int pal_get_sensor_units(uint8_t fru, uint8_t sensor_num, char *units);
@@ -290,6 +320,9 @@ int pal_get_all_thresh_from_file(uint8_t fru, thresh_sensor_t *sinfo, int mode);
 int pal_copy_all_thresh_to_file(uint8_t fru, thresh_sensor_t *sinfo);
 int pal_get_thresh_from_file(uint8_t fru, uint8_t snr_num, thresh_sensor_t *sinfo);
 int pal_copy_thresh_to_file(uint8_t fru, uint8_t snr_num, thresh_sensor_t *sinfo);
+int pal_clear_thresh_value(uint8_t fru);
+thresh_tbl_t *pal_thresh_tbl_map(uint8_t fru, int mode, size_t *size);
+void pal_thresh_tbl_unmap(thresh_tbl_t *tbl, size_t size);
 bool pal_is_sensor_existing(uint8_t fru, uint8_t snr_num);
 #ifdef __cplusplus
 }
@@ -0,0 +1,314 @@
+/*
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Debug card MCU bootloader simulator. Built together with ocp-dbg-lcd.c
+ * (make mcu-sim) it stands in for the i2c bus and ipmbd, runs
+ * usb_dbg_update_fw() against a simulated flash and checks the result:
+ *
+ *   mcu-sim [-b packet] [-e packet] [-p ms] <image>
+ *
+ *   -b  drop off the bus at the given data packet, then resume the update
+ *   -e  stop programming from the given data packet on, then resume
+ *   -p  power cycle the card before the retry, its runtime firmware
+ *       answers after the given time instead of the bootloader
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <openbmc/ipmb.h>
+#include <openbmc/ipmi.h>
+#include "ocp-dbg-lcd.h"
+
+#define SIM_FLASH_START   0x8000
+#define SIM_FLASH_SIZE    (256 * 1024)
+#define SIM_FLASH_PAGE    1024
+#define SIM_ERASE_US      200   /* per page */
+#define SIM_I2C_HZ        100000
+
+#define CMD_PING          0x20
+#define CMD_DOWNLOAD      0x21
+#define CMD_RUN           0x22
+#define CMD_STATUS        0x23
+#define CMD_DATA          0x24
+
+#define ACK               0xCC
+#define NAK               0x33
+#define RET_SUCCESS       0x40
+#define RET_UNKNOWN_CMD   0x41
+#define RET_INVALID_ADR   0x43
+
+static struct {
+  bool bootloader;
+  uint8_t flash[SIM_FLASH_SIZE];
+  uint32_t addr;
+  uint32_t remain;
+  uint8_t status;
+  uint8_t pending_ack;
+  long long busy_until;
+  bool status_pending;
+  int data_pkts;
+  int bus_drop_at;
+  int fail_at;
+  long long runtime_at;
+  unsigned long xfers;
+  unsigned long bytes;
+} sim;
+
+static long long
+sim_now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int
+mcu_sim_open(void) {
+  return open("/dev/null", O_RDWR);
+}
+
+static void
+sim_packet(uint8_t *pkt, uint8_t len, uint8_t *ack) {
+  uint8_t sum = 0;
+  uint32_t addr, size, off;
+  int i;
+
+  if (len < 3 || pkt[0] != len) {
+    *ack = NAK;
+    return;
+  }
+  for (i = 2; i < len; i++) {
+    sum += pkt[i];
+  }
+  if (sum != pkt[1]) {
+    *ack = NAK;
+    return;
+  }
+
+  *ack = ACK;
+  if (pkt[2] == CMD_STATUS) {
+    // Reports the status of the previous command
+    sim.status_pending = true;
+    return;
+  }
+
+  sim.status = RET_SUCCESS;
+  switch (pkt[2]) {
+    case CMD_PING:
+      break;
+    case CMD_DOWNLOAD:
+      addr = (pkt[3] << 24) | (pkt[4] << 16) | (pkt[5] << 8) | pkt[6];
+      size = (pkt[7] << 24) | (pkt[8] << 16) | (pkt[9] << 8) | pkt[10];
+      if (addr < SIM_FLASH_START || (addr - SIM_FLASH_START) % SIM_FLASH_PAGE ||
+          addr - SIM_FLASH_START + size > SIM_FLASH_SIZE || size == 0) {
+        sim.status = RET_INVALID_ADR;
+        sim.remain = 0;
+        break;
+      }
+      // Erase the pages covered, the ACK is held back until done
+      off = addr - SIM_FLASH_START;
+      size = (size + SIM_FLASH_PAGE - 1) / SIM_FLASH_PAGE;
+      memset(&sim.flash[off], 0xFF, size * SIM_FLASH_PAGE);
+      sim.busy_until = sim_now_us() + size * SIM_ERASE_US;
+      sim.addr = off;
+      sim.remain = (pkt[7] << 24) | (pkt[8] << 16) | (pkt[9] << 8) | pkt[10];
+      break;
+    case CMD_DATA:
+      sim.data_pkts++;
+      if (sim.data_pkts == sim.fail_at) {
+        // Flash programming fails from here on until the next download
+        sim.remain = 0;
+      }
+      if (len - 3 > sim.remain) {
+        sim.status = RET_INVALID_ADR;
+        break;
+      }
+      memcpy(&sim.flash[sim.addr], &pkt[3], len - 3);
+      sim.addr += len - 3;
+      sim.remain -= len - 3;
+      break;
+    case CMD_RUN:
+      sim.bootloader = false;
+      break;
+    default:
+      sim.status = RET_UNKNOWN_CMD;
+      break;
+  }
+}
+
+int
+mcu_sim_xfer(uint8_t *tbuf, uint8_t tcount, uint8_t *rbuf, uint8_t rcount) {
+  uint8_t ack = 0;
+
+  sim.xfers++;
+  sim.bytes += tcount + rcount + 2;  // address bytes of write and read
+
+  if (sim.bus_drop_at && sim.data_pkts >= sim.bus_drop_at) {
+    return -1;
+  }
+  if (!sim.bootloader) {
+    return -1;
+  }
+
+  if (tcount == 1 && tbuf[0] == ACK && !rcount) {
+    // Host acknowledging the status packet
+    return 0;
+  }
+
+  if (tcount) {
+    if (sim_now_us() < sim.busy_until) {
+      // Busy erasing, the write is not taken
+      return -1;
+    }
+    sim_packet(tbuf, tcount, &ack);
+    sim.pending_ack = ack;
+  }
+
+  if (rcount) {
+    memset(rbuf, 0, rcount);
+    if (sim_now_us() < sim.busy_until) {
+      return 0;
+    }
+    rbuf[1] = sim.pending_ack;
+    sim.pending_ack = 0;
+    if (sim.status_pending && rcount >= 5) {
+      rbuf[2] = 3;
+      rbuf[3] = sim.status;
+      rbuf[4] = sim.status;
+      sim.status_pending = false;
+    }
+  }
+  return 0;
+}
+
+void
+lib_ipmb_handle(unsigned char bus_id, unsigned char *request, unsigned char req_len,
+                unsigned char *response, unsigned char *res_len) {
+  ipmb_req_t *req = (ipmb_req_t *)request;
+  ipmb_res_t *res = (ipmb_res_t *)response;
+  uint8_t netfn = req->netfn_lun >> 2;
+  uint8_t dlen = 0;
+
+  *res_len = 0;
+  if (sim.bootloader || sim_now_us() < sim.runtime_at) {
+    return;
+  }
+
+  res->cc = CC_SUCCESS;
+  if (netfn == NETFN_APP_REQ && req->cmd == CMD_APP_GET_DEVICE_ID) {
+    memset(res->data, 0, 15);
+    res->data[2] = sim.flash[0x100];
+    res->data[3] = sim.flash[0x101];
+    dlen = 15;
+  } else if (netfn == NETFN_OEM_1S_REQ && req->cmd == CMD_OEM_1S_ENABLE_BIC_UPDATE) {
+    sim.bootloader = true;
+    memcpy(res->data, req->data, 3);
+    dlen = 3;
+  } else {
+    res->cc = CC_INVALID_CMD;
+  }
+
+  *res_len = IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + dlen;
+}
+
+static int
+sim_update(const char *path, uint8_t *image, uint32_t size) {
+  unsigned long xfers = sim.xfers, bytes = sim.bytes;
+  long long start = sim_now_us();
+  int ret;
+
+  ret = usb_dbg_update_fw((char *)path, 1);
+  printf("sim: update %s, %lu transfers, %lu bus bytes (%lu ms at 100 kHz),"
+         " %lld ms elapsed\n", ret ? "failed" : "done", sim.xfers - xfers,
+         sim.bytes - bytes, (sim.bytes - bytes) * 9 * 1000 / SIM_I2C_HZ,
+         (sim_now_us() - start) / 1000);
+  return ret;
+}
+
+int
+main(int argc, char **argv) {
+  uint8_t *image;
+  uint32_t size;
+  FILE *fp;
+  int opt, ret;
+  int power_cycle = -1;
+
+  while ((opt = getopt(argc, argv, "b:e:p:")) != -1) {
+    switch (opt) {
+      case 'b':
+        sim.bus_drop_at = atoi(optarg);
+        break;
+      case 'e':
+        sim.fail_at = atoi(optarg);
+        break;
+      case 'p':
+        power_cycle = atoi(optarg);
+        break;
+      default:
+        return -1;
+    }
+  }
+  if (optind >= argc) {
+    printf("Usage: mcu-sim [-b packet] [-e packet] [-p ms] <image>\n");
+    return -1;
+  }
+
+  fp = fopen(argv[optind], "rb");
+  if (fp == NULL) {
+    perror(argv[optind]);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  rewind(fp);
+  image = malloc(size);
+  if (size > SIM_FLASH_SIZE || fread(image, 1, size, fp) != size) {
+    printf("bad image\n");
+    return -1;
+  }
+  fclose(fp);
+
+  memset(sim.flash, 0xFF, sizeof(sim.flash));
+  ret = sim_update(argv[optind], image, size);
+  if (ret && (sim.bus_drop_at || sim.fail_at)) {
+    // Bus back, the MCU stays in its bootloader unless power cycled
+    sim.bus_drop_at = sim.fail_at = 0;
+    if (power_cycle >= 0) {
+      sim.bootloader = false;
+      sim.runtime_at = sim_now_us() + power_cycle * 1000LL;
+    }
+    printf("sim: retrying\n");
+    ret = sim_update(argv[optind], image, size);
+  }
+
+  if (!ret && memcmp(sim.flash, image, size)) {
+    printf("sim: flash content does not match the image\n");
+    ret = -1;
+  }
+  printf("sim: %s\n", ret ? "FAIL" : "PASS");
+  free(image);
+  return ret ? 1 : 0;
+}
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
@@ -38,19 +39,56 @@
 #define MCU_UPDATE_TIMEOUT 500
 
 #define MCU_FLASH_START 0x8000
+#define MCU_FLASH_PAGE 1024
+// The packet size field is one byte and covers the 3 byte header
 #define MCU_PKT_MAX 252
+// Bytes sent between two bootloader status checks, also the resume unit
+#define MCU_STATUS_WINDOW (4 * MCU_FLASH_PAGE)
 
+#define MCU_CMD_PING 0x20
 #define MCU_CMD_DOWNLOAD 0x21
 #define MCU_CMD_RUN 0x22
 #define MCU_CMD_STATUS 0x23
 #define MCU_CMD_DATA 0x24
 
+#define MCU_ACK 0xCC
+#define MCU_NAK 0x33
+#define MCU_STATUS_SUCCESS 0x40
+
 #define CMD_DOWNLOAD_SIZE 11
 #define CMD_RUN_SIZE 7
 #define CMD_STATUS_SIZE 3
 #define CMD_DATA_SIZE 0xFF
 #define IPMB_WRITE_COUNT_MAX 224
 
+// Time allowed for the MCU to enter its bootloader, erase and boot again
+#define MCU_BOOT_TIMEOUT 3000
+#define MCU_ERASE_TIMEOUT 10000
+#define MCU_RUN_TIMEOUT 10000
+
+#ifndef MCU_UPDATE_STATE
+#define MCU_UPDATE_STATE "/mnt/data/usbdbg_fw_update"
+#endif
+#define MCU_UPDATE_MAGIC 0x55424447
+
+// Progress of an interrupted update, to resume the same image on the same
+// card from. The bootloader has no identity to read back, the card is the
+// MCU on the bus and address the update ran on.
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint32_t size;
+  uint32_t offset;
+  uint8_t bus;
+  uint8_t addr;
+  uint16_t rsvd;
+} mcu_update_state_t;
+
+#ifdef MCU_SIM
+int mcu_sim_open(void);
+int mcu_sim_xfer(uint8_t *tbuf, uint8_t tcount, uint8_t *rbuf, uint8_t rcount);
+#endif
+
 static uint8_t io_expander_addr = 0x4E;
 static uint8_t mcu_bus_id       = 0x9;
 static uint8_t MCU_addr         = 0x60;
@@ -60,8 +98,8 @@ static void
 msleep(int msec) {
   struct timespec req;
 
-  req.tv_sec = 0;
-  req.tv_nsec = msec * 1000 * 1000;
+  req.tv_sec = msec / 1000;
+  req.tv_nsec = (msec % 1000) * 1000 * 1000;
 
   while(nanosleep(&req, &req) == -1 && errno == EINTR) {
     continue;
@@ -171,234 +209,407 @@ usb_dbg_get_fw_ver(uint8_t comp, uint8_t *ver) {
   return ret;
 }
 
-int
-usb_dbg_update_fw(char *path, uint8_t en_mcu_upd)
-{
-  int fd = -1;
-  int ifd = -1;
-  char cmd[100] = {0};
-  struct stat buf;
-  int size;
-  uint8_t tbuf[256] = {0};
-  uint8_t rbuf[16] = {0};
-  uint8_t xbuf[256] = {0};
-  uint8_t tcount;
-  uint8_t rcount;
-  volatile int xcount;
-  int i = 0;
-  int ret = 0;
-  uint32_t offset = 0;
-  uint32_t last_offset = 0;
-  uint32_t dsize;
-  char fn[32];
+static long long
+now_ms(void) {
+  struct timespec ts;
 
-  // Open the file exclusively for read
-  fd = open(path, O_RDONLY, 0666);
-  if (fd < 0) {
-    syslog(LOG_ERR, "%s(%d) : open fails for path: %s\n",
-          __func__, __LINE__, path);
-    goto error_exit;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+crc32(const uint8_t *buf, uint32_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  int i;
+
+  while (len--) {
+    crc ^= *buf++;
+    for (i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
   }
+  return ~crc;
+}
 
-  fstat(fd, &buf);
-  size = buf.st_size;
-  printf("size of file is %d bytes\n", size);
-  dsize = size/20;
+static int
+mcu_open(void) {
+#ifdef MCU_SIM
+  return mcu_sim_open();
+#else
+  char fn[32];
 
-  // Open the i2c driver
   snprintf(fn, sizeof(fn), "/dev/i2c-%d", mcu_bus_id);
-  ifd = open(fn, O_RDWR);
-  if (ifd < 0) {
-    syslog(LOG_WARNING, "%s(%d): i2c_open failed for bus#%d\n",
-            __func__, __LINE__, mcu_bus_id);
-    goto error_exit2;
-  }
+  return open(fn, O_RDWR);
+#endif
+}
 
-  // Enable Bridge-IC update
-  if (en_mcu_upd) {
-    enable_MCU_update();
-  }
+static int
+mcu_xfer(int ifd, uint8_t *tbuf, uint8_t tcount, uint8_t *rbuf, uint8_t rcount) {
+#ifdef MCU_SIM
+  return mcu_sim_xfer(tbuf, tcount, rbuf, rcount);
+#else
+  return i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
+#endif
+}
 
-  // Kill ipmb daemon
-  memset(cmd, 0, sizeof(cmd));
-  sprintf(cmd, "sv stop ipmbd_%d", mcu_bus_id);
+static void
+ipmbd_control(const char *action) {
+#ifndef MCU_SIM
+  char cmd[64];
+
+  sprintf(cmd, "sv %s ipmbd_%d", action, mcu_bus_id);
   system(cmd);
-  printf("Stopped ipmbd %d..\n",mcu_bus_id);
+#endif
+}
 
-  //Waiting for MCU reset to bootloader for updating
-  sleep(1);
+// Send one bootloader packet, reading its ACK in the same transfer if asked
+static int
+mcu_send_pkt(int ifd, uint8_t cmd, const uint8_t *data, uint8_t len, bool ack) {
+  uint8_t tbuf[256];
+  uint8_t rbuf[2] = {0};
+  int i;
+
+  tbuf[0] = len + 3;
+  tbuf[1] = cmd;
+  tbuf[2] = cmd;
+  for (i = 0; i < len; i++) {
+    tbuf[3 + i] = data[i];
+    tbuf[1] += data[i];
+  }
 
-  // Start Bridge IC update(0x21)
+  if (mcu_xfer(ifd, tbuf, tbuf[0], rbuf, ack ? 2 : 0)) {
+    return -1;
+  }
+  if (ack && (rbuf[0] != 0x00 || rbuf[1] != MCU_ACK)) {
+    printf("cmd 0x%02x response: %x:%x\n", cmd, rbuf[0], rbuf[1]);
+    return -1;
+  }
+  return 0;
+}
 
-  tbuf[0] = CMD_DOWNLOAD_SIZE;
-  tbuf[1] = 0x00; //Checksum, will fill later
+// Poll for the ACK of the last packet; the MCU answers 0 while it is busy
+static int
+mcu_wait_ack(int ifd, int timeout_ms) {
+  long long end = now_ms() + timeout_ms;
+  uint8_t tbuf[1] = {0};
+  uint8_t rbuf[2];
+  int delay = 10;
+
+  do {
+    rbuf[0] = rbuf[1] = 0;
+    if (!mcu_xfer(ifd, tbuf, 0, rbuf, 2)) {
+      if (rbuf[1] == MCU_ACK) {
+        return 0;
+      }
+      if (rbuf[1] == MCU_NAK) {
+        return -1;
+      }
+    }
+    msleep(delay);
+    delay = (delay < 100) ? delay * 2 : 100;
+  } while (now_ms() < end);
 
-  tbuf[2] = MCU_CMD_DOWNLOAD;
+  return -1;
+}
 
-  // update flash address: 0x8000
-  tbuf[3] = (MCU_FLASH_START >> 24) & 0xff;
-  tbuf[4] = (MCU_FLASH_START >> 16) & 0xff;
-  tbuf[5] = (MCU_FLASH_START >> 8) & 0xff;
-  tbuf[6] = (MCU_FLASH_START) & 0xff;
+static int
+mcu_get_status(int ifd) {
+  uint8_t tbuf[CMD_STATUS_SIZE] = {CMD_STATUS_SIZE, MCU_CMD_STATUS, MCU_CMD_STATUS};
+  uint8_t rbuf[5] = {0};
 
-  // image size
-  tbuf[7] = (size >> 24) & 0xff;
-  tbuf[8] = (size >> 16) & 0xff;
-  tbuf[9] = (size >> 8) & 0xff;
-  tbuf[10] = (size) & 0xff;
+  if (mcu_xfer(ifd, tbuf, CMD_STATUS_SIZE, rbuf, 5)) {
+    printf("i2c_rdwr_msg_transfer failed - MCU_CMD_STATUS\n");
+    return -1;
+  }
 
-  // calcualte checksum for data portion
-  for (i = 2; i < CMD_DOWNLOAD_SIZE; i++) {
-    tbuf[1] += tbuf[i];
+  // ACK, then a 3 byte packet: size, checksum, status
+  if (rbuf[0] != 0x00 ||
+      rbuf[1] != MCU_ACK ||
+      rbuf[2] != 0x03 ||
+      rbuf[3] != rbuf[4] ||
+      rbuf[4] != MCU_STATUS_SUCCESS) {
+    printf("status resp: %x:%x:%x:%x:%x\n", rbuf[0], rbuf[1], rbuf[2], rbuf[3], rbuf[4]);
+    return -1;
   }
 
-  tcount = CMD_DOWNLOAD_SIZE;
+  // Acknowledge the status packet
+  tbuf[0] = MCU_ACK;
+  if (mcu_xfer(ifd, tbuf, 1, rbuf, 0)) {
+    printf("i2c_rdwr_msg_transfer failed, Send ACK\n");
+    return -1;
+  }
+  return 0;
+}
 
-  rcount = 0;
+// Wait for the bootloader to answer a ping after the MCU was reset into it
+static int
+mcu_wait_boot(int ifd) {
+  long long end = now_ms() + MCU_BOOT_TIMEOUT;
+  int delay = 20;
 
-  ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-  if (ret) {
-    printf("i2c_rdwr_msg_transfer failed download\n");
-    goto error_exit;
+  do {
+    if (!mcu_send_pkt(ifd, MCU_CMD_PING, NULL, 0, true)) {
+      return 0;
+    }
+    msleep(delay);
+    delay = (delay < 200) ? delay * 2 : 200;
+  } while (now_ms() < end);
+
+  return -1;
+}
+
+// Put the MCU in its bootloader, ipmbd is stopped as it shares the bus
+static int
+mcu_enter_boot(int ifd, uint8_t en_mcu_upd, bool resume) {
+  // Enable Bridge-IC update, an interrupted update left it in bootloader
+  if (en_mcu_upd && !resume) {
+    enable_MCU_update();
   }
 
-  //delay for download command process ---
-  msleep(500);
-  tcount = 0;
-  rcount = 2;
-  ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-  if (ret) {
-    printf("i2c_rdwr_msg_transfer failed download ack\n");
-    goto error_exit;
+  // Kill ipmb daemon
+  ipmbd_control("stop");
+  printf("Stopped ipmbd %d..\n",mcu_bus_id);
+
+  if (mcu_wait_boot(ifd)) {
+    printf("MCU bootloader does not respond\n");
+    return -1;
   }
+  return 0;
+}
 
-  if (rbuf[0] != 0x00 || rbuf[1] != 0xcc) {
-    printf("download response: %x:%x\n", rbuf[0], rbuf[1]);
-    ret = -1;
-    goto error_exit;
+static uint32_t
+mcu_resume_offset(uint32_t crc, uint32_t size) {
+  mcu_update_state_t st;
+  int fd;
+
+  fd = open(MCU_UPDATE_STATE, O_RDONLY);
+  if (fd < 0) {
+    return 0;
   }
+  if (read(fd, &st, sizeof(st)) != sizeof(st)) {
+    st.magic = 0;
+  }
+  close(fd);
 
-  // Loop to send all the image data
-  while (1) {
-    // Get Status
-    tbuf[0] = CMD_STATUS_SIZE;
-    tbuf[1] = MCU_CMD_STATUS;// checksum same as data
-    tbuf[2] = MCU_CMD_STATUS;
+  if (st.magic != MCU_UPDATE_MAGIC || st.crc != crc ||
+      st.size != size || st.offset > size ||
+      st.bus != mcu_bus_id || st.addr != MCU_addr) {
+    return 0;
+  }
 
-    tcount = CMD_STATUS_SIZE;
+  // Download erases whole pages, so restart at the page holding offset;
+  // a finished transfer still needs a non-empty download before running
+  if (st.offset == size && size) {
+    st.offset--;
+  }
+  return st.offset & ~(MCU_FLASH_PAGE - 1);
+}
 
-    rcount = 5;
+static void
+mcu_save_offset(uint32_t crc, uint32_t size, uint32_t offset) {
+  mcu_update_state_t st = {MCU_UPDATE_MAGIC, crc, size, offset,
+                           mcu_bus_id, MCU_addr, 0};
+  int fd;
 
-    ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-      printf("i2c_rdwr_msg_transfer failed - MCU_CMD_STATUS\n");
-      goto error_exit;
-    }
+  fd = open(MCU_UPDATE_STATE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return;
+  }
+  if (write(fd, &st, sizeof(st)) != sizeof(st)) {
+    syslog(LOG_WARNING, "%s: cannot save update progress", __func__);
+  }
+  close(fd);
+}
 
-    if (rbuf[0] != 0x00 ||
-        rbuf[1] != 0xcc ||
-        rbuf[2] != 0x03 ||
-        rbuf[3] != 0x40 ||
-        rbuf[4] != 0x40) {
-      printf("status resp: %x:%x:%x:%x:%x", rbuf[0], rbuf[1], rbuf[2], rbuf[3], rbuf[4]);
-      goto error_exit;
-    }
+static int
+mcu_load_image(char *path, uint8_t **image, uint32_t *size) {
+  struct stat buf;
+  uint32_t done = 0;
+  int fd, n;
 
-    // Send ACK ---
-    tbuf[0] = 0xcc;
-    tcount = 1;
-    rcount = 0;
-    ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-      printf("i2c_rdwr_msg_transfer failed, Send ACK\n");
-      goto error_exit;
-    }
+  // Open the file exclusively for read
+  fd = open(path, O_RDONLY, 0666);
+  if (fd < 0) {
+    syslog(LOG_ERR, "%s(%d) : open fails for path: %s\n",
+          __func__, __LINE__, path);
+    return -1;
+  }
 
-    // send next packet
+  fstat(fd, &buf);
+  *size = buf.st_size;
+  *image = malloc(*size ? *size : 1);
+  if (*image == NULL) {
+    close(fd);
+    return -1;
+  }
 
-    xcount = read(fd, xbuf, MCU_PKT_MAX);
-    if (xcount <= 0) {
-#ifdef DEBUG
-      printf("read returns %d\n", xcount);
-#endif
-      break;
+  while (done < *size) {
+    n = read(fd, *image + done, *size - done);
+    if (n <= 0) {
+      free(*image);
+      close(fd);
+      return -1;
     }
-#ifdef DEBUG
-    printf("read returns %d bytes\n", xcount);
-#endif
+    done += n;
+  }
+  close(fd);
 
-    offset += xcount;
-    if((last_offset + dsize) <= offset) {
-       printf("updated debug card FW: %d %%\n", offset/dsize*5);
-       last_offset += dsize;
-    }
+  return 0;
+}
 
-    tbuf[0] = xcount + 3;
-    tbuf[1] = MCU_CMD_DATA;
-    tbuf[2] = MCU_CMD_DATA;
-    memcpy(&tbuf[3], xbuf, xcount);
+/*
+ * Download an image to the MCU through its bootloader. Data packets are
+ * sent back to back at the largest size the bootloader takes, each
+ * acknowledged in the same transfer, so a checksum or transport error is
+ * seen right away. The bootloader status, which reports programming
+ * errors, is checked once per MCU_STATUS_WINDOW bytes and at the end
+ * instead of per packet.
+ * The last good window is recorded in MCU_UPDATE_STATE so an interrupted
+ * update of the same image resumes from there while the card is still in
+ * its bootloader; otherwise the state is dropped and the update starts over.
+ */
+int
+usb_dbg_update_fw(char *path, uint8_t en_mcu_upd)
+{
+  int ifd = -1;
+  uint8_t *image = NULL;
+  uint8_t tbuf[8];
+  uint8_t ver[2];
+  uint32_t size;
+  uint32_t crc;
+  uint32_t offset;
+  uint32_t window;
+  uint32_t last_offset;
+  uint32_t dsize;
+  uint32_t addr;
+  uint8_t count;
+  long long end;
+  int ret = -1;
 
-    for (i = 0; i < xcount; i++) {
-      tbuf[1] += xbuf[i];
-    }
+  if (mcu_load_image(path, &image, &size)) {
+    return -1;
+  }
+  printf("size of file is %d bytes\n", size);
+  dsize = size / 20 ? size / 20 : 1;
+  crc = crc32(image, size);
+
+  offset = mcu_resume_offset(crc, size);
+  // Only a card still in its bootloader can be resumed, one answering in
+  // its runtime firmware was power cycled or swapped since
+  if (offset && !usb_dbg_get_fw_ver(0x00, ver)) {
+    printf("debug card runs FW %02x.%02x, not resuming\n", ver[0], ver[1]);
+    unlink(MCU_UPDATE_STATE);
+    offset = 0;
+  }
+  if (offset) {
+    printf("resuming debug card FW update at offset %u\n", offset);
+  }
 
-    tcount = tbuf[0];
-    rcount = 2;
+  // Open the i2c driver
+  ifd = mcu_open();
+  if (ifd < 0) {
+    syslog(LOG_WARNING, "%s(%d): i2c_open failed for bus#%d\n",
+            __func__, __LINE__, mcu_bus_id);
+    free(image);
+    return -1;
+  }
 
-    ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-    if (ret) {
-      printf("i2c_rdwr_msg_transfer error\n");
+  if (mcu_enter_boot(ifd, en_mcu_upd, offset != 0)) {
+    if (!offset) {
       goto error_exit;
     }
-
-    if (rbuf[0] != 0x00 || rbuf[1] != 0xcc) {
-      printf("data error: %x:%x\n", rbuf[0], rbuf[1]);
+    // The resume is dropped for a full update, so a card that is gone from
+    // the bootloader does not fail every later update the same way
+    printf("cannot resume, restarting the debug card FW update\n");
+    unlink(MCU_UPDATE_STATE);
+    offset = 0;
+    ipmbd_control("start");
+    if (mcu_enter_boot(ifd, en_mcu_upd, false)) {
       goto error_exit;
     }
   }
 
-  // Run the new image
-  tbuf[0] = CMD_RUN_SIZE;
-  tbuf[1] = 0x00; //checksum
-  tbuf[2] = MCU_CMD_RUN;
-  tbuf[3] = (MCU_FLASH_START >> 24) & 0xff;
-  tbuf[4] = (MCU_FLASH_START >> 16) & 0xff;
-  tbuf[5] = (MCU_FLASH_START >> 8) & 0xff;
-  tbuf[6] = (MCU_FLASH_START) & 0xff;
-
-  for (i = 2; i < CMD_RUN_SIZE; i++) {
-    tbuf[1] += tbuf[i];
+  // Start Bridge IC update(0x21), erasing from the first page to write
+  addr = MCU_FLASH_START + offset;
+  tbuf[0] = (addr >> 24) & 0xff;
+  tbuf[1] = (addr >> 16) & 0xff;
+  tbuf[2] = (addr >> 8) & 0xff;
+  tbuf[3] = (addr) & 0xff;
+  tbuf[4] = ((size - offset) >> 24) & 0xff;
+  tbuf[5] = ((size - offset) >> 16) & 0xff;
+  tbuf[6] = ((size - offset) >> 8) & 0xff;
+  tbuf[7] = (size - offset) & 0xff;
+  if (mcu_send_pkt(ifd, MCU_CMD_DOWNLOAD, tbuf, 8, false)) {
+    printf("i2c_rdwr_msg_transfer failed download\n");
+    unlink(MCU_UPDATE_STATE);
+    goto error_exit;
+  }
+  if (mcu_wait_ack(ifd, MCU_ERASE_TIMEOUT)) {
+    printf("download ack timed out\n");
+    unlink(MCU_UPDATE_STATE);
+    goto error_exit;
   }
 
-  tcount = CMD_RUN_SIZE;
+  window = offset;
+  last_offset = offset - offset % dsize;
+  while (offset < size) {
+    count = (size - offset > MCU_PKT_MAX) ? MCU_PKT_MAX : size - offset;
+    if (mcu_send_pkt(ifd, MCU_CMD_DATA, image + offset, count, true)) {
+      printf("data error at offset %u\n", offset);
+      goto error_exit;
+    }
+    offset += count;
 
-  rcount = 2;
+    if (offset - window >= MCU_STATUS_WINDOW || offset == size) {
+      if (mcu_get_status(ifd)) {
+        goto error_exit;
+      }
+      window = offset;
+      mcu_save_offset(crc, size, offset);
+    }
 
-  ret = i2c_rdwr_msg_transfer(ifd, MCU_addr, tbuf, tcount, rbuf, rcount);
-  if (ret) {
-    printf("i2c_rdwr_msg_transfer failed for run\n");
-    goto error_exit;
+    if((last_offset + dsize) <= offset) {
+       printf("updated debug card FW: %d %%\n", offset/dsize*5);
+       last_offset += dsize;
+    }
   }
 
-  if (rbuf[0] != 0x00 || rbuf[1] != 0xcc) {
-    printf("run response: %x:%x\n", rbuf[0], rbuf[1]);
+  // Run the new image
+  tbuf[0] = (MCU_FLASH_START >> 24) & 0xff;
+  tbuf[1] = (MCU_FLASH_START >> 16) & 0xff;
+  tbuf[2] = (MCU_FLASH_START >> 8) & 0xff;
+  tbuf[3] = (MCU_FLASH_START) & 0xff;
+  if (mcu_send_pkt(ifd, MCU_CMD_RUN, tbuf, 4, true)) {
+    printf("i2c_rdwr_msg_transfer failed for run\n");
     goto error_exit;
   }
+  unlink(MCU_UPDATE_STATE);
+  ret = 0;
 
 error_exit:
-  // Restart ipmbd daemon
-  memset(cmd, 0, sizeof(cmd));
-  sprintf(cmd, "sv start ipmbd_%d", mcu_bus_id);
-  system(cmd);
-
-error_exit2:
-  if (fd > 0) {
-    close(fd);
-  }
-  if (ifd > 0) {
-    close(ifd);
+  // Restart ipmb daemon
+  ipmbd_control("start");
+
+  // The update is only done once the new firmware answers
+  if (!ret) {
+    end = now_ms() + MCU_RUN_TIMEOUT;
+    while (usb_dbg_get_fw_ver(0x00, ver)) {
+      if (now_ms() >= end) {
+        printf("debug card FW does not respond after update\n");
+        ret = -1;
+        break;
+      }
+      msleep(100);
+    }
+    if (!ret) {
+      printf("debug card FW version %02x.%02x, image crc32 0x%08x\n",
+             ver[0], ver[1], crc);
+    }
   }
 
+  close(ifd);
+  free(image);
+
   return ret;
 }
 
@@ -412,6 +623,7 @@ update_MCU_bl_fw(uint8_t target, uint32_t offset, uint16_t len, uint8_t *buf)
   uint8_t tlen = 0;
   uint8_t rlen = 0;
   int retries = 3;
+  int delay = 100;
 
   req = (ipmb_req_t*)tbuf;
 
@@ -446,7 +658,8 @@ update_MCU_bl_fw(uint8_t target, uint32_t offset, uint16_t len, uint8_t *buf)
 bic_send:
   lib_ipmb_handle(mcu_bus_id, tbuf, tlen+1, rbuf, &rlen);
   if ((rlen == 0) && (retries--)) {
-    sleep(1);
+    msleep(delay);
+    delay *= 2;
     syslog(LOG_DEBUG, "%s(%d): target %d, offset: %d, len: %d retrying..\n", __func__, __LINE__, target, offset, len);
     goto bic_send;
   }
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
+#include <unistd.h>
 #include "sdr.h"
 
 #define FIELD_RATE_UNIT(x)  ((x & (0x07 << 3)) >> 3)
@@ -575,21 +576,15 @@ _sdr_get_snr_thresh(uint8_t fru, sdr_full_t *sdr, uint8_t snr_num,
   return 0;
 }
 
-int
-sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
+/* Load the SDRs of a FRU, retrying while the repository is not ready */
+static int
+sdr_load_fru(uint8_t fru, sensor_info_t *sinfo) {
 
-  int ret = 0;
-  sdr_full_t *sdr;
+  int ret;
 #ifdef DEBUG
   int cnt = 0;
 #endif /* DEBUG */
   int retry = 0;
-  char fpath[64] = {0};
-  char initpath[64] = {0};
-  char initflag[64] = {0};
-  char fru_name[8];
-
-  sensor_info_t sinfo[MAX_SENSOR_NUM] = {0};
 
   ret = pal_sensor_sdr_init(fru, sinfo);
 
@@ -597,7 +592,6 @@ sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
 
     if (retry++ > MAX_RETRIES_SDR_INIT) {
       syslog(LOG_INFO, "sdr_get_snr_thresh: failed for fru: %d", fru);
-
       return ERR_NOT_READY;
     }
 #ifdef DEBUG
@@ -607,37 +601,39 @@ sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
     ret = pal_sensor_sdr_init(fru, sinfo);
   }
 
-  if (ret < 0) {
-    sdr = NULL;
-  } else {
-    sdr = &sinfo[snr_num].sdr;
-  }
+  return ret;
+}
 
-  /* Set all the threshold options set in the flag */
-  snr->flag = GETMASK(SENSOR_VALID) | GETMASK(UCR_THRESH) |
-    GETMASK(UNC_THRESH) | GETMASK(UNR_THRESH) | GETMASK(LCR_THRESH) |
-    GETMASK(LNC_THRESH) | GETMASK(LNR_THRESH);
+/* Check whether the user override threshold file is in effect */
+static bool
+sdr_thresh_file_active(char *fru_name) {
+
+  char fpath[64] = {0};
+  char initpath[64] = {0};
 
-  ret = pal_get_fru_name(fru, fru_name);
-  if (ret < 0) {
-    printf("%s: Fail to get fru%d name\n", __func__, fru);
-    return -1;
-  }
-  
   sprintf(initpath, INIT_THRESHOLD_BIN, fru_name);
   if (0 == access(initpath, F_OK)) { // init done
     sprintf(fpath, THRESHOLD_BIN, fru_name);
     if (0 == access(fpath, F_OK)) {
-      ret = pal_get_thresh_from_file(fru, snr_num, snr);
-      if (0 != ret) {
-        syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
-        return -1;
-      }
-
-      return ret;
-    } 
+      return true;
+    }
   }
 
+  return false;
+}
+
+/* Populate the thresholds of a sensor from its SDR or the PAL defaults */
+static int
+sdr_fill_snr_thresh(uint8_t fru, sdr_full_t *sdr, uint8_t snr_num,
+    thresh_sensor_t *snr) {
+
+  int ret = 0;
+
+  /* Set all the threshold options set in the flag */
+  snr->flag = GETMASK(SENSOR_VALID) | GETMASK(UCR_THRESH) |
+    GETMASK(UNC_THRESH) | GETMASK(UNR_THRESH) | GETMASK(LCR_THRESH) |
+    GETMASK(LNC_THRESH) | GETMASK(LNR_THRESH);
+
   if (sdr != NULL) {
     ret = _sdr_get_snr_thresh(fru, sdr, snr_num, snr);
     if (ret < 0) {
@@ -684,3 +680,118 @@ sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
 
   return ret;
 }
+
+int
+sdr_get_snr_thresh(uint8_t fru, uint8_t snr_num, thresh_sensor_t *snr) {
+
+  int ret = 0;
+  sdr_full_t *sdr;
+  char fru_name[8];
+
+  sensor_info_t sinfo[MAX_SENSOR_NUM] = {0};
+
+  ret = sdr_load_fru(fru, sinfo);
+  if (ret == ERR_NOT_READY) {
+    return ERR_NOT_READY;
+  }
+
+  if (ret < 0) {
+    sdr = NULL;
+  } else {
+    sdr = &sinfo[snr_num].sdr;
+  }
+
+  ret = pal_get_fru_name(fru, fru_name);
+  if (ret < 0) {
+    printf("%s: Fail to get fru%d name\n", __func__, fru);
+    return -1;
+  }
+
+  if (sdr_thresh_file_active(fru_name)) {
+    ret = pal_get_thresh_from_file(fru, snr_num, snr);
+    if (0 != ret) {
+      syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
+      return -1;
+    }
+
+    return ret;
+  }
+
+  return sdr_fill_snr_thresh(fru, sdr, snr_num, snr);
+}
+
+/*
+ * Populate the thresholds of every sensor in snr_list with a single load of
+ * the FRU's SDRs and a single mapping of the threshold override table, instead
+ * of repeating both for each sensor as sdr_get_snr_thresh() does.
+ * status[i] receives the per-sensor result of snr[i].
+ */
+int
+sdr_get_snr_thresh_list(uint8_t fru, uint8_t *snr_list, int snr_cnt,
+    thresh_sensor_t *snr, int *status) {
+
+  int ret = 0;
+  int i;
+  int sensor_cnt;
+  uint8_t *sensor_list;
+  sdr_full_t *sdr;
+  char fru_name[8];
+  thresh_tbl_t *tbl = NULL;
+  size_t tbl_size = 0;
+  thresh_sensor_t *file_thresh = NULL;
+  int16_t file_idx[MAX_SENSOR_NUM + 1];
+
+  sensor_info_t sinfo[MAX_SENSOR_NUM] = {0};
+
+  ret = sdr_load_fru(fru, sinfo);
+  if (ret == ERR_NOT_READY) {
+    return ERR_NOT_READY;
+  }
+  sdr = (ret < 0) ? NULL : &sinfo[0].sdr;
+
+  ret = pal_get_fru_name(fru, fru_name);
+  if (ret < 0) {
+    printf("%s: Fail to get fru%d name\n", __func__, fru);
+    return -1;
+  }
+
+  memset(file_idx, 0xff, sizeof(file_idx));
+  if (sdr_thresh_file_active(fru_name)) {
+    // The override table holds one record per sensor in sensor list order
+    ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+    if (ret < 0) {
+      return ret;
+    }
+
+    tbl = pal_thresh_tbl_map(fru, SENSORD_MODE_TESTING, &tbl_size);
+    if (tbl == NULL) {
+      syslog(LOG_WARNING, "%s: Fail to get threshold from file for slot%d", __func__, fru);
+      return -1;
+    }
+    file_thresh = THRESH_TBL_ENTRY(tbl, 0);
+
+    for (i = 0; i < sensor_cnt && i < (int)tbl->count; i++) {
+      file_idx[sensor_list[i]] = i;
+    }
+  }
+
+  for (i = 0; i < snr_cnt; i++) {
+    if (file_thresh != NULL) {
+      if (file_idx[snr_list[i]] < 0) {
+        status[i] = -1;
+        continue;
+      }
+      memcpy(&snr[i], &file_thresh[file_idx[snr_list[i]]], sizeof(thresh_sensor_t));
+      status[i] = 0;
+      continue;
+    }
+
+    status[i] = sdr_fill_snr_thresh(fru, sdr ? &sinfo[snr_list[i]].sdr : NULL,
+                                    snr_list[i], &snr[i]);
+  }
+
+  if (tbl != NULL) {
+    pal_thresh_tbl_unmap(tbl, tbl_size);
+  }
+  return 0;
+}
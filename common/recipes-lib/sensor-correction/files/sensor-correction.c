@@ -24,6 +24,12 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <limits.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 #ifndef __TEST__
 #include <syslog.h>
 #endif
@@ -50,6 +56,8 @@
 
 #define MAX_NUM_CONDITIONS 32
 #define MAX_NUM_TABLES     32
+#define MAX_NUM_FRUS       256
+#define MAX_NUM_SENSORS    256
 
 typedef struct {
   char cond_value[MAX_VALUE_LEN];
@@ -63,7 +71,10 @@ typedef struct {
 
 typedef struct {
   size_t num;
+  /* Sorted by cond_value */
   correction_element_t *corr_table;
+  /* Distance between the points if they are evenly spaced, else 0 */
+  float step;
 } correction_table_t;
 
 typedef struct {
@@ -76,10 +87,29 @@ typedef struct {
   char    cond_key[MAX_KEY_LEN];
   size_t  value_map_size;
   value_map_element_t value_map[MAX_NUM_CONDITIONS];
+  /* Table chosen by the current value of cond_key */
+  size_t  table_idx;
+  bool    table_valid;
+  /* Watch on the cond_key file, -1 if none yet */
+  int     cond_wd;
 } sensor_correction_t;
 
-static sensor_correction_t *g_sensors = NULL;
-static size_t g_sensors_count = 0;
+typedef struct {
+  sensor_correction_t *sensors;
+  size_t count;
+  /* Per FRU map of sensor ID to index in sensors, -1 if none */
+  int16_t *index[MAX_NUM_FRUS];
+} correction_conf_t;
+
+static correction_conf_t *g_conf = NULL;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Watches on the condition keys and on the configuration
+ * file, -1 if not available */
+static int g_watch_fd = -1;
+static char g_conf_path[PATH_MAX];
+static char g_conf_name[NAME_MAX + 1];
+static char g_conf_target[NAME_MAX + 1];
 
 static int get_table(value_map_element_t *value_map, size_t num, char *value, size_t *idx)
 {
@@ -96,13 +126,83 @@ static int get_table(value_map_element_t *value_map, size_t num, char *value, si
 
 static sensor_correction_t *get_correction(uint8_t fru, uint8_t sensor_id)
 {
-  size_t i;
-  for(i = 0; i < g_sensors_count; i++) {
-    if (g_sensors[i].fru == fru && g_sensors[i].id == sensor_id) {
-      return &g_sensors[i];
+  int16_t *index;
+
+  if (!g_conf || !(index = g_conf->index[fru]) || index[sensor_id] < 0) {
+    return NULL;
+  }
+  return &g_conf->sensors[index[sensor_id]];
+}
+
+/* Sort the points (stable, so the later of equal points still wins)
+ * and check whether they are evenly spaced */
+static void compile_table(correction_table_t *tbl)
+{
+  correction_element_t e;
+  float step;
+  size_t i, j;
+
+  for (i = 1; i < tbl->num; i++) {
+    e = tbl->corr_table[i];
+    for (j = i; j > 0 && tbl->corr_table[j-1].cond_value > e.cond_value; j--) {
+      tbl->corr_table[j] = tbl->corr_table[j-1];
     }
+    tbl->corr_table[j] = e;
   }
-  return NULL;
+
+  tbl->step = 0;
+  if (tbl->num < 2) {
+    return;
+  }
+  step = (tbl->corr_table[tbl->num-1].cond_value - tbl->corr_table[0].cond_value) /
+    (tbl->num - 1);
+  if (step <= 0) {
+    return;
+  }
+  for (i = 1; i < tbl->num; i++) {
+    float expected = tbl->corr_table[0].cond_value + i * step;
+    if (tbl->corr_table[i].cond_value - expected > step / 1000 ||
+        expected - tbl->corr_table[i].cond_value > step / 1000) {
+      return;
+    }
+  }
+  tbl->step = step;
+}
+
+/* Index of the last point at or below cond_value, the
+ * first one if cond_value is below all of them */
+static size_t lookup_table(correction_table_t *tbl, float cond_value)
+{
+  correction_element_t *e = tbl->corr_table;
+  size_t lo, hi, mid;
+
+  if (cond_value < e[0].cond_value) {
+    return 0;
+  }
+
+  if (tbl->step > 0) {
+    float pos = (cond_value - e[0].cond_value) / tbl->step;
+    lo = pos >= tbl->num ? tbl->num - 1 : (size_t)pos;
+    /* Rounding may put us one point off */
+    if (lo + 1 < tbl->num && cond_value >= e[lo+1].cond_value) {
+      lo++;
+    } else if (lo > 0 && cond_value < e[lo].cond_value) {
+      lo--;
+    }
+    return lo;
+  }
+
+  lo = 0;
+  hi = tbl->num;
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (cond_value < e[mid].cond_value) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  return lo;
 }
 
 static int load_table(json_t *obj, correction_table_t *tbl)
@@ -124,6 +224,7 @@ static int load_table(json_t *obj, correction_table_t *tbl)
     if (!e || !json_is_array(e) || json_array_size(e) != 2) {
       DEBUG("Could not get correction: %zu\n", i);
       free(tbl->corr_table);
+      tbl->corr_table = NULL;
       return -1;
     }
     cond_value_o = json_array_get(e, 0);
@@ -133,11 +234,13 @@ static int load_table(json_t *obj, correction_table_t *tbl)
         !json_is_number(correction_o)) {
       DEBUG("Invalid value in index: %zu\n", i);
       free(tbl->corr_table);
+      tbl->corr_table = NULL;
       return -1;
     }
     tbl->corr_table[i].cond_value = get_float(cond_value_o);
     tbl->corr_table[i].correction = get_float(correction_o);
   }
+  compile_table(tbl);
   return 0;
 }
 
@@ -283,86 +386,278 @@ static int load_sensor_correction(json_t *obj, sensor_correction_t *snr)
   return ret;
 }
 
-int sensor_correction_init(const char *file)
+static void free_conf(correction_conf_t *conf)
 {
-  json_t *conf, *tmp;
+  size_t i, j;
+
+  if (!conf) {
+    return;
+  }
+  for (i = 0; i < conf->count; i++) {
+    for (j = 0; j < MAX_NUM_TABLES; j++) {
+      free(conf->sensors[i].tables[j].corr_table);
+    }
+  }
+  for (i = 0; i < MAX_NUM_FRUS; i++) {
+    free(conf->index[i]);
+  }
+  free(conf->sensors);
+  free(conf);
+}
+
+/* Build the (fru, sensor ID) to correction map */
+static int index_conf(correction_conf_t *conf)
+{
+  size_t i;
+
+  for (i = 0; i < conf->count; i++) {
+    sensor_correction_t *snr = &conf->sensors[i];
+    int16_t *index = conf->index[snr->fru];
+
+    if (!index) {
+      index = malloc(MAX_NUM_SENSORS * sizeof(int16_t));
+      if (!index) {
+        return -1;
+      }
+      memset(index, 0xFF, MAX_NUM_SENSORS * sizeof(int16_t));
+      conf->index[snr->fru] = index;
+    }
+    /* The first definition of a sensor is the one used */
+    if (index[snr->id] < 0) {
+      index[snr->id] = (int16_t)i;
+    }
+  }
+  return 0;
+}
+
+static correction_conf_t *load_conf(const char *file)
+{
+  correction_conf_t *conf;
+  json_t *root, *tmp;
   json_error_t error;
   size_t i;
 
-  conf = json_load_file(file, 0, &error);
+  root = json_load_file(file, 0, &error);
+  if (!root) {
+    return NULL;
+  }
+  conf = calloc(1, sizeof(correction_conf_t));
   if (!conf) {
-    return -1;
+    json_decref(root);
+    return NULL;
   }
-  tmp = json_object_get(conf, "version");
+  tmp = json_object_get(root, "version");
   if (tmp && json_is_string(tmp)) {
-    INFO("Loaded sensor correction configuration version: %s\n", 
+    INFO("Loaded sensor correction configuration version: %s\n",
         json_string_value(tmp));
   }
-  tmp = json_object_get(conf, "sensors");
+  tmp = json_object_get(root, "sensors");
   if (!tmp || !json_is_array(tmp)) {
     DEBUG("Failed to get sensors");
-    return -1;
+    goto bail;
   }
-  g_sensors_count = json_array_size(tmp);
-  if (!g_sensors_count) {
+  conf->count = json_array_size(tmp);
+  if (!conf->count) {
     DEBUG("No sensors found in configuration");
-    return 0;
+    json_decref(root);
+    return conf;
+  }
+  if (conf->count > INT16_MAX) {
+    DEBUG("Unsupported number of sensors: %zu\n", conf->count);
+    conf->count = 0;
+    goto bail;
   }
-  g_sensors = calloc(g_sensors_count, sizeof(sensor_correction_t));
-  if (!g_sensors) {
-    g_sensors_count = 0;
+  conf->sensors = calloc(conf->count, sizeof(sensor_correction_t));
+  if (!conf->sensors) {
+    conf->count = 0;
     DEBUG("Allocation failure!\n");
-    return -1;
+    goto bail;
   }
 
-  for (i = 0; i < g_sensors_count; i++) {
+  for (i = 0; i < conf->count; i++) {
     json_t *s_o = json_array_get(tmp, i);
     if (!s_o) {
       DEBUG("Getting sensor[%zu] failed", i);
       goto bail;
     }
-    if (load_sensor_correction(s_o, &g_sensors[i])) {
+    if (load_sensor_correction(s_o, &conf->sensors[i])) {
       DEBUG("Loading sensor correction for sensor %zu failed!\n", i);
       goto bail;
     }
+    conf->sensors[i].cond_wd = -1;
   }
-  json_decref(conf);
-  return 0;
+  if (index_conf(conf)) {
+    goto bail;
+  }
+  json_decref(root);
+  return conf;
 bail:
-  free(g_sensors);
-  json_decref(conf);
-  g_sensors = NULL;
-  g_sensors_count = 0;
-  return -1;
+  free_conf(conf);
+  json_decref(root);
+  return NULL;
+}
+
+/* Set up the watches on the configuration file, which may be a
+ * symbolic link to the real one. The condition keys are watched
+ * one by one as they are first used, not the whole cache store:
+ * sensord writes there for every reading */
+static void watch_init(const char *file)
+{
+  char path[PATH_MAX];
+  char real[PATH_MAX];
+
+  if (g_watch_fd < 0) {
+    g_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_watch_fd < 0) {
+      INFO("sensor-correction: inotify_init failed, polling conditions\n");
+      return;
+    }
+  }
+
+  if (file != g_conf_path) {
+    strncpy(g_conf_path, file, sizeof(g_conf_path) - 1);
+  }
+  strncpy(path, file, sizeof(path) - 1);
+  path[sizeof(path) - 1] = '\0';
+  strncpy(g_conf_name, basename(path), sizeof(g_conf_name) - 1);
+  strncpy(path, file, sizeof(path) - 1);
+  inotify_add_watch(g_watch_fd, dirname(path),
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+  g_conf_target[0] = '\0';
+  if (realpath(file, real)) {
+    strcpy(path, real);
+    strncpy(g_conf_target, basename(path), sizeof(g_conf_target) - 1);
+    strcpy(path, real);
+    inotify_add_watch(g_watch_fd, dirname(path), IN_CLOSE_WRITE | IN_MOVED_TO);
+  }
+}
+
+/* Replace the configuration, the old one is kept if the new one
+ * does not load. Called with g_lock held */
+static int reload_conf(const char *file)
+{
+  correction_conf_t *conf = load_conf(file);
+
+  if (!conf) {
+    return -1;
+  }
+  free_conf(g_conf);
+  g_conf = conf;
+  return 0;
+}
+
+/* Mark the sensors conditional on the key file watched by wd (all
+ * if -1) for a new look up. Once the file is gone so is the watch */
+static void invalidate_tables(int wd, bool removed)
+{
+  size_t i;
+
+  if (!g_conf) {
+    return;
+  }
+  for (i = 0; i < g_conf->count; i++) {
+    if (wd < 0 || g_conf->sensors[i].cond_wd == wd) {
+      g_conf->sensors[i].table_valid = false;
+      if (removed) {
+        g_conf->sensors[i].cond_wd = -1;
+      }
+    }
+  }
+}
+
+/* Watch the condition key of a sensor before its value is read, so
+ * no write after the read goes unnoticed */
+static void watch_cond_key(sensor_correction_t *snr)
+{
+  char kpath[MAX_KEY_PATH_LEN];
+
+  if (g_watch_fd < 0 || snr->cond_wd >= 0) {
+    return;
+  }
+  snprintf(kpath, sizeof(kpath), CACHE_STORE, snr->cond_key);
+  snr->cond_wd = inotify_add_watch(g_watch_fd, kpath,
+      IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+}
+
+/* Drain the pending events. Called with g_lock held */
+static void watch_poll(void)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct inotify_event *ev;
+  bool reload = false;
+  ssize_t len;
+  char *ptr;
+
+  while ((len = read(g_watch_fd, buf, sizeof(buf))) > 0) {
+    for (ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len) {
+      ev = (struct inotify_event *)ptr;
+      if (ev->mask & IN_Q_OVERFLOW) {
+        invalidate_tables(-1, false);
+      } else if (!ev->len) {
+        /* Events of a condition key file */
+        invalidate_tables(ev->wd, ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF));
+      } else if (!strcmp(ev->name, g_conf_name) ||
+          (g_conf_target[0] && !strcmp(ev->name, g_conf_target))) {
+        reload = true;
+      }
+    }
+  }
+
+  if (reload) {
+    if (reload_conf(g_conf_path)) {
+      INFO("Reloading %s failed, keeping the current configuration\n", g_conf_path);
+    } else {
+      INFO("Reloaded sensor correction configuration %s\n", g_conf_path);
+      /* The configuration may now point to another file */
+      watch_init(g_conf_path);
+    }
+  }
+}
+
+int sensor_correction_init(const char *file)
+{
+  int ret;
+
+  pthread_mutex_lock(&g_lock);
+  ret = reload_conf(file);
+  if (ret == 0) {
+    watch_init(file);
+  }
+  pthread_mutex_unlock(&g_lock);
+  return ret;
 }
 
 int sensor_correction_apply(uint8_t fru, uint8_t sensor_id, float cond_value, float *sensor_reading)
 {
   char value[MAX_VALUE_LEN];
-  size_t table_idx = 0;
   correction_table_t *table;
-  size_t i;
-  float correction;
+  sensor_correction_t *snr;
 
-  sensor_correction_t *snr = get_correction(fru, sensor_id);
+  pthread_mutex_lock(&g_lock);
+  if (g_watch_fd >= 0) {
+    watch_poll();
+  }
+  snr = get_correction(fru, sensor_id);
   if (!snr) {
     /* No correction defined for this sensor. Return success without
      * manipulating it */
+    pthread_mutex_unlock(&g_lock);
     return 0;
   }
-  if (edb_cache_get(snr->cond_key, value) ||
-      get_table(snr->value_map, snr->value_map_size, value, &table_idx)) {
-    table_idx = snr->default_table;
-  }
-  table = &snr->tables[table_idx];
-  correction = table->corr_table[0].correction;
-  for (i = 0; i < table->num; i++) {
-    if (cond_value < table->corr_table[i].cond_value) {
-      break;
+  /* The table is only chosen again after the key changed */
+  if (!snr->table_valid) {
+    watch_cond_key(snr);
+    if (edb_cache_get(snr->cond_key, value) ||
+        get_table(snr->value_map, snr->value_map_size, value, &snr->table_idx)) {
+      snr->table_idx = snr->default_table;
     }
-    correction = table->corr_table[i].correction;
+    /* Without a watch (no key file yet) look again next time */
+    snr->table_valid = snr->cond_wd >= 0;
   }
-  *sensor_reading = *sensor_reading - correction;
+  table = &snr->tables[snr->table_idx];
+  *sensor_reading = *sensor_reading - table->corr_table[lookup_table(table, cond_value)].correction;
+  pthread_mutex_unlock(&g_lock);
   return 0;
 }
 
@@ -20,167 +20,518 @@
 #include <gio/gio.h>
 #include <openbmc/pal.h>
 #include <syslog.h>
+#include <stdbool.h>
+#include <string.h>
 #include "sensor-svc-client.h"
 #include <stdio.h>
 
-//proxy to DBus objects are stored to optimize performance
-static GDBusProxy* _proxy_sensor_service = NULL;
-static GDBusProxy* _proxy_fru[MAX_NUM_FRUS] = {NULL};
-static GDBusProxy* _proxy_sensor[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {NULL};
-
-static GDBusProxy*
-get_dbus_proxy(const char* path, const char* interface) {
-  GError* error = NULL;
-  GDBusProxy* proxy = g_dbus_proxy_new_for_bus_sync(
-                      G_BUS_TYPE_SYSTEM,
-                      G_DBUS_PROXY_FLAGS_NONE,
-                      NULL,
-                      SENSOR_SVC_DBUS_NAME,
-                      path,
-                      interface,
-                      NULL,
-                      &error);
+// Object paths are resolved once and the calls are made directly on the
+// shared system bus connection; no proxies, so no introspection and no
+// per-object match rules. A library thread runs a private main context
+// that receives the valueChanged signals of sensor-svc and keeps a local
+// copy of the last status and value of every sensor for sensor_svc_read().
 
-  if (error != NULL) {
-    syslog(LOG_ERR, "DBus error in setting proxy for object %s at inteface %s", path, interface);
+#define SENSOR_SVC_CALL_TIMEOUT 5000 // ms
+
+typedef struct {
+  float value;
+  int status;
+  bool valid;
+} sensor_value_t;
+
+typedef struct {
+  uint8_t fru;
+  gchar *path;
+  GVariant *ids;
+} batch_request_t;
+
+static GMutex m_client;
+static GDBusConnection *_conn = NULL;
+static GMainContext *_context = NULL;
+static bool _watching = false;  // signals are received, cache is kept current
+static gchar *_path_fru[MAX_NUM_FRUS+1] = {NULL};
+static gchar *_path_sensor[MAX_NUM_FRUS+1][MAX_SENSOR_NUM+1] = {{NULL}};
+static bool _fru_cached[MAX_NUM_FRUS+1] = {false};
+static sensor_value_t _value[MAX_NUM_FRUS+1][MAX_SENSOR_NUM+1];
+
+// Forget paths and values of a FRU, call with m_client held
+static void
+reset_fru(uint8_t fru) {
+  int i;
+
+  g_free(_path_fru[fru]);
+  _path_fru[fru] = NULL;
+  for (i = 0; i <= MAX_SENSOR_NUM; i++) {
+    g_free(_path_sensor[fru][i]);
+    _path_sensor[fru][i] = NULL;
+    _value[fru][i].valid = false;
   }
-  return proxy;
+  _fru_cached[fru] = false;
 }
 
-// function to get proxy to DBUS FRU Object based on fru
-static GDBusProxy*
-get_proxy_fruobject (uint8_t fru){
-  GVariant *response;
-  const gchar* fruPath;
-  GError *error = NULL;
+static void
+reset_all(void) {
+  int fru;
 
-  if (_proxy_sensor_service == NULL) {
-    _proxy_sensor_service = get_dbus_proxy(SENSOR_SVC_BASE_PATH, SENSOR_SVC_SENSOR_TREE_INTERFACE);
-    if (_proxy_sensor_service == NULL) {
-      return NULL;
-    }
+  g_mutex_lock(&m_client);
+  for (fru = 0; fru <= MAX_NUM_FRUS; fru++) {
+    reset_fru(fru);
   }
+  g_mutex_unlock(&m_client);
+}
+
+static void
+store_value(uint8_t fru, uint8_t sensor_num, int status, gdouble value) {
+  if (fru > MAX_NUM_FRUS) {
+    return;
+  }
+  g_mutex_lock(&m_client);
+  _value[fru][sensor_num].status = status;
+  _value[fru][sensor_num].value = value;
+  _value[fru][sensor_num].valid = true;
+  g_mutex_unlock(&m_client);
+}
 
-  //create proxy to FRU object if not yet created
-  if (_proxy_fru[fru] == NULL) {
-    // Get fru path from sensor service
-    response = g_dbus_proxy_call_sync(
-        _proxy_sensor_service,
-        "org.openbmc.SensorTree.getFruPathById",
-        g_variant_new ("(y)", fru),
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
+static void
+on_value_changed(GDBusConnection *conn, const gchar *sender,
+                 const gchar *path, const gchar *interface,
+                 const gchar *signal, GVariant *params, gpointer data) {
+  guint8 fru, sensor_num;
+  gint status;
+  gdouble value;
+
+  g_variant_get(params, "(yyid)", &fru, &sensor_num, &status, &value);
+  store_value(fru, sensor_num, status, value);
+}
+
+// sensor-svc (re)started or went away, its objects and values are gone
+static void
+on_name_appeared(GDBusConnection *conn, const gchar *name,
+                 const gchar *owner, gpointer data) {
+  reset_all();
+}
 
+static void
+on_name_vanished(GDBusConnection *conn, const gchar *name, gpointer data) {
+  reset_all();
+}
+
+static gpointer
+client_thread(gpointer data) {
+  GMainLoop *loop;
+
+  // Signal and async call callbacks are dispatched in this context
+  g_main_context_push_thread_default(_context);
+
+  g_dbus_connection_signal_subscribe(_conn,
+                                     SENSOR_SVC_DBUS_NAME,
+                                     SENSOR_SVC_SENSOR_OBJECT_INTERFACE,
+                                     "valueChanged",
+                                     NULL,
+                                     NULL,
+                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                     on_value_changed,
+                                     NULL,
+                                     NULL);
+  g_bus_watch_name_on_connection(_conn,
+                                 SENSOR_SVC_DBUS_NAME,
+                                 G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                 on_name_appeared,
+                                 on_name_vanished,
+                                 NULL,
+                                 NULL);
+
+  g_mutex_lock(&m_client);
+  _watching = true;
+  g_mutex_unlock(&m_client);
+
+  loop = g_main_loop_new(_context, FALSE);
+  g_main_loop_run(loop);
+
+  return NULL;
+}
+
+static GDBusConnection*
+get_connection(void) {
+  static gsize init = 0;
+  GError *error = NULL;
+
+  if (g_once_init_enter(&init)) {
+    _conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
     if (error != NULL) {
-      syslog (LOG_ERR, "DBUS error in get_proxy_fruobject fru %d, %s", fru, error->message);
-      g_object_unref(_proxy_sensor_service);
-      _proxy_sensor_service = NULL; // Proxy to sensor service not working, reset
-      return NULL;
+      syslog(LOG_ERR, "DBus error in connecting to system bus, %s", error->message);
+      g_error_free(error);
+    } else {
+      _context = g_main_context_new();
+      g_thread_unref(g_thread_new("sensor-svc-client", client_thread, NULL));
     }
+    g_once_init_leave(&init, 1);
+  }
 
-    g_variant_get(response, "(&s)", &fruPath);
+  return _conn;
+}
+
+static GVariant*
+call_sync(const gchar *path, const gchar *interface, const gchar *method,
+          GVariant *params, const gchar *reply_type) {
+  GDBusConnection *conn;
+  GVariant *response;
+  GError *error = NULL;
 
-    if ((fruPath == NULL) || (fruPath[0] == '\0')) {
-      syslog (LOG_ERR, "Could not locate fru %d", fru);
-      return NULL;
+  if ((conn = get_connection()) == NULL) {
+    if (params != NULL) {
+      g_variant_unref(g_variant_ref_sink(params));
     }
+    return NULL;
+  }
 
-    _proxy_fru[fru] = get_dbus_proxy(fruPath, SENSOR_SVC_SENSOR_TREE_INTERFACE);
-    g_variant_unref(response);
+  response = g_dbus_connection_call_sync(
+      conn,
+      SENSOR_SVC_DBUS_NAME,
+      path,
+      interface,
+      method,
+      params,
+      G_VARIANT_TYPE(reply_type),
+      G_DBUS_CALL_FLAGS_NONE,
+      SENSOR_SVC_CALL_TIMEOUT,
+      NULL,
+      &error);
 
+  if (error != NULL) {
+    syslog(LOG_ERR, "DBUS error in %s on %s, %s", method, path, error->message);
+    g_error_free(error);
+    return NULL;
   }
-  return _proxy_fru[fru];
+
+  return response;
 }
 
-// function to get proxy to DBUS Sensor Object based on fru and sensor_num
-static GDBusProxy*
-get_proxy_sensorobject (uint8_t fru, uint8_t sensor_num){
-  GDBusProxy* fruProxy;
-  GError* error = NULL;
-  const gchar* sensorPath;
+// Get the path of a FRU object, caller frees the returned string
+static gchar*
+get_fru_path(uint8_t fru) {
   GVariant *response;
+  const gchar *fruPath;
+  gchar *path;
 
-  //create proxy to sensor object if not yet created
-  if (_proxy_sensor[fru][sensor_num] == NULL) {
-
-    if ((fruProxy = get_proxy_fruobject(fru)) != NULL) {
-      // Get sensor path from fru
-      response = g_dbus_proxy_call_sync(
-          fruProxy,
-          "org.openbmc.SensorTree.getSensorPathById",
-          g_variant_new ("(y)", sensor_num),
-          G_DBUS_CALL_FLAGS_NONE,
-          -1,
-          NULL,
-          &error);
-
-      if (error != NULL) {
-        syslog (LOG_ERR, "DBUS error in get_proxy_sensorobject fru %d sensor %d, %s", fru, sensor_num, error->message);
-        g_object_unref(_proxy_fru[fru]);
-        _proxy_fru[fru] = NULL; // Proxy to FRU not working, reset
-        return NULL;
-      }
+  if (fru > MAX_NUM_FRUS) {
+    return NULL;
+  }
 
-      g_variant_get(response, "(&s)", &sensorPath);
+  g_mutex_lock(&m_client);
+  path = g_strdup(_path_fru[fru]);
+  g_mutex_unlock(&m_client);
+  if (path != NULL) {
+    return path;
+  }
 
-      if ((sensorPath == NULL) || (sensorPath[0] == '\0')) {
-        syslog (LOG_ERR, "Could not locate sensor %d", sensor_num);
-        return NULL;
-      }
+  // Get fru path from sensor service
+  response = call_sync(SENSOR_SVC_BASE_PATH, SENSOR_SVC_SENSOR_TREE_INTERFACE,
+                       "getFruPathById", g_variant_new("(y)", fru), "(s)");
+  if (response == NULL) {
+    return NULL;
+  }
 
-      _proxy_sensor[fru][sensor_num] = get_dbus_proxy(sensorPath, SENSOR_SVC_SENSOR_OBJECT_INTERFACE);
-      g_variant_unref(response);
+  g_variant_get(response, "(&s)", &fruPath);
+  if (fruPath[0] == '\0') {
+    syslog(LOG_ERR, "Could not locate fru %d", fru);
+  } else {
+    path = g_strdup(fruPath);
+    g_mutex_lock(&m_client);
+    if (_path_fru[fru] == NULL) {
+      _path_fru[fru] = g_strdup(path);
     }
+    g_mutex_unlock(&m_client);
   }
-  return _proxy_sensor[fru][sensor_num];
+  g_variant_unref(response);
+
+  return path;
 }
 
-static int
-sensor_read(uint8_t fru, uint8_t sensor_num, float *value, const char* method) {
-  GDBusProxy* proxy = NULL;
-  int readStatus;
+// Get the path of a sensor object, caller frees the returned string
+static gchar*
+get_sensor_path(uint8_t fru, uint8_t sensor_num) {
   GVariant *response;
-  GError *error = NULL;
-  gdouble val;
+  const gchar *sensorPath;
+  gchar *fruPath;
+  gchar *path;
 
-  //create proxy to sensor object if not yet is created
-  if ((proxy = get_proxy_sensorobject(fru, sensor_num)) != NULL) {
-    response = g_dbus_proxy_call_sync(
-        proxy,
-        method,
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
+  if ((fruPath = get_fru_path(fru)) == NULL) {
+    return NULL;
+  }
 
-    if (error != NULL) {
-      syslog (LOG_ERR, "DBUS error in sensorRead senor_num %d, %s", sensor_num, error->message);
-      g_object_unref(_proxy_sensor[fru][sensor_num]);
-      _proxy_sensor[fru][sensor_num] = NULL; // Proxy to Sensor not working, reset
-      return -1;
+  g_mutex_lock(&m_client);
+  path = g_strdup(_path_sensor[fru][sensor_num]);
+  g_mutex_unlock(&m_client);
+  if (path != NULL) {
+    g_free(fruPath);
+    return path;
+  }
+
+  // Get sensor path from fru
+  response = call_sync(fruPath, SENSOR_SVC_SENSOR_TREE_INTERFACE,
+                       "getSensorPathById", g_variant_new("(y)", sensor_num),
+                       "(s)");
+  g_free(fruPath);
+  if (response == NULL) {
+    return NULL;
+  }
+
+  g_variant_get(response, "(&s)", &sensorPath);
+  if (sensorPath[0] == '\0') {
+    syslog(LOG_ERR, "Could not locate sensor %d", sensor_num);
+  } else {
+    path = g_strdup(sensorPath);
+    g_mutex_lock(&m_client);
+    if (_path_sensor[fru][sensor_num] == NULL) {
+      _path_sensor[fru][sensor_num] = g_strdup(path);
     }
+    g_mutex_unlock(&m_client);
+  }
+  g_variant_unref(response);
 
-    g_variant_get(response, "(id)", &readStatus, &val);
-    g_variant_unref(response);
-    if (readStatus == 0) {
-      *value = val;
+  return path;
+}
+
+// Object paths of the FRU may be stale, resolve them again on next use
+static void
+forget_fru(uint8_t fru) {
+  g_mutex_lock(&m_client);
+  reset_fru(fru);
+  g_mutex_unlock(&m_client);
+}
+
+// Fill the local copy of all sensor values of a FRU with one call
+static int
+load_fru(uint8_t fru) {
+  GVariant *response;
+  GVariantIter *iter;
+  const gchar *name, *unit;
+  guint8 id;
+  gint status;
+  gdouble value;
+  gchar *path;
+
+  if ((path = get_fru_path(fru)) == NULL) {
+    return -1;
+  }
+
+  response = call_sync(path, SENSOR_SVC_SENSOR_TREE_INTERFACE,
+                       "getSensorObjects", NULL, "(a(syids))");
+  g_free(path);
+  if (response == NULL) {
+    forget_fru(fru);
+    return -1;
+  }
+
+  g_variant_get(response, "(a(syids))", &iter);
+  g_mutex_lock(&m_client);
+  while (g_variant_iter_loop(iter, "(&syid&s)", &name, &id, &status, &value, &unit)) {
+    if (!_value[fru][id].valid) {
+      _value[fru][id].status = status;
+      _value[fru][id].value = value;
+      _value[fru][id].valid = true;
     }
+  }
+  _fru_cached[fru] = true;
+  g_mutex_unlock(&m_client);
+  g_variant_iter_free(iter);
+  g_variant_unref(response);
+
+  return 0;
+}
+
+static int
+sensor_read(uint8_t fru, uint8_t sensor_num, float *value, const char* method) {
+  GVariant *response;
+  gint readStatus;
+  gdouble val;
+  gchar *path;
+
+  if ((path = get_sensor_path(fru, sensor_num)) == NULL) {
+    return -1;
+  }
+
+  response = call_sync(path, SENSOR_SVC_SENSOR_OBJECT_INTERFACE, method,
+                       NULL, "(id)");
+  g_free(path);
+  if (response == NULL) {
+    forget_fru(fru);
+    return -1;
+  }
 
-    return readStatus;
+  g_variant_get(response, "(id)", &readStatus, &val);
+  g_variant_unref(response);
+  store_value(fru, sensor_num, readStatus, val);
+  if (readStatus == 0) {
+    *value = val;
   }
 
-  return -1;
+  return readStatus;
 }
 
 int
 sensor_svc_raw_read(uint8_t fru, uint8_t sensor_num, float *value) {
-  return sensor_read(fru, sensor_num, value, "org.openbmc.SensorObject.sensorRawRead");
+  return sensor_read(fru, sensor_num, value, "sensorRawRead");
 }
 
 int
 sensor_svc_read(uint8_t fru, uint8_t sensor_num, float *value) {
-  return sensor_read(fru, sensor_num, value, "org.openbmc.SensorObject.sensorRead");
+  sensor_value_t v = {0};
+  bool watching, cached;
+
+  if (fru > MAX_NUM_FRUS || get_connection() == NULL) {
+    return -1;
+  }
+
+  g_mutex_lock(&m_client);
+  watching = _watching;
+  cached = _fru_cached[fru];
+  g_mutex_unlock(&m_client);
+
+  // The local copy is only current while the signals are received
+  if (watching) {
+    if (!cached) {
+      load_fru(fru);
+    }
+    g_mutex_lock(&m_client);
+    v = _value[fru][sensor_num];
+    g_mutex_unlock(&m_client);
+    if (v.valid) {
+      if (v.status == 0) {
+        *value = v.value;
+      }
+      return v.status;
+    }
+  }
+
+  return sensor_read(fru, sensor_num, value, "sensorRead");
+}
+
+static GVariant*
+new_sensor_ids(const uint8_t *sensor_nums, int cnt) {
+  return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, sensor_nums, cnt,
+                                   sizeof(uint8_t));
+}
+
+// Store the a(yid) reply of getSensorValues in the local copy and
+// optionally in values/status in request order
+static void
+store_values(uint8_t fru, GVariant *response, float *values, int *status,
+             int cnt) {
+  GVariantIter *iter;
+  guint8 id;
+  gint readStatus;
+  gdouble val;
+  int i = 0;
+
+  g_variant_get(response, "(a(yid))", &iter);
+  while (g_variant_iter_loop(iter, "(yid)", &id, &readStatus, &val)) {
+    store_value(fru, id, readStatus, val);
+    if (i < cnt) {
+      if (status != NULL) {
+        status[i] = readStatus;
+      }
+      if (values != NULL && readStatus == 0) {
+        values[i] = val;
+      }
+      i++;
+    }
+  }
+  g_variant_iter_free(iter);
+}
+
+int
+sensor_svc_raw_read_batch(uint8_t fru, const uint8_t *sensor_nums, int cnt,
+                          float *values, int *status) {
+  GVariant *response;
+  gchar *path;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    status[i] = -1;
+  }
+
+  if ((path = get_fru_path(fru)) == NULL) {
+    return -1;
+  }
+
+  response = call_sync(path, SENSOR_SVC_SENSOR_TREE_INTERFACE,
+                       "getSensorValues",
+                       g_variant_new("(@ay)", new_sensor_ids(sensor_nums, cnt)),
+                       "(a(yid))");
+  g_free(path);
+  if (response == NULL) {
+    forget_fru(fru);
+    return -1;
+  }
+
+  store_values(fru, response, values, status, cnt);
+  g_variant_unref(response);
+
+  return 0;
+}
+
+static void
+on_batch_reply(GObject *source, GAsyncResult *res, gpointer data) {
+  batch_request_t *req = data;
+  GVariant *response;
+  GError *error = NULL;
+
+  response = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+  if (error != NULL) {
+    syslog(LOG_ERR, "DBUS error in getSensorValues on %s, %s", req->path, error->message);
+    g_error_free(error);
+    forget_fru(req->fru);
+  } else {
+    store_values(req->fru, response, NULL, NULL, 0);
+    g_variant_unref(response);
+  }
+
+  g_variant_unref(req->ids);
+  g_free(req->path);
+  g_free(req);
+}
+
+// Runs in the library thread so that the reply is dispatched there
+static gboolean
+send_batch(gpointer data) {
+  batch_request_t *req = data;
+
+  g_dbus_connection_call(_conn,
+                         SENSOR_SVC_DBUS_NAME,
+                         req->path,
+                         SENSOR_SVC_SENSOR_TREE_INTERFACE,
+                         "getSensorValues",
+                         g_variant_new("(@ay)", req->ids),
+                         G_VARIANT_TYPE("(a(yid))"),
+                         G_DBUS_CALL_FLAGS_NONE,
+                         SENSOR_SVC_CALL_TIMEOUT,
+                         NULL,
+                         on_batch_reply,
+                         req);
+
+  return G_SOURCE_REMOVE;
+}
+
+int
+sensor_svc_request_batch(uint8_t fru, const uint8_t *sensor_nums, int cnt) {
+  batch_request_t *req;
+  GSource *source;
+  gchar *path;
+
+  if ((path = get_fru_path(fru)) == NULL) {
+    return -1;
+  }
+
+  req = g_new0(batch_request_t, 1);
+  req->fru = fru;
+  req->path = path;
+  req->ids = g_variant_ref_sink(new_sensor_ids(sensor_nums, cnt));
+  source = g_idle_source_new();
+  g_source_set_callback(source, send_batch, req, NULL);
+  g_source_attach(source, _context);
+  g_source_unref(source);
+
+  return 0;
 }
@@ -35,6 +35,16 @@ extern "C" {
 extern int sensor_svc_raw_read(uint8_t fru, uint8_t sensor_num, float *value);
 extern int sensor_svc_read(uint8_t fru, uint8_t sensor_num, float *value);
 
+// Read cnt sensors of a FRU with one call, status[i] and values[i] are
+// filled in the order of sensor_nums. Readings younger than the cache
+// time of sensor-svc are not read from the hardware again.
+extern int sensor_svc_raw_read_batch(uint8_t fru, const uint8_t *sensor_nums,
+                                     int cnt, float *values, int *status);
+// Same as sensor_svc_raw_read_batch but returns right away, the readings
+// are picked up by later sensor_svc_read() calls
+extern int sensor_svc_request_batch(uint8_t fru, const uint8_t *sensor_nums,
+                                    int cnt);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
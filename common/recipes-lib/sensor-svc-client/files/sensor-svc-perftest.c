@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "sensor-svc-client.h"
+
+// measure throughput and latency of the sensor-svc client calls,
+// in the same way as dbus-latencytest of dbus-perftest
+
+#define MAX_BATCH 256
+
+static uint8_t fru;
+static uint8_t sensors[MAX_BATCH];
+static int cnt;
+
+static int
+cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// mode 0: sensor_svc_raw_read per sensor
+// mode 1: sensor_svc_raw_read_batch of all sensors
+// mode 2: sensor_svc_read per sensor
+static int
+do_reads(int mode) {
+  float values[MAX_BATCH];
+  int status[MAX_BATCH];
+  int i;
+
+  switch (mode) {
+    case 0:
+      for (i = 0; i < cnt; i++) {
+        if (sensor_svc_raw_read(fru, sensors[i], &values[i]) < 0)
+          return -1;
+      }
+      break;
+    case 1:
+      if (sensor_svc_raw_read_batch(fru, sensors, cnt, values, status))
+        return -1;
+      break;
+    default:
+      for (i = 0; i < cnt; i++) {
+        if (sensor_svc_read(fru, sensors[i], &values[i]) < 0)
+          return -1;
+      }
+      break;
+  }
+
+  return 0;
+}
+
+static int
+run(const char *name, int mode, int iteration) {
+  double *lat = malloc(iteration * sizeof(double));
+  double total = 0;
+  int i;
+
+  if (lat == NULL) {
+    return 1;
+  }
+
+  // first round resolves the object paths
+  do_reads(mode);
+
+  for (i = 0; i < iteration; i++) {
+    gint64 t1 = g_get_monotonic_time();
+    if (do_reads(mode)) {
+      printf("%s: read failed\n", name);
+      free(lat);
+      return 1;
+    }
+    lat[i] = g_get_monotonic_time() - t1;
+    total += lat[i];
+  }
+
+  qsort(lat, iteration, sizeof(double), cmp_double);
+  printf("%-10s reads/s = %.0f, average latency = %.1f us, p99 latency = %.1f us\n",
+         name, (double)iteration * cnt * 1000000 / total,
+         total / iteration, lat[(iteration * 99) / 100]);
+  free(lat);
+
+  return 0;
+}
+
+int main (int argc, char *argv[]) {
+  int iteration = 1000;
+  int i;
+
+  if (argc < 3) {
+    printf("Usage: %s <fru> <sensor> [<sensor> ...]\n", argv[0]);
+    return 1;
+  }
+
+  fru = strtoul(argv[1], NULL, 0);
+  for (i = 2; i < argc && cnt < MAX_BATCH; i++) {
+    sensors[cnt++] = strtoul(argv[i], NULL, 0);
+  }
+  if (getenv("ITERATION") != NULL) {
+    iteration = atoi(getenv("ITERATION"));
+  }
+
+  if (run("raw", 0, iteration) ||
+      run("raw-batch", 1, iteration) ||
+      run("cached", 2, iteration)) {
+    return 1;
+  }
+
+  return 0;
+}
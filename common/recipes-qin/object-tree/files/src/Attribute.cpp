@@ -16,7 +16,9 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <cstdio>
 #include <string>
+#include <stdexcept>
 #include <unordered_map>
 #include <glog/logging.h>
 #include <nlohmann/json.hpp>
@@ -39,12 +41,117 @@ std::unordered_map<std::string, const unsigned int> Attribute::stringModesMap =
     {"RW", RW}
   };
 
+std::unordered_map<unsigned int, const std::string> Attribute::typesStringMap =
+  {
+    {STRING, "STRING"},
+    {INT,    "INT"},
+    {FLOAT,  "FLOAT"},
+    {BLOB,   "BLOB"}
+  };
+
+void Attribute::setValue(const std::string &value) {
+  size_t pos = 0;
+  int64_t intValue = 0;
+  double floatValue = 0;
+  if (type_ == STRING || type_ == BLOB) {
+    value_ = value;
+    return;
+  }
+  // std::stoll and std::stod throw std::invalid_argument on no digits
+  if (type_ == INT) {
+    intValue = std::stoll(value, &pos, 0);
+  } else {
+    floatValue = std::stod(value, &pos);
+  }
+  if (pos != value.size()) {
+    LOG(ERROR) << "Value \"" << value << "\" of Attribute \"" << name_
+      << "\" is not a number";
+    throw std::invalid_argument("Invalid number");
+  }
+  if (type_ == INT) {
+    num_.int_ = intValue;
+  } else {
+    num_.float_ = floatValue;
+  }
+  value_ = value;
+}
+
+void Attribute::setType(Types type) {
+  Types old = type_;
+  type_ = type;
+  if (type == STRING || type == BLOB) {
+    return;
+  }
+  if (value_.empty()) {
+    type == INT ? setInt(0) : setFloat(0);
+    return;
+  }
+  try {
+    setValue(value_);
+  } catch (const std::exception &e) {
+    type_ = old;
+    LOG(ERROR) << "Attribute \"" << name_ << "\" cannot be converted to "
+      << typesStringMap.at(type);
+    throw std::invalid_argument("Invalid number");
+  }
+}
+
+void Attribute::setInt(int64_t value) {
+  type_ = INT;
+  num_.int_ = value;
+  value_ = std::to_string(value);
+}
+
+void Attribute::setFloat(double value) {
+  char buf[32];
+  type_ = FLOAT;
+  num_.float_ = value;
+  snprintf(buf, sizeof(buf), "%g", value);
+  value_ = buf;
+}
+
+void Attribute::setBlob(const void* data, size_t len) {
+  type_ = BLOB;
+  value_.assign(static_cast<const char*>(data), len);
+}
+
+int64_t Attribute::getInt() const {
+  if (type_ != INT) {
+    LOG(ERROR) << "Attribute \"" << name_ << "\" is not INT";
+    throw std::invalid_argument("Attribute type mismatch");
+  }
+  return num_.int_;
+}
+
+double Attribute::getFloat() const {
+  if (type_ == INT) {
+    return num_.int_;
+  }
+  if (type_ != FLOAT) {
+    LOG(ERROR) << "Attribute \"" << name_ << "\" is not FLOAT";
+    throw std::invalid_argument("Attribute type mismatch");
+  }
+  return num_.float_;
+}
+
 nlohmann::json Attribute::dumpToJson() const {
-  LOG(INFO) << "Dumpping the info for Attribute \"" << name_ << "\"";
+  VLOG(1) << "Dumpping the info for Attribute \"" << name_ << "\"";
   nlohmann::json dump;
   dump["name"] = name_;
-  dump["value"] = value_;
+  if (type_ == BLOB) {
+    static const char hex[] = "0123456789abcdef";
+    std::string str;
+    str.reserve(value_.size() * 2);
+    for (unsigned char c : value_) {
+      str.push_back(hex[c >> 4]);
+      str.push_back(hex[c & 0xf]);
+    }
+    dump["value"] = str;
+  } else {
+    dump["value"] = value_;
+  }
   dump["modes"] = modesStringMap.at(modes_);
+  dump["type"] = typesStringMap.at(type_);
   return dump;
 }
 
@@ -17,44 +17,67 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <nlohmann/json.hpp>
+#include "ObjectArena.h"
 
 namespace openbmc {
 namespace qin {
 
 /**
- * Attribute for object
+ * Attribute for object. The value is kept as text for the IPC side; INT
+ * and FLOAT attributes also keep the number so it can be read back
+ * without parsing. BLOB attributes hold raw bytes.
  */
 class Attribute {
   public:
     // RO: read only; WO: write only; RW: read write
     enum Modes {RO, WO, RW};
+    // STRING: text; INT: 64 bit integer; FLOAT: double; BLOB: raw bytes
+    enum Types {STRING, INT, FLOAT, BLOB};
     // map Modes to strings
     static std::unordered_map<unsigned int, const std::string> modesStringMap;
     // map strings to Modes
     static std::unordered_map<std::string, const unsigned int> stringModesMap;
+    // map Types to strings
+    static std::unordered_map<unsigned int, const std::string> typesStringMap;
 
   protected:
-    std::string name_;
-    std::string value_{""};
-    Modes       modes_{RO};
+    const std::string &name_;        // interned in NamePool
+    std::string       value_{""};
+    Modes             modes_{RO};
+    Types             type_{STRING};
+    union {
+      int64_t         int_;
+      double          float_;
+    } num_{0};
 
   public:
     /**
      * Constructor to set the name and type of the attribute
      */
-    Attribute(const std::string &name) {
-      name_  = name;
-    }
+    Attribute(const std::string &name)
+      : name_(NamePool::get().intern(name)) {}
 
     virtual ~Attribute() {}
 
+    static void* operator new(size_t size) {
+      return ObjectArena::get().allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+      ObjectArena::get().deallocate(ptr, size);
+    }
+
     const std::string& getName() const {
       return name_;
     }
 
+    /**
+     * @return value as text; raw bytes for BLOB attributes
+     */
     const std::string& getValue() const {
       return value_;
     }
@@ -63,10 +86,56 @@ class Attribute {
       return modes_;
     }
 
-    void setValue(const std::string &value) {
-      value_ = value;
+    Types getType() const {
+      return type_;
     }
 
+    /**
+     * Set the value from text. INT and FLOAT attributes parse it.
+     *
+     * @param value to be set
+     * @throw std::invalid_argument if value is not a number for INT and
+     *        FLOAT attributes
+     * @throw std::out_of_range if the number does not fit
+     */
+    void setValue(const std::string &value);
+
+    /**
+     * Set the type of the attribute. A non-empty current value is
+     * converted to the new type.
+     *
+     * @param type of the attribute
+     * @throw std::invalid_argument if the current value does not convert
+     */
+    void setType(Types type);
+
+    /**
+     * Set an integer value and make the attribute INT.
+     */
+    void setInt(int64_t value);
+
+    /**
+     * Set a floating point value and make the attribute FLOAT.
+     */
+    void setFloat(double value);
+
+    /**
+     * Set raw bytes and make the attribute BLOB.
+     */
+    void setBlob(const void* data, size_t len);
+
+    /**
+     * @throw std::invalid_argument if the attribute is not INT
+     * @return integer value
+     */
+    int64_t getInt() const;
+
+    /**
+     * @throw std::invalid_argument if the attribute is not FLOAT or INT
+     * @return floating point value
+     */
+    double getFloat() const;
+
     /**
      *  Set the modes of the attribute. glog error if
      *  the input is NULL or is not "RO" || "WO" || "RW"
@@ -102,8 +171,9 @@ class Attribute {
      * @return nlohmann::json object with the following entries.
      *
      *         name: name of the attribute
-     *         value: value of the atribute
+     *         value: value of the atribute; hex string for BLOB
      *         modes: modes in string of the attribute
+     *         type: type in string of the attribute
      */
     virtual nlohmann::json dumpToJson() const;
 };
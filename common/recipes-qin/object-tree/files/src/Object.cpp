@@ -27,6 +27,15 @@
 namespace openbmc {
 namespace qin {
 
+Object::~Object() {
+  for (auto &it : childMap_) {
+    it.second->setParent(nullptr);
+  }
+  if (parent_ != nullptr && parent_->getChildObject(name_) == this) {
+    parent_->childMap_.erase(name_);
+  }
+}
+
 Attribute* Object::getAttribute(const std::string &name) const {
   AttrMap::const_iterator it;
   if ((it = attrMap_.find(name)) == attrMap_.end()) {
@@ -36,20 +45,20 @@ Attribute* Object::getAttribute(const std::string &name) const {
 }
 
 const std::string& Object::readAttrValue(const std::string &name) const {
-  LOG(INFO) << "Reading the value of Attribute \n" << name << "\"";
+  VLOG(1) << "Reading the value of Attribute \n" << name << "\"";
   Attribute* attr = getReadableAttribute(name);
   return attr->getValue();
 }
 
 void Object::writeAttrValue(const std::string &name,
                             const std::string &value) {
-  LOG(INFO) << "Writing the value of Attribute \"" << name << "\"";
+  VLOG(1) << "Writing the value of Attribute \"" << name << "\"";
   Attribute* attr = getWritableAttribute(name);
   attr->setValue(value);
 }
 
 Attribute* Object::addAttribute(const std::string &name) {
-  LOG(INFO) << "Adding Attribute \"" << name << "\" to object \"" << name_
+  VLOG(1) << "Adding Attribute \"" << name << "\" to object \"" << name_
     << "\"";
   if (getAttribute(name) != nullptr) {
     LOG(ERROR) << "Adding duplicated Attribute \"" << name << "\"";
@@ -63,7 +72,7 @@ Attribute* Object::addAttribute(const std::string &name) {
 
 void Object::deleteAttribute(const std::string &name) {
   const Attribute* attr = getAttribute(name);
-  LOG(INFO) << "Deleting Attribute \"" << name << "\" from object \n"
+  VLOG(1) << "Deleting Attribute \"" << name << "\" from object \n"
     << name_ << "\n";
   if (attr == nullptr) {
     LOG(ERROR) << "Attribute \"" << name << "\" not found";
@@ -73,7 +82,7 @@ void Object::deleteAttribute(const std::string &name) {
 }
 
 void Object::addChildObject(Object &child) {
-  LOG(INFO) << "Adding child object \"" << child.getName() << "\"";
+  VLOG(1) << "Adding child object \"" << child.getName() << "\"";
   if (getChildObject(child.getName()) != nullptr) {
     LOG(ERROR) << "Adding duplicated Child";
     throw std::invalid_argument("Duplicated child object");
@@ -87,7 +96,7 @@ void Object::addChildObject(Object &child) {
 }
 
 Object* Object::removeChildObject(const std::string &name) {
-  LOG(INFO) << "Removing child object \"" << name << "\"";
+  VLOG(1) << "Removing child object \"" << name << "\"";
   Object* child = getChildObject(name);
   if (child == nullptr) {
     LOG(ERROR) << "Object with name " << name << " not found";
@@ -112,7 +121,7 @@ std::string Object::getObjectPath() const {
 }
 
 nlohmann::json Object::dumpToJson() const {
-  LOG(INFO) << "Dump object with name " << name_ << " into json";
+  VLOG(1) << "Dump object with name " << name_ << " into json";
   nlohmann::json dump = Object::dump();
   for (auto cit = childMap_.begin(); cit != childMap_.end(); cit++) {
     dump["childObjectNames"].push_back(cit->first);
@@ -122,7 +131,7 @@ nlohmann::json Object::dumpToJson() const {
 }
 
 nlohmann::json Object::dumpToJsonRecursive() const {
-  LOG(INFO) << "Dump object with name " << name_ << " into json";
+  VLOG(1) << "Dump object with name " << name_ << " into json";
   nlohmann::json dump = Object::dump();
   for (auto cit = childMap_.begin(); cit != childMap_.end(); cit++) {
     dump["childObjects"].push_back(cit->second->dumpToJsonRecursive());
@@ -24,12 +24,15 @@
 #include <glog/logging.h>
 #include <unordered_map>
 #include "Attribute.h"
+#include "ObjectArena.h"
 
 namespace openbmc {
 namespace qin {
 
 /**
- * Object contains a map of attributes and a map of children objects
+ * Object contains a map of attributes and a map of children objects.
+ * Objects and their attributes are allocated from the ObjectArena and the
+ * names are interned in the NamePool.
  */
 class Object {
   public:
@@ -42,7 +45,7 @@ class Object {
     typedef std::unordered_map<std::string, Object*> ChildMap;
 
   protected:
-    std::string name_;
+    const std::string &name_;       // interned in NamePool
     AttrMap     attrMap_;
     Object*     parent_{nullptr};   // pointer to the parent object
     ChildMap    childMap_;
@@ -54,19 +57,33 @@ class Object {
      * @param name of the object
      * @param parent of the object; not allowed to be nullptr
      */
-    Object(const std::string &name, Object* parent = nullptr) {
-      name_ = name;
+    Object(const std::string &name, Object* parent = nullptr)
+      : name_(NamePool::get().intern(name)) {
       parent_ = parent;
-      LOG(INFO) << "Creating Object \"" << name << "\"";
+      VLOG(1) << "Creating Object \"" << name << "\"";
       if (parent_ != nullptr) {
         parent_->addChildObject(*this);
       }
     }
 
     /**
-     * Virtual Destructor for inheritance
+     * Virtual Destructor for inheritance. Detaches the object from its
+     * parent and children so none of them keeps a dangling pointer.
      */
-    virtual ~Object() {};
+    virtual ~Object();
+
+    /**
+     * Class allocation functions, inherited by the derived objects. The
+     * sized delete gets the size of the most derived class through the
+     * virtual destructor.
+     */
+    static void* operator new(size_t size) {
+      return ObjectArena::get().allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+      ObjectArena::get().deallocate(ptr, size);
+    }
 
     const std::string& getName() const {
       return name_;
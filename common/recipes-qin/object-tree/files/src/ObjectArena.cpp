@@ -0,0 +1,103 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <new>
+#include <mutex>
+#include <string>
+#include "ObjectArena.h"
+
+namespace openbmc {
+namespace qin {
+
+const size_t ObjectArena::kAlign;
+const size_t ObjectArena::kMaxSize;
+const size_t ObjectArena::kBlockSize;
+
+ObjectArena& ObjectArena::get() {
+  static ObjectArena* arena = new ObjectArena();
+  return *arena;
+}
+
+void* ObjectArena::allocate(size_t size) {
+  if (size == 0 || size > kMaxSize) {
+    return ::operator new(size);
+  }
+  size_t cls = (size - 1) / kAlign;
+  size_t chunk = (cls + 1) * kAlign;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  void* ptr = freeList_[cls];
+  if (ptr != nullptr) {
+    freeList_[cls] = *static_cast<void**>(ptr);
+  } else {
+    if (cur_ == nullptr || (size_t)(end_ - cur_) < chunk) {
+      // the tail of the old block is left unused, at most kMaxSize bytes
+      cur_ = static_cast<char*>(::operator new(kBlockSize));
+      end_ = cur_ + kBlockSize;
+      blocks_.push_back(cur_);
+    }
+    ptr = cur_;
+    cur_ += chunk;
+  }
+  inUse_ += chunk;
+  return ptr;
+}
+
+void ObjectArena::deallocate(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+  if (size == 0 || size > kMaxSize) {
+    ::operator delete(ptr);
+    return;
+  }
+  size_t cls = (size - 1) / kAlign;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  *static_cast<void**>(ptr) = freeList_[cls];
+  freeList_[cls] = ptr;
+  inUse_ -= (cls + 1) * kAlign;
+}
+
+size_t ObjectArena::getBytesReserved() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return blocks_.size() * kBlockSize;
+}
+
+size_t ObjectArena::getBytesInUse() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return inUse_;
+}
+
+NamePool& NamePool::get() {
+  static NamePool* pool = new NamePool();
+  return *pool;
+}
+
+const std::string& NamePool::intern(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return *names_.insert(name).first;
+}
+
+size_t NamePool::getNameCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return names_.size();
+}
+
+} // namespace qin
+} // namespace openbmc
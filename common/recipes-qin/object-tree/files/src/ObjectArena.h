@@ -0,0 +1,118 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace openbmc {
+namespace qin {
+
+/**
+ * Pool allocator for Objects and Attributes. Requests up to kMaxSize bytes
+ * are served from size classes carved out of kBlockSize blocks, so building
+ * a tree of thousands of objects costs a handful of large allocations
+ * instead of one malloc per object. Freed chunks go back to the free list
+ * of their class and are reused; blocks are kept for the life of the
+ * process. Larger requests fall through to the global operator new.
+ */
+class ObjectArena {
+  public:
+    static const size_t kAlign     = 16;
+    static const size_t kMaxSize   = 512;
+    static const size_t kBlockSize = 64 * 1024;
+
+  private:
+    std::mutex         mutex_;
+    void*              freeList_[kMaxSize / kAlign] = {};
+    std::vector<char*> blocks_;
+    char*              cur_{nullptr};   // next free byte in current block
+    char*              end_{nullptr};   // end of the current block
+    size_t             inUse_{0};       // bytes handed out from the pool
+
+  public:
+    /**
+     * Get the process wide arena. It is never destroyed so objects
+     * released during static destruction are still safe to free.
+     */
+    static ObjectArena& get();
+
+    /**
+     * Allocate size bytes aligned to kAlign.
+     *
+     * @param size in bytes
+     * @throw std::bad_alloc if memory is exhausted
+     * @return pointer to the memory
+     */
+    void* allocate(size_t size);
+
+    /**
+     * Return memory from allocate(). size must be the size it was
+     * allocated with, which the sized operator delete provides.
+     */
+    void deallocate(void* ptr, size_t size);
+
+    /**
+     * @return bytes reserved from the system for the pool
+     */
+    size_t getBytesReserved();
+
+    /**
+     * @return bytes of the pool currently handed out
+     */
+    size_t getBytesInUse();
+
+  private:
+    ObjectArena() {}
+    ObjectArena(const ObjectArena&) = delete;
+    ObjectArena& operator=(const ObjectArena&) = delete;
+};
+
+/**
+ * Interned object and attribute names. Sensor and FRU trees repeat the
+ * same segment names under every FRU, so each distinct name is stored
+ * once and objects keep a reference to it. Names are never released.
+ */
+class NamePool {
+  private:
+    std::mutex                      mutex_;
+    std::unordered_set<std::string> names_;
+
+  public:
+    static NamePool& get();
+
+    /**
+     * @param name to be interned
+     * @return reference to the pooled copy of name, valid for the life
+     *         of the process
+     */
+    const std::string& intern(const std::string &name);
+
+    size_t getNameCount();
+
+  private:
+    NamePool() {}
+    NamePool(const NamePool&) = delete;
+    NamePool& operator=(const NamePool&) = delete;
+};
+
+} // namespace qin
+} // namespace openbmc
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ObjectMap.h"
+
+namespace openbmc {
+namespace qin {
+
+void ObjectMap::insert(const std::string &path,
+                       std::unique_ptr<Object> object) {
+  const Object* key = object.get();
+  std::lock_guard<std::mutex> lock(mutex_);
+  map_[path] = std::move(object);
+  if (journaling_) {
+    journal_.push_back(Change{path, key, nullptr});
+    pending_++;
+  }
+}
+
+Object* ObjectMap::find(const std::string &path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Map::const_iterator it;
+  if ((it = map_.find(path)) == map_.end()) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+std::unique_ptr<Object> ObjectMap::release(const std::string &path) {
+  std::unique_ptr<Object> upObj;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Map::iterator it;
+  if ((it = map_.find(path)) != map_.end()) {
+    upObj = std::move(it->second);
+    map_.erase(it);
+  }
+  return upObj;
+}
+
+void ObjectMap::retire(const std::string &path,
+                       std::unique_ptr<Object> object) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (journaling_) {
+    journal_.push_back(Change{path, nullptr, std::move(object)});
+    pending_++;
+    return;
+  }
+  lock.unlock();
+  object.reset();
+}
+
+void ObjectMap::startJournal(ObjectSnapshot::PathMap &objects) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  objects.reserve(map_.size());
+  for (auto &it : map_) {
+    objects.insert(std::make_pair(it.first, it.second.get()));
+  }
+  journaling_ = true;
+}
+
+std::vector<ObjectMap::Change> ObjectMap::takeJournal() const {
+  std::vector<Change> changes;
+  if (pending_ == 0) {
+    return changes;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  changes.swap(journal_);
+  pending_ = 0;
+  return changes;
+}
+
+} // namespace qin
+} // namespace openbmc
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Object.h"
+
+namespace openbmc {
+namespace qin {
+
+/**
+ * Immutable view of the object paths of an ObjectTree at one point in
+ * time. Objects removed from the tree after the snapshot was taken stay
+ * allocated until every snapshot that can reference them is released, so
+ * readers may use the objects without holding any lock. The snapshot
+ * covers the tree structure; attribute values are read as they are.
+ * A snapshot must not outlive its tree.
+ */
+class ObjectSnapshot {
+  public:
+    typedef std::unordered_map<std::string, const Object*> PathMap;
+
+  private:
+    friend class ObjectTree;
+
+    PathMap                               objects_;
+    // Objects removed while this was the latest snapshot, and the
+    // snapshot that superseded it; both are only touched by the builder.
+    std::vector<std::unique_ptr<Object>>  retired_;
+    std::shared_ptr<ObjectSnapshot>       next_;
+
+  public:
+    /**
+     * @param path of the object
+     * @return nullptr if not found; Object* otherwise
+     */
+    const Object* getObject(const std::string &path) const {
+      PathMap::const_iterator it;
+      if ((it = objects_.find(path)) == objects_.end()) {
+        return nullptr;
+      }
+      return it->second;
+    }
+
+    int getObjectCount() const {
+      return objects_.size();
+    }
+
+    const PathMap& getPathMap() const {
+      return objects_;
+    }
+};
+
+/**
+ * Owner of all the objects of an ObjectTree, keyed by their path so that
+ * a lookup by path is a single hash lookup. Once a snapshot has been
+ * taken, additions and removals are also recorded in a journal that the
+ * next snapshot is built from, and removed objects are handed over to
+ * the snapshots instead of being freed.
+ */
+class ObjectMap {
+  public:
+    struct Change {
+      std::string             path;
+      const Object*           object;   // added object; nullptr if removed
+      std::unique_ptr<Object> retired;  // removed object
+    };
+
+    typedef std::unordered_map<std::string, std::unique_ptr<Object>> Map;
+
+  private:
+    Map                 map_;
+    mutable std::mutex  mutex_;
+    // journal state is changed by snapshot readers of a const tree
+    mutable bool                journaling_{false};
+    mutable std::vector<Change> journal_;
+    // journal_.size(), checked without the lock by idle snapshot readers
+    mutable std::atomic<size_t> pending_{0};
+
+  public:
+    /**
+     * Insert an object registered at path. Takes the same argument as
+     * the insert of the path keyed map this class replaced, so derived
+     * trees can keep using std::make_pair(path, std::move(upObj)).
+     */
+    template <typename T>
+    void insert(std::pair<std::string, std::unique_ptr<T>> &&entry) {
+      insert(entry.first, std::unique_ptr<Object>(std::move(entry.second)));
+    }
+
+    void insert(const std::string &path, std::unique_ptr<Object> object);
+
+    /**
+     * @param path of the object
+     * @return nullptr if not found; Object* otherwise
+     */
+    Object* find(const std::string &path) const;
+
+    /**
+     * Take the ownership of the object at path out of the map.
+     *
+     * @return unique_ptr to the object; empty if there is none
+     */
+    std::unique_ptr<Object> release(const std::string &path);
+
+    /**
+     * Dispose of an object released from the map. It is freed right
+     * away unless snapshots are in use.
+     *
+     * @param path the object was registered at
+     * @param object to be disposed of
+     */
+    void retire(const std::string &path, std::unique_ptr<Object> object);
+
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return map_.size();
+    }
+
+    /**
+     * Unlocked access to the owned objects for the tree's destructor.
+     */
+    const Map& getMap() const {
+      return map_;
+    }
+
+    /**
+     * Fill objects with every owned object and start recording changes.
+     *
+     * @param objects to be filled
+     */
+    void startJournal(ObjectSnapshot::PathMap &objects) const;
+
+    /**
+     * @return the changes recorded since the last call
+     */
+    std::vector<Change> takeJournal() const;
+};
+
+} // namespace qin
+} // namespace openbmc
@@ -20,6 +20,8 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <glog/logging.h>
 #include "ObjectTree.h"
 #include "Object.h"
@@ -36,6 +38,7 @@ ObjectTree::ObjectTree(const std::shared_ptr<Ipc> &ipc,
   ipc_ = ipc;
 
   const std::string rootPath = getPath("", rootName);
+  separator_ = rootPath.substr(0, rootPath.size() - rootName.size());
 
   LOG(INFO) << "Adding root \"" << rootName << "\"";
   std::unique_ptr<Object> upObj(new Object(rootName));
@@ -46,9 +49,13 @@ ObjectTree::ObjectTree(const std::shared_ptr<Ipc> &ipc,
   ipc_.get()->onConnLost     = onConnLostCallBack;
 }
 
+Object* ObjectTree::getObject(const std::string &path) const {
+  return objectMap_.find(path);
+}
+
 Object* ObjectTree::addObject(const std::string &name,
                               const std::string &parentPath) {
-  LOG(INFO) << "Adding object \"" << name << "\" under path \""
+  VLOG(1) << "Adding object \"" << name << "\" under path \""
     << parentPath << "\"";
   Object* parent = getParent(parentPath, name);
   const std::string path = getPath(parentPath, name);
@@ -61,7 +68,7 @@ Object* ObjectTree::addObject(std::unique_ptr<Object> upObj,
   checkObject(upObj.get());
   const std::string &name = upObj.get()->getName();
   const std::string path = getPath(parentPath, name);
-  LOG(INFO) << "Adding object \"" << name << "\" under path \""
+  VLOG(1) << "Adding object \"" << name << "\" under path \""
     << parentPath << "\"";
   Object* parent = getParent(parentPath, name);
   parent->addChildObject(*(upObj.get()));
@@ -69,27 +76,139 @@ Object* ObjectTree::addObject(std::unique_ptr<Object> upObj,
 }
 
 void ObjectTree::deleteObjectByPath(const std::string &path) {
-  ObjectMap::const_iterator it;
-  if ((it = objectMap_.find(path)) == objectMap_.end()) {
+  Object* object = getObject(path);
+  if (object == nullptr) {
     LOG(ERROR) << "Object to be deleted cannot be found at path \""
       << path << "\"";
     throw std::invalid_argument("Object not found");
   }
-  Object* object = it->second.get();
   if (object == root_) {
     LOG(ERROR) << "Cannot delete root \"" << root_->getName() << "\"";
     throw std::invalid_argument("Error deleting root");
   }
-  Object* parent = object->getParent();
-  object = parent->removeChildObject(object->getName());
-  if (object == nullptr) {
-    LOG(ERROR) << "Failed to delete the object at \"" << path << "\"";
-    throw std::invalid_argument("Error deleting object");
+  if (object->getChildCount() != 0) {
+    LOG(ERROR) << "Object to be deleted has non-empty children";
+    throw std::invalid_argument("Object has non-empty children");
   }
-  objectMap_.erase(it);
+  std::unique_ptr<Object> upObj = objectMap_.release(path);
+  object->getParent()->removeChildObject(object->getName());
+  objectMap_.retire(path, std::move(upObj));
   ipc_.get()->unregisterObject(path);
 }
 
+Object* ObjectTree::addSubtree(std::vector<std::unique_ptr<Object>> objects,
+                               const std::string &parentPath) {
+  if (objects.empty() || objects[0] == nullptr) {
+    LOG(ERROR) << "Empty subtree";
+    throw std::invalid_argument("Empty object");
+  }
+  Object* top = objects[0].get();
+  if (top->getParent() != nullptr) {
+    LOG(ERROR) << "Subtree root \"" << top->getName() << "\" has a parent";
+    throw std::invalid_argument("Child has non-null parent");
+  }
+  VLOG(1) << "Adding subtree \"" << top->getName() << "\" of "
+    << objects.size() << " objects under path \"" << parentPath << "\"";
+
+  // Paths of the listed objects; a parent has to come before its children
+  std::unordered_map<const Object*, std::string> paths;
+  size_t children = 0;
+  paths.insert(std::make_pair(top, getPath(parentPath, top->getName())));
+  for (size_t i = 0; i < objects.size(); i++) {
+    const Object* object = objects[i].get();
+    if (object == nullptr) {
+      LOG(ERROR) << "Empty object in subtree";
+      throw std::invalid_argument("Empty object");
+    }
+    children += object->getChildCount();
+    if (i == 0) {
+      continue;
+    }
+    auto it = paths.find(object->getParent());
+    if (it == paths.end() || paths.count(object) != 0) {
+      LOG(ERROR) << "Object \"" << object->getName()
+        << "\" is not part of the subtree";
+      throw std::invalid_argument("Invalid subtree");
+    }
+    paths.insert(std::make_pair(object, getPath(it->second, object->getName())));
+  }
+  if (children != objects.size() - 1) {
+    LOG(ERROR) << "Subtree has children that are not listed";
+    throw std::invalid_argument("Invalid subtree");
+  }
+
+  Object* parent = getParent(parentPath, top->getName());
+  parent->addChildObject(*top);
+  for (auto &upObj : objects) {
+    const std::string &path = paths.at(upObj.get());
+    addObjectByPath(std::move(upObj), path);
+  }
+  return top;
+}
+
+void ObjectTree::deleteSubtree(const std::string &path) {
+  Object* object = getObject(path);
+  if (object == nullptr) {
+    LOG(ERROR) << "Subtree to be deleted cannot be found at path \""
+      << path << "\"";
+    throw std::invalid_argument("Object not found");
+  }
+  if (object == root_) {
+    LOG(ERROR) << "Cannot delete root \"" << root_->getName() << "\"";
+    throw std::invalid_argument("Error deleting root");
+  }
+
+  // Parents are listed before their children, delete in reverse
+  std::vector<std::pair<const Object*, std::string>> stack{{object, path}};
+  std::vector<std::string> paths;
+  while (!stack.empty()) {
+    const Object* obj = stack.back().first;
+    paths.push_back(std::move(stack.back().second));
+    stack.pop_back();
+    for (auto &it : obj->getChildMap()) {
+      stack.push_back(std::make_pair(it.second,
+                                     ipc_.get()->getPath(paths.back(), it.first)));
+    }
+  }
+  VLOG(1) << "Deleting subtree of " << paths.size() << " objects at \""
+    << path << "\"";
+  for (auto it = paths.rbegin(); it != paths.rend(); it++) {
+    deleteObjectByPath(*it);
+  }
+}
+
+std::shared_ptr<const ObjectSnapshot> ObjectTree::getSnapshot() const {
+  // Only snapshot builders take this lock; writers only meet them on the
+  // short journal lock of objectMap_
+  std::lock_guard<std::mutex> lock(snapshotMutex_);
+  std::shared_ptr<ObjectSnapshot> snapshot(new ObjectSnapshot());
+
+  if (snapshot_ == nullptr) {
+    objectMap_.startJournal(snapshot->objects_);
+    snapshot_ = snapshot;
+    return snapshot_;
+  }
+
+  std::vector<ObjectMap::Change> changes = objectMap_.takeJournal();
+  if (changes.empty()) {
+    return snapshot_;
+  }
+  snapshot->objects_ = snapshot_->objects_;
+  for (auto &change : changes) {
+    if (change.retired != nullptr) {
+      // still referenced by the previous snapshots
+      snapshot->objects_.erase(change.path);
+      snapshot_->retired_.push_back(std::move(change.retired));
+    } else {
+      snapshot->objects_[change.path] = change.object;
+    }
+  }
+  // older snapshots keep the newer ones and their retired objects alive
+  snapshot_->next_ = snapshot;
+  snapshot_ = snapshot;
+  return snapshot_;
+}
+
 Object* ObjectTree::getParent(const std::string &parentPath,
                               const std::string &name) const {
   Object* parent = getObject(parentPath);
@@ -106,7 +225,7 @@ Object* ObjectTree::getParent(const std::string &parentPath,
 }
 
 void ObjectTree::checkObject(const Object* object) const {
-  LOG(INFO) << "Checking validality of Object";
+  VLOG(1) << "Checking validality of Object";
   if (object == nullptr) {
     LOG(ERROR) << "Empty object";
     throw std::invalid_argument("Empty object");
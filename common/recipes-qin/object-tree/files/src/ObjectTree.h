@@ -20,8 +20,11 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <ipc-interface/Ipc.h>
 #include "Object.h"
+#include "ObjectMap.h"
 
 namespace openbmc {
 namespace qin {
@@ -34,15 +37,20 @@ namespace qin {
  * memory management. Object management functions are virtual in
  * order to provide reimplementation and polymorphism on Object
  * class.
+ *
+ * Readers on other threads use getSnapshot(); taking or refreshing a
+ * snapshot never waits for a writer and writers never wait for readers.
  */
 class ObjectTree {
-  public:
-    typedef std::unordered_map<std::string, std::unique_ptr<Object>> ObjectMap;
-
   protected:
     std::shared_ptr<Ipc>  ipc_;        // pointer to the ipc interface
     Object*               root_;       // pointer to the root object
-    ObjectMap             objectMap_;  // path to *object map of all objects
+    ObjectMap             objectMap_;  // owner of all objects
+    std::string           separator_;  // ipc path separator
+
+  private:
+    mutable std::mutex                      snapshotMutex_;
+    mutable std::shared_ptr<ObjectSnapshot> snapshot_;
 
   public:
     /**
@@ -59,7 +67,7 @@ class ObjectTree {
      * Delete remove object registration
      */
     virtual ~ObjectTree() {
-      for (auto &it : objectMap_) {
+      for (auto &it : objectMap_.getMap()) {
         ipc_.get()->unregisterObject(it.first);
       }
     }
@@ -87,13 +95,7 @@ class ObjectTree {
      * @param path of the object
      * @return nullptr if not found; Object* otherwise
      */
-    Object* getObject(const std::string &path) const {
-      ObjectMap::const_iterator it;
-      if ((it = objectMap_.find(path)) == objectMap_.end()) {
-        return nullptr;
-      }
-      return it->second.get();
-    }
+    Object* getObject(const std::string &path) const;
 
     bool containObject(const std::string &path) const {
       return getObject(path) != nullptr;
@@ -165,6 +167,46 @@ class ObjectTree {
      */
     virtual void deleteObjectByPath(const std::string &path);
 
+    /**
+     * Add a subtree of objects under the specified parent path in one
+     * call. The first object is the root of the subtree and must have no
+     * parent. Every other object must have been created with its parent
+     * set to an object listed before it, and every child of a listed
+     * object must be listed.
+     *
+     * @param objects of the subtree
+     * @param parentPath is the parent object path for the subtree
+     * @throw std::invalid_argument if
+     *        * objects is empty or contains an empty unique_ptr
+     *        * the objects do not form a subtree as described
+     *        * parentPath not found
+     *        * a name does not meet the ipc's rule
+     *        * the object with the same name as the subtree root has
+     *          already existed under the parent
+     * @return raw pointer to the root of the subtree
+     */
+    virtual Object* addSubtree(std::vector<std::unique_ptr<Object>> objects,
+                               const std::string &parentPath);
+
+    /**
+     * Delete the object at path together with all its descendants. The
+     * objects are deleted through deleteObjectByPath(), children first.
+     *
+     * @param path of the subtree root
+     * @throw std::invalid_argument if object not found or object is root
+     */
+    virtual void deleteSubtree(const std::string &path);
+
+    /**
+     * Get a snapshot of the tree structure. The snapshot is shared until
+     * the tree changes; a new one is built from the previous one and the
+     * changes recorded since. The first call records the current tree
+     * and turns the recording on.
+     *
+     * @return shared_ptr to the snapshot
+     */
+    std::shared_ptr<const ObjectSnapshot> getSnapshot() const;
+
     /**
      * This is the function that will be called by the static callback
      * at Ipc when the connection is acquired. Currently, there is
@@ -198,7 +240,7 @@ class ObjectTree {
     Object* addObjectByPath(std::unique_ptr<Object> upObj,
                             const std::string       &path) {
       Object* object = upObj.get();
-      objectMap_.insert(std::make_pair(path, std::move(upObj)));
+      objectMap_.insert(path, std::move(upObj));
       ipc_->registerObject(path, object);
       return object;
     }
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include "../Attribute.h"
+#include "../ObjectArena.h"
 
 using namespace openbmc::qin;
 
@@ -98,6 +99,72 @@ TEST_F(AttributeTest, Dump) {
   EXPECT_STREQ(modes.c_str(), "RW");
 }
 
+TEST_F(AttributeTest, Types) {
+  EXPECT_EQ(a_->getType(), Attribute::STRING);
+  EXPECT_ANY_THROW(a_->getInt());
+  EXPECT_ANY_THROW(a_->getFloat());
+
+  a_->setInt(-42);
+  EXPECT_EQ(a_->getType(), Attribute::INT);
+  EXPECT_EQ(a_->getInt(), -42);
+  EXPECT_DOUBLE_EQ(a_->getFloat(), -42.0);
+  EXPECT_STREQ(a_->getValue().c_str(), "-42");
+
+  a_->setValue("0x10");
+  EXPECT_EQ(a_->getInt(), 16);
+  EXPECT_THROW(a_->setValue("12abc"), std::invalid_argument);
+  EXPECT_EQ(a_->getInt(), 16);
+
+  a_->setFloat(25.5);
+  EXPECT_EQ(a_->getType(), Attribute::FLOAT);
+  EXPECT_DOUBLE_EQ(a_->getFloat(), 25.5);
+  EXPECT_ANY_THROW(a_->getInt());
+  EXPECT_STREQ(a_->getValue().c_str(), "25.5");
+
+  a_->setType(Attribute::STRING);
+  a_->setValue("abc");
+  EXPECT_THROW(a_->setType(Attribute::INT), std::invalid_argument);
+  EXPECT_EQ(a_->getType(), Attribute::STRING);
+  a_->setValue("7");
+  a_->setType(Attribute::INT);
+  EXPECT_EQ(a_->getInt(), 7);
+
+  const uint8_t blob[] = {0x00, 0xde, 0xad, 0xbe, 0xef};
+  a_->setBlob(blob, sizeof(blob));
+  EXPECT_EQ(a_->getType(), Attribute::BLOB);
+  EXPECT_EQ(a_->getValue().size(), sizeof(blob));
+  nlohmann::json attrInfo = a_->dumpToJson();
+  const std::string &value = attrInfo.at("value");
+  const std::string &type = attrInfo.at("type");
+  EXPECT_STREQ(value.c_str(), "00deadbeef");
+  EXPECT_STREQ(type.c_str(), "BLOB");
+}
+
+TEST(ArenaTest, Allocation) {
+  ObjectArena &arena = ObjectArena::get();
+  size_t inUse = arena.getBytesInUse();
+
+  Attribute* attr = new Attribute("arenaAttr");
+  EXPECT_GT(arena.getBytesInUse(), inUse);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(attr) % ObjectArena::kAlign, 0);
+  delete attr;
+  EXPECT_EQ(arena.getBytesInUse(), inUse);
+
+  // freed chunks are reused
+  Attribute* attr1 = new Attribute("arenaAttr");
+  Attribute* attr2 = new Attribute("arenaAttr");
+  EXPECT_NE(attr1, attr2);
+  EXPECT_EQ(&attr1->getName(), &attr2->getName());
+  delete attr1;
+  delete attr2;
+  EXPECT_EQ(arena.getBytesInUse(), inUse);
+
+  // oversized requests bypass the pool
+  void* big = arena.allocate(ObjectArena::kMaxSize + 1);
+  EXPECT_EQ(arena.getBytesInUse(), inUse);
+  arena.deallocate(big, ObjectArena::kMaxSize + 1);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   ::google::InitGoogleLogging(argv[0]);
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glog/logging.h>
+#include "DummyIpc.h"
+#include "../ObjectTree.h"
+#include "../ObjectArena.h"
+using namespace openbmc::qin;
+
+/*
+ * Memory and build time of a sled sized tree: FRUS FRUs with SENSORS
+ * sensor objects of two attributes each (10k objects by default).
+ *
+ * Usage: object-tree-benchmark [FRUS] [SENSORS]
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(const Clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static size_t heapInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  struct mallinfo2 mi = mallinfo2();
+#else
+  struct mallinfo mi = mallinfo();
+#endif
+  return mi.uordblks + mi.hblkhd;
+}
+
+static std::string fruName(int fru) {
+  return "FRU_SLOT" + std::to_string(fru);
+}
+
+static std::string sensorName(int sensor) {
+  return "SENSOR_TEMPERATURE_" + std::to_string(sensor);
+}
+
+static void addSensorAttrs(Object* object) {
+  object->addAttribute("value")->setFloat(42.5);
+  object->addAttribute("unit")->setValue("C");
+}
+
+int main(int argc, char* argv[]) {
+  ::google::InitGoogleLogging(argv[0]);
+  int frus = argc > 1 ? atoi(argv[1]) : 100;
+  int sensors = argc > 2 ? atoi(argv[2]) : 99;
+  int objects = frus * (sensors + 1);
+  Clock::time_point start;
+  std::vector<std::string> paths;
+
+  // one object at a time through addObject()
+  size_t heap = heapInUse();
+  start = Clock::now();
+  std::unique_ptr<ObjectTree> tree(
+      new ObjectTree(std::shared_ptr<Ipc>(new DummyIpc()), "org"));
+  tree->addObject("openbmc", "/org");
+  for (int f = 0; f < frus; f++) {
+    tree->addObject(fruName(f), "/org/openbmc");
+    std::string fruPath = "/org/openbmc/" + fruName(f);
+    for (int s = 0; s < sensors; s++) {
+      addSensorAttrs(tree->addObject(sensorName(s), fruPath));
+    }
+  }
+  double buildMs = elapsedMs(start);
+  size_t bytes = heapInUse() - heap;
+  printf("objects:             %d\n", tree->getObjectCount());
+  printf("build (addObject):   %.2f ms\n", buildMs);
+  printf("heap:                %zu KB, %zu B/object\n",
+         bytes / 1024, bytes / objects);
+  printf("arena:               %zu KB reserved, %zu KB in use\n",
+         ObjectArena::get().getBytesReserved() / 1024,
+         ObjectArena::get().getBytesInUse() / 1024);
+  printf("interned names:      %zu\n", NamePool::get().getNameCount());
+
+  for (int f = 0; f < frus; f++) {
+    for (int s = 0; s < sensors; s++) {
+      paths.push_back("/org/openbmc/" + fruName(f) + "/" + sensorName(s));
+    }
+  }
+  start = Clock::now();
+  size_t found = 0;
+  for (int r = 0; r < 10; r++) {
+    for (auto &path : paths) {
+      found += tree->getObject(path) != nullptr;
+    }
+  }
+  printf("lookup:              %.3f us (%zu found)\n",
+         elapsedMs(start) * 1000 / (10.0 * paths.size()), found);
+
+  start = Clock::now();
+  std::shared_ptr<const ObjectSnapshot> snapshot = tree->getSnapshot();
+  printf("first snapshot:      %.2f ms\n", elapsedMs(start));
+  tree->deleteObjectByPath(paths.back());
+  start = Clock::now();
+  snapshot = tree->getSnapshot();
+  printf("snapshot after 1 op: %.2f ms\n", elapsedMs(start));
+  snapshot.reset();
+
+  // writer churn with and without a reader refreshing snapshots
+  for (int withReader = 0; withReader < 2; withReader++) {
+    std::atomic<bool> stop(false);
+    std::atomic<int> snapshots(0);
+    std::atomic<int> attrs(0);
+    std::thread reader([&]() {
+      while (withReader && !stop) {
+        std::shared_ptr<const ObjectSnapshot> snap = tree->getSnapshot();
+        int count = 0;
+        for (auto &it : snap->getPathMap()) {
+          count += it.second->getAttrCount();
+        }
+        attrs = count;
+        snapshots++;
+      }
+    });
+    start = Clock::now();
+    int ops = 0;
+    while (elapsedMs(start) < 500) {
+      tree->addObject("HOTPLUG", "/org/openbmc/" + fruName(0));
+      tree->deleteObjectByPath("/org/openbmc/" + fruName(0) + "/HOTPLUG");
+      ops += 2;
+    }
+    double ms = elapsedMs(start);
+    stop = true;
+    reader.join();
+    printf("writer %s reader: %.0f ops/s (%d snapshots of %d attrs)\n",
+           withReader ? "with   " : "without", ops * 1000 / ms,
+           snapshots.load(), attrs.load());
+  }
+
+  start = Clock::now();
+  for (auto it = paths.rbegin(); it != paths.rend(); it++) {
+    if (tree->containObject(*it)) {
+      tree->deleteObjectByPath(*it);
+    }
+  }
+  printf("delete (per object): %.2f ms\n", elapsedMs(start));
+  tree.reset();
+
+  // the same tree built one FRU subtree at a time
+  heap = heapInUse();
+  start = Clock::now();
+  tree.reset(new ObjectTree(std::shared_ptr<Ipc>(new DummyIpc()), "org"));
+  tree->addObject("openbmc", "/org");
+  for (int f = 0; f < frus; f++) {
+    std::vector<std::unique_ptr<Object>> subtree;
+    subtree.reserve(sensors + 1);
+    subtree.emplace_back(new Object(fruName(f)));
+    for (int s = 0; s < sensors; s++) {
+      Object* object = new Object(sensorName(s), subtree[0].get());
+      subtree.emplace_back(object);
+      addSensorAttrs(object);
+    }
+    tree->addSubtree(std::move(subtree), "/org/openbmc");
+  }
+  printf("build (addSubtree):  %.2f ms, %zu B/object\n", elapsedMs(start),
+         (heapInUse() - heap) / objects);
+  start = Clock::now();
+  tree->deleteSubtree("/org/openbmc");
+  printf("delete (subtree):    %.2f ms\n", elapsedMs(start));
+
+  return 0;
+}
@@ -19,6 +19,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string.h>
+#include <vector>
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <ipc-interface/Ipc.h>
@@ -145,6 +146,93 @@ TEST_F(ObjectTreeTest, AddObjectByUniquePtr) {
   EXPECT_ANY_THROW(objTree_->addObject(std::move(uObj), "/org"));
 }
 
+TEST_F(ObjectTreeTest, Subtree) {
+  std::vector<std::unique_ptr<Object>> objects;
+  objects.emplace_back(new Object("openbmc"));
+  objects.emplace_back(new Object("fru1", objects[0].get()));
+  objects.emplace_back(new Object("temp", objects[1].get()));
+  objects.emplace_back(new Object("fan", objects[1].get()));
+  objects.emplace_back(new Object("fru2", objects[0].get()));
+  Object* top = objTree_->addSubtree(std::move(objects), "/org");
+  ASSERT_TRUE(top != nullptr);
+  EXPECT_EQ(objTree_->getObjectCount(), 6);
+  EXPECT_TRUE(objTree_->getObject("/org/openbmc") == top);
+  EXPECT_TRUE(objTree_->containObject("/org/openbmc/fru1/temp"));
+  EXPECT_TRUE(objTree_->containObject("/org/openbmc/fru2"));
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/fru1/temp/x"));
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/fru"));
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/"));
+  EXPECT_FALSE(objTree_->containObject("/orgopenbmc"));
+
+  // failed since the root of the subtree has a duplicated name
+  objects.clear();
+  objects.emplace_back(new Object("openbmc"));
+  EXPECT_THROW(objTree_->addSubtree(std::move(objects), "/org"),
+               std::invalid_argument);
+
+  // failed since a child is not listed
+  objects.clear();
+  objects.emplace_back(new Object("system"));
+  Object child("sqlite", objects[0].get());
+  EXPECT_THROW(objTree_->addSubtree(std::move(objects), "/org"),
+               std::invalid_argument);
+  EXPECT_TRUE(child.getParent() == nullptr);
+
+  // failed since the parent is listed after the child
+  objects.clear();
+  objects.emplace_back(new Object("system"));
+  objects.emplace_back(new Object("sqlite"));
+  objects.emplace_back(new Object("db", objects[1].get()));
+  objects[0]->addChildObject(*objects[1]);
+  std::swap(objects[1], objects[2]);
+  EXPECT_THROW(objTree_->addSubtree(std::move(objects), "/org"),
+               std::invalid_argument);
+  EXPECT_EQ(objTree_->getObjectCount(), 6);
+
+  EXPECT_THROW(objTree_->deleteSubtree("/org"), std::invalid_argument);
+  EXPECT_THROW(objTree_->deleteSubtree("/org/none"), std::invalid_argument);
+  objTree_->deleteSubtree("/org/openbmc/fru1");
+  EXPECT_EQ(objTree_->getObjectCount(), 3);
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/fru1/temp"));
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/fru1"));
+  EXPECT_EQ(top->getChildCount(), 1);
+  objTree_->deleteSubtree("/org/openbmc");
+  EXPECT_EQ(objTree_->getObjectCount(), 1);
+  EXPECT_EQ(objTree_->getRoot()->getChildCount(), 0);
+}
+
+TEST_F(ObjectTreeTest, Snapshot) {
+  Object* obj = objTree_->addObject("openbmc", "/org");
+  std::shared_ptr<const ObjectSnapshot> snap0 = objTree_->getSnapshot();
+  EXPECT_EQ(snap0->getObjectCount(), 2);
+  EXPECT_TRUE(snap0->getObject("/org/openbmc") == obj);
+  // unchanged tree shares the snapshot
+  EXPECT_TRUE(objTree_->getSnapshot() == snap0);
+
+  Object* fru = objTree_->addObject("fru1", "/org/openbmc");
+  fru->addAttribute("name")->setValue("fru1");
+  std::shared_ptr<const ObjectSnapshot> snap1 = objTree_->getSnapshot();
+  EXPECT_TRUE(snap1 != snap0);
+  EXPECT_EQ(snap0->getObjectCount(), 2);
+  EXPECT_EQ(snap1->getObjectCount(), 3);
+  EXPECT_TRUE(snap1->getObject("/org/openbmc/fru1") == fru);
+
+  // removed objects stay readable through the older snapshots
+  objTree_->deleteObjectByPath("/org/openbmc/fru1");
+  EXPECT_FALSE(objTree_->containObject("/org/openbmc/fru1"));
+  std::shared_ptr<const ObjectSnapshot> snap2 = objTree_->getSnapshot();
+  EXPECT_EQ(snap2->getObjectCount(), 2);
+  EXPECT_TRUE(snap2->getObject("/org/openbmc/fru1") == nullptr);
+  const Object* old = snap1->getObject("/org/openbmc/fru1");
+  ASSERT_TRUE(old != nullptr);
+  EXPECT_STREQ(old->readAttrValue("name").c_str(), "fru1");
+
+  // same path reused for a new object
+  Object* fru2 = objTree_->addObject("fru1", "/org/openbmc");
+  EXPECT_TRUE(objTree_->getSnapshot()->getObject("/org/openbmc/fru1") == fru2);
+  EXPECT_TRUE(snap1->getObject("/org/openbmc/fru1") == old);
+}
+
 int main (int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   ::google::InitGoogleLogging(argv[0]);
@@ -0,0 +1,415 @@
+#!/usr/bin/env python
+#
+# Copyright 2017-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+# In-process bindings to the sensor, SDR, FRUID and log stores so that the
+# REST nodes do not have to fork sensor-util, fruid-util or log-util for
+# every request. Every function returns None when the request can not be
+# served natively (library missing, aggregate FRU, 'all', ...) and the
+# caller falls back to the command line utility.
+
+from ctypes import *
+from datetime import datetime
+import functools
+import os
+import re
+import threading
+import time
+from pal import lpal_hndl
+
+# Threshold bits of thresh_sensor_t.flag, see obmc-pal.h
+UCR_THRESH = 1
+UNC_THRESH = 2
+UNR_THRESH = 3
+LCR_THRESH = 4
+LNC_THRESH = 5
+LNR_THRESH = 6
+
+FRU_ALL = 0
+
+class thresh_sensor_t(Structure):
+    _fields_ = [
+        ("flag", c_uint16),
+        ("ucr_thresh", c_float),
+        ("unc_thresh", c_float),
+        ("unr_thresh", c_float),
+        ("lcr_thresh", c_float),
+        ("lnc_thresh", c_float),
+        ("lnr_thresh", c_float),
+        ("pos_hyst", c_float),
+        ("neg_hyst", c_float),
+        ("curr_state", c_int),
+        ("name", c_char * 32),
+        ("units", c_char * 64),
+        ("poll_interval", c_uint8),
+    ]
+
+class fruid_chassis_t(Structure):
+    _fields_ = [("flag", c_uint8)] + [(f, c_char_p) for f in (
+        "type_str", "part", "serial",
+        "custom1", "custom2", "custom3", "custom4")]
+
+class fruid_board_t(Structure):
+    _fields_ = [("flag", c_uint8)] + [(f, c_char_p) for f in (
+        "mfg_time_str", "mfg", "name", "serial", "part", "fruid",
+        "custom1", "custom2", "custom3", "custom4")]
+
+class fruid_product_t(Structure):
+    _fields_ = [("flag", c_uint8)] + [(f, c_char_p) for f in (
+        "mfg", "name", "part", "version", "serial", "asset_tag", "fruid",
+        "custom1", "custom2", "custom3", "custom4")]
+
+class fruid_info_t(Structure):
+    _fields_ = [
+        ("chassis", fruid_chassis_t),
+        ("board", fruid_board_t),
+        ("product", fruid_product_t),
+    ]
+
+# Field order and labels as printed by fruid-util
+FRUID_FIELDS = [
+    ("chassis", [
+        ("Chassis Type", "type_str", True),
+        ("Chassis Part Number", "part", True),
+        ("Chassis Serial Number", "serial", True),
+        ("Chassis Custom Data 1", "custom1", False),
+        ("Chassis Custom Data 2", "custom2", False),
+        ("Chassis Custom Data 3", "custom3", False),
+        ("Chassis Custom Data 4", "custom4", False)]),
+    ("board", [
+        ("Board Mfg Date", "mfg_time_str", True),
+        ("Board Mfg", "mfg", True),
+        ("Board Product", "name", True),
+        ("Board Serial", "serial", True),
+        ("Board Part Number", "part", True),
+        ("Board FRU ID", "fruid", True),
+        ("Board Custom Data 1", "custom1", False),
+        ("Board Custom Data 2", "custom2", False),
+        ("Board Custom Data 3", "custom3", False),
+        ("Board Custom Data 4", "custom4", False)]),
+    ("product", [
+        ("Product Manufacturer", "mfg", True),
+        ("Product Name", "name", True),
+        ("Product Part Number", "part", True),
+        ("Product Version", "version", True),
+        ("Product Serial", "serial", True),
+        ("Product Asset Tag", "asset_tag", True),
+        ("Product FRU ID", "fruid", True),
+        ("Product Custom Data 1", "custom1", False),
+        ("Product Custom Data 2", "custom2", False),
+        ("Product Custom Data 3", "custom3", False),
+        ("Product Custom Data 4", "custom4", False)]),
+]
+
+SYSLOG_FILES = ['/mnt/data/logfile.0', '/mnt/data/logfile']
+
+_libs = {}
+_libs_lock = threading.Lock()
+
+def _get_lib(name):
+    with _libs_lock:
+        if name not in _libs:
+            try:
+                _libs[name] = CDLL(name)
+            except OSError:
+                _libs[name] = None
+        return _libs[name]
+
+def ttl_cache(ttl):
+    '''
+    Memoize the result of a function per argument tuple for ttl seconds.
+    Results of None (not served natively) are not cached.
+    '''
+    def decorator(func):
+        cache = {}
+        lock = threading.Lock()
+
+        @functools.wraps(func)
+        def wrapper(*args):
+            now = time.time()
+            with lock:
+                entry = cache.get(args)
+                if entry is not None and now - entry[0] < ttl:
+                    return entry[1]
+            value = func(*args)
+            if value is not None:
+                with lock:
+                    cache[args] = (now, value)
+            return value
+        return wrapper
+    return decorator
+
+def pal_get_fru_id(name):
+    fru = c_uint8()
+    ret = lpal_hndl.pal_get_fru_id(create_string_buffer(name.encode()),
+                                   byref(fru))
+    if ret:
+        return None
+    return fru.value
+
+def pal_get_fru_list():
+    frulist = create_string_buffer(128)
+    ret = lpal_hndl.pal_get_fru_list(frulist)
+    if ret:
+        return None
+    return frulist.value.decode()
+
+def pal_fru_available(fru):
+    '''
+    Present and ready, as checked by the utilities before touching a FRU
+    '''
+    status = c_uint8()
+    if lpal_hndl.pal_is_fru_prsnt(fru, byref(status)) or status.value == 0:
+        return False
+    if lpal_hndl.pal_is_fru_ready(fru, byref(status)) or status.value == 0:
+        return False
+    return True
+
+def sensor_get_status(value, snr):
+    '''
+    Same ns/ok/unc/ucr/unr/lnc/lcr/lnr evaluation as sensor-util
+    '''
+    flag = snr.flag
+    status = 'ok' if flag else 'ns'
+    for bit, thresh, upper, name in (
+            (UNC_THRESH, snr.unc_thresh, True, 'unc'),
+            (UCR_THRESH, snr.ucr_thresh, True, 'ucr'),
+            (UNR_THRESH, snr.unr_thresh, True, 'unr'),
+            (LNC_THRESH, snr.lnc_thresh, False, 'lnc'),
+            (LCR_THRESH, snr.lcr_thresh, False, 'lcr'),
+            (LNR_THRESH, snr.lnr_thresh, False, 'lnr')):
+        if flag & (1 << bit) and (value >= thresh if upper else value <= thresh):
+            status = name
+    return status
+
+@ttl_cache(2)
+def sensor_read_fru(name):
+    '''
+    Read all the sensors of a FRU from the sensor cache in one pass.
+    Returns a list of (num, thresh_sensor_t, value) with value None for an
+    unavailable reading, [] if the FRU or its SDR is not available.
+    '''
+    sdr = _get_lib("libsdr.so")
+    if sdr is None:
+        return None
+
+    fru = pal_get_fru_id(name)
+    if fru is None or fru == FRU_ALL:
+        return None
+
+    if not pal_fru_available(fru):
+        return []
+
+    sensor_list = POINTER(c_uint8)()
+    sensor_cnt = c_int()
+    if lpal_hndl.pal_get_fru_sensor_list(fru, byref(sensor_list),
+                                         byref(sensor_cnt)) < 0:
+        return []
+
+    cnt = sensor_cnt.value
+    snr_list = (c_uint8 * cnt)(*sensor_list[:cnt])
+    thresh = (thresh_sensor_t * cnt)()
+    status = (c_int * cnt)()
+    if sdr.sdr_get_snr_thresh_list(fru, snr_list, cnt, thresh, status) < 0:
+        return []
+
+    result = []
+    value = c_float()
+    for i in range(cnt):
+        if status[i] < 0:
+            continue
+        if lpal_hndl.sensor_cache_read(fru, snr_list[i], byref(value)) == 0:
+            result.append((snr_list[i], thresh[i], value.value))
+        else:
+            result.append((snr_list[i], thresh[i], None))
+    return result
+
+_fruid_cache = {}
+_fruid_lock = threading.Lock()
+
+def fruid_read(name):
+    '''
+    Parse the FRUID binary of a FRU. Returns a list of (label, value) in
+    the order printed by fruid-util, [] if the FRU is not available. The
+    result is kept until the binary changes.
+    '''
+    lfruid = _get_lib("libfruid.so")
+    if lfruid is None:
+        return None
+
+    fru = pal_get_fru_id(name)
+    if fru is None or fru == FRU_ALL:
+        return None
+
+    if not pal_fru_available(fru):
+        return []
+
+    path = create_string_buffer(64)
+    if lpal_hndl.pal_get_fruid_path(fru, path) < 0:
+        return []
+
+    try:
+        st = os.stat(path.value)
+    except OSError:
+        return []
+    key = (st.st_ino, st.st_size, st.st_mtime)
+
+    with _fruid_lock:
+        entry = _fruid_cache.get(path.value)
+        if entry is not None and entry[0] == key:
+            return entry[1]
+
+    info = fruid_info_t()
+    if lfruid.fruid_parse(path.value, byref(info)):
+        return []
+
+    result = []
+    try:
+        for area, fields in FRUID_FIELDS:
+            area = getattr(info, area)
+            if not area.flag:
+                continue
+            for label, field, mandatory in fields:
+                value = getattr(area, field)
+                if value is None:
+                    # printf("%s", NULL) in fruid-util
+                    if not mandatory:
+                        continue
+                    value = '(null)'
+                else:
+                    value = value.decode(errors='replace').strip()
+                result.append((label, value))
+    finally:
+        lfruid.free_fruid_info(byref(info))
+
+    with _fruid_lock:
+        _fruid_cache[path.value] = (key, result)
+    return result
+
+class _logfile:
+    '''
+    Critical entries of one syslog file. Only the bytes appended since the
+    last call are parsed, the file is re-read from the start when it has
+    been rotated, rewritten by a clear or the year changed.
+    '''
+    crit_re = re.compile(r' [a-z]*.crit ')
+    fru_re = re.compile(r'FRU: [0-9]{1,2}', re.IGNORECASE)
+
+    def __init__(self, path):
+        self.path = path
+        self.reset(None)
+
+    def reset(self, ino):
+        self.ino = ino
+        self.offset = 0
+        self.year = datetime.now().year
+        self.entries = []
+
+    def parse(self, line):
+        # log-util prints its own entries unformatted, they never make it
+        # into the REST output
+        if 'log-util:' in line or not self.crit_re.search(line):
+            return None
+
+        m = self.fru_re.search(line)
+        fru_num = m.group(0)[5] if m else '0'
+
+        # log eg: Nov 21 21:46:09 host user.crit version: app: message
+        tmp = line.split()
+        if len(tmp) < 7:
+            return None
+        try:
+            ts = datetime.strptime('%d %s' % (self.year, ' '.join(tmp[0:3])),
+                                   '%Y %b %d %H:%M:%S')
+        except ValueError:
+            return None
+
+        return (fru_num, ts.strftime('%Y-%m-%d %H:%M:%S'), tmp[6].strip(':'),
+                ' '.join(tmp[7:]))
+
+    def update(self):
+        try:
+            st = os.stat(self.path)
+        except OSError:
+            self.reset(None)
+            return
+        if (st.st_ino != self.ino or st.st_size < self.offset or
+                datetime.now().year != self.year):
+            self.reset(st.st_ino)
+        if st.st_size == self.offset:
+            return
+
+        try:
+            with open(self.path, 'rb') as f:
+                f.seek(self.offset)
+                data = f.read(st.st_size - self.offset)
+        except IOError:
+            return
+
+        # Leave a partially written last line for the next call
+        end = data.rfind(b'\n') + 1
+        self.offset += end
+        for line in data[:end].decode('utf-8', 'replace').splitlines():
+            entry = self.parse(line)
+            if entry is not None:
+                self.entries.append(entry)
+
+_logfiles = [_logfile(path) for path in SYSLOG_FILES]
+_logfiles_lock = threading.Lock()
+
+def log_read(name):
+    '''
+    Critical log entries of a FRU ('all' and 'sys' included) as
+    (fru_num, fru_name, time_stamp, app_name, message) tuples, oldest
+    first, with the same FRU attribution as log-util.
+    '''
+    frus = pal_get_fru_list()
+    if frus is None:
+        return None
+    frulist = re.split(r',\s', frus)
+    frulist.append('sys')
+    if name not in frulist:
+        return []
+
+    result = []
+    with _logfiles_lock:
+        for logfile in _logfiles:
+            logfile.update()
+            for fru_num, ts, app, message in logfile.entries:
+                if name == 'sys' and fru_num == '0':
+                    fruname = 'sys'
+                elif int(fru_num) < len(frulist):
+                    fruname = frulist[int(fru_num)]
+                else:
+                    continue
+                if name != 'all' and name != fruname:
+                    continue
+                result.append((fru_num, fruname, ts, app, message))
+    return result
+
+@ttl_cache(2)
+def kv_read(path):
+    '''
+    Contents of a small state file such as a kv_store entry, '' if missing
+    '''
+    try:
+        with open(path, 'r') as f:
+            return f.read()
+    except IOError:
+        return ''
@@ -20,6 +20,7 @@
 
 from subprocess import *
 from node import node
+from native import fruid_read
 
 class fruidNode(node):
     def __init__(self, name, info = None, actions = None):
@@ -35,9 +36,16 @@ class fruidNode(node):
             self.actions = actions
 
     def getInformation(self):
+        fruid = fruid_read(self.name)
+        if fruid is None:
+            return self.getUtilInformation()
+
+        return dict(fruid)
+
+    def getUtilInformation(self):
         result = {}
-        cmd = '/usr/local/bin/fruid-util ' + self.name
-        data = Popen(cmd, shell=True, stdout=PIPE).stdout.read()
+        cmd = ['/usr/local/bin/fruid-util', self.name]
+        data = Popen(cmd, stdout=PIPE).stdout.read()
         data = data.decode()
         sdata = data.split('\n')
         for line in sdata:
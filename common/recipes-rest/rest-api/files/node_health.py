@@ -3,6 +3,7 @@
 from subprocess import *
 from node import node
 from pal import *
+from native import kv_read
 
 class healthNode(node):
     def __init__(self, name = None, info = None, actions = None):
@@ -24,30 +25,21 @@ class healthNode(node):
         result = "NA"
         # Enclosure health LED status (GOOD/BAD)
         if (name == "FBTTN"):
-            dpb_hlth = Popen('cat /mnt/data/kv_store/dpb_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            iom_hlth = Popen('cat /mnt/data/kv_store/iom_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            nic_hlth = Popen('cat /mnt/data/kv_store/nic_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            scc_hlth = Popen('cat /mnt/data/kv_store/scc_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            slot1_hlth = Popen('cat /mnt/data/kv_store/slot1_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
+            dpb_hlth = kv_read('/mnt/data/kv_store/dpb_sensor_health')
+            iom_hlth = kv_read('/mnt/data/kv_store/iom_sensor_health')
+            nic_hlth = kv_read('/mnt/data/kv_store/nic_sensor_health')
+            scc_hlth = kv_read('/mnt/data/kv_store/scc_sensor_health')
+            slot1_hlth = kv_read('/mnt/data/kv_store/slot1_sensor_health')
 
             if ((dpb_hlth == "1")&(iom_hlth == "1")&(nic_hlth == "1")&(scc_hlth == "1")&(slot1_hlth == "1")):
                 result = "Good"
             else:
                 result = "Bad"
         elif (name == "Lightning"):
-            peb_hlth = Popen('cat /tmp/peb_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            pdpb_hlth = Popen('cat /tmp/pdpb_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            fcb_hlth = Popen('cat /tmp/fcb_sensor_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
-            bmc_hlth = Popen('cat /tmp/bmc_health', \
-                                shell=True, stdout=PIPE).stdout.read().decode()
+            peb_hlth = kv_read('/tmp/peb_sensor_health')
+            pdpb_hlth = kv_read('/tmp/pdpb_sensor_health')
+            fcb_hlth = kv_read('/tmp/fcb_sensor_health')
+            bmc_hlth = kv_read('/tmp/bmc_health')
 
             if ((peb_hlth == "1") and (pdpb_hlth == "1")
                     and (fcb_hlth == "1") and (bmc_hlth == "1")):
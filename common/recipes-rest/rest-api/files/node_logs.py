@@ -21,6 +21,7 @@
 import re
 from subprocess import *
 from node import node
+from native import log_read
 
 class logsNode(node):
     def __init__(self, name, info = None, actions = None):
@@ -36,9 +37,29 @@ class logsNode(node):
             self.actions = actions
 
     def getInformation(self):
+        logs = log_read(self.name)
+        if logs is None:
+            return self.getUtilInformation()
+
+        linfo = []
+        for fru_num, fru_name, time_stamp, app_name, message in logs:
+            temp = {
+                    "FRU#": fru_num,
+                    "FRU_NAME": fru_name,
+                    "TIME_STAMP": time_stamp,
+                    "APP_NAME": app_name,
+                    "MESSAGE": message,
+                   }
+
+            linfo.append(temp)
+
+        result = { "Logs": linfo }
+        return result
+
+    def getUtilInformation(self):
         linfo = []
-        cmd = '/usr/local/bin/log-util ' + self.name +' --print'
-        data = Popen(cmd, shell=True, stdout=PIPE).stdout.read()
+        cmd = ['/usr/local/bin/log-util', self.name, '--print']
+        data = Popen(cmd, stdout=PIPE).stdout.read()
         data = data.decode()
         sdata = data.split('\n')
         for line in sdata:
@@ -72,8 +93,8 @@ class logsNode(node):
         if data["action"] != "clear":
             res = 'failure'
         else:
-            cmd = '/usr/local/bin/log-util ' + self.name +' --clear'
-            data = Popen(cmd, shell=True, stdout=PIPE).stdout.read()
+            cmd = ['/usr/local/bin/log-util', self.name, '--clear']
+            data = Popen(cmd, stdout=PIPE).stdout.read()
             data = data.decode()
             if data.startswith( 'Usage' ):
                 res = 'failure'
@@ -23,6 +23,7 @@ import json
 import os
 import re
 from node import node
+from native import *
 
 class sensorsNode(node):
     def __init__(self, name, info = None, actions = None):
@@ -37,9 +38,39 @@ class sensorsNode(node):
             self.actions = actions
 
     def getInformation(self):
+        sensors = sensor_read_fru(self.name)
+        if sensors is None:
+            return self.getUtilInformation()
+
+        # Same keys and values as the text output of sensor-util --threshold
+        result = {}
+        for num, snr, value in sensors:
+            key = ('%-28s (0x%X)' % (snr.name.decode(), num)).strip()
+            if value is None:
+                result[key] = 'NA | (na)'
+                continue
+
+            data = '%7.2f %-5s | (%s)' % (value, snr.units.decode(),
+                                          sensor_get_status(value, snr))
+            for label, bit, thresh in (
+                    ('UCR', UCR_THRESH, snr.ucr_thresh),
+                    ('UNC', UNC_THRESH, snr.unc_thresh),
+                    ('UNR', UNR_THRESH, snr.unr_thresh),
+                    ('LCR', LCR_THRESH, snr.lcr_thresh),
+                    ('LNC', LNC_THRESH, snr.lnc_thresh),
+                    ('LNR', LNR_THRESH, snr.lnr_thresh)):
+                if snr.flag & (1 << bit):
+                    data += ' | %s: %.2f' % (label, thresh)
+                else:
+                    data += ' | %s: NA' % label
+            result[key] = data.strip()
+
+        return result
+
+    def getUtilInformation(self):
         result = {}
-        cmd = '/usr/local/bin/sensor-util ' + self.name + ' --threshold'
-        data = Popen(cmd, shell=True, stdout=PIPE).stdout.read().decode()
+        cmd = ['/usr/local/bin/sensor-util', self.name, '--threshold']
+        data = Popen(cmd, stdout=PIPE).stdout.read().decode()
         sdata = data.split('\n')
         for line in sdata:
             # skip lines with " or startin with FRU
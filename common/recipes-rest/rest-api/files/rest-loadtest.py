@@ -0,0 +1,122 @@
+#!/usr/bin/env python
+#
+# Copyright 2017-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+# Load test of the REST API with a mix of fast and slow resources.
+# Every client keeps one persistent connection and walks the resources
+# round robin; throughput and latency percentiles are reported per resource.
+#
+# eg: rest-loadtest.py --clients 8 --duration 30 \
+#         /api/spb /api/spb/bmc /api/spb/sensors /api/server1/fruid
+
+import argparse
+import http.client
+import ssl
+import threading
+import time
+
+def percentile(samples, pct):
+    if not samples:
+        return 0.0
+    return samples[min(len(samples) - 1, int(len(samples) * pct / 100.0))]
+
+def client(args, paths, offset, stats, lock, stop):
+    conn = None
+    i = offset
+    while not stop.is_set():
+        path = paths[i % len(paths)]
+        i += 1
+        if conn is None:
+            if args.https:
+                conn = http.client.HTTPSConnection(args.host, args.port,
+                    timeout = args.timeout,
+                    context = ssl._create_unverified_context())
+            else:
+                conn = http.client.HTTPConnection(args.host, args.port,
+                    timeout = args.timeout)
+
+        start = time.time()
+        try:
+            conn.request('GET', path)
+            resp = conn.getresponse()
+            resp.read()
+            status = resp.status
+            if resp.will_close or args.no_keepalive:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            status = 'error'
+            conn.close()
+            conn = None
+        elapsed = time.time() - start
+
+        with lock:
+            s = stats.setdefault(path, {'latency': [], 'status': {}})
+            s['latency'].append(elapsed)
+            s['status'][status] = s['status'].get(status, 0) + 1
+
+    if conn is not None:
+        conn.close()
+
+def main():
+    parser = argparse.ArgumentParser(description = 'Load test the REST API.')
+    parser.add_argument('--host', default = 'localhost')
+    parser.add_argument('--port', type = int, default = 8080)
+    parser.add_argument('--https', action = 'store_true')
+    parser.add_argument('--clients', type = int, default = 8)
+    parser.add_argument('--duration', type = float, default = 10)
+    parser.add_argument('--timeout', type = float, default = 30)
+    parser.add_argument('--no-keepalive', action = 'store_true',
+                        help = 'open a new connection for every request')
+    parser.add_argument('paths', nargs = '+', help = 'resources to request')
+    args = parser.parse_args()
+
+    stats = {}
+    lock = threading.Lock()
+    stop = threading.Event()
+    threads = [threading.Thread(target = client,
+                                args = (args, args.paths, n, stats, lock, stop))
+               for n in range(args.clients)]
+    start = time.time()
+    for t in threads:
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join()
+    elapsed = time.time() - start
+
+    total = sum(len(s['latency']) for s in stats.values())
+    print('%d requests in %.1f s, %.1f req/s' % (total, elapsed, total / elapsed))
+    print('%-32s %6s %8s %8s %8s %8s  %s' % (
+        'RESOURCE', 'COUNT', 'P50_MS', 'P90_MS', 'P99_MS', 'MAX_MS', 'STATUS'))
+    for path in args.paths:
+        s = stats.get(path)
+        if s is None:
+            continue
+        lat = sorted(s['latency'])
+        print('%-32s %6d %8.1f %8.1f %8.1f %8.1f  %s' % (
+            path, len(lat),
+            percentile(lat, 50) * 1000, percentile(lat, 90) * 1000,
+            percentile(lat, 99) * 1000, lat[-1] * 1000,
+            ' '.join('%s:%d' % (k, v) for k, v in sorted(
+                s['status'].items(), key = lambda kv: str(kv[0])))))
+
+if __name__ == '__main__':
+    main()
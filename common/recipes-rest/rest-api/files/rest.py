@@ -21,11 +21,11 @@
 from ctypes import *
 from bottle import route, run, template, request, response, ServerAdapter
 from bottle import abort
-from wsgiref.simple_server import make_server, WSGIRequestHandler, WSGIServer
+from rest_server import *
 import json
-import ssl
-import socket
+import threading
 import os
+import syslog
 from tree import tree
 from node import node
 from plat_tree import init_plat_tree
@@ -34,6 +34,36 @@ CONSTANTS = {
     'certificate': '/usr/lib/ssl/certs/rest_server.pem',
 }
 
+# Resources that go out to a BIC, an EEPROM or an external utility are
+# limited in how many requests for them run at the same time, and every
+# request has a deadline: class -> (max concurrent, timeout in seconds).
+# POST requests (power, identify, log clear, ...) form the 'action' class.
+ENDPOINT_CLASSES = {
+    'fruid':   (2, 15),
+    'sensors': (4, 15),
+    'logs':    (2, 15),
+    'action':  (2, 60),
+    'default': (0, 15),
+}
+
+limiter = EndpointLimiter(ENDPOINT_CLASSES)
+
+def endpoint_class(token, method):
+    if method == 'POST':
+        return 'action'
+    for t in reversed(token):
+        if t in ENDPOINT_CLASSES:
+            return t
+    return 'default'
+
+def limited_call(token, method, func, *args):
+    try:
+        return limiter.call(endpoint_class(token, method), func, *args)
+    except EndpointBusy:
+        abort(503, 'Too many requests in progress for this resource')
+    except EndpointTimeout:
+        abort(504, 'Timed out serving this resource')
+
 root = init_plat_tree()
 
 # Generic router for incoming requests
@@ -51,7 +81,7 @@ def url_router(path):
     # Handle GET request
     if request.method == 'GET':
         # Gather info/actions directly from respective node
-        info = c.getInformation()
+        info = limited_call(token, 'GET', c.getInformation)
         actions = c.getActions()
 
         # Create list of resources from tree structure
@@ -68,39 +98,34 @@ def url_router(path):
     # Handle POST request
     if request.method == 'POST':
         lines = request.body.readlines()
-        return c.doAction(json.loads(lines[0].decode()))
+        return limited_call(token, 'POST', c.doAction,
+                            json.loads(lines[0].decode()))
 
     return None
 
-run(host = "::", port = 8080)
-
-# TODO: Test the https connection with proper certificates
-# SSL Wrapper for Rest API
-class SSLWSGIRefServer(ServerAdapter):
+# Thread pool server with persistent connections, see rest_server.py
+class PooledServer(ServerAdapter):
     def run(self, handler):
-        if self.quiet:
-            class QuietHandler(WSGIRequestHandler):
-                def log_request(*args, **kw): pass
-            self.options['handler_class'] = QuietHandler
-
-        # IPv6 Support
-        server_cls = self.options.get('server_class', WSGIServer)
-
-        if ':' in self.host:
-            if getattr(server_cls, 'address_family') == socket.AF_INET:
-                class server_cls(server_cls):
-                    address_family = socket.AF_INET6
-
-        srv = make_server(self.host, self.port, handler,
-                server_class=server_cls, **self.options)
-        srv.socket = ssl.wrap_socket (
-                srv.socket,
-                certfile=CONSTANTS['certificate'],
-                server_side=True)
+        srv = PooledWSGIServer((self.host, self.port),
+                               ssl_context = self.options.get('ssl_context'))
+        srv.quiet = self.quiet
+        srv.set_app(handler)
         srv.serve_forever()
 
-# Use SSL if the certificate exists. Otherwise, run without SSL.
+# Serve HTTPS as well if the certificate exists. TLS sessions are resumed
+# through the single context shared by all connections. The context is set
+# up in the thread so that a bad certificate only loses HTTPS.
+def run_https():
+    try:
+        context = make_ssl_context(CONSTANTS['certificate'])
+    except Exception as e:
+        syslog.syslog(syslog.LOG_ERR, "rest-api: HTTPS disabled, {}".format(e))
+        return
+    run(server = PooledServer(host = "::", port = 8443, ssl_context = context))
+
 if os.access(CONSTANTS['certificate'], os.R_OK):
-    run(server=SSLWSGIRefServer(host="::", port=8443))
-else:
-    run(host = "::", port = 8080)
+    t = threading.Thread(target = run_https)
+    t.daemon = True
+    t.start()
+
+run(server = PooledServer(host = "::", port = 8080))
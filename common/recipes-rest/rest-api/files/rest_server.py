@@ -0,0 +1,213 @@
+#!/usr/bin/env python
+#
+# Copyright 2017-present Facebook. All Rights Reserved.
+#
+# This program file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+# for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program in a file named COPYING; if not, write to the
+# Free Software Foundation, Inc.,
+# 51 Franklin Street, Fifth Floor,
+# Boston, MA 02110-1301 USA
+#
+
+# WSGI server for the REST API: a bounded pool of worker threads serving
+# HTTP/1.1 persistent connections, optionally over TLS, and a limiter that
+# bounds the concurrency and run time of classes of endpoints.
+
+from concurrent.futures import ThreadPoolExecutor
+from concurrent.futures import TimeoutError as FutureTimeoutError
+from wsgiref.simple_server import WSGIServer, WSGIRequestHandler
+from wsgiref.simple_server import ServerHandler
+import queue
+import socket
+import ssl
+import sys
+import threading
+import time
+
+# Worker threads serving connections
+WORKERS = 8
+# Accepted connections waiting for a worker before accept() blocks
+BACKLOG = 32
+# Idle time after which a persistent connection is closed
+KEEPALIVE_TIMEOUT = 5
+
+class KeepAliveServerHandler(ServerHandler):
+    http_version = "1.1"
+
+    def cleanup_headers(self):
+        ServerHandler.cleanup_headers(self)
+        rh = self.request_handler
+
+        # The connection can only be kept when the client can find the end
+        # of the response. Give the worker up when others are waiting.
+        if ('Content-Length' not in self.headers or
+                self.environ.get('CONTENT_LENGTH', '') not in ('', '0') or
+                not rh.server.idle()):
+            rh.close_connection = True
+
+        if rh.close_connection:
+            self.headers['Connection'] = 'close'
+        elif rh.request_version == 'HTTP/1.0':
+            self.headers['Connection'] = 'keep-alive'
+
+class KeepAliveRequestHandler(WSGIRequestHandler):
+    protocol_version = "HTTP/1.1"
+    timeout = KEEPALIVE_TIMEOUT
+
+    def setup(self):
+        # The TLS handshake is done here rather than in accept() so that a
+        # slow client only holds its own worker
+        if isinstance(self.request, ssl.SSLSocket):
+            self.request.settimeout(self.timeout)
+            self.request.do_handshake()
+        WSGIRequestHandler.setup(self)
+
+    def handle(self):
+        self.close_connection = True
+        self.handle_one_request()
+        while not self.close_connection:
+            self.handle_one_request()
+
+    def handle_one_request(self):
+        try:
+            self.raw_requestline = self.rfile.readline(65537)
+        except (socket.timeout, OSError):
+            self.close_connection = True
+            return
+        if len(self.raw_requestline) > 65536:
+            self.requestline = ''
+            self.request_version = ''
+            self.command = ''
+            self.send_error(414)
+            self.close_connection = True
+            return
+        if not self.raw_requestline:
+            self.close_connection = True
+            return
+
+        # Sets close_connection from the request version and headers
+        if not self.parse_request():
+            return
+
+        handler = KeepAliveServerHandler(
+            self.rfile, self.wfile, self.get_stderr(), self.get_environ(),
+            multithread=True)
+        handler.request_handler = self
+        handler.run(self.server.get_app())
+
+    def log_request(self, *args, **kw):
+        if not self.server.quiet:
+            WSGIRequestHandler.log_request(self, *args, **kw)
+
+class PooledWSGIServer(WSGIServer):
+    quiet = False
+
+    def __init__(self, server_address, handler_class = KeepAliveRequestHandler,
+                 ssl_context = None, workers = WORKERS, backlog = BACKLOG):
+        if ':' in server_address[0]:
+            self.address_family = socket.AF_INET6
+        WSGIServer.__init__(self, server_address, handler_class)
+        self.ssl_context = ssl_context
+        self.requests = queue.Queue(maxsize = backlog)
+        for i in range(workers):
+            t = threading.Thread(target = self.worker)
+            t.daemon = True
+            t.start()
+
+    def idle(self):
+        return self.requests.empty()
+
+    def get_request(self):
+        sock, addr = self.socket.accept()
+        # Status line, headers and body go out in separate writes, do not
+        # let them wait for the ACK of the previous response
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        if self.ssl_context is not None:
+            sock = self.ssl_context.wrap_socket(sock, server_side = True,
+                                                do_handshake_on_connect = False)
+        return sock, addr
+
+    def process_request(self, request, client_address):
+        # Blocks accepting further connections while all workers are busy
+        # and the backlog is full
+        self.requests.put((request, client_address))
+
+    def worker(self):
+        while True:
+            request, client_address = self.requests.get()
+            try:
+                self.finish_request(request, client_address)
+            except Exception:
+                self.handle_error(request, client_address)
+            finally:
+                self.shutdown_request(request)
+
+    def handle_error(self, request, client_address):
+        # Clients going away or failing the handshake are not worth a trace
+        if isinstance(sys.exc_info()[1], OSError):
+            return
+        WSGIServer.handle_error(self, request, client_address)
+
+def make_ssl_context(certfile):
+    '''
+    One context for all connections so that the session cache and the
+    session tickets let returning clients skip the full handshake
+    '''
+    # PROTOCOL_TLS_SERVER and OP_NO_TICKET are not in the Python 3.5 of
+    # the image; tickets are on unless OP_NO_TICKET is set
+    context = ssl.SSLContext(ssl.PROTOCOL_SSLv23)
+    context.options |= ssl.OP_NO_SSLv2 | ssl.OP_NO_SSLv3
+    context.load_cert_chain(certfile = certfile)
+    context.options &= ~getattr(ssl, 'OP_NO_TICKET', 0)
+    return context
+
+class EndpointBusy(Exception):
+    pass
+
+class EndpointTimeout(Exception):
+    pass
+
+class EndpointLimiter:
+    '''
+    Runs endpoint handlers with a deadline and at most limit of them in
+    flight per endpoint class. classes maps a class name to
+    (limit, timeout in seconds), a limit of 0 means unlimited. A handler
+    that misses its deadline keeps its slot until it really finishes.
+    '''
+    def __init__(self, classes, workers = WORKERS * 2):
+        self.classes = classes
+        self.slots = {}
+        for name, (limit, timeout) in classes.items():
+            if limit:
+                self.slots[name] = threading.BoundedSemaphore(limit)
+        self.executor = ThreadPoolExecutor(max_workers = workers)
+
+    def call(self, cls, func, *args):
+        limit, timeout = self.classes[cls]
+        deadline = time.time() + timeout
+
+        slot = self.slots.get(cls)
+        if slot is not None and not slot.acquire(timeout = timeout):
+            raise EndpointBusy(cls)
+        try:
+            future = self.executor.submit(func, *args)
+        except Exception:
+            if slot is not None:
+                slot.release()
+            raise
+        if slot is not None:
+            future.add_done_callback(lambda f: slot.release())
+
+        try:
+            return future.result(timeout = max(0, deadline - time.time()))
+        except FutureTimeoutError:
+            raise EndpointTimeout(cls)
@@ -585,6 +585,12 @@ static const i2c_dev_attr_st cmmcpld_attr_table[] = {
   },
 };
 
+/* PCB version, module and slot id are strapped, not the CPLD version */
+static const i2c_dev_reg_st cmmcpld_reg_table[] = {
+  { 0x0, 0x0, I2C_DEV_REG_NONVOLATILE },
+  { 0x3, 0x3, I2C_DEV_REG_NONVOLATILE },
+};
+
 static i2c_dev_data_st cmmcpld_data;
 
 /*
@@ -616,8 +622,10 @@ static int cmmcpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(cmmcpld_attr_table) / sizeof(cmmcpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &cmmcpld_data,
-                                 cmmcpld_attr_table, n_attrs);
+  return i2c_dev_sysfs_data_init_regmap(client, &cmmcpld_data,
+                                        cmmcpld_attr_table, n_attrs,
+                                        cmmcpld_reg_table,
+                                        ARRAY_SIZE(cmmcpld_reg_table));
 }
 
 static int cmmcpld_remove(struct i2c_client *client)
@@ -314,6 +314,11 @@ static const i2c_dev_attr_st fancpld_attr_table[] = {
   FAN_ENREIS("fan5", "fan6", "fantray3", 0x40),
 };
 
+/* PCB version is strapped, not the CPLD version */
+static const i2c_dev_reg_st fancpld_reg_table[] = {
+  { 0x0, 0x0, I2C_DEV_REG_NONVOLATILE },
+};
+
 static i2c_dev_data_st fancpld_data;
 
 /*
@@ -345,8 +350,10 @@ static int fancpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(fancpld_attr_table) / sizeof(fancpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &fancpld_data,
-                                 fancpld_attr_table, n_attrs);
+  return i2c_dev_sysfs_data_init_regmap(client, &fancpld_data,
+                                        fancpld_attr_table, n_attrs,
+                                        fancpld_reg_table,
+                                        ARRAY_SIZE(fancpld_reg_table));
 }
 
 static int fancpld_remove(struct i2c_client *client)
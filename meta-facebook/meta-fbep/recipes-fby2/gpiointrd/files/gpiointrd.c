@@ -34,6 +34,7 @@
 #include <openbmc/ipmi.h>
 #include <openbmc/pal.h>
 #include <openbmc/gpio.h>
+#include <openbmc/hsvc.h>
 #include <facebook/bic.h>
 #include <facebook/fby2_gpio.h>
 #include <facebook/fby2_sensor.h>
@@ -52,10 +53,6 @@
 
 #define DEBUG_ME_EJECTOR_LOG 1 // Enable log "GPIO_SLOTX_EJECTOR_LATCH_DETECT_N is 1 and SLOT_12v is ON" before mechanism issue is fixed
 
-static uint8_t IsHotServiceStart[MAX_NODES + 1] = {0};
-static void *hsvc_event_handler(void *ptr);
-static pthread_mutex_t hsvc_mutex[MAX_NODES + 1];
-
 char *fru_prsnt_log_string[3 * MAX_NUM_FRUS] = {
   // slot1, slot2, slot3, slot4
  "", "Slot1 Removal", "Slot2 Removal", "Slot3 Removal", "Slot4 Removal", "",
@@ -77,21 +74,6 @@ typedef struct {
   char slot_def_val[32];
 } slot_kv_st;
 
-struct delayed_log {
-  useconds_t usec;
-  char msg[256];
-};
-
-typedef struct {
-  uint8_t slot_id;
-  uint8_t action;
-} hot_service_info;
-
-enum {
-  REMOVAl = 0,
-  INSERTION = 1,
-};
-
 slot_kv_st slot_kv_list[] = {
   // {slot_key, slot_def_val}
   {"pwr_server%d_last_state", "on"},
@@ -104,24 +86,6 @@ slot_kv_st slot_kv_list[] = {
   {"fru%d_restart_cause",      "3"},
 };
 
-// Thread for delay event
-static void *
-delay_log(void *arg)
-{
-  struct delayed_log* log = (struct delayed_log*)arg;
-
-  pthread_detach(pthread_self());
-
-  if (arg) {
-    usleep(log->usec);
-    syslog(LOG_CRIT, log->msg);
-
-    free(arg);
-  }
-
-  pthread_exit(NULL);
-}
-
 static int
 read_device(const char *device, int *value) {
   FILE *fp;
@@ -177,22 +141,13 @@ write_device(const char *device, const char *value) {
 
 static void log_gpio_change(gpio_poll_st *gp, useconds_t log_delay)
 {
+  char msg[256];
+
   if (log_delay == 0) {
     syslog(LOG_CRIT, "%s: %s - %s\n", gp->value ? "DEASSERT": "ASSERT", gp->name, gp->desc);
   } else {
-    pthread_t tid_delay_log;
-    struct delayed_log *log = (struct delayed_log *)malloc(sizeof(struct delayed_log));
-    if (log) {
-      log->usec = log_delay;
-      snprintf(log->msg, 256, "%s: %s - %s\n", gp->value ? "DEASSERT" : "ASSERT", gp->name, gp->value);
-      if (pthread_create(&tid_delay_log, NULL, delay_log, (void *)log)) {
-        free(log);
-        log = NULL;
-      }
-    }
-    if (!log) {
-      syslog(LOG_CRIT, "%s: %s - %s\n", gp->value ? "DEASSERT": "ASSERT", gp->name, gp->desc);
-    }
+    snprintf(msg, sizeof(msg), "%s: %s - %s\n", gp->value ? "DEASSERT" : "ASSERT", gp->name, gp->desc);
+    hsvc_log_delayed(log_delay / 1000, msg);
   }
 }
 
@@ -206,9 +161,6 @@ static void gpio_event_handle(gpio_poll_st *gp)
   int status;
   char vpath[80] = {0};
   char locstr[MAX_VALUE_LEN];
-  static bool prsnt_assert[MAX_NODES + 1]={0};
-  static pthread_t hsvc_action_tid[MAX_NODES + 1];
-  hot_service_info hsvc_info[MAX_NODES + 1];
 
   if (gp->gs.gs_gpio == gpio_num("GPIOH5")) { // GPIO_FAN_LATCH_DETECT
     if (gp->value == 1) { // low to high
@@ -274,64 +226,13 @@ static void gpio_event_handle(gpio_poll_st *gp)
     else if (gp->gs.gs_gpio >= GPIO_SLOT1_PRSNT_N && gp->gs.gs_gpio <= GPIO_SLOT4_PRSNT_N)
        slot_id = (gp->gs.gs_gpio - GPIO_SLOT1_PRSNT_N) + 1;
 
-    // Use flag to ignore the interrupt of pair present pin
-    if (prsnt_assert[slot_id])
-    {
-       prsnt_assert[slot_id] = false;
-       return;
-    }
-
     sprintf(vpath, GPIO_VAL, GPIO_FAN_LATCH_DETECT);
     read_device(vpath, &value);
 
-    // HOT SERVER event would be detected when SLED is pulled out
+    // HOT SERVER event would be detected when SLED is pulled out.
+    // Both present pins of the slot re-arm the same settle timer.
     if (value) {
-       prsnt_assert[slot_id] = true;
-
-       if (gp->value == 1) { // SLOT Removal
-          hsvc_info[slot_id].slot_id = slot_id;
-          hsvc_info[slot_id].action = REMOVAl;
-
-          pthread_mutex_lock(&hsvc_mutex[slot_id]);
-          if ( IsHotServiceStart[slot_id] )
-          {
-#ifdef DEBUG
-            syslog(LOG_WARNING, "[%s] Close the previous thread for slot%x\n", __func__, slot_id);
-#endif
-            pthread_cancel(hsvc_action_tid[slot_id]);
-          }
-
-          //Create thread for hsvc event detect
-          if (pthread_create(&hsvc_action_tid[slot_id], NULL, hsvc_event_handler, &hsvc_info[slot_id]) < 0) {
-            syslog(LOG_WARNING, "[%s] Create hsvc_event_handler thread for slot%x\n",__func__, slot_id);
-            pthread_mutex_unlock(&hsvc_mutex[slot_id]);
-            return;
-          }
-          IsHotServiceStart[slot_id] = true;
-          pthread_mutex_unlock(&hsvc_mutex[slot_id]);
-       }
-       else { // SLOT INSERTION
-          hsvc_info[slot_id].slot_id = slot_id;
-          hsvc_info[slot_id].action = INSERTION;
-
-          pthread_mutex_lock(&hsvc_mutex[slot_id]);
-          if ( IsHotServiceStart[slot_id] )
-          {
-#ifdef DEBUG
-            syslog(LOG_WARNING, "[%s] Close the previous thread for slot%x\n", __func__, slot_id);
-#endif
-            pthread_cancel(hsvc_action_tid[slot_id]);
-          }
-
-          //Create thread for hsvc event detect
-          if (pthread_create(&hsvc_action_tid[slot_id], NULL, hsvc_event_handler, &hsvc_info[slot_id]) < 0) {
-            syslog(LOG_WARNING, "[%s] Create hsvc_event_handler thread for slot%x\n",__func__, slot_id);
-            pthread_mutex_unlock(&hsvc_mutex[slot_id]);
-            return;
-          }
-          IsHotServiceStart[slot_id] = true;
-          pthread_mutex_unlock(&hsvc_mutex[slot_id]);
-       }
+      hsvc_edge(slot_id, gp->value ? HSVC_REMOVAL : HSVC_INSERTION);
     }
   } // End of GPIO_SLOT1/2/3/4_PRSNT_B_N, GPIO_SLOT1/2/3/4_PRSNT_N
   else if (gp->gs.gs_gpio == gpio_num("GPIOO3")) {
@@ -346,8 +247,20 @@ static void gpio_event_handle(gpio_poll_st *gp)
   }
 }
 
-static void *
-hsvc_event_handler(void *ptr) {
+static int
+hsvc_is_prsnt(uint8_t slot_id) {
+  uint8_t value;
+
+  if (pal_is_fru_prsnt(slot_id, &value) < 0) {
+    syslog(LOG_CRIT, "%s pal_is_fru_prsnt failed for fru: %d\n", __func__, slot_id);
+    return -1;
+  }
+  return value;
+}
+
+// Work after the present pins of a slot settled, run on the hsvc workers
+static void
+hsvc_action(uint8_t slot_id, hsvc_action_t action) {
 
   int ret=-1;
   uint8_t value;
@@ -359,84 +272,66 @@ hsvc_event_handler(void *ptr) {
   char hslotpid[80] = {0};
   char slot_kv[80] = {0};
   int i=0;
-  hot_service_info *hsvc_info = (hot_service_info *)ptr;
-  pthread_detach(pthread_self());
 
-
-  switch(hsvc_info->action)
+  switch(action)
   {
-    case REMOVAl :
-      usleep(250000);   //Delay 250ms to wait for slot present pin status stable
-      ret = pal_is_fru_prsnt(hsvc_info->slot_id, &value);
-      if (ret < 0) {
-        syslog(LOG_CRIT, "%s pal_is_fru_prsnt failed for fru: %d\n", __func__, hsvc_info->slot_id);
-        break;
-      }
-      if (value) {
-        printf("Not remove entirely\n");
-      }
-      else {   //Card has been removed
-        ret = pal_is_server_12v_on(hsvc_info->slot_id, &value);    /* Check whether the system is 12V off or on */
+    case HSVC_REMOVAL :   //Card has been removed
+      {
+        ret = pal_is_server_12v_on(slot_id, &value);    /* Check whether the system is 12V off or on */
         if (ret < 0) {
           syslog(LOG_ERR, "pal_get_server_power: pal_is_server_12v_on failed");
           break;
         }
         if (value) {
-          syslog(LOG_CRIT, fru_prsnt_log_string[2*MAX_NUM_FRUS + hsvc_info->slot_id]);     //Card removal without 12V-off
+          syslog(LOG_CRIT, fru_prsnt_log_string[2*MAX_NUM_FRUS + slot_id]);     //Card removal without 12V-off
           memset(vpath, 0, sizeof(vpath));
-          sprintf(vpath, GPIO_VAL, gpio_12v[hsvc_info->slot_id]);
+          sprintf(vpath, GPIO_VAL, gpio_12v[slot_id]);
           if (write_device(vpath, "0")) {        /* Turn off 12V to given slot when Server/GP/CF be removed brutally */
             break;
           }
-          ret = pal_slot_pair_12V_off(hsvc_info->slot_id);  /* Turn off 12V to pair of slots when Server/GP/CF be removed brutally with pair config */
+          ret = pal_slot_pair_12V_off(slot_id);  /* Turn off 12V to pair of slots when Server/GP/CF be removed brutally with pair config */
           if (0 != ret)
-            printf("pal_slot_pair_12V_off failed for fru: %d\n", hsvc_info->slot_id);
+            printf("pal_slot_pair_12V_off failed for fru: %d\n", slot_id);
         }
         else
-          syslog(LOG_CRIT, fru_prsnt_log_string[hsvc_info->slot_id]);     //Card removal with 12V-off
+          syslog(LOG_CRIT, fru_prsnt_log_string[slot_id]);     //Card removal with 12V-off
 
         // Re-init kv list
         for(i=0; i < sizeof(slot_kv_list)/sizeof(slot_kv_st); i++) {
           memset(slot_kv, 0, sizeof(slot_kv));
-          sprintf(slot_kv, slot_kv_list[i].slot_key, hsvc_info->slot_id);
+          sprintf(slot_kv, slot_kv_list[i].slot_key, slot_id);
           if ((ret = pal_set_key_value(slot_kv, slot_kv_list[i].slot_def_val)) < 0) {
             syslog(LOG_WARNING, "%s pal_set_def_key_value: kv_set failed. %d", __func__, ret);
           }
         }
 
         // Create file for 12V-on re-init
-        sprintf(hspath, HOTSERVICE_FILE, hsvc_info->slot_id);
+        sprintf(hspath, HOTSERVICE_FILE, slot_id);
         memset(cmd, 0, sizeof(cmd));
         sprintf(cmd,"touch %s",hspath);
         system(cmd);
 
         // Assign slot type
-        sprintf(slotrcpath, SLOT_RECORD_FILE, hsvc_info->slot_id);
+        sprintf(slotrcpath, SLOT_RECORD_FILE, slot_id);
         memset(cmd, 0, sizeof(cmd));
-        sprintf(cmd, "echo %d > %s", fby2_get_slot_type(hsvc_info->slot_id), slotrcpath);
+        sprintf(cmd, "echo %d > %s", fby2_get_slot_type(slot_id), slotrcpath);
         system(cmd);
       }
       break;
-    case INSERTION :
-      sleep(5);   //Delay 5 seconds to wait for slot present pin status stable
-      ret = pal_is_fru_prsnt(hsvc_info->slot_id, &value);
-      if (ret < 0) {
-        syslog(LOG_CRIT, "%s pal_is_fru_prsnt failed for fru: %d\n", __func__, hsvc_info->slot_id);
-        break;
-      }
-      if (value) {      //Card has been inserted
-        syslog(LOG_CRIT, fru_prsnt_log_string[MAX_NUM_FRUS + hsvc_info->slot_id]);
+    case HSVC_INSERTION :   //Card has been inserted
+      {
+        syslog(LOG_CRIT, fru_prsnt_log_string[MAX_NUM_FRUS + slot_id]);
 
         // Create file for 12V-on re-init
-        sprintf(hspath, HOTSERVICE_FILE, hsvc_info->slot_id);
+        sprintf(hspath, HOTSERVICE_FILE, slot_id);
         memset(cmd, 0, sizeof(cmd));
         sprintf(cmd,"touch %s",hspath);
         system(cmd);
 
         // Assign slot type
-        sprintf(slotrcpath, SLOT_RECORD_FILE, hsvc_info->slot_id);
+        sprintf(slotrcpath, SLOT_RECORD_FILE, slot_id);
         memset(cmd, 0, sizeof(cmd));
-        sprintf(cmd, "echo %d > %s", fby2_get_slot_type(hsvc_info->slot_id), slotrcpath);
+        sprintf(cmd, "echo %d > %s", fby2_get_slot_type(slot_id), slotrcpath);
         system(cmd);
 
         // Remove pid_file
@@ -445,27 +340,18 @@ hsvc_event_handler(void *ptr) {
         system(cmd);
 
         /* Check whether the system is 12V off or on */
-        ret = pal_is_server_12v_on(hsvc_info->slot_id, &status);
+        ret = pal_is_server_12v_on(slot_id, &status);
         if (ret < 0) {
           syslog(LOG_ERR, "pal_get_server_power: pal_is_server_12v_on failed");
           break;
         }
         if (!status) {
-          sprintf(cmd, "/usr/local/bin/power-util slot%u 12V-on &",hsvc_info->slot_id);
+          sprintf(cmd, "/usr/local/bin/power-util slot%u 12V-on &",slot_id);
           system(cmd);
         }
       }
-      else {
-        printf("Not insert entirely\n");
-      }
       break;
   }
-
-  pthread_mutex_lock(&hsvc_mutex[hsvc_info->slot_id]);
-  IsHotServiceStart[hsvc_info->slot_id] = false;
-  pthread_mutex_unlock(&hsvc_mutex[hsvc_info->slot_id]);
-
-  pthread_exit(0);
 }
 
 static gpio_poll_st g_gpios[] = {
@@ -511,6 +397,11 @@ static void default_gpio_check(void) {
 }
 #endif
 
+static const hsvc_ops_t hsvc_ops = {
+  .is_prsnt = hsvc_is_prsnt,
+  .action = hsvc_action,
+};
+
 int
 main(int argc, void **argv) {
   int dev, rc, pid_file;
@@ -518,11 +409,6 @@ main(int argc, void **argv) {
   int i;
  
 
-  for(i=1 ;i<MAX_NODES + 1; i++)
-  {
-    pthread_mutex_init(&hsvc_mutex[i], NULL);
-  }
-
 #if DEBUG_ME_EJECTOR_LOG // Enable log "GPIO_SLOTX_EJECTOR_LATCH_DETECT_N is 1 and SLOT_12v is ON" before mechanism issue is fixed
   default_gpio_check();
 #endif
@@ -538,14 +424,14 @@ main(int argc, void **argv) {
     openlog("gpiointrd", LOG_CONS, LOG_DAEMON);
     syslog(LOG_INFO, "gpiointrd: daemon started");
 
+    if (hsvc_start(&hsvc_ops, HSVC_WORKERS)) {
+      syslog(LOG_ERR, "gpiointrd: hot service setup failed");
+      exit(-1);
+    }
     gpio_poll_open(g_gpios, g_count);
     gpio_poll(g_gpios, g_count, POLL_TIMEOUT);
     gpio_poll_close(g_gpios, g_count);
-  }
-
-  for(i=1; i<MAX_NODES + 1; i++)
-  {
-    pthread_mutex_destroy(&hsvc_mutex[i]);
+    hsvc_stop();
   }
 
   return 0;
@@ -41,12 +41,13 @@ fruid_cache_init(void) {
   char fruid_temp_path[64] = {0};
   char fruid_path[64] = {0};
   int retry = 0;
+  bool cached = false;
 
   sprintf(fruid_temp_path, "/tmp/tfruid_scc.bin");
   sprintf(fruid_path, "/tmp/fruid_scc.bin");
 
   while(retry < 5) {
-    ret = exp_read_fruid(fruid_temp_path, FRU_SCC);
+    ret = exp_read_fruid_cached(fruid_temp_path, FRU_SCC, &cached);
     if (ret != 0) {
       retry++;
       msleep(20);
@@ -56,9 +57,9 @@ fruid_cache_init(void) {
   }
 
   if(retry == 5)
-    syslog(LOG_CRIT, "%s: exp_read_fruid failed with FRU:%d\n", __func__, FRU_SCC);
+    syslog(LOG_CRIT, "%s: exp_read_fruid_cached failed with FRU:%d\n", __func__, FRU_SCC);
   else
-    syslog(LOG_INFO, "SCC FRU initial is done.\n");
+    syslog(LOG_INFO, "SCC FRU initial is done%s.\n", cached ? " from cache" : "");
 
   rename(fruid_temp_path, fruid_path);
 
@@ -70,7 +71,7 @@ fruid_cache_init(void) {
   sleep(3);
 
   while(retry < 5) {
-    ret = exp_read_fruid(fruid_temp_path, FRU_DPB);
+    ret = exp_read_fruid_cached(fruid_temp_path, FRU_DPB, &cached);
     if (ret != 0) {
       retry++;
       msleep(20);
@@ -80,9 +81,9 @@ fruid_cache_init(void) {
   }
 
   if(retry == 5)
-    syslog(LOG_CRIT, "%s: exp_read_fruid failed with FRU:%d\n", __func__, FRU_DPB);
+    syslog(LOG_CRIT, "%s: exp_read_fruid_cached failed with FRU:%d\n", __func__, FRU_DPB);
   else
-    syslog(LOG_INFO, "DPB FRU initial is done.\n");
+    syslog(LOG_INFO, "DPB FRU initial is done%s.\n", cached ? " from cache" : "");
 
   rename(fruid_temp_path, fruid_path);
   return;
@@ -21,12 +21,47 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <fcntl.h>
 #include <syslog.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/stat.h>
 #include "exp.h"
 
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define EXP_RES_NONE (-2)   // no response, as opposed to a completion code
+#define EXP_FRU_CACHE_MAGIC 0x55524645  // "EFRU"
+#define EXP_FRU_HALF_LEN (EXPANDER_FRUID_SIZE + 2)
+
+typedef struct {
+  uint8_t netfn;
+  uint8_t cmd;
+  uint8_t txbuf[EXP_MAX_SENSOR_REQ + 1];
+  uint8_t txlen;
+  uint8_t rxbuf[MAX_IPMB_RES_LEN];
+  uint8_t rxlen;
+  int ret;
+} exp_req_t;
+
+#pragma pack(push, 1)
+typedef struct {
+  uint32_t magic;
+  uint8_t ver_len;
+  uint8_t ver[EXP_MAX_VER_LEN];   // Get Expander Version response
+  uint8_t len[2];                 // the two Get FRUID responses following
+} exp_fru_cache_key_t;
+#pragma pack(pop)
+
+// Set once a pipelined request went unanswered and then got an answer alone,
+// -1 until EXP_SERIAL_FLAG was looked at
+static int exp_serial = -1;
+
 static void
 msleep(int msec) {
   struct timespec req;
@@ -39,20 +74,9 @@ msleep(int msec) {
   }
 }
 
-int
-expander_ipmb_wrapper(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen) {
-  ipmb_req_t *req;
-  ipmb_res_t *res;
-  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
-  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
-  uint8_t tlen = 0;
-  uint8_t rlen = 0;
-  int count = 0;
-  int i = 0;
-  int ret;
-  int retry = 0;
-
-  req = (ipmb_req_t*)tbuf;
+static uint8_t
+exp_fill_req(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen, uint8_t *tbuf) {
+  ipmb_req_t *req = (ipmb_req_t*)tbuf;
 
   req->res_slave_addr = EXPANDER_SLAVE_ADDR << 1;
   req->netfn_lun = netfn << LUN_OFFSET;
@@ -69,11 +93,43 @@ expander_ipmb_wrapper(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen,
     memcpy(req->data, txbuf, txlen);
   }
 
-  tlen = IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + txlen;
+  return IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + txlen;
+}
+
+static int
+exp_parse_res(uint8_t *rbuf, uint8_t rlen, uint8_t *rxbuf, uint8_t *rxlen) {
+  ipmb_res_t *res = (ipmb_res_t*) rbuf;
+
+  if (rlen < IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE) {
+    return EXP_RES_NONE;
+  }
+
+  if (res->cc) {
+    syslog(LOG_ERR, "%s: Completion Code: 0x%X\n", __func__, res->cc);
+    return -1;
+  }
+
+  // copy the received data back to caller
+  *rxlen = rlen - IPMB_HDR_SIZE - IPMI_RESP_HDR_SIZE;
+  memcpy(rxbuf, res->data, *rxlen);
+
+  return 0;
+}
+
+int
+expander_ipmb_wrapper(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen) {
+  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t tlen = 0;
+  uint8_t rlen = 0;
+  int retry = 0;
+
+  tlen = exp_fill_req(netfn, cmd, txbuf, txlen, tbuf);
 
   while(retry < 5) {
     // Invoke IPMB library handler
-    lib_ipmb_handle(EXPANDER_IPMB_BUS_NUM, tbuf, tlen, &rbuf, &rlen);
+    rlen = 0;
+    lib_ipmb_handle(EXPANDER_IPMB_BUS_NUM, tbuf, tlen, rbuf, &rlen);
 
     if (rlen == 0) {
       retry++;
@@ -91,19 +147,79 @@ expander_ipmb_wrapper(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen,
     return -1;
   }
 
-  // Handle IPMB response
-  res  = (ipmb_res_t*) rbuf;
+  return exp_parse_res(rbuf, rlen, rxbuf, rxlen) ? -1 : 0;
+}
 
-  if (res->cc) {
-    syslog(LOG_ERR, "%s: Completion Code: 0x%X\n", __func__, res->cc);
-    return -1;
+/*
+ * sensor-util and fw-util run once per command, so the fallback to serial
+ * requests is kept in EXP_SERIAL_FLAG for the processes coming after.
+ */
+static bool
+exp_is_serial(void) {
+  if (exp_serial < 0) {
+    exp_serial = (access(EXP_SERIAL_FLAG, F_OK) == 0);
   }
+  return exp_serial;
+}
 
-  // copy the received data back to caller
-  *rxlen = rlen - IPMB_HDR_SIZE - IPMI_RESP_HDR_SIZE;
-  memcpy(rxbuf, res->data, *rxlen);
+static void
+exp_set_serial(void) {
+  int fd;
 
-  return 0;
+  exp_serial = 1;
+  fd = open(EXP_SERIAL_FLAG, O_WRONLY | O_CREAT, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: open %s failed, errno = %d\n", __func__, EXP_SERIAL_FLAG, errno);
+    return;
+  }
+  close(fd);
+}
+
+/*
+ * Send the requests with up to EXP_PIPELINE_DEPTH of them in flight:
+ * ipmbd serves every connection on its own thread, so the next request
+ * is on the bus while the expander works on the previous one. Requests
+ * that got no response go again one at a time, with the usual retries.
+ */
+static void
+exp_ipmb_pipeline(exp_req_t *reqs, int n) {
+  uint8_t tbuf[EXP_PIPELINE_DEPTH][MAX_IPMB_RES_LEN];
+  uint8_t rbuf[MAX_IPMB_RES_LEN];
+  uint8_t tlen, rlen;
+  int fd[EXP_PIPELINE_DEPTH];
+  int i, j, cnt;
+
+  for (i = 0; i < n; i++) {
+    reqs[i].ret = EXP_RES_NONE;
+  }
+
+  if (n > 1 && !exp_is_serial()) {
+    for (i = 0; i < n; i += cnt) {
+      cnt = MIN(n - i, EXP_PIPELINE_DEPTH);
+      for (j = 0; j < cnt; j++) {
+        tlen = exp_fill_req(reqs[i+j].netfn, reqs[i+j].cmd, reqs[i+j].txbuf, reqs[i+j].txlen, tbuf[j]);
+        fd[j] = lib_ipmb_submit(EXPANDER_IPMB_BUS_NUM, tbuf[j], tlen);
+      }
+      for (j = 0; j < cnt; j++) {
+        rlen = 0;
+        lib_ipmb_collect(fd[j], rbuf, &rlen);
+        reqs[i+j].ret = exp_parse_res(rbuf, rlen, reqs[i+j].rxbuf, &reqs[i+j].rxlen);
+      }
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    if (reqs[i].ret != EXP_RES_NONE) {
+      continue;
+    }
+    reqs[i].ret = expander_ipmb_wrapper(reqs[i].netfn, reqs[i].cmd, reqs[i].txbuf, reqs[i].txlen,
+                                        reqs[i].rxbuf, &reqs[i].rxlen);
+    if (reqs[i].ret == 0 && n > 1 && !exp_is_serial()) {
+      // The expander drops requests that overlap, stop pipelining
+      exp_set_serial();
+      syslog(LOG_WARNING, "%s: pipelined request unanswered, sending one at a time\n", __func__);
+    }
+  }
 }
 
 // Read Firwmare Versions of Expander via IPMB, and save to cache
@@ -150,43 +266,88 @@ exp_get_ioc_fw_ver(uint8_t *ver) {
   return 0;
 }
 
+/*
+ * Get Sensor Reading of a list of sensors, EXP_MAX_SENSOR_REQ sensors per
+ * request and the requests pipelined. The sensors of a request that failed
+ * come back with status EXP_SENSOR_NA and the return value is -1.
+ */
 int
-exp_read_fruid(const char *path, unsigned char FRUID) {
-  int fd;
-  uint8_t tbuf[256] = {0x00};
-  uint8_t rbuf[256] = {0x00};
-  uint8_t r1_buf[256] = {0x00};
-  uint8_t abuf[512] = {0x0};
-  uint8_t rlen = 0;
-  uint8_t tlen = 0;
-  uint8_t l_rlen = 0;
-  int ret;
-  int i;
-
-  tbuf[0] = FRUID; //FRU Device ID
-  tbuf[1] = 0; //FRU Inventory Offset to read, LS Byte
-  tbuf[2] = 0; //FRU Inventory Offset to read, MS Byte
-  tbuf[3] = EXPANDER_FRUID_SIZE + 2; //Count to read --- count is 1 based
-  tlen = 4;
-  ret = expander_ipmb_wrapper(NETFN_STORAGE_REQ, CMD_GET_EXP_FRUID, tbuf, tlen, rbuf, &rlen);
-  if (ret) {
-    syslog(LOG_ERR, "%s: first half failed for fru:%d\n", __func__, FRUID);
+exp_read_sensor_list(const uint8_t *sensor_list, int sensor_cnt, exp_sensor_t *sensors) {
+  exp_req_t reqs[(EXP_MAX_SENSOR_CNT + EXP_MAX_SENSOR_REQ - 1) / EXP_MAX_SENSOR_REQ];
+  exp_sensor_t *snr;
+  int nreq, cnt, got;
+  int i, j;
+  int ret = 0;
+
+  if (sensor_cnt <= 0 || sensor_cnt > EXP_MAX_SENSOR_CNT) {
     return -1;
   }
 
-  memcpy( abuf, rbuf + 1, rlen-1);
-  l_rlen = rlen - 1;
-  memset(rbuf,0,512);
+  nreq = (sensor_cnt + EXP_MAX_SENSOR_REQ - 1) / EXP_MAX_SENSOR_REQ;
+  for (i = 0; i < nreq; i++) {
+    cnt = MIN(sensor_cnt - i * EXP_MAX_SENSOR_REQ, EXP_MAX_SENSOR_REQ);
+    reqs[i].netfn = NETFN_OEM_REQ;
+    reqs[i].cmd = CMD_EXP_GET_SENSOR_READING;
+    reqs[i].txbuf[0] = cnt;
+    memcpy(&reqs[i].txbuf[1], &sensor_list[i * EXP_MAX_SENSOR_REQ], cnt);
+    reqs[i].txlen = cnt + 1;
+  }
 
-  tbuf[1] = EXPANDER_FRUID_SIZE + 2; //FRU Inventory Offset to read, LS Byte
-  tbuf[2] = 0; //FRU Inventory Offset to read, MS Byte
-  ret = expander_ipmb_wrapper(NETFN_STORAGE_REQ, CMD_GET_EXP_FRUID, tbuf, tlen, r1_buf, &rlen);
-  if (ret) {
-    syslog(LOG_ERR, "%s: second half failed for fru:%d\n", __func__, FRUID);
+  exp_ipmb_pipeline(reqs, nreq);
+
+  for (i = 0; i < nreq; i++) {
+    cnt = reqs[i].txlen - 1;
+    got = 0;
+    if (reqs[i].ret == 0 && reqs[i].rxlen > 0) {
+      // The sensors follow the first byte of the response
+      got = MIN((reqs[i].rxlen - 1) / (int)sizeof(exp_sensor_t), cnt);
+    }
+    if (got < cnt) {
+      ret = -1;
+    }
+
+    for (j = 0; j < cnt; j++) {
+      snr = &sensors[i * EXP_MAX_SENSOR_REQ + j];
+      if (j < got) {
+        memcpy(snr, &reqs[i].rxbuf[1 + j * sizeof(exp_sensor_t)], sizeof(exp_sensor_t));
+      } else {
+        memset(snr, 0, sizeof(exp_sensor_t));
+        snr->sensor_num = reqs[i].txbuf[1 + j];
+        snr->status = EXP_SENSOR_NA;
+      }
+    }
+  }
+
+  return ret;
+}
+
+static void
+exp_fruid_req(exp_req_t *req, unsigned char FRUID, int half) {
+
+  req->netfn = NETFN_STORAGE_REQ;
+  req->cmd = CMD_GET_EXP_FRUID;
+  req->txbuf[0] = FRUID; //FRU Device ID
+  req->txbuf[1] = half ? EXP_FRU_HALF_LEN : 0; //FRU Inventory Offset to read, LS Byte
+  req->txbuf[2] = 0; //FRU Inventory Offset to read, MS Byte
+  req->txbuf[3] = EXP_FRU_HALF_LEN; //Count to read --- count is 1 based
+  req->txlen = 4;
+}
+
+// Write the FRU from the two Get FRUID responses
+static int
+exp_fruid_write(const char *path, exp_req_t *first, exp_req_t *second) {
+  uint8_t abuf[512] = {0x0};
+  uint8_t l_rlen;
+  int fd;
+
+  if (first->rxlen < 1 || second->rxlen < 1) {
     return -1;
   }
 
-  memcpy( abuf + l_rlen, r1_buf + 1, rlen - 1);
+  // Skip the first byte of each response, it is the count returned
+  l_rlen = first->rxlen - 1;
+  memcpy(abuf, first->rxbuf + 1, l_rlen);
+  memcpy(abuf + l_rlen, second->rxbuf + 1, second->rxlen - 1);
 
   // Remove the file if exists already
   unlink(path);
@@ -200,9 +361,145 @@ exp_read_fruid(const char *path, unsigned char FRUID) {
     return -1;
   }
   // Ignore the first byte as it indicates length of response
-  write(fd, abuf, l_rlen + rlen - 2);
+  write(fd, abuf, l_rlen + second->rxlen - 2);
+
+  close(fd);
+  return 0;
+}
+
+int
+exp_read_fruid(const char *path, unsigned char FRUID) {
+  exp_req_t reqs[2];
+
+  exp_fruid_req(&reqs[0], FRUID, 0);
+  exp_fruid_req(&reqs[1], FRUID, 1);
+  exp_ipmb_pipeline(reqs, 2);
+
+  if (reqs[0].ret) {
+    syslog(LOG_ERR, "%s: first half failed for fru:%d\n", __func__, FRUID);
+    return -1;
+  }
+  if (reqs[1].ret) {
+    syslog(LOG_ERR, "%s: second half failed for fru:%d\n", __func__, FRUID);
+    return -1;
+  }
+
+  return exp_fruid_write(path, &reqs[0], &reqs[1]);
+}
+
+static void
+exp_fru_cache_path(char *path, size_t size, unsigned char FRUID) {
+
+  snprintf(path, size, "%s/fruid_%d.bin", EXP_CACHE_DIR, FRUID);
+}
 
+static int
+exp_fru_cache_load(unsigned char FRUID, exp_fru_cache_key_t *key, exp_req_t *first, exp_req_t *second) {
+  char path[128];
+  int fd, ret = -1;
+
+  exp_fru_cache_path(path, sizeof(path), FRUID);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (read(fd, key, sizeof(*key)) == sizeof(*key) &&
+      key->magic == EXP_FRU_CACHE_MAGIC && key->ver_len <= EXP_MAX_VER_LEN &&
+      read(fd, first->rxbuf, key->len[0]) == key->len[0] &&
+      read(fd, second->rxbuf, key->len[1]) == key->len[1]) {
+    first->rxlen = key->len[0];
+    second->rxlen = key->len[1];
+    ret = 0;
+  }
+
+  close(fd);
+  return ret;
+}
+
+static int
+exp_fru_cache_store(unsigned char FRUID, exp_fru_cache_key_t *key, exp_req_t *first, exp_req_t *second) {
+  char path[128];
+  char temp_path[136];
+  int fd, ret = 0;
+
+  mkdir(EXP_CACHE_DIR, 0755);
+  exp_fru_cache_path(path, sizeof(path), FRUID);
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  key->len[0] = first->rxlen;
+  key->len[1] = second->rxlen;
+
+  fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: open fails for path: %s\n", __func__, temp_path);
+    return -1;
+  }
+  if (write(fd, key, sizeof(*key)) != sizeof(*key) ||
+      write(fd, first->rxbuf, first->rxlen) != first->rxlen ||
+      write(fd, second->rxbuf, second->rxlen) != second->rxlen || fsync(fd)) {
+    ret = -1;
+  }
   close(fd);
+
+  if (ret || rename(temp_path, path)) {
+    syslog(LOG_WARNING, "%s: failed to write %s\n", __func__, path);
+    unlink(temp_path);
+    return -1;
+  }
   return 0;
 }
 
+/*
+ * exp_read_fruid() with the FRU kept across reboots in EXP_CACHE_DIR,
+ * keyed on the expander firmware version. The first half is read anyway,
+ * in the same pipeline as the version: it holds the board serial number,
+ * so a swapped board with the same firmware is not served the old FRU.
+ * *cached tells whether the second half came from the cache.
+ */
+int
+exp_read_fruid_cached(const char *path, unsigned char FRUID, bool *cached) {
+  exp_req_t live[3];    // version, first half, second half
+  exp_req_t saved[2];
+  exp_fru_cache_key_t key, saved_key;
+
+  *cached = false;
+
+  live[0].netfn = NETFN_OEM_REQ;
+  live[0].cmd = CMD_GET_EXP_VERSION;
+  live[0].txlen = 0;
+  exp_fruid_req(&live[1], FRUID, 0);
+  exp_ipmb_pipeline(live, 2);
+
+  if (live[1].ret) {
+    syslog(LOG_ERR, "%s: first half failed for fru:%d\n", __func__, FRUID);
+    return -1;
+  }
+
+  memset(&key, 0, sizeof(key));
+  if (live[0].ret == 0 && live[0].rxlen <= EXP_MAX_VER_LEN) {
+    key.magic = EXP_FRU_CACHE_MAGIC;
+    key.ver_len = live[0].rxlen;
+    memcpy(key.ver, live[0].rxbuf, live[0].rxlen);
+
+    if (exp_fru_cache_load(FRUID, &saved_key, &saved[0], &saved[1]) == 0 &&
+        saved_key.ver_len == key.ver_len && !memcmp(saved_key.ver, key.ver, key.ver_len) &&
+        saved[0].rxlen == live[1].rxlen && !memcmp(saved[0].rxbuf, live[1].rxbuf, live[1].rxlen)) {
+      *cached = true;
+      return exp_fruid_write(path, &saved[0], &saved[1]);
+    }
+  }
+
+  exp_fruid_req(&live[2], FRUID, 1);
+  exp_ipmb_pipeline(&live[2], 1);
+  if (live[2].ret) {
+    syslog(LOG_ERR, "%s: second half failed for fru:%d\n", __func__, FRUID);
+    return -1;
+  }
+
+  if (key.magic) {
+    exp_fru_cache_store(FRUID, &key, &live[1], &live[2]);
+  }
+
+  return exp_fruid_write(path, &live[1], &live[2]);
+}
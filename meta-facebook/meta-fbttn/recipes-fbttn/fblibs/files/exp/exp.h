@@ -21,6 +21,7 @@
 #ifndef __EXPANDER_H__
 #define __EXPANDER_H__
 
+#include <stdbool.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
 
@@ -38,11 +39,36 @@ extern "C" {
 #define EXPANDER_HDD_STATUS 0xC0
 #define EXPANDER_ERROR_CODE 0x11
 
+#define EXP_MAX_SENSOR_REQ 40   // sensors per Get Sensor Reading request
+#define EXP_MAX_SENSOR_CNT 255
+#define EXP_PIPELINE_DEPTH 4    // requests in flight through ipmbd
+#define EXP_SENSOR_NA 0xFF      // status of the sensors the expander did not answer for
+#define EXP_MAX_VER_LEN 32
+
+#ifndef EXP_CACHE_DIR
+#define EXP_CACHE_DIR "/mnt/data/exp-cached"
+#endif
+
+// Present once the expander dropped a pipelined request, until reboot
+#ifndef EXP_SERIAL_FLAG
+#define EXP_SERIAL_FLAG "/tmp/exp_ipmb_serial"
+#endif
+
+// One sensor of the Get Sensor Reading response
+typedef struct {
+  uint8_t sensor_num;
+  uint8_t data1;
+  uint8_t data2;
+  uint8_t status;   // 0: reading available
+  uint8_t reserved;
+} exp_sensor_t;
 
 int expander_ipmb_wrapper(uint8_t netfn, uint8_t cmd, uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen);
 int exp_get_fw_ver(uint8_t *ver);
 int exp_get_ioc_fw_ver(uint8_t *ver);
 int exp_read_fruid(const char *path, unsigned char FRUID);
+int exp_read_fruid_cached(const char *path, unsigned char FRUID, bool *cached);
+int exp_read_sensor_list(const uint8_t *sensor_list, int sensor_cnt, exp_sensor_t *sensors);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,280 @@
+/*
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * The simulator takes the place of ipmbd, so stop ipmbd of the expander
+ * bus first when running it on a BMC: the socket path is the same.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "exp.h"
+#include "exp_sim.h"
+
+typedef struct {
+  exp_sim_t *sim;
+  int fd;
+} sim_conn_t;
+
+static void
+sim_sleep_us(long us) {
+  struct timespec req;
+
+  req.tv_sec = us / 1000000;
+  req.tv_nsec = (us % 1000000) * 1000;
+  while (nanosleep(&req, &req) == -1 && errno == EINTR) {
+    continue;
+  }
+}
+
+static uint8_t
+sim_handle(exp_sim_t *sim, uint8_t netfn, uint8_t cmd, uint8_t *req, int req_len,
+           uint8_t *data, int *data_len) {
+  uint8_t *snr;
+  int id, off, cnt;
+  int i;
+
+  *data_len = 0;
+
+  if (netfn == NETFN_OEM_REQ && cmd == CMD_EXP_GET_SENSOR_READING) {
+    if (req_len < 1 || req[0] != req_len - 1) {
+      return CC_INVALID_LENGTH;
+    }
+    cnt = req[0];
+    if (cnt > sim->max_sensors) {
+      return CC_PARAM_OUT_OF_RANGE;
+    }
+    data[0] = cnt;
+    for (i = 0; i < cnt; i++) {
+      snr = &data[1 + i * sizeof(exp_sensor_t)];
+      snr[0] = req[1 + i];
+      snr[1] = EXP_SIM_DATA1(req[1 + i]);
+      snr[2] = EXP_SIM_DATA2(req[1 + i]);
+      snr[3] = (sim->na_sensor && req[1 + i] == sim->na_sensor) ? 0x20 : 0;
+      snr[4] = 0;
+    }
+    *data_len = 1 + cnt * sizeof(exp_sensor_t);
+    sim->sensor_reqs++;
+    sim->sensors += cnt;
+    sim_sleep_us(cnt * sim->sensor_us);
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_OEM_REQ && cmd == CMD_GET_EXP_VERSION) {
+    memset(data, 0, 16);
+    data[5] = 1;    // FW 1 selected
+    memcpy(&data[6], sim->fw_ver, 4);
+    data[14] = 1;   // backup FW
+    *data_len = 16;
+    sim->ver_reqs++;
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_OEM_REQ && cmd == CMD_GET_IOC_VERSION) {
+    data[0] = 0x00;
+    data[1] = 0x00;
+    data[2] = 0x0e;
+    data[3] = 0x0f;
+    *data_len = 4;
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_STORAGE_REQ && cmd == CMD_GET_EXP_FRUID) {
+    if (req_len != 4) {
+      return CC_INVALID_LENGTH;
+    }
+    id = req[0];
+    off = req[1] | (req[2] << 8);
+    cnt = req[3];
+    if (id >= EXP_SIM_MAX_FRU || off + cnt > EXP_SIM_FRU_SIZE) {
+      return CC_PARAM_OUT_OF_RANGE;
+    }
+    data[0] = cnt;
+    memcpy(&data[1], &sim->fru[id][off], cnt);
+    *data_len = cnt + 1;
+    sim->fru_reqs++;
+    return CC_SUCCESS;
+  }
+
+  return CC_INVALID_CMD;
+}
+
+static void *
+sim_conn(void *arg) {
+  sim_conn_t *conn = (sim_conn_t *)arg;
+  exp_sim_t *sim = conn->sim;
+  uint8_t rbuf[MAX_IPMB_RES_LEN];
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  ipmb_req_t *req = (ipmb_req_t *)rbuf;
+  ipmb_res_t *res = (ipmb_res_t *)tbuf;
+  bool drop = false;
+  int len, data_len = 0;
+
+  len = recv(conn->fd, rbuf, sizeof(rbuf), 0);
+  if (len >= MIN_IPMB_REQ_LEN) {
+    pthread_mutex_lock(&sim->bus);
+    sim_sleep_us(len * sim->byte_us);
+    if (sim->no_overlap) {
+      drop = sim->busy;
+      sim->busy = true;
+    }
+    pthread_mutex_unlock(&sim->bus);
+
+    if (drop) {
+      pthread_mutex_lock(&sim->lock);
+      sim->dropped++;
+      pthread_mutex_unlock(&sim->lock);
+      goto done;
+    }
+
+    pthread_mutex_lock(&sim->lock);
+    sim->requests++;
+    sim_sleep_us(sim->cmd_us);
+    res->cc = sim_handle(sim, req->netfn_lun >> LUN_OFFSET, req->cmd, req->data,
+                         len - (IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE), res->data, &data_len);
+    pthread_mutex_unlock(&sim->lock);
+
+    pthread_mutex_lock(&sim->bus);
+    sim_sleep_us((IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + data_len) * sim->byte_us);
+    sim->busy = false;
+    pthread_mutex_unlock(&sim->bus);
+
+    res->req_slave_addr = req->req_slave_addr;
+    res->netfn_lun = ((req->netfn_lun >> LUN_OFFSET) + 1) << LUN_OFFSET;
+    res->res_slave_addr = req->res_slave_addr;
+    res->seq_lun = req->seq_lun;
+    res->cmd = req->cmd;
+    send(conn->fd, tbuf, IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + data_len, MSG_NOSIGNAL);
+  }
+
+done:
+  close(conn->fd);
+  free(conn);
+  return NULL;
+}
+
+static void *
+sim_listen(void *arg) {
+  exp_sim_t *sim = (exp_sim_t *)arg;
+  pthread_attr_t attr;
+  pthread_t tid;
+  sim_conn_t *conn;
+  int fd;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  while ((fd = accept(sim->sock, NULL, NULL)) >= 0 || errno == EINTR) {
+    if (fd < 0) {
+      continue;
+    }
+    conn = malloc(sizeof(sim_conn_t));
+    if (conn == NULL) {
+      close(fd);
+      continue;
+    }
+    conn->sim = sim;
+    conn->fd = fd;
+    if (pthread_create(&tid, &attr, sim_conn, conn)) {
+      close(fd);
+      free(conn);
+    }
+  }
+
+  return NULL;
+}
+
+// Defaults: a 100KHz bus and FRUs with a recognizable pattern
+void
+exp_sim_init(exp_sim_t *sim) {
+  int id, i;
+
+  memset(sim, 0, sizeof(*sim));
+  sim->byte_us = 90;
+  sim->cmd_us = 2000;
+  sim->sensor_us = 50;
+  sim->max_sensors = EXP_MAX_SENSOR_REQ;
+  sim->fw_ver[0] = 0x01;
+  sim->fw_ver[1] = 0x02;
+  sim->fw_ver[2] = 0x03;
+  sim->fw_ver[3] = 0x04;
+  for (id = 0; id < EXP_SIM_MAX_FRU; id++) {
+    for (i = 0; i < EXP_SIM_FRU_SIZE; i++) {
+      sim->fru[id][i] = (id * 31 + i) & 0xFF;
+    }
+  }
+  sim->sock = -1;
+}
+
+int
+exp_sim_start(exp_sim_t *sim) {
+  struct sockaddr_un local;
+
+  pthread_mutex_init(&sim->bus, NULL);
+  pthread_mutex_init(&sim->lock, NULL);
+
+  sim->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sim->sock < 0) {
+    return -1;
+  }
+  local.sun_family = AF_UNIX;
+  snprintf(local.sun_path, sizeof(local.sun_path), "%s_%d", SOCK_PATH_IPMB, EXPANDER_IPMB_BUS_NUM);
+  unlink(local.sun_path);
+  if (bind(sim->sock, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+      listen(sim->sock, 64) < 0) {
+    perror(local.sun_path);
+    close(sim->sock);
+    return -1;
+  }
+
+  return pthread_create(&sim->tid, NULL, sim_listen, sim);
+}
+
+void
+exp_sim_stop(exp_sim_t *sim) {
+  char path[108];
+
+  shutdown(sim->sock, SHUT_RDWR);
+  pthread_join(sim->tid, NULL);
+  close(sim->sock);
+  snprintf(path, sizeof(path), "%s_%d", SOCK_PATH_IPMB, EXPANDER_IPMB_BUS_NUM);
+  unlink(path);
+}
+
+void
+exp_sim_reset_stats(exp_sim_t *sim) {
+
+  pthread_mutex_lock(&sim->lock);
+  sim->requests = 0;
+  sim->sensor_reqs = 0;
+  sim->sensors = 0;
+  sim->ver_reqs = 0;
+  sim->fru_reqs = 0;
+  sim->dropped = 0;
+  pthread_mutex_unlock(&sim->lock);
+}
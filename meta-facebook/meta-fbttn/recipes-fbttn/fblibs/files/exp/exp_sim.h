@@ -0,0 +1,82 @@
+/*
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __EXP_SIM_H__
+#define __EXP_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXP_SIM_MAX_FRU 8
+#define EXP_SIM_FRU_SIZE 0x200
+
+/*
+ * SCC expander simulator for testing libexp without hardware. It listens
+ * on the ipmbd socket of the expander bus, in threads of the calling
+ * process, and answers Get Sensor Reading, Get Expander/IOC Version and
+ * Get FRUID. Like ipmbd every connection gets its own thread, while the
+ * bus carries one transfer and the expander serves one request at a time.
+ */
+typedef struct {
+  /* Configuration, set before exp_sim_start() */
+  int byte_us;          // bus time per byte
+  int cmd_us;           // expander time per request
+  int sensor_us;        // and per sensor read
+  int max_sensors;      // most sensors answered in one request
+  bool no_overlap;      // drop requests arriving while one is served
+  uint8_t fw_ver[4];
+  uint8_t na_sensor;    // sensor reported unavailable, 0 for none
+  uint8_t fru[EXP_SIM_MAX_FRU][EXP_SIM_FRU_SIZE];
+
+  /* Counters */
+  uint32_t requests;
+  uint32_t sensor_reqs;
+  uint32_t sensors;
+  uint32_t ver_reqs;
+  uint32_t fru_reqs;
+  uint32_t dropped;
+
+  /* Internal */
+  int sock;
+  bool busy;
+  pthread_t tid;
+  pthread_mutex_t bus;
+  pthread_mutex_t lock;
+} exp_sim_t;
+
+void exp_sim_init(exp_sim_t *sim);
+int exp_sim_start(exp_sim_t *sim);
+void exp_sim_stop(exp_sim_t *sim);
+void exp_sim_reset_stats(exp_sim_t *sim);
+
+// Sensor reading the simulator returns for a sensor
+#define EXP_SIM_DATA1(num) ((uint8_t)(num))
+#define EXP_SIM_DATA2(num) ((uint8_t)((num) ^ 0x5A))
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* __EXP_SIM_H__ */
@@ -0,0 +1,360 @@
+/*
+ *
+ * Copyright 2015-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Tests of libexp against the expander simulator, and a comparison of the
+ * sensor sweeps and the FRU reads with the old request sequences.
+ *
+ * eg: exp-test [iterations]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "exp.h"
+#include "exp_sim.h"
+
+#define FRU_DPB 3
+#define FRU_SCC 4
+#define DPB_SENSORS 59
+#define SCC_SENSORS 12
+#define FRU_PATH "/tmp/exp-test-fruid.bin"
+#define FRU_LEN (2 * (EXPANDER_FRUID_SIZE + 2) - 1)
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+static uint8_t dpb_list[DPB_SENSORS];
+static uint8_t scc_list[SCC_SENSORS];
+
+static double
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool
+check_sensors(exp_sim_t *sim, const uint8_t *list, int cnt, exp_sensor_t *snr) {
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (snr[i].sensor_num != list[i]) {
+      return false;
+    }
+    if (list[i] == sim->na_sensor) {
+      if (snr[i].status == 0) {
+        return false;
+      }
+    } else if (snr[i].status != 0 || snr[i].data1 != EXP_SIM_DATA1(list[i]) ||
+               snr[i].data2 != EXP_SIM_DATA2(list[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The old pal: one Get Sensor Reading after the other, 40 sensors at most
+static int
+old_read_list(const uint8_t *list, int cnt, exp_sensor_t *snr) {
+  uint8_t tbuf[256];
+  uint8_t rbuf[256];
+  uint8_t rlen;
+  int i, n, ret = 0;
+
+  for (i = 0; i < cnt; i += n) {
+    n = (cnt - i > EXP_MAX_SENSOR_REQ) ? EXP_MAX_SENSOR_REQ : cnt - i;
+    tbuf[0] = n;
+    memcpy(&tbuf[1], &list[i], n);
+    rlen = 0;
+    if (expander_ipmb_wrapper(NETFN_OEM_REQ, CMD_EXP_GET_SENSOR_READING, tbuf, n + 1, rbuf, &rlen)) {
+      ret = -1;
+      continue;
+    }
+    memcpy(&snr[i], &rbuf[1], n * sizeof(exp_sensor_t));
+  }
+  return ret;
+}
+
+static void
+test_sensor_list(exp_sim_t *sim) {
+  exp_sensor_t snr[EXP_MAX_SENSOR_CNT];
+  uint8_t list[EXP_MAX_SENSOR_CNT];
+  int i;
+
+  exp_sim_reset_stats(sim);
+  CHECK(exp_read_sensor_list(dpb_list, DPB_SENSORS, snr) == 0);
+  CHECK(check_sensors(sim, dpb_list, DPB_SENSORS, snr));
+  CHECK(sim->sensor_reqs == 2);
+
+  CHECK(exp_read_sensor_list(scc_list, SCC_SENSORS, snr) == 0);
+  CHECK(check_sensors(sim, scc_list, SCC_SENSORS, snr));
+  CHECK(sim->sensor_reqs == 3);
+
+  // Every sensor number, 7 requests at most 4 in flight
+  for (i = 0; i < EXP_MAX_SENSOR_CNT; i++) {
+    list[i] = i + 1;
+  }
+  exp_sim_reset_stats(sim);
+  CHECK(exp_read_sensor_list(list, EXP_MAX_SENSOR_CNT, snr) == 0);
+  CHECK(check_sensors(sim, list, EXP_MAX_SENSOR_CNT, snr));
+  CHECK(sim->sensor_reqs == 7);
+
+  CHECK(exp_read_sensor_list(list, 0, snr) == -1);
+  CHECK(exp_read_sensor_list(list, EXP_MAX_SENSOR_CNT + 1, snr) == -1);
+
+  // An expander that takes fewer sensors per request: the full request
+  // comes back NA, the short one is still read
+  sim->max_sensors = 20;
+  CHECK(exp_read_sensor_list(dpb_list, DPB_SENSORS, snr) == -1);
+  for (i = 0; i < EXP_MAX_SENSOR_REQ; i++) {
+    CHECK(snr[i].sensor_num == dpb_list[i] && snr[i].status == EXP_SENSOR_NA);
+  }
+  CHECK(check_sensors(sim, &dpb_list[EXP_MAX_SENSOR_REQ], DPB_SENSORS - EXP_MAX_SENSOR_REQ,
+                      &snr[EXP_MAX_SENSOR_REQ]));
+  sim->max_sensors = EXP_MAX_SENSOR_REQ;
+}
+
+static void
+bench_sweep(exp_sim_t *sim, int iterations) {
+  exp_sensor_t snr[EXP_MAX_SENSOR_CNT];
+  uint8_t tbuf[2], rbuf[16], rlen;
+  double start, old_ms, new_ms;
+  uint32_t old_reqs, new_reqs;
+  int i, j;
+
+  // A sensord sweep of the DPB and the SCC
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  for (i = 0; i < iterations; i++) {
+    old_read_list(dpb_list, DPB_SENSORS, snr);
+    old_read_list(scc_list, SCC_SENSORS, snr);
+  }
+  old_ms = (now_ms() - start) / iterations;
+  old_reqs = sim->requests / iterations;
+
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  for (i = 0; i < iterations; i++) {
+    exp_read_sensor_list(dpb_list, DPB_SENSORS, snr);
+    exp_read_sensor_list(scc_list, SCC_SENSORS, snr);
+  }
+  new_ms = (now_ms() - start) / iterations;
+  new_reqs = sim->requests / iterations;
+  printf("%-32s old %3u requests %7.1f ms, new %3u requests %7.1f ms\n",
+         "DPB + SCC sweep", old_reqs, old_ms, new_reqs, new_ms);
+  CHECK(new_ms < old_ms);
+
+  // fscd reading 10 DPB sensors other than the first one after the
+  // timestamp went stale: the old pal read them one by one, the new one
+  // refreshes the whole DPB list on the first of them
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  for (i = 0; i < iterations; i++) {
+    for (j = 0; j < 10; j++) {
+      tbuf[0] = 1;
+      tbuf[1] = dpb_list[10 + j];
+      expander_ipmb_wrapper(NETFN_OEM_REQ, CMD_EXP_GET_SENSOR_READING, tbuf, 2, rbuf, &rlen);
+    }
+  }
+  old_ms = (now_ms() - start) / iterations;
+  old_reqs = sim->requests / iterations;
+
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  for (i = 0; i < iterations; i++) {
+    exp_read_sensor_list(dpb_list, DPB_SENSORS, snr);
+  }
+  new_ms = (now_ms() - start) / iterations;
+  new_reqs = sim->requests / iterations;
+  printf("%-32s old %3u requests %7.1f ms, new %3u requests %7.1f ms\n",
+         "10 stale DPB reads", old_reqs, old_ms, new_reqs, new_ms);
+}
+
+static bool
+check_fru_file(exp_sim_t *sim, int fru) {
+  uint8_t buf[EXP_SIM_FRU_SIZE];
+  int fd, len;
+
+  fd = open(FRU_PATH, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  len = read(fd, buf, sizeof(buf));
+  close(fd);
+  return len == FRU_LEN && !memcmp(buf, sim->fru[fru], FRU_LEN);
+}
+
+static void
+test_fru(exp_sim_t *sim) {
+  bool cached;
+  double start, old_ms, cold_ms, warm_ms;
+  uint32_t old_reqs, cold_reqs, warm_reqs;
+
+  system("rm -rf " EXP_CACHE_DIR);
+
+  // What exp-cached did: both FRUs, one request after the other
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  CHECK(exp_read_fruid(FRU_PATH, FRU_SCC) == 0);
+  CHECK(check_fru_file(sim, FRU_SCC));
+  CHECK(exp_read_fruid(FRU_PATH, FRU_DPB) == 0);
+  CHECK(check_fru_file(sim, FRU_DPB));
+  old_ms = now_ms() - start;
+  old_reqs = sim->requests;
+  CHECK(sim->fru_reqs == 4);
+
+  // Nothing cached yet
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_SCC, &cached) == 0 && !cached);
+  CHECK(check_fru_file(sim, FRU_SCC));
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_DPB, &cached) == 0 && !cached);
+  CHECK(check_fru_file(sim, FRU_DPB));
+  cold_ms = now_ms() - start;
+  cold_reqs = sim->requests;
+
+  // Same firmware and boards
+  exp_sim_reset_stats(sim);
+  start = now_ms();
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_SCC, &cached) == 0 && cached);
+  CHECK(check_fru_file(sim, FRU_SCC));
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_DPB, &cached) == 0 && cached);
+  CHECK(check_fru_file(sim, FRU_DPB));
+  warm_ms = now_ms() - start;
+  warm_reqs = sim->requests;
+  CHECK(sim->fru_reqs == 2);
+
+  printf("%-32s old %3u requests %7.1f ms (+3 s pause), cold %u requests %.1f ms, "
+         "cached %u requests %.1f ms\n", "SCC + DPB FRU", old_reqs, old_ms,
+         cold_reqs, cold_ms, warm_reqs, warm_ms);
+
+  // A board with the same firmware but another serial number
+  sim->fru[FRU_SCC][0x30] ^= 0xFF;
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_SCC, &cached) == 0 && !cached);
+  CHECK(check_fru_file(sim, FRU_SCC));
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_SCC, &cached) == 0 && cached);
+
+  // The second half changed along with the firmware
+  sim->fw_ver[3]++;
+  sim->fru[FRU_DPB][0xF0] ^= 0xFF;
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_DPB, &cached) == 0 && !cached);
+  CHECK(check_fru_file(sim, FRU_DPB));
+  CHECK(exp_read_fruid_cached(FRU_PATH, FRU_DPB, &cached) == 0 && cached);
+  CHECK(check_fru_file(sim, FRU_DPB));
+
+  unlink(FRU_PATH);
+  system("rm -rf " EXP_CACHE_DIR);
+}
+
+// Last: once the expander drops a pipelined request, libexp stops pipelining
+static void
+test_no_overlap(exp_sim_t *sim) {
+  exp_sensor_t snr[EXP_MAX_SENSOR_CNT];
+  uint32_t reqs;
+
+  sim->no_overlap = true;
+  exp_sim_reset_stats(sim);
+  CHECK(exp_read_sensor_list(dpb_list, DPB_SENSORS, snr) == 0);
+  CHECK(check_sensors(sim, dpb_list, DPB_SENSORS, snr));
+  CHECK(sim->dropped > 0);
+
+  CHECK(access(EXP_SERIAL_FLAG, F_OK) == 0);
+
+  reqs = sim->dropped;
+  CHECK(exp_read_sensor_list(dpb_list, DPB_SENSORS, snr) == 0);
+  CHECK(check_sensors(sim, dpb_list, DPB_SENSORS, snr));
+  CHECK(sim->dropped == reqs);
+  printf("%-32s %u dropped, then one at a time\n", "expander without overlap", reqs);
+}
+
+// The processes after the one that found out go one at a time from the start
+static void
+test_serial_flag(exp_sim_t *sim, const char *self) {
+  int status;
+  pid_t pid;
+
+  exp_sim_reset_stats(sim);
+  pid = fork();
+  if (pid == 0) {
+    execl(self, self, "serial", NULL);
+    _exit(127);
+  }
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+        WEXITSTATUS(status) == 0);
+  CHECK(sim->dropped == 0);
+  unlink(EXP_SERIAL_FLAG);
+}
+
+static int
+serial_child(void) {
+  exp_sensor_t snr[EXP_MAX_SENSOR_CNT];
+
+  return exp_read_sensor_list(dpb_list, DPB_SENSORS, snr) ? 1 : 0;
+}
+
+int
+main(int argc, char **argv) {
+  int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+  exp_sim_t sim;
+  int i;
+
+  for (i = 0; i < DPB_SENSORS; i++) {
+    dpb_list[i] = 0x18 + i;
+  }
+  for (i = 0; i < SCC_SENSORS; i++) {
+    scc_list[i] = 0x60 + i;
+  }
+
+  if (argc > 1 && !strcmp(argv[1], "serial")) {
+    return serial_child();
+  }
+
+  unlink(EXP_SERIAL_FLAG);
+  exp_sim_init(&sim);
+  sim.na_sensor = dpb_list[30];
+  if (exp_sim_start(&sim)) {
+    printf("failed to start the simulator\n");
+    return 1;
+  }
+
+  test_sensor_list(&sim);
+  bench_sweep(&sim, iterations);
+  test_fru(&sim);
+  test_no_overlap(&sim);
+  test_serial_flag(&sim, argv[0]);
+
+  exp_sim_stop(&sim);
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
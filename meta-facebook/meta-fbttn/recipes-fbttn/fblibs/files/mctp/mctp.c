@@ -22,350 +22,813 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <openbmc/obmc-i2c.h>
 #include "mctp.h"
 
 #define MAX_MCTP_RETRY_CNT  3
-
-int
-mctp_i2c_open(uint8_t bus_num) {
+#define MAX_I2C_BUS_NUM     16
+#define MAX_PEERS           8   // endpoints per bus
+#define RESP_POLL_MIN_USEC  1000
+#define RESP_POLL_MAX_USEC  8000
+
+typedef struct {
+  bool busy;        // request sent, response not received yet
+  bool in_msg;      // SOM received
+  bool done;        // EOM received
+  uint8_t next_seq;
+  int len;
+  uint64_t start;
+  uint8_t buf[MCTP_MAX_MSG_LEN];
+} mctp_tag_t;
+
+typedef struct {
+  bool used;
+  uint8_t addr;
+  uint8_t next_tag;
+  uint64_t resp_usec;   // estimate of the time to the first response packet
+  mctp_tag_t tags[MCTP_TAG_COUNT];
+} mctp_peer_t;
+
+struct mctp_bus {
+  const mctp_bus_ops_t *ops;
+  void *priv;
   int fd;
+  int bus_num;
+  uint8_t own_addr;
+  pthread_mutex_t lock;
+  mctp_stats_t stats;
+  mctp_peer_t peers[MAX_PEERS];
+};
+
+typedef struct {
+  mctp_bus_t *bus;
+  uint8_t addr;
+} mctp_route_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static mctp_bus_t *g_buses[MAX_I2C_BUS_NUM];
+static mctp_route_t g_routes[256];
+static uint8_t g_local_eid = MCTP_EID_NULL;
+
+static uint64_t
+now_usec(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+i2c_rdwr(mctp_bus_t *bus, uint8_t addr, uint16_t flags, uint8_t *buf, int len) {
+  struct i2c_rdwr_ioctl_data data;
+  struct i2c_msg msg;
+  struct timespec req = {0, 20000000};  // 20mSec
+  int rc = -1;
+  int i;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.addr = addr;
+  msg.flags = flags;
+  msg.len = len;
+  msg.buf = buf;
+
+  data.msgs = &msg;
+  data.nmsgs = 1;
+
+  for (i = 0; i < I2C_RETRIES_MAX; i++) {
+    rc = ioctl(bus->fd, I2C_RDWR, &data);
+    if (rc >= 0) {
+      break;
+    }
+    nanosleep(&req, NULL);
+  }
+
+  return (rc < 0) ? -1 : 0;
+}
+
+static int
+i2c_write(void *priv, uint8_t addr, const uint8_t *buf, int len) {
+  return i2c_rdwr((mctp_bus_t *)priv, addr, 0, (uint8_t *)buf, len);
+}
+
+static int
+i2c_read(void *priv, uint8_t addr, uint8_t *buf, int len) {
+  return i2c_rdwr((mctp_bus_t *)priv, addr, I2C_M_RD, buf, len);
+}
+
+static const mctp_bus_ops_t i2c_ops = {
+  .write = i2c_write,
+  .read = i2c_read,
+};
+
+static mctp_bus_t *
+bus_alloc(const mctp_bus_ops_t *ops, void *priv, uint8_t own_addr) {
+  mctp_bus_t *bus;
+
+  bus = calloc(1, sizeof(*bus));
+  if (bus == NULL) {
+    return NULL;
+  }
+  bus->ops = ops;
+  bus->priv = priv;
+  bus->fd = -1;
+  bus->bus_num = -1;
+  bus->own_addr = own_addr;
+  pthread_mutex_init(&bus->lock, NULL);
+
+  return bus;
+}
+
+mctp_bus_t *
+mctp_bus_open(uint8_t bus_num, uint8_t own_addr) {
+  mctp_bus_t *bus;
   char fn[32];
-  int rc;
 
+  if (bus_num >= MAX_I2C_BUS_NUM) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&g_lock);
+  bus = g_buses[bus_num];
+  if (bus != NULL) {
+    pthread_mutex_unlock(&g_lock);
+    return bus;
+  }
+
+  bus = bus_alloc(&i2c_ops, NULL, own_addr);
+  if (bus == NULL) {
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+  }
   snprintf(fn, sizeof(fn), "/dev/i2c-%d", bus_num);
-  fd = open(fn, O_RDWR);
-  if (fd == -1) {
+  bus->fd = open(fn, O_RDWR | O_CLOEXEC);
+  if (bus->fd < 0) {
     syslog(LOG_WARNING, "Failed to open i2c device %s", fn);
+    pthread_mutex_unlock(&g_lock);
+    free(bus);
+    return NULL;
+  }
+  bus->priv = bus;
+  bus->bus_num = bus_num;
+  g_buses[bus_num] = bus;
+  pthread_mutex_unlock(&g_lock);
+
+  return bus;
+}
+
+mctp_bus_t *
+mctp_bus_attach(const mctp_bus_ops_t *ops, void *priv, uint8_t own_addr) {
+  return bus_alloc(ops, priv, own_addr);
+}
+
+void
+mctp_bus_detach(mctp_bus_t *bus) {
+  int i;
+
+  if (bus == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_lock);
+  for (i = 0; i < 256; i++) {
+    if (g_routes[i].bus == bus) {
+      g_routes[i].bus = NULL;
+    }
+  }
+  if (bus->bus_num >= 0) {
+    g_buses[bus->bus_num] = NULL;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  if (bus->fd >= 0) {
+    close(bus->fd);
+  }
+  pthread_mutex_destroy(&bus->lock);
+  free(bus);
+}
+
+void
+mctp_bus_get_stats(mctp_bus_t *bus, mctp_stats_t *stats) {
+  pthread_mutex_lock(&bus->lock);
+  *stats = bus->stats;
+  pthread_mutex_unlock(&bus->lock);
+}
+
+void
+mctp_bus_reset_stats(mctp_bus_t *bus) {
+  pthread_mutex_lock(&bus->lock);
+  memset(&bus->stats, 0, sizeof(bus->stats));
+  pthread_mutex_unlock(&bus->lock);
+}
+
+void
+mctp_set_local_eid(uint8_t eid) {
+  g_local_eid = eid;
+}
+
+int
+mctp_route_add(uint8_t eid, mctp_bus_t *bus, uint8_t addr) {
+  if (eid == MCTP_EID_NULL || eid == MCTP_EID_BROADCAST || bus == NULL) {
     return -1;
   }
 
-  rc = ioctl(fd, I2C_SLAVE, IOM_IOC_SLAVE_ADDRESS);
+  pthread_mutex_lock(&g_lock);
+  g_routes[eid].bus = bus;
+  g_routes[eid].addr = addr;
+  pthread_mutex_unlock(&g_lock);
+
+  return 0;
+}
+
+int
+mctp_route_del(uint8_t eid) {
+  int ret = -1;
+
+  pthread_mutex_lock(&g_lock);
+  if (g_routes[eid].bus != NULL) {
+    g_routes[eid].bus = NULL;
+    ret = 0;
+  }
+  pthread_mutex_unlock(&g_lock);
+
+  return ret;
+}
+
+static uint64_t
+bus_now(mctp_bus_t *bus) {
+  return bus->ops->clock ? bus->ops->clock(bus->priv) : now_usec();
+}
+
+// Transfers, called with bus->lock held
+static int
+bus_write(mctp_bus_t *bus, uint8_t addr, const uint8_t *buf, int len) {
+  uint64_t start = bus_now(bus);
+  int rc;
+
+  rc = bus->ops->write(bus->priv, addr, buf, len);
+  bus->stats.bus_usec += bus_now(bus) - start;
   if (rc < 0) {
-    syslog(LOG_WARNING, "Failed to open slave @ address 0x%x", IOM_IOC_SLAVE_ADDRESS);
-    close(fd);
+    bus->stats.xfer_errors++;
     return -1;
   }
+  bus->stats.tx_packets++;
+  bus->stats.tx_bytes += len;
 
-  return fd;
+  return 0;
 }
 
-int
-mctp_i2c_write(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len) {
-  struct i2c_rdwr_ioctl_data data;
-  struct i2c_msg msg;
+static int
+bus_read(mctp_bus_t *bus, uint8_t addr, uint8_t *buf, int len) {
+  uint64_t start = bus_now(bus);
   int rc;
-  int i;
-  struct timespec req;
-  struct timespec rem;
-  char bus[32];
-  int dev;
 
-  dev = mctp_i2c_open(dev_number);
-  if (dev < 0) {
-    syslog(LOG_WARNING, "mctp_i2c_write mctp_i2c_open failed");
+  rc = bus->ops->read(bus->priv, addr, buf, len);
+  bus->stats.bus_usec += bus_now(bus) - start;
+  if (rc < 0) {
+    bus->stats.xfer_errors++;
     return -1;
   }
+  bus->stats.rx_bytes += len;
 
-  memset(&msg, 0, sizeof(msg));
+  return 0;
+}
 
-  msg.addr = slave_addr;
-  msg.flags = 0;
-  msg.len = len;
-  msg.buf = buf;
+static void
+bus_delay(mctp_bus_t *bus, int usec) {
+  struct timespec req;
 
-  data.msgs = &msg;
-  data.nmsgs = 1;
+  if (bus->ops->delay) {
+    bus->ops->delay(bus->priv, usec);
+    return;
+  }
+  req.tv_sec = usec / 1000000;
+  req.tv_nsec = (usec % 1000000) * 1000;
+  nanosleep(&req, NULL);
+}
 
-  // Setup wait time
-  req.tv_sec = 0;
-  req.tv_nsec = 20000000;//20mSec
+static mctp_peer_t *
+get_peer(mctp_bus_t *bus, uint8_t addr, bool create) {
+  mctp_peer_t *free_peer = NULL;
+  int i;
 
-  for (i = 0; i < I2C_RETRIES_MAX; i++) {
-    rc = ioctl(dev, I2C_RDWR, &data);
-    if (rc < 0) {
-      nanosleep(&req, &rem);
-      continue;
-    } else {
+  for (i = 0; i < MAX_PEERS; i++) {
+    if (bus->peers[i].used && bus->peers[i].addr == addr) {
+      return &bus->peers[i];
+    }
+    if (!bus->peers[i].used && free_peer == NULL) {
+      free_peer = &bus->peers[i];
+    }
+  }
+  if (!create || free_peer == NULL) {
+    return NULL;
+  }
+  memset(free_peer, 0, sizeof(*free_peer));
+  free_peer->used = true;
+  free_peer->addr = addr;
+
+  return free_peer;
+}
+
+int
+mctp_req_send(mctp_bus_t *bus, uint8_t addr, uint8_t dst_eid,
+              const uint8_t *msg, int len) {
+  uint8_t pkt[MCTP_SMBUS_HDR_LEN + MCTP_BTU];
+  mctp_peer_t *peer;
+  mctp_tag_t *t;
+  int tag, off, n, seq, i;
+
+  if (bus == NULL || len <= 0 || len > MCTP_MAX_MSG_LEN) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&bus->lock);
+  peer = get_peer(bus, addr, true);
+  if (peer == NULL) {
+    pthread_mutex_unlock(&bus->lock);
+    return -1;
+  }
+
+  // Tags are handed out round robin so that a late response to an
+  // abandoned request is unlikely to match a new one
+  for (i = 0; i < MCTP_TAG_COUNT; i++) {
+    tag = (peer->next_tag + i) % MCTP_TAG_COUNT;
+    if (!peer->tags[tag].busy) {
       break;
     }
   }
-  close(dev);
-  if (rc < 0) {
-    syslog(LOG_WARNING, "mctp_i2c_write failed to do raw io");
+  if (i == MCTP_TAG_COUNT) {
+    syslog(LOG_WARNING, "mctp_req_send: no free tag for 0x%x", addr);
+    pthread_mutex_unlock(&bus->lock);
+    return -1;
+  }
+  peer->next_tag = (tag + 1) % MCTP_TAG_COUNT;
+
+  t = &peer->tags[tag];
+  t->busy = true;
+  t->in_msg = false;
+  t->done = false;
+  t->len = 0;
+  t->start = bus_now(bus);
+
+  for (off = 0, seq = 0; off < len; off += n, seq++) {
+    n = (len - off > MCTP_BTU) ? MCTP_BTU : len - off;
+    pkt[0] = MCTP_SMBUS_CMD_CODE;
+    pkt[1] = MCTP_SMBUS_HDR_LEN - 2 + n;
+    pkt[2] = (bus->own_addr << 1) | 0x01;
+    pkt[3] = MCTP_HDR_VERSION;
+    pkt[4] = dst_eid;
+    pkt[5] = g_local_eid;
+    pkt[6] = ((off == 0) ? MCTP_FLAG_SOM : 0) |
+             ((off + n == len) ? MCTP_FLAG_EOM : 0) |
+             ((seq & 0x3) << 4) | MCTP_FLAG_TO | tag;
+    memcpy(&pkt[MCTP_SMBUS_HDR_LEN], &msg[off], n);
+    if (bus_write(bus, addr, pkt, MCTP_SMBUS_HDR_LEN + n) < 0) {
+      syslog(LOG_WARNING, "mctp_req_send: write to 0x%x failed", addr);
+      t->busy = false;
+      pthread_mutex_unlock(&bus->lock);
+      return -1;
+    }
+  }
+  bus->stats.requests++;
+  pthread_mutex_unlock(&bus->lock);
+
+  return tag;
+}
+
+/*
+ * Read a packet of up to want bytes from the endpoint and add it to the
+ * response it belongs to. A packet cut short by want only completes a
+ * response the caller wants no more of. Returns 1 if the packet was taken
+ * by an outstanding request, 0 if there was none to take. Called with
+ * bus->lock held.
+ */
+static int
+bus_poll(mctp_bus_t *bus, mctp_peer_t *peer, int want) {
+  uint8_t pkt[MCTP_SMBUS_PKT_LEN];
+  mctp_tag_t *t;
+  uint64_t sample;
+  uint8_t flags;
+  int n;
+
+  memset(pkt, 0xff, sizeof(pkt));
+  if (bus_read(bus, peer->addr, pkt, want) < 0) {
+    return 0;
+  }
+
+  // Reads with no response ready return 0xff filled packets
+  n = pkt[1] - (MCTP_SMBUS_HDR_LEN - 2);
+  if (pkt[0] != MCTP_SMBUS_CMD_CODE || pkt[3] != MCTP_HDR_VERSION ||
+      n <= 0 || n > MCTP_BTU) {
+    bus->stats.not_ready++;
+    return 0;
+  }
+  bus->stats.rx_packets++;
+
+  flags = pkt[6];
+  t = &peer->tags[MCTP_TAG(flags)];
+  if ((flags & MCTP_FLAG_TO) || !t->busy || t->done) {
+    bus->stats.dropped++;
+    return 0;
+  }
+
+  if (flags & MCTP_FLAG_SOM) {
+    t->in_msg = true;
+    t->len = 0;
+    sample = bus_now(bus) - t->start;
+    peer->resp_usec = peer->resp_usec ?
+                      (peer->resp_usec * 7 + sample) / 8 : sample;
+  } else if (!t->in_msg || MCTP_SEQ(flags) != t->next_seq) {
+    bus->stats.dropped++;
+    t->in_msg = false;
+    return 0;
+  }
+  if (t->len + n > MCTP_MAX_MSG_LEN) {
+    bus->stats.dropped++;
+    t->in_msg = false;
+    return 0;
+  }
+  if (n > want - MCTP_SMBUS_HDR_LEN) {
+    n = want - MCTP_SMBUS_HDR_LEN;
+  }
+  memcpy(&t->buf[t->len], &pkt[MCTP_SMBUS_HDR_LEN], n);
+  t->len += n;
+  t->next_seq = (MCTP_SEQ(flags) + 1) & 0x3;
+  if (flags & MCTP_FLAG_EOM) {
+    t->done = true;
+  }
+
+  return 1;
+}
+
+static int
+tags_busy(mctp_peer_t *peer) {
+  int i, n = 0;
+
+  for (i = 0; i < MCTP_TAG_COUNT; i++) {
+    n += peer->tags[i].busy;
+  }
+  return n;
+}
+
+int
+mctp_resp_recv(mctp_bus_t *bus, uint8_t addr, uint8_t tag,
+               uint8_t *msg, int *len, int timeout_ms) {
+  uint64_t deadline, elapsed, first;
+  int delay = RESP_POLL_MIN_USEC;
+  int want;
+  mctp_peer_t *peer;
+  mctp_tag_t *t;
+
+  if (bus == NULL || tag >= MCTP_TAG_COUNT) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&bus->lock);
+  peer = get_peer(bus, addr, false);
+  if (peer == NULL || !peer->tags[tag].busy) {
+    pthread_mutex_unlock(&bus->lock);
     return -1;
   }
+  t = &peer->tags[tag];
+  deadline = bus_now(bus) + (uint64_t)timeout_ms * 1000;
+
+  // Every poll of an endpoint still busy with the request costs a packet
+  // read of bus time. Do not poll before most of the time it usually takes.
+  first = t->start + peer->resp_usec * 3 / 4;
+  if (!t->in_msg && bus_now(bus) < first && first < deadline) {
+    pthread_mutex_unlock(&bus->lock);
+    bus_delay(bus, first - bus_now(bus));
+    pthread_mutex_lock(&bus->lock);
+  }
+
+  // A response longer than the caller wants is cut short, the endpoint
+  // drops the packets left when it gets the next request
+  while (!t->done && !(t->in_msg && t->len >= *len)) {
+    // With no other response to wait for, only read as much of the packet
+    // as is wanted
+    want = MCTP_SMBUS_PKT_LEN;
+    if (tags_busy(peer) == 1 && MCTP_SMBUS_HDR_LEN + *len - t->len < want) {
+      want = MCTP_SMBUS_HDR_LEN + *len - t->len;
+    }
+    if (bus_poll(bus, peer, want)) {
+      delay = RESP_POLL_MIN_USEC;
+      continue;
+    }
+    if (bus_now(bus) >= deadline) {
+      bus->stats.timeouts++;
+      t->busy = false;
+      pthread_mutex_unlock(&bus->lock);
+      return -1;
+    }
+    // Leave the bus to others while the endpoint works on the request
+    pthread_mutex_unlock(&bus->lock);
+    bus_delay(bus, delay);
+    delay = (delay * 2 > RESP_POLL_MAX_USEC) ? RESP_POLL_MAX_USEC : delay * 2;
+    pthread_mutex_lock(&bus->lock);
+  }
+
+  if (*len > t->len) {
+    *len = t->len;
+  }
+  memcpy(msg, t->buf, *len);
+  t->busy = false;
+
+  elapsed = bus_now(bus) - t->start;
+  bus->stats.req_usec += elapsed;
+  if (elapsed > bus->stats.req_usec_max) {
+    bus->stats.req_usec_max = elapsed;
+  }
+  pthread_mutex_unlock(&bus->lock);
 
   return 0;
 }
 
+void
+mctp_req_abort(mctp_bus_t *bus, uint8_t addr, uint8_t tag) {
+  mctp_peer_t *peer;
+
+  if (bus == NULL || tag >= MCTP_TAG_COUNT) {
+    return;
+  }
+
+  pthread_mutex_lock(&bus->lock);
+  peer = get_peer(bus, addr, false);
+  if (peer != NULL) {
+    peer->tags[tag].busy = false;
+  }
+  pthread_mutex_unlock(&bus->lock);
+}
+
 int
-mctp_i2c_read(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len) {
-  struct i2c_rdwr_ioctl_data data;
-  struct i2c_msg msg;
-  int rc;
-  int i;
-  struct timespec req;
-  struct timespec rem;
-  char bus[32];
-  int dev;
+mctp_request(uint8_t eid, const uint8_t *req, int req_len,
+             uint8_t *resp, int *resp_len, int timeout_ms) {
+  mctp_route_t route;
+  int tag;
+
+  pthread_mutex_lock(&g_lock);
+  route = g_routes[eid];
+  pthread_mutex_unlock(&g_lock);
+  if (route.bus == NULL) {
+    syslog(LOG_WARNING, "mctp_request: no route to EID 0x%x", eid);
+    return -1;
+  }
 
-  dev = mctp_i2c_open(dev_number);
-  if (dev < 0) {
-    syslog(LOG_WARNING, "mctp_i2c_read mctp_i2c_open failed");
+  tag = mctp_req_send(route.bus, route.addr, eid, req, req_len);
+  if (tag < 0) {
     return -1;
   }
 
-  memset(&msg, 0, sizeof(msg));
+  return mctp_resp_recv(route.bus, route.addr, tag, resp, resp_len, timeout_ms);
+}
 
-  msg.addr = slave_addr;
-  msg.flags = I2C_M_RD;
-  msg.len = len;
-  msg.buf = buf;
+int
+mctp_assign_eid(mctp_bus_t *bus, uint8_t addr, uint8_t eid) {
+  static uint8_t iid = 0;
+  uint8_t req[5];
+  uint8_t resp[8];
+  int resp_len = sizeof(resp);
+  int tag;
+
+  iid = (iid + 1) & 0x1f;
+  req[0] = MCTP_MSG_TYPE_CONTROL;
+  req[1] = 0x80 | iid;          // Rq
+  req[2] = MCTP_CTRL_SET_EID;
+  req[3] = 0x00;                // Set EID
+  req[4] = eid;
+
+  // The endpoint has no EID yet, address it physically
+  tag = mctp_req_send(bus, addr, MCTP_EID_NULL, req, sizeof(req));
+  if (tag < 0) {
+    return -1;
+  }
+  if (mctp_resp_recv(bus, addr, tag, resp, &resp_len, MCTP_RESP_TIMEOUT_MS)) {
+    return -1;
+  }
 
-  data.msgs = &msg;
-  data.nmsgs = 1;
+  // type, IID, command, completion code, status, EID setting, pool size
+  if (resp_len < 6 || resp[0] != MCTP_MSG_TYPE_CONTROL ||
+      (resp[1] & 0x1f) != iid || resp[2] != MCTP_CTRL_SET_EID || resp[3]) {
+    syslog(LOG_WARNING, "mctp_assign_eid: 0x%x refused EID 0x%x", addr, eid);
+    return -1;
+  }
+  if (mctp_route_add(resp[5], bus, addr)) {
+    return -1;
+  }
 
-  // Setup wait time
-  req.tv_sec = 0;
-  req.tv_nsec = 20000000;//20mSec
+  return resp[5];
+}
 
-  for (i = 0; i < I2C_RETRIES_MAX; i++) {
-    rc = ioctl(dev, I2C_RDWR, &data);
-    if (rc < 0) {
-      nanosleep(&req, &rem);
-      continue;
-    } else {
-      break;
-    }
+int
+mctp_i2c_write(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len) {
+  mctp_bus_t *bus;
+  int rc;
+
+  bus = mctp_bus_open(dev_number, 0);
+  if (bus == NULL) {
+    syslog(LOG_WARNING, "mctp_i2c_write mctp_bus_open failed");
+    return -1;
   }
-  close(dev);
+
+  pthread_mutex_lock(&bus->lock);
+  rc = bus_write(bus, slave_addr, buf, len);
+  pthread_mutex_unlock(&bus->lock);
   if (rc < 0) {
-    syslog(LOG_WARNING, "mctp_i2c_read failed to do raw io");
+    syslog(LOG_WARNING, "mctp_i2c_write failed to do raw io");
     return -1;
   }
 
   return 0;
 }
 
-//Type7 IOM IOC initialization
-int mctp_ioc_init(uint8_t tag) {
-  uint8_t pwrite_buf[72];
-  uint8_t readd[80];
-  /* IOC_Tempeature initialization */
-  uint8_t slave_addr = 0x0a;  /* slave address */
-  int reading = -1;
-  int fd, ret = 0;
-
-  memset(pwrite_buf, 0, 72);
-  memset(readd, 0, 80);
-
-  pwrite_buf[0] = 0xf;
-  pwrite_buf[1] = 0x11;
-  pwrite_buf[2] = 0x1;
-  pwrite_buf[3] = 0x01;
-  pwrite_buf[4] = 0x00;
-  pwrite_buf[5] = 0x0;
-  pwrite_buf[6] = 0xc8;
-  pwrite_buf[7] = 0x7e; /* Message type */
-  pwrite_buf[8] = 0x10;
-  pwrite_buf[9] = 0x00;
-  pwrite_buf[10] = 0x20;  /* Payload ID LSI define command or respomse */
-  pwrite_buf[11] = 0x0;
-  pwrite_buf[12] = 0x0;
-  pwrite_buf[13] = tag;   /* App Msg tag */
-  pwrite_buf[14] = 0x01;  /* Command initail MCTP interface can't open */
-  pwrite_buf[15] = 0x00;  /* Payload length */
-  pwrite_buf[16] = 0x00;
-  pwrite_buf[17] = 0x00;
-  pwrite_buf[18] = 0x00;
-
-  ret = mctp_i2c_write(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, pwrite_buf, 19);
-  if (ret < 0) {
+int
+mctp_i2c_read(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len) {
+  mctp_bus_t *bus;
+  int rc;
+
+  bus = mctp_bus_open(dev_number, 0);
+  if (bus == NULL) {
+    syslog(LOG_WARNING, "mctp_i2c_read mctp_bus_open failed");
     return -1;
   }
-  ret = mctp_i2c_read(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, readd, 72);
-  if (ret < 0) {
+
+  pthread_mutex_lock(&bus->lock);
+  rc = bus_read(bus, slave_addr, buf, len);
+  pthread_mutex_unlock(&bus->lock);
+  if (rc < 0) {
+    syslog(LOG_WARNING, "mctp_i2c_read failed to do raw io");
     return -1;
   }
 
   return 0;
 }
 
-int mctp_get_iom_ioc_ver(uint8_t *value) {
-  static uint8_t tag_num = 0;
-  uint8_t pwrite_buf[72];
-  uint8_t readd[80];
-  int reading = -1;
-  int i = 0, ret = 0, retry = 0;
-
-  memset(pwrite_buf, 0, 72);
-
-  while(retry <= MAX_MCTP_RETRY_CNT) {
-    pwrite_buf[0] = 0xf;
-    pwrite_buf[1] = 0x1D;
-    pwrite_buf[2] = 0x01;
-    pwrite_buf[3] = 0x01;
-    pwrite_buf[4] = 0x00;
-    pwrite_buf[5] = 0x00;
-    pwrite_buf[6] = 0xc8;
-    pwrite_buf[7] = 0x7e;
-    pwrite_buf[8] = 0x10;
-    pwrite_buf[9] = 0x00;
-    pwrite_buf[10] = 0x20; /* Payload ID */
-    pwrite_buf[11] = 0x00;
-    pwrite_buf[12] = 0x0;
-    pwrite_buf[13] = tag_num; /* App Msg tag */
-    pwrite_buf[14] = 0x05; /* Command         Issue an MPI request */
-    pwrite_buf[15] = 0x00; /* Payload length */
-    pwrite_buf[16] = 0x0C;
-    pwrite_buf[17] = 0x00; /*Response length */
-    pwrite_buf[18] = 0x3C;
-    pwrite_buf[19] = 0x00;
-    pwrite_buf[20] = 0x00;
-    pwrite_buf[21] = 0x00; /*ChainOffset*/
-    pwrite_buf[22] = 0x03; /* Function code */
-    pwrite_buf[23] = 0x00;
-    pwrite_buf[24] = 0x00;
-    pwrite_buf[25] = 0x00;
-    pwrite_buf[26] = 0x00; /* MsgFlags */
-    pwrite_buf[27] = 0x00; /* VP_ID */
-    pwrite_buf[28] = 0x00; /* VF_ID */
-    pwrite_buf[29] = 0x00;
-    pwrite_buf[30] = 0x00;
-
-    ret = mctp_i2c_write(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, pwrite_buf, 31);
-    if (ret < 0) {
-      retry++;
-      continue;
-    }
-
-    memset(readd, 0, 80);
-
-    ret = mctp_i2c_read(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, readd, 72);
-    // If any of the version register byte is 0xff, init and retry
-    if (readd[51] == 0xff || readd[52] == 0xff || readd[53] == 0xff || readd[54] == 0xff || ret != 0) {
-
-      retry++;
-
-      if (retry <= MAX_MCTP_RETRY_CNT) {
-        tag_num = tag_num + 1;
-        if (tag_num == 0)
-        tag_num = 1;
-        
-        ret = mctp_ioc_init(tag_num);
-        if (ret != 0) {
-          #ifdef DEBUG
-            syslog(LOG_WARNING, "IOC init failed for Get IOC version.");
-          #endif
-        }
-      }
+//Type7 IOM IOC
+static mctp_bus_t *g_ioc_bus = NULL;
+static uint8_t g_ioc_addr = IOM_IOC_SLAVE_ADDRESS;
+
+// LSI vendor defined message header: type, PCI vendor ID 0x1000, payload ID,
+// 2 reserved, app msg tag, command, payload length, response length
+#define IOC_VDM_HDR_LEN     12
+#define IOC_APP_TAG_OFFSET  6
+
+static const uint8_t ioc_init_req[] = {
+  MCTP_MSG_TYPE_VDM_PCI, 0x10, 0x00,
+  0x20, 0x00, 0x00, 0x00,
+  0x01,       /* Command initail MCTP interface can't open */
+  0x00, 0x00, /* Payload length */
+  0x00, 0x00,
+};
+
+static const uint8_t ioc_ver_req[] = {
+  MCTP_MSG_TYPE_VDM_PCI, 0x10, 0x00,
+  0x20, 0x00, 0x00, 0x00,
+  0x05,       /* Command         Issue an MPI request */
+  0x00, 0x0C, /* Payload length */
+  0x00, 0x3C, /* Response length */
+  0x00, 0x00,
+  0x00,       /* ChainOffset */
+  0x03,       /* Function code */
+  0x00, 0x00, 0x00,
+  0x00,       /* MsgFlags */
+  0x00,       /* VP_ID */
+  0x00,       /* VF_ID */
+  0x00, 0x00,
+};
+
+static const uint8_t ioc_temp_req[] = {
+  MCTP_MSG_TYPE_VDM_PCI, 0x10, 0x00,
+  0x20, 0x00, 0x00, 0x00,
+  0x05,       /* Command  Issue an MPI request */
+  0x00, 0x14, /* Payload length */
+  0x00, 0x3C,
+  0x01, 0x00, 0x00,
+  0x04,
+  0x00,       /* ExtpageLength */
+  0x00, 0x00, 0x00,
+  0x02,       /* Page Version */
+  0x0a,       /* Page Length */
+  0x07,       /* Page Number */
+  0x00,       /* Page Type */
+  0x00, 0x00, 0x00, 0x00,
+};
+
+// MPI reply bytes used: IOC version and temperature
+#define IOC_VER_OFFSET      (IOC_VDM_HDR_LEN + 32)
+#define IOC_TEMP_OFFSET     (IOC_VDM_HDR_LEN + 36)
+
+void
+mctp_ioc_set_bus(mctp_bus_t *bus, uint8_t addr) {
+  g_ioc_bus = bus;
+  g_ioc_addr = addr;
+}
 
-      #ifdef DEBUG
-        syslog(LOG_WARNING, "GET IOC Version Failed. Retry: %d\n", retry);
-      #endif
-      continue;
+/*
+ * Send a request to the IOC and receive the first *len bytes of its
+ * response, which fit in the first packet.
+ */
+static int
+mctp_ioc_request(const uint8_t *req, int req_len, uint8_t tag,
+                 uint8_t *resp, int *len) {
+  uint8_t msg[MCTP_BTU];
+  int msg_tag;
+
+  if (g_ioc_bus == NULL) {
+    g_ioc_bus = mctp_bus_open(IOM_IOC_BUS_NUM, 0);
+    if (g_ioc_bus == NULL) {
+      return -1;
     }
+  }
 
-    break;
+  memcpy(msg, req, req_len);
+  msg[IOC_APP_TAG_OFFSET] = tag;
+  msg_tag = mctp_req_send(g_ioc_bus, g_ioc_addr, MCTP_EID_NULL, msg, req_len);
+  if (msg_tag < 0) {
+    return -1;
   }
 
-  if (retry <= MAX_MCTP_RETRY_CNT) {
-    memcpy(value, readd + 51, 4);
-    return 0;
-  } else
-      return -1;
+  return mctp_resp_recv(g_ioc_bus, g_ioc_addr, msg_tag, resp, len,
+                        MCTP_RESP_TIMEOUT_MS);
 }
 
-int mctp_get_iom_ioc_temp(float *value) {
-  static uint8_t tag_num = 0;
-  uint8_t pwrite_buf[72];
-  uint8_t readd[80];
-  int i = 0, ret = 0, retry = 0;
-
-  memset(pwrite_buf, 0, 72);
-
-  while(retry <= MAX_MCTP_RETRY_CNT) {
-    pwrite_buf[0] = 0xf;
-    pwrite_buf[1] = 0x21;
-    pwrite_buf[2] = 0x1;
-    pwrite_buf[3] = 0x01;
-    pwrite_buf[4] = 0x00;
-    pwrite_buf[5] = 0x00;
-    pwrite_buf[6] = 0xc8;
-    pwrite_buf[7] = 0x7e;
-    pwrite_buf[8] = 0x10;
-    pwrite_buf[9] = 0x00;
-    pwrite_buf[10] = 0x20;  /*  Payload ID */
-    pwrite_buf[11] = 0x00;
-    pwrite_buf[12] = 0x0;
-    pwrite_buf[13] = tag_num;  /* App Msg tag */
-    pwrite_buf[14] = 0x05;  /* Command  Issue an MPI request */
-    pwrite_buf[15] = 0x0;   /* Payload length */
-    pwrite_buf[16] = 0x14;
-    pwrite_buf[17] = 0x0;
-    pwrite_buf[18] = 0x3C;
-    pwrite_buf[19] = 0x01;
-    pwrite_buf[20] = 0x0;
-    pwrite_buf[21] = 0x0;
-    pwrite_buf[22] = 0x04;
-    pwrite_buf[23] = 0x0;   /* ExtpageLength */
-    pwrite_buf[24] = 0x0;
-    pwrite_buf[25] = 0x0;
-    pwrite_buf[26] = 0x0;
-    pwrite_buf[27] = 0x02;  /* Page Version */
-    pwrite_buf[28] = 0x0a;  /* Page Length */
-    pwrite_buf[29] = 0x07;  /* Page Number */
-    pwrite_buf[30] = 0x00;  /* Page Type */
-    pwrite_buf[31] = 0x0;
-    pwrite_buf[32] = 0x0;
-    pwrite_buf[33] = 0x0;
-    pwrite_buf[34] = 0x0;
-
-    ret = mctp_i2c_write(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, pwrite_buf, 35);
-    if (ret < 0) {
-      retry++;
-      continue;
-    }
-
-    memset(readd, 0, 80);
+//Type7 IOM IOC initialization
+int mctp_ioc_init(uint8_t tag) {
+  uint8_t readd[IOC_VDM_HDR_LEN];
+  int len = sizeof(readd);
 
-    ret = mctp_i2c_read(IOM_IOC_BUS_NUM, IOM_IOC_SLAVE_ADDRESS, readd, 72);
-    // When any of the temp register byte is 0xff, init and retry
-    if (readd[55] == 0xff || readd[56] == 0xff  || ret != 0) {
+  return mctp_ioc_request(ioc_init_req, sizeof(ioc_init_req), tag, readd, &len);
+}
 
-      retry++;
+/*
+ * Issue an MPI request to the IOC and read len bytes of the response. When
+ * the bytes of interest at [off, off + n) are 0xff, init and retry.
+ */
+static int
+mctp_ioc_mpi(const uint8_t *req, int req_len, uint8_t *tag_num,
+             uint8_t *readd, int off, int n) {
+  int retry, len, ret, i;
+  bool valid;
+
+  for (retry = 0; retry <= MAX_MCTP_RETRY_CNT; retry++) {
+    len = off + n;
+    ret = mctp_ioc_request(req, req_len, *tag_num, readd, &len);
+    valid = (ret == 0 && len == off + n);
+    for (i = 0; valid && i < n; i++) {
+      valid = (readd[off + i] != 0xff);
+    }
+    if (valid) {
+      return 0;
+    }
 
-      if (retry <= MAX_MCTP_RETRY_CNT) {
-        tag_num = tag_num + 1;
-        if (tag_num == 0)
-        tag_num = 1;
+    if (retry < MAX_MCTP_RETRY_CNT) {
+      *tag_num = *tag_num + 1;
+      if (*tag_num == 0)
+        *tag_num = 1;
 
-        ret = mctp_ioc_init(tag_num);
-        if ( ret != 0) {
-          #ifdef DEBUG
-            syslog(LOG_WARNING, "IOC init failed for Get IOC version.");
-          #endif
-        }
+      ret = mctp_ioc_init(*tag_num);
+      if (ret != 0) {
+        #ifdef DEBUG
+          syslog(LOG_WARNING, "IOC init failed.");
+        #endif
       }
-
-      #ifdef DEBUG
-        syslog(LOG_WARNING, "GET IOC Temp Failed. Retry: %d\n", retry);
-      #endif
-      continue;
     }
 
-    break;
+    #ifdef DEBUG
+      syslog(LOG_WARNING, "IOC MPI request failed. Retry: %d\n", retry + 1);
+    #endif
   }
 
-  if (retry <= MAX_MCTP_RETRY_CNT) {
-    *value = readd[55] + (readd[56] * 256);
-    return 0;
-  } else
+  return -1;
+}
+
+int mctp_get_iom_ioc_ver(uint8_t *value) {
+  static uint8_t tag_num = 0;
+  uint8_t readd[IOC_VER_OFFSET + 4];
+
+  if (mctp_ioc_mpi(ioc_ver_req, sizeof(ioc_ver_req), &tag_num,
+                   readd, IOC_VER_OFFSET, 4)) {
+    return -1;
+  }
+  memcpy(value, readd + IOC_VER_OFFSET, 4);
+  return 0;
+}
+
+int mctp_get_iom_ioc_temp(float *value) {
+  static uint8_t tag_num = 0;
+  uint8_t readd[IOC_TEMP_OFFSET + 2];
+
+  if (mctp_ioc_mpi(ioc_temp_req, sizeof(ioc_temp_req), &tag_num,
+                   readd, IOC_TEMP_OFFSET, 2)) {
     return -1;
+  }
+  *value = readd[IOC_TEMP_OFFSET] + (readd[IOC_TEMP_OFFSET + 1] * 256);
+  return 0;
 }
@@ -25,14 +25,106 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #define I2C_RETRIES_MAX 5
 
 //Type7 IOM IOC
 #define IOM_IOC_BUS_NUM 1
 #define IOM_IOC_SLAVE_ADDRESS 0x5
 
+// MCTP over SMBus (DSP0237) packet: command code, byte count, source slave
+// address, header version, destination EID, source EID, flags, payload, PEC
+#define MCTP_SMBUS_CMD_CODE   0x0f
+#define MCTP_HDR_VERSION      0x01
+#define MCTP_SMBUS_HDR_LEN    7
+#define MCTP_BTU              64    // baseline transmission unit, payload/packet
+#define MCTP_SMBUS_PKT_LEN    (MCTP_SMBUS_HDR_LEN + MCTP_BTU + 1)
+#define MCTP_MAX_MSG_LEN      1024
+
+#define MCTP_FLAG_SOM         0x80
+#define MCTP_FLAG_EOM         0x40
+#define MCTP_FLAG_TO          0x08
+#define MCTP_SEQ(flags)       (((flags) >> 4) & 0x3)
+#define MCTP_TAG(flags)       ((flags) & 0x7)
+#define MCTP_TAG_COUNT        8
+
+#define MCTP_EID_NULL         0x00
+#define MCTP_EID_BROADCAST    0xff
+
+#define MCTP_MSG_TYPE_CONTROL 0x00
+#define MCTP_MSG_TYPE_VDM_PCI 0x7e
+#define MCTP_CTRL_SET_EID     0x01
+
+// Default time to wait for a response
+#define MCTP_RESP_TIMEOUT_MS  100
+
+// Transfers of a bus, addr is the 7-bit slave address. Return 0 or -1.
+// delay and clock (usec) are optional, nanosleep() and CLOCK_MONOTONIC
+// are used without them.
+typedef struct {
+  int (*write)(void *priv, uint8_t addr, const uint8_t *buf, int len);
+  int (*read)(void *priv, uint8_t addr, uint8_t *buf, int len);
+  void (*delay)(void *priv, int usec);
+  uint64_t (*clock)(void *priv);
+} mctp_bus_ops_t;
+
+typedef struct {
+  uint64_t requests;
+  uint64_t tx_packets;
+  uint64_t rx_packets;
+  uint64_t tx_bytes;
+  uint64_t rx_bytes;
+  uint64_t xfer_errors;   // failed transfers
+  uint64_t not_ready;     // reads without a response packet
+  uint64_t dropped;       // packets not matching an outstanding request
+  uint64_t timeouts;
+  uint64_t bus_usec;      // time spent in transfers
+  uint64_t req_usec;      // sum of request to response times
+  uint64_t req_usec_max;
+} mctp_stats_t;
+
+typedef struct mctp_bus mctp_bus_t;
+
+// Buses are opened once per process and stay open, mctp_bus_open() returns
+// the same handle for the same bus number. own_addr is our 7-bit address.
+mctp_bus_t *mctp_bus_open(uint8_t bus_num, uint8_t own_addr);
+// A bus on other transfers, e.g. mctp_sim_ops of the test simulator
+mctp_bus_t *mctp_bus_attach(const mctp_bus_ops_t *ops, void *priv, uint8_t own_addr);
+void mctp_bus_detach(mctp_bus_t *bus);
+void mctp_bus_get_stats(mctp_bus_t *bus, mctp_stats_t *stats);
+void mctp_bus_reset_stats(mctp_bus_t *bus);
+
+// Endpoint IDs: our own (MCTP_EID_NULL by default) and the routes to others
+void mctp_set_local_eid(uint8_t eid);
+int mctp_route_add(uint8_t eid, mctp_bus_t *bus, uint8_t addr);
+int mctp_route_del(uint8_t eid);
+// Set Endpoint ID of the endpoint at addr, adds the route on success.
+// Returns the EID the endpoint accepted or -1.
+int mctp_assign_eid(mctp_bus_t *bus, uint8_t addr, uint8_t eid);
+
+// Send a request message (message type first) to the endpoint at addr,
+// fragmented into packets as needed. Returns the message tag to match the
+// response with, up to MCTP_TAG_COUNT requests can be outstanding per endpoint.
+int mctp_req_send(mctp_bus_t *bus, uint8_t addr, uint8_t dst_eid,
+                  const uint8_t *msg, int len);
+// Receive the response with tag, reassembled. *len is the size of msg on
+// input and the length of the response on output. A larger response is
+// truncated and its remaining packets are not read. Packets of other
+// outstanding requests are kept for them.
+int mctp_resp_recv(mctp_bus_t *bus, uint8_t addr, uint8_t tag,
+                   uint8_t *msg, int *len, int timeout_ms);
+// Drop an outstanding request, e.g. after a timeout
+void mctp_req_abort(mctp_bus_t *bus, uint8_t addr, uint8_t tag);
+// Request and response with an endpoint by EID over its route
+int mctp_request(uint8_t eid, const uint8_t *req, int req_len,
+                 uint8_t *resp, int *resp_len, int timeout_ms);
+
 int mctp_i2c_write(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len);
 int mctp_i2c_read(uint8_t dev_number, uint8_t slave_addr,uint8_t *buf, uint8_t len);
+// Talk to the IOC over another bus than IOM_IOC_BUS_NUM, e.g. a simulator
+void mctp_ioc_set_bus(mctp_bus_t *bus, uint8_t addr);
 int mctp_get_iom_ioc_ver(uint8_t *vaule);
 int mctp_get_iom_ioc_temp(float *value);
 
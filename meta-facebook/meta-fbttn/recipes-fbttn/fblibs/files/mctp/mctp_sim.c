@@ -0,0 +1,302 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * In-process MCTP over SMBus endpoint, for testing the library without an
+ * IOC: attach a bus with mctp_bus_attach(&mctp_sim_ops, sim, own_addr).
+ * Request messages are reassembled and given to the handler, Set Endpoint
+ * ID is answered by the simulator itself. Time is virtual, it advances with
+ * the bytes on the bus at the bus clock and with the delays of the library,
+ * so nothing sleeps.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mctp_sim.h"
+
+#define SIM_MAX_RESP  16
+#define SIM_MAX_PKTS  ((MCTP_MAX_MSG_LEN + MCTP_BTU - 1) / MCTP_BTU)
+
+typedef struct {
+  uint64_t ready;   // virtual time the response can be read from
+  int npkts;
+  int next;
+  uint8_t pkts[SIM_MAX_PKTS][MCTP_SMBUS_PKT_LEN];
+} sim_resp_t;
+
+typedef struct {
+  bool in_msg;
+  uint8_t next_seq;
+  int len;
+  uint8_t buf[MCTP_MAX_MSG_LEN];
+} sim_req_t;
+
+struct mctp_sim {
+  uint8_t addr;
+  uint8_t eid;
+  mctp_sim_handler_t handler;
+  void *ctx;
+  int bus_khz;
+  int process_usec;
+  bool reorder;
+  int depth;
+  uint64_t now;
+  uint64_t bus_usec;
+  sim_req_t req[MCTP_TAG_COUNT];
+  sim_resp_t *resp[SIM_MAX_RESP];
+  int nresp;
+};
+
+mctp_sim_t *
+mctp_sim_create(uint8_t addr, mctp_sim_handler_t handler, void *ctx) {
+  mctp_sim_t *sim;
+
+  sim = calloc(1, sizeof(*sim));
+  if (sim == NULL) {
+    return NULL;
+  }
+  sim->addr = addr;
+  sim->handler = handler;
+  sim->ctx = ctx;
+  sim->bus_khz = 100;
+  sim->depth = SIM_MAX_RESP;
+
+  return sim;
+}
+
+void
+mctp_sim_destroy(mctp_sim_t *sim) {
+  int i;
+
+  if (sim == NULL) {
+    return;
+  }
+  for (i = 0; i < sim->nresp; i++) {
+    free(sim->resp[i]);
+  }
+  free(sim);
+}
+
+void
+mctp_sim_set_timing(mctp_sim_t *sim, int bus_khz, int process_usec) {
+  sim->bus_khz = bus_khz;
+  sim->process_usec = process_usec;
+}
+
+void
+mctp_sim_set_reorder(mctp_sim_t *sim, bool reorder) {
+  sim->reorder = reorder;
+}
+
+void
+mctp_sim_set_depth(mctp_sim_t *sim, int depth) {
+  sim->depth = (depth < 1 || depth > SIM_MAX_RESP) ? SIM_MAX_RESP : depth;
+}
+
+uint64_t
+mctp_sim_bus_usec(mctp_sim_t *sim) {
+  return sim->bus_usec;
+}
+
+// Address byte and data bytes, 9 clocks each
+static void
+sim_xfer_time(mctp_sim_t *sim, int len) {
+  uint64_t usec = (uint64_t)(len + 1) * 9 * 1000 / sim->bus_khz;
+
+  sim->now += usec;
+  sim->bus_usec += usec;
+}
+
+static void
+sim_respond(mctp_sim_t *sim, const uint8_t *hdr, const uint8_t *req, int len) {
+  uint8_t msg[MCTP_MAX_MSG_LEN];
+  sim_resp_t *r;
+  int n, off, i;
+
+  if (req[0] == MCTP_MSG_TYPE_CONTROL && len >= 5 &&
+      req[2] == MCTP_CTRL_SET_EID) {
+    sim->eid = req[4];
+    msg[0] = MCTP_MSG_TYPE_CONTROL;
+    msg[1] = req[1] & 0x1f;
+    msg[2] = MCTP_CTRL_SET_EID;
+    msg[3] = 0x00;  // completion code
+    msg[4] = 0x00;  // EID assignment accepted
+    msg[5] = sim->eid;
+    msg[6] = 0x00;  // no EID pool
+    n = 7;
+  } else if (sim->handler) {
+    n = sim->handler(sim->ctx, req, len, msg, sizeof(msg));
+  } else {
+    n = -1;
+  }
+  if (n <= 0) {
+    return;
+  }
+
+  // A new request drops what is left of a response read in part, and the
+  // oldest responses beyond the depth
+  for (i = 0; i < sim->nresp;) {
+    if (sim->resp[i]->next > 0 || sim->nresp >= sim->depth) {
+      free(sim->resp[i]);
+      memmove(&sim->resp[i], &sim->resp[i + 1],
+              (sim->nresp - i - 1) * sizeof(sim->resp[0]));
+      sim->nresp--;
+    } else {
+      i++;
+    }
+  }
+
+  r = calloc(1, sizeof(*r));
+  if (r == NULL) {
+    return;
+  }
+  r->ready = sim->now + sim->process_usec;
+  for (off = 0, i = 0; off < n; off += MCTP_BTU, i++) {
+    int plen = (n - off > MCTP_BTU) ? MCTP_BTU : n - off;
+    uint8_t *pkt = r->pkts[i];
+
+    pkt[0] = MCTP_SMBUS_CMD_CODE;
+    pkt[1] = MCTP_SMBUS_HDR_LEN - 2 + plen;
+    pkt[2] = (sim->addr << 1) | 0x01;
+    pkt[3] = MCTP_HDR_VERSION;
+    pkt[4] = hdr[5];      // requester's EID
+    pkt[5] = sim->eid;
+    pkt[6] = ((off == 0) ? MCTP_FLAG_SOM : 0) |
+             ((off + plen == n) ? MCTP_FLAG_EOM : 0) |
+             ((i & 0x3) << 4) | MCTP_TAG(hdr[6]);
+    memcpy(&pkt[MCTP_SMBUS_HDR_LEN], &msg[off], plen);
+  }
+  r->npkts = i;
+  sim->resp[sim->nresp++] = r;
+}
+
+static int
+sim_write(void *priv, uint8_t addr, const uint8_t *buf, int len) {
+  mctp_sim_t *sim = (mctp_sim_t *)priv;
+  sim_req_t *rq;
+  uint8_t flags;
+  int n;
+
+  if (addr != sim->addr) {
+    sim_xfer_time(sim, 0);
+    return -1;
+  }
+  sim_xfer_time(sim, len);
+
+  n = len - MCTP_SMBUS_HDR_LEN;
+  if (len < MCTP_SMBUS_HDR_LEN || buf[0] != MCTP_SMBUS_CMD_CODE ||
+      buf[1] != len - 2 || buf[3] != MCTP_HDR_VERSION || n > MCTP_BTU) {
+    return 0;
+  }
+  flags = buf[6];
+  if (!(flags & MCTP_FLAG_TO)) {
+    return 0;
+  }
+
+  rq = &sim->req[MCTP_TAG(flags)];
+  if (flags & MCTP_FLAG_SOM) {
+    rq->in_msg = true;
+    rq->len = 0;
+  } else if (!rq->in_msg || MCTP_SEQ(flags) != rq->next_seq) {
+    rq->in_msg = false;
+    return 0;
+  }
+  if (rq->len + n > MCTP_MAX_MSG_LEN) {
+    rq->in_msg = false;
+    return 0;
+  }
+  memcpy(&rq->buf[rq->len], &buf[MCTP_SMBUS_HDR_LEN], n);
+  rq->len += n;
+  rq->next_seq = (MCTP_SEQ(flags) + 1) & 0x3;
+
+  if (flags & MCTP_FLAG_EOM) {
+    rq->in_msg = false;
+    sim_respond(sim, buf, rq->buf, rq->len);
+  }
+
+  return 0;
+}
+
+static int
+sim_read(void *priv, uint8_t addr, uint8_t *buf, int len) {
+  mctp_sim_t *sim = (mctp_sim_t *)priv;
+  sim_resp_t *r = NULL;
+  int i, pick = -1;
+
+  if (addr != sim->addr) {
+    sim_xfer_time(sim, 0);
+    return -1;
+  }
+  sim_xfer_time(sim, len);
+  if (len > MCTP_SMBUS_PKT_LEN) {
+    len = MCTP_SMBUS_PKT_LEN;
+  }
+
+  // Finish a response being read first, else the oldest (newest when
+  // reordering) one that is ready
+  for (i = 0; i < sim->nresp; i++) {
+    if (sim->resp[i]->next > 0) {
+      pick = i;
+      break;
+    }
+    if (sim->resp[i]->ready <= sim->now && (pick < 0 || sim->reorder)) {
+      pick = i;
+    }
+  }
+
+  if (pick < 0) {
+    // Nothing ready, like the IOC
+    memset(buf, 0xff, len);
+    return 0;
+  }
+
+  r = sim->resp[pick];
+  memcpy(buf, r->pkts[r->next++], len);
+  if (r->next == r->npkts) {
+    free(r);
+    memmove(&sim->resp[pick], &sim->resp[pick + 1],
+            (sim->nresp - pick - 1) * sizeof(sim->resp[0]));
+    sim->nresp--;
+  }
+
+  return 0;
+}
+
+static void
+sim_delay(void *priv, int usec) {
+  mctp_sim_t *sim = (mctp_sim_t *)priv;
+
+  sim->now += usec;
+}
+
+static uint64_t
+sim_clock(void *priv) {
+  return ((mctp_sim_t *)priv)->now;
+}
+
+const mctp_bus_ops_t mctp_sim_ops = {
+  .write = sim_write,
+  .read = sim_read,
+  .delay = sim_delay,
+  .clock = sim_clock,
+};
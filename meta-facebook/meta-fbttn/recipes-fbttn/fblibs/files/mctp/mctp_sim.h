@@ -0,0 +1,45 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef __MCTP_SIM_H__
+#define __MCTP_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mctp.h"
+
+// In-process endpoint for mctp-test, not part of libmctp. The handler gets a request message
+// and returns the length of the response written to resp or -1 for none.
+typedef int (*mctp_sim_handler_t)(void *ctx, const uint8_t *req, int req_len,
+                                  uint8_t *resp, int resp_max);
+typedef struct mctp_sim mctp_sim_t;
+extern const mctp_bus_ops_t mctp_sim_ops;
+mctp_sim_t *mctp_sim_create(uint8_t addr, mctp_sim_handler_t handler, void *ctx);
+void mctp_sim_destroy(mctp_sim_t *sim);
+// Bus clock and time the endpoint takes to answer a request
+void mctp_sim_set_timing(mctp_sim_t *sim, int bus_khz, int process_usec);
+// Answer outstanding requests newest first
+void mctp_sim_set_reorder(mctp_sim_t *sim, bool reorder);
+// Responses held, a new request drops the oldest beyond. The IOC holds one.
+void mctp_sim_set_depth(mctp_sim_t *sim, int depth);
+// Time the bus was busy with transfers to the endpoint
+uint64_t mctp_sim_bus_usec(mctp_sim_t *sim);
+
+#endif /* __MCTP_SIM_H__ */
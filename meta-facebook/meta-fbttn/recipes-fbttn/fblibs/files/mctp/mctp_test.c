@@ -0,0 +1,230 @@
+/*
+ *
+ * Copyright 2017-present Facebook. All Rights Reserved.
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/*
+ * Tests of the MCTP transport against the in-process endpoint, and a
+ * comparison of the bus time of IOC polling with the old request sequence.
+ *
+ * eg: mctp-test [iterations]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mctp_sim.h"
+
+#define SIM_ADDR  0x5
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+// Echoes the request back
+static int
+echo_handler(void *ctx, const uint8_t *req, int req_len,
+             uint8_t *resp, int resp_max) {
+  memcpy(resp, req, req_len);
+  return req_len;
+}
+
+// LSI IOC: IOCFacts and IO unit page 7 replies with a firmware version and
+// a temperature, honouring the requested response length
+static int
+ioc_handler(void *ctx, const uint8_t *req, int req_len,
+            uint8_t *resp, int resp_max) {
+  int rlen;
+
+  if (req_len < 12 || req[0] != MCTP_MSG_TYPE_VDM_PCI) {
+    return -1;
+  }
+  memcpy(resp, req, 12);
+  if (req[7] != 0x05) {
+    return 12;
+  }
+  rlen = (req[10] << 8) | req[11];
+  memset(resp + 12, 0, rlen);
+  if (req[12 + 3] == 0x03) {
+    resp[12 + 32] = 0x0e;
+    resp[12 + 33] = 0x00;
+    resp[12 + 34] = 0x02;
+    resp[12 + 35] = 0x01;
+  } else {
+    resp[12 + 36] = 45;
+    resp[12 + 37] = 0;
+  }
+  return 12 + rlen;
+}
+
+static void
+test_fragmentation(mctp_bus_t *bus) {
+  uint8_t req[300], resp[400];
+  int len = sizeof(resp);
+  mctp_stats_t st;
+  int i, tag;
+
+  for (i = 0; i < sizeof(req); i++) {
+    req[i] = i * 7;
+  }
+  mctp_bus_reset_stats(bus);
+  tag = mctp_req_send(bus, SIM_ADDR, MCTP_EID_NULL, req, sizeof(req));
+  CHECK(tag >= 0);
+  CHECK(mctp_resp_recv(bus, SIM_ADDR, tag, resp, &len, 100) == 0);
+  CHECK(len == sizeof(req));
+  CHECK(memcmp(req, resp, sizeof(req)) == 0);
+  mctp_bus_get_stats(bus, &st);
+  CHECK(st.tx_packets == 5);
+  CHECK(st.rx_packets == 5);
+}
+
+static void
+test_outstanding(mctp_sim_t *sim, mctp_bus_t *bus) {
+  uint8_t req[3][100], resp[100];
+  int tags[3];
+  int i, len;
+
+  mctp_sim_set_reorder(sim, true);
+  for (i = 0; i < 3; i++) {
+    memset(req[i], 0x10 + i, sizeof(req[i]));
+    tags[i] = mctp_req_send(bus, SIM_ADDR, MCTP_EID_NULL, req[i], 70 + i);
+    CHECK(tags[i] >= 0);
+  }
+  // The endpoint answers the last request first, the packets read while
+  // waiting are kept for their requests
+  for (i = 0; i < 3; i++) {
+    len = sizeof(resp);
+    CHECK(mctp_resp_recv(bus, SIM_ADDR, tags[i], resp, &len, 100) == 0);
+    CHECK(len == 70 + i);
+    CHECK(memcmp(resp, req[i], len) == 0);
+  }
+  mctp_sim_set_reorder(sim, false);
+}
+
+static void
+test_eid(mctp_bus_t *bus) {
+  uint8_t req[4] = {MCTP_MSG_TYPE_VDM_PCI, 1, 2, 3};
+  uint8_t resp[8];
+  int len = sizeof(resp);
+
+  CHECK(mctp_request(0x20, req, sizeof(req), resp, &len, 100) < 0);
+  CHECK(mctp_assign_eid(bus, SIM_ADDR, 0x20) == 0x20);
+  CHECK(mctp_request(0x20, req, sizeof(req), resp, &len, 100) == 0);
+  CHECK(len == sizeof(req) && memcmp(req, resp, len) == 0);
+  CHECK(mctp_route_del(0x20) == 0);
+}
+
+// The IOC sequence before the transport: write the request, read a whole
+// packet right away, init and retry when the bytes wanted are 0xff
+static int
+legacy_ioc_temp(mctp_bus_t *bus, mctp_sim_t *sim, float *value) {
+  static const uint8_t init[19] = {
+    0xf, 0x11, 0x1, 0x01, 0x00, 0x0, 0xc8, 0x7e, 0x10, 0x00, 0x20,
+  };
+  static const uint8_t temp[35] = {
+    0xf, 0x21, 0x1, 0x01, 0x00, 0x00, 0xc8, 0x7e, 0x10, 0x00, 0x20, 0x00,
+    0x0, 0x0, 0x05, 0x0, 0x14, 0x0, 0x3C, 0x01, 0x0, 0x0, 0x04, 0x0, 0x0,
+    0x0, 0x0, 0x02, 0x0a, 0x07, 0x00,
+  };
+  uint8_t readd[80];
+  int retry;
+
+  for (retry = 0; retry <= 3; retry++) {
+    mctp_sim_ops.write(sim, SIM_ADDR, temp, sizeof(temp));
+    memset(readd, 0, sizeof(readd));
+    mctp_sim_ops.read(sim, SIM_ADDR, readd, 72);
+    if (readd[55] != 0xff && readd[56] != 0xff) {
+      *value = readd[55] + readd[56] * 256;
+      return 0;
+    }
+    if (retry < 3) {
+      mctp_sim_ops.write(sim, SIM_ADDR, init, sizeof(init));
+      mctp_sim_ops.read(sim, SIM_ADDR, readd, 72);
+    }
+  }
+  return -1;
+}
+
+static void
+test_ioc(mctp_sim_t *sim, mctp_bus_t *bus, int iterations) {
+  uint8_t ver[4];
+  float temp = 0;
+  uint64_t start;
+  double legacy_usec, usec;
+  int process_usec[] = {0, 2000, 5000, 10000, 20000};
+  int i, j, ok;
+
+  mctp_sim_set_depth(sim, 1);
+  mctp_ioc_set_bus(bus, SIM_ADDR);
+  CHECK(mctp_get_iom_ioc_ver(ver) == 0);
+  CHECK(ver[0] == 0x0e && ver[3] == 0x01);
+  CHECK(mctp_get_iom_ioc_temp(&temp) == 0);
+  CHECK(temp == 45);
+
+  printf("%-12s %16s %16s %10s\n",
+         "IOC_BUSY_MS", "OLD_BUS_MS/READ", "NEW_BUS_MS/READ", "OLD_FAILS");
+  for (j = 0; j < sizeof(process_usec) / sizeof(process_usec[0]); j++) {
+    mctp_sim_set_timing(sim, 100, process_usec[j]);
+
+    start = mctp_sim_bus_usec(sim);
+    for (i = 0, ok = 0; i < iterations; i++) {
+      ok += (legacy_ioc_temp(bus, sim, &temp) == 0);
+    }
+    legacy_usec = (double)(mctp_sim_bus_usec(sim) - start) / iterations;
+
+    start = mctp_sim_bus_usec(sim);
+    for (i = 0; i < iterations; i++) {
+      CHECK(mctp_get_iom_ioc_temp(&temp) == 0);
+    }
+    usec = (double)(mctp_sim_bus_usec(sim) - start) / iterations;
+
+    printf("%-12.1f %16.2f %16.2f %10d\n", process_usec[j] / 1000.0,
+           legacy_usec / 1000, usec / 1000, iterations - ok);
+  }
+}
+
+int
+main(int argc, char **argv) {
+  int iterations = (argc > 1) ? atoi(argv[1]) : 100;
+  mctp_sim_t *sim, *ioc;
+  mctp_bus_t *bus, *ioc_bus;
+
+  sim = mctp_sim_create(SIM_ADDR, echo_handler, NULL);
+  bus = mctp_bus_attach(&mctp_sim_ops, sim, 0x10);
+  test_fragmentation(bus);
+  test_outstanding(sim, bus);
+  test_eid(bus);
+  mctp_bus_detach(bus);
+  mctp_sim_destroy(sim);
+
+  ioc = mctp_sim_create(SIM_ADDR, ioc_handler, NULL);
+  ioc_bus = mctp_bus_attach(&mctp_sim_ops, ioc, 0x00);
+  test_ioc(ioc, ioc_bus, iterations);
+  mctp_bus_detach(ioc_bus);
+  mctp_sim_destroy(ioc);
+
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <syslog.h>
 #include <sys/mman.h>
+#include <sys/file.h>
 #include <string.h>
 #include <pthread.h>
 #include <openbmc/obmc-sensor.h>
@@ -273,6 +274,9 @@ struct power_coeff power_table[] = {
 /* NVMe-MI SSD SMART Critical Warning */
 #define NVME_SMART_WARNING_MASK_BIT 0x1F // Check bit 0~4
 
+/* Age of the NVMe-MI data pal_drive_health() accepts from the cache */
+#define NVME_DATA_MAX_AGE_MS 1000
+
 #define MAX_SERIAL_NUM 20
 
 /* Adjust power value */
@@ -2800,280 +2804,185 @@ pal_fan_recovered_handle(int fan_num) {
   return 0;
 }
 
-int pal_expander_sensor_check(uint8_t fru, uint8_t sensor_num) {
+// Returns 1 if the sensors of the FRU are older than 5 seconds, 0 if not
+static int
+pal_expander_sensor_stale(char *key, int tolerance) {
   int ret;
-  char key[MAX_KEY_LEN] = {0};
   char cvalue[MAX_VALUE_LEN] = {0};
-  int timestamp, timestamp_flag = 0, current_time, tolerance = 0;
-  //clock_gettime parameters
-  char tstr[MAX_VALUE_LEN] = {0};
+  int timestamp;
   struct timespec ts;
 
-  int sensor_cnt = 1; //default is single call, so just 1 sensor
+  ret = pal_get_edb_value(key, cvalue);
+  if (ret < 0) {
+#ifdef DEBUG
+    syslog(LOG_WARNING, "pal_expander_sensor_check: pal_get_key_value failed for "
+        "%s", key);
+#endif
+    return ret;
+  }
+
+  timestamp = atoi(cvalue);
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return (abs((int)ts.tv_sec - timestamp) > (5 - tolerance)) ? 1 : 0;
+}
+
+/*
+ * A stale read of any sensor refreshes every sensor of the FRU in one
+ * pipelined batch, so a sweep, or fscd reading a few fans, costs two
+ * expander requests for the DPB and one for the SCC instead of one per
+ * sensor. The lock keeps sensord, fscd and sensor-util from refreshing
+ * the same FRU at the same time.
+ */
+int pal_expander_sensor_check(uint8_t fru, uint8_t sensor_num) {
+  int ret, fd;
+  char key[MAX_KEY_LEN] = {0};
+  char path[64] = {0};
+  char tstr[MAX_VALUE_LEN] = {0};
+  struct timespec ts;
+  int tolerance = 0;
+  int sensor_cnt;
   uint8_t *sensor_list;
 
   switch(fru) {
     case FRU_DPB:
       sprintf(key, "dpb_sensor_timestamp");
+      sprintf(path, EXP_SENSOR_LOCK, "dpb");
       break;
     case FRU_SCC:
       sprintf(key, "scc_sensor_timestamp");
+      sprintf(path, EXP_SENSOR_LOCK, "scc");
       break;
     default:
       return -1;
   }
 
-  ret = pal_get_edb_value(key, cvalue);
-    if (ret < 0) {
-#ifdef DEBUG
-      syslog(LOG_WARNING, "pal_expander_sensor_check: pal_get_key_value failed for "
-          "fru %u", fru);
-#endif
-      return ret;
-    }
-
-  timestamp = atoi(cvalue);
-
-  clock_gettime(CLOCK_REALTIME, &ts);
-  sprintf(tstr, "%d", ts.tv_sec);
-  current_time = atoi(tstr);
-
-  //set 1 sec tolerance for Firsr Sensor Number, to avoid updating all FRU sensor when interval around 4.9999 second
+  //set 1 sec tolerance for First Sensor Number, so that a sweep refreshes the FRU at its start
   if (sensor_num == DPB_FIRST_SENSOR_NUM || sensor_num == SCC_FIRST_SENSOR_NUM) {
     tolerance = 1;
-    timestamp_flag = 1; //Update only after First sensor update
-    //Get FRU sensor list for update all sensor
-    ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
-      if (ret < 0) {
-        return ret;
-    }
   }
 
-  //timeout: 5 second, 1 second tolerance only for First sensor
-  if ( abs(current_time - timestamp) > (5 - tolerance) ) {
-    //SCC
-    switch(fru) {
-      case FRU_SCC:
-        ret = pal_exp_scc_read_sensor_wrapper(fru, sensor_list, sensor_cnt, sensor_num);
-        if (ret < 0) {
-          return ret;
-        }
-      break;
-      case FRU_DPB:
-      // DPB sensors are too much, needs twice ipmb commands
-        ret = pal_exp_dpb_read_sensor_wrapper(fru, sensor_list, MAX_EXP_IPMB_SENSOR_COUNT, sensor_num, 0);
-        if (ret < 0) {
-          return ret;
-        }
-        //DO the Second transaction only when sensor number is the first in DPB sensor list
-        if (sensor_num == DPB_FIRST_SENSOR_NUM) {
-          ret = pal_exp_dpb_read_sensor_wrapper(fru, sensor_list, (sensor_cnt - MAX_EXP_IPMB_SENSOR_COUNT), sensor_num, 1);
-          if (ret < 0) {
-            return ret;
-          }
-        }
-      break;
-    }
+  ret = pal_expander_sensor_stale(key, tolerance);
+  if (ret <= 0) {
+    return ret;
+  }
 
-    if (timestamp_flag) {
-      //update timestamp after Updated Expander sensor
+  fd = open(path, O_CREAT | O_RDWR, 0666);
+  if (fd < 0) {
+    return -1;
+  }
+  if (flock(fd, LOCK_EX)) {
+    syslog(LOG_WARNING, "%s(): failed to flock on %s. %s", __func__, path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  // Someone else may have refreshed the FRU while we waited for the lock
+  ret = pal_expander_sensor_stale(key, tolerance);
+  if (ret > 0) {
+    ret = pal_get_fru_sensor_list(fru, &sensor_list, &sensor_cnt);
+    if (ret == 0) {
+      ret = pal_exp_read_sensor_list(fru, sensor_list, sensor_cnt);
+
+      //update timestamp even if the expander failed, the sensors are NA until the next try
       clock_gettime(CLOCK_REALTIME, &ts);
-      sprintf(tstr, "%d", ts.tv_sec);
+      sprintf(tstr, "%ld", ts.tv_sec);
       pal_set_edb_value(key, tstr);
     }
   }
-  return 0;
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  return ret;
 }
 
-int
-pal_exp_dpb_read_sensor_wrapper(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, uint8_t sensor_num, int second_transaction) {
-  uint8_t tbuf[256] = {0x00};
-  uint8_t rbuf[256] = {0x00};
-  uint8_t rlen = 0;
-  uint8_t tlen = 0;
-  int ret, i = 0;
-  char key[MAX_KEY_LEN] = {0};
-  char str[MAX_VALUE_LEN] = {0};
+static void
+pal_exp_sensor_value(uint8_t fru, exp_sensor_t *sensor, char *str) {
   float value;
   char units[64];
-  int offset = 0; //sensor overload offset
-  int sku = 0;
+  uint8_t status;
 
-  if (second_transaction)
-    offset = MAX_EXP_IPMB_SENSOR_COUNT;
+  value = ((sensor->data1 << 8) + sensor->data2);
+  fbttn_sensor_units(fru, sensor->sensor_num, units);
 
-  //Fill up sensor number
-  if (sensor_num == DPB_FIRST_SENSOR_NUM) {
-    tbuf[0] = sensor_cnt;
-     for( i = 0 ; i < sensor_cnt; i++) {
-      tbuf[i+1] = sensor_list[i + offset];  //feed sensor number to tbuf
+  if (fru == FRU_DPB) {
+    if( strcmp(units,"C") == 0 ) {
+      value = sensor->data1;
     }
-    tlen = sensor_cnt + 1;
-  }
-  else {
-    sensor_cnt = 1;
-    tbuf[0] = sensor_cnt;
-    tbuf[1] = sensor_num;
-    tlen = 2;
-  }
-
-  //send tbuf with sensor count and numbers to get spcific sensor data from exp
-  ret = expander_ipmb_wrapper(NETFN_OEM_REQ, CMD_EXP_GET_SENSOR_READING, tbuf, tlen, rbuf, &rlen);
-  if (ret) {
-    #ifdef DEBUG
-      syslog(LOG_WARNING, "%s: expander_ipmb_wrapper failed.", __func__);
-    #endif
-
-    //if expander doesn't respond, set all sensors value to NA and save to cache
-    for(i = 0; i < sensor_cnt; i++) {
-      sprintf(key, "dpb_sensor%d", tbuf[i+1]);
-      sprintf(str, "NA");
-
-      if(edb_cache_set(key, str) < 0) {
-        #ifdef DEBUG
-          syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__ , key, str);
-        #endif
-      }
+    else if( sensor->sensor_num >= DPB_SENSOR_FAN1_FRONT && sensor->sensor_num <= DPB_SENSOR_FAN4_REAR ) {
+      value = value * 10;
     }
-    return ret;
-  }
-
-  for(i = 0; i < sensor_cnt; i++) {
-    if (rbuf[5*i+4] != 0) {
-      //if sensor status byte is not 0, means sensor reading is unavailable
-      sprintf(str, "NA");
+    else if( sensor->sensor_num == DPB_SENSOR_HSC_POWER || sensor->sensor_num == DPB_SENSOR_12V_POWER_CLIP ||
+             sensor->sensor_num == AIRFLOW ) {
+      // raw value
     }
     else {
-      // search the corresponding sensor table to fill up the raw data and status
-      // rbuf[5*i+1] sensor number
-      // rbuf[5*i+2] sensor raw data1
-      // rbuf[5*i+3] sensor raw data2
-      // rbuf[5*i+4] sensor status
-      // rbuf[5*i+5] reserved
-      fbttn_sensor_units(fru, rbuf[5*i+1], units);
-      if( strcmp(units,"C") == 0 ) {
-        value = rbuf[5*i+2];
-      }
-      else if( rbuf[5*i+1] >= DPB_SENSOR_FAN1_FRONT && rbuf[5*i+1] <= DPB_SENSOR_FAN4_REAR ) {
-        value =  (((rbuf[5*i+2] << 8) + rbuf[5*i+3]));
-        value = value * 10;
-      }
-      else if( rbuf[5*i+1] == DPB_SENSOR_HSC_POWER || rbuf[5*i+1] == DPB_SENSOR_12V_POWER_CLIP || (rbuf[5*i+1] == AIRFLOW) ) {
-        value =  (((rbuf[5*i+2] << 8) + rbuf[5*i+3]));
-      }
-      else {
-        value =  (((rbuf[5*i+2] << 8) + rbuf[5*i+3]));
-        value = value/100;
-      }
-
-      sprintf(str, "%.2f",(float)value);
+      value = value/100;
     }
-
-    //cache sensor reading
-    sprintf(key, "dpb_sensor%d", rbuf[5*i+1]);
-    if(edb_cache_set(key, str) < 0) {
-      #ifdef DEBUG
-        syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__ , key, str);
-      #endif
+  } else {
+    if( strcmp(units,"C") == 0 ) {
+      value = sensor->data1;
+    }
+    else if( strcmp(units,"Watts") != 0 ) {
+      value = value/100;
     }
   }
 
-  return 0;
+  sprintf(str, "%.2f",(float)value);
+
+  // SCC_IOC have to check if the server is on, if not shows "NA"
+  if (fru == FRU_SCC && sensor->sensor_num == SCC_SENSOR_IOC_TEMP) {
+    pal_get_server_power(FRU_SLOT1, &status);
+    if (status != SERVER_POWER_ON) {
+      strcpy(str, "NA");
+    }
+  }
 }
 
+/*
+ * Read the sensors of the DPB or the SCC and cache them. Sensors the
+ * expander did not answer, or reports unavailable, are cached as NA.
+ */
 int
-pal_exp_scc_read_sensor_wrapper(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, uint8_t sensor_num) {
-  uint8_t tbuf[256] = {0x00};
-  uint8_t rbuf[256] = {0x00};
-  uint8_t rlen = 0;
-  uint8_t tlen = 0;
-  int ret, i;
+pal_exp_read_sensor_list(uint8_t fru, uint8_t *sensor_list, int sensor_cnt) {
+  exp_sensor_t sensors[EXP_MAX_SENSOR_CNT];
   char key[MAX_KEY_LEN] = {0};
   char str[MAX_VALUE_LEN] = {0};
-  float value;
-  char units[64];
-  uint8_t status;
+  int ret, i;
 
-  tbuf[0] = sensor_cnt; //sensor_count
-  //Fill up sensor number
-  if (sensor_num ==  SCC_FIRST_SENSOR_NUM) {
-    for( i = 0 ; i < sensor_cnt; i++) {
-      tbuf[i+1] = sensor_list[i];  //feed sensor number to tbuf
-    }
+  if (fru != FRU_DPB && fru != FRU_SCC) {
+    return -1;
   }
-  else {
-    tbuf[1] = sensor_num;
+  if (sensor_cnt <= 0 || sensor_cnt > EXP_MAX_SENSOR_CNT) {
+    return -1;
   }
 
-  tlen = sensor_cnt + 1;
-
-  //send tbuf with sensor count and numbers to get spcific sensor data from exp
-  ret = expander_ipmb_wrapper(NETFN_OEM_REQ, CMD_EXP_GET_SENSOR_READING, tbuf, tlen, rbuf, &rlen);
+  ret = exp_read_sensor_list(sensor_list, sensor_cnt, sensors);
   if (ret) {
     #ifdef DEBUG
-      syslog(LOG_WARNING, "%s: expander_ipmb_wrapper failed.", __func__);
+      syslog(LOG_WARNING, "%s: exp_read_sensor_list failed.", __func__);
     #endif
-
-    //if expander doesn't respond, set all sensors value to NA and save to cache
-    for(i = 0; i < sensor_cnt; i++) {
-      sprintf(key, "scc_sensor%d", tbuf[i+1]);
-      sprintf(str, "NA");
-
-      if(edb_cache_set(key, str) < 0) {
-        #ifdef DEBUG
-          syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__ , key, str);
-        #endif
-      }
-    }
-    return ret;
   }
 
   for(i = 0; i < sensor_cnt; i++) {
-    if (rbuf[5*i+4] != 0) {
+    if (sensors[i].status != 0) {
       //if sensor status byte is not 0, means sensor reading is unavailable
       sprintf(str, "NA");
     }
     else {
-      // search the corresponding sensor table to fill up the raw data and status
-      // rbuf[5*i+1] sensor number
-      // rbuf[5*i+2] sensor raw data1
-      // rbuf[5*i+3] sensor raw data2
-      // rbuf[5*i+4] sensor status
-      // rbuf[5*i+5] reserved
-      fbttn_sensor_units(fru, rbuf[5*i+1], units);
-
-      if( strcmp(units,"C") == 0 ) {
-        value = rbuf[5*i+2];
-      }
-      else if( strcmp(units,"Watts") == 0 ) {
-        value = (((rbuf[5*i+2] << 8) + rbuf[5*i+3]));
-      }
-      else {
-        value = (((rbuf[5*i+2] << 8) + rbuf[5*i+3]));
-        value = value/100;
-      }
-
-      sprintf(str, "%.2f",(float)value);
-
-      // SCC_IOC have to check if the server is on, if not shows "NA"
-      if (rbuf[5*i+1] == SCC_SENSOR_IOC_TEMP) {
-        pal_get_server_power(FRU_SLOT1, &status);
-        if (status != SERVER_POWER_ON) {
-          strcpy(str, "NA");
-        }
-      }
+      pal_exp_sensor_value(fru, &sensors[i], str);
     }
 
     //cache sensor reading
-    sprintf(key, "scc_sensor%d", rbuf[5*i+1]);
+    sprintf(key, (fru == FRU_DPB) ? "dpb_sensor%d" : "scc_sensor%d", sensors[i].sensor_num);
     if(edb_cache_set(key, str) < 0) {
       #ifdef DEBUG
-        syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__, key, str);
+        syslog(LOG_WARNING, "%s: cache_set key = %s, str = %s failed.", __func__ , key, str);
       #endif
     }
   }
 
-  return 0;
+  return ret;
 }
 
 int  pal_get_bmc_rmt_hb(void) {
@@ -3824,8 +3733,13 @@ pal_set_power_restore_policy(uint8_t slot, uint8_t *pwr_policy, uint8_t *res_dat
   return completion_code;
 }
 
+/*
+ * Print the NVMe-MI data of a drive, read in one basic management
+ * transaction. drive tells apart the drives behind a mux on one bus, the
+ * data is kept for pal_drive_health() on the same drive.
+ */
 int
-pal_drive_status(const char* i2c_bus) {
+pal_drive_status(const char* i2c_bus, int drive) {
   ssd_data ssd;
   t_status_flags status_flag_decoding;
   t_smart_warning smart_warning_decoding;
@@ -3834,69 +3748,63 @@ pal_drive_status(const char* i2c_bus) {
   t_key_value_pair vendor_decoding;
   t_key_value_pair sn_decoding;
 
-  if (nvme_vendor_read_decode(i2c_bus, &ssd.vendor, &vendor_decoding))
-    printf("%s: Fail on reading Vendor ID\n", vendor_decoding.key);
-  else
-    printf("%s: %s\n", vendor_decoding.key, vendor_decoding.value);
+  if (nvme_mi_basic_read_cached(i2c_bus, drive, 0, &ssd)) {
+    printf("Vendor: Fail on reading Vendor ID\n");
+    printf("Serial Number: Fail on reading Serial Number\n");
+    printf("Composite Temperature: Fail on reading Composite Temperature\n");
+    printf("Percentage Drive Life Used: Fail on reading Percentage Drive Life Used\n");
+    printf("Status Flags: Fail on reading Status Flags\n");
+    printf("SMART Critical Warning: Fail on reading SMART Critical Warning\n");
+    printf("\n");
+    return 0;
+  }
 
-  if (nvme_serial_num_read_decode(i2c_bus, ssd.serial_num, MAX_SERIAL_NUM, &sn_decoding))
-    printf("%s: Fail on reading Serial Number\n", sn_decoding.key);
-  else
-    printf("%s: %s\n", sn_decoding.key, sn_decoding.value);
+  nvme_vendor_decode(ssd.vendor, &vendor_decoding);
+  printf("%s: %s\n", vendor_decoding.key, vendor_decoding.value);
 
-  if (nvme_temp_read_decode(i2c_bus, &ssd.temp, &temp_decoding))
-    printf("%s: Fail on reading Composite Temperature\n", temp_decoding.key);
-  else
-    printf("%s: %s\n", temp_decoding.key, temp_decoding.value);
+  nvme_serial_num_decode(ssd.serial_num, &sn_decoding);
+  printf("%s: %s\n", sn_decoding.key, sn_decoding.value);
 
-  if (nvme_pdlu_read_decode(i2c_bus, &ssd.pdlu, &pdlu_decoding))
-    printf("%s: Fail on reading Percentage Drive Life Used\n", pdlu_decoding.key);
-  else
-    printf("%s: %s\n", pdlu_decoding.key, pdlu_decoding.value);
+  nvme_temp_decode(ssd.temp, &temp_decoding);
+  printf("%s: %s\n", temp_decoding.key, temp_decoding.value);
 
-  if (nvme_sflgs_read_decode(i2c_bus, &ssd.sflgs, &status_flag_decoding))
-    printf("%s: Fail on reading Status Flags\n", status_flag_decoding.self.key);
-  else {
-    printf("%s: %s\n", status_flag_decoding.self.key, status_flag_decoding.self.value);
-    printf("    %s: %s\n", status_flag_decoding.read_complete.key, status_flag_decoding.read_complete.value);
-    printf("    %s: %s\n", status_flag_decoding.ready.key, status_flag_decoding.ready.value);
-    printf("    %s: %s\n", status_flag_decoding.functional.key, status_flag_decoding.functional.value);
-    printf("    %s: %s\n", status_flag_decoding.reset_required.key, status_flag_decoding.reset_required.value);
-    printf("    %s: %s\n", status_flag_decoding.port0_link.key, status_flag_decoding.port0_link.value);
-    printf("    %s: %s\n", status_flag_decoding.port1_link.key, status_flag_decoding.port1_link.value);
-  }
+  nvme_pdlu_decode(ssd.pdlu, &pdlu_decoding);
+  printf("%s: %s\n", pdlu_decoding.key, pdlu_decoding.value);
 
-  if (nvme_smart_warning_read_decode(i2c_bus, &ssd.warning, &smart_warning_decoding))
-    printf("%s: Fail on reading SMART Critical Warning\n", smart_warning_decoding.self.key);
-  else {
-    printf("%s: %s\n", smart_warning_decoding.self.key, smart_warning_decoding.self.value);
-    printf("    %s: %s\n", smart_warning_decoding.spare_space.key, smart_warning_decoding.spare_space.value);
-    printf("    %s: %s\n", smart_warning_decoding.temp_warning.key, smart_warning_decoding.temp_warning.value);
-    printf("    %s: %s\n", smart_warning_decoding.reliability.key, smart_warning_decoding.reliability.value);
-    printf("    %s: %s\n", smart_warning_decoding.media_status.key, smart_warning_decoding.media_status.value);
-    printf("    %s: %s\n", smart_warning_decoding.backup_device.key, smart_warning_decoding.backup_device.value);
-  }
+  nvme_sflgs_decode(ssd.sflgs, &status_flag_decoding);
+  printf("%s: %s\n", status_flag_decoding.self.key, status_flag_decoding.self.value);
+  printf("    %s: %s\n", status_flag_decoding.read_complete.key, status_flag_decoding.read_complete.value);
+  printf("    %s: %s\n", status_flag_decoding.ready.key, status_flag_decoding.ready.value);
+  printf("    %s: %s\n", status_flag_decoding.functional.key, status_flag_decoding.functional.value);
+  printf("    %s: %s\n", status_flag_decoding.reset_required.key, status_flag_decoding.reset_required.value);
+  printf("    %s: %s\n", status_flag_decoding.port0_link.key, status_flag_decoding.port0_link.value);
+  printf("    %s: %s\n", status_flag_decoding.port1_link.key, status_flag_decoding.port1_link.value);
+
+  nvme_smart_warning_decode(ssd.warning, &smart_warning_decoding);
+  printf("%s: %s\n", smart_warning_decoding.self.key, smart_warning_decoding.self.value);
+  printf("    %s: %s\n", smart_warning_decoding.spare_space.key, smart_warning_decoding.spare_space.value);
+  printf("    %s: %s\n", smart_warning_decoding.temp_warning.key, smart_warning_decoding.temp_warning.value);
+  printf("    %s: %s\n", smart_warning_decoding.reliability.key, smart_warning_decoding.reliability.value);
+  printf("    %s: %s\n", smart_warning_decoding.media_status.key, smart_warning_decoding.media_status.value);
+  printf("    %s: %s\n", smart_warning_decoding.backup_device.key, smart_warning_decoding.backup_device.value);
 
   printf("\n");
   return 0;
 }
 
 int
-pal_drive_health(const char* dev) {
-  uint8_t sflgs;
-  uint8_t warning;
+pal_drive_health(const char* dev, int drive) {
+  ssd_data ssd;
 
-  if (nvme_smart_warning_read(dev, &warning))
+  // Reuses the data of a pal_drive_status() call just before
+  if (nvme_mi_basic_read_cached(dev, drive, NVME_DATA_MAX_AGE_MS, &ssd))
     return -1;
-  else
-    if ((warning & NVME_SMART_WARNING_MASK_BIT) != NVME_SMART_WARNING_MASK_BIT)
-      return -1;
 
-  if (nvme_sflgs_read(dev, &sflgs))
+  if ((ssd.warning & NVME_SMART_WARNING_MASK_BIT) != NVME_SMART_WARNING_MASK_BIT)
+    return -1;
+
+  if ((ssd.sflgs & NVME_SFLGS_MASK_BIT) != NVME_SFLGS_CHECK_VALUE)
     return -1;
-  else
-    if ((sflgs & NVME_SFLGS_MASK_BIT) != NVME_SFLGS_CHECK_VALUE)
-      return -1;
 
   return 0;
 }
@@ -58,7 +58,7 @@ extern "C" {
 //Expander
 #define SCC_FIRST_SENSOR_NUM 96 //Expander_TEMP 0x60
 #define DPB_FIRST_SENSOR_NUM 24 //P3V3_SENSE  0x18
-#define MAX_EXP_IPMB_SENSOR_COUNT 40
+#define EXP_SENSOR_LOCK "/tmp/%s_sensor.lock"
 
 #define ERROR_CODE_NUM 32
 
@@ -292,8 +292,7 @@ int pal_get_pwm_value(uint8_t fan_num, uint8_t *value);
 int pal_fan_dead_handle(int fan_num);
 int pal_fan_recovered_handle(int fan_num);
 int pal_expander_sensor_check(uint8_t fru, uint8_t sensor_num);
-int pal_exp_scc_read_sensor_wrapper(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, uint8_t sensor_num);
-int pal_exp_dpb_read_sensor_wrapper(uint8_t fru, uint8_t *sensor_list, int sensor_cnt, uint8_t sensor_num, int second_transaction);
+int pal_exp_read_sensor_list(uint8_t fru, uint8_t *sensor_list, int sensor_cnt);
 int pal_get_bmc_rmt_hb(void);
 int pal_get_scc_loc_hb(void);
 int pal_get_scc_rmt_hb(void);
@@ -330,6 +329,8 @@ void pal_rm_powering_on_flag(uint8_t slot_id);
 int pal_is_bic_ready(uint8_t slot_id, uint8_t *status);
 int pal_get_iom_ioc_ver(uint8_t *ver);
 void pal_power_policy_control(uint8_t fru, char *last_ps);
+int pal_drive_status(const char* i2c_bus, int drive);
+int pal_drive_health(const char* dev, int drive);
 
 
 #ifdef __cplusplus
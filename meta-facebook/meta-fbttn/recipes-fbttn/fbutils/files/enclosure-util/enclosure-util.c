@@ -135,14 +135,14 @@ show_drive_health() {
   int ret;
   
   /* read NVMe-MI data */  
-  ret = pal_drive_health(I2C_DEV_FLASH7);
+  ret = pal_drive_health(I2C_DEV_FLASH7, 0);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): bus7, pal_drive_health failed", __func__);
   }
   printf("flash-1: %s\n", (ret == 0) ? "Normal":"Abnormal");
 
   /* read NVMe-MI data */  
-  ret = pal_drive_health(I2C_DEV_FLASH8);
+  ret = pal_drive_health(I2C_DEV_FLASH8, 0);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): bus8, pal_drive_health failed 8", __func__);
   }
@@ -156,14 +156,14 @@ show_drive_status() {
 
   /* read NVMe-MI data */
   printf("flash-1:\n");
-  ret = pal_drive_status(I2C_DEV_FLASH7);
+  ret = pal_drive_status(I2C_DEV_FLASH7, 0);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): pal_drive_status failed 7", __func__);
   }
 
   /* read NVMe-MI data */
   printf("flash-2:\n");
-  ret = pal_drive_status(I2C_DEV_FLASH8);
+  ret = pal_drive_status(I2C_DEV_FLASH8, 0);
   if(ret < 0) {
     syslog(LOG_DEBUG, "%s(): pal_drive_status failed 8", __func__);
   }
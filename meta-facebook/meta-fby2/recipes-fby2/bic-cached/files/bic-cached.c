@@ -17,26 +17,77 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+/*
+ * Caches the SDR and FRUID of the servers for sensord and the FRU tools.
+ *
+ * The SDR of a BIC is kept in SDR_CACHE_DIR along with the key it was read
+ * under: the BIC firmware revision and the SDR repository record count and
+ * add/erase timestamps. Get Device ID and Get SDR Repository Info tell if
+ * the cache is still good; if so it is copied to /tmp without reading any
+ * record. When only records were added, the records already cached are
+ * kept and only the record headers are read to walk the repository.
+ * Records are read whole, or in the largest pieces the BIC returns.
+ *
+ * eg: bic-cached 1 2 3 4
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <errno.h>
 #include <syslog.h>
 #include <string.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/file.h>
 #include <openbmc/ipmi.h>
 #include <openbmc/ipmb.h>
+#include <openbmc/pal.h>
 #include <facebook/bic.h>
 
 #define LAST_RECORD_ID 0xFFFF
 #define MAX_SENSOR_NUM 0xFF
 #define BYTES_ENTIRE_RECORD 0xFF
 
+#ifndef SDR_CACHE_DIR
+#define SDR_CACHE_DIR "/mnt/data/bic-cached"
+#endif
+
+#define SDR_CACHE_MAGIC 0x52445342  // "BSDR"
+#define SDR_HDR_SIZE 5
+#define SDR_READ_COUNT_MIN 0x1A     // what libbic reads per request
+#define SDR_MAX_RECORDS 0x200
+#define SDR_RSV_RETRIES 3
+
+#pragma pack(push, 1)
+typedef struct {
+  uint32_t magic;
+  uint8_t fw_rev1;
+  uint8_t fw_rev2;
+  uint8_t aux_fw_rev[4];
+  uint16_t rec_count;
+  uint8_t add_ts[4];
+  uint8_t erase_ts[4];
+  uint16_t count;       // records following the key in the cache file
+} sdr_cache_key_t;
+#pragma pack(pop)
+
+typedef struct {
+  uint8_t slot_id;
+  uint16_t rsv_id;
+  bool whole;           // the BIC returns whole records in one read
+  int read_max;         // partial read size in use
+  int read_ok;          // largest partial read the BIC returned
+  int read_bad;         // smallest partial read the BIC refused
+  uint32_t xfers;
+} sdr_ctx_t;
+
 int
 fruid_cache_init(uint8_t slot_id) {
   // Initialize Slot0's fruid
@@ -58,90 +109,391 @@ fruid_cache_init(uint8_t slot_id) {
   return ret;
 }
 
-void
-sdr_cache_init(uint8_t slot_id) {
+static long long
+now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Get SDR, renewing the reservation when the BIC cancelled it
+static int
+sdr_read(sdr_ctx_t *ctx, uint16_t rec_id, uint8_t offset, uint8_t nbytes,
+         ipmi_sel_sdr_res_t *res, uint8_t *rlen) {
+  ipmi_sel_sdr_req_t req;
+  int retry = 0;
   int ret;
-  int fd;
-  uint8_t rlen;
+
+  while (1) {
+    req.rsv_id = ctx->rsv_id;
+    req.rec_id = rec_id;
+    req.offset = offset;
+    req.nbytes = nbytes;
+    ctx->xfers++;
+    ret = bic_get_sdr_part(ctx->slot_id, &req, res, rlen);
+    if (ret != CC_SDR_RSV_CANCELLED || retry++ >= SDR_RSV_RETRIES) {
+      break;
+    }
+    ctx->xfers++;
+    if (bic_get_sdr_rsv(ctx->slot_id, &ctx->rsv_id)) {
+      return -1;
+    }
+  }
+
+  if (ret == 0 && *rlen < sizeof(res->next_rec_id)) {
+    return -1;
+  }
+  return ret;
+}
+
+static const sdr_full_t *
+sdr_find(const sdr_full_t *recs, int count, const uint8_t *hdr) {
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (!memcmp(&recs[i], hdr, SDR_HDR_SIZE)) {
+      return &recs[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Read the record rec_id into sdr. If base is given, the record is taken
+ * from it when a record with the same header is there.
+ */
+static int
+sdr_read_rec(sdr_ctx_t *ctx, uint16_t rec_id, sdr_full_t *sdr, uint16_t *next_rec_id,
+             const sdr_full_t *base, int base_count, bool *reused) {
   uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t rec[SDR_HDR_SIZE + 0xFF] = {0};
+  ipmi_sel_sdr_res_t *res = (ipmi_sel_sdr_res_t *) rbuf;
+  const sdr_full_t *cached;
+  uint8_t rlen = 0;
+  int len, offset, n;
+  int ret;
+
+  *reused = false;
+
+  if (base == NULL && ctx->whole) {
+    ret = sdr_read(ctx, rec_id, 0, BYTES_ENTIRE_RECORD, res, &rlen);
+    if (ret == 0) {
+      *next_rec_id = res->next_rec_id;
+      len = rlen - sizeof(res->next_rec_id);
+      memset(sdr, 0, sizeof(sdr_full_t));
+      memcpy(sdr, res->data, len < sizeof(sdr_full_t) ? len : sizeof(sdr_full_t));
+      return 0;
+    }
+    if (ret != CC_SDR_CANNOT_RETURN) {
+      return -1;
+    }
+    ctx->whole = false;
+  }
+
+  // The header tells the length of the record
+  ret = sdr_read(ctx, rec_id, 0, SDR_HDR_SIZE, res, &rlen);
+  if (ret || rlen != sizeof(res->next_rec_id) + SDR_HDR_SIZE) {
+    return -1;
+  }
+  *next_rec_id = res->next_rec_id;
+  memcpy(rec, res->data, SDR_HDR_SIZE);
+
+  cached = base ? sdr_find(base, base_count, rec) : NULL;
+  if (cached) {
+    memcpy(sdr, cached, sizeof(sdr_full_t));
+    *reused = true;
+    return 0;
+  }
+
+  // Use a reservation for the partial reads of the body
+  if (ctx->rsv_id == 0) {
+    ctx->xfers++;
+    if (bic_get_sdr_rsv(ctx->slot_id, &ctx->rsv_id)) {
+      return -1;
+    }
+  }
+
+  len = rec[4];
+  offset = SDR_HDR_SIZE;
+  while (len > 0) {
+    n = (len > ctx->read_max) ? ctx->read_max : len;
+    ret = sdr_read(ctx, rec_id, offset, n, res, &rlen);
+    // Bisect for the largest read the BIC returns
+    if (ret == CC_SDR_CANNOT_RETURN && n > ctx->read_ok) {
+      ctx->read_bad = n;
+      ctx->read_max = (ctx->read_ok + ctx->read_bad) / 2;
+      continue;
+    }
+    if (ret || rlen <= sizeof(res->next_rec_id)) {
+      return -1;
+    }
+    if (n > ctx->read_ok) {
+      ctx->read_ok = n;
+    }
+    if (n == ctx->read_max && ctx->read_bad - n > 1) {
+      ctx->read_max = (n + ctx->read_bad) / 2;
+    }
+    n = rlen - sizeof(res->next_rec_id);
+    if (n > len) {
+      n = len;
+    }
+    memcpy(&rec[offset], res->data, n);
+    offset += n;
+    len -= n;
+  }
+
+  memcpy(sdr, rec, sizeof(sdr_full_t));
+  return 0;
+}
+
+static void
+sdr_cache_path(char *path, size_t size, uint8_t slot_id) {
+
+  snprintf(path, size, "%s/sdr_slot%d.bin", SDR_CACHE_DIR, slot_id);
+}
+
+// Load the persistent cache of the slot, returns the number of records
+static int
+sdr_cache_load(uint8_t slot_id, sdr_cache_key_t *key, sdr_full_t **recs) {
+  char path[128];
+  size_t size;
+  int fd;
+
+  *recs = NULL;
+  sdr_cache_path(path, sizeof(path), slot_id);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (read(fd, key, sizeof(*key)) != sizeof(*key) ||
+      key->magic != SDR_CACHE_MAGIC || key->count > SDR_MAX_RECORDS) {
+    goto error_exit;
+  }
+  size = key->count * sizeof(sdr_full_t);
+  *recs = malloc(size ? size : 1);
+  if (*recs == NULL || read(fd, *recs, size) != size) {
+    goto error_exit;
+  }
+
+  close(fd);
+  return key->count;
+
+error_exit:
+  free(*recs);
+  *recs = NULL;
+  close(fd);
+  return -1;
+}
+
+static int
+sdr_cache_store(uint8_t slot_id, sdr_cache_key_t *key, const sdr_full_t *recs) {
+  char path[128];
+  char temp_path[136];
+  size_t size = key->count * sizeof(sdr_full_t);
+  int fd, ret = 0;
+
+  mkdir(SDR_CACHE_DIR, 0755);
+  sdr_cache_path(path, sizeof(path), slot_id);
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    syslog(LOG_WARNING, "%s: open fails for path: %s\n", __func__, temp_path);
+    return -1;
+  }
+  if (write(fd, key, sizeof(*key)) != sizeof(*key) ||
+      write(fd, recs, size) != size || fsync(fd)) {
+    ret = -1;
+  }
+  close(fd);
+
+  if (ret || rename(temp_path, path)) {
+    syslog(LOG_WARNING, "%s: failed to write %s\n", __func__, path);
+    unlink(temp_path);
+    return -1;
+  }
+  return 0;
+}
+
+// Put the SDR in place for sensord
+static int
+sdr_install(uint8_t slot_id, const sdr_full_t *recs, int count) {
+  int ret;
+  int fd;
   char *path = NULL;
   char sdr_temp_path[64] = {0};
   char sdr_path[64] = {0};
+  size_t size = count * sizeof(sdr_full_t);
 
   sprintf(sdr_temp_path, "/tmp/tsdr_slot%d.bin", slot_id);
   sprintf(sdr_path, "/tmp/sdr_slot%d.bin", slot_id);
 
-  ipmi_sel_sdr_req_t req;
-  ipmi_sel_sdr_res_t *res = (ipmi_sel_sdr_res_t *) rbuf;
-
-  req.rsv_id = 0;
-  req.rec_id = 0;
-  req.offset = 0;
-  req.nbytes = BYTES_ENTIRE_RECORD;
-
-  // Read Slot0's SDR records and store
   path = sdr_temp_path;
   unlink(path);
   fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0666);
   if (fd < 0) {
     syslog(LOG_WARNING, "%s: open fails for path: %s\n", __func__, path);
-    return;
+    return -1;
   }
 
   ret = pal_flock_retry(fd);
   if (ret == -1) {
    syslog(LOG_WARNING, "%s: failed to flock on %s", __func__, path);
    close(fd);
-   return;
+   return -1;
   }
 
-  while (1) {
-    ret = bic_get_sdr(slot_id, &req, res, &rlen);
-    if (ret) {
-      syslog(LOG_WARNING, "%s: bic_get_sdr returns %d\n", __func__, ret);
-      continue;
-    }
-
-    sdr_full_t *sdr = res->data;
-
-    write(fd, sdr, sizeof(sdr_full_t));
-
-    req.rec_id = res->next_rec_id;
-    if (req.rec_id == LAST_RECORD_ID) {
-      // syslog(LOG_INFO, "This record is LAST record\n");
-      break;
-    }
+  if (write(fd, recs, size) != size) {
+    syslog(LOG_WARNING, "%s: write fails for path: %s\n", __func__, path);
   }
 
   ret = pal_unflock_retry(fd);
   if (ret == -1) {
    syslog(LOG_WARNING, "%s: failed to unflock on %s", __func__, path);
    close(fd);
-   return;
+   return -1;
   }
 
   close(fd);
+  // sensord waits for the rename
   rename(sdr_temp_path, sdr_path);
+  return 0;
+}
+
+static int
+sdr_get_key(sdr_ctx_t *ctx, sdr_cache_key_t *key) {
+  ipmi_dev_id_t id;
+  ipmi_sel_sdr_info_t info;
+
+  ctx->xfers += 2;
+  if (bic_get_dev_id(ctx->slot_id, &id) || bic_get_sdr_info(ctx->slot_id, &info)) {
+    return -1;
+  }
+
+  memset(key, 0, sizeof(*key));
+  key->magic = SDR_CACHE_MAGIC;
+  key->fw_rev1 = id.fw_rev1;
+  key->fw_rev2 = id.fw_rev2;
+  memcpy(key->aux_fw_rev, id.aux_fw_rev, sizeof(key->aux_fw_rev));
+  key->rec_count = info.rec_count;
+  memcpy(key->add_ts, info.add_ts, sizeof(key->add_ts));
+  memcpy(key->erase_ts, info.erase_ts, sizeof(key->erase_ts));
+  return 0;
+}
+
+// Same firmware and nothing erased since: the cached records are still valid
+static bool
+sdr_key_base(const sdr_cache_key_t *a, const sdr_cache_key_t *b) {
+
+  return a->fw_rev1 == b->fw_rev1 && a->fw_rev2 == b->fw_rev2 &&
+         !memcmp(a->aux_fw_rev, b->aux_fw_rev, sizeof(a->aux_fw_rev)) &&
+         !memcmp(a->erase_ts, b->erase_ts, sizeof(a->erase_ts));
+}
+
+static bool
+sdr_key_match(const sdr_cache_key_t *a, const sdr_cache_key_t *b) {
+
+  return sdr_key_base(a, b) && a->rec_count == b->rec_count &&
+         !memcmp(a->add_ts, b->add_ts, sizeof(a->add_ts));
+}
+
+static int
+sdr_fetch(sdr_ctx_t *ctx, sdr_full_t *recs, const sdr_full_t *base, int base_count, int *reused) {
+  uint16_t rec_id = 0;
+  uint16_t next_rec_id;
+  int count = 0;
+  bool hit;
+
+  *reused = 0;
+  ctx->rsv_id = 0;
+  while (count < SDR_MAX_RECORDS) {
+    if (sdr_read_rec(ctx, rec_id, &recs[count], &next_rec_id, base, base_count, &hit)) {
+      syslog(LOG_WARNING, "%s: slot%d failed to read record 0x%x\n", __func__, ctx->slot_id, rec_id);
+      return -1;
+    }
+    count++;
+    if (hit) {
+      (*reused)++;
+    }
+
+    rec_id = next_rec_id;
+    if (rec_id == LAST_RECORD_ID) {
+      return count;
+    }
+  }
+
+  syslog(LOG_WARNING, "%s: slot%d has more than %d records\n", __func__, ctx->slot_id, SDR_MAX_RECORDS);
+  return -1;
 }
 
 int
-main (int argc, char * const argv[])
-{
-  int ret;
-  uint8_t slot_id;
-  uint8_t self_test_result[2]={0};
-  int retry = 0;
-  int max_retry = 3;
+sdr_cache_init(uint8_t slot_id) {
+  sdr_ctx_t ctx = {
+    .slot_id = slot_id,
+    .whole = true,
+    .read_max = BYTES_ENTIRE_RECORD - 1,
+    .read_ok = SDR_READ_COUNT_MIN,
+    .read_bad = BYTES_ENTIRE_RECORD,
+  };
+  sdr_cache_key_t key, cached_key;
+  sdr_full_t *cached = NULL;
+  sdr_full_t *recs = NULL;
+  long long start = now_ms();
+  int cached_count, count, reused = 0;
+  int ret = -1;
 
-  if (argc != 2) {
+  if (sdr_get_key(&ctx, &key)) {
+    syslog(LOG_WARNING, "%s: slot%d failed to get the SDR key\n", __func__, slot_id);
     return -1;
   }
 
-  slot_id = atoi(argv[1]);
+  cached_count = sdr_cache_load(slot_id, &cached_key, &cached);
+  if (cached_count >= 0 && sdr_key_match(&key, &cached_key)) {
+    ret = sdr_install(slot_id, cached, cached_count);
+    syslog(LOG_INFO, "slot%d: SDR cache is valid, %d records, %u requests, %lld ms\n",
+           slot_id, cached_count, ctx.xfers, now_ms() - start);
+    free(cached);
+    return ret;
+  }
+  if (cached_count >= 0 && !sdr_key_base(&key, &cached_key)) {
+    free(cached);
+    cached = NULL;
+    cached_count = 0;
+  }
+
+  recs = calloc(SDR_MAX_RECORDS, sizeof(sdr_full_t));
+  if (recs == NULL) {
+    free(cached);
+    return -1;
+  }
+
+  count = sdr_fetch(&ctx, recs, cached, cached_count, &reused);
+  if (count >= 0) {
+    key.count = count;
+    sdr_cache_store(slot_id, &key, recs);
+    ret = sdr_install(slot_id, recs, count);
+    syslog(LOG_INFO, "slot%d: SDR cache updated, %d records (%d kept), %u requests, %lld ms\n",
+           slot_id, count, reused, ctx.xfers, now_ms() - start);
+  }
+
+  free(recs);
+  free(cached);
+  return ret;
+}
+
+static void *
+slot_cache_init(void *arg) {
+  uint8_t slot_id = (uint8_t)(uintptr_t)arg;
+  uint8_t self_test_result[2]={0};
+  int ret;
+  int retry = 0;
+  int max_retry = 3;
 
   // Check BIC Self Test Result
   do {
-    ret = bic_get_self_test_result(slot_id, &self_test_result);
+    ret = bic_get_self_test_result(slot_id, self_test_result);
     if (ret == 0) {
       syslog(LOG_INFO, "bic_get_self_test_result: %X %X\n", self_test_result[0], self_test_result[1]);
       break;
@@ -149,6 +501,11 @@ main (int argc, char * const argv[])
     sleep(5);
   } while (ret != 0);
 
+  // Sensor monitoring waits on the SDR, get it first
+  while (sdr_cache_init(slot_id) != 0) {
+    sleep(1);
+  }
+
   // Get Server FRU
   do {
     if (fruid_cache_init(slot_id) == 0)
@@ -161,7 +518,34 @@ main (int argc, char * const argv[])
   if (retry == max_retry)
     syslog(LOG_CRIT, "Fail on getting Server FRU.");
 
-  sdr_cache_init(slot_id);
+  return NULL;
+}
+
+int
+main (int argc, char * const argv[])
+{
+  pthread_t tid[FRU_SLOT4];
+  int slot_id;
+  int i, n = 0;
+
+  if (argc < 2 || argc > FRU_SLOT4 + 1) {
+    return -1;
+  }
+
+  // The slots are on their own IPMB buses, cache them concurrently
+  for (i = 1; i < argc; i++) {
+    slot_id = atoi(argv[i]);
+    if (slot_id < FRU_SLOT1 || slot_id > FRU_SLOT4) {
+      return -1;
+    }
+    if (pthread_create(&tid[n], NULL, slot_cache_init, (void *)(uintptr_t)slot_id) == 0) {
+      n++;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    pthread_join(tid[i], NULL);
+  }
 
   return 0;
 }
@@ -16,23 +16,15 @@
 echo -n "Setup Caching for Bridge IC info.."
 #Get slot type (0:TwinLakes, 1:Crace Flat, 2:Glacier Point 3:Empty Slot)
 #get_slot_type is to get slot type to check if the slot type is server
-if [[ $(is_server_prsnt 1) == "1" && $(get_slot_type 1) == "0" ]]; then
-  /usr/local/bin/bic-cached 1 > /dev/null 2>&1 &
-fi
-#Get slot type (0:TwinLakes, 1:Crace Flat, 2:Glacier Point 3:Empty Slot)
-#get_slot_type is to get slot type to check if the slot type is server
-if [[ $(is_server_prsnt 2) == "1" && $(get_slot_type 2) == "0" ]]; then
-  /usr/local/bin/bic-cached 2 > /dev/null 2>&1 &
-fi
-#Get slot type (0:TwinLakes, 1:Crace Flat, 2:Glacier Point 3:Empty Slot)
-#get_slot_type is to get slot type to check if the slot type is server
-if [[ $(is_server_prsnt 3) == "1" && $(get_slot_type 3) == "0" ]]; then
-  /usr/local/bin/bic-cached 3 > /dev/null 2>&1 &
-fi
-#Get slot type (0:TwinLakes, 1:Crace Flat, 2:Glacier Point 3:Empty Slot)
-#get_slot_type is to get slot type to check if the slot type is server
-if [[ $(is_server_prsnt 4) == "1" && $(get_slot_type 4) == "0" ]]; then
-  /usr/local/bin/bic-cached 4 > /dev/null 2>&1 &
+SLOTS=""
+for i in 1 2 3 4; do
+  if [[ $(is_server_prsnt $i) == "1" && $(get_slot_type $i) == "0" ]]; then
+    SLOTS="$SLOTS $i"
+  fi
+done
+#One bic-cached caches all the servers concurrently
+if [ -n "$SLOTS" ]; then
+  /usr/local/bin/bic-cached $SLOTS > /dev/null 2>&1 &
 fi
 
 echo "done."
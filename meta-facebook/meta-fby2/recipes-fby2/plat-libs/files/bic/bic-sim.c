@@ -0,0 +1,608 @@
+/*
+ * bic-sim
+ *
+ * Copyright 2018-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Bridge-IC simulator for testing libbic without hardware. It listens on
+ * the ipmbd socket of each slot's bus and answers the requests libbic
+ * sends through libipmb: BIOS Update Firmware with per-64KB-block erase,
+ * Get Firmware Checksum and Get Sensor Reading, and
+ * the Get Self Test Results, Get Device ID, SDR and FRUID requests
+ * bic-cached sends. Like ipmbd, every connection gets its own thread
+ * while the BIC handles one request at a time.
+ *
+ * Given a BIOS image, it updates all simulated slots at once with
+ * bic_update_fw_window() and checks the simulated flash against the
+ * image. Without one, it keeps serving until killed and then prints the
+ * number of requests each slot served.
+ *
+ * Build on a development host with "make bic-sim" and stop ipmbd first
+ * when running on a BMC, as the socket paths are the same.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "bic.h"
+
+#define SIM_FLASH_SIZE (32*1024*1024)
+#define SIM_ERASE_SIZE (64*1024)
+#define SIZE_IANA_ID 3
+#define SIM_FRU_SIZE 0xF0
+#define SIM_SDR_TS 0x5A000000
+
+typedef struct {
+  uint8_t slot_id;
+  int bus_id;
+  int sock;
+  pthread_mutex_t bus;      // one transfer at a time on the I2C bus
+  pthread_mutex_t lock;     // the BIC serves one request at a time
+  uint8_t *flash;
+  bool *erased;
+  int corrupt_block;        // block whose next write is corrupted, -1 none
+  uint32_t writes;
+  uint32_t erases;
+  uint32_t cksums;
+  int update_ret;
+  sdr_full_t *sdr;
+  uint16_t rsv_id;
+  uint32_t sdr_reads;
+  uint32_t requests;
+} sim_bic_t;
+
+typedef struct {
+  sim_bic_t *bic;
+  int fd;
+} sim_conn_t;
+
+static sim_bic_t g_bic[MAX_NUM_FRUS];
+static int g_nslots = 4;
+static int g_byte_us = 10;      // I2C transfer time per byte (1MHz)
+static int g_cmd_us = 500;      // per request processing
+static int g_erase_ms = 20;     // per block erase
+static int g_cksum_ms = 5;      // per checksum
+static uint8_t g_window = BIC_UPDATE_WINDOW;
+static int g_sdr_count = 64;    // SDR records of each slot
+static int g_sdr_read_max = 0xFF; // largest Get SDR partial read answered
+static int g_rsv_every = 0;     // cancel the SDR reservation every N reads
+static uint8_t g_fw_rev = 1;
+static const char *g_image;
+
+static const int bus_of_slot[] = { 0, IPMB_BUS_SLOT1, IPMB_BUS_SLOT2, IPMB_BUS_SLOT3, IPMB_BUS_SLOT4 };
+
+static void
+sim_sleep_us(long us) {
+  struct timespec req;
+
+  req.tv_sec = us / 1000000;
+  req.tv_nsec = (us % 1000000) * 1000;
+  while (nanosleep(&req, &req) == -1 && errno == EINTR) {
+    continue;
+  }
+}
+
+static long long
+sim_now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+get_u32(uint8_t *buf) {
+  return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void
+put_u32(uint8_t *buf, uint32_t val) {
+  buf[0] = val & 0xFF;
+  buf[1] = (val >> 8) & 0xFF;
+  buf[2] = (val >> 16) & 0xFF;
+  buf[3] = (val >> 24) & 0xFF;
+}
+
+static uint8_t
+sim_storage(sim_bic_t *bic, uint8_t cmd, uint8_t *req, int req_len,
+            uint8_t *data, int *data_len) {
+  ipmi_sel_sdr_info_t *info;
+  ipmi_sel_sdr_req_t sreq;
+  uint8_t *rec;
+  uint16_t next;
+  int idx, rec_len, n, i;
+
+  switch (cmd) {
+    case CMD_STORAGE_GET_SDR_INFO:
+      info = (ipmi_sel_sdr_info_t *)data;
+      memset(info, 0, sizeof(*info));
+      info->ver = 0x51;
+      info->rec_count = g_sdr_count;
+      info->free_space = 0xFFFF;
+      put_u32(info->add_ts, SIM_SDR_TS + g_sdr_count);
+      put_u32(info->erase_ts, SIM_SDR_TS);
+      *data_len = sizeof(*info);
+      return CC_SUCCESS;
+
+    case CMD_STORAGE_RSV_SDR:
+      if (++bic->rsv_id == 0) {
+        bic->rsv_id = 1;
+      }
+      memcpy(data, &bic->rsv_id, sizeof(bic->rsv_id));
+      *data_len = sizeof(bic->rsv_id);
+      return CC_SUCCESS;
+
+    case CMD_STORAGE_GET_SDR:
+      if (req_len < sizeof(sreq)) {
+        return CC_INVALID_LENGTH;
+      }
+      memcpy(&sreq, req, sizeof(sreq));
+      bic->sdr_reads++;
+      if (g_rsv_every && (bic->sdr_reads % g_rsv_every) == 0) {
+        bic->rsv_id++;
+      }
+      idx = sreq.rec_id ? sreq.rec_id - 1 : 0;
+      if (idx >= g_sdr_count) {
+        return CC_PARAM_OUT_OF_RANGE;
+      }
+      // Partial reads need the current reservation
+      if (sreq.offset && sreq.rsv_id != bic->rsv_id) {
+        return CC_SDR_RSV_CANCELLED;
+      }
+      rec = (uint8_t *)&bic->sdr[idx];
+      rec_len = 5 + bic->sdr[idx].len;
+      if (sreq.offset > rec_len) {
+        return CC_PARAM_OUT_OF_RANGE;
+      }
+      n = rec_len - sreq.offset;
+      if (sreq.nbytes != 0xFF && sreq.nbytes < n) {
+        n = sreq.nbytes;
+      }
+      if (n > g_sdr_read_max) {
+        return CC_SDR_CANNOT_RETURN;
+      }
+      next = (idx + 1 < g_sdr_count) ? idx + 2 : 0xFFFF;
+      memcpy(data, &next, sizeof(next));
+      memcpy(&data[sizeof(next)], &rec[sreq.offset], n);
+      *data_len = sizeof(next) + n;
+      return CC_SUCCESS;
+
+    case CMD_STORAGE_GET_FRUID_INFO:
+      data[0] = SIM_FRU_SIZE;
+      data[1] = 0;
+      data[2] = 0;
+      *data_len = 3;
+      return CC_SUCCESS;
+
+    case CMD_STORAGE_READ_FRUID_DATA:
+      if (req_len < 4) {
+        return CC_INVALID_LENGTH;
+      }
+      idx = req[1] | (req[2] << 8);
+      n = req[3];
+      if (idx > SIM_FRU_SIZE) {
+        return CC_PARAM_OUT_OF_RANGE;
+      }
+      if (idx + n > SIM_FRU_SIZE) {
+        n = SIM_FRU_SIZE - idx;
+      }
+      data[0] = n;
+      for (i = 0; i < n; i++) {
+        data[1 + i] = (idx + i) ^ bic->slot_id;
+      }
+      *data_len = 1 + n;
+      return CC_SUCCESS;
+  }
+
+  return CC_INVALID_CMD;
+}
+
+// Handle one request, filling data and returning the completion code
+static uint8_t
+sim_handle(sim_bic_t *bic, uint8_t netfn, uint8_t cmd, uint8_t *req, int req_len,
+           uint8_t *data, int *data_len) {
+  uint32_t offset, len, cksum, i;
+
+  *data_len = 0;
+
+  if (netfn == NETFN_SENSOR_REQ && cmd == CMD_SENSOR_GET_SENSOR_READING) {
+    if (req_len < 1) {
+      return CC_INVALID_LENGTH;
+    }
+    data[0] = 0x20 + req[0];  // value
+    data[1] = 0xC0;           // scanning enabled
+    data[2] = 0x00;
+    data[3] = 0x00;
+    *data_len = 4;
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_APP_REQ && cmd == CMD_APP_GET_SELFTEST_RESULTS) {
+    data[0] = 0x55;           // no error
+    data[1] = 0x00;
+    *data_len = 2;
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_APP_REQ && cmd == CMD_APP_GET_DEVICE_ID) {
+    ipmi_dev_id_t *id = (ipmi_dev_id_t *)data;
+
+    memset(id, 0, sizeof(*id));
+    id->dev_id = 0x20;
+    id->fw_rev1 = g_fw_rev;
+    id->ipmi_ver = 0x02;
+    *data_len = sizeof(*id);
+    return CC_SUCCESS;
+  }
+
+  if (netfn == NETFN_STORAGE_REQ) {
+    return sim_storage(bic, cmd, req, req_len, data, data_len);
+  }
+
+  if (netfn != NETFN_OEM_1S_REQ || req_len < SIZE_IANA_ID) {
+    return CC_INVALID_CMD;
+  }
+  memcpy(data, req, SIZE_IANA_ID);
+  *data_len = SIZE_IANA_ID;
+  req += SIZE_IANA_ID;
+  req_len -= SIZE_IANA_ID;
+
+  switch (cmd) {
+    case CMD_OEM_1S_UPDATE_FW:
+      if (req_len < 7 || req[0] != UPDATE_BIOS) {
+        return CC_PARAM_OUT_OF_RANGE;
+      }
+      offset = get_u32(&req[1]);
+      len = req[5] | (req[6] << 8);
+      if (len != req_len - 7 || offset + len > SIM_FLASH_SIZE) {
+        return CC_INVALID_LENGTH;
+      }
+      if ((offset % SIM_ERASE_SIZE) == 0) {
+        memset(&bic->flash[offset], 0xFF, SIM_ERASE_SIZE);
+        bic->erased[offset / SIM_ERASE_SIZE] = true;
+        bic->erases++;
+        sim_sleep_us(g_erase_ms * 1000);
+      }
+      if (!bic->erased[offset / SIM_ERASE_SIZE]) {
+        // Writing to a block that was never erased only clears bits
+        for (i = 0; i < len; i++) {
+          bic->flash[offset + i] &= req[7 + i];
+        }
+      } else {
+        memcpy(&bic->flash[offset], &req[7], len);
+      }
+      if (bic->corrupt_block == offset / SIM_ERASE_SIZE) {
+        bic->flash[offset] ^= 0x5A;
+        bic->corrupt_block = -1;
+      }
+      bic->writes++;
+      return CC_SUCCESS;
+
+    case CMD_OEM_1S_GET_FW_CKSUM:
+      if (req_len < 9) {
+        return CC_INVALID_LENGTH;
+      }
+      offset = get_u32(&req[1]);
+      len = get_u32(&req[5]);
+      if (offset + len > SIM_FLASH_SIZE) {
+        return CC_PARAM_OUT_OF_RANGE;
+      }
+      for (i = 0, cksum = 0; i < len; i++) {
+        cksum += bic->flash[offset + i];
+      }
+      memcpy(&data[SIZE_IANA_ID], &cksum, sizeof(cksum));
+      *data_len += sizeof(cksum);
+      bic->cksums++;
+      sim_sleep_us(g_cksum_ms * 1000);
+      return CC_SUCCESS;
+  }
+
+  return CC_INVALID_CMD;
+}
+
+static void *
+sim_conn(void *arg) {
+  sim_conn_t *conn = (sim_conn_t *)arg;
+  sim_bic_t *bic = conn->bic;
+  uint8_t rbuf[MAX_IPMB_RES_LEN];
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  ipmb_req_t *req = (ipmb_req_t *)rbuf;
+  ipmb_res_t *res = (ipmb_res_t *)tbuf;
+  int len, data_len = 0;
+
+  len = recv(conn->fd, rbuf, sizeof(rbuf), 0);
+  if (len >= MIN_IPMB_REQ_LEN) {
+    // The BIC takes the next request off the bus while it is still busy
+    // with the previous one
+    pthread_mutex_lock(&bic->bus);
+    sim_sleep_us(len * g_byte_us);
+    pthread_mutex_unlock(&bic->bus);
+
+    pthread_mutex_lock(&bic->lock);
+    bic->requests++;
+    sim_sleep_us(g_cmd_us);
+    res->cc = sim_handle(bic, req->netfn_lun >> LUN_OFFSET, req->cmd, req->data,
+                         len - (IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE), res->data, &data_len);
+    pthread_mutex_unlock(&bic->lock);
+
+    pthread_mutex_lock(&bic->bus);
+    sim_sleep_us((IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + data_len) * g_byte_us);
+    pthread_mutex_unlock(&bic->bus);
+
+    res->req_slave_addr = req->req_slave_addr;
+    res->netfn_lun = ((req->netfn_lun >> LUN_OFFSET) + 1) << LUN_OFFSET;
+    res->res_slave_addr = req->res_slave_addr;
+    res->seq_lun = req->seq_lun;
+    res->cmd = req->cmd;
+    send(conn->fd, tbuf, IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + data_len, MSG_NOSIGNAL);
+  }
+
+  close(conn->fd);
+  free(conn);
+  return NULL;
+}
+
+static void *
+sim_listen(void *arg) {
+  sim_bic_t *bic = (sim_bic_t *)arg;
+  pthread_attr_t attr;
+  pthread_t tid;
+  sim_conn_t *conn;
+  int fd;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  while ((fd = accept(bic->sock, NULL, NULL)) >= 0 || errno == EINTR) {
+    if (fd < 0) {
+      continue;
+    }
+    conn = malloc(sizeof(sim_conn_t));
+    if (conn == NULL) {
+      close(fd);
+      continue;
+    }
+    conn->bic = bic;
+    conn->fd = fd;
+    if (pthread_create(&tid, &attr, sim_conn, conn)) {
+      close(fd);
+      free(conn);
+    }
+  }
+
+  return NULL;
+}
+
+static int
+sim_start(sim_bic_t *bic) {
+  struct sockaddr_un local;
+  sdr_full_t *sdr;
+  pthread_t tid;
+  int i;
+
+  bic->bus_id = bus_of_slot[bic->slot_id];
+  bic->flash = malloc(SIM_FLASH_SIZE);
+  bic->erased = calloc(SIM_FLASH_SIZE / SIM_ERASE_SIZE, sizeof(bool));
+  if (!bic->flash || !bic->erased) {
+    return -1;
+  }
+  memset(bic->flash, 0, SIM_FLASH_SIZE);
+  bic->sdr = calloc(g_sdr_count, sizeof(sdr_full_t));
+  if (!bic->sdr) {
+    return -1;
+  }
+  for (i = 0; i < g_sdr_count; i++) {
+    sdr = &bic->sdr[i];
+    sdr->rec_id[0] = (i + 1) & 0xFF;
+    sdr->rec_id[1] = (i + 1) >> 8;
+    sdr->ver = 0x51;
+    sdr->type = 0x01;
+    sdr->len = sizeof(sdr_full_t) - 5;
+    sdr->owner = 0x20;
+    sdr->sensor_num = i + 1;
+    sdr->m_val = bic->slot_id;
+    snprintf(sdr->str, sizeof(sdr->str), "SIM_SNR_%u", (uint16_t)(i + 1));
+    sdr->str_type_len = 0xC0 | strlen(sdr->str);
+  }
+  pthread_mutex_init(&bic->bus, NULL);
+  pthread_mutex_init(&bic->lock, NULL);
+
+  bic->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (bic->sock < 0) {
+    return -1;
+  }
+  local.sun_family = AF_UNIX;
+  snprintf(local.sun_path, sizeof(local.sun_path), "%s_%d", SOCK_PATH_IPMB, bic->bus_id);
+  unlink(local.sun_path);
+  if (bind(bic->sock, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+      listen(bic->sock, 64) < 0) {
+    perror(local.sun_path);
+    return -1;
+  }
+
+  return pthread_create(&tid, NULL, sim_listen, bic);
+}
+
+static void *
+sim_update(void *arg) {
+  sim_bic_t *bic = (sim_bic_t *)arg;
+
+  bic->update_ret = bic_update_fw_window(bic->slot_id, UPDATE_BIOS, (char *)g_image, g_window);
+  return NULL;
+}
+
+static int
+sim_check(sim_bic_t *bic, uint8_t *image, off_t size) {
+  off_t i;
+
+  if (bic->update_ret) {
+    printf("slot%d: update failed\n", bic->slot_id);
+    return -1;
+  }
+  for (i = 0; i < size; i++) {
+    if (bic->flash[i] != image[i]) {
+      printf("slot%d: flash differs from the image at 0x%lx\n", bic->slot_id, (long)i);
+      return -1;
+    }
+  }
+  printf("slot%d: ok, %u writes, %u erases, %u checksums\n",
+         bic->slot_id, bic->writes, bic->erases, bic->cksums);
+  return 0;
+}
+
+static void
+sim_stop(int sig) {
+}
+
+static void
+usage(const char *prog) {
+  printf("Usage: %s [-n slots] [-w window] [-b byte_us] [-t cmd_us] [-e erase_ms] [-k cksum_ms] "
+         "[-c slot:block] [-s sdr_count] [-m sdr_read_max] [-r rsv_every] [-f fw_rev] "
+         "[bios-image]\n", prog);
+  exit(1);
+}
+
+int
+main(int argc, char **argv) {
+  pthread_t tid[MAX_NUM_FRUS];
+  uint8_t *image;
+  struct stat st;
+  long long start;
+  int slot, block;
+  int fd, opt, i;
+  int ret = 0;
+
+  for (i = 0; i < MAX_NUM_FRUS; i++) {
+    g_bic[i].slot_id = i + 1;
+    g_bic[i].corrupt_block = -1;
+  }
+
+  while ((opt = getopt(argc, argv, "n:w:b:t:e:k:c:s:m:r:f:")) != -1) {
+    switch (opt) {
+      case 'n':
+        g_nslots = atoi(optarg);
+        if (g_nslots < 1 || g_nslots > 4) {
+          usage(argv[0]);
+        }
+        break;
+      case 'w':
+        g_window = atoi(optarg);
+        break;
+      case 'b':
+        g_byte_us = atoi(optarg);
+        break;
+      case 't':
+        g_cmd_us = atoi(optarg);
+        break;
+      case 'e':
+        g_erase_ms = atoi(optarg);
+        break;
+      case 'k':
+        g_cksum_ms = atoi(optarg);
+        break;
+      case 'c':
+        if (sscanf(optarg, "%d:%d", &slot, &block) != 2 || slot < 1 || slot > 4) {
+          usage(argv[0]);
+        }
+        g_bic[slot - 1].corrupt_block = block;
+        break;
+      case 's':
+        g_sdr_count = atoi(optarg);
+        if (g_sdr_count < 1 || g_sdr_count > 0xFFFE) {
+          usage(argv[0]);
+        }
+        break;
+      case 'm':
+        g_sdr_read_max = atoi(optarg);
+        break;
+      case 'r':
+        g_rsv_every = atoi(optarg);
+        break;
+      case 'f':
+        g_fw_rev = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (optind < argc) {
+    g_image = argv[optind];
+  }
+
+  for (i = 0; i < g_nslots; i++) {
+    if (sim_start(&g_bic[i])) {
+      printf("failed to start the BIC of slot%d\n", i + 1);
+      return 1;
+    }
+  }
+
+  if (g_image == NULL) {
+    signal(SIGINT, sim_stop);
+    signal(SIGTERM, sim_stop);
+    printf("serving %d slot(s)\n", g_nslots);
+    fflush(stdout);
+    pause();
+    for (i = 0; i < g_nslots; i++) {
+      pthread_mutex_lock(&g_bic[i].lock);
+      printf("slot%d: %u requests, %u Get SDR\n", i + 1, g_bic[i].requests, g_bic[i].sdr_reads);
+      pthread_mutex_unlock(&g_bic[i].lock);
+    }
+    return 0;
+  }
+
+  fd = open(g_image, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0 || st.st_size > SIM_FLASH_SIZE) {
+    printf("invalid image %s\n", g_image);
+    return 1;
+  }
+  image = malloc(st.st_size);
+  if (image == NULL || read(fd, image, st.st_size) != st.st_size) {
+    printf("failed to read %s\n", g_image);
+    return 1;
+  }
+  close(fd);
+
+  start = sim_now_ms();
+  for (i = 0; i < g_nslots; i++) {
+    pthread_create(&tid[i], NULL, sim_update, &g_bic[i]);
+  }
+  for (i = 0; i < g_nslots; i++) {
+    pthread_join(tid[i], NULL);
+  }
+  printf("updated %d slot(s) in %lld ms with window %d\n", g_nslots, sim_now_ms() - start, g_window);
+
+  for (i = 0; i < g_nslots; i++) {
+    if (sim_check(&g_bic[i], image, st.st_size)) {
+      ret = 1;
+    }
+  }
+
+  free(image);
+  return ret;
+}
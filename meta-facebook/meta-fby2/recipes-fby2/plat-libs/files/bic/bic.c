@@ -21,6 +21,7 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -48,12 +49,28 @@
 #define BIOS_VER_REGION_SIZE (4*1024*1024)
 #define BIOS_VER_STR "F09_"
 
-#define BIC_UPDATE_RETRIES 12
-#define BIC_UPDATE_TIMEOUT 500
+#define BIC_UPDATE_RETRIES 60
+#define BIC_UPDATE_TIMEOUT 100
+
+// Boot loader ack timeouts (ms), polled every BIC_ACK_POLL ms
+#define BIC_ACK_POLL 2
+#define BIC_DOWNLOAD_ACK_TIMEOUT 1000
+#define BIC_DATA_ACK_TIMEOUT 100
+
+// Requests in flight during a BIOS update, and rewrite rounds for blocks
+// that fail verification
+#define BIC_UPDATE_WINDOW_MAX 16
+#define BIC_UPDATE_VERIFY_RETRIES 3
+// Erase blocks of the BIOS image held in memory: the one being written and
+// the previous one, whose checksums are requested meanwhile
+#define BIC_UPDATE_RING_BLOCKS 2
 
 #define BIC_FLASH_START 0x8000
 #define BIC_PKT_MAX 252
 
+// Get Sensor Reading requests in flight
+#define BIC_SNR_PIPELINE 8
+
 #define BIC_CMD_DOWNLOAD 0x21
 #define BIC_CMD_RUN 0x22
 #define BIC_CMD_STATUS 0x23
@@ -224,32 +241,10 @@ get_ipmb_bus_id(uint8_t slot_id) {
   return bus_id;
 }
 
-int
-bic_ipmb_wrapper(uint8_t slot_id, uint8_t netfn, uint8_t cmd,
-                  uint8_t *txbuf, uint8_t txlen,
-                  uint8_t *rxbuf, uint8_t *rxlen) {
-  ipmb_req_t *req;
-  ipmb_res_t *res;
-  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
-  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
-  uint8_t tlen = 0;
-  uint8_t rlen = 0;
-  int count = 0;
-  int i = 0;
-  int ret;
-  uint8_t bus_id;
-
-  ret = get_ipmb_bus_id(slot_id);
-  if (ret < 0) {
-#ifdef DEBUG
-    syslog(LOG_ERR, "bic_ipmb_wrapper: Wrong Slot ID %d\n", slot_id);
-#endif
-    return ret;
-  }
-
-  bus_id = (uint8_t) ret;
-
-  req = (ipmb_req_t*)tbuf;
+static uint8_t
+bic_ipmb_req(uint8_t *tbuf, uint8_t netfn, uint8_t cmd,
+             uint8_t *txbuf, uint8_t txlen) {
+  ipmb_req_t *req = (ipmb_req_t*)tbuf;
 
   req->res_slave_addr = BRIDGE_SLAVE_ADDR << 1;
   req->netfn_lun = netfn << LUN_OFFSET;
@@ -266,26 +261,26 @@ bic_ipmb_wrapper(uint8_t slot_id, uint8_t netfn, uint8_t cmd,
     memcpy(req->data, txbuf, txlen);
   }
 
-  tlen = IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + txlen;
+  return IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + txlen;
+}
 
-  // Invoke IPMB library handler
-  lib_ipmb_handle(bus_id, tbuf, tlen, rbuf, &rlen);
+// Returns the completion code of the response, -1 if there was none
+static int
+bic_ipmb_res(uint8_t *rbuf, uint8_t rlen, uint8_t *rxbuf, uint8_t *rxlen) {
+  ipmb_res_t *res = (ipmb_res_t*) rbuf;
 
-  if (rlen == 0) {
+  if (rlen < IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE) {
 #ifdef DEBUG
     syslog(LOG_DEBUG, "bic_ipmb_wrapper: Zero bytes received\n");
 #endif
     return -1;
   }
 
-  // Handle IPMB response
-  res  = (ipmb_res_t*) rbuf;
-
   if (res->cc) {
 #ifdef DEBUG
     syslog(LOG_ERR, "bic_ipmb_wrapper: Completion Code: 0x%X\n", res->cc);
 #endif
-    return -1;
+    return res->cc;
   }
 
   // copy the received data back to caller
@@ -295,6 +290,40 @@ bic_ipmb_wrapper(uint8_t slot_id, uint8_t netfn, uint8_t cmd,
   return 0;
 }
 
+static int
+bic_ipmb_xfer(uint8_t slot_id, uint8_t netfn, uint8_t cmd,
+              uint8_t *txbuf, uint8_t txlen,
+              uint8_t *rxbuf, uint8_t *rxlen) {
+  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t tlen = 0;
+  uint8_t rlen = 0;
+  int ret;
+
+  ret = get_ipmb_bus_id(slot_id);
+  if (ret < 0) {
+#ifdef DEBUG
+    syslog(LOG_ERR, "bic_ipmb_wrapper: Wrong Slot ID %d\n", slot_id);
+#endif
+    return ret;
+  }
+
+  tlen = bic_ipmb_req(tbuf, netfn, cmd, txbuf, txlen);
+
+  // Invoke IPMB library handler
+  lib_ipmb_handle((uint8_t) ret, tbuf, tlen, rbuf, &rlen);
+
+  return bic_ipmb_res(rbuf, rlen, rxbuf, rxlen);
+}
+
+int
+bic_ipmb_wrapper(uint8_t slot_id, uint8_t netfn, uint8_t cmd,
+                  uint8_t *txbuf, uint8_t txlen,
+                  uint8_t *rxbuf, uint8_t *rxlen) {
+
+  return bic_ipmb_xfer(slot_id, netfn, cmd, txbuf, txlen, rxbuf, rxlen) ? -1 : 0;
+}
+
 // Get Self-Test result
 int
 bic_get_self_test_result(uint8_t slot_id, uint8_t *self_test_result) {
@@ -630,6 +659,37 @@ bic_send:
   return ret;
 }
 
+// Poll for the boot loader's 0x00 0xcc ack instead of sleeping a fixed time
+static int
+_bic_wait_ack(int ifd, uint8_t *rbuf, int timeout) {
+  struct i2c_rdwr_ioctl_data data;
+  struct i2c_msg msg;
+  int elapsed;
+  int rc = -1;
+
+  msg.addr = BRIDGE_SLAVE_ADDR;
+  msg.flags = I2C_M_RD;
+  msg.len = 2;
+  msg.buf = rbuf;
+  data.msgs = &msg;
+  data.nmsgs = 1;
+
+  // The boot loader NAKs while it is busy, so failed reads are not logged
+  for (elapsed = 0; elapsed < timeout; elapsed += BIC_ACK_POLL) {
+    msleep(BIC_ACK_POLL);
+    rbuf[0] = rbuf[1] = 0;
+    rc = (ioctl(ifd, I2C_RDWR, &data) < 0) ? -1 : 0;
+    if (!rc && rbuf[0] == 0x00 && rbuf[1] == 0xcc) {
+      break;
+    }
+  }
+
+  if (rc) {
+    syslog(LOG_ERR, "Failed to do raw io");
+  }
+  return rc;
+}
+
 static int
 _update_bic_main(uint8_t slot_id, char *path) {
   int fd;
@@ -774,11 +834,8 @@ _update_bic_main(uint8_t slot_id, char *path) {
     goto error_exit;
   }
 
-  //delay for download command process ---
-  msleep(500);
-  tcount = 0;
-  rcount = 2;
-  rc = i2c_io(ifd, tbuf, tcount, rbuf, rcount);
+  // wait for download command process ---
+  rc = _bic_wait_ack(ifd, rbuf, BIC_DOWNLOAD_ACK_TIMEOUT);
   if (rc) {
     printf("i2c_io failed download ack\n");
     goto error_exit;
@@ -870,11 +927,7 @@ _update_bic_main(uint8_t slot_id, char *path) {
       goto error_exit;
     }
 
-    msleep(10);
-    tcount = 0;
-    rcount = 2;
-
-    rc = i2c_io(ifd, tbuf, tcount, rbuf, rcount);
+    rc = _bic_wait_ack(ifd, rbuf, BIC_DATA_ACK_TIMEOUT);
     if (rc) {
       printf("i2c_io error send data ack\n");
       goto error_exit;
@@ -922,7 +975,6 @@ _update_bic_main(uint8_t slot_id, char *path) {
     printf("run response: %x:%x\n", rbuf[0], rbuf[1]);
     goto error_exit;
   }
-  msleep(500);
 
   // Wait for SMB_BMC_3v3SB_ALRT_N
   for (i = 0; i < BIC_UPDATE_RETRIES; i++) {
@@ -1127,8 +1179,331 @@ error_exit:
   return ret;
 }
 
+/*
+ * BIOS update pipeline. Up to 'window' Update Firmware and Get Firmware
+ * Checksum requests are kept in flight through ipmbd, which serves each
+ * connection on its own thread. The BIC erases a 64KB block when it gets
+ * the packet at the start of the block, so that packet is always sent on
+ * its own with the pipeline drained on both sides. Once a block is fully
+ * written its checksums are requested alongside the writes of the next
+ * one, and only blocks that fail verification are written again. The
+ * image is read from the file a block at a time into a ring of
+ * BIC_UPDATE_RING_BLOCKS blocks rather than held in memory as a whole.
+ */
+enum {
+  BIOS_REQ_DATA = 0,
+  BIOS_REQ_CKSUM,
+};
+
+typedef struct {
+  int fd;
+  uint8_t type;
+  uint32_t offset;
+  uint16_t len;
+} bios_req_t;
+
+typedef struct {
+  uint8_t slot_id;
+  int bus_id;
+  int image_fd;
+  uint8_t ring[BIC_UPDATE_RING_BLOCKS][BIOS_ERASE_PKT_SIZE];
+  int32_t ring_block[BIC_UPDATE_RING_BLOCKS];
+  uint32_t size;
+  uint8_t window;
+  bios_req_t req[BIC_UPDATE_WINDOW_MAX];
+  int head;
+  int inflight;
+  uint8_t *bad;
+  int err;
+} bios_pipe_t;
+
+// Image data at offset, of a block loaded in the ring
+static uint8_t *
+_bios_data(bios_pipe_t *pipe, uint32_t offset) {
+  uint32_t block = offset / BIOS_ERASE_PKT_SIZE;
+
+  return &pipe->ring[block % BIC_UPDATE_RING_BLOCKS][offset % BIOS_ERASE_PKT_SIZE];
+}
+
+static uint8_t
+_bios_req_build(bios_pipe_t *pipe, uint8_t *tbuf, uint8_t type, uint32_t offset, uint16_t len) {
+  uint8_t data[256] = {0x15, 0xA0, 0x00}; // IANA ID
+  uint8_t dlen;
+
+  data[3] = UPDATE_BIOS;
+
+  data[4] = (offset) & 0xFF;
+  data[5] = (offset >> 8) & 0xFF;
+  data[6] = (offset >> 16) & 0xFF;
+  data[7] = (offset >> 24) & 0xFF;
+
+  if (type == BIOS_REQ_DATA) {
+    data[8] = len & 0xFF;
+    data[9] = (len >> 8) & 0xFF;
+    memcpy(&data[10], _bios_data(pipe, offset), len);
+    dlen = len + 10;
+    return bic_ipmb_req(tbuf, NETFN_OEM_1S_REQ, CMD_OEM_1S_UPDATE_FW, data, dlen);
+  }
+
+  data[8] = len & 0xFF;
+  data[9] = (len >> 8) & 0xFF;
+  data[10] = 0;
+  data[11] = 0;
+  return bic_ipmb_req(tbuf, NETFN_OEM_1S_REQ, CMD_OEM_1S_GET_FW_CKSUM, data, 12);
+}
+
+static uint32_t
+_bios_cksum(bios_pipe_t *pipe, uint32_t offset, uint16_t len) {
+  uint8_t *data = _bios_data(pipe, offset);
+  uint32_t cksum = 0;
+  uint32_t i;
+
+  for (i = 0; i < len; i++) {
+    cksum += data[i];
+  }
+  return cksum;
+}
+
+static void
+_bios_req_check(bios_pipe_t *pipe, bios_req_t *req, uint8_t *rbuf, uint8_t rlen) {
+  uint8_t data[MAX_IPMB_RES_LEN];
+  uint8_t dlen = 0;
+  uint32_t tcksum, gcksum;
+  int rc;
+
+  rc = bic_ipmb_res(rbuf, rlen, data, &dlen);
+
+  if (req->type == BIOS_REQ_DATA) {
+    if (rc) {
+      // Send it again on its own, with the usual retries
+      rc = _update_fw(pipe->slot_id, UPDATE_BIOS, req->offset, req->len, _bios_data(pipe, req->offset));
+      if (rc) {
+        pipe->err = -1;
+      }
+    }
+    return;
+  }
+
+  if (rc == 0 && dlen == 4+SIZE_IANA_ID) {
+    memcpy(&gcksum, &data[SIZE_IANA_ID], sizeof(gcksum));
+  } else if (bic_get_fw_cksum(pipe->slot_id, UPDATE_BIOS, req->offset, req->len, (uint8_t*)&gcksum)) {
+    pipe->err = -1;
+    return;
+  }
+
+  tcksum = _bios_cksum(pipe, req->offset, req->len);
+  if (gcksum != tcksum) {
+    printf("checksum does not match offset:0x%x, 0x%x:0x%x\n", req->offset, tcksum, gcksum);
+    pipe->bad[req->offset / BIOS_ERASE_PKT_SIZE] = 1;
+  }
+}
+
+// Collect the oldest request in flight
+static void
+_bios_pipe_complete(bios_pipe_t *pipe) {
+  uint8_t rbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t rlen = 0;
+  bios_req_t *req;
+
+  if (pipe->inflight == 0) {
+    return;
+  }
+
+  req = &pipe->req[pipe->head];
+  lib_ipmb_collect(req->fd, rbuf, &rlen);
+  _bios_req_check(pipe, req, rbuf, rlen);
+
+  pipe->head = (pipe->head + 1) % pipe->window;
+  pipe->inflight--;
+}
+
+static void
+_bios_pipe_drain(bios_pipe_t *pipe) {
+  while (pipe->inflight) {
+    _bios_pipe_complete(pipe);
+  }
+}
+
+static void
+_bios_pipe_submit(bios_pipe_t *pipe, uint8_t type, uint32_t offset, uint16_t len) {
+  uint8_t tbuf[MAX_IPMB_RES_LEN] = {0};
+  uint8_t tlen;
+  bios_req_t *req;
+
+  if (pipe->inflight == pipe->window) {
+    _bios_pipe_complete(pipe);
+  }
+
+  req = &pipe->req[(pipe->head + pipe->inflight) % pipe->window];
+  req->type = type;
+  req->offset = offset;
+  req->len = len;
+
+  tlen = _bios_req_build(pipe, tbuf, type, offset, len);
+  // A failed submit is retried synchronously when it is collected
+  req->fd = lib_ipmb_submit(pipe->bus_id, tbuf, tlen);
+  pipe->inflight++;
+}
+
+static void
+_bios_pipe_verify(bios_pipe_t *pipe, uint32_t block) {
+  uint32_t offset, end;
+
+  end = (block + 1) * BIOS_ERASE_PKT_SIZE;
+  if (end > pipe->size) {
+    end = pipe->size;
+  }
+
+  pipe->bad[block] = 0;
+  for (offset = block * BIOS_ERASE_PKT_SIZE; offset < end; offset += BIOS_VERIFY_PKT_SIZE) {
+    _bios_pipe_submit(pipe, BIOS_REQ_CKSUM, offset,
+                      (end - offset < BIOS_VERIFY_PKT_SIZE) ? (end - offset) : BIOS_VERIFY_PKT_SIZE);
+  }
+}
+
+// Read a block of the image into its place in the ring. The pipeline is
+// drained, so no request refers to the block it replaces.
+static int
+_bios_pipe_load(bios_pipe_t *pipe, uint32_t block) {
+  int slot = block % BIC_UPDATE_RING_BLOCKS;
+  uint32_t offset, end;
+  int count;
+
+  if (pipe->ring_block[slot] == block) {
+    return 0;
+  }
+
+  end = (block + 1) * BIOS_ERASE_PKT_SIZE;
+  if (end > pipe->size) {
+    end = pipe->size;
+  }
+
+  pipe->ring_block[slot] = -1;
+  for (offset = block * BIOS_ERASE_PKT_SIZE; offset < end; offset += count) {
+    count = pread(pipe->image_fd, _bios_data(pipe, offset), end - offset, offset);
+    if (count <= 0) {
+      pipe->err = -1;
+      return -1;
+    }
+  }
+  pipe->ring_block[slot] = block;
+  return 0;
+}
+
+// Write one erase block, verifying the previous one meanwhile
+static void
+_bios_pipe_write(bios_pipe_t *pipe, uint32_t block, int verify_block) {
+  uint32_t offset, end;
+  uint16_t count;
+
+  _bios_pipe_drain(pipe);
+  if (_bios_pipe_load(pipe, block)) {
+    return;
+  }
+
+  end = (block + 1) * BIOS_ERASE_PKT_SIZE;
+  if (end > pipe->size) {
+    end = pipe->size;
+  }
+
+  for (offset = block * BIOS_ERASE_PKT_SIZE; offset < end; offset += count) {
+    count = (end - offset < IPMB_WRITE_COUNT_MAX) ? (end - offset) : IPMB_WRITE_COUNT_MAX;
+    if (offset == block * BIOS_ERASE_PKT_SIZE) {
+      // The first packet triggers the erase of the block
+      _bios_pipe_submit(pipe, BIOS_REQ_DATA, offset, count);
+      _bios_pipe_drain(pipe);
+      if (verify_block >= 0) {
+        _bios_pipe_verify(pipe, verify_block);
+      }
+      continue;
+    }
+    _bios_pipe_submit(pipe, BIOS_REQ_DATA, offset, count);
+  }
+}
+
+static int
+_update_bios_pipelined(uint8_t slot_id, int fd, uint32_t size, uint8_t window) {
+  bios_pipe_t *pipe;
+  uint32_t blocks, block, nbad;
+  int i, retry;
+  int ret = -1;
+
+  pipe = calloc(1, sizeof(bios_pipe_t));
+  if (pipe == NULL) {
+    return -1;
+  }
+  pipe->slot_id = slot_id;
+  pipe->bus_id = get_ipmb_bus_id(slot_id);
+  pipe->size = size;
+  pipe->window = window ? window : 1;
+  if (pipe->window > BIC_UPDATE_WINDOW_MAX) {
+    pipe->window = BIC_UPDATE_WINDOW_MAX;
+  }
+  pipe->image_fd = fd;
+  for (i = 0; i < BIC_UPDATE_RING_BLOCKS; i++) {
+    pipe->ring_block[i] = -1;
+  }
+  if (pipe->bus_id < 0 || size == 0) {
+    goto exit;
+  }
+
+  blocks = (size + BIOS_ERASE_PKT_SIZE - 1) / BIOS_ERASE_PKT_SIZE;
+  pipe->bad = calloc(blocks, sizeof(uint8_t));
+  if (!pipe->bad) {
+    goto exit;
+  }
+
+  for (block = 0; block < blocks && !pipe->err; block++) {
+    _bios_pipe_write(pipe, block, (int)block - 1);
+    printf("\rupdated bios: %d %%", (block + 1) * 100 / blocks);
+    fflush(stdout);
+  }
+  _bios_pipe_drain(pipe);
+  if (!pipe->err) {
+    _bios_pipe_verify(pipe, blocks - 1);
+    _bios_pipe_drain(pipe);
+  }
+
+  // Write the blocks that did not verify again
+  for (retry = 0; !pipe->err; retry++) {
+    for (block = 0, nbad = 0; block < blocks; block++) {
+      nbad += pipe->bad[block];
+    }
+    if (nbad == 0) {
+      ret = 0;
+      break;
+    }
+    if (retry == BIC_UPDATE_VERIFY_RETRIES) {
+      printf("\n%u block(s) still fail verification\n", nbad);
+      break;
+    }
+
+    printf("\nrewriting %u block(s) that failed verification\n", nbad);
+    syslog(LOG_WARNING, "bic_update_fw: slot %d: rewriting %u bios block(s)", slot_id, nbad);
+    for (block = 0; block < blocks && !pipe->err; block++) {
+      if (pipe->bad[block]) {
+        _bios_pipe_write(pipe, block, -1);
+        _bios_pipe_drain(pipe);
+        _bios_pipe_verify(pipe, block);
+      }
+    }
+    _bios_pipe_drain(pipe);
+  }
+
+exit:
+  _bios_pipe_drain(pipe);
+  free(pipe->bad);
+  free(pipe);
+  return ret;
+}
+
 int
 bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
+  return bic_update_fw_window(slot_id, comp, path, BIC_UPDATE_WINDOW);
+}
+
+int
+bic_update_fw_window(uint8_t slot_id, uint8_t comp, char *path, uint8_t window) {
   int ret = -1, rc;
   uint32_t offset;
   volatile uint16_t count, read_count;
@@ -1137,9 +1512,6 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
   uint8_t target;
   int fd;
   int i;
-  uint32_t tcksum;
-  uint32_t gcksum;
-  uint8_t *tbuf = NULL;
 
   printf("updating fw on slot %d:\n", slot_id);
   // Handle Bridge IC firmware separately as the process differs significantly from others
@@ -1167,7 +1539,10 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
       //goto error_exit;
     }
     syslog(LOG_CRIT, "bic_update_fw: update bios firmware on slot %d\n", slot_id);
-    dsize = st.st_size/100;
+    if (_update_bios_pipelined(slot_id, fd, st.st_size, window)) {
+      goto error_exit;
+    }
+    goto update_done;
   } else if (comp == UPDATE_VR) {
     if (check_vr_image(fd, st.st_size) < 0) {
       printf("invalid VR file!\n");
@@ -1193,15 +1568,8 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
   // Write chunks of binary data in a loop
   offset = 0;
   last_offset = 0;
-  i = 1;
   while (1) {
-    // For BIOS, send packets in blocks of 64K
-    if (comp == UPDATE_BIOS && ((offset+IPMB_WRITE_COUNT_MAX) > (i * BIOS_ERASE_PKT_SIZE))) {
-      read_count = (i * BIOS_ERASE_PKT_SIZE) - offset;
-      i++;
-    } else {
-      read_count = IPMB_WRITE_COUNT_MAX;
-    }
+    read_count = IPMB_WRITE_COUNT_MAX;
 
     // Read from file
     count = read(fd, buf, read_count);
@@ -1209,8 +1577,8 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
       break;
     }
 
-    // For non-BIOS update, the last packet is indicated by extra flag
-    if ((comp != UPDATE_BIOS) && (count < read_count)) {
+    // The last packet is indicated by extra flag
+    if (count < read_count) {
       target = comp | 0x80;
     } else {
       target = comp;
@@ -1226,9 +1594,6 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
     offset += count;
     if((last_offset + dsize) <= offset) {
        switch(comp) {
-         case UPDATE_BIOS:
-           printf("\rupdated bios: %d %%", offset/dsize);
-           break;
          case UPDATE_CPLD:
            printf("\ruploaded cpld: %d %%", offset/dsize*5);
            break;
@@ -1265,44 +1630,6 @@ bic_update_fw(uint8_t slot_id, uint8_t comp, char *path) {
     }
   }
 
-  if (comp != UPDATE_BIOS) {
-    goto update_done;
-  }
-
-  // Checksum calculation for BIOS image
-  tbuf = malloc(BIOS_VERIFY_PKT_SIZE * sizeof(uint8_t));
-  if (!tbuf) {
-    goto error_exit;
-  }
-
-  lseek(fd, 0, SEEK_SET);
-  offset = 0;
-  while (1) {
-    count = read(fd, tbuf, BIOS_VERIFY_PKT_SIZE);
-    if (count <= 0) {
-      break;
-    }
-
-    tcksum = 0;
-    for (i = 0; i < BIOS_VERIFY_PKT_SIZE; i++) {
-      tcksum += tbuf[i];
-    }
-
-    // Get the checksum of binary image
-    rc = bic_get_fw_cksum(slot_id, comp, offset, BIOS_VERIFY_PKT_SIZE, (uint8_t*)&gcksum);
-    if (rc) {
-      goto error_exit;
-    }
-
-    // Compare both and see if they match or not
-    if (gcksum != tcksum) {
-      printf("checksum does not match offset:0x%x, 0x%x:0x%x\n", offset, tcksum, gcksum);
-      goto error_exit;
-    }
-
-    offset += BIOS_VERIFY_PKT_SIZE;
-  }
-
 update_done:
   ret = 0;
 error_exit:
@@ -1325,10 +1652,6 @@ error_exit:
     close(fd);
   }
 
-  if (tbuf) {
-    free(tbuf);
-  }
-
   return ret;
 }
 
@@ -1601,6 +1924,22 @@ _get_sdr(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint
   return ret;
 }
 
+int
+bic_get_sdr_rsv(uint8_t slot_id, uint16_t *rsv) {
+
+  return _get_sdr_rsv(slot_id, rsv);
+}
+
+// Read req->nbytes of a record from req->offset in one request. The
+// completion code is returned, so that the caller can renew a cancelled
+// reservation or fall back to smaller reads; -1 if the BIC did not answer.
+int
+bic_get_sdr_part(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint8_t *rlen) {
+
+  *rlen = 0;
+  return bic_ipmb_xfer(slot_id, NETFN_STORAGE_REQ, CMD_STORAGE_GET_SDR, (uint8_t *)req, sizeof(ipmi_sel_sdr_req_t), (uint8_t *)res, rlen);
+}
+
 int
 bic_get_sdr(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint8_t *rlen) {
   int ret;
@@ -1688,6 +2027,50 @@ bic_read_sensor(uint8_t slot_id, uint8_t sensor_num, ipmi_sensor_reading_t *sens
   return ret;
 }
 
+/*
+ * Read a list of sensors with Get Sensor Reading requests pipelined
+ * through ipmbd, BIC_SNR_PIPELINE in flight at a time. status[i] is 0
+ * when sensors[i] holds a reading. Returns 0 if at least one sensor
+ * was read.
+ */
+int
+bic_read_sensor_list(uint8_t slot_id, uint8_t *snr_list, uint8_t cnt,
+                     ipmi_sensor_reading_t *sensors, int *status) {
+  uint8_t tbuf[BIC_SNR_PIPELINE][IPMB_HDR_SIZE + IPMI_REQ_HDR_SIZE + 1];
+  uint8_t rbuf[MAX_IPMB_RES_LEN];
+  uint8_t tlen, rlen, rxlen;
+  int fd[BIC_SNR_PIPELINE];
+  int bus_id, i, j, n, ret = -1;
+
+  bus_id = get_ipmb_bus_id(slot_id);
+  if (bus_id < 0) {
+    return -1;
+  }
+
+  for (i = 0; i < cnt; i += n) {
+    n = (cnt - i < BIC_SNR_PIPELINE) ? (cnt - i) : BIC_SNR_PIPELINE;
+    for (j = 0; j < n; j++) {
+      tlen = bic_ipmb_req(tbuf[j], NETFN_SENSOR_REQ, CMD_SENSOR_GET_SENSOR_READING,
+                          &snr_list[i+j], 1);
+      fd[j] = lib_ipmb_submit(bus_id, tbuf[j], tlen);
+    }
+    for (j = 0; j < n; j++) {
+      rlen = 0;
+      lib_ipmb_collect(fd[j], rbuf, &rlen);
+      if (rlen > IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + sizeof(ipmi_sensor_reading_t)) {
+        rlen = IPMB_HDR_SIZE + IPMI_RESP_HDR_SIZE + sizeof(ipmi_sensor_reading_t);
+      }
+      memset(&sensors[i+j], 0, sizeof(ipmi_sensor_reading_t));
+      status[i+j] = bic_ipmb_res(rbuf, rlen, (uint8_t *)&sensors[i+j], &rxlen) ? -1 : 0;
+      if (status[i+j] == 0) {
+        ret = 0;
+      }
+    }
+  }
+
+  return ret;
+}
+
 int
 bic_get_sys_guid(uint8_t slot_id, uint8_t *guid) {
   int ret;
@@ -31,6 +31,13 @@ extern "C" {
 
 #define MAX_GPIO_PINS     40
 
+// Default number of requests in flight during a BIOS update
+#define BIC_UPDATE_WINDOW 8
+
+// Completion codes of Get SDR partial reads (IPMI/Section 33.12)
+#define CC_SDR_RSV_CANCELLED 0xC5
+#define CC_SDR_CANNOT_RETURN 0xCA
+
 // GPIO PINS
 enum {
   PWRGD_COREPWR = 0x0,
@@ -204,8 +211,10 @@ int bic_get_sel(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *re
 int bic_get_sdr_info(uint8_t slot_id, ipmi_sel_sdr_info_t *info);
 int bic_get_sdr_rsv(uint8_t slot_id, uint16_t *rsv);
 int bic_get_sdr(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint8_t *rlen);
+int bic_get_sdr_part(uint8_t slot_id, ipmi_sel_sdr_req_t *req, ipmi_sel_sdr_res_t *res, uint8_t *rlen);
 
 int bic_read_sensor(uint8_t slot_id, uint8_t sensor_num, ipmi_sensor_reading_t *sensor);
+int bic_read_sensor_list(uint8_t slot_id, uint8_t *snr_list, uint8_t cnt, ipmi_sensor_reading_t *sensors, int *status);
 
 int bic_get_sys_guid(uint8_t slot_id, uint8_t *guid);
 int bic_set_sys_guid(uint8_t slot_id, uint8_t *guid);
@@ -216,6 +225,7 @@ int bic_get_fw_ver(uint8_t slot_id, uint8_t comp, uint8_t *ver);
 
 int bic_dump_fw(uint8_t slot_id, uint8_t comp, char *path);
 int bic_update_fw(uint8_t slot_id, uint8_t comp, char *path);
+int bic_update_fw_window(uint8_t slot_id, uint8_t comp, char *path, uint8_t window);
 int bic_me_xmit(uint8_t slot_id, uint8_t *txbuf, uint8_t txlen, uint8_t *rxbuf, uint8_t *rxlen);
 int me_recovery(uint8_t slot_id, uint8_t command);
 int bic_get_self_test_result(uint8_t slot_id, uint8_t *self_test_result);
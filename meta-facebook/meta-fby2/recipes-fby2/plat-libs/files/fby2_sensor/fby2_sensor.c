@@ -30,6 +30,9 @@
 #include <syslog.h>
 #include <unistd.h>
 #include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/inotify.h>
 #include <openbmc/obmc-i2c.h>
 #include "fby2_sensor.h"
 #include <openbmc/nvme-mi.h>
@@ -98,6 +101,8 @@
 #define TOTAL_M2_CH_ON_GP 6
 #define MAX_POS_READING_MARGIN 127
 
+// How long the readings of one BIC sensor sweep are served
+
 static float ml_hsc_r_sense = ML_ADM1278_R_SENSE;
 
 // List of BIC sensors which need to do negative reading handle
@@ -363,6 +368,27 @@ enum ina_register {
 
 static sensor_info_t g_sinfo[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
 
+// Raw value to reading tables of the BIC sensors, built from g_sinfo
+static float *g_conv[MAX_NUM_FRUS][MAX_SENSOR_NUM] = {0};
+
+// Readings of the current BIC sensor sweep of each slot
+typedef struct {
+  bool valid;
+  bool ok[MAX_SENSOR_NUM+1];
+  ipmi_sensor_reading_t reading[MAX_SENSOR_NUM+1];
+} bic_snr_batch_t;
+
+static bic_snr_batch_t g_bic_batch[MAX_NUM_FRUS];
+
+// Threshold and discrete BIC sensors read by a sweep, built once
+static uint8_t g_bic_snr_list[MAX_SENSOR_NUM];
+static uint8_t g_bic_snr_cnt = 0;
+static bool g_bic_snr_member[MAX_SENSOR_NUM+1];
+static pthread_once_t g_bic_snr_once = PTHREAD_ONCE_INIT;
+
+// Set while the calling thread sweeps the sensors of a slot
+static __thread bool g_bic_sweep[MAX_NUM_FRUS];
+
 const static uint8_t gpio_12v[] = { 0, GPIO_P12V_STBY_SLOT1_EN, GPIO_P12V_STBY_SLOT2_EN, GPIO_P12V_STBY_SLOT3_EN, GPIO_P12V_STBY_SLOT4_EN };
 
 void
@@ -827,50 +853,32 @@ read_nic_temp(const char *device, uint8_t addr, float *value) {
   return 0;
 }
 
-static int
-bic_read_sensor_wrapper(uint8_t fru, uint8_t sensor_num, bool discrete,
-    void *value) {
-
-  int ret;
-  int i;
-  sdr_full_t *sdr;
-  ipmi_sensor_reading_t sensor;
-
-  ret = bic_read_sensor(fru, sensor_num, &sensor);
-  if (ret) {
-    return ret;
-  }
-  msleep(1);  // a little delay to reduce CPU utilization
-
-  if (sensor.flags & BIC_SENSOR_READ_NA) {
-#ifdef DEBUG
-    syslog(LOG_ERR, "bic_read_sensor_wrapper: Reading Not Available");
-    syslog(LOG_ERR, "bic_read_sensor_wrapper: sensor_num: 0x%X, flag: 0x%X",
-        sensor_num, sensor.flags);
-#endif
-    return EER_READ_NA;
-  }
-
-  if (discrete) {
-    *(float *) value = (float) sensor.status;
-    return 0;
-  }
-
-  sdr = &g_sinfo[fru-1][sensor_num].sdr;
-
-  // If the SDR is not type1, no need for conversion
-  if (sdr->type !=1) {
-    *(float *) value = sensor.value;
-    return 0;
-  }
+/*
+ * Precompute the reading of every raw value of a threshold-based BIC sensor
+ * so a conversion is a table lookup instead of decoding the SDR factors and
+ * calling pow() on each read.
+ */
+static float *
+bic_sensor_conv_table(uint8_t sensor_num, sdr_full_t *sdr) {
+  float *table;
+  int i, x;
 
   // y = (mx + b * 10^b_exp) * 10^r_exp
-  uint8_t x;
   uint8_t m_lsb, m_msb, m;
   uint8_t b_lsb, b_msb, b;
   int8_t b_exp, r_exp;
+  double b_scale, r_scale;
+  bool neg_reading = false;
 
-  x = sensor.value;
+  // If the SDR is not type1, no need for conversion
+  if (sdr->type != 1) {
+    return NULL;
+  }
+
+  table = malloc(sizeof(float) * (ALL_BYTES + 1));
+  if (table == NULL) {
+    return NULL;
+  }
 
   m_lsb = sdr->m_val;
   m_msb = sdr->m_tolerance >> 6;
@@ -891,23 +899,144 @@ bic_read_sensor_wrapper(uint8_t fru, uint8_t sensor_num, bool discrete,
     r_exp = (~r_exp + 1) & 0xF;
     r_exp = -r_exp;
   }
+  b_scale = pow(10, b_exp);
+  r_scale = pow(10, r_exp);
+
+  for (i = 0; i < sizeof(bic_neg_reading_sensor_support_list)/sizeof(uint8_t); i++) {
+    if (sensor_num == bic_neg_reading_sensor_support_list[i]) {
+      neg_reading = true;
+    }
+  }
 
-  //printf("m:%d, x:%d, b:%d, b_exp:%d, r_exp:%d\n", m, x, b, b_exp, r_exp);
+  for (x = 0; x <= ALL_BYTES; x++) {
+    table[x] = ((m * x) + (b * b_scale)) * r_scale;
 
-  * (float *) value = ((m * x) + (b * pow(10, b_exp))) * (pow(10, r_exp));
+    if ((sensor_num == BIC_SENSOR_SOC_THERM_MARGIN) && (table[x] > 0)) {
+      table[x] -= (float) THERMAL_CONSTANT;
+    }
 
-  if ((sensor_num == BIC_SENSOR_SOC_THERM_MARGIN) && (* (float *) value > 0)) {
-   * (float *) value -= (float) THERMAL_CONSTANT;
+    if (neg_reading && table[x] > MAX_POS_READING_MARGIN) {     //Negative reading handle
+      table[x] -= (float) THERMAL_CONSTANT;
+    }
   }
 
-  if (*(float *) value > MAX_POS_READING_MARGIN) {     //Negative reading handle
-    for(i=0;i<sizeof(bic_neg_reading_sensor_support_list)/sizeof(uint8_t);i++) {
-      if (sensor_num == bic_neg_reading_sensor_support_list[i]) {
-        * (float *) value -= (float) THERMAL_CONSTANT;
-      }
+  return table;
+}
+
+static void
+bic_sensor_conv_init(uint8_t fru) {
+  int snr_num;
+
+  for (snr_num = 0; snr_num < MAX_SENSOR_NUM; snr_num++) {
+    free(g_conv[fru-1][snr_num]);
+    g_conv[fru-1][snr_num] = NULL;
+    if (g_sinfo[fru-1][snr_num].valid) {
+      g_conv[fru-1][snr_num] = bic_sensor_conv_table(snr_num, &g_sinfo[fru-1][snr_num].sdr);
+    }
+  }
+}
+
+static void
+bic_sensor_list_init(void) {
+  int i;
+
+  for (i = 0; i < bic_sensor_cnt; i++) {
+    g_bic_snr_list[g_bic_snr_cnt++] = bic_sensor_list[i];
+  }
+  for (i = 0; i < bic_discrete_cnt; i++) {
+    g_bic_snr_list[g_bic_snr_cnt++] = bic_discrete_list[i];
+  }
+  for (i = 0; i < g_bic_snr_cnt; i++) {
+    g_bic_snr_member[g_bic_snr_list[i]] = true;
+  }
+}
+
+/*
+ * A sweep by the sensor monitor reads all BIC sensors of the slot with its
+ * first read: one Get Sensor Reading request per sensor, all pipelined
+ * through ipmbd instead of one round trip after another. Every reading is
+ * handed out once, a re-read of the sweep goes to the BIC again. Readers
+ * outside a sweep (fscd, sensor-util, ipmid) read the single sensor.
+ */
+void
+fby2_sensor_sweep(uint8_t fru, bool start) {
+  if (fru < 1 || fru > MAX_NUM_FRUS) {
+    return;
+  }
+
+  g_bic_sweep[fru-1] = start;
+  if (start) {
+    g_bic_batch[fru-1].valid = false;
+  }
+}
+
+static int
+bic_read_sensor_batch(uint8_t fru, uint8_t sensor_num, ipmi_sensor_reading_t *sensor) {
+  bic_snr_batch_t *batch = &g_bic_batch[fru-1];
+  ipmi_sensor_reading_t reading[MAX_SENSOR_NUM];
+  int status[MAX_SENSOR_NUM];
+  int i;
+
+  pthread_once(&g_bic_snr_once, bic_sensor_list_init);
+
+  if (!g_bic_sweep[fru-1] || !g_bic_snr_member[sensor_num]) {
+    return bic_read_sensor(fru, sensor_num, sensor);
+  }
+
+  if (!batch->valid) {
+    // On failure the sweep goes on with single reads
+    if (bic_read_sensor_list(fru, g_bic_snr_list, g_bic_snr_cnt, reading, status)) {
+      memset(status, 0xff, sizeof(status));
+    }
+    for (i = 0; i < g_bic_snr_cnt; i++) {
+      batch->reading[g_bic_snr_list[i]] = reading[i];
+      batch->ok[g_bic_snr_list[i]] = (status[i] == 0);
     }
+    batch->valid = true;
+  }
+
+  if (!batch->ok[sensor_num]) {
+    return bic_read_sensor(fru, sensor_num, sensor);
+  }
+  batch->ok[sensor_num] = false;
+  *sensor = batch->reading[sensor_num];
+  return 0;
+}
+
+static int
+bic_read_sensor_wrapper(uint8_t fru, uint8_t sensor_num, bool discrete,
+    void *value) {
+
+  int ret;
+  ipmi_sensor_reading_t sensor;
+
+  ret = bic_read_sensor_batch(fru, sensor_num, &sensor);
+  if (ret) {
+    return ret;
+  }
+
+  if (sensor.flags & BIC_SENSOR_READ_NA) {
+#ifdef DEBUG
+    syslog(LOG_ERR, "bic_read_sensor_wrapper: Reading Not Available");
+    syslog(LOG_ERR, "bic_read_sensor_wrapper: sensor_num: 0x%X, flag: 0x%X",
+        sensor_num, sensor.flags);
+#endif
+    return EER_READ_NA;
   }
 
+  if (discrete) {
+    *(float *) value = (float) sensor.status;
+    return 0;
+  }
+
+  // No conversion table if the SDR is not type1
+  if (g_conv[fru-1][sensor_num] == NULL) {
+    *(float *) value = sensor.value;
+    return 0;
+  }
+
+  *(float *) value = g_conv[fru-1][sensor_num][sensor.value];
+
   return 0;
 }
 
@@ -951,6 +1080,47 @@ if (access(path, F_OK) == -1) {
 return 0;
 }
 
+/*
+ * Wait for bic-cached to rename the SDR dump into place, woken by inotify
+ * instead of polling. Falls back to polling if no watch can be added.
+ */
+static void
+_sdr_wait(char *path) {
+  char dir[64] = {0};
+  char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  char *name;
+  int fd = -1;
+
+  if (access(path, F_OK) == 0) {
+    return;
+  }
+
+  name = strrchr(path, '/');
+  if (name != NULL && name - path < sizeof(dir)) {
+    memcpy(dir, path, name - path);
+    fd = inotify_init1(IN_CLOEXEC);
+    if (fd >= 0 && inotify_add_watch(fd, dir[0] ? dir : "/", IN_MOVED_TO | IN_CREATE) < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  // The dump may have been put in place before the watch was added
+  while (access(path, F_OK) == -1) {
+    if (fd < 0) {
+      sleep(5);
+    } else if (read(fd, buf, sizeof(buf)) <= 0 && errno != EINTR) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
 /* Populates all sensor_info_t struct using the path to SDR dump */
 static int
 _sdr_init(char *path, sensor_info_t *sinfo) {
@@ -961,9 +1131,7 @@ _sdr_init(char *path, sensor_info_t *sinfo) {
   uint8_t snr_num = 0;
   sdr_full_t *sdr;
 
-  while (access(path, F_OK) == -1) {
-    sleep(5);
-  }
+  _sdr_wait(path);
 
   fd = open(path, O_RDONLY);
   if (fd < 0) {
@@ -1066,6 +1234,7 @@ fby2_sdr_init(uint8_t fru) {
     if (fby2_sensor_sdr_init(fru, sinfo) < 0)
       return ERR_NOT_READY;
 
+    bic_sensor_conv_init(fru);
     init_done[fru - 1] = true;
   }
 
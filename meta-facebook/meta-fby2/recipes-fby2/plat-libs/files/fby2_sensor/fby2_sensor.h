@@ -212,6 +212,7 @@ extern size_t nic_sensor_cnt;
 extern size_t dc_cf_sensor_cnt;
 
 int fby2_sensor_read(uint8_t fru, uint8_t sensor_num, void *value);
+void fby2_sensor_sweep(uint8_t fru, bool start);
 int fby2_sensor_name(uint8_t fru, uint8_t sensor_num, char *name);
 int fby2_sensor_units(uint8_t fru, uint8_t sensor_num, char *units);
 int fby2_sensor_sdr_path(uint8_t fru, char *path);
@@ -2067,6 +2067,54 @@ pal_sled_cycle(void) {
   return 0;
 }
 
+int
+pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint) {
+
+  constraint->max_parallel = 0;
+  constraint->stagger_ms = 0;
+  constraint->cycle_off_ms = DELAY_POWER_CYCLE * 1000;
+
+  switch (cmd) {
+    case SERVER_12V_ON:
+    case SERVER_12V_CYCLE:
+      // Every slot hot-swap controller sits behind the same sled HSC, so
+      // keep the 12V inrush of two slots from overlapping
+      constraint->stagger_ms = 2000;
+      constraint->timeout_ms = (DELAY_12V_CYCLE + 30) * 1000;
+      constraint->cycle_off_ms = DELAY_12V_CYCLE * 1000;
+      break;
+    case SERVER_POWER_ON:
+    case SERVER_POWER_CYCLE:
+      constraint->stagger_ms = 500;
+      constraint->timeout_ms = (DELAY_POWER_CYCLE + 20) * 1000;
+      break;
+    default:
+      constraint->timeout_ms = (DELAY_POWER_OFF + 20) * 1000;
+      break;
+  }
+
+  return 0;
+}
+
+int
+pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group) {
+
+  *group = slot_id;
+
+  // 12V of a pair configuration is controlled through the server slot,
+  // so slot 1/2 and slot 3/4 must be sequenced one after the other
+  switch (cmd) {
+    case SERVER_12V_OFF:
+    case SERVER_12V_ON:
+    case SERVER_12V_CYCLE:
+      if (slot_id == FRU_SLOT2 || slot_id == FRU_SLOT4)
+        *group = slot_id - 1;
+      break;
+  }
+
+  return 0;
+}
+
 // Read the Front Panel Hand Switch and return the position
 int
 pal_get_hand_sw_physically(uint8_t *pos) {
@@ -2833,6 +2881,11 @@ get_sensor_desc(uint8_t fru, uint8_t snr_num) {
   return &m_snr_desc[fru-1][snr_num];
 }
 
+void
+pal_sensor_sweep(uint8_t fru, bool start) {
+  fby2_sensor_sweep(fru, start);
+}
+
 int
 pal_sensor_read_raw(uint8_t fru, uint8_t sensor_num, void *value) {
 
@@ -104,6 +104,8 @@ int pal_slot_pair_12V_off(uint8_t slot_id);
 bool pal_is_hsvc_ongoing(uint8_t slot_id);
 int pal_set_hsvc_ongoing(uint8_t slot_id, uint8_t status, uint8_t ident);
 int pal_sled_cycle(void);
+int pal_get_pwr_seq_constraint(uint8_t cmd, pwr_seq_constraint_t *constraint);
+int pal_get_pwr_seq_group(uint8_t slot_id, uint8_t cmd, uint8_t *group);
 int pal_is_debug_card_prsnt(uint8_t *status);
 int pal_get_hand_sw_physically(uint8_t *pos);
 int pal_get_hand_sw(uint8_t *pos);
@@ -441,18 +441,26 @@ util_get_sdr(uint8_t slot_id) {
 // Test to read all Sensors from Monolake Server
 static void
 util_read_sensor(uint8_t slot_id) {
-  int ret;
   int i;
-  ipmi_sensor_reading_t sensor;
+  uint8_t snr_list[MAX_SENSOR_NUM];
+  ipmi_sensor_reading_t sensor[MAX_SENSOR_NUM];
+  int status[MAX_SENSOR_NUM];
 
   for (i = 0; i < MAX_SENSOR_NUM; i++) {
-    ret = bic_read_sensor(slot_id, i, &sensor);
-    if (ret) {
+    snr_list[i] = i;
+  }
+
+  if (bic_read_sensor_list(slot_id, snr_list, MAX_SENSOR_NUM, sensor, status)) {
+    return;
+  }
+
+  for (i = 0; i < MAX_SENSOR_NUM; i++) {
+    if (status[i]) {
       continue;
     }
 
     printf("sensor#%d: value: 0x%X, flags: 0x%X, status: 0x%X, ext_status: 0x%X\n",
-            i, sensor.value, sensor.flags, sensor.status, sensor.ext_status);
+            i, sensor[i].value, sensor[i].flags, sensor[i].status, sensor[i].ext_status);
   }
 }
 
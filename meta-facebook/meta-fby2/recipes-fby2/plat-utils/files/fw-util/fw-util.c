@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <sys/file.h>
+#include <sys/wait.h>
 #include <facebook/bic.h>
 #include <openbmc/pal.h>
 #include <openbmc/ipmi.h>
@@ -399,6 +400,8 @@ int
 update_fw(char **argv, uint8_t slot_id) {
   int ret = 0;
   int opt = 0;
+  pid_t pid[OPT_SLOT4 + 1];
+  int status;
 
   switch(slot_id) {
     case OPT_SLOT1:
@@ -431,9 +434,23 @@ update_fw(char **argv, uint8_t slot_id) {
         }
       }
 
+      // Each slot is behind its own bus and BIC, update them all at once
       printf("Updating all slots....\n");
       for (opt = OPT_SLOT1; opt <= OPT_SLOT4; opt++) {
-        if (fw_update_slot(argv, opt)) {
+        pid[opt] = fork();
+        if (pid[opt] == 0) {
+          exit(fw_update_slot(argv, opt) ? 1 : 0);
+        }
+        if (pid[opt] < 0 && fw_update_slot(argv, opt)) {
+          printf("fw_util: updating %s on slot %d failed!\n", argv[3], opt);
+          ret = -1;
+        }
+      }
+      for (opt = OPT_SLOT1; opt <= OPT_SLOT4; opt++) {
+        if (pid[opt] <= 0) {
+          continue;
+        }
+        if (waitpid(pid[opt], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
           printf("fw_util: updating %s on slot %d failed!\n", argv[3], opt);
           ret = -1;
         }
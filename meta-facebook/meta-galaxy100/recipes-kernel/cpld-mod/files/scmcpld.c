@@ -269,6 +269,12 @@ static const i2c_dev_attr_st scmcpld_attr_table[] = {
   },
 };
 
+/* Board version and slot id are strapped, not the CPLD version */
+static const i2c_dev_reg_st scmcpld_reg_table[] = {
+  { 0x0, 0x0, I2C_DEV_REG_NONVOLATILE },
+  { 0x3, 0x3, I2C_DEV_REG_NONVOLATILE },
+};
+
 static i2c_dev_data_st scmcpld_data;
 
 /*
@@ -300,8 +306,10 @@ static int scmcpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(scmcpld_attr_table) / sizeof(scmcpld_attr_table[0]);
-  i2c_dev_sysfs_data_init(client, &scmcpld_data,
-					scmcpld_attr_table, n_attrs);
+  return i2c_dev_sysfs_data_init_regmap(client, &scmcpld_data,
+                                        scmcpld_attr_table, n_attrs,
+                                        scmcpld_reg_table,
+                                        ARRAY_SIZE(scmcpld_reg_table));
 }
 
 static int scmcpld_remove(struct i2c_client *client)
@@ -22,8 +22,12 @@
 
 #include <linux/errno.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/i2c.h>
 #include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include <i2c_dev_sysfs.h>
 
@@ -45,6 +49,73 @@
 
 #define EC_DELAY 11 //ms
 
+/*
+ * The EC is slow: it needs EC_DELAY between transactions and answers 0xff
+ * while busy. Rather than reading it for every sysfs access, the driver
+ * keeps a snapshot of the registers below, refreshed every refresh_ms by a
+ * work item. Attributes are served from the snapshot as long as it is no
+ * older than max_age_ms, else the range is read again first. The transfers
+ * and their sleeps happen without the snapshot lock, a range is published
+ * as a whole so multi-byte values are always consistent.
+ *
+ * The driver can be tried without an EC through i2c-stub, eg:
+ *   modprobe i2c-stub chip_addr=0x33
+ *   i2cset -y N 0x33 0x20 0x55
+ *   echo galaxy100_ec 0x33 > /sys/bus/i2c/devices/i2c-N/new_device
+ */
+static unsigned int refresh_ms = 1000;
+module_param(refresh_ms, uint, 0644);
+MODULE_PARM_DESC(refresh_ms,
+                 "Interval (ms) of the background register refresh, 0 to stop it");
+
+static unsigned int max_age_ms = 2000;
+module_param(max_age_ms, uint, 0644);
+MODULE_PARM_DESC(max_age_ms,
+                 "Oldest register value (ms) served before reading it again");
+
+#define EC_NUM_REGS 0x80
+#define EC_STABLE_MAX_AGE_MS 60000
+
+#define EC_RANGE_STABLE  0x1  /* identity, only re-read every minute */
+#define EC_RANGE_NODELAY 0x2  /* no EC_DELAY needed between its bytes */
+
+typedef struct ec_range_st_ {
+  u8 first;
+  u8 len;
+  int flags;
+} ec_range_st;
+
+static const ec_range_st ec_ranges[] = {
+  { 0x00, 1, 0 },                                   /* CPU temperature */
+  { 0x04, 5, 0 },                                   /* memory temp, wdt */
+  { 0x15, 1, 0 },                                   /* hw monitor config */
+  { 0x1d, 3, EC_RANGE_STABLE },                     /* version */
+  { 0x20, 6, 0 },                                   /* CPU, 3V, 5V */
+  { 0x2b, 2, 0 },                                   /* gpio */
+  { 0x2d, 3, EC_RANGE_STABLE },                     /* build date */
+  { 0x30, 4, 0 },                                   /* 12V, DIMM */
+  { 0x3c, EC_PRODUCT_NAME_LEN, EC_RANGE_STABLE },
+  { 0x4d, EC_CUST_NAME_LEN, EC_RANGE_STABLE },
+  { 0x50, EC_MAC_LEN, EC_RANGE_STABLE },
+  { 0x60, EC_SERIAL_NUM, EC_RANGE_STABLE | EC_RANGE_NODELAY },
+};
+
+#define EC_NUM_RANGES ARRAY_SIZE(ec_ranges)
+
+typedef struct ec_data_st_ {
+  i2c_dev_data_st idd;
+  struct i2c_client *client;
+  struct mutex io_lock;       /* transfers with the EC */
+  spinlock_t snap_lock;       /* regs, updated and valid */
+  u8 regs[EC_NUM_REGS];
+  unsigned long updated[EC_NUM_RANGES];
+  bool valid[EC_NUM_RANGES];
+  bool block_read;
+  struct delayed_work refresh_work;
+} ec_data_st;
+
+#define TO_EC_DATA(_idd) container_of(_idd, ec_data_st, idd)
+
 static int i2c_smbus_read_byte_data_retry(struct i2c_client *client, unsigned char reg)
 {
 	int count = 10;
@@ -56,447 +127,368 @@ static int i2c_smbus_read_byte_data_retry(struct i2c_client *client, unsigned ch
 
 	return ret;
 }
-static ssize_t ec_cpu_temp_show(struct device *dev,
-                                    struct device_attribute *attr,
-                                    char *buf)
+
+static int ec_read_block_retry(struct i2c_client *client, u8 reg, u8 len,
+                               u8 *values)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
+  int count = 10;
+  int ret;
+  int i;
+
+  while (count--) {
+    ret = i2c_smbus_read_i2c_block_data(client, reg, len, values);
+    if (ret != len) {
+      continue;
+    }
+    /* all 0xff: the EC is busy */
+    for (i = 0; i < len && values[i] == 0xff; i++);
+    if (i < len) {
+      return 0;
+    }
+  }
 
-  mutex_lock(&data->idd_lock);
+  return -EIO;
+}
 
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
+/* Read a range from the EC, called with io_lock held */
+static int ec_read_range(ec_data_st *ec, const ec_range_st *range, u8 *values)
+{
+  struct i2c_client *client = ec->client;
+  int tries, i, val;
 
-  if (val < 0) {
-    /* error case */
-    EC_DEBUG("I2C read error!\n");
-    return -1;
+  if (ec->block_read) {
+    return ec_read_block_retry(client, range->first, range->len, values);
   }
 
-  return scnprintf(buf, PAGE_SIZE, "%d\n", val * 10);
+  for (tries = 0; tries < 3; tries++) {
+    for (i = 0; i < range->len; i++) {
+      if (i && !(range->flags & EC_RANGE_NODELAY)) {
+        msleep(EC_DELAY);
+      }
+      val = i2c_smbus_read_byte_data_retry(client, range->first + i);
+      if (val < 0) {
+        EC_DEBUG("I2C read 0x%x error!\n", range->first + i);
+        return val;
+      }
+      values[i] = val;
+    }
+    if (range->len == 1 || (range->flags & EC_RANGE_STABLE)) {
+      return 0;
+    }
+    /* A value may have changed between its bytes, check the first again */
+    msleep(EC_DELAY);
+    val = i2c_smbus_read_byte_data_retry(client, range->first);
+    if (val < 0) {
+      return val;
+    }
+    if (val == values[0]) {
+      return 0;
+    }
+  }
+
+  return -EAGAIN;
 }
 
-static ssize_t ec_mem_temp_show(struct device *dev,
-                                    struct device_attribute *attr,
-                                    char *buf)
+static bool ec_range_fresh(ec_data_st *ec, int idx)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
+  unsigned int age_ms = (ec_ranges[idx].flags & EC_RANGE_STABLE)
+    ? EC_STABLE_MAX_AGE_MS : max_age_ms;
 
-  mutex_lock(&data->idd_lock);
+  return ec->valid[idx]
+    && time_before(jiffies, ec->updated[idx] + msecs_to_jiffies(age_ms));
+}
 
-  msb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  lsb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
+/* Read a range and publish it in the snapshot, unless it is fresh already */
+static int ec_refresh_range(ec_data_st *ec, int idx, bool force)
+{
+  const ec_range_st *range = &ec_ranges[idx];
+  u8 values[EC_SERIAL_NUM];
+  bool fresh;
+  int ret;
+
+  mutex_lock(&ec->io_lock);
+
+  /* another reader or the work item may have just read it */
+  spin_lock(&ec->snap_lock);
+  fresh = ec_range_fresh(ec, idx);
+  spin_unlock(&ec->snap_lock);
+  if (fresh && !force) {
+    mutex_unlock(&ec->io_lock);
+    return 0;
+  }
 
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
+  ret = ec_read_range(ec, range, values);
+  if (ret == 0) {
+    spin_lock(&ec->snap_lock);
+    memcpy(&ec->regs[range->first], values, range->len);
+    ec->updated[idx] = jiffies;
+    ec->valid[idx] = true;
+    spin_unlock(&ec->snap_lock);
   }
 
-  result = ((((msb_val << 8) + lsb_val) >> 4) & 0xff) * 10 + (((lsb_val >> 1) & 0x07) * 10)/ 8;
+  mutex_unlock(&ec->io_lock);
+  return ret;
+}
 
-//return scnprintf(buf, PAGE_SIZE, "%d.%d C\n", result / 8, (((result % 8) * 10) / 8));
-  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+static void ec_refresh_work(struct work_struct *work)
+{
+  ec_data_st *ec = container_of(to_delayed_work(work), ec_data_st,
+                                refresh_work);
+  bool fresh;
+  int i;
+
+  if (refresh_ms) {
+    for (i = 0; i < EC_NUM_RANGES; i++) {
+      spin_lock(&ec->snap_lock);
+      fresh = ec_range_fresh(ec, i);
+      spin_unlock(&ec->snap_lock);
+      if (fresh && (ec_ranges[i].flags & EC_RANGE_STABLE)) {
+        continue;
+      }
+      ec_refresh_range(ec, i, true);
+    }
+  }
+
+  schedule_delayed_work(&ec->refresh_work,
+                        msecs_to_jiffies(refresh_ms ? refresh_ms : 1000));
 }
 
-static ssize_t ec_wdt_cfg_show(struct device *dev,
-                                    struct device_attribute *attr,
-                                    char *buf)
+/*
+ * Copy n registers starting at reg from the snapshot, all of them from the
+ * same range so that they were read together.
+ */
+static int ec_get_regs(struct device *dev, int reg, u8 *values, int n)
 {
   struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
+  ec_data_st *ec = TO_EC_DATA((i2c_dev_data_st *)i2c_get_clientdata(client));
+  const ec_range_st *range;
+  bool fresh;
+  int idx;
+  int ret;
+
+  for (idx = 0; idx < EC_NUM_RANGES; idx++) {
+    range = &ec_ranges[idx];
+    if (reg >= range->first && reg + n <= range->first + range->len) {
+      break;
+    }
+  }
+  if (idx == EC_NUM_RANGES) {
+    return -EINVAL;
+  }
 
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
+  spin_lock(&ec->snap_lock);
+  fresh = ec_range_fresh(ec, idx);
+  if (fresh) {
+    memcpy(values, &ec->regs[reg], n);
+  }
+  spin_unlock(&ec->snap_lock);
+  if (fresh) {
+    return 0;
+  }
 
-  if (val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
+  ret = ec_refresh_range(ec, idx, false);
+  if (ret) {
+    EC_DEBUG("I2C read error!\n");
+    return ret;
   }
 
-  return scnprintf(buf, PAGE_SIZE, "0x%x\n", val);
+  spin_lock(&ec->snap_lock);
+  memcpy(values, &ec->regs[reg], n);
+  spin_unlock(&ec->snap_lock);
+  return 0;
 }
 
-static ssize_t ec_wdt_crm_show(struct device *dev,
+static ssize_t ec_cpu_temp_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
+  u8 val;
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
-
-  if (val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
+  ret = ec_get_regs(dev, dev_attr->ida_reg, &val, 1);
+  if (ret) {
+    return ret;
   }
 
-  return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+  return scnprintf(buf, PAGE_SIZE, "%d\n", val * 10);
 }
 
-static ssize_t ec_wdt_crs_show(struct device *dev,
-									struct device_attribute *attr,
-									char *buf)
+static ssize_t ec_mem_temp_show(struct device *dev,
+                                    struct device_attribute *attr,
+                                    char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
-
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
+  u8 val[2];
+  int msb_val, lsb_val;
+  int result;
+  int ret;
 
-  if (val < 0) {
-	/* error case */
-	EC_DEBUG("I2C read error!\n");
-	return -1;
+  ret = ec_get_regs(dev, dev_attr->ida_reg, val, 2);
+  if (ret) {
+    return ret;
   }
+  msb_val = val[0];
+  lsb_val = val[1];
 
-  return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+  result = ((((msb_val << 8) + lsb_val) >> 4) & 0xff) * 10 + (((lsb_val >> 1) & 0x07) * 10)/ 8;
+
+//return scnprintf(buf, PAGE_SIZE, "%d.%d C\n", result / 8, (((result % 8) * 10) / 8));
+  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
 }
 
-static ssize_t ec_hw_monitor_cfg_show(struct device *dev,
-									struct device_attribute *attr,
-									char *buf)
+/* Single register in hex: wdt_cfg, hw_monitor_cfg, gpio_dir, gpio_data */
+static ssize_t ec_reg_hex_show(struct device *dev,
+                               struct device_attribute *attr,
+                               char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
+  u8 val;
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
-
-  if (val < 0) {
-	/* error case */
-	EC_DEBUG("I2C read error!\n");
-	return -1;
+  ret = ec_get_regs(dev, dev_attr->ida_reg, &val, 1);
+  if (ret) {
+    return ret;
   }
 
   return scnprintf(buf, PAGE_SIZE, "0x%x\n", val);
 }
 
-static ssize_t ec_version_show(struct device *dev,
-									struct device_attribute *attr,
-									char *buf)
+/* Single register in decimal: wdt_crm, wdt_crs */
+static ssize_t ec_reg_dec_show(struct device *dev,
+                               struct device_attribute *attr,
+                               char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val_r, val_e, val_t;
-  int year, month, day;
+  u8 val;
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  val_r = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  val_e = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  msleep(EC_DELAY);
-  val_t = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x2));
-  mutex_unlock(&data->idd_lock);
-
-  if (val_r < 0 || val_e < 0 || val_t < 0) {
-	/* error case */
-	EC_DEBUG("I2C read error!\n");
-	return -1;
-  }
-  if(val_t >> 7) {
-	mutex_lock(&data->idd_lock);
-	year = i2c_smbus_read_byte_data_retry(client, 0x2d);
-	year &= 0x0f;
-	msleep(EC_DELAY);
-	month = i2c_smbus_read_byte_data_retry(client, 0x2e);
-	msleep(EC_DELAY);
-	day = i2c_smbus_read_byte_data_retry(client, 0x2f);
-	mutex_unlock(&data->idd_lock);
-	return scnprintf(buf, PAGE_SIZE, "%d%02x%02xT%02x\n", year, month, day, val_t & 0x0f);
-  } else {
-	return scnprintf(buf, PAGE_SIZE, "V%02dE%02d\n", val_r, val_e);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, &val, 1);
+  if (ret) {
+    return ret;
   }
+
+  return scnprintf(buf, PAGE_SIZE, "%d\n", val);
 }
 
-static ssize_t ec_gpio_dir_show(struct device *dev,
+static ssize_t ec_version_show(struct device *dev,
 									struct device_attribute *attr,
 									char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
-
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
+  u8 ver[3];
+  u8 date[3];
+  int ret;
 
-  if (val < 0) {
-	/* error case */
-	EC_DEBUG("I2C read error!\n");
-	return -1;
+  ret = ec_get_regs(dev, dev_attr->ida_reg, ver, 3);
+  if (ret) {
+    return ret;
+  }
+  if(ver[2] >> 7) {
+	ret = ec_get_regs(dev, 0x2d, date, 3);
+	if (ret) {
+	  return ret;
+	}
+	return scnprintf(buf, PAGE_SIZE, "%d%02x%02xT%02x\n",
+	  date[0] & 0x0f, date[1], date[2], ver[2] & 0x0f);
+  } else {
+	return scnprintf(buf, PAGE_SIZE, "V%02dE%02d\n", ver[0], ver[1]);
   }
-
-  return scnprintf(buf, PAGE_SIZE, "0x%x\n", val);
 }
 
-static ssize_t ec_gpio_data_show(struct device *dev,
+static ssize_t ec_build_date_show(struct device *dev,
 									struct device_attribute *attr,
 									char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int val;
+  u8 date[3];
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  mutex_unlock(&data->idd_lock);
-
-  if (val < 0) {
-	/* error case */
-	EC_DEBUG("I2C read error!\n");
-	return -1;
+  ret = ec_get_regs(dev, dev_attr->ida_reg, date, 3);
+  if (ret) {
+    return ret;
   }
 
-  return scnprintf(buf, PAGE_SIZE, "0x%x\n", val);
+  return scnprintf(buf, PAGE_SIZE, "20%x-%x-%x\n", date[0], date[1], date[2]);
 }
 
-static ssize_t ec_build_date_show(struct device *dev,
-									struct device_attribute *attr,
-									char *buf)
+/* Little endian 16 bit voltage reading, scaled */
+static ssize_t ec_vol_show(struct device *dev,
+                           struct device_attribute *attr,
+                           char *buf, int scale)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int year, month, day;
-
-  mutex_lock(&data->idd_lock);
-  year = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  if (year < 0) {
-	/* error case */
-	EC_DEBUG("I2C read 0x%x error!\n", dev_attr->ida_reg);
-	return -1;
-  }
-  msleep(EC_DELAY);
-  month = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + 1);
-  if (month < 0) {
-	/* error case */
-	EC_DEBUG("I2C read 0x%x error!\n", dev_attr->ida_reg + 1);
-	return -1;
-  }
-  msleep(EC_DELAY);
-  day = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + 2);
-  if (day < 0) {
-	/* error case */
-	EC_DEBUG("I2C read 0x%x error!\n", dev_attr->ida_reg + 2);
-	return -1;
-  }
+  u8 val[2];
+  int ret;
 
-  mutex_unlock(&data->idd_lock);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, val, 2);
+  if (ret) {
+    return ret;
+  }
 
-  return scnprintf(buf, PAGE_SIZE, "20%x-%x-%x\n", year, month, day);
+  return scnprintf(buf, PAGE_SIZE, "%d\n", ((val[1] << 8) + val[0]) * scale);
 }
 
 static ssize_t ec_cpu_vol_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
-
-  mutex_lock(&data->idd_lock);
-
-  lsb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  msb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
-
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
-  }
-
-  result = (msb_val << 8) + lsb_val;
-
   //scnprintf(buf, PAGE_SIZE, "%d.%d V\n", result / 341, (((result % 341) * 10) / 341));
-  scnprintf(buf, PAGE_SIZE, "%d\n", result);
+  return ec_vol_show(dev, attr, buf, 1);
 }
 
 static ssize_t ec_3v_vol_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
-
-  mutex_lock(&data->idd_lock);
-
-  lsb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  msb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
-
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
-  }
-
-  result = ((msb_val << 8) + lsb_val) * 2;
-
   //scnprintf(buf, PAGE_SIZE, "%d.%d V\n", result / 341, (((result % 341) * 10) / 341));
-  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+  return ec_vol_show(dev, attr, buf, 2);
 }
 
 static ssize_t ec_5v_vol_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
-
-  mutex_lock(&data->idd_lock);
-
-  lsb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  msb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
-
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
-  }
-
-  result = ((msb_val << 8) + lsb_val) * 16;
-
   //scnprintf(buf, PAGE_SIZE, "%d.%d V\n", result / 1705, (((result % 1705) * 10) / 1705));
-  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+  return ec_vol_show(dev, attr, buf, 16);
 }
 
 static ssize_t ec_12v_vol_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
-
-  mutex_lock(&data->idd_lock);
-
-  lsb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  msb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
-
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
-  }
-
-  result = ((msb_val << 8) + lsb_val) * 33;
-
   //scnprintf(buf, PAGE_SIZE, "%d.%d V\n", result / 1705, (((result % 1705) * 10) / 1705));
-  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+  return ec_vol_show(dev, attr, buf, 33);
 }
 
 static ssize_t ec_dimm_vol_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
-  i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
-  const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int lsb_val, msb_val;
-  int result;
-
-  mutex_lock(&data->idd_lock);
-
-  lsb_val = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg);
-  msleep(EC_DELAY);
-  msb_val = i2c_smbus_read_byte_data_retry(client, (dev_attr->ida_reg + 0x1));
-  mutex_unlock(&data->idd_lock);
-
-  if (lsb_val < 0 || msb_val < 0) {
-    /* error case */
-	EC_DEBUG("I2C read error!\n");
-    return -1;
-  }
-
-  result = (msb_val << 8) + lsb_val;
-
   //scnprintf(buf, PAGE_SIZE, "%d.%d V\n", result / 341, (((result % 341) * 10) / 341));
-  return scnprintf(buf, PAGE_SIZE, "%d\n", result);
+  return ec_vol_show(dev, attr, buf, 1);
 }
 
 static ssize_t ec_product_name_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int result, i, len = EC_PRODUCT_NAME_LEN;
   unsigned char product_name[EC_PRODUCT_NAME_LEN];
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  for(i = 0; i < len; i++) {
-	result = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + i);
-	if (result < 0) {
-	  /* error case */
-	  EC_DEBUG("I2C read error!\n");
-	  return -1;
-	}
-	product_name[i] = (unsigned char)result;
-	msleep(EC_DELAY);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, product_name, EC_PRODUCT_NAME_LEN);
+  if (ret) {
+    return ret;
   }
-  mutex_unlock(&data->idd_lock);
 
   return scnprintf(buf, PAGE_SIZE, "%c%c%c%c\n",
 	product_name[0], product_name[1], product_name[2], product_name[3]);
@@ -506,52 +498,32 @@ static ssize_t ec_customize_name_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int result, i, len = EC_CUST_NAME_LEN;
   unsigned char cust_name[EC_CUST_NAME_LEN];
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  for(i = 0; i < len; i++) {
-	result = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + i);
-	if (result < 0) {
-	  /* error case */
-	  EC_DEBUG("I2C read error!\n");
-	  return -1;
-	}
-	cust_name[i] = (unsigned char)result;
-	msleep(EC_DELAY);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, cust_name, EC_CUST_NAME_LEN);
+  if (ret) {
+    return ret;
   }
-  mutex_unlock(&data->idd_lock);
 
-  return scnprintf(buf, PAGE_SIZE, "%s\n", cust_name);
+  return scnprintf(buf, PAGE_SIZE, "%.*s\n", EC_CUST_NAME_LEN, cust_name);
 }
 
 static ssize_t ec_mac_addr_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int result, i, len = EC_MAC_LEN;
   unsigned char mac[EC_MAC_LEN];
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  for(i = 0; i < len; i++) {
-    result = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + i);
-    if (result < 0) {
-      /* error case */
-	  EC_DEBUG("I2C read error!\n");
-      return -1;
-    }
-    mac[i] = (unsigned char)result;
-    msleep(EC_DELAY);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, mac, EC_MAC_LEN);
+  if (ret) {
+    return ret;
   }
-  mutex_unlock(&data->idd_lock);
 
   return scnprintf(buf, PAGE_SIZE, "%02x:%02x:%02x:%02x:%02x:%02x\n",
 	mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
@@ -561,28 +533,17 @@ static ssize_t ec_serial_number_show(struct device *dev,
                                     struct device_attribute *attr,
                                     char *buf)
 {
-  struct i2c_client *client = to_i2c_client(dev);
-  i2c_dev_data_st *data = i2c_get_clientdata(client);
   i2c_sysfs_attr_st *i2c_attr = TO_I2C_SYSFS_ATTR(attr);
   const i2c_dev_attr_st *dev_attr = i2c_attr->isa_i2c_attr;
-  int result, i, len = EC_SERIAL_NUM;
   unsigned char serial[EC_SERIAL_NUM];
+  int ret;
 
-  mutex_lock(&data->idd_lock);
-  for(i = 0; i < len; i++) {
-	  result = i2c_smbus_read_byte_data_retry(client, dev_attr->ida_reg + i);
-	  if (result < 0) {
-	    /* error case */
-		EC_DEBUG("I2C read error!\n");
-	    return -1;
-	  }
-	  serial[i] = (unsigned char)result;
-	  //msleep(EC_DELAY / 4);
+  ret = ec_get_regs(dev, dev_attr->ida_reg, serial, EC_SERIAL_NUM);
+  if (ret) {
+    return ret;
   }
 
-  mutex_unlock(&data->idd_lock);
-
-  return scnprintf(buf, PAGE_SIZE, "%s\n", serial);
+  return scnprintf(buf, PAGE_SIZE, "%.*s\n", EC_SERIAL_NUM, serial);
 }
 
 static const i2c_dev_attr_st ec_attr_table[] = {
@@ -603,28 +564,28 @@ static const i2c_dev_attr_st ec_attr_table[] = {
   {
     "wdt_cfg",
     NULL,
-    ec_wdt_cfg_show,
+    ec_reg_hex_show,
     NULL,
     0x6, 0, 8,
   },
   {
     "wdt_crm",
     NULL,
-    ec_wdt_crm_show,
+    ec_reg_dec_show,
     NULL,
     0x7, 0, 8,
   },
   {
     "wdt_crs",
     NULL,
-    ec_wdt_crs_show,
+    ec_reg_dec_show,
     NULL,
     0x8, 0, 8,
   },
   {
     "hw_monitor_cfg",
     NULL,
-    ec_hw_monitor_cfg_show,
+    ec_reg_hex_show,
     NULL,
     0x15, 0, 8,
   },
@@ -659,14 +620,14 @@ static const i2c_dev_attr_st ec_attr_table[] = {
   {
     "gpio_dir",
     NULL,
-    ec_gpio_dir_show,
+    ec_reg_hex_show,
     NULL,
     0x2b, 0, 8,
   },
   {
     "gpio_data",
     NULL,
-    ec_gpio_data_show,
+    ec_reg_hex_show,
     NULL,
     0x2c, 0, 8,
   },
@@ -721,7 +682,7 @@ static const i2c_dev_attr_st ec_attr_table[] = {
   },
 };
 
-static i2c_dev_data_st ec_data;
+static ec_data_st ec_data;
 
 /*
  * EC i2c addresses.
@@ -748,17 +709,70 @@ static int ec_detect(struct i2c_client *client,
   return 0;
 }
 
+/*
+ * Use I2C block reads if the adapter can do them and a block read of the
+ * product name matches byte reads, i.e. the EC advances the register
+ * address within a block read.
+ */
+static bool ec_probe_block_read(struct i2c_client *client)
+{
+  u8 bytes[EC_PRODUCT_NAME_LEN];
+  u8 block[EC_PRODUCT_NAME_LEN];
+  bool distinct = false;
+  int i, val;
+
+  if (!i2c_check_functionality(client->adapter,
+                               I2C_FUNC_SMBUS_READ_I2C_BLOCK)) {
+    return false;
+  }
+
+  for (i = 0; i < EC_PRODUCT_NAME_LEN; i++) {
+    if (i) {
+      msleep(EC_DELAY);
+    }
+    val = i2c_smbus_read_byte_data_retry(client, 0x3c + i);
+    if (val < 0) {
+      return false;
+    }
+    bytes[i] = val;
+    distinct |= (bytes[i] != bytes[0]);
+  }
+  msleep(EC_DELAY);
+  if (ec_read_block_retry(client, 0x3c, EC_PRODUCT_NAME_LEN, block)) {
+    return false;
+  }
+
+  return distinct && !memcmp(bytes, block, EC_PRODUCT_NAME_LEN);
+}
+
 static int ec_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(ec_attr_table) / sizeof(ec_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &ec_data,
-                                 ec_attr_table, n_attrs);
+  ec_data_st *ec = &ec_data;
+  int ret;
+
+  memset(ec, 0, sizeof(*ec));
+  ec->client = client;
+  mutex_init(&ec->io_lock);
+  spin_lock_init(&ec->snap_lock);
+  INIT_DELAYED_WORK(&ec->refresh_work, ec_refresh_work);
+  ec->block_read = ec_probe_block_read(client);
+  EC_DEBUG("block read %s", ec->block_read ? "on" : "off");
+
+  ret = i2c_dev_sysfs_data_init(client, &ec->idd, ec_attr_table, n_attrs);
+  if (ret) {
+    return ret;
+  }
+
+  schedule_delayed_work(&ec->refresh_work, 0);
+  return 0;
 }
 
 static int ec_remove(struct i2c_client *client)
 {
-  i2c_dev_sysfs_data_clean(client, &ec_data);
+  cancel_delayed_work_sync(&ec_data.refresh_work);
+  i2c_dev_sysfs_data_clean(client, &ec_data.idd);
   return 0;
 }
 
@@ -92,6 +92,9 @@
 /* NVMe-MI SSD SMART Critical Warning */
 #define NVME_SMART_WARNING_MASK_BIT 0x1F // Check bit 0~4
 
+/* Age of the NVMe-MI data pal_drive_health() accepts from the cache */
+#define NVME_DATA_MAX_AGE_MS 1000
+
 const char pal_fru_list[] = "all, peb, pdpb, fcb";
 const char pal_fru_list_wo_all[] = "peb, pdpb, fcb";
 size_t pal_pwm_cnt = 1;
@@ -1562,8 +1565,13 @@ pal_write_error_code_file(const uint8_t error_num, const bool status) {
   return ret;
 }
 
+/*
+ * Print the NVMe-MI data of a drive, read in one basic management
+ * transaction. drive tells apart the drives behind a mux on one bus, the
+ * data is kept for pal_drive_health() on the same drive.
+ */
 int
-pal_drive_status(const char* i2c_bus) {
+pal_drive_status(const char* i2c_bus, int drive) {
   ssd_data ssd;
   t_status_flags status_flag_decoding;
   t_smart_warning smart_warning_decoding;
@@ -1572,49 +1580,46 @@ pal_drive_status(const char* i2c_bus) {
   t_key_value_pair vendor_decoding;
   t_key_value_pair sn_decoding;
 
-  if (nvme_vendor_read_decode(i2c_bus, &ssd.vendor, &vendor_decoding))
+  if (nvme_mi_basic_read_cached(i2c_bus, drive, 0, &ssd)) {
     printf("Fail on reading Vendor ID\n");
-  else
-    printf("%s: %s\n", vendor_decoding.key, vendor_decoding.value);
-
-  if (nvme_serial_num_read_decode(i2c_bus, ssd.serial_num, MAX_SERIAL_NUM, &sn_decoding))
     printf("Fail on reading Serial Number\n");
-  else
-    printf("%s: %s\n", sn_decoding.key, sn_decoding.value);
-
-  if (nvme_temp_read_decode(i2c_bus, &ssd.temp, &temp_decoding))
     printf("Fail on reading Composite Temperature\n");
-  else
-    printf("%s: %s\n", temp_decoding.key, temp_decoding.value);
-
-  if (nvme_pdlu_read_decode(i2c_bus, &ssd.pdlu, &pdlu_decoding))
     printf("Fail on reading Percentage Drive Life Used\n");
-  else
-    printf("%s: %s\n", pdlu_decoding.key, pdlu_decoding.value);
-
-  if (nvme_sflgs_read_decode(i2c_bus, &ssd.sflgs, &status_flag_decoding))
     printf("Fail on reading Status Flags\n");
-  else {
-    printf("%s: %s\n", status_flag_decoding.self.key, status_flag_decoding.self.value);
-    printf("    %s: %s\n", status_flag_decoding.read_complete.key, status_flag_decoding.read_complete.value);
-    printf("    %s: %s\n", status_flag_decoding.ready.key, status_flag_decoding.ready.value);
-    printf("    %s: %s\n", status_flag_decoding.functional.key, status_flag_decoding.functional.value);
-    printf("    %s: %s\n", status_flag_decoding.reset_required.key, status_flag_decoding.reset_required.value);
-    printf("    %s: %s\n", status_flag_decoding.port0_link.key, status_flag_decoding.port0_link.value);
-    printf("    %s: %s\n", status_flag_decoding.port1_link.key, status_flag_decoding.port1_link.value);
-  }
-
-  if (nvme_smart_warning_read_decode(i2c_bus, &ssd.warning, &smart_warning_decoding))
     printf("Fail on reading SMART Critical Warning\n");
-  else {
-    printf("%s: %s\n", smart_warning_decoding.self.key, smart_warning_decoding.self.value);
-    printf("    %s: %s\n", smart_warning_decoding.spare_space.key, smart_warning_decoding.spare_space.value);
-    printf("    %s: %s\n", smart_warning_decoding.temp_warning.key, smart_warning_decoding.temp_warning.value);
-    printf("    %s: %s\n", smart_warning_decoding.reliability.key, smart_warning_decoding.reliability.value);
-    printf("    %s: %s\n", smart_warning_decoding.media_status.key, smart_warning_decoding.media_status.value);
-    printf("    %s: %s\n", smart_warning_decoding.backup_device.key, smart_warning_decoding.backup_device.value);
+    printf("\n");
+    return 0;
   }
 
+  nvme_vendor_decode(ssd.vendor, &vendor_decoding);
+  printf("%s: %s\n", vendor_decoding.key, vendor_decoding.value);
+
+  nvme_serial_num_decode(ssd.serial_num, &sn_decoding);
+  printf("%s: %s\n", sn_decoding.key, sn_decoding.value);
+
+  nvme_temp_decode(ssd.temp, &temp_decoding);
+  printf("%s: %s\n", temp_decoding.key, temp_decoding.value);
+
+  nvme_pdlu_decode(ssd.pdlu, &pdlu_decoding);
+  printf("%s: %s\n", pdlu_decoding.key, pdlu_decoding.value);
+
+  nvme_sflgs_decode(ssd.sflgs, &status_flag_decoding);
+  printf("%s: %s\n", status_flag_decoding.self.key, status_flag_decoding.self.value);
+  printf("    %s: %s\n", status_flag_decoding.read_complete.key, status_flag_decoding.read_complete.value);
+  printf("    %s: %s\n", status_flag_decoding.ready.key, status_flag_decoding.ready.value);
+  printf("    %s: %s\n", status_flag_decoding.functional.key, status_flag_decoding.functional.value);
+  printf("    %s: %s\n", status_flag_decoding.reset_required.key, status_flag_decoding.reset_required.value);
+  printf("    %s: %s\n", status_flag_decoding.port0_link.key, status_flag_decoding.port0_link.value);
+  printf("    %s: %s\n", status_flag_decoding.port1_link.key, status_flag_decoding.port1_link.value);
+
+  nvme_smart_warning_decode(ssd.warning, &smart_warning_decoding);
+  printf("%s: %s\n", smart_warning_decoding.self.key, smart_warning_decoding.self.value);
+  printf("    %s: %s\n", smart_warning_decoding.spare_space.key, smart_warning_decoding.spare_space.value);
+  printf("    %s: %s\n", smart_warning_decoding.temp_warning.key, smart_warning_decoding.temp_warning.value);
+  printf("    %s: %s\n", smart_warning_decoding.reliability.key, smart_warning_decoding.reliability.value);
+  printf("    %s: %s\n", smart_warning_decoding.media_status.key, smart_warning_decoding.media_status.value);
+  printf("    %s: %s\n", smart_warning_decoding.backup_device.key, smart_warning_decoding.backup_device.value);
+
   printf("\n");
   return 0;
 }
@@ -1682,18 +1687,18 @@ pal_u2_flash_read_nvme_data(uint8_t slot_num, uint8_t cmd) {
 
   if (cmd == CMD_DRIVE_STATUS) {
     printf("Slot%d:\n", slot_num);
-    ret = pal_drive_status(bus);
+    ret = pal_drive_status(bus, slot_num);
     if(ret < 0) {
       syslog(LOG_DEBUG, "%s(): pal_drive_status failed", __func__);
       return -1;
     }
 
-    ret = pal_drive_health(bus);
+    ret = pal_drive_health(bus, slot_num);
     return ret;
   }
 
   else if (cmd == CMD_DRIVE_HEALTH) {
-    ret = pal_drive_health(bus);
+    ret = pal_drive_health(bus, slot_num);
     return ret;
   }
 
@@ -1739,6 +1744,7 @@ pal_m2_read_nvme_data(uint8_t slot_num, uint8_t m2_mux_chan, uint8_t cmd) {
   int ret;
   uint8_t mux;
   uint8_t chan;
+  int drive = (slot_num << 8) | m2_mux_chan;
   char bus[32];
 
   mux = lightning_flash_list[slot_num] / 10;
@@ -1769,18 +1775,18 @@ pal_m2_read_nvme_data(uint8_t slot_num, uint8_t m2_mux_chan, uint8_t cmd) {
 
   if (cmd == CMD_DRIVE_STATUS) {
     printf("Slot%d Drive%d\n", slot_num, m2_mux_chan);
-    ret = pal_drive_status(bus);
+    ret = pal_drive_status(bus, drive);
     if(ret < 0) {
       syslog(LOG_DEBUG, "%s(): pal_drive_status failed", __func__);
       return ret;
     }
 
-    ret = pal_drive_health(bus);
+    ret = pal_drive_health(bus, drive);
     return ret;
   }
 
   else if (cmd == CMD_DRIVE_HEALTH) {
-    ret = pal_drive_health(bus);
+    ret = pal_drive_health(bus, drive);
     return ret;
   }
 
@@ -1791,21 +1797,18 @@ pal_m2_read_nvme_data(uint8_t slot_num, uint8_t m2_mux_chan, uint8_t cmd) {
 }
 
 int
-pal_drive_health(const char* dev) {
-  uint8_t sflgs;
-  uint8_t warning;
+pal_drive_health(const char* dev, int drive) {
+  ssd_data ssd;
 
-  if (nvme_smart_warning_read(dev, &warning))
+  // Reuses the data of a pal_drive_status() call just before
+  if (nvme_mi_basic_read_cached(dev, drive, NVME_DATA_MAX_AGE_MS, &ssd))
     return -1;
-  else
-    if ((warning & NVME_SMART_WARNING_MASK_BIT) != NVME_SMART_WARNING_MASK_BIT)
-      return -1;
 
-  if (nvme_sflgs_read(dev, &sflgs))
+  if ((ssd.warning & NVME_SMART_WARNING_MASK_BIT) != NVME_SMART_WARNING_MASK_BIT)
+    return -1;
+
+  if ((ssd.sflgs & NVME_SFLGS_MASK_BIT) != NVME_SFLGS_CHECK_VALUE)
     return -1;
-  else
-    if ((sflgs & NVME_SFLGS_MASK_BIT) != NVME_SFLGS_CHECK_VALUE)
-      return -1;
 
   return 0;
 }
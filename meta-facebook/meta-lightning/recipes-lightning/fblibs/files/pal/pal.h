@@ -213,12 +213,12 @@ void pal_err_code_enable(const uint8_t error_num);
 void pal_err_code_disable(const uint8_t error_num);
 int pal_read_error_code_file(uint8_t *error_code_arrray);
 int pal_write_error_code_file(const uint8_t error_num, const bool status);
-int pal_drive_status(const char* dev);
+int pal_drive_status(const char* dev, int drive);
 int pal_read_nvme_data(uint8_t slot_num, uint8_t cmd);
 int pal_u2_flash_read_nvme_data(uint8_t slot_num, uint8_t cmd);
 int pal_m2_flash_read_nvme_data(uint8_t slot_num, uint8_t cmd);
 int pal_m2_read_nvme_data(uint8_t i2c_map, uint8_t m2_mux_chan, uint8_t cmd);
-int pal_drive_health(const char* dev);
+int pal_drive_health(const char* dev, int drive);
 void pal_i2c_crash_assert_handle(int i2c_bus_num);
 void pal_i2c_crash_deassert_handle(int i2c_bus_num);
 uint8_t pal_get_status(void);
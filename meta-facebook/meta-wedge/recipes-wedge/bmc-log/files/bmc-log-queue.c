@@ -0,0 +1,582 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/param.h>
+#include <sys/uio.h>
+#include <linux/sockios.h>
+#include "bmc-log-queue.h"
+
+/* Record of a spooled message, followed by the message */
+typedef struct {
+	uint32_t seq;
+	uint16_t len;
+} __attribute__((packed)) lq_spool_rec_t;
+
+static uint64_t lq_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void lq_fill(lq_t *q, lq_entry_t *e, uint32_t seq, const char *msg, size_t len)
+{
+	char seq_str[12];
+	int n;
+
+	e->seq = seq;
+	e->len = len;
+	if (e->msg != msg) {
+		memcpy(e->msg, msg, len);
+	}
+
+	e->hdr_len = 0;
+	if (q->stream) {
+		/* The frame length counts "<seq> " and the message */
+		n = snprintf(seq_str, sizeof(seq_str), "%u ", seq);
+		e->hdr_len = snprintf(e->hdr, sizeof(e->hdr), "%zu %s", n + len, seq_str);
+	}
+}
+
+static size_t lq_frame_len(lq_entry_t *e)
+{
+	return e->hdr_len + e->len;
+}
+
+static uint32_t lq_spooled(lq_t *q)
+{
+	return q->spool_msgs[0] + q->spool_msgs[1];
+}
+
+static void lq_spool_name(lq_t *q, unsigned int gen, char *path, size_t size)
+{
+	snprintf(path, size, "%s.%u", q->spool_path, gen & 1);
+}
+
+static void lq_spool_remove(lq_t *q, unsigned int gen)
+{
+	char path[PATH_MAX];
+	int i = gen & 1;
+
+	if (q->spool_fd[i] >= 0) {
+		close(q->spool_fd[i]);
+		q->spool_fd[i] = -1;
+	}
+	lq_spool_name(q, gen, path, sizeof(path));
+	unlink(path);
+	q->spool_size[i] = 0;
+	q->spool_msgs[i] = 0;
+}
+
+/* Drop the file being read, the oldest spooled messages */
+static void lq_spool_drop(lq_t *q)
+{
+	q->stats.msgs_dropped += q->spool_msgs[q->rd_gen & 1];
+	lq_spool_remove(q, q->rd_gen);
+	q->rd_gen++;
+	q->rd_off = 0;
+}
+
+/*
+ * Append a message to the spool. Each file takes half of spool_max; when
+ * both are full, the older one is dropped, or nothing is taken with
+ * LQ_BLOCK.
+ */
+static bool lq_spool(lq_t *q, uint32_t seq, const char *msg, size_t len)
+{
+	char path[PATH_MAX];
+	lq_spool_rec_t rec;
+	struct iovec iov[2];
+	int w = q->wr_gen & 1;
+
+	if (q->spool_size[w] > 0 && q->spool_size[w] + sizeof(rec) + len > q->spool_max / 2) {
+		if (q->wr_gen != q->rd_gen) {
+			if (q->policy == LQ_BLOCK) {
+				return false;
+			}
+			lq_spool_drop(q);
+		}
+		q->wr_gen++;
+		w = q->wr_gen & 1;
+	}
+
+	if (q->spool_fd[w] < 0) {
+		lq_spool_name(q, q->wr_gen, path, sizeof(path));
+		q->spool_fd[w] = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (q->spool_fd[w] < 0) {
+			q->stats.spool_errors++;
+			return false;
+		}
+	}
+
+	rec.seq = seq;
+	rec.len = len;
+	iov[0].iov_base = &rec;
+	iov[0].iov_len = sizeof(rec);
+	iov[1].iov_base = (void *)msg;
+	iov[1].iov_len = len;
+	if (pwritev(q->spool_fd[w], iov, 2, q->spool_size[w]) != sizeof(rec) + len) {
+		q->stats.spool_errors++;
+		return false;
+	}
+
+	q->spool_size[w] += sizeof(rec) + len;
+	q->spool_msgs[w]++;
+	q->stats.msgs_spooled++;
+	return true;
+}
+
+/* Move spooled messages into the ring as it has room */
+static void lq_refill(lq_t *q)
+{
+	lq_spool_rec_t rec;
+	lq_entry_t *e;
+	int r;
+
+	while (lq_spooled(q) > 0 && q->tail - q->head < q->ring_size) {
+		r = q->rd_gen & 1;
+		if (q->spool_msgs[r] == 0) {
+			lq_spool_remove(q, q->rd_gen);
+			q->rd_gen++;
+			q->rd_off = 0;
+			continue;
+		}
+
+		e = &q->ring[q->tail % q->ring_size];
+		if (pread(q->spool_fd[r], &rec, sizeof(rec), q->rd_off) != sizeof(rec) ||
+		    rec.len >= LQ_MSG_LEN ||
+		    pread(q->spool_fd[r], e->msg, rec.len, q->rd_off + sizeof(rec)) != rec.len) {
+			q->stats.spool_errors++;
+			lq_spool_drop(q);
+			continue;
+		}
+
+		lq_fill(q, e, rec.seq, e->msg, rec.len);
+		q->tail++;
+		q->rd_off += sizeof(rec) + rec.len;
+		q->spool_msgs[r]--;
+	}
+
+	if (q->spool_path && lq_spooled(q) == 0 && (q->spool_size[0] || q->spool_size[1])) {
+		lq_spool_remove(q, 0);
+		lq_spool_remove(q, 1);
+		q->rd_gen = q->wr_gen = 0;
+		q->rd_off = 0;
+	}
+}
+
+static void lq_up(lq_t *q)
+{
+	q->state = LQ_UP;
+	q->backoff = LQ_RETRY_MIN;
+	q->stats.connects++;
+}
+
+/* Close the link, and send the messages not acked again after reconnecting */
+static void lq_down(lq_t *q)
+{
+	if (q->fd >= 0) {
+		close(q->fd);
+		q->fd = -1;
+	}
+	if (q->state == LQ_UP) {
+		q->stats.disconnects++;
+	}
+	q->state = LQ_DOWN;
+	q->retry_at = lq_now() + q->backoff;
+	q->backoff = MIN(q->backoff * 2, LQ_RETRY_MAX);
+
+	q->stats.msgs_resent += q->sent - q->head;
+	q->sent = q->head;
+	q->sent_off = 0;
+	q->stream_off = 0;
+}
+
+static void lq_connect(lq_t *q)
+{
+	int type = (q->stream ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+	q->fd = socket(q->addr.ss_family, type, 0);
+	if (q->fd < 0) {
+		lq_down(q);
+		return;
+	}
+
+	if (connect(q->fd, (struct sockaddr *)&q->addr, q->addr_len) == 0) {
+		lq_up(q);
+	} else if (errno == EINPROGRESS) {
+		q->state = LQ_CONNECTING;
+	} else {
+		lq_down(q);
+	}
+}
+
+/* Release the messages TCP acked: all but the bytes still in the send queue */
+static void lq_ack(lq_t *q)
+{
+	uint64_t acked;
+	int outq;
+
+	if (q->state != LQ_UP || ioctl(q->fd, SIOCOUTQ, &outq) < 0) {
+		return;
+	}
+
+	acked = q->stream_off - outq;
+	while (q->head < q->sent && q->ring[q->head % q->ring_size].end <= acked) {
+		q->head++;
+	}
+}
+
+/* One sendmsg() of the frames not sent, returns -1 if the link failed */
+static int lq_send_stream(lq_t *q)
+{
+	struct iovec iov[2 * LQ_BATCH];
+	struct msghdr mh;
+	lq_entry_t *e;
+	uint64_t i, pos;
+	size_t skip, rem;
+	ssize_t w;
+	int cnt = 0;
+
+	for (i = q->sent; i < q->tail && cnt + 2 <= 2 * LQ_BATCH; i++) {
+		e = &q->ring[i % q->ring_size];
+		skip = (i == q->sent) ? q->sent_off : 0;
+		if (skip < e->hdr_len) {
+			iov[cnt].iov_base = e->hdr + skip;
+			iov[cnt].iov_len = e->hdr_len - skip;
+			cnt++;
+			skip = 0;
+		} else {
+			skip -= e->hdr_len;
+		}
+		iov[cnt].iov_base = e->msg + skip;
+		iov[cnt].iov_len = e->len - skip;
+		cnt++;
+	}
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = cnt;
+	w = sendmsg(q->fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (w < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+	q->stats.sends++;
+	q->stats.bytes_sent += w;
+
+	pos = q->stream_off;
+	q->stream_off += w;
+	while (w > 0) {
+		e = &q->ring[q->sent % q->ring_size];
+		rem = lq_frame_len(e) - q->sent_off;
+		if (w < rem) {
+			q->sent_off += w;
+			break;
+		}
+		w -= rem;
+		pos += rem;
+		e->end = pos;
+		q->sent_off = 0;
+		q->sent++;
+		q->stats.msgs_sent++;
+	}
+
+	return 1;
+}
+
+/* One sendmmsg() of the datagrams not sent, returns -1 if the link failed */
+static int lq_send_dgram(lq_t *q)
+{
+	struct mmsghdr mm[LQ_BATCH];
+	struct iovec iov[LQ_BATCH];
+	lq_entry_t *e;
+	int cnt, i, r;
+
+	memset(mm, 0, sizeof(mm));
+	for (cnt = 0; cnt < LQ_BATCH && q->sent + cnt < q->tail; cnt++) {
+		e = &q->ring[(q->sent + cnt) % q->ring_size];
+		iov[cnt].iov_base = e->msg;
+		iov[cnt].iov_len = e->len;
+		mm[cnt].msg_hdr.msg_iov = &iov[cnt];
+		mm[cnt].msg_hdr.msg_iovlen = 1;
+	}
+
+	r = sendmmsg(q->fd, mm, cnt, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (r < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+	q->stats.sends++;
+	for (i = 0; i < r; i++) {
+		q->stats.bytes_sent += mm[i].msg_len;
+	}
+
+	/* Nothing to ack with datagrams */
+	q->sent += r;
+	q->head = q->sent;
+	q->stats.msgs_sent += r;
+	return r > 0;
+}
+
+static void lq_flush(lq_t *q)
+{
+	int ret;
+
+	while (q->state == LQ_UP) {
+		if (q->stream) {
+			lq_ack(q);
+		}
+		lq_refill(q);
+		if (q->sent == q->tail) {
+			break;
+		}
+		ret = q->stream ? lq_send_stream(q) : lq_send_dgram(q);
+		if (ret < 0) {
+			lq_down(q);
+		} else if (ret == 0) {
+			break;
+		}
+	}
+}
+
+/* Free the oldest slot of the full ring */
+static bool lq_drop_oldest(lq_t *q)
+{
+	if (q->head < q->sent) {
+		/* Already sent, only given up for resending */
+		q->head++;
+		return true;
+	}
+	if (q->sent_off) {
+		/* Partly written, the frame has to be completed */
+		return false;
+	}
+	q->head++;
+	q->sent++;
+	q->stats.msgs_dropped++;
+	return true;
+}
+
+/* Wait a little for room in the queue, false if interrupted by a signal */
+static bool lq_wait(lq_t *q)
+{
+	fd_set rset, wset;
+	struct timeval tv;
+	int fdmax = -1;
+	int ms;
+
+	FD_ZERO(&rset);
+	FD_ZERO(&wset);
+	ms = lq_fdset(q, &rset, &wset, &fdmax);
+	if (ms < 0 || ms > LQ_ACK_POLL) {
+		ms = LQ_ACK_POLL;
+	}
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+
+	if (select(fdmax + 1, &rset, &wset, NULL, &tv) < 0) {
+		if (errno == EINTR) {
+			return false;
+		}
+		FD_ZERO(&rset);
+		FD_ZERO(&wset);
+	}
+	lq_service(q, &rset, &wset);
+	return true;
+}
+
+bool lq_push(lq_t *q, const char *msg, size_t len)
+{
+	if (len >= LQ_MSG_LEN) {
+		len = LQ_MSG_LEN - 1;
+	}
+	q->stats.msgs_in++;
+
+	while (1) {
+		if (q->stream && q->tail - q->head == q->ring_size) {
+			lq_ack(q);
+			lq_refill(q);
+		}
+
+		/* Spooled messages go first */
+		if (lq_spooled(q) == 0 && q->tail - q->head < q->ring_size) {
+			lq_fill(q, &q->ring[q->tail % q->ring_size], q->next_seq++, msg, len);
+			q->tail++;
+			return true;
+		}
+
+		if (q->spool_path) {
+			if (lq_spool(q, q->next_seq, msg, len)) {
+				q->next_seq++;
+				return true;
+			}
+			if (q->policy == LQ_DROP_OLDEST) {
+				/* The spool failed */
+				q->stats.msgs_dropped++;
+				return true;
+			}
+		}
+
+		if (q->policy == LQ_BLOCK) {
+			if (q->head < q->sent) {
+				/* Sent, rather give up resending it than wait for the ack */
+				q->head++;
+			} else if (!lq_wait(q)) {
+				return false;
+			}
+		} else if (!lq_drop_oldest(q)) {
+			q->stats.msgs_dropped++;
+			return true;
+		}
+	}
+}
+
+int lq_fdset(lq_t *q, fd_set *rset, fd_set *wset, int *fdmax)
+{
+	uint64_t now;
+
+	switch (q->state) {
+	case LQ_DOWN:
+		if (q->addr_len == 0) {
+			return -1;
+		}
+		now = lq_now();
+		return (q->retry_at > now) ? q->retry_at - now : 0;
+
+	case LQ_CONNECTING:
+		FD_SET(q->fd, wset);
+		*fdmax = MAX(*fdmax, q->fd);
+		return -1;
+
+	case LQ_UP:
+		if (q->sent < q->tail || lq_spooled(q) > 0) {
+			FD_SET(q->fd, wset);
+		}
+		if (q->stream) {
+			/* The server closing the connection */
+			FD_SET(q->fd, rset);
+		}
+		*fdmax = MAX(*fdmax, q->fd);
+		return (q->stream && q->head < q->sent) ? LQ_ACK_POLL : -1;
+	}
+
+	return -1;
+}
+
+void lq_service(lq_t *q, fd_set *rset, fd_set *wset)
+{
+	char buf[64];
+	socklen_t len;
+	ssize_t n;
+	int err;
+
+	switch (q->state) {
+	case LQ_DOWN:
+		if (q->addr_len && lq_now() >= q->retry_at) {
+			lq_connect(q);
+		}
+		break;
+
+	case LQ_CONNECTING:
+		if (FD_ISSET(q->fd, wset)) {
+			len = sizeof(err);
+			if (getsockopt(q->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) {
+				lq_down(q);
+			} else {
+				lq_up(q);
+			}
+		}
+		break;
+
+	case LQ_UP:
+		if (q->stream && FD_ISSET(q->fd, rset)) {
+			n = recv(q->fd, buf, sizeof(buf), MSG_DONTWAIT);
+			if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+				lq_down(q);
+			}
+		}
+		break;
+	}
+
+	lq_flush(q);
+	lq_refill(q);
+}
+
+void lq_get_stats(lq_t *q, lq_stats_t *stats)
+{
+	*stats = q->stats;
+	stats->queued = (q->tail - q->head) + lq_spooled(q);
+}
+
+void lq_set_addr(lq_t *q, const struct sockaddr *addr, socklen_t addr_len)
+{
+	memcpy(&q->addr, addr, addr_len);
+	q->addr_len = addr_len;
+	q->retry_at = 0;
+}
+
+bool lq_init(lq_t *q, int ring_size, lq_policy_t policy, bool stream,
+	     const char *spool_path, size_t spool_max)
+{
+	memset(q, 0, sizeof(*q));
+	q->ring_size = ring_size;
+	q->policy = policy;
+	q->stream = stream;
+	q->spool_path = spool_path;
+	q->spool_max = spool_max;
+	q->spool_fd[0] = q->spool_fd[1] = -1;
+	q->fd = -1;
+	q->state = LQ_DOWN;
+	q->backoff = LQ_RETRY_MIN;
+	q->next_seq = 1;
+
+	q->ring = calloc(ring_size, sizeof(lq_entry_t));
+	if (!q->ring) {
+		return false;
+	}
+
+	/* Left over from before a restart, the sequence starts over */
+	if (spool_path) {
+		lq_spool_remove(q, 0);
+		lq_spool_remove(q, 1);
+	}
+
+	return true;
+}
+
+void lq_close(lq_t *q)
+{
+	if (q->fd >= 0) {
+		close(q->fd);
+		q->fd = -1;
+	}
+	if (q->spool_path) {
+		lq_spool_remove(q, 0);
+		lq_spool_remove(q, 1);
+	}
+	free(q->ring);
+	q->ring = NULL;
+}
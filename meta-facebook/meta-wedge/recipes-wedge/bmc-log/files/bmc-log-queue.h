@@ -0,0 +1,144 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef BMC_LOG_QUEUE_H_
+#define BMC_LOG_QUEUE_H_
+
+/*
+ * Output queue of bmc-log: the log messages wait in a ring in memory and,
+ * when the ring is full, in an optional spool file, until they are sent
+ * to the log server in batches.
+ *
+ * Over UDP every message is one datagram, as netcons expects. Over TCP
+ * every message is an octet-counted frame (RFC 6587) whose payload starts
+ * with the sequence number of the message:
+ *
+ *	"<frame len> <seq> kernel: <version> - msg <line>"
+ *
+ * Sent messages stay in the ring until TCP acked them, or until the ring
+ * needs their slot for a new message, and are sent again after a reconnect.
+ * The server may get a message twice and drops it by seq.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+/* Default sizes */
+#define LQ_RING_MSGS (256)
+#define LQ_SPOOL_MAX (1024*1024)
+#define LQ_MSG_LEN (1025)
+#define LQ_HDR_LEN (24)
+#define LQ_BATCH (64)	// messages per sendmmsg()/sendmsg()
+
+/* Reconnect backoff and TCP ack polling in msec */
+#define LQ_RETRY_MIN (500)
+#define LQ_RETRY_MAX (30000)
+#define LQ_ACK_POLL (100)
+
+/* What to do with new messages when the ring and the spool are full */
+typedef enum {
+	LQ_DROP_OLDEST,
+	LQ_BLOCK,
+} lq_policy_t;
+
+typedef enum {
+	LQ_DOWN,
+	LQ_CONNECTING,
+	LQ_UP,
+} lq_state_t;
+
+typedef struct {
+	uint32_t seq;
+	uint16_t len;
+	uint16_t hdr_len;
+	uint64_t end;	// stream offset past the frame, to tell when it is acked
+	char hdr[LQ_HDR_LEN];
+	char msg[LQ_MSG_LEN];
+} lq_entry_t;
+
+typedef struct {
+	uint64_t msgs_in;
+	uint64_t msgs_sent;
+	uint64_t bytes_sent;
+	uint64_t msgs_dropped;
+	uint64_t msgs_spooled;
+	uint64_t msgs_resent;	// sent again after a reconnect
+	uint64_t sends;		// sendmmsg()/sendmsg() calls
+	uint64_t connects;
+	uint64_t disconnects;
+	uint64_t spool_errors;
+	uint32_t queued;	// messages in the ring and the spool
+} lq_stats_t;
+
+typedef struct {
+	/* Configuration */
+	int ring_size;
+	lq_policy_t policy;
+	bool stream;
+	const char *spool_path;
+	size_t spool_max;
+
+	/* Ring: [head, sent) sent but not acked, [sent, tail) not sent */
+	lq_entry_t *ring;
+	uint64_t head, sent, tail;
+	size_t sent_off;	// bytes of ring[sent] already written
+	uint64_t stream_off;	// bytes written on this connection
+	uint32_t next_seq;
+
+	/* Spool: messages newer than the ring, in up to two files */
+	int spool_fd[2];
+	off_t spool_size[2];
+	uint32_t spool_msgs[2];
+	unsigned int rd_gen, wr_gen;
+	off_t rd_off;
+
+	/* Link to the log server */
+	lq_state_t state;
+	int fd;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	int backoff;
+	uint64_t retry_at;
+
+	lq_stats_t stats;
+} lq_t;
+
+bool lq_init(lq_t *q, int ring_size, lq_policy_t policy, bool stream,
+	     const char *spool_path, size_t spool_max);
+void lq_set_addr(lq_t *q, const struct sockaddr *addr, socklen_t addr_len);
+void lq_close(lq_t *q);
+
+/*
+ * Queue a message. Returns false if it was not queued: with LQ_BLOCK, when
+ * a signal interrupted the wait for room.
+ */
+bool lq_push(lq_t *q, const char *msg, size_t len);
+
+/* Add the link fd to the select() sets, returns the timeout in msec or -1 */
+int lq_fdset(lq_t *q, fd_set *rset, fd_set *wset, int *fdmax);
+
+/* Connect, send, and handle acks and disconnects after select() */
+void lq_service(lq_t *q, fd_set *rset, fd_set *wset);
+
+void lq_get_stats(lq_t *q, lq_stats_t *stats);
+
+#endif
@@ -0,0 +1,534 @@
+/*
+ * Copyright 2014-present Facebook. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Tests of the bmc-log output queue against a log server on the loopback:
+ * a TCP sink that can be slow, drop the connection every so many frames
+ * or come up late, and a UDP sink.
+ *
+ * eg: bmc-log-test
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "bmc-log-queue.h"
+
+#define SPOOL_PATH "/tmp/bmc-log-test.spool"
+
+typedef struct {
+	bool stream;
+	int delay_us;		// after every read
+	int chunk;		// bytes per read
+	int rcvbuf;
+	int flap_every;		// frames before dropping the connection
+	int late_ms;		// before listening
+	/* Results */
+	int port;
+	uint32_t frames;
+	uint32_t unique;
+	uint32_t dups;
+	uint32_t disorder;
+	uint32_t bad;
+	uint32_t flaps;
+	uint32_t last_seq;
+	uint32_t last_idx;
+	uint8_t *seen;
+	int max_seq;
+	volatile bool stop;
+	pthread_t tid;
+} sink_t;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+static double now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* A message: "<seq> kernel: test - msg line <idx>" */
+static void sink_msg(sink_t *s, const char *p, size_t len)
+{
+	char buf[LQ_MSG_LEN + 16];
+	unsigned int seq, idx;
+
+	s->frames++;
+	if (len >= sizeof(buf)) {
+		s->bad++;
+		return;
+	}
+	memcpy(buf, p, len);
+	buf[len] = 0;
+	if (s->stream) {
+		if (sscanf(buf, "%u kernel: test - msg line %u", &seq, &idx) != 2) {
+			s->bad++;
+			return;
+		}
+	} else {
+		if (sscanf(buf, "kernel: test - msg line %u", &idx) != 1) {
+			s->bad++;
+			return;
+		}
+		seq = idx + 1;
+	}
+	if (seq >= s->max_seq) {
+		s->bad++;
+		return;
+	}
+
+	if (s->seen[seq]) {
+		s->dups++;
+		return;
+	}
+	s->seen[seq] = 1;
+	s->unique++;
+	/* New messages come in order */
+	if (seq < s->last_seq || idx < s->last_idx) {
+		s->disorder++;
+	}
+	s->last_seq = seq;
+	s->last_idx = idx;
+}
+
+/* Parse "<len> <payload>" frames, returns the bytes used */
+static size_t sink_frames(sink_t *s, char *buf, size_t len)
+{
+	size_t used = 0, flen;
+	char *sp, *end;
+
+	while (used < len) {
+		sp = memchr(buf + used, ' ', len - used);
+		if (!sp) {
+			break;
+		}
+		flen = strtoul(buf + used, &end, 10);
+		if (end != sp || flen == 0 || flen > LQ_MSG_LEN + 12) {
+			s->bad++;
+			return len;
+		}
+		if (sp + 1 + flen > buf + len) {
+			break;
+		}
+		sink_msg(s, sp + 1, flen);
+		used = sp + 1 + flen - buf;
+		if (s->flap_every && s->frames % s->flap_every == 0) {
+			s->flaps++;
+			return (size_t)-1;
+		}
+	}
+	return used;
+}
+
+static void *sink_stream(void *arg)
+{
+	sink_t *s = arg;
+	static char buf[65536];
+	struct timeval tv = { 0, 50000 };
+	struct sockaddr_in addr;
+	size_t have = 0, used;
+	int lfd, fd = -1;
+	ssize_t n;
+	int one = 1;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (s->rcvbuf) {
+		setsockopt(lfd, SOL_SOCKET, SO_RCVBUF, &s->rcvbuf, sizeof(s->rcvbuf));
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(s->port);
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return NULL;
+	}
+	usleep(s->late_ms * 1000);
+	listen(lfd, 4);
+	setsockopt(lfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	while (!s->stop) {
+		if (fd < 0) {
+			fd = accept(lfd, NULL, NULL);
+			if (fd < 0) {
+				continue;
+			}
+			setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+			have = 0;
+		}
+		n = read(fd, buf + have, s->chunk ? s->chunk : sizeof(buf) - have);
+		if (n <= 0) {
+			if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+				close(fd);
+				fd = -1;
+			}
+			continue;
+		}
+		have += n;
+		used = sink_frames(s, buf, have);
+		if (used == (size_t)-1) {
+			/* Go away, whatever the client sends now is lost */
+			close(fd);
+			fd = -1;
+			continue;
+		}
+		memmove(buf, buf + used, have - used);
+		have -= used;
+		if (s->delay_us) {
+			usleep(s->delay_us);
+		}
+	}
+
+	if (fd >= 0) {
+		close(fd);
+	}
+	close(lfd);
+	return NULL;
+}
+
+static void *sink_dgram(void *arg)
+{
+	sink_t *s = arg;
+	char buf[LQ_MSG_LEN];
+	struct timeval tv = { 0, 50000 };
+	struct sockaddr_in addr;
+	int rcvbuf = 4 * 1024 * 1024;
+	ssize_t n;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(s->port);
+	bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+	while (!s->stop) {
+		n = recv(fd, buf, sizeof(buf), 0);
+		if (n > 0) {
+			sink_msg(s, buf, n);
+		}
+	}
+	close(fd);
+	return NULL;
+}
+
+static int sink_port = 24500;
+
+static void sink_start(sink_t *s, int max_seq)
+{
+	s->port = sink_port++;
+	s->max_seq = max_seq + 2;
+	s->seen = calloc(s->max_seq, 1);
+	pthread_create(&s->tid, NULL, s->stream ? sink_stream : sink_dgram, s);
+	usleep(20000);
+}
+
+static void sink_stop(sink_t *s)
+{
+	s->stop = true;
+	pthread_join(s->tid, NULL);
+	free(s->seen);
+}
+
+/* One round of the bmc-log main loop, without the TTYs */
+static void loop_once(lq_t *q, int max_ms)
+{
+	fd_set rset, wset;
+	struct timeval tv;
+	int fdmax = -1;
+	int ms;
+
+	FD_ZERO(&rset);
+	FD_ZERO(&wset);
+	ms = lq_fdset(q, &rset, &wset, &fdmax);
+	if (ms < 0 || ms > max_ms) {
+		ms = max_ms;
+	}
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	if (select(fdmax + 1, &rset, &wset, NULL, &tv) < 0) {
+		FD_ZERO(&rset);
+		FD_ZERO(&wset);
+	}
+	lq_service(q, &rset, &wset);
+}
+
+static void drain(lq_t *q, int timeout_ms)
+{
+	double end = now_ms() + timeout_ms;
+	lq_stats_t st;
+
+	do {
+		loop_once(q, 10);
+		lq_get_stats(q, &st);
+	} while (st.queued && now_ms() < end);
+}
+
+/*
+ * Push n messages, burst at a time with a round of the main loop in
+ * between, like lines read from the TTY. Returns msec taken.
+ */
+static double produce(lq_t *q, int n, int burst, int burst_us, int pad)
+{
+	char msg[LQ_MSG_LEN];
+	double start = now_ms();
+	int i, len;
+
+	for (i = 0; i < n; i++) {
+		len = snprintf(msg, sizeof(msg), "kernel: test - msg line %u %*s", i, pad, "");
+		lq_push(q, msg, len);
+		if ((i + 1) % burst == 0) {
+			loop_once(q, 0);
+			if (burst_us) {
+				usleep(burst_us);
+			}
+		}
+	}
+	return now_ms() - start;
+}
+
+static void setup(lq_t *q, sink_t *s, int ring, lq_policy_t policy, const char *spool, size_t spool_max)
+{
+	struct sockaddr_in addr;
+
+	lq_init(q, ring, policy, s->stream, spool, spool_max);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(s->port);
+	lq_set_addr(q, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void report(const char *name, lq_t *q, sink_t *s, int n, double ms)
+{
+	lq_stats_t st;
+
+	lq_get_stats(q, &st);
+	printf("%-22s %6d msgs %6.0f ms: sent %llu in %llu sends, dropped %llu, spooled %llu, "
+	       "resent %llu, reconnects %llu; got %u (%u dups)\n",
+	       name, n, ms, (unsigned long long)st.msgs_sent, (unsigned long long)st.sends,
+	       (unsigned long long)st.msgs_dropped, (unsigned long long)st.msgs_spooled,
+	       (unsigned long long)st.msgs_resent, (unsigned long long)st.disconnects,
+	       s->unique, s->dups);
+}
+
+/* What the old bmc-log did: a write() per message */
+static void test_baseline(bool stream, int n)
+{
+	sink_t s = { .stream = stream };
+	struct sockaddr_in addr;
+	char body[LQ_MSG_LEN], msg[LQ_MSG_LEN + LQ_HDR_LEN];
+	double start, ms;
+	int fd, i, len;
+
+	sink_start(&s, n);
+	fd = socket(AF_INET, stream ? SOCK_STREAM : SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(s.port);
+	connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+	start = now_ms();
+	for (i = 0; i < n; i++) {
+		if (stream) {
+			len = snprintf(body, sizeof(body), "%u kernel: test - msg line %u", i + 1, i);
+			len = snprintf(msg, sizeof(msg), "%d %s", len, body);
+		} else {
+			len = snprintf(msg, sizeof(msg), "kernel: test - msg line %u", i);
+		}
+		if (write(fd, msg, len) < 0) {
+			break;
+		}
+	}
+	ms = now_ms() - start;
+	usleep(100000);
+	printf("%-22s %6d msgs %6.0f ms: %d write() calls; got %u\n",
+	       stream ? "old, tcp" : "old, udp", n, ms, n, s.unique);
+	close(fd);
+	sink_stop(&s);
+}
+
+static void test_fast(bool stream, int n)
+{
+	sink_t s = { .stream = stream };
+	lq_t q;
+	lq_stats_t st;
+	double ms;
+
+	sink_start(&s, n);
+	setup(&q, &s, LQ_RING_MSGS, LQ_BLOCK, NULL, 0);
+	ms = produce(&q, n, 64, 0, 0);
+	drain(&q, 5000);
+	usleep(100000);
+	report(stream ? "fast, tcp" : "fast, udp", &q, &s, n, ms);
+
+	lq_get_stats(&q, &st);
+	CHECK(st.msgs_dropped == 0);
+	CHECK(s.bad == 0 && s.disorder == 0 && s.dups == 0);
+	if (stream) {
+		CHECK(s.unique == n);
+	}
+	CHECK(st.sends * 8 < n);
+	lq_close(&q);
+	sink_stop(&s);
+}
+
+/* A slow server and a small ring: the oldest are dropped, in order otherwise */
+static void test_slow_drop(int n)
+{
+	sink_t s = { .stream = true, .delay_us = 2000, .chunk = 4096, .rcvbuf = 4096 };
+	lq_t q;
+	lq_stats_t st;
+	double ms;
+
+	sink_start(&s, n);
+	setup(&q, &s, 64, LQ_DROP_OLDEST, NULL, 0);
+	ms = produce(&q, n, 16, 100, 1000);
+	drain(&q, 10000);
+	usleep(100000);
+	report("slow, drop oldest", &q, &s, n, ms);
+
+	lq_get_stats(&q, &st);
+	CHECK(st.msgs_dropped > 0);
+	CHECK(s.unique + st.msgs_dropped == n);
+	CHECK(s.bad == 0 && s.disorder == 0);
+	lq_close(&q);
+	sink_stop(&s);
+}
+
+/* A slow server and LQ_BLOCK: the producer is held back, nothing is lost */
+static void test_slow_block(int n)
+{
+	sink_t s = { .stream = true, .delay_us = 2000, .chunk = 4096, .rcvbuf = 4096 };
+	lq_t q;
+	lq_stats_t st;
+	double ms;
+
+	sink_start(&s, n);
+	setup(&q, &s, 64, LQ_BLOCK, NULL, 0);
+	ms = produce(&q, n, 16, 100, 1000);
+	drain(&q, 10000);
+	usleep(100000);
+	report("slow, block", &q, &s, n, ms);
+
+	lq_get_stats(&q, &st);
+	CHECK(st.msgs_dropped == 0);
+	CHECK(s.unique == n);
+	CHECK(s.bad == 0 && s.disorder == 0);
+	lq_close(&q);
+	sink_stop(&s);
+}
+
+/*
+ * The server drops the connection every 3000 frames. What it had not read
+ * yet is lost although TCP acked it; everything else is sent again.
+ */
+static void test_flap(int n)
+{
+	sink_t s = { .stream = true, .flap_every = 3000 };
+	lq_t q;
+	lq_stats_t st;
+	double ms;
+	int lost;
+
+	sink_start(&s, n);
+	setup(&q, &s, LQ_RING_MSGS, LQ_DROP_OLDEST, SPOOL_PATH, LQ_SPOOL_MAX);
+	ms = produce(&q, n, 16, 20, 0);
+	drain(&q, 20000);
+	usleep(100000);
+	report("flapping, spool", &q, &s, n, ms);
+
+	lq_get_stats(&q, &st);
+	lost = n - s.unique - st.msgs_dropped;
+	printf("%-22s %u flaps, %d lost in the server's buffers\n", "", s.flaps, lost);
+	CHECK(s.flaps >= 3);
+	CHECK(st.disconnects >= s.flaps);
+	CHECK(st.msgs_dropped == 0);
+	CHECK(st.msgs_spooled > 0);
+	CHECK(lost >= 0 && lost <= s.flaps * LQ_BATCH);
+	CHECK(s.bad == 0 && s.disorder == 0);
+	lq_close(&q);
+	sink_stop(&s);
+	CHECK(access(SPOOL_PATH ".0", F_OK) && access(SPOOL_PATH ".1", F_OK));
+}
+
+/* The server comes up late: the spool holds the logs, then they are replayed */
+static void test_late(int n, size_t spool_max)
+{
+	sink_t s = { .stream = true, .late_ms = 1500 };
+	lq_t q;
+	lq_stats_t st;
+	double ms;
+
+	sink_start(&s, n);
+	setup(&q, &s, 64, LQ_DROP_OLDEST, SPOOL_PATH, spool_max);
+	ms = produce(&q, n, 16, 0, 0);
+	drain(&q, 40000);
+	usleep(100000);
+	report(spool_max < LQ_SPOOL_MAX ? "late, small spool" : "late, spool", &q, &s, n, ms);
+
+	lq_get_stats(&q, &st);
+	CHECK(st.connects >= 1);
+	CHECK(st.msgs_spooled > 0);
+	CHECK(s.unique + st.msgs_dropped == n);
+	CHECK(s.bad == 0 && s.disorder == 0);
+	if (spool_max >= LQ_SPOOL_MAX) {
+		CHECK(st.msgs_dropped == 0);
+	} else {
+		CHECK(st.msgs_dropped > 0);
+	}
+	lq_close(&q);
+	sink_stop(&s);
+}
+
+int main(int argc, char **argv)
+{
+	test_baseline(false, 50000);
+	test_fast(false, 50000);
+	test_baseline(true, 50000);
+	test_fast(true, 50000);
+	test_slow_drop(8000);
+	test_slow_block(8000);
+	test_flap(20000);
+	test_late(10000, LQ_SPOOL_MAX);
+	test_late(10000, 64 * 1024);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
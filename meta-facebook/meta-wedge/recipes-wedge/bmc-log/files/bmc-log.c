@@ -36,6 +36,7 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include "bmc-log.h"
+#include "bmc-log-queue.h"
 
 FILE *error_file = NULL;
 
@@ -43,12 +44,20 @@ bool kill_received = false;	// To check if a killing interrupt is received
 
 speed_t baud_rate = B57600;	// Default baud rate - change if user inputs a different one
 
-int fd_tty = -1, fd_soc = -1;
+int fd_tty = -1;
 
 /* Hostname and port of the server */
 char *hostname;
 int port;
 
+/* Messages waiting to be sent to the server */
+lq_t log_queue;
+bool use_tcp = false;
+lq_policy_t queue_policy = LQ_DROP_OLDEST;
+int ring_msgs = LQ_RING_MSGS;
+char spool_path[SPOOL_LEN] = { 0 };
+size_t spool_max = LQ_SPOOL_MAX;
+
 struct termios orig_tty_state;
 
 char *get_time()
@@ -133,6 +142,7 @@ bool prepare_sock(struct sockaddr_in * tgt_addr)
 	tgt_addr->sin_addr = ((struct sockaddr_in *)addr_info->ai_addr)->sin_addr;
 	tgt_addr->sin_port = htons(port);
 	tgt_addr->sin_family = AF_INET;
+	freeaddrinfo(addr_info);
 
 	return true;
 }
@@ -151,6 +161,7 @@ bool prepare_sock6(struct sockaddr_in6 * tgt_addr6)
 	tgt_addr6->sin6_addr = ((struct sockaddr_in6 *)addr_info->ai_addr)->sin6_addr;
 	tgt_addr6->sin6_port = htons(port);
 	tgt_addr6->sin6_family = AF_INET6;
+	freeaddrinfo(addr_info);
 
 	return true;
 }
@@ -227,8 +238,8 @@ int create_pseudo_tty()
 	return amaster;
 }
 
-/* Prepare logs from the read_buf and send them to the server */
-bool prepare_log_send(char *read_buf, int max_read, int fd_socket)
+/* Prepare logs from the read_buf and queue them for the server */
+bool prepare_log_send(char *read_buf, int max_read)
 {
 	size_t buff_index = 0;	// Index for the read_buf string
 
@@ -236,6 +247,7 @@ bool prepare_log_send(char *read_buf, int max_read, int fd_socket)
 	static size_t line_index = 0;	// Index for the line string
 
 	char msg[MSG_LEN] = { 0 };	// Message to be sent to the server
+	int msg_len;
 
 	/* Kernel Version */
 	static char kernel_version[KERNEL_VERSION_LEN] = "dummy_kernel";
@@ -257,15 +269,14 @@ bool prepare_log_send(char *read_buf, int max_read, int fd_socket)
 			}
 
 			/* Prepare the message */
-			memset(msg, 0, sizeof(msg));
-			if (snprintf(msg, sizeof(msg), "%s %s %s %s", "kernel:", kernel_version, "- msg", line) < 0) {
+			msg_len = snprintf(msg, sizeof(msg), "%s %s %s %s", "kernel:", kernel_version, "- msg", line);
+			if (msg_len < 0) {
 				errlog("Error copying the message - %m\n");
 				return false;
 			}
 
-			/* Send message to the server */
-			if (write(fd_socket, msg, strlen(msg)) < 0) {
-				errlog("Error: Write to socket failed - %m\n");
+			/* Queue the message, the main loop sends it in a batch */
+			if (!lq_push(&log_queue, msg, MIN(msg_len, sizeof(msg) - 1))) {
 				return false;
 			}
 
@@ -290,14 +301,60 @@ bool prepare_log_send(char *read_buf, int max_read, int fd_socket)
 	return true;
 }
 
+/* Write the counters of the log queue for monitoring */
+void write_stats()
+{
+	static lq_stats_t last;
+	static time_t last_time;
+	char tmp_file[PATH_MAX];
+	lq_stats_t st;
+	time_t now = time(NULL);
+	long secs = now - last_time;
+	FILE *fp;
+
+	lq_get_stats(&log_queue, &st);
+	if (secs <= 0) {
+		secs = 1;
+	}
+
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", stats_file);
+	fp = fopen(tmp_file, "w");
+	if (!fp) {
+		return;
+	}
+	fprintf(fp, "link: %s\n", log_queue.state == LQ_UP ? "up" :
+	            log_queue.state == LQ_CONNECTING ? "connecting" : "down");
+	fprintf(fp, "msgs_in: %llu\n", (unsigned long long)st.msgs_in);
+	fprintf(fp, "msgs_sent: %llu\n", (unsigned long long)st.msgs_sent);
+	fprintf(fp, "bytes_sent: %llu\n", (unsigned long long)st.bytes_sent);
+	fprintf(fp, "msgs_dropped: %llu\n", (unsigned long long)st.msgs_dropped);
+	fprintf(fp, "msgs_spooled: %llu\n", (unsigned long long)st.msgs_spooled);
+	fprintf(fp, "msgs_resent: %llu\n", (unsigned long long)st.msgs_resent);
+	fprintf(fp, "msgs_queued: %u\n", st.queued);
+	fprintf(fp, "sends: %llu\n", (unsigned long long)st.sends);
+	fprintf(fp, "connects: %llu\n", (unsigned long long)st.connects);
+	fprintf(fp, "disconnects: %llu\n", (unsigned long long)st.disconnects);
+	fprintf(fp, "spool_errors: %llu\n", (unsigned long long)st.spool_errors);
+	fprintf(fp, "msgs_per_sec: %llu\n", (unsigned long long)(st.msgs_sent - last.msgs_sent) / secs);
+	fprintf(fp, "bytes_per_sec: %llu\n", (unsigned long long)(st.bytes_sent - last.bytes_sent) / secs);
+	fclose(fp);
+	rename(tmp_file, stats_file);
+
+	last = st;
+	last_time = now;
+}
+
 /* Read text from the TTY and send to send as logs */
-bool read_send(int fd_tty, int fd_socket)
+bool read_send(int fd_tty)
 {
-	char read_buf[LINE_LEN] = { 0 };	// Buffer to be read into.
+	char read_buf[READ_BUF_LEN] = { 0 };	// Buffer to be read into.
 	int read_size = 0;
-	fd_set readset;
+	fd_set readset, writeset;
+	struct timeval tv;
+	time_t next_stats = 0;
 	int sel;
 	int fdmax;
+	int ms;
 
 	int pseudo_tty = create_pseudo_tty();
 
@@ -306,19 +363,42 @@ bool read_send(int fd_tty, int fd_socket)
 		return false;
 	}
 
-	fdmax = MAX(fd_tty, pseudo_tty);
-
 	while (!kill_received) {
 		do {
 			FD_ZERO(&readset);
+			FD_ZERO(&writeset);
 			FD_SET(fd_tty, &readset);
 			FD_SET(pseudo_tty, &readset);
+			fdmax = MAX(fd_tty, pseudo_tty);
 
-			sel = select(fdmax + 1, &readset, NULL, NULL, NULL);
+			/* The link to the server, and when to retry or look for acks */
+			ms = lq_fdset(&log_queue, &readset, &writeset, &fdmax);
+			if (ms < 0 || ms > STATS_INTERVAL * 1000) {
+				ms = STATS_INTERVAL * 1000;
+			}
+			tv.tv_sec = ms / 1000;
+			tv.tv_usec = (ms % 1000) * 1000;
+
+			sel = select(fdmax + 1, &readset, &writeset, NULL, &tv);
 		}
 		while (sel == -1 && errno == EINTR && !kill_received);
 
-		memset(read_buf, 0, sizeof(read_buf));
+		if (sel == -1) {
+			if (kill_received) {
+				break;
+			}
+			errlog("Error: Select failed - %m\n");
+			return false;
+		}
+
+		/* Send what the last round queued, reconnect if needed */
+		lq_service(&log_queue, &readset, &writeset);
+
+		if (time(NULL) >= next_stats) {
+			write_stats();
+			next_stats = time(NULL) + STATS_INTERVAL;
+		}
+
 		if (FD_ISSET(fd_tty, &readset)) {
 			read_size = read(fd_tty, read_buf, sizeof(read_buf) - 1);
 
@@ -345,8 +425,11 @@ bool read_send(int fd_tty, int fd_socket)
 				return false;
 			}
 
-			/* Prepare log message and send to the server */
-			if (!prepare_log_send(read_buf, sizeof(read_buf), fd_socket)) {
+			/* Prepare log messages and queue them for the server */
+			if (!prepare_log_send(read_buf, read_size)) {
+				if (kill_received) {
+					break;
+				}
 				errlog("Error: Sending log failed - %m\n");
 				return false;
 			}
@@ -392,7 +475,8 @@ void cleanup()
 	remove(pseudo_tty_save_file);
 	tcsetattr(fd_tty, TCSAFLUSH, &orig_tty_state);	//Restore original settings
 	close(fd_tty);
-	close(fd_soc);
+	write_stats();
+	lq_close(&log_queue);
 	fclose(error_file);
 }
 
@@ -423,27 +507,73 @@ void register_kill()
 void usage(char *prog_name)
 {
 	printf("Usage:\n");
-	printf("\t%s TTY ip_version(4 or 6) hostname port [baud rate (like 57600)]\n", prog_name);
+	printf("\t%s [options] TTY ip_version(4 or 6) hostname port [baud rate (like 57600)]\n", prog_name);
 	printf("\t%s -h : For this help\n", prog_name);
+	printf("Options:\n");
+	printf("\t-t : Send over TCP, with sequence numbers, instead of UDP\n");
+	printf("\t-b : Stop reading the TTY when the queue is full, instead of dropping the oldest logs\n");
+	printf("\t-r msgs : Logs held in memory (default %d)\n", LQ_RING_MSGS);
+	printf("\t-s file : Spool logs to file when the memory is full\n");
+	printf("\t-S kbytes : Size of the spool (default %d)\n", LQ_SPOOL_MAX / 1024);
 	printf("Example:\n\t./bmc-log /dev/ttyS1 4 netcons.any.facebook.com 1514\n");
 	printf("\tOR\n\t./bmc-log /dev/ttyS1 6 netcons6.any.facebook.com 1514 57600\n");
+	printf("\tOR\n\t./bmc-log -t -s /mnt/data/bmc-log.spool /dev/ttyS1 6 netcons6.any.facebook.com 1514\n");
 }
 
 bool parse_user_input(int nargs, char **args, char *read_tty, int read_tty_size, int *ip_version)
 {
+	char *prog_name = args[0];
+	int opt;
+
+	while ((opt = getopt(nargs, args, "htbr:s:S:")) != -1) {
+		switch (opt) {
+		case 't':
+			use_tcp = true;
+			break;
+		case 'b':
+			queue_policy = LQ_BLOCK;
+			break;
+		case 'r':
+			ring_msgs = atoi(optarg);
+			if (ring_msgs < 1) {
+				fprintf(stderr, "Error: Invalid number of logs held in memory\n");
+				usage(prog_name);
+				return false;
+			}
+			break;
+		case 's':
+			if (strlen(optarg) >= sizeof(spool_path)) {
+				fprintf(stderr, "Error: Spool file name too long\n");
+				usage(prog_name);
+				return false;
+			}
+			strcpy(spool_path, optarg);
+			break;
+		case 'S':
+			spool_max = atoi(optarg) * 1024;
+			break;
+		default:
+			usage(prog_name);
+			return false;
+		}
+	}
+	/* The positional arguments follow the options */
+	nargs -= optind - 1;
+	args += optind - 1;
+
 	if (nargs < 5) {
 		if ((nargs > 1) && ((strcmp(args[1], "-h") == 0) || (strcmp(args[1], "--help") == 0))) {
-			usage(args[0]);
+			usage(prog_name);
 			return false;	// Not an error but returning -1 for the main function to return
 		}
 		fprintf(stderr, "Error: Invalid number of arguments\n");
-		usage(args[0]);
+		usage(prog_name);
 		return false;
 	}
 
 	if (strlen(args[1]) > read_tty_size) {
 		fprintf(stderr, "Error: TTY too long\n");
-		usage(args[0]);
+		usage(prog_name);
 		return false;
 	}
 
@@ -454,7 +584,7 @@ bool parse_user_input(int nargs, char **args, char *read_tty, int read_tty_size,
 	*ip_version = atoi(args[2]);
 	if (*ip_version != IPV4 && *ip_version != IPV6) {
 		fprintf(stderr, "Error: Invalid IP Version input\n");
-		usage(args[0]);
+		usage(prog_name);
 		return false;
 	}
 
@@ -472,7 +602,6 @@ int main(int argc, char **argv)
 {
 	char read_tty[TTY_LEN] = { 0 };
 	int ip_version;
-	int socket_domain = AF_UNSPEC;
 	char cmd[COMMAND_LEN] = { 0 };
 
 	/* Open the error log file */
@@ -496,47 +625,34 @@ int main(int argc, char **argv)
 		return 3;
 	}
 
-	/* Create a socket to communicate with the netcons server */
-	socket_domain = (ip_version == IPV4) ? AF_INET : AF_INET6;
-	fd_soc = socket(socket_domain, SOCK_DGRAM, 0);
-	if (fd_soc == -1) {
-		errlog("Error: Socket creation failed -  %m\n");
+	/* Queue to the netcons server, connected from the main loop */
+	if (!lq_init(&log_queue, ring_msgs, queue_policy, use_tcp,
+		     spool_path[0] ? spool_path : NULL, spool_max)) {
+		errlog("Error: Unable to allocate the log queue - %m\n");
 		return 4;
 	}
 
 	if (ip_version == IPV4) {	/* IPv4 */
 		struct sockaddr_in tgt_addr;
 		if (!prepare_sock(&tgt_addr)) {
-			close(fd_soc);
 			errlog("Error: Socket not valid\n");
 			return 5;
 		}
-
-		if (connect(fd_soc, (struct sockaddr *)&tgt_addr, sizeof(tgt_addr)) == -1) {
-			close(fd_soc);
-			errlog("Error: Socket connection failed - %m\n");
-			return 6;
-		}
+		lq_set_addr(&log_queue, (struct sockaddr *)&tgt_addr, sizeof(tgt_addr));
 
 	} else {		/* IPv6 */
 
 		struct sockaddr_in6 tgt_addr6;
 		if (!prepare_sock6(&tgt_addr6)) {
-			close(fd_soc);
 			errlog("Error: Socket not valid\n");
 			return 5;
 		}
-
-		if (connect(fd_soc, (struct sockaddr *)&tgt_addr6, sizeof(tgt_addr6)) == -1) {
-			close(fd_soc);
-			errlog("Error: Socket connection failed - %m\n");
-			return 6;
-		}
+		lq_set_addr(&log_queue, (struct sockaddr *)&tgt_addr6, sizeof(tgt_addr6));
 	}
 
 	/* TTY Operations */
 	if ((fd_tty = open(read_tty, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK)) == -1) {
-		close(fd_soc);
+		lq_close(&log_queue);
 		errlog("Error: Serial Port %s open failed - %m\n", read_tty);
 		return 7;
 	}
@@ -548,7 +664,7 @@ int main(int argc, char **argv)
 	}
 
 	/* Read, prepare and send the logs */
-	if (!read_send(fd_tty, fd_soc)) {
+	if (!read_send(fd_tty)) {
 		errlog("Error: Sending logs failed\n");
 		cleanup();
 		return 9;
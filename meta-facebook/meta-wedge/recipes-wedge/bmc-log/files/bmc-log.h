@@ -34,6 +34,11 @@
 #define MSG_LEN (1025)
 #define COMMAND_LEN (100)
 #define KERNEL_VERSION_LEN (100)
+#define READ_BUF_LEN (4096)
+#define SPOOL_LEN (100)
+
+/* Seconds between updates of the stats file */
+#define STATS_INTERVAL (10)
 
 static char *uS_console = "/usr/local/fbpackages/utils/us_console.sh";
 
@@ -41,6 +46,8 @@ static char *error_log_file = "/var/log/bmc-log";
 
 static char *pseudo_tty_save_file = "/etc/us_pseudo_tty";
 
+static char *stats_file = "/tmp/bmc-log.stats";
+
 static int kernel_search_len = sizeof(KERNEL_SEARCH_STR) - 1;
 
 #endif
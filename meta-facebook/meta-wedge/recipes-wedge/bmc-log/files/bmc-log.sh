@@ -40,6 +40,24 @@ LOG_SERVER=${LOG_SERVER_NAME:-}
 PORT=${LOG_SERVER_PORT:-}
 BAUD_RATE=${TTY_BAUD_RATE:-}
 
+OPTS=""
+if [ "$LOG_SERVER_PROTO" = "tcp" ]
+then
+	OPTS="$OPTS -t"
+fi
+if [ -n "$LOG_SPOOL_FILE" ]
+then
+	OPTS="$OPTS -s $LOG_SPOOL_FILE"
+fi
+if [ -n "$LOG_SPOOL_SIZE" ]
+then
+	OPTS="$OPTS -S $LOG_SPOOL_SIZE"
+fi
+if [ "$LOG_QUEUE_POLICY" = "block" ]
+then
+	OPTS="$OPTS -b"
+fi
+
 if [ -z "$LOG_SERVER" ] || [ -z "$PORT" ]
 then
 	echo "Error: Server and/or port not set"
@@ -52,7 +70,7 @@ ACTION="$1"
 case "$ACTION" in
   start)
   	echo -e "Starting $DESC"
-	$DAEMON $TTY $IP $LOG_SERVER $PORT $BAUD_RATE
+	$DAEMON $OPTS $TTY $IP $LOG_SERVER $PORT $BAUD_RATE
     ;;
   stop)
     echo -e "Stopping $DESC: "
@@ -62,7 +80,7 @@ case "$ACTION" in
     echo -e "Restarting $DESC: "
     start-stop-daemon --stop --quiet --exec $DAEMON
     sleep 1
-    $DAEMON $TTY $IP $LOG_SERVER $PORT $BAUD_RATE
+    $DAEMON $OPTS $TTY $IP $LOG_SERVER $PORT $BAUD_RATE
     ;;
   status)
     stat $DAEMON
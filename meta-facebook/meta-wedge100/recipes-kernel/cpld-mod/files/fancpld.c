@@ -318,6 +318,12 @@ static const i2c_dev_attr_st fancpld_attr_table[] = {
   },
 };
 
+/* Board revision, model and slot id are strapped, not the CPLD version */
+static const i2c_dev_reg_st fancpld_reg_table[] = {
+  { 0x0, 0x0, I2C_DEV_REG_NONVOLATILE },
+  { 0x3, 0x3, I2C_DEV_REG_NONVOLATILE },
+};
+
 static i2c_dev_data_st fancpld_data;
 
 /*
@@ -349,8 +355,10 @@ static int fancpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(fancpld_attr_table) / sizeof(fancpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &fancpld_data,
-                                 fancpld_attr_table, n_attrs);
+  return i2c_dev_sysfs_data_init_regmap(client, &fancpld_data,
+                                        fancpld_attr_table, n_attrs,
+                                        fancpld_reg_table,
+                                        ARRAY_SIZE(fancpld_reg_table));
 }
 
 static int fancpld_remove(struct i2c_client *client)
@@ -618,6 +618,12 @@ static const i2c_dev_attr_st syscpld_attr_table[] = {
   },
 };
 
+/* Board revision, model and slot id are strapped, not the CPLD version */
+static const i2c_dev_reg_st syscpld_reg_table[] = {
+  { 0x0, 0x0, I2C_DEV_REG_NONVOLATILE },
+  { 0x3, 0x3, I2C_DEV_REG_NONVOLATILE },
+};
+
 static i2c_dev_data_st syscpld_data;
 
 /*
@@ -649,8 +655,10 @@ static int syscpld_probe(struct i2c_client *client,
                          const struct i2c_device_id *id)
 {
   int n_attrs = sizeof(syscpld_attr_table) / sizeof(syscpld_attr_table[0]);
-  return i2c_dev_sysfs_data_init(client, &syscpld_data,
-                                 syscpld_attr_table, n_attrs);
+  return i2c_dev_sysfs_data_init_regmap(client, &syscpld_data,
+                                        syscpld_attr_table, n_attrs,
+                                        syscpld_reg_table,
+                                        ARRAY_SIZE(syscpld_reg_table));
 }
 
 static int syscpld_remove(struct i2c_client *client)